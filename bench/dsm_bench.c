@@ -0,0 +1,663 @@
+/**
+ * @file dsm_bench.c
+ * @brief Microbenchmarks of the protocol hot paths
+ *
+ * Every node runs this binary; node 0 writes the results as JSON so runs
+ * can be compared across releases. Measured, in order:
+ *
+ *   - local_upgrade_fault: write fault on a page node 0 owns and can read
+ *   - remote_read_fault / remote_write_fault: node 1 faulting on pages
+ *     node 0 owns
+ *   - page_pingpong: nodes 0 and 1 taking turns to write one page
+ *   - invalidation_fanout: node 0's write fault on a page read by 1 to N-1
+ *     other nodes
+ *   - lock_handoff: every node incrementing a shared counter under one lock
+ *   - barrier: a barrier of all N nodes (sweep N with scripts/run_bench.sh)
+ *   - network_send: frames per second node 1 sends to node 0
+ *   - page_stream: bytes per second dsm_prefetch() moves to node 1
+ *
+ * Latencies are taken around the faulting access in the application, so
+ * they include signal delivery and the return to user space.
+ *
+ * USAGE:
+ *   Node 0 (manager): ./dsm_bench --manager --nodes 2 [--json bench.json]
+ *   Node 1 (worker):  ./dsm_bench --worker --node-id 1 --manager-host <ip>
+ *   Or start all nodes at once with scripts/run_bench.sh.
+ *
+ * Multi-node benchmarks need sequential consistency, so this runs with the
+ * default protocol only.
+ */
+
+#include "dsm/dsm.h"
+#include "../src/core/log.h"
+#include "../src/network/network.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** Results the report region holds */
+#define BENCH_MAX_RESULTS 64
+
+/** Longest a spinning node waits for its peer before giving up */
+#define BENCH_SPIN_TIMEOUT_NS (30ULL * 1000000000ULL)
+
+/* Barrier and lock IDs, clear of the ones the tests use */
+#define BENCH_BARRIER_SETUP   7000
+#define BENCH_BARRIER_STEP    7001
+#define BENCH_BARRIER_LOOP    7002
+#define BENCH_LOCK_ID         7100
+
+/* What a result carries */
+#define RESULT_LATENCY   0x1   /**< min/p50/p99/mean/max_ns */
+#define RESULT_RATE      0x2   /**< ops_per_sec */
+#define RESULT_BANDWIDTH 0x4   /**< mb_per_sec */
+
+/**
+ * One benchmark result
+ * Lives in DSM memory so the measuring node can hand it to node 0.
+ */
+typedef struct {
+    char name[32];
+    char param_name[16];       /**< "" if the benchmark has no parameter */
+    int param;
+    unsigned flags;            /**< RESULT_* */
+    int ok;                    /**< 0 if the run failed or gave a wrong answer */
+    uint64_t samples;
+    double min_ns, p50_ns, p99_ns, mean_ns, max_ns;
+    double ops_per_sec;
+    double mb_per_sec;
+} bench_result_t;
+
+typedef struct {
+    int count;
+    bench_result_t results[BENCH_MAX_RESULTS];
+} bench_report_t;
+
+/* Benchmark parameters */
+static struct {
+    int node_id;
+    int num_nodes;
+    int pages;                 /**< Pages per fault benchmark */
+    int iterations;            /**< Rounds of ping-pong, lock and barrier loops */
+    int messages;              /**< Frames sent by network_send */
+    int stream_pages;          /**< Pages moved by page_stream */
+} g_bench;
+
+/* Shared regions, in allocation order (dsm_get_allocation index) */
+enum {
+    REGION_REPORT,
+    REGION_LOCAL,
+    REGION_REMOTE_READ,
+    REGION_REMOTE_WRITE,
+    REGION_PINGPONG,
+    REGION_FANOUT,
+    REGION_COUNTER,
+    REGION_STREAM,
+    NUM_REGIONS
+};
+
+static void *g_regions[NUM_REGIONS];
+static bench_report_t *g_report;
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline volatile int *page_at(int region, int page) {
+    return (volatile int *)((char *)g_regions[region] + (size_t)page * PAGE_SIZE);
+}
+
+static void sync_all(void) {
+    dsm_barrier(BENCH_BARRIER_STEP, g_bench.num_nodes);
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Start a result in the report
+ * Called by the measuring node only, between barriers.
+ */
+static bench_result_t *report_add(const char *name, const char *param_name, int param) {
+    if (g_report->count >= BENCH_MAX_RESULTS) {
+        fprintf(stderr, "[Node %d] Report full, dropping %s\n", g_bench.node_id, name);
+        return NULL;
+    }
+    bench_result_t result;
+    memset(&result, 0, sizeof(result));
+    strncpy(result.name, name, sizeof(result.name) - 1);
+    strncpy(result.param_name, param_name, sizeof(result.param_name) - 1);
+    result.param = param;
+    result.ok = 1;
+
+    bench_result_t *slot = &g_report->results[g_report->count++];
+    *slot = result;
+    return slot;
+}
+
+/** Fill a result's latency fields from samples (sorts them) */
+static void set_latency(bench_result_t *r, uint64_t *samples, size_t n) {
+    if (!r || n == 0) {
+        return;
+    }
+    qsort(samples, n, sizeof(uint64_t), compare_u64);
+    double sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += (double)samples[i];
+    }
+    r->flags |= RESULT_LATENCY;
+    r->samples = n;
+    r->min_ns = (double)samples[0];
+    r->p50_ns = (double)samples[n / 2];
+    r->p99_ns = (double)samples[(n * 99) / 100];
+    r->mean_ns = sum / (double)n;
+    r->max_ns = (double)samples[n - 1];
+}
+
+static void set_rate(bench_result_t *r, uint64_t ops, uint64_t elapsed_ns) {
+    if (!r || elapsed_ns == 0) {
+        return;
+    }
+    r->flags |= RESULT_RATE;
+    r->samples = ops;
+    r->ops_per_sec = (double)ops * 1e9 / (double)elapsed_ns;
+}
+
+static void set_bandwidth(bench_result_t *r, uint64_t bytes, uint64_t elapsed_ns) {
+    if (!r || elapsed_ns == 0) {
+        return;
+    }
+    r->flags |= RESULT_BANDWIDTH;
+    r->mb_per_sec = (double)bytes * 1e9 / (double)elapsed_ns / (1024.0 * 1024.0);
+}
+
+/* ================================================================
+ * Benchmarks
+ * ================================================================ */
+
+/**
+ * Node 0 reads each page it owns, then times the write that upgrades it
+ */
+static void bench_local_upgrade(uint64_t *samples) {
+    if (g_bench.node_id == 0) {
+        for (int i = 0; i < g_bench.pages; i++) {
+            (void)*page_at(REGION_LOCAL, i);
+        }
+        for (int i = 0; i < g_bench.pages; i++) {
+            uint64_t t0 = now_ns();
+            *page_at(REGION_LOCAL, i) = i;
+            samples[i] = now_ns() - t0;
+        }
+        set_latency(report_add("local_upgrade_fault", "", 0), samples, (size_t)g_bench.pages);
+    }
+    sync_all();
+}
+
+/**
+ * Node 0 writes the pages, then node 1 times its first access to each
+ */
+static void bench_remote_fault(uint64_t *samples, int region, bool write) {
+    if (g_bench.node_id == 0) {
+        for (int i = 0; i < g_bench.pages; i++) {
+            *page_at(region, i) = i + 1;
+        }
+    }
+    sync_all();
+
+    if (g_bench.node_id == 1) {
+        int wrong = 0;
+        for (int i = 0; i < g_bench.pages; i++) {
+            uint64_t t0 = now_ns();
+            if (write) {
+                *page_at(region, i) = -i;
+            } else if (*page_at(region, i) != i + 1) {
+                wrong++;
+            }
+            samples[i] = now_ns() - t0;
+        }
+        bench_result_t *r = report_add(write ? "remote_write_fault" : "remote_read_fault", "", 0);
+        set_latency(r, samples, (size_t)g_bench.pages);
+        if (r && wrong) {
+            r->ok = 0;
+        }
+    }
+    sync_all();
+}
+
+/**
+ * Nodes 0 and 1 increment one counter in turn: node 0 on even values,
+ * node 1 on odd ones. Each increment moves the page.
+ */
+static void bench_pingpong(void) {
+    volatile int *value = page_at(REGION_PINGPONG, 0);
+    if (g_bench.node_id == 0) {
+        *value = 0;
+    }
+    sync_all();
+
+    int self = g_bench.node_id;
+    bool ok = true;
+    uint64_t start = now_ns();
+    if (self <= 1) {
+        int target = 2 * g_bench.iterations;
+        int v;
+        while ((v = *value) < target) {
+            if ((v & 1) == self) {
+                *value = v + 1;
+            } else if (now_ns() - start > BENCH_SPIN_TIMEOUT_NS) {
+                fprintf(stderr, "[Node %d] Ping-pong stalled at %d\n", self, v);
+                ok = false;
+                break;
+            } else {
+                /* Let this node's handler threads run on a busy host */
+                sched_yield();
+            }
+        }
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    if (self == 0) {
+        bench_result_t *r = report_add("page_pingpong", "", 0);
+        set_rate(r, (uint64_t)g_bench.iterations, elapsed);
+        if (r) {
+            /* Two page moves per round */
+            r->flags |= RESULT_LATENCY;
+            r->mean_ns = (double)elapsed / (2.0 * g_bench.iterations);
+            r->ok = ok;
+        }
+    }
+    sync_all();
+}
+
+/**
+ * For each sharer count s, nodes 1..s read node 0's pages and node 0
+ * times the write that invalidates them
+ */
+static void bench_fanout(uint64_t *samples) {
+    for (int s = 1; s < g_bench.num_nodes; s++) {
+        int base = (s - 1) * g_bench.pages;
+        if (g_bench.node_id == 0) {
+            for (int i = 0; i < g_bench.pages; i++) {
+                *page_at(REGION_FANOUT, base + i) = i;
+            }
+        }
+        sync_all();
+
+        if (g_bench.node_id >= 1 && g_bench.node_id <= s) {
+            for (int i = 0; i < g_bench.pages; i++) {
+                (void)*page_at(REGION_FANOUT, base + i);
+            }
+        }
+        sync_all();
+
+        if (g_bench.node_id == 0) {
+            for (int i = 0; i < g_bench.pages; i++) {
+                uint64_t t0 = now_ns();
+                *page_at(REGION_FANOUT, base + i) = -i;
+                samples[i] = now_ns() - t0;
+            }
+            set_latency(report_add("invalidation_fanout", "sharers", s), samples,
+                        (size_t)g_bench.pages);
+        }
+        sync_all();
+    }
+}
+
+/**
+ * Every node increments the counter under one lock
+ */
+static void bench_lock_handoff(void) {
+    dsm_lock_t *lock = dsm_lock_create(BENCH_LOCK_ID);
+    volatile int *counter = page_at(REGION_COUNTER, 0);
+    if (g_bench.node_id == 0) {
+        *counter = 0;
+    }
+    sync_all();
+
+    uint64_t start = now_ns();
+    int failed = 0;
+    for (int i = 0; lock && i < g_bench.iterations; i++) {
+        if (dsm_lock_acquire(lock) != DSM_SUCCESS) {
+            failed++;
+            continue;
+        }
+        *counter = *counter + 1;
+        dsm_lock_release(lock);
+    }
+    sync_all();
+    uint64_t elapsed = now_ns() - start;
+
+    if (g_bench.node_id == 0) {
+        int expected = g_bench.num_nodes * g_bench.iterations;
+        int got = *counter;
+        bench_result_t *r = report_add("lock_handoff", "nodes", g_bench.num_nodes);
+        set_rate(r, (uint64_t)expected, elapsed);
+        if (r && (!lock || failed || got != expected)) {
+            fprintf(stderr, "[Node 0] Lock counter %d, expected %d\n", got, expected);
+            r->ok = 0;
+        }
+    }
+    sync_all();
+    if (lock) {
+        dsm_lock_destroy(lock);
+    }
+}
+
+/**
+ * Time a barrier of all nodes
+ */
+static void bench_barrier(uint64_t *samples, int iterations) {
+    for (int i = 0; i < iterations; i++) {
+        uint64_t t0 = now_ns();
+        dsm_barrier(BENCH_BARRIER_LOOP, g_bench.num_nodes);
+        samples[i] = now_ns() - t0;
+    }
+    if (g_bench.node_id == 0) {
+        set_latency(report_add("barrier", "nodes", g_bench.num_nodes), samples, (size_t)iterations);
+    }
+    sync_all();
+}
+
+/**
+ * Node 1 sends HEARTBEAT_ACK frames, which node 0 ignores, with network_send()
+ * Timed up to the following barrier, which arrives behind the last frame.
+ */
+static void bench_network_send(void) {
+    if (g_bench.node_id == 1) {
+        message_t msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.header.magic = MSG_MAGIC;
+        msg.header.type = MSG_HEARTBEAT_ACK;
+        msg.header.sender = (node_id_t)g_bench.node_id;
+        msg.payload.heartbeat_ack.acker = (node_id_t)g_bench.node_id;
+        size_t frame_bytes = sizeof(msg_header_t) + message_wire_payload_size(&msg);
+
+        int failed = 0;
+        uint64_t start = now_ns();
+        for (int i = 0; i < g_bench.messages; i++) {
+            if (network_send(0, &msg) != DSM_SUCCESS) {
+                failed++;
+            }
+        }
+        sync_all();
+        uint64_t elapsed = now_ns() - start;
+
+        uint64_t sent = (uint64_t)(g_bench.messages - failed);
+        bench_result_t *r = report_add("network_send", "frame_bytes", (int)frame_bytes);
+        set_rate(r, sent, elapsed);
+        set_bandwidth(r, sent * frame_bytes, elapsed);
+        if (r && failed) {
+            r->ok = 0;
+        }
+    } else {
+        sync_all();
+    }
+    sync_all();
+}
+
+/**
+ * Node 1 prefetches node 0's pages in one call
+ */
+static void bench_page_stream(void) {
+    size_t len = (size_t)g_bench.stream_pages * PAGE_SIZE;
+    if (g_bench.node_id == 0) {
+        for (int i = 0; i < g_bench.stream_pages; i++) {
+            *page_at(REGION_STREAM, i) = i;
+        }
+    }
+    sync_all();
+
+    if (g_bench.node_id == 1) {
+        uint64_t start = now_ns();
+        int rc = dsm_prefetch(g_regions[REGION_STREAM], len, ACCESS_READ);
+        int wrong = 0;
+        for (int i = 0; i < g_bench.stream_pages; i++) {
+            if (*page_at(REGION_STREAM, i) != i) {
+                wrong++;
+            }
+        }
+        uint64_t elapsed = now_ns() - start;
+
+        bench_result_t *r = report_add("page_stream", "pages", g_bench.stream_pages);
+        set_bandwidth(r, len, elapsed);
+        if (r && (rc != DSM_SUCCESS || wrong)) {
+            r->ok = 0;
+        }
+    }
+    sync_all();
+}
+
+/* ================================================================
+ * Setup and output
+ * ================================================================ */
+
+static int alloc_regions(void) {
+    size_t sizes[NUM_REGIONS] = {
+        [REGION_REPORT] = sizeof(bench_report_t),
+        [REGION_LOCAL] = (size_t)g_bench.pages * PAGE_SIZE,
+        [REGION_REMOTE_READ] = (size_t)g_bench.pages * PAGE_SIZE,
+        [REGION_REMOTE_WRITE] = (size_t)g_bench.pages * PAGE_SIZE,
+        [REGION_PINGPONG] = PAGE_SIZE,
+        [REGION_FANOUT] = (size_t)(g_bench.num_nodes > 1 ? g_bench.num_nodes - 1 : 1) *
+                          g_bench.pages * PAGE_SIZE,
+        [REGION_COUNTER] = PAGE_SIZE,
+        [REGION_STREAM] = (size_t)g_bench.stream_pages * PAGE_SIZE,
+    };
+
+    /* Only node 0 allocates; the others map the same objects by index */
+    if (g_bench.node_id == 0) {
+        for (int i = 0; i < NUM_REGIONS; i++) {
+            g_regions[i] = dsm_malloc(sizes[i]);
+        }
+    }
+    dsm_barrier(BENCH_BARRIER_SETUP, g_bench.num_nodes);
+    if (g_bench.node_id != 0) {
+        for (int i = 0; i < NUM_REGIONS; i++) {
+            g_regions[i] = dsm_get_allocation(i);
+        }
+    }
+
+    for (int i = 0; i < NUM_REGIONS; i++) {
+        if (!g_regions[i]) {
+            fprintf(stderr, "[Node %d] Missing region %d\n", g_bench.node_id, i);
+            return -1;
+        }
+    }
+    g_report = g_regions[REGION_REPORT];
+    return 0;
+}
+
+static void free_regions(void) {
+    dsm_barrier(BENCH_BARRIER_SETUP, g_bench.num_nodes);
+    for (int i = NUM_REGIONS - 1; i >= 0; i--) {
+        if (g_regions[i]) {
+            dsm_free(g_regions[i]);
+        }
+    }
+}
+
+static void write_json(FILE *out, const dsm_config_t *config) {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"benchmark\": \"dsm_bench\",\n");
+    fprintf(out, "  \"timestamp\": %ld,\n", (long)time(NULL));
+    fprintf(out, "  \"config\": {\n");
+    fprintf(out, "    \"nodes\": %d,\n", g_bench.num_nodes);
+    fprintf(out, "    \"pages\": %d,\n", g_bench.pages);
+    fprintf(out, "    \"iterations\": %d,\n", g_bench.iterations);
+    fprintf(out, "    \"messages\": %d,\n", g_bench.messages);
+    fprintf(out, "    \"stream_pages\": %d,\n", g_bench.stream_pages);
+    fprintf(out, "    \"fault_engine\": \"%s\",\n",
+            config->fault_engine == DSM_FAULT_USERFAULTFD ? "userfaultfd" : "sigsegv");
+    fprintf(out, "    \"handler_threads\": %d\n", config->num_handler_threads);
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"results\": [");
+
+    for (int i = 0; i < g_report->count; i++) {
+        const bench_result_t *r = &g_report->results[i];
+        fprintf(out, "%s\n    {\"name\": \"%s\"", i ? "," : "", r->name);
+        if (r->param_name[0]) {
+            fprintf(out, ", \"%s\": %d", r->param_name, r->param);
+        }
+        fprintf(out, ", \"ok\": %s, \"samples\": %lu", r->ok ? "true" : "false", r->samples);
+        if (r->flags & RESULT_LATENCY) {
+            if (r->max_ns > 0) {
+                fprintf(out, ", \"min_ns\": %.0f, \"p50_ns\": %.0f, \"p99_ns\": %.0f, \"max_ns\": %.0f",
+                        r->min_ns, r->p50_ns, r->p99_ns, r->max_ns);
+            }
+            fprintf(out, ", \"mean_ns\": %.0f", r->mean_ns);
+        }
+        if (r->flags & RESULT_RATE) {
+            fprintf(out, ", \"ops_per_sec\": %.1f", r->ops_per_sec);
+        }
+        if (r->flags & RESULT_BANDWIDTH) {
+            fprintf(out, ", \"mb_per_sec\": %.2f", r->mb_per_sec);
+        }
+        fprintf(out, "}");
+    }
+    fprintf(out, "\n  ]\n}\n");
+}
+
+void print_usage(const char *prog) {
+    printf("Usage:\n");
+    printf("  Manager: %s --manager --nodes <N> [--port <P>] [--json <FILE>] [options]\n", prog);
+    printf("  Worker:  %s --worker --node-id <ID> --manager-host <HOST> [--manager-port <P>] [options]\n", prog);
+    printf("Options (the same on every node):\n");
+    printf("  --pages <N>: pages per fault benchmark (default 256)\n");
+    printf("  --iterations <N>: rounds of the ping-pong, lock and barrier loops (default 1000)\n");
+    printf("  --messages <N>: frames sent by the network_send benchmark (default 100000)\n");
+    printf("  --stream-pages <N>: pages moved by the page_stream benchmark (default 1024)\n");
+    printf("  --handlers <N>: handle messages on a pool of N threads\n");
+    printf("  --userfaultfd: take faults with userfaultfd instead of SIGSEGV\n");
+    printf("  --json <FILE>: where node 0 writes the results (default: stdout)\n");
+}
+
+int main(int argc, char *argv[]) {
+    int is_manager = 0;
+    int node_id = -1;
+    int num_nodes = 2;
+    char manager_host[256] = "localhost";
+    int port = 5000;
+    int num_handler_threads = 0;
+    dsm_fault_engine_t fault_engine = DSM_FAULT_SIGSEGV;
+    const char *json_path = NULL;
+
+    g_bench.pages = 256;
+    g_bench.iterations = 1000;
+    g_bench.messages = 100000;
+    g_bench.stream_pages = 1024;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--manager") == 0) {
+            is_manager = 1;
+            node_id = 0;
+        } else if (strcmp(argv[i], "--worker") == 0) {
+            is_manager = 0;
+        } else if (strcmp(argv[i], "--node-id") == 0 && i + 1 < argc) {
+            node_id = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--nodes") == 0 && i + 1 < argc) {
+            num_nodes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--manager-host") == 0 && i + 1 < argc) {
+            strncpy(manager_host, argv[++i], sizeof(manager_host) - 1);
+        } else if ((strcmp(argv[i], "--port") == 0 || strcmp(argv[i], "--manager-port") == 0) &&
+                   i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pages") == 0 && i + 1 < argc) {
+            g_bench.pages = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            g_bench.iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--messages") == 0 && i + 1 < argc) {
+            g_bench.messages = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--stream-pages") == 0 && i + 1 < argc) {
+            g_bench.stream_pages = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--handlers") == 0 && i + 1 < argc) {
+            num_handler_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--userfaultfd") == 0) {
+            fault_engine = DSM_FAULT_USERFAULTFD;
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        }
+    }
+
+    if (node_id < 0 || num_nodes < 2 || num_nodes > MAX_NODES || g_bench.pages <= 0 ||
+        g_bench.iterations <= 0 || g_bench.messages <= 0 || g_bench.stream_pages <= 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    g_bench.node_id = node_id;
+    g_bench.num_nodes = num_nodes;
+
+    dsm_config_t config = {
+        .node_id = node_id,
+        .port = port + node_id,
+        .num_nodes = num_nodes,
+        .is_manager = is_manager,
+        .log_level = LOG_LEVEL_WARN,
+        .num_handler_threads = num_handler_threads,
+        .fault_engine = fault_engine
+    };
+    if (!is_manager) {
+        snprintf(config.manager_host, sizeof(config.manager_host), "%s", manager_host);
+        config.manager_port = port;
+    }
+
+    if (dsm_init(&config) != DSM_SUCCESS) {
+        fprintf(stderr, "Failed to initialize DSM\n");
+        return 1;
+    }
+
+    int samples_len = g_bench.pages > g_bench.iterations ? g_bench.pages : g_bench.iterations;
+    uint64_t *samples = calloc((size_t)samples_len, sizeof(uint64_t));
+    if (!samples || alloc_regions() != 0) {
+        free(samples);
+        dsm_finalize();
+        return 1;
+    }
+    if (node_id == 0) {
+        g_report->count = 0;
+    }
+    sync_all();
+
+    fprintf(stderr, "[Node %d] Running benchmarks on %d nodes\n", node_id, num_nodes);
+    bench_local_upgrade(samples);
+    bench_remote_fault(samples, REGION_REMOTE_READ, false);
+    bench_remote_fault(samples, REGION_REMOTE_WRITE, true);
+    bench_pingpong();
+    bench_fanout(samples);
+    bench_lock_handoff();
+    bench_barrier(samples, g_bench.iterations);
+    bench_network_send();
+    bench_page_stream();
+
+    int status = 0;
+    if (node_id == 0) {
+        FILE *out = json_path ? fopen(json_path, "w") : stdout;
+        if (out) {
+            write_json(out, &config);
+            if (out != stdout) {
+                fclose(out);
+                fprintf(stderr, "[Node 0] Results written to %s\n", json_path);
+            }
+        } else {
+            fprintf(stderr, "[Node 0] Cannot open %s\n", json_path);
+            status = 1;
+        }
+        for (int i = 0; i < g_report->count; i++) {
+            if (!g_report->results[i].ok) {
+                fprintf(stderr, "[Node 0] %s failed\n", g_report->results[i].name);
+                status = 1;
+            }
+        }
+    }
+
+    free_regions();
+    free(samples);
+    dsm_finalize();
+    return status;
+}
@@ -10,9 +10,8 @@
 #include "dsm/dsm.h"
 
 /* Barrier IDs - Following test_multinode.c pattern of unique barrier IDs */
-#define BARRIER_ALLOC          100
 #define BARRIER_INIT           101
-#define BARRIER_COMPUTE_BASE   1000   /* 1000, 1001, 1002... per generation */
+#define BARRIER_COMPUTE_BASE   1000   /* 999 before generation 0; the compute step itself ends in a dsm_allreduce() */
 #define BARRIER_SWAP_BASE      2000   /* 2000, 2001, 2002... per generation */
 #define BARRIER_FINAL          10000
 #define BARRIER_CLEANUP        10001
@@ -50,6 +49,9 @@ typedef struct {
     pattern_type_t pattern;  /* Initial pattern type */
     float random_density;    /* For random pattern (0.0-1.0) */
 
+    /* Compute mode */
+    int packed;              /* 1 = bit-packed cells with halo-row exchange */
+
     /* DSM parameters - Following test_multinode.c structure */
     int node_id;             /* Node ID (0 = manager) */
     int num_nodes;           /* Total nodes in cluster */
@@ -57,6 +59,7 @@ typedef struct {
     char manager_host[256];  /* Manager hostname (for workers) */
     int port;                /* Base port number */
     int log_level;           /* DSM log level */
+    int dissemination;       /* 1 = dissemination barriers instead of the manager's */
 } gol_config_t;
 
 /**
@@ -69,12 +72,14 @@ static inline void gol_config_init(gol_config_t *config) {
     config->display_interval = DEFAULT_DISPLAY_INTERVAL;
     config->pattern = PATTERN_RANDOM;
     config->random_density = 0.3f;
+    config->packed = 0;
     config->node_id = -1;  /* Must be set */
     config->num_nodes = 2;
     config->is_manager = 0;
     config->manager_host[0] = '\0';
     config->port = DEFAULT_PORT;
     config->log_level = 3;  /* 3 = INFO level (0=NONE, 1=ERROR, 2=WARN, 3=INFO, 4=DEBUG) */
+    config->dissemination = 0;
 }
 
 #endif /* GOL_CONFIG_H */
@@ -33,7 +33,9 @@ void print_usage(const char *prog) {
     printf("  --pattern <TYPE>       Initial pattern: glider, random, rpentomino (default: random)\n");
     printf("  --density <F>          Random pattern density 0.0-1.0 (default: 0.3)\n");
     printf("  --display-interval <N> Display every N generations (default: 10, 0=none)\n");
+    printf("  --packed               Bit-packed cells, word-parallel kernel, halo-row exchange\n");
     printf("  --port <P>             Base port number (default: 5000)\n");
+    printf("  --dissemination        Dissemination barriers, without the manager (every node)\n");
     printf("  --log-level <L>        Log level 0-4 (default: 3=INFO)\n\n");
     printf("Examples:\n");
     printf("  # 2-node setup with 100x100 grid\n");
@@ -90,6 +92,10 @@ int parse_arguments(int argc, char *argv[], gol_config_t *config) {
             config->random_density = atof(argv[++i]);
         } else if (strcmp(argv[i], "--display-interval") == 0 && i + 1 < argc) {
             config->display_interval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--packed") == 0) {
+            config->packed = 1;
+        } else if (strcmp(argv[i], "--dissemination") == 0) {
+            config->dissemination = 1;
         } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
             config->log_level = atoi(argv[++i]);
         } else {
@@ -127,7 +133,8 @@ int initialize_dsm(const gol_config_t *config) {
         .port = config->port + config->node_id,  /* Unique port per node */
         .num_nodes = config->num_nodes,
         .is_manager = config->is_manager,
-        .log_level = config->log_level
+        .log_level = config->log_level,
+        .barrier_algorithm = config->dissemination ? DSM_BARRIER_DISSEMINATION : DSM_BARRIER_CENTRAL
     };
 
     /* Set manager connection info for workers */
@@ -172,6 +179,7 @@ int main(int argc, char *argv[]) {
     printf("  Generations: %d\n", config.num_generations);
     printf("  Display interval: %d\n", config.display_interval);
     printf("  Pattern: %d\n", config.pattern);
+    printf("  Mode: %s\n", config.packed ? "packed" : "byte");
     printf("  Nodes: %d (this node: %d, %s)\n",
            config.num_nodes, config.node_id, config.is_manager ? "manager" : "worker");
     printf("\n");
@@ -191,34 +199,12 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    /* PHASE 2: Per-Node Partition Allocation */
-    /* CRITICAL: Sequential allocation to ensure deterministic allocation indices
-     * Node 0 allocates first (gets indices 0, 1)
-     * Node 1 allocates second (gets indices 2, 3)
-     * This ensures dsm_get_allocation(node*2) returns correct partition
-     */
-    for (int i = 0; i < config.num_nodes; i++) {
-        if (config.node_id == i) {
-            printf("[Node %d] Allocating my partition...\n", config.node_id);
-            rc = gol_allocate_partition(&state);
-            if (rc != DSM_SUCCESS) {
-                fprintf(stderr, "[Node %d] Failed to allocate partition\n", config.node_id);
-                dsm_finalize();
-                return 1;
-            }
-        }
-
-        /* Barrier after each node's allocation */
-        printf("[Node %d] Waiting at BARRIER_ALLOC_%d...\n", config.node_id, i);
-        dsm_barrier(BARRIER_ALLOC + i, config.num_nodes);
-        printf("[Node %d] Passed BARRIER_ALLOC_%d\n", config.node_id, i);
-    }
-
-    /* ALL nodes retrieve other nodes' partitions via SVAS */
-    printf("[Node %d] Retrieving other partitions...\n", config.node_id);
-    rc = gol_retrieve_partitions(&state);
+    /* PHASE 2: Per-Node Partition Allocation
+     * One collective call per grid gives every node all partitions at once */
+    printf("[Node %d] Allocating partitions...\n", config.node_id);
+    rc = gol_allocate_partitions(&state);
     if (rc != DSM_SUCCESS) {
-        fprintf(stderr, "[Node %d] Failed to retrieve partitions\n", config.node_id);
+        fprintf(stderr, "[Node %d] Failed to allocate partitions\n", config.node_id);
         dsm_finalize();
         return 1;
     }
@@ -263,8 +249,11 @@ int main(int argc, char *argv[]) {
         /* CRITICAL: This will trigger page faults at boundary rows */
         uint64_t live_cells = compute_generation(&state);
 
-        /* Step 2: Barrier - all nodes must finish computing before swap */
-        dsm_barrier(BARRIER_COMPUTE_BASE + gen, config.num_nodes);
+        /* Step 2: Barrier - all nodes must finish computing before swap.
+         * The allreduce is that barrier and also totals the live cells,
+         * without reading any other node's partition */
+        uint64_t total_live = live_cells;
+        dsm_allreduce(&total_live, 1, DSM_TYPE_UINT64, DSM_REDUCE_SUM);
 
         /* Step 3: Status output (all nodes, using display_interval) */
         int should_display = (config.display_interval > 0) && 
@@ -275,8 +264,8 @@ int main(int argc, char *argv[]) {
             dsm_get_stats(&stats_now);
             
             /* Output generation info */
-            printf("[Node %d] Generation %d: %lu live cells in partition\n",
-                   config.node_id, gen, live_cells);
+            printf("[Node %d] Generation %d: %lu live cells in partition, %lu in total\n",
+                   config.node_id, gen, live_cells, total_live);
             
             /* Output current page fault stats (cumulative since start) */
             printf("[Node %d] Page faults: %lu (R: %lu, W: %lu)\n",
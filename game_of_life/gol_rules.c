@@ -71,6 +71,10 @@ uint64_t compute_generation(gol_state_t *state) {
         return 0;
     }
 
+    if (state->packed) {
+        return compute_generation_packed(state);
+    }
+
     const int width = state->grid_width;
     uint64_t live_count = 0;
 
@@ -106,6 +110,133 @@ uint64_t compute_generation(gol_state_t *state) {
     return live_count;
 }
 
+/* Bit-sliced adders: bit i of each word is an independent 1-bit lane */
+static inline void half_add(gol_word_t a, gol_word_t b, gol_word_t *sum, gol_word_t *carry) {
+    *sum = a ^ b;
+    *carry = a & b;
+}
+
+static inline void full_add(gol_word_t a, gol_word_t b, gol_word_t c,
+                            gol_word_t *sum, gol_word_t *carry) {
+    gol_word_t t = a ^ b;
+    *sum = t ^ c;
+    *carry = (a & b) | (t & c);
+}
+
+/**
+ * Next state of 64 cells from the three rows around them
+ *
+ * The eight neighbor bits are summed lane-wise into ones/twos/fours; a count
+ * of 8 wraps to 0, which is dead either way.
+ */
+static inline gol_word_t next_word(gol_word_t nw, gol_word_t n, gol_word_t ne,
+                                   gol_word_t w, gol_word_t c, gol_word_t e,
+                                   gol_word_t sw, gol_word_t s, gol_word_t se) {
+    gol_word_t s_above, c_above, s_below, c_below, s_mid, c_mid;
+    full_add(nw, n, ne, &s_above, &c_above);
+    full_add(sw, s, se, &s_below, &c_below);
+    half_add(w, e, &s_mid, &c_mid);
+
+    gol_word_t ones, carry_ones, t, carry_twos, twos, carry_t;
+    full_add(s_above, s_below, s_mid, &ones, &carry_ones);
+    full_add(c_above, c_below, c_mid, &t, &carry_twos);
+    half_add(t, carry_ones, &twos, &carry_t);
+    gol_word_t fours = carry_twos ^ carry_t;
+
+    /* Alive with 3 neighbors, or alive now with 2 */
+    return ~fours & twos & (ones | c);
+}
+
+/* Word w of a row shifted so bit i holds column i-1 (west) or i+1 (east), wrapping */
+static inline gol_word_t west_word(const gol_word_t *row, int w, int words, int width) {
+    gol_word_t carry = (w > 0) ? row[w - 1] >> (GOL_WORD_BITS - 1)
+                               : (row[words - 1] >> ((width - 1) % GOL_WORD_BITS)) & 1;
+    return (row[w] << 1) | carry;
+}
+
+static inline gol_word_t east_word(const gol_word_t *row, int w, int words, int width) {
+    if (w < words - 1) {
+        return (row[w] >> 1) | (row[w + 1] << (GOL_WORD_BITS - 1));
+    }
+    return (row[w] >> 1) | ((row[0] & 1) << ((width - 1) % GOL_WORD_BITS));
+}
+
+/**
+ * Compute one row of the next generation
+ * @return Live cells in the new row
+ */
+static uint64_t compute_row_packed(const gol_word_t *above, const gol_word_t *row,
+                                   const gol_word_t *below, gol_word_t *out,
+                                   int words, int width) {
+    const int tail = width % GOL_WORD_BITS;
+    const gol_word_t tail_mask = tail ? ((gol_word_t)1 << tail) - 1 : ~(gol_word_t)0;
+    uint64_t live = 0;
+
+    /* Edge words wrap around the row; the interior loop is branch-free */
+    const int edges[2] = {0, words - 1};
+    for (int i = 0; i < (words > 1 ? 2 : 1); i++) {
+        int w = edges[i];
+        out[w] = next_word(west_word(above, w, words, width), above[w],
+                           east_word(above, w, words, width),
+                           west_word(row, w, words, width), row[w],
+                           east_word(row, w, words, width),
+                           west_word(below, w, words, width), below[w],
+                           east_word(below, w, words, width));
+    }
+    out[words - 1] &= tail_mask;
+
+    for (int w = 1; w < words - 1; w++) {
+        out[w] = next_word((above[w] << 1) | (above[w - 1] >> (GOL_WORD_BITS - 1)), above[w],
+                           (above[w] >> 1) | (above[w + 1] << (GOL_WORD_BITS - 1)),
+                           (row[w] << 1) | (row[w - 1] >> (GOL_WORD_BITS - 1)), row[w],
+                           (row[w] >> 1) | (row[w + 1] << (GOL_WORD_BITS - 1)),
+                           (below[w] << 1) | (below[w - 1] >> (GOL_WORD_BITS - 1)), below[w],
+                           (below[w] >> 1) | (below[w + 1] << (GOL_WORD_BITS - 1)));
+    }
+
+    for (int w = 0; w < words; w++) {
+        live += (uint64_t)__builtin_popcountll(out[w]);
+    }
+    return live;
+}
+
+/**
+ * Compute next generation in packed mode
+ * CRITICAL: Reads neighbor partitions only through the halo copies
+ */
+uint64_t compute_generation_packed(gol_state_t *state) {
+    if (!state || !state->packed) {
+        fprintf(stderr, "Invalid state in compute_generation_packed\n");
+        return 0;
+    }
+
+    if (gol_fetch_halo(state) != DSM_SUCCESS) {
+        fprintf(stderr, "[Node %d] Failed to fetch halo rows\n", state->my_node_id);
+        return 0;
+    }
+
+    const int words = state->words_per_row;
+    const int width = state->grid_width;
+    uint64_t live_count = 0;
+
+    for (int row = state->start_row; row < state->end_row; row++) {
+        const gol_word_t *above = (row == state->start_row) ? state->halo_above
+                                  : gol_get_row_words(state, 0, row - 1);
+        const gol_word_t *below = (row == state->end_row - 1) ? state->halo_below
+                                  : gol_get_row_words(state, 0, row + 1);
+        const gol_word_t *current = gol_get_row_words(state, 0, row);
+        gol_word_t *next = gol_get_row_words(state, 1, row);
+        if (!above || !below || !current || !next) {
+            fprintf(stderr, "[Node %d] Failed to get row %d\n", state->my_node_id, row);
+            continue;
+        }
+
+        live_count += compute_row_packed(above, current, below, next, words, width);
+    }
+
+    return live_count;
+}
+
 /**
  * Count live cells in this node's partition only
  * Note: grid parameter is unused (kept for API compatibility)
@@ -120,6 +251,16 @@ uint64_t count_live_cells(const cell_t *grid, const gol_state_t *state) {
     uint64_t count = 0;
     const int width = state->grid_width;
 
+    if (state->packed) {
+        for (int row = state->start_row; row < state->end_row; row++) {
+            const gol_word_t *words = gol_get_row_words(state, 0, row);
+            for (int w = 0; words && w < state->words_per_row; w++) {
+                count += (uint64_t)__builtin_popcountll(words[w]);
+            }
+        }
+        return count;
+    }
+
     /* Count only in this node's partition */
     for (int row = state->start_row; row < state->end_row; row++) {
         for (int col = 0; col < width; col++) {
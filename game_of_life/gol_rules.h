@@ -40,13 +40,27 @@ cell_t apply_rules(cell_t current_state, int neighbor_count);
  * @brief Compute next generation for this node's partition
  *
  * Each node computes only its assigned rows [start_row, end_row).
- * Boundary row accesses will trigger DSM page faults.
+ * Boundary row accesses will trigger DSM page faults. In packed mode this
+ * calls compute_generation_packed().
  *
  * @param state Game state
  * @return Number of live cells in this partition
  */
 uint64_t compute_generation(gol_state_t *state);
 
+/**
+ * @brief Compute next generation for this node's partition in packed mode
+ *
+ * Fetches the two halo rows with gol_fetch_halo(), then counts neighbors 64
+ * cells at a time with bit-sliced adders over whole words. Only this node's
+ * own rows and the local halo copies are read, so the only DSM traffic is
+ * one batched fetch per boundary.
+ *
+ * @param state Game state (packed mode)
+ * @return Number of live cells in this partition
+ */
+uint64_t compute_generation_packed(gol_state_t *state);
+
 /**
  * @brief Count live cells in this node's partition
  *
@@ -1,7 +1,7 @@
 /**
  * @file gol_state.c
- * @brief Game of Life state management - Per-node allocation design
- * Each node allocates ONLY its partition to comply with SWMR protocol
+ * @brief Game of Life state management - Per-node partition design
+ * Each node owns and writes ONLY its partition to comply with SWMR protocol
  */
 
 #include "gol_state.h"
@@ -22,10 +22,24 @@ int gol_state_init(gol_state_t *state, const gol_config_t *config) {
     state->grid_height = config->grid_height;
     state->num_nodes = config->num_nodes;
     state->my_node_id = config->node_id;
+    state->packed = config->packed;
 
     /* Calculate partition boundaries for ALL nodes */
     gol_calculate_partition(state);
 
+    if (state->packed) {
+        state->words_per_row = (state->grid_width + GOL_WORD_BITS - 1) / GOL_WORD_BITS;
+        state->halo_above = calloc(state->words_per_row, sizeof(gol_word_t));
+        state->halo_below = calloc(state->words_per_row, sizeof(gol_word_t));
+        if (!state->halo_above || !state->halo_below) {
+            fprintf(stderr, "[Node %d] Failed to allocate halo rows\n", config->node_id);
+            free(state->halo_above);
+            free(state->halo_below);
+            state->halo_above = state->halo_below = NULL;
+            return DSM_ERROR_MEMORY;
+        }
+    }
+
     printf("[Node %d] State initialized: my partition rows [%d, %d), %d rows total\n",
            config->node_id, state->start_row, state->end_row, state->num_rows);
 
@@ -68,7 +82,7 @@ void gol_calculate_partition(gol_state_t *state) {
     state->num_rows = state->partition_num_rows[config->node_id];
 }
 
-int gol_allocate_partition(gol_state_t *state) {
+int gol_allocate_partitions(gol_state_t *state) {
     if (!state || !state->config) {
         fprintf(stderr, "NULL state or config\n");
         return DSM_ERROR_INVALID;
@@ -76,38 +90,47 @@ int gol_allocate_partition(gol_state_t *state) {
 
     const gol_config_t *config = state->config;
     const int my_node = config->node_id;
+    const int num_nodes = config->num_nodes;
 
-    /* Calculate this node's partition size */
-    size_t partition_size = state->num_rows * state->grid_width * sizeof(cell_t);
-
-    printf("[Node %d] Allocating partition: %d rows × %d cols = %zu bytes\n",
-           my_node, state->num_rows, state->grid_width, partition_size);
+    /* Partitions are all as large as the first, which gets any remainder row */
+    size_t row_size = state->packed ? state->words_per_row * sizeof(gol_word_t)
+                                    : state->grid_width * sizeof(cell_t);
+    size_t partition_size = state->partition_num_rows[0] * row_size;
+
+    printf("[Node %d] Allocating %d partitions: %d rows × %d cols = %zu bytes each%s\n",
+           my_node, num_nodes, state->partition_num_rows[0], state->grid_width,
+           partition_size, state->packed ? " (packed)" : "");
+
+    /* One collective region per generation; node n owns the n-th partition
+     * of each. Grids are mostly dead cells, so their pages compress well on
+     * the wire */
+    dsm_alloc_attr_t attr;
+    dsm_alloc_attr_init(&attr);
+    attr.compression = DSM_COMPRESSION_LZ;
+
+    size_t stride = 0;
+    for (int grid = 0; grid < 2; grid++) {
+        state->grids[grid] = (cell_t*)dsm_malloc_collective(partition_size, &attr, &stride);
+        if (!state->grids[grid]) {
+            fprintf(stderr, "[Node %d] Failed to allocate grid %d (%d × %zu bytes)\n",
+                    my_node, grid, num_nodes, partition_size);
+            if (grid == 1) {
+                dsm_free(state->grids[0]);
+                state->grids[0] = NULL;
+            }
+            return DSM_ERROR_MEMORY;
+        }
 
-    /* Allocate current generation partition */
-    state->partitions_current[my_node] = (cell_t*)dsm_malloc(partition_size);
-    if (!state->partitions_current[my_node]) {
-        fprintf(stderr, "[Node %d] Failed to allocate partitions_current[%d] (%zu bytes)\n",
-                my_node, my_node, partition_size);
-        return DSM_ERROR_MEMORY;
+        printf("[Node %d] Allocated grid %d at %p (stride %zu bytes)\n",
+               my_node, grid, (void*)state->grids[grid], stride);
     }
 
-    printf("[Node %d] Allocated partitions_current[%d] at %p (%zu bytes)\n",
-           my_node, my_node, (void*)state->partitions_current[my_node], partition_size);
-
-    /* Allocate next generation partition */
-    state->partitions_next[my_node] = (cell_t*)dsm_malloc(partition_size);
-    if (!state->partitions_next[my_node]) {
-        fprintf(stderr, "[Node %d] Failed to allocate partitions_next[%d]\n",
-                my_node, my_node);
-        dsm_free(state->partitions_current[my_node]);
-        state->partitions_current[my_node] = NULL;
-        return DSM_ERROR_MEMORY;
+    for (int node = 0; node < num_nodes; node++) {
+        state->partitions_current[node] = state->grids[0] + (size_t)node * stride;
+        state->partitions_next[node] = state->grids[1] + (size_t)node * stride;
     }
 
-    printf("[Node %d] Allocated partitions_next[%d] at %p (%zu bytes)\n",
-           my_node, my_node, (void*)state->partitions_next[my_node], partition_size);
-
-    /* Initialize partition to zero */
+    /* Initialize our partitions to zero */
     memset(state->partitions_current[my_node], 0, partition_size);
     memset(state->partitions_next[my_node], 0, partition_size);
 
@@ -116,73 +139,11 @@ int gol_allocate_partition(gol_state_t *state) {
     return DSM_SUCCESS;
 }
 
-int gol_retrieve_partitions(gol_state_t *state) {
-    if (!state || !state->config) {
-        fprintf(stderr, "NULL state or config\n");
-        return DSM_ERROR_INVALID;
-    }
-
-    const gol_config_t *config = state->config;
-    const int my_node = config->node_id;
-    const int num_nodes = config->num_nodes;
-
-    printf("[Node %d] Retrieving other nodes' partitions via SVAS...\n", my_node);
-
-    /* Calculate allocation index for each node
-     * Each node allocates 2 partitions (current and next)
-     * Node 0: allocations 0, 1
-     * Node 1: allocations 2, 3
-     * Node N: allocations 2*N, 2*N+1
-     */
-
-    for (int node = 0; node < num_nodes; node++) {
-        if (node == my_node) {
-            /* Already have our own partition */
-            printf("[Node %d] Partition %d: Own allocation (already set)\n",
-                   my_node, node);
-            continue;
-        }
-
-        int alloc_idx_current = node * 2;
-        int alloc_idx_next = node * 2 + 1;
-
-        /* Retrieve remote partition for current generation */
-        state->partitions_current[node] = (cell_t*)dsm_get_allocation(alloc_idx_current);
-        if (!state->partitions_current[node]) {
-            fprintf(stderr, "[Node %d] Failed to retrieve partitions_current[%d] (allocation %d)\n",
-                    my_node, node, alloc_idx_current);
-            return DSM_ERROR_NOT_FOUND;
-        }
-
-        printf("[Node %d] Retrieved partitions_current[%d] at %p (allocation %d)\n",
-               my_node, node, (void*)state->partitions_current[node], alloc_idx_current);
-
-        /* Retrieve remote partition for next generation */
-        state->partitions_next[node] = (cell_t*)dsm_get_allocation(alloc_idx_next);
-        if (!state->partitions_next[node]) {
-            fprintf(stderr, "[Node %d] Failed to retrieve partitions_next[%d] (allocation %d)\n",
-                    my_node, node, alloc_idx_next);
-            return DSM_ERROR_NOT_FOUND;
-        }
-
-        printf("[Node %d] Retrieved partitions_next[%d] at %p (allocation %d)\n",
-               my_node, node, (void*)state->partitions_next[node], alloc_idx_next);
-    }
-
-    printf("[Node %d] All partitions retrieved successfully\n", my_node);
-    return DSM_SUCCESS;
-}
-
-cell_t* gol_get_cell(const gol_state_t *state, int grid, int row, int col) {
-    if (!state) {
-        return NULL;
-    }
-
-    /* Validate row and column */
-    if (row < 0 || row >= state->grid_height || col < 0 || col >= state->grid_width) {
-        return NULL;
-    }
-
+/**
+ * Map a grid row to its partition
+ * @return Pointer to the start of the row, or NULL if invalid
+ */
+static cell_t* locate_row(const gol_state_t *state, int grid, int row) {
     /* Determine which node owns this row */
     int owner_node = -1;
     int local_row = -1;
@@ -215,12 +176,71 @@ cell_t* gol_get_cell(const gol_state_t *state, int grid, int row, int col) {
     }
 
     /* Calculate offset within partition */
-    size_t offset = local_row * state->grid_width + col;
+    size_t row_size = state->packed ? state->words_per_row * sizeof(gol_word_t)
+                                    : (size_t)state->grid_width;
+    return partition + local_row * row_size;
+}
+
+cell_t* gol_get_cell(const gol_state_t *state, int grid, int row, int col) {
+    if (!state || state->packed) {
+        return NULL;  /* Packed cells are not addressable */
+    }
+
+    /* Validate row and column */
+    if (row < 0 || row >= state->grid_height || col < 0 || col >= state->grid_width) {
+        return NULL;
+    }
+
+    cell_t *cells = locate_row(state, grid, row);
+    return cells ? &cells[col] : NULL;
+}
+
+gol_word_t* gol_get_row_words(const gol_state_t *state, int grid, int row) {
+    if (!state || !state->packed || row < 0 || row >= state->grid_height) {
+        return NULL;
+    }
 
-    return &partition[offset];
+    return (gol_word_t*)locate_row(state, grid, row);
+}
+
+int gol_fetch_halo(gol_state_t *state) {
+    if (!state || !state->packed) {
+        return DSM_ERROR_INVALID;
+    }
+
+    const int height = state->grid_height;
+    const size_t row_size = state->words_per_row * sizeof(gol_word_t);
+    gol_word_t *above = gol_get_row_words(state, 0, (state->start_row - 1 + height) % height);
+    gol_word_t *below = gol_get_row_words(state, 0, state->end_row % height);
+    if (!above || !below) {
+        return DSM_ERROR_NOT_FOUND;
+    }
+
+    /* Request both boundaries before waiting on either copy */
+    dsm_prefetch(above, row_size, ACCESS_READ);
+    dsm_prefetch(below, row_size, ACCESS_READ);
+
+    memcpy(state->halo_above, above, row_size);
+    memcpy(state->halo_below, below, row_size);
+    return DSM_SUCCESS;
 }
 
 int gol_set_cell(const gol_state_t *state, int grid, int row, int col, cell_t value) {
+    if (state && state->packed) {
+        gol_word_t *words = gol_get_row_words(state, grid, row);
+        if (!words || col < 0 || col >= state->grid_width) {
+            return DSM_ERROR_INVALID;
+        }
+
+        gol_word_t bit = (gol_word_t)1 << (col % GOL_WORD_BITS);
+        if (value) {
+            words[col / GOL_WORD_BITS] |= bit;
+        } else {
+            words[col / GOL_WORD_BITS] &= ~bit;
+        }
+        return DSM_SUCCESS;
+    }
+
     cell_t *cell = gol_get_cell(state, grid, row, col);
     if (!cell) {
         return DSM_ERROR_INVALID;
@@ -246,18 +266,21 @@ void gol_state_cleanup(gol_state_t *state) {
         state->display_lock = NULL;
     }
 
-    /* Free only OUR partitions (we own them) */
-    if (state->partitions_current[my_node]) {
-        dsm_free(state->partitions_current[my_node]);
-        state->partitions_current[my_node] = NULL;
-    }
-
-    if (state->partitions_next[my_node]) {
-        dsm_free(state->partitions_next[my_node]);
-        state->partitions_next[my_node] = NULL;
+    /* Every node frees both collective regions, which releases its own
+     * page tables for all partitions */
+    for (int grid = 0; grid < 2; grid++) {
+        if (state->grids[grid]) {
+            dsm_free(state->grids[grid]);
+            state->grids[grid] = NULL;
+        }
     }
+    memset(state->partitions_current, 0, sizeof(state->partitions_current));
+    memset(state->partitions_next, 0, sizeof(state->partitions_next));
 
-    /* Don't free other nodes' partitions - they own them! */
+    free(state->halo_above);
+    free(state->halo_below);
+    state->halo_above = NULL;
+    state->halo_below = NULL;
 
     printf("[Node %d] State cleanup complete\n", my_node);
 }
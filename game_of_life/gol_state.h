@@ -13,18 +13,24 @@
 /* Cell type - 1 byte per cell (0 = dead, 1 = alive) */
 typedef uint8_t cell_t;
 
+/* Packed cells - 64 per word, column c is bit (c % 64) of word (c / 64) */
+typedef uint64_t gol_word_t;
+#define GOL_WORD_BITS 64
+
 /* Maximum nodes supported */
 #define MAX_GOL_NODES 4
 
 /**
  * @brief Game of Life runtime state
- * Per-node allocation design: Each node allocates ONLY its partition
- * Other nodes retrieve via SVAS (Single Virtual Address Space)
+ * Per-node partition design: Each node writes ONLY its partition
+ * Both grids are collective regions at the same address on every node
  */
 typedef struct {
-    /* Per-node partition pointers (SVAS - same addresses on all nodes) */
+    /* Per-node partition pointers (SVAS - same addresses on all nodes)
+     * In packed mode each partition holds words_per_row gol_word_t per row */
     cell_t *partitions_current[MAX_GOL_NODES];  /* Current gen partitions */
     cell_t *partitions_next[MAX_GOL_NODES];     /* Next gen partitions */
+    cell_t *grids[2];                           /* Collective regions behind them */
 
     /* Partition metadata (same on all nodes) */
     int partition_start_row[MAX_GOL_NODES];  /* Start row for each partition */
@@ -41,6 +47,12 @@ typedef struct {
     int grid_height;
     int num_nodes;            /* Total nodes */
 
+    /* Packed mode */
+    int packed;               /* Cells are bit-packed (config->packed) */
+    int words_per_row;        /* gol_word_t per row in packed mode */
+    gol_word_t *halo_above;   /* Local copy of the row above our partition */
+    gol_word_t *halo_below;   /* Local copy of the row below our partition */
+
     /* DSM synchronization primitives */
     dsm_lock_t *display_lock; /* Lock for terminal output */
 
@@ -76,20 +88,12 @@ void gol_state_cleanup(gol_state_t *state);
 void gol_calculate_partition(gol_state_t *state);
 
 /**
- * @brief Allocate this node's partition in DSM
- * Per-node allocation: EACH node allocates its own partition
+ * @brief Allocate every node's partition of both grids in DSM
+ * Collective: EACH node calls it, and node n owns the n-th partition
  * @param state State structure
  * @return DSM_SUCCESS on success, error code otherwise
  */
-int gol_allocate_partition(gol_state_t *state);
-
-/**
- * @brief Retrieve other nodes' partitions via SVAS
- * After allocation, retrieve pointers to other nodes' partitions
- * @param state State structure
- * @return DSM_SUCCESS on success, error code otherwise
- */
-int gol_retrieve_partitions(gol_state_t *state);
+int gol_allocate_partitions(gol_state_t *state);
 
 /**
  * @brief Get cell address for any (row, col) in the grid
@@ -102,6 +106,28 @@ int gol_retrieve_partitions(gol_state_t *state);
  */
 cell_t* gol_get_cell(const gol_state_t *state, int grid, int row, int col);
 
+/**
+ * @brief Get the words of a row in packed mode
+ * @param state State structure
+ * @param grid Which grid (0=current, 1=next)
+ * @param row Row index
+ * @return Pointer to the row's first word, or NULL if invalid
+ */
+gol_word_t* gol_get_row_words(const gol_state_t *state, int grid, int row);
+
+/**
+ * @brief Copy the rows bordering this node's partition into the halo buffers
+ *
+ * Both rows belong to neighbor partitions (the grid wraps). Their pages are
+ * requested with dsm_prefetch() first, so each boundary costs one batched
+ * fetch instead of a fault per access, then copied out so the kernel never
+ * touches another node's partition.
+ *
+ * @param state State structure (packed mode)
+ * @return DSM_SUCCESS on success, error code otherwise
+ */
+int gol_fetch_halo(gol_state_t *state);
+
 /**
  * @brief Set cell value for any (row, col) in the grid
  * Maps to correct partition
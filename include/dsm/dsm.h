@@ -61,6 +61,84 @@ int dsm_finalize(void);
  */
 void* dsm_malloc(size_t size);
 
+/**
+ * Allocate distributed shared memory with a compression mode and block size
+ *
+ * Like dsm_malloc(), but pages of this allocation are sent compressed as
+ * far as the mode allows (dsm_malloc() uses dsm_config_t.compression).
+ * Sparse data such as zero-filled grids benefits most; compression costs
+ * CPU time on every transfer, so dense data is better left uncompressed.
+ *
+ * block_size sets the allocation's coherence unit: the bytes fetched,
+ * protected and invalidated as one DSM page. Large blocks cut the fault
+ * count of dense sequential data (one fault brings in the whole block);
+ * small ones limit false sharing. A block of DSM_MAX_BLOCK_SIZE is backed
+ * by a huge page where the system provides them. Blocks larger than
+ * PAGE_SIZE are sent either whole or, if all zero, elided; LZ compression
+ * and batched prefetch replies apply to PAGE_SIZE blocks only.
+ *
+ * @param size Size in bytes (will be rounded up to a block boundary)
+ * @param compression Compression mode for the allocation's pages
+ * @param block_size Bytes per page: a power-of-two multiple of PAGE_SIZE
+ *                   up to DSM_MAX_BLOCK_SIZE, or 0 for PAGE_SIZE
+ * @return Pointer to allocated memory, or NULL on failure
+ */
+void* dsm_malloc_ex(size_t size, dsm_compression_t compression, size_t block_size);
+
+/**
+ * Fill allocation attributes with the defaults of dsm_malloc()
+ *
+ * dsm_config_t.compression, PAGE_SIZE blocks, and every page owned by the
+ * calling node.
+ *
+ * @param attr Attributes to initialize
+ */
+void dsm_alloc_attr_init(dsm_alloc_attr_t *attr);
+
+/**
+ * Allocate distributed shared memory with placement
+ *
+ * Like dsm_malloc_ex(), but the pages of the allocation can start out
+ * owned by other nodes (see dsm_placement_t). With DSM_PLACEMENT_BLOCK a
+ * single array is partitioned across the cluster at allocation time:
+ * node n writes the n-th run of pages without fetching them, and no
+ * allocation per node is needed. Placement spreads pages over the
+ * dsm_config_t.num_nodes nodes of the cluster; a page's owner provides
+ * its zero-filled contents on first use.
+ *
+ * @param size Size in bytes (will be rounded up to a block boundary)
+ * @param attr Allocation attributes (NULL for the dsm_malloc() defaults)
+ * @return Pointer to allocated memory, or NULL on failure (including a
+ *         home_node outside the cluster)
+ */
+void* dsm_malloc_attr(size_t size, const dsm_alloc_attr_t *attr);
+
+/**
+ * Allocate one partition per node in a single collective step
+ *
+ * Every node calls this with the same arguments, in the same order with
+ * respect to its other dsm_malloc_collective() calls. The region holds
+ * num_nodes partitions of size_per_node bytes rounded up to the block
+ * size (the stride), and node n owns the n-th one as with
+ * DSM_PLACEMENT_BLOCK. Each node derives the region's address and page
+ * IDs from the call count alone, from a virtual address window reserved
+ * at the same address on every node, so no ALLOC_NOTIFY or ALLOC_ACK is
+ * sent: the call costs one barrier whatever the number of nodes, and
+ * the window is only backed by memory where pages are touched.
+ *
+ * A node whose allocation fails still joins the barrier, so the other
+ * nodes are not held up and later collective calls stay in step.
+ *
+ * @param size_per_node Bytes of each node's partition
+ * @param attr Allocation attributes (NULL for the dsm_malloc() defaults);
+ *             placement and home_node are ignored
+ * @param stride Out: bytes between partitions, node n's starting at
+ *               base + n * stride (may be NULL)
+ * @return Base of the region, or NULL on failure (including the window
+ *         being full or not reservable)
+ */
+void* dsm_malloc_collective(size_t size_per_node, const dsm_alloc_attr_t *attr, size_t *stride);
+
 /**
  * Free DSM memory region
  *
@@ -71,6 +149,281 @@ void* dsm_malloc(size_t size);
  */
 int dsm_free(void *ptr);
 
+/**
+ * Shared-heap arena handle (opaque)
+ */
+typedef struct dsm_arena_s dsm_arena_t;
+
+/**
+ * Create an arena for many small shared objects
+ *
+ * Reserves one DSM region of size bytes, with DSM_PLACEMENT_BLOCK, and
+ * serves objects from it without further allocations: one dsm_malloc()
+ * per object would cost an ALLOC_NOTIFY round and at least one page each.
+ * Every node allocates from the run of pages it owns, so objects of
+ * different nodes never share a page and neither allocating nor freeing
+ * sends messages. Other nodes join with dsm_arena_attach().
+ *
+ * @param size Size of the region in bytes (rounded up to a page boundary)
+ * @return Arena handle, or NULL on failure
+ */
+dsm_arena_t* dsm_arena_create(size_t size);
+
+/**
+ * Join an arena created by another node
+ *
+ * @param base Base address of the arena's region, from dsm_get_allocation()
+ *             after a barrier
+ * @return Arena handle, or NULL if base is not the start of an arena region
+ */
+dsm_arena_t* dsm_arena_attach(void *base);
+
+/**
+ * Allocate an object from this node's part of an arena
+ *
+ * Objects up to 2 KB come from page-sized slabs of one power-of-two size
+ * class and are aligned to 16 bytes; larger ones take whole pages and are
+ * page aligned. Memory is not cleared: a fresh page reads as zeros, a
+ * reused object keeps its old contents.
+ *
+ * @param arena Arena handle
+ * @param size Size in bytes
+ * @return Pointer into the arena's region, or NULL if this node's part is full
+ */
+void* dsm_arena_alloc(dsm_arena_t *arena, size_t size);
+
+/**
+ * Return an object to an arena
+ *
+ * Only the node that allocated an object can free it. Other nodes may
+ * read and write it until then.
+ *
+ * @param arena Arena handle
+ * @param ptr Pointer returned by dsm_arena_alloc() on this node (NULL is ignored)
+ * @return DSM_SUCCESS, or DSM_ERROR_INVALID if ptr is not an object this
+ *         node allocated (including a double free)
+ */
+int dsm_arena_free(dsm_arena_t *arena, void *ptr);
+
+/**
+ * Destroy this node's arena handle and free the region
+ *
+ * Every node that created or attached the arena calls this, as dsm_free()
+ * is called on every node for an allocation.
+ *
+ * @param arena Arena handle
+ * @return Result of dsm_free() on the region
+ */
+int dsm_arena_destroy(dsm_arena_t *arena);
+
+/**
+ * Fetch a range of DSM pages ahead of use
+ *
+ * Pages of the range this node does not hold are requested with one
+ * PAGE_BATCH_REQUEST per owner instead of one fault round trip each, and
+ * the call waits for them to arrive. For ACCESS_WRITE the pages are then
+ * made writable as a write fault would. A prefetch is only a hint: pages
+ * that do not arrive in time are simply fetched by their next fault.
+ *
+ * @param addr Start of the range (need not be page aligned)
+ * @param len Length of the range in bytes
+ * @param access ACCESS_READ or ACCESS_WRITE
+ * @return DSM_SUCCESS, DSM_ERROR_INVALID for bad arguments, or
+ *         DSM_ERROR_NOT_FOUND if no part of the range is DSM memory
+ */
+int dsm_prefetch(void *addr, size_t len, access_type_t access);
+
+/**
+ * Completion callback of dsm_acquire_async()
+ *
+ * @param addr Start of the range, as passed to dsm_acquire_async()
+ * @param len Length of the range
+ * @param status DSM_SUCCESS once every page of the range allowed the
+ *               access, or the error that stopped the request
+ * @param arg Caller's argument
+ */
+typedef void (*dsm_async_callback_t)(void *addr, size_t len, int status, void *arg);
+
+/**
+ * Start making a range of DSM pages accessible without blocking or faulting
+ *
+ * The pages this node lacks are requested as by dsm_prefetch() and the call
+ * returns at once; a service thread follows the request, fetching pages
+ * whose prefetch did not arrive and making them writable for ACCESS_WRITE.
+ * When the whole range allows the access the request completes and the
+ * descriptor of dsm_async_fd() becomes readable; the callback then runs on
+ * the thread that calls dsm_poll(). Any number of requests may be
+ * outstanding. A completed range is accessible without a fault until
+ * another node takes one of its pages.
+ *
+ * Requests still outstanding at dsm_finalize() are dropped without their
+ * callbacks.
+ *
+ * @param addr Start of the range (need not be page aligned)
+ * @param len Length of the range in bytes
+ * @param access ACCESS_READ or ACCESS_WRITE
+ * @param callback Run by dsm_poll() on completion, may be NULL
+ * @param arg Passed to callback
+ * @return DSM_SUCCESS once the request is queued, DSM_ERROR_INVALID for bad
+ *         arguments, DSM_ERROR_NOT_FOUND if no part of the range is DSM
+ *         memory, or DSM_ERROR_MEMORY
+ */
+int dsm_acquire_async(void *addr, size_t len, access_type_t access,
+                      dsm_async_callback_t callback, void *arg);
+
+/**
+ * Run the callbacks of completed dsm_acquire_async() requests
+ * Never blocks; callbacks run on the calling thread, oldest first.
+ *
+ * @param max_completions Most callbacks to run, <= 0 for all
+ * @return Requests completed by this call, or DSM_ERROR_INIT
+ */
+int dsm_poll(int max_completions);
+
+/**
+ * Descriptor that is readable while completed requests wait for dsm_poll()
+ *
+ * An eventfd, for an event loop's epoll/poll set; it stays open until
+ * dsm_finalize() and must not be read or closed by the caller.
+ *
+ * @return File descriptor, or DSM_ERROR_INIT
+ */
+int dsm_async_fd(void);
+
+/**
+ * One-sided transfer in flight, from dsm_get_nb() or dsm_put_nb()
+ */
+typedef struct dsm_rma_s dsm_rma_t;
+
+/**
+ * Copy a range of DSM memory into a local buffer without faulting it in
+ *
+ * Bytes of pages this node holds are copied directly; the others are read
+ * at the nodes holding them, batched into one RMA_REQUEST per node, and
+ * this node's copies and page permissions stay as they were. The copy is
+ * as a memcpy() from dsm_addr at some instant of the call would see it:
+ * ordering against other nodes' writes still comes from locks and
+ * barriers.
+ *
+ * @param local_buf Destination (ordinary memory)
+ * @param dsm_addr Start of the range (need not be page aligned)
+ * @param len Length of the range in bytes
+ * @return DSM_SUCCESS, DSM_ERROR_INVALID for bad arguments, or
+ *         DSM_ERROR_NOT_FOUND if any part of the range is not DSM memory
+ */
+int dsm_get(void *local_buf, const void *dsm_addr, size_t len);
+
+/**
+ * Copy a local buffer into a range of DSM memory without faulting it in
+ *
+ * The bytes are written at the owner of each page (its home under release
+ * consistency), which invalidates other copies as a local write there
+ * would; ownership does not move to this node.
+ *
+ * @param dsm_addr Start of the range (need not be page aligned)
+ * @param local_buf Source (ordinary memory)
+ * @param len Length of the range in bytes
+ * @return As dsm_get()
+ */
+int dsm_put(void *dsm_addr, const void *local_buf, size_t len);
+
+/**
+ * Start a dsm_get() and return without waiting for remote bytes
+ *
+ * local_buf must stay valid, and must not be read, until dsm_rma_wait()
+ * or dsm_rma_test() reports completion.
+ *
+ * @param handle Output handle, completed with dsm_rma_wait() or dsm_rma_test()
+ * @return As dsm_get(); no handle is returned on error
+ */
+int dsm_get_nb(void *local_buf, const void *dsm_addr, size_t len, dsm_rma_t **handle);
+
+/**
+ * Start a dsm_put() and return without waiting for remote writes
+ *
+ * local_buf must stay valid and unchanged until completion.
+ *
+ * @param handle Output handle, completed with dsm_rma_wait() or dsm_rma_test()
+ * @return As dsm_put(); no handle is returned on error
+ */
+int dsm_put_nb(void *dsm_addr, const void *local_buf, size_t len, dsm_rma_t **handle);
+
+/**
+ * Wait for a transfer started by dsm_get_nb() or dsm_put_nb() and free it
+ *
+ * Bytes the nodes holding them did not serve in time are transferred
+ * through the fault path instead, so a transfer always completes.
+ *
+ * @param handle Transfer handle (invalid after the call)
+ * @return DSM_SUCCESS, or DSM_ERROR_INVALID for a NULL handle
+ */
+int dsm_rma_wait(dsm_rma_t *handle);
+
+/**
+ * Check whether a transfer has completed, without blocking
+ *
+ * When *done is set the transfer is finished and the handle freed, as by
+ * dsm_rma_wait().
+ *
+ * @param handle Transfer handle
+ * @param done Set to true once the transfer completed
+ * @return DSM_SUCCESS, or DSM_ERROR_INVALID for bad arguments
+ */
+int dsm_rma_test(dsm_rma_t *handle, bool *done);
+
+/**
+ * Atomically add to a word of DSM memory
+ *
+ * Executed by the node keeping the page (its owner, or home under release
+ * consistency) without moving the page, so nodes updating a shared counter
+ * do not take its page from each other. addr must be naturally aligned.
+ * An operation whose reply never arrives is not retried, so it is applied
+ * at most once.
+ *
+ * @param addr Word in DSM memory
+ * @param value Addend
+ * @param old Receives the previous value (may be NULL)
+ * @return DSM_SUCCESS, DSM_ERROR_INVALID for a misaligned address,
+ *         DSM_ERROR_NOT_FOUND outside DSM memory, DSM_ERROR_TIMEOUT if the
+ *         keeper did not reply (it may have applied the addition), or
+ *         DSM_ERROR_NETWORK if it could not be asked
+ */
+int dsm_atomic_fetch_add32(void *addr, uint32_t value, uint32_t *old);
+
+/** 64-bit dsm_atomic_fetch_add32() */
+int dsm_atomic_fetch_add64(void *addr, uint64_t value, uint64_t *old);
+
+/**
+ * Atomically replace a word of DSM memory if it holds an expected value
+ *
+ * Executed as dsm_atomic_fetch_add32().
+ *
+ * @param addr Word in DSM memory
+ * @param expected Value to compare with
+ * @param desired Value stored if the word equals expected
+ * @param old Receives the previous value; the swap happened if it equals expected
+ * @return As dsm_atomic_fetch_add32()
+ */
+int dsm_atomic_cas32(void *addr, uint32_t expected, uint32_t desired, uint32_t *old);
+
+/** 64-bit dsm_atomic_cas32() */
+int dsm_atomic_cas64(void *addr, uint64_t expected, uint64_t desired, uint64_t *old);
+
+/**
+ * Atomically store a word of DSM memory and return its previous value
+ *
+ * Executed as dsm_atomic_fetch_add32().
+ *
+ * @param addr Word in DSM memory
+ * @param value Value to store
+ * @param old Receives the previous value (may be NULL)
+ * @return As dsm_atomic_fetch_add32()
+ */
+int dsm_atomic_swap32(void *addr, uint32_t value, uint32_t *old);
+
+/** 64-bit dsm_atomic_swap32() */
+int dsm_atomic_swap64(void *addr, uint64_t value, uint64_t *old);
+
 /**
  * Get the base address of a DSM allocation by index
  *
@@ -97,6 +450,34 @@ node_id_t dsm_get_node_id(void);
  */
 int dsm_get_num_nodes(void);
 
+/**
+ * Get the fault engine in use
+ *
+ * @return DSM_FAULT_USERFAULTFD if it was requested and the kernel offers
+ *         it, DSM_FAULT_SIGSEGV otherwise
+ */
+dsm_fault_engine_t dsm_get_fault_engine(void);
+
+/**
+ * Get the transport in use
+ *
+ * @return DSM_TRANSPORT_RDMA if it was requested and an RDMA device was
+ *         opened, DSM_TRANSPORT_TCP otherwise. Each peer connection
+ *         moves to RDMA once both ends agree and stays on TCP if not.
+ */
+dsm_transport_t dsm_get_transport(void);
+
+/**
+ * Get the transport frames to and from a peer travel over
+ *
+ * @param node Peer node ID
+ * @return DSM_TRANSPORT_SHM for a peer on the same host (unless
+ *         disable_shm is set), DSM_TRANSPORT_RDMA for a peer reached
+ *         over RDMA, DSM_TRANSPORT_TCP otherwise or while the peer's
+ *         handshake is still in progress
+ */
+dsm_transport_t dsm_get_peer_transport(node_id_t node);
+
 /* ============================ */
 /*     Synchronization          */
 /* ============================ */
@@ -133,12 +514,34 @@ int dsm_lock_acquire(dsm_lock_t *lock);
  *
  * Releases the lock, allowing another node to acquire it.
  * Must be called by the node that currently holds the lock.
+ * Under release consistency an error means writes made while holding it
+ * did not reach their homes; the lock is released all the same.
  *
  * @param lock Lock handle
  * @return DSM_SUCCESS on success, error code on failure
  */
 int dsm_lock_release(dsm_lock_t *lock);
 
+/**
+ * Bind a DSM range to a lock
+ *
+ * Declares that the lock protects the range (entry consistency). An
+ * acquire that receives the lock from another node fetches the bound
+ * pages it does not hold before returning, with one PAGE_BATCH_REQUEST per
+ * owner, so the critical section does not fault on each of them in turn.
+ * Re-acquiring a lock this node released last fetches nothing. The
+ * binding is only a hint: data outside bound ranges stays coherent, and
+ * a range freed later is skipped. Each node binds its own handle.
+ *
+ * @param lock Lock handle
+ * @param addr Start of the range (need not be page aligned)
+ * @param len Length of the range in bytes
+ * @return DSM_SUCCESS, DSM_ERROR_INVALID for bad arguments,
+ *         DSM_ERROR_NOT_FOUND if addr is not DSM memory, or
+ *         DSM_ERROR_MEMORY if the lock already has 8 bound ranges
+ */
+int dsm_lock_bind(dsm_lock_t *lock, void *addr, size_t len);
+
 /**
  * Destroy a distributed lock
  *
@@ -150,11 +553,74 @@ int dsm_lock_release(dsm_lock_t *lock);
  */
 int dsm_lock_destroy(dsm_lock_t *lock);
 
+/**
+ * Distributed reader-writer lock handle (opaque)
+ */
+typedef struct dsm_rwlock_s dsm_rwlock_t;
+
+/**
+ * Create a distributed reader-writer lock
+ *
+ * Readers on any number of nodes may hold the lock at once; a writer
+ * holds it alone. Lock IDs are shared with dsm_lock_create(), so a
+ * reader-writer lock needs an ID no mutex uses. All nodes must create the
+ * same lock with the same ID.
+ *
+ * @param lock_id Unique lock identifier (must be same across nodes)
+ * @return Lock handle, or NULL on failure
+ */
+dsm_rwlock_t* dsm_rwlock_create(lock_id_t lock_id);
+
+/**
+ * Acquire a reader-writer lock for reading
+ *
+ * Blocks while a writer holds the lock or waits for it. Readers queued
+ * behind a writer are all admitted together once it releases. A node
+ * keeps its shared token after release, so reading again takes no
+ * messages until a writer asks for the lock.
+ *
+ * @param rwlock Lock handle from dsm_rwlock_create
+ * @return DSM_SUCCESS on success, error code on failure
+ */
+int dsm_rwlock_rdlock(dsm_rwlock_t *rwlock);
+
+/**
+ * Acquire a reader-writer lock for writing
+ *
+ * Blocks until no other thread of any node holds the lock.
+ *
+ * @param rwlock Lock handle from dsm_rwlock_create
+ * @return DSM_SUCCESS on success, error code on failure
+ */
+int dsm_rwlock_wrlock(dsm_rwlock_t *rwlock);
+
+/**
+ * Release a reader-writer lock held for reading or writing
+ *
+ * @param rwlock Lock handle
+ * @return DSM_SUCCESS, DSM_ERROR_PERMISSION if no thread of this node
+ *         holds the lock, or the error of a lost diff as for
+ *         dsm_lock_release()
+ */
+int dsm_rwlock_unlock(dsm_rwlock_t *rwlock);
+
+/**
+ * Destroy a reader-writer lock
+ *
+ * @param rwlock Lock handle
+ * @return DSM_SUCCESS on success, error code on failure
+ */
+int dsm_rwlock_destroy(dsm_rwlock_t *rwlock);
+
 /**
  * Distributed barrier synchronization
  *
  * Blocks until all participating nodes have reached the barrier.
  * All nodes must call with the same barrier_id and num_participants.
+ * DSM_BARRIER_COLLECTIVE is reserved for dsm_malloc_collective() and
+ * DSM_BARRIER_REDUCE for dsm_allreduce(), dsm_reduce() and dsm_broadcast().
+ * Under release consistency an error may also mean this node's writes did
+ * not reach their homes; the barrier completes all the same.
  *
  * @param barrier_id Unique barrier identifier
  * @param num_participants Number of nodes that must arrive
@@ -162,6 +628,75 @@ int dsm_lock_destroy(dsm_lock_t *lock);
  */
 int dsm_barrier(barrier_id_t barrier_id, int num_participants);
 
+/**
+ * Combine a buffer element-wise across all nodes and give every node the result
+ *
+ * A collective episode of DSM_BARRIER_REDUCE: each node's contribution
+ * travels with its barrier arrival, the manager combines them as they
+ * arrive and the release returns the result, so no DSM page is touched.
+ * Every node must make the same collective calls in the same order, one
+ * thread per node, with the same count, type and op. Like dsm_barrier(),
+ * the call is a release and acquire under release consistency.
+ * Floating-point results depend on the order contributions arrive in,
+ * but every node gets the same bits.
+ *
+ * @param buf count elements: this node's contribution in, the result out
+ * @param count Elements in buf (at most DSM_COLLECTIVE_MAX_BYTES in total)
+ * @param type Element type
+ * @param op Combining operation
+ * @return DSM_SUCCESS, DSM_ERROR_INVALID for bad arguments or nodes that
+ *         disagree on them, or DSM_ERROR_TIMEOUT as dsm_barrier()
+ */
+int dsm_allreduce(void *buf, size_t count, dsm_datatype_t type, dsm_reduce_op_t op);
+
+/**
+ * dsm_allreduce() whose result only root receives
+ * Other nodes' buffers are left as they were.
+ *
+ * @param root Node that receives the result
+ * @return As dsm_allreduce(), DSM_ERROR_INVALID also for a root outside the cluster
+ */
+int dsm_reduce(void *buf, size_t count, dsm_datatype_t type, dsm_reduce_op_t op, node_id_t root);
+
+/**
+ * Copy root's buffer to every node
+ *
+ * Run as dsm_allreduce(): root's bytes travel with its barrier arrival
+ * and every other node's release.
+ *
+ * @param buf len bytes: the data on root, overwritten with it elsewhere
+ * @param len Bytes (at most DSM_COLLECTIVE_MAX_BYTES)
+ * @param root Node whose buffer is copied
+ * @return As dsm_reduce()
+ */
+int dsm_broadcast(void *buf, size_t len, node_id_t root);
+
+/* ============================ */
+/*     Checkpoint / Restart     */
+/* ============================ */
+
+/**
+ * Write a coordinated checkpoint of the shared address space
+ *
+ * Collective: every node calls it, from one thread, while no other thread
+ * touches DSM memory. The nodes meet at a barrier, then each writes the
+ * blocks it is responsible for (owned under sequential consistency, homed
+ * under release consistency) with its page table, and the manager its
+ * directory, to one snapshot file per node in dir. The previous
+ * checkpoint in dir is replaced only once the new file is complete.
+ *
+ * To restart, start the same number of nodes with the same IDs and
+ * dsm_config_t.restore_path set to dir: dsm_init() maps every allocation
+ * at its old address, and dsm_get_allocation() returns them in their old
+ * order. Restored blocks are read from the snapshot when first touched.
+ * Locks, barriers and arena handles are not saved.
+ *
+ * @param dir Checkpoint directory, created if missing (shared or per node)
+ * @return DSM_SUCCESS once every node has written its snapshot, or the
+ *         first error of any node (then all return it)
+ */
+int dsm_checkpoint(const char *dir);
+
 /* ============================ */
 /*     Statistics & Debugging   */
 /* ============================ */
@@ -185,6 +720,29 @@ int dsm_get_stats(dsm_stats_t *stats);
  */
 int dsm_reset_stats(void);
 
+/**
+ * Get the fault latency histogram for one fault path
+ *
+ * Faults are recorded by the SIGSEGV handler from entry to permission
+ * upgrade. dsm_reset_stats() clears the histograms as well.
+ *
+ * @param path Fault path (DSM_FAULT_PATH_ALL for every fault)
+ * @param hist Histogram to fill, including p50/p90/p99/p999
+ * @return DSM_SUCCESS on success, DSM_ERROR_INVALID for a bad path or NULL hist
+ */
+int dsm_get_latency_histogram(dsm_fault_path_t path, dsm_latency_histogram_t *hist);
+
+/**
+ * Get the traffic counters for one peer
+ *
+ * dsm_reset_stats() clears these as well.
+ *
+ * @param peer Peer node ID (below DSM_MAX_PEER_STATS)
+ * @param out Counters to fill
+ * @return DSM_SUCCESS, or DSM_ERROR_INVALID for a bad peer or NULL out
+ */
+int dsm_get_peer_stats(node_id_t peer, dsm_peer_stats_t *out);
+
 /**
  * Print statistics to stdout
  *
@@ -208,7 +766,9 @@ void dsm_set_log_level(int level);
 /**
  * Initialize performance logging (Task 8.6)
  *
- * Enables detailed performance tracking and CSV logging.
+ * Enables detailed performance tracking and CSV logging. Events are
+ * recorded to a binary trace ("<log_file>.trace") and written to log_file
+ * as CSV by dsm_finalize().
  *
  * @param log_file Path to CSV log file (NULL to disable file logging)
  * @return DSM_SUCCESS on success, error code on failure
@@ -0,0 +1,98 @@
+/**
+ * @file metrics.h
+ * @brief Layout and reader of the live metrics page
+ *
+ * With dsm_config_t.metrics_path set, each node maps that file and copies
+ * its statistics, fault latency histograms and per-peer traffic counters
+ * into it every metrics_interval_ms. Monitoring tools map the same file
+ * read-only and take consistent snapshots with dsm_metrics_read(): the
+ * page is guarded by a sequence lock, so readers never block the node and
+ * need no calls into it. This header only depends on dsm/types.h and does
+ * not require linking libdsm.
+ *
+ * The header fields give the offset of each section, and counter_names
+ * lists the dsm_stats_t fields in order, so tools in other languages can
+ * decode the page without this header. All fields are native-endian.
+ */
+
+#ifndef DSM_METRICS_H
+#define DSM_METRICS_H
+
+#include "dsm/types.h"
+#include <stdint.h>
+#include <string.h>
+
+/** "DSMMETRC" in the first 8 bytes of a little-endian page */
+#define DSM_METRICS_MAGIC 0x435254454d4d5344ULL
+
+/** Bumped when the layout changes */
+#define DSM_METRICS_VERSION 1
+
+/** Bytes of the counter name list */
+#define DSM_METRICS_NAMES_BYTES 2048
+
+/** Bytes of the fault path name list */
+#define DSM_METRICS_PATH_NAMES_BYTES 128
+
+/** Attempts dsm_metrics_read() makes before giving up on a busy page */
+#define DSM_METRICS_READ_TRIES 100
+
+/**
+ * Live metrics page
+ *
+ * seq is odd while the node writes a snapshot and is incremented again
+ * when it is done; a copy taken between two equal, even reads of seq is
+ * consistent.
+ */
+typedef struct {
+    uint64_t magic;                  /**< DSM_METRICS_MAGIC */
+    uint32_t version;                /**< DSM_METRICS_VERSION */
+    uint32_t size;                   /**< sizeof(dsm_metrics_page_t) */
+    uint64_t seq;                    /**< Sequence lock */
+    uint64_t publish_time_ns;        /**< CLOCK_REALTIME of the snapshot */
+    uint64_t publishes;              /**< Snapshots written so far */
+    uint32_t node_id;                /**< Publishing node */
+    uint32_t pid;                    /**< Publishing process */
+    uint32_t interval_ms;            /**< Publish interval */
+    uint32_t num_counters;           /**< uint64_t counters in stats */
+    uint32_t num_paths;              /**< Entries of histograms (DSM_FAULT_PATH_COUNT) */
+    uint32_t num_buckets;            /**< Buckets per histogram (DSM_LATENCY_BUCKETS) */
+    uint32_t num_peers;              /**< Entries of peers in use */
+    uint32_t stats_offset;           /**< offsetof(dsm_metrics_page_t, stats) */
+    uint32_t histograms_offset;      /**< offsetof(dsm_metrics_page_t, histograms) */
+    uint32_t peers_offset;           /**< offsetof(dsm_metrics_page_t, peers) */
+    char counter_names[DSM_METRICS_NAMES_BYTES];  /**< '\n'-terminated dsm_stats_t field names */
+    char path_names[DSM_METRICS_PATH_NAMES_BYTES]; /**< '\n'-terminated fault path names */
+    dsm_stats_t stats;               /**< Node totals, as dsm_get_stats() */
+    dsm_latency_histogram_t histograms[DSM_FAULT_PATH_COUNT]; /**< Indexed by dsm_fault_path_t */
+    dsm_peer_stats_t peers[DSM_MAX_PEER_STATS]; /**< Indexed by peer node ID */
+} dsm_metrics_page_t;
+
+/**
+ * Take a consistent snapshot of a mapped metrics page
+ *
+ * @param page Mapped page (read-only mapping is enough)
+ * @param out Output copy
+ * @return 0, -1 if the page is not a metrics page of this version, or
+ *         -2 if every attempt overlapped a write
+ */
+static inline int dsm_metrics_read(const dsm_metrics_page_t *page, dsm_metrics_page_t *out) {
+    for (int tries = 0; tries < DSM_METRICS_READ_TRIES; tries++) {
+        uint64_t seq = __atomic_load_n(&page->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            continue;
+        }
+        memcpy(out, page, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&page->seq, __ATOMIC_RELAXED) == seq) {
+            if (out->magic != DSM_METRICS_MAGIC || out->version != DSM_METRICS_VERSION ||
+                out->size != sizeof(*out)) {
+                return -1;
+            }
+            return 0;
+        }
+    }
+    return -2;
+}
+
+#endif /* DSM_METRICS_H */
@@ -20,9 +20,20 @@
 /** Page size (4KB - standard) */
 #define PAGE_SIZE 4096
 
-/** Maximum number of nodes in the cluster */
+/** Largest coherence block of one allocation (see dsm_malloc_ex()); blocks
+ *  of this size are backed by 2MB huge pages where the system has them */
+#define DSM_MAX_BLOCK_SIZE (2 * 1024 * 1024)
+
+/** Default node table capacity (used when dsm_config_t.max_nodes is 0) */
 #define MAX_NODES 16
 
+/** Most node IDs one message can list (sharers, lock waiters); also the
+ *  largest supported node table capacity */
+#define MAX_SHARERS 1024
+
+/** Most TCP connections to one peer (dsm_config_t.tcp_lanes) */
+#define MAX_TCP_LANES 8
+
 /** Maximum hostname length */
 #define MAX_HOSTNAME_LEN 256
 
@@ -33,6 +44,9 @@
 /** Node identifier type */
 typedef uint32_t node_id_t;
 
+/** No node (e.g. the owner of a first-touch page nobody has touched) */
+#define DSM_NODE_NONE ((node_id_t)-1)
+
 /** Page identifier type */
 typedef uint64_t page_id_t;
 
@@ -42,6 +56,18 @@ typedef uint64_t lock_id_t;
 /** Barrier identifier type */
 typedef uint64_t barrier_id_t;
 
+/** Barrier ID used by dsm_malloc_collective() */
+#define DSM_BARRIER_COLLECTIVE ((barrier_id_t)-1)
+
+/** Barrier ID used by dsm_allreduce(), dsm_reduce() and dsm_broadcast() */
+#define DSM_BARRIER_REDUCE ((barrier_id_t)-2)
+
+/** Barrier ID used by dsm_checkpoint() */
+#define DSM_BARRIER_CHECKPOINT ((barrier_id_t)-3)
+
+/** Most bytes one dsm_allreduce(), dsm_reduce() or dsm_broadcast() moves */
+#define DSM_COLLECTIVE_MAX_BYTES (64 * 1024)
+
 /* ============================ */
 /*     Page States              */
 /* ============================ */
@@ -95,9 +121,157 @@ typedef enum {
  */
 typedef enum {
     LOCK_STATE_FREE = 0,      /**< Lock is free */
-    LOCK_STATE_HELD           /**< Lock is held by a node */
+    LOCK_STATE_HELD,          /**< Lock is held by a node */
+    LOCK_STATE_SHARED         /**< Lock is held by readers (dsm_rwlock_t) */
 } lock_state_t;
 
+/* ============================ */
+/*     Consistency Models       */
+/* ============================ */
+
+/**
+ * Memory consistency model (must be the same on every node)
+ */
+typedef enum {
+    DSM_CONSISTENCY_SEQUENTIAL = 0, /**< Single writer, invalidate on write (default) */
+    DSM_CONSISTENCY_RELEASE         /**< Multiple writers, twins and diffs at release */
+} dsm_consistency_t;
+
+/* ============================ */
+/*     Page Compression         */
+/* ============================ */
+
+/**
+ * How pages of an allocation may be compressed in PAGE_REPLY
+ * Each mode includes the ones before it.
+ */
+typedef enum {
+    DSM_COMPRESSION_NONE = 0, /**< Pages always sent raw (default) */
+    DSM_COMPRESSION_ZERO,     /**< Zero-filled pages sent without data */
+    DSM_COMPRESSION_LZ        /**< Also LZ-compress pages when it saves enough */
+} dsm_compression_t;
+
+/* ============================ */
+/*     Page Placement           */
+/* ============================ */
+
+/**
+ * Which node initially owns each page of an allocation
+ *
+ * The owner (under release consistency, the home) of a page serves it
+ * and, until another node writes it, is the only node that touches it
+ * without a fetch. Placement is fixed when the allocation is made and
+ * computed the same way on every node; pages still migrate afterwards
+ * as the consistency protocol moves them.
+ */
+typedef enum {
+    DSM_PLACEMENT_LOCAL = 0,    /**< Every page owned by the allocating node (default) */
+    DSM_PLACEMENT_BLOCK,        /**< Contiguous runs of pages: node n owns the n-th of num_nodes runs */
+    DSM_PLACEMENT_CYCLIC,       /**< Page i owned by node i % num_nodes */
+    DSM_PLACEMENT_FIRST_TOUCH,  /**< Each page owned by the first node to fault on it */
+    DSM_PLACEMENT_HOME          /**< Every page owned by dsm_alloc_attr_t.home_node */
+} dsm_placement_t;
+
+/* ============================ */
+/*     Collectives              */
+/* ============================ */
+
+/**
+ * Element type of a dsm_allreduce() or dsm_reduce() buffer
+ */
+typedef enum {
+    DSM_TYPE_INT32 = 0,       /**< int32_t */
+    DSM_TYPE_INT64,           /**< int64_t */
+    DSM_TYPE_UINT32,          /**< uint32_t */
+    DSM_TYPE_UINT64,          /**< uint64_t */
+    DSM_TYPE_FLOAT,           /**< float */
+    DSM_TYPE_DOUBLE           /**< double */
+} dsm_datatype_t;
+
+/**
+ * Element-wise combining operation of a reduction
+ */
+typedef enum {
+    DSM_REDUCE_SUM = 0,       /**< Sum */
+    DSM_REDUCE_PROD,          /**< Product */
+    DSM_REDUCE_MIN,           /**< Minimum */
+    DSM_REDUCE_MAX            /**< Maximum */
+} dsm_reduce_op_t;
+
+/* ============================ */
+/*     Fault Engine             */
+/* ============================ */
+
+/**
+ * How accesses to pages this node may not touch reach the protocol
+ */
+typedef enum {
+    DSM_FAULT_SIGSEGV = 0,    /**< mprotect() page permissions and a SIGSEGV handler (default) */
+    DSM_FAULT_USERFAULTFD     /**< Linux userfaultfd served by fault threads (SIGSEGV if unavailable) */
+} dsm_fault_engine_t;
+
+/* ============================ */
+/*     Transport                */
+/* ============================ */
+
+/**
+ * How frames travel between nodes once connected
+ */
+typedef enum {
+    DSM_TRANSPORT_TCP = 0,    /**< TCP sockets only (default) */
+    DSM_TRANSPORT_RDMA,       /**< RC queue pairs on an RDMA device, page data by RDMA WRITE (TCP if unavailable) */
+    DSM_TRANSPORT_SHM,        /**< Shared-memory rings; chosen automatically for peers on the same host */
+    DSM_TRANSPORT_COUNT
+} dsm_transport_t;
+
+/* ============================ */
+/*     Replication              */
+/* ============================ */
+
+/**
+ * When the manager's directory, lock and barrier changes must have been
+ * shipped to the hot backup (node 1)
+ */
+typedef enum {
+    DSM_REPLICATION_BEFORE_REPLY = 0, /**< Before the manager sends any other message (default) */
+    DSM_REPLICATION_ASYNC             /**< In the background; a manager crash loses the last few ms */
+} dsm_replication_t;
+
+/* ============================ */
+/*     Directory                */
+/* ============================ */
+
+/**
+ * Where the owner and sharers of each page are tracked
+ */
+typedef enum {
+    DSM_DIRECTORY_CENTRAL = 0,        /**< On the manager, replicated to the hot backup (default) */
+    DSM_DIRECTORY_DISTRIBUTED         /**< On a home node per page, derived from its page ID */
+} dsm_directory_t;
+
+/**
+ * Attributes of a DSM allocation, for dsm_malloc_attr()
+ * Initialize with dsm_alloc_attr_init() so unset fields keep their defaults.
+ */
+typedef struct {
+    dsm_compression_t compression;   /**< How pages are compressed in PAGE_REPLY */
+    size_t block_size;               /**< Bytes per coherence block (0 = PAGE_SIZE) */
+    dsm_placement_t placement;       /**< Initial page owners */
+    node_id_t home_node;             /**< Owner of every page for DSM_PLACEMENT_HOME */
+} dsm_alloc_attr_t;
+
+/* ============================ */
+/*     Barriers                 */
+/* ============================ */
+
+/**
+ * How dsm_barrier() synchronizes the whole cluster
+ */
+typedef enum {
+    DSM_BARRIER_CENTRAL = 0,       /**< Every node arrives at the manager, which releases all (default) */
+    DSM_BARRIER_DISSEMINATION      /**< ceil(log2 N) rounds of signals between the nodes themselves */
+} dsm_barrier_algorithm_t;
+
 /* ============================ */
 /*     Return Codes             */
 /* ============================ */
@@ -132,6 +306,30 @@ typedef struct {
     int num_nodes;                   /**< Total nodes in cluster */
     bool is_manager;                 /**< True if this is manager node */
     int log_level;                   /**< Logging verbosity (0-4) */
+    bool log_async;                  /**< Format log lines on a background thread */
+    int num_handler_threads;         /**< Message handler pool size (0 = handle on dispatcher thread) */
+    int max_nodes;                   /**< Node table capacity (0 = max(num_nodes, MAX_NODES)) */
+    dsm_barrier_algorithm_t barrier_algorithm; /**< Algorithm of whole-cluster barriers (0 = central); every node must pass the same */
+    dsm_consistency_t consistency;   /**< Consistency model (0 = sequential) */
+    dsm_compression_t compression;   /**< Page compression for dsm_malloc() (0 = none) */
+    int prefetch_depth;              /**< Pages the fault prefetcher fetches ahead of a stream (0 = off) */
+    dsm_fault_engine_t fault_engine; /**< How page faults are caught (0 = SIGSEGV) */
+    int num_fault_threads;           /**< userfaultfd fault threads (0 = default) */
+    dsm_transport_t transport;       /**< Transport for peer traffic (0 = TCP) */
+    bool disable_shm;                /**< Keep co-located peers off shared memory */
+    int tcp_lanes;                   /**< TCP connections per peer that stays on TCP (0 = 1, max MAX_TCP_LANES) */
+    int socket_buffer_size;          /**< SO_SNDBUF/SO_RCVBUF of peer sockets in bytes (0 = kernel default) */
+    int busy_poll_us;                /**< SO_BUSY_POLL time of peer sockets in microseconds (0 = off) */
+    dsm_replication_t replication;   /**< Durability point of hot-backup replication (0 = before reply) */
+    dsm_directory_t directory;       /**< Where page ownership is tracked (0 = manager); every node must pass the same */
+    int heartbeat_ms;                /**< Liveness interval in milliseconds (0 = 2000); heartbeats only go to idle peers */
+    bool adaptive;                   /**< Adapt grants to observed access patterns (sequential consistency only) */
+    int sharing_profile_pages;       /**< Pages the false-sharing profiler tracks (0 = off) */
+    const char *metrics_path;        /**< File the live metrics page is mapped to (NULL = off) */
+    int metrics_port;                /**< Port of the Prometheus /metrics endpoint (0 = off) */
+    const char *metrics_bind;        /**< IPv4 address the endpoint listens on (NULL = 127.0.0.1, "0.0.0.0" = all) */
+    int metrics_interval_ms;         /**< Metrics publish interval in milliseconds (0 = 1000) */
+    const char *restore_path;        /**< dsm_checkpoint() directory to restart from (NULL = start empty) */
 } dsm_config_t;
 
 /* ============================ */
@@ -147,6 +345,9 @@ typedef struct {
     uint64_t write_faults;           /**< Write faults */
     uint64_t pages_fetched;          /**< Pages fetched from remote */
     uint64_t pages_sent;             /**< Pages sent to remote */
+    uint64_t page_data_skipped;      /**< Grants sent without data (requester's copy current) */
+    uint64_t pages_compressed;       /**< Pages sent zero-elided or LZ-compressed */
+    uint64_t compression_bytes_saved;/**< Page bytes not sent thanks to compression */
     uint64_t invalidations_sent;     /**< Invalidations sent */
     uint64_t invalidations_received; /**< Invalidations received */
     uint64_t network_bytes_sent;     /**< Total bytes sent */
@@ -159,10 +360,126 @@ typedef struct {
     uint64_t max_fault_latency_ns;   /**< Maximum fault latency */
     uint64_t min_fault_latency_ns;   /**< Minimum fault latency */
     uint64_t queued_requests;        /**< Number of queued page requests */
+    uint64_t requests_forwarded;     /**< PAGE_REQUESTs this directory node passed on to the page's owner */
     uint64_t false_sharing_events;   /**< Potential false sharing detections */
     uint64_t network_retries;        /**< Network send retries */
     uint64_t network_failures;       /**< Network failures after retries */
     uint64_t timeouts;               /**< Request timeouts */
+
+    /* Release consistency (DSM_CONSISTENCY_RELEASE) */
+    uint64_t twins_created;          /**< Twins made on first write to a page */
+    uint64_t diffs_sent;             /**< Diff messages sent to home nodes */
+    uint64_t diff_bytes_sent;        /**< Changed bytes carried by those diffs */
+    uint64_t diffs_applied;          /**< Diff messages applied as home node */
+    uint64_t write_notices_sent;     /**< Written pages reported with barrier arrivals */
+    uint64_t notice_invalidations;   /**< Cached copies dropped at barrier exit by a write notice */
+
+    /* Prefetch (dsm_prefetch() and the fault prefetcher) */
+    uint64_t prefetch_requests;      /**< PAGE_BATCH_REQUESTs sent */
+    uint64_t pages_prefetched;       /**< Pages installed by a prefetch */
+    uint64_t prefetch_hits;          /**< Faults served by a prefetch already in flight */
+    uint64_t async_acquires;         /**< dsm_acquire_async() requests queued */
+
+    /* Lock tokens (dsm_lock_acquire()) */
+    uint64_t lock_cached_acquires;   /**< Acquires served by a cached token, without messages */
+    uint64_t lock_recalls;           /**< Cached tokens recalled by the manager for another node */
+    uint64_t lock_shared_acquires;   /**< Read acquires of a dsm_rwlock_t (also in lock_acquires) */
+
+    /* Permission batches (release, acquire and barrier invalidation) */
+    uint64_t batched_pages;          /**< Pages whose protection changed in a batch */
+    uint64_t batched_mprotects;      /**< mprotect() calls those batches took */
+
+    /* Startup */
+    uint64_t bootstrap_ns;           /**< Time dsm_init() took, cluster bring-up included */
+    uint64_t peer_links_opened;      /**< Direct links opened to other workers on first use */
+    /* Failure detection */
+    uint64_t heartbeats_sent;        /**< HEARTBEATs sent to peers we had nothing else to send */
+    uint64_t probe_requests_sent;    /**< PROBE_REQUESTs asking other nodes to probe a silent peer */
+    uint64_t probe_acks_received;    /**< Silent peers an indirect probe found alive */
+
+    /* Adaptive protocol (dsm_config_t.adaptive) */
+    uint64_t adaptive_migrations;    /**< Read faults that took ownership for the page's dominant writer */
+    uint64_t adaptive_replicas;      /**< Invalidated read-mostly pages fetched again at a barrier */
+    uint64_t pingpong_freezes;       /**< Pages frozen for moving between writers too often */
+
+    /* One-sided transfers (dsm_get() / dsm_put() / dsm_atomic_*()) */
+    uint64_t rma_requests;           /**< RMA_REQUESTs sent */
+    uint64_t rma_bytes;              /**< Bytes moved by dsm_get() and dsm_put(), local or remote */
+    uint64_t rma_segments_served;    /**< Segments of other nodes' requests served here */
+    uint64_t rma_fallbacks;          /**< Segments completed through the fault path */
+    uint64_t atomic_ops;             /**< dsm_atomic_*() calls completed, local or remote */
+
+    /* Collectives (dsm_allreduce() / dsm_reduce() / dsm_broadcast()) */
+    uint64_t collectives;            /**< Collective calls completed */
+    uint64_t collective_bytes;       /**< Bytes contributed to or received from collectives */
 } dsm_stats_t;
 
+/** Peers with traffic counters in dsm_get_peer_stats() (higher node IDs are not counted) */
+#define DSM_MAX_PEER_STATS 64
+
+/**
+ * Traffic exchanged with one peer
+ *
+ * Frames are counted as written to or read from the peer's connection,
+ * so forwarded requests count on each hop and coalesced messages count
+ * once each.
+ */
+typedef struct {
+    uint64_t frames_sent;            /**< Frames written to the peer */
+    uint64_t bytes_sent;             /**< Bytes of those frames, length prefixes included */
+    uint64_t frames_received;        /**< Frames read from the peer */
+    uint64_t bytes_received;         /**< Bytes of those frames, length prefixes included */
+} dsm_peer_stats_t;
+
+/* ============================ */
+/*   Fault Latency Histograms   */
+/* ============================ */
+
+/**
+ * Fault path a latency histogram covers
+ *
+ * Every fault is counted in DSM_FAULT_PATH_ALL, in READ or WRITE and in
+ * LOCAL_UPGRADE or REMOTE_FETCH. Remote fetches are further split into
+ * QUEUED (waited on another thread's fetch of the same page) or LEADER,
+ * and into FORWARDED (routed through the manager) or DIRECT.
+ */
+typedef enum {
+    DSM_FAULT_PATH_ALL = 0,          /**< All faults */
+    DSM_FAULT_PATH_READ,             /**< Read faults */
+    DSM_FAULT_PATH_WRITE,            /**< Write faults */
+    DSM_FAULT_PATH_LOCAL_UPGRADE,    /**< Already owner, permission upgrade only */
+    DSM_FAULT_PATH_REMOTE_FETCH,     /**< Page fetched from another node */
+    DSM_FAULT_PATH_QUEUED,           /**< Remote: queued behind another thread */
+    DSM_FAULT_PATH_LEADER,           /**< Remote: this thread sent the request */
+    DSM_FAULT_PATH_FORWARDED,        /**< Remote: routed through the manager */
+    DSM_FAULT_PATH_DIRECT,           /**< Remote: sent straight to the owner */
+    DSM_FAULT_PATH_COUNT
+} dsm_fault_path_t;
+
+/** Linear sub-buckets per power of two (log2); bounds bucket error to 1/16 */
+#define DSM_LATENCY_SUB_BITS 4
+
+/** Histogram buckets: exact below 16ns, log-linear up to 2^36ns (~69s) */
+#define DSM_LATENCY_BUCKETS ((36 - DSM_LATENCY_SUB_BITS + 1) << DSM_LATENCY_SUB_BITS)
+
+/**
+ * Log-bucketed fault latency histogram
+ *
+ * Bucket i < 16 holds latency i ns. Above that, bucket i covers
+ * [(16 + i % 16) << (i / 16 - 1), (17 + i % 16) << (i / 16 - 1)) ns; the
+ * last bucket also holds everything longer. Percentiles report the upper
+ * edge of the bucket they fall in, capped at max_ns.
+ */
+typedef struct {
+    uint64_t count;                  /**< Faults recorded */
+    uint64_t total_ns;               /**< Sum of latencies */
+    uint64_t min_ns;                 /**< Minimum latency (0 if count == 0) */
+    uint64_t max_ns;                 /**< Maximum latency */
+    uint64_t p50_ns;                 /**< Median */
+    uint64_t p90_ns;                 /**< 90th percentile */
+    uint64_t p99_ns;                 /**< 99th percentile */
+    uint64_t p999_ns;                /**< 99.9th percentile */
+    uint64_t buckets[DSM_LATENCY_BUCKETS]; /**< Per-bucket fault counts */
+} dsm_latency_histogram_t;
+
 #endif /* DSM_TYPES_H */
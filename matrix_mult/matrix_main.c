@@ -24,6 +24,9 @@ void print_usage(const char *prog) {
     printf("  Worker:  %s --worker --node-id <ID> --manager-host <HOST> --size <M>\n", prog);
     printf("\nOptions:\n");
     printf("  --size <M>  : Matrix dimension (default: 100)\n");
+    printf("  --block-size <B> : Coherence block size in bytes (default: page size)\n");
+    printf("  --kernel <K> : naive or tiled (default: tiled)\n");
+    printf("  --no-prefetch : Fault pages in on access instead of prefetching them\n");
     printf("  --verify    : Enable verification\n");
     printf("  --sample    : Print sample results\n\n");
 }
@@ -41,6 +44,9 @@ int main(int argc, char *argv[]) {
     int N = 100;
     int enable_verify = 0;
     int enable_sample = 0;
+    size_t block_size = 0;
+    matrix_kernel_t kernel = MATRIX_KERNEL_TILED;
+    int prefetch = 1;
     
     /* Parse arguments */
     for (int i = 1; i < argc; i++) {
@@ -61,6 +67,21 @@ int main(int argc, char *argv[]) {
             port = atoi(argv[++i]);
         } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
             N = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--block-size") == 0 && i + 1 < argc) {
+            block_size = (size_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "naive") == 0) {
+                kernel = MATRIX_KERNEL_NAIVE;
+            } else if (strcmp(argv[i], "tiled") == 0) {
+                kernel = MATRIX_KERNEL_TILED;
+            } else {
+                printf("Error: Unknown kernel '%s'\n", argv[i]);
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--no-prefetch") == 0) {
+            prefetch = 0;
         } else if (strcmp(argv[i], "--verify") == 0) {
             enable_verify = 1;
         } else if (strcmp(argv[i], "--sample") == 0) {
@@ -91,7 +112,7 @@ int main(int argc, char *argv[]) {
     };
     
     if (!is_manager) {
-        strncpy(config.manager_host, manager_host, sizeof(config.manager_host) - 1);
+        snprintf(config.manager_host, sizeof(config.manager_host), "%s", manager_host);
         config.manager_port = port;
     }
     
@@ -114,11 +135,16 @@ int main(int argc, char *argv[]) {
         dsm_finalize();
         return 1;
     }
+    state.block_size = block_size;
+    state.kernel = kernel;
+    state.prefetch = prefetch;
     
     matrix_calculate_partitions(&state);
     
     char info_msg[128];
-    snprintf(info_msg, sizeof(info_msg), "Matrix size: %dx%d, Nodes: %d", N, N, num_nodes);
+    snprintf(info_msg, sizeof(info_msg), "Matrix size: %dx%d, Nodes: %d, Kernel: %s%s", N, N,
+             num_nodes, kernel == MATRIX_KERNEL_TILED ? "tiled" : "naive",
+             prefetch ? "" : " (no prefetch)");
     display_action(node_id, ICON_INFO, info_msg);
     
     snprintf(info_msg, sizeof(info_msg), "This node computes rows %d-%d (%d rows)",
@@ -139,59 +165,35 @@ int main(int argc, char *argv[]) {
     dsm_barrier(BARRIER_ALLOC_A_BASE, num_nodes);
     display_barrier(BARRIER_ALLOC_A_BASE, num_nodes);
 
-    /* 
-     * Serialize allocations: Node 0 allocates first, then Node 1, etc.
-     * This avoids mutual deadlock where both nodes wait for ACKs from each other.
-     * The key insight: dsm_barrier() allows message processing while waiting,
-     * so the waiting node can respond to ALLOC_NOTIFY messages.
-     */
-    for (int i = 0; i < num_nodes; i++) {
-        if (node_id == i) {
-            display_action(node_id, ICON_MEM, "Allocating my partitions (A and C)...");
-            if (matrix_allocate_my_partitions(&state) != 0) {
-                display_action(node_id, ICON_CROSS, "Allocation failed");
-                dsm_finalize();
-                return 1;
-            }
-            double kb = (state.rows_per_node[i] * N * sizeof(double)) / 1024.0;
-            snprintf(info_msg, sizeof(info_msg), "Allocated %.1f KB per matrix", kb);
-            display_action(node_id, ICON_CHECK, info_msg);
-        }
-        /* All nodes synchronize - waiting nodes can process ALLOC_NOTIFY messages */
-        dsm_barrier(BARRIER_ALLOC_A_BASE + 1 + i, num_nodes);
-        if (i == node_id) {
-            display_barrier(BARRIER_ALLOC_A_BASE + 1 + i, num_nodes);
-        }
+    /* A and C: one collective call each gives every node all partitions */
+    display_action(node_id, ICON_MEM, "Allocating all partitions (A and C)...");
+    if (matrix_allocate_partitions(&state) != 0) {
+        display_action(node_id, ICON_CROSS, "Allocation failed");
+        dsm_finalize();
+        return 1;
     }
+    double kb = (state.rows_per_node[node_id] * N * sizeof(double)) / 1024.0;
+    snprintf(info_msg, sizeof(info_msg), "Allocated %.1f KB per matrix", kb);
+    display_action(node_id, ICON_CHECK, info_msg);
 
     display_divider();
     
     if (node_id == 0) {
         display_action(node_id, ICON_MEM, "Allocating matrix B (shared by all)...");
-        if (matrix_allocate_B(&state) != 0) {
-            display_action(node_id, ICON_CROSS, "B allocation failed");
-            matrix_state_cleanup(&state);
-            dsm_finalize();
-            return 1;
-        }
-        double kb = (N * N * sizeof(double)) / 1024.0;
-        snprintf(info_msg, sizeof(info_msg), "Allocated %.1f KB for matrix B", kb);
-        display_action(node_id, ICON_CHECK, info_msg);
     }
-    
-    dsm_barrier(BARRIER_ALLOC_B, num_nodes);
-    display_barrier(BARRIER_ALLOC_B, num_nodes);
-    
-    display_divider();
-    
-    display_action(node_id, ICON_MEM, "Retrieving SVAS pointers to all partitions...");
-    if (matrix_retrieve_all_partitions(&state) != 0) {
-        display_action(node_id, ICON_CROSS, "Failed to retrieve partitions");
+    if (matrix_allocate_B(&state) != 0) {
+        display_action(node_id, ICON_CROSS, "B allocation failed");
         matrix_state_cleanup(&state);
         dsm_finalize();
         return 1;
     }
-    display_action(node_id, ICON_CHECK, "All partition pointers retrieved");
+    if (node_id == 0) {
+        kb = (N * N * sizeof(double)) / 1024.0;
+        snprintf(info_msg, sizeof(info_msg), "Allocated %.1f KB for matrix B", kb);
+        display_action(node_id, ICON_CHECK, info_msg);
+    } else {
+        display_action(node_id, ICON_CHECK, "Matrix B address received");
+    }
     
     dsm_barrier(BARRIER_INIT, num_nodes);
     display_barrier(BARRIER_INIT, num_nodes);
@@ -258,7 +260,13 @@ int main(int argc, char *argv[]) {
         } else {
             display_action(node_id, ICON_CROSS, "Verification failed - mismatch detected");
         }
-        dsm_barrier(BARRIER_VERIFY, num_nodes);
+
+        /* One collective round tells every node whether all partitions passed */
+        int32_t all_verified = verify_result;
+        dsm_allreduce(&all_verified, 1, DSM_TYPE_INT32, DSM_REDUCE_MIN);
+        if (!all_verified) {
+            display_action(node_id, ICON_CROSS, "Verification failed on another node");
+        }
         display_barrier(BARRIER_VERIFY, num_nodes);
         
         printf("\n");
@@ -16,9 +16,20 @@
 #define MAX_MATRIX_NODES 8
 #define MAX_MATRIX_SIZE 2000
 
+/* Target size of a packed B panel in the tiled kernel (fits in L2) */
+#define MATRIX_PANEL_BYTES    (256 * 1024)
+
+/* Columns of C updated per pass over a panel in the tiled kernel */
+#define MATRIX_TILE_COLS      256
+
+/* Compute kernels */
+typedef enum {
+    MATRIX_KERNEL_NAIVE,      /* i/j/k triple loop straight over DSM memory */
+    MATRIX_KERNEL_TILED       /* B packed into local panels, i/k/j over tiles */
+} matrix_kernel_t;
+
 /* Barrier IDs */
 #define BARRIER_ALLOC_A_BASE  100
-#define BARRIER_ALLOC_B       200
 #define BARRIER_ALLOC_C_BASE  300
 #define BARRIER_INIT          400
 #define BARRIER_COMPUTE       500
@@ -44,6 +55,10 @@ typedef struct {
     /* Local computation pointers */
     double *my_A;
     double *my_C;
+
+    size_t block_size;              /* Coherence block of the matrices (0 = PAGE_SIZE) */
+    matrix_kernel_t kernel;         /* Compute kernel */
+    int prefetch;                   /* Fetch A/B/C ranges with dsm_prefetch() before use */
     
 } matrix_state_t;
 
@@ -58,20 +73,15 @@ int matrix_state_init(matrix_state_t *state, int N, int node_id, int num_nodes);
 void matrix_calculate_partitions(matrix_state_t *state);
 
 /**
- * Allocate this node's partition of matrices A and C
+ * Allocate every node's partition of matrices A and C (called by all nodes)
  */
-int matrix_allocate_my_partitions(matrix_state_t *state);
+int matrix_allocate_partitions(matrix_state_t *state);
 
 /**
- * Allocate matrix B (Node 0 only)
+ * Allocate matrix B on Node 0 and share its address (called by all nodes)
  */
 int matrix_allocate_B(matrix_state_t *state);
 
-/**
- * Retrieve all partitions via SVAS
- */
-int matrix_retrieve_all_partitions(matrix_state_t *state);
-
 /**
  * Initialize matrices with test values
  */
@@ -79,6 +89,13 @@ void matrix_initialize(matrix_state_t *state);
 
 /**
  * Compute this node's portion of C = A × B
+ *
+ * The tiled kernel walks B one k-panel at a time: a panel is a run of whole
+ * rows of B ending on a coherence block boundary where the row length
+ * allows, copied into a local buffer once (after one batched prefetch of
+ * exactly its pages) and then reused for every row of this node's C, one
+ * MATRIX_TILE_COLS-wide tile at a time. The inner loop runs over contiguous
+ * columns of the panel and of C, so the compiler vectorizes it.
  */
 void matrix_compute(matrix_state_t *state);
 
@@ -47,24 +47,46 @@ void matrix_calculate_partitions(matrix_state_t *state) {
     }
 }
 
-int matrix_allocate_my_partitions(matrix_state_t *state) {
-    int my_id = state->node_id;
-    int my_rows = state->rows_per_node[my_id];
+/* Large blocks fetch a dense matrix in fewer faults; block size 0 keeps dsm_malloc() */
+static void *matrix_alloc(const matrix_state_t *state, size_t size) {
+    if (state->block_size == 0) {
+        return dsm_malloc(size);
+    }
+    return dsm_malloc_ex(size, DSM_COMPRESSION_ZERO, state->block_size);
+}
+
+int matrix_allocate_partitions(matrix_state_t *state) {
     int N = state->N;
 
-    size_t partition_size = my_rows * N * sizeof(double);
+    /* Node 0 has the most rows, so its partition size fits every node's */
+    size_t partition_size = state->rows_per_node[0] * N * sizeof(double);
 
-    state->my_A = (double*)dsm_malloc(partition_size);
-    if (!state->my_A) {
-        return -1;
+    dsm_alloc_attr_t attr;
+    dsm_alloc_attr_init(&attr);
+    if (state->block_size != 0) {
+        attr.compression = DSM_COMPRESSION_ZERO;
+        attr.block_size = state->block_size;
     }
 
-    state->my_C = (double*)dsm_malloc(partition_size);
-    if (!state->my_C) {
-        dsm_free(state->my_A);
+    /* One collective region per matrix; node n owns the n-th partition */
+    size_t stride = 0;
+    char *A = dsm_malloc_collective(partition_size, &attr, &stride);
+    char *C = dsm_malloc_collective(partition_size, &attr, NULL);
+    if (!A || !C) {
+        dsm_free(A);
+        dsm_free(C);
         return -1;
     }
 
+    for (int i = 0; i < state->num_nodes; i++) {
+        state->A_partitions[i] = (double*)(A + (size_t)i * stride);
+        state->C_partitions[i] = (double*)(C + (size_t)i * stride);
+    }
+
+    int my_id = state->node_id;
+    state->my_A = state->A_partitions[my_id];
+    state->my_C = state->C_partitions[my_id];
+
     return 0;
 }
 
@@ -72,38 +94,19 @@ int matrix_allocate_B(matrix_state_t *state) {
     int N = state->N;
     size_t size = N * N * sizeof(double);
 
-    state->B = (double*)dsm_malloc(size);
-    if (!state->B) {
-        return -1;
+    if (state->node_id == 0) {
+        state->B = (double*)matrix_alloc(state, size);
     }
 
-    return 0;
-}
-
-int matrix_retrieve_all_partitions(matrix_state_t *state) {
-    int num_nodes = state->num_nodes;
-
-    for (int i = 0; i < num_nodes; i++) {
-        state->A_partitions[i] = (double*)dsm_get_allocation(i * 2);
-        if (!state->A_partitions[i]) {
-            return -1;
-        }
-
-        state->C_partitions[i] = (double*)dsm_get_allocation(i * 2 + 1);
-        if (!state->C_partitions[i]) {
-            return -1;
+    /* A failed allocation is broadcast as NULL, so every node fails */
+    if (dsm_broadcast(&state->B, sizeof(state->B), 0) != DSM_SUCCESS || !state->B) {
+        if (state->node_id == 0) {
+            dsm_free(state->B);
         }
-    }
-
-    state->B = (double*)dsm_get_allocation(num_nodes * 2);
-    if (!state->B) {
+        state->B = NULL;
         return -1;
     }
 
-    int my_id = state->node_id;
-    state->my_A = state->A_partitions[my_id];
-    state->my_C = state->C_partitions[my_id];
-
     return 0;
 }
 
@@ -135,11 +138,12 @@ void matrix_initialize(matrix_state_t *state) {
 }
 
 void matrix_state_cleanup(matrix_state_t *state) {
-    if (state->my_A) {
-        dsm_free(state->my_A);
+    /* Every node frees the collective regions, which start at partition 0 */
+    if (state->A_partitions[0]) {
+        dsm_free(state->A_partitions[0]);
     }
-    if (state->my_C) {
-        dsm_free(state->my_C);
+    if (state->C_partitions[0]) {
+        dsm_free(state->C_partitions[0]);
     }
     if (state->B && state->node_id == 0) {
         dsm_free(state->B);
@@ -0,0 +1,168 @@
+#!/bin/bash
+# Script to run the DSM microbenchmarks on N nodes (localhost or a host list)
+
+set -e
+
+# Default values
+NODES=2
+PORT=5000
+BENCH_BINARY="./build/dsm_bench"
+OUT_DIR="./build/bench"
+HOSTS=""
+REMOTE_DIR=""
+SWEEP=0
+BENCH_ARGS=()
+
+# Colors
+GREEN='\033[0;32m'
+BLUE='\033[0;34m'
+RED='\033[0;31m'
+NC='\033[0m' # No Color
+
+# Parse arguments
+while [[ $# -gt 0 ]]; do
+    case $1 in
+        --nodes)
+            NODES="$2"
+            shift 2
+            ;;
+        --port)
+            PORT="$2"
+            shift 2
+            ;;
+        --bench)
+            BENCH_BINARY="$2"
+            shift 2
+            ;;
+        --out)
+            OUT_DIR="$2"
+            shift 2
+            ;;
+        --hosts)
+            HOSTS="$2"
+            shift 2
+            ;;
+        --remote-dir)
+            REMOTE_DIR="$2"
+            shift 2
+            ;;
+        --sweep)
+            SWEEP=1
+            shift
+            ;;
+        --)
+            shift
+            BENCH_ARGS=("$@")
+            break
+            ;;
+        -h|--help)
+            echo "Usage: $0 [OPTIONS] [-- BENCH_OPTIONS]"
+            echo ""
+            echo "Options:"
+            echo "  --nodes N          Number of nodes (default: 2)"
+            echo "  --port P           Manager port; node i listens on P+i (default: 5000)"
+            echo "  --bench PATH       Path to benchmark binary (default: ./build/dsm_bench)"
+            echo "  --out DIR          Directory for logs and JSON results (default: ./build/bench)"
+            echo "  --hosts LIST       Comma-separated hosts, or a file with one per line;"
+            echo "                     node i runs on host i over ssh (node 0 is the manager)"
+            echo "  --remote-dir DIR   Repository path on the hosts (default: this one)"
+            echo "  --sweep            Run once for every node count from 2 to N"
+            echo "  -h, --help         Show this help message"
+            echo ""
+            echo "BENCH_OPTIONS are passed to every node, e.g. --pages 512 --iterations 2000"
+            echo ""
+            echo "Example:"
+            echo "  $0 --nodes 4 --sweep"
+            echo "  $0 --nodes 3 --hosts 10.0.0.1,10.0.0.2,10.0.0.3 -- --pages 1024"
+            exit 0
+            ;;
+        *)
+            echo "Unknown option: $1"
+            echo "Use --help for usage information"
+            exit 1
+            ;;
+    esac
+done
+
+# Host list: one host per node, in node order
+HOST_LIST=()
+if [ -n "$HOSTS" ]; then
+    if [ -f "$HOSTS" ]; then
+        mapfile -t HOST_LIST < <(grep -v '^\s*\(#\|$\)' "$HOSTS")
+    else
+        IFS=',' read -r -a HOST_LIST <<< "$HOSTS"
+    fi
+    if [ "${#HOST_LIST[@]}" -lt "$NODES" ]; then
+        echo -e "${RED}Error: $NODES nodes need $NODES hosts, got ${#HOST_LIST[@]}${NC}"
+        exit 1
+    fi
+    REMOTE_DIR="${REMOTE_DIR:-$(pwd)}"
+fi
+
+# Check if benchmark binary exists
+if [ -z "$HOSTS" ] && [ ! -f "$BENCH_BINARY" ]; then
+    echo -e "${RED}Error: Benchmark binary not found at $BENCH_BINARY${NC}"
+    echo "Please run 'make build-bench' first"
+    exit 1
+fi
+
+mkdir -p "$OUT_DIR"
+
+# Start one node in the background: run_node <node_id> <num_nodes> <args...>
+run_node() {
+    local id=$1 nodes=$2
+    shift 2
+    local log="$OUT_DIR/node${id}_n${nodes}.log"
+    if [ ${#HOST_LIST[@]} -gt 0 ]; then
+        ssh -o BatchMode=yes "${HOST_LIST[$id]}" \
+            "cd '$REMOTE_DIR' && $BENCH_BINARY $* ${BENCH_ARGS[*]}" > "$log" 2>&1 &
+    else
+        "$BENCH_BINARY" "$@" "${BENCH_ARGS[@]}" > "$log" 2>&1 &
+    fi
+}
+
+# Run the benchmarks on <num_nodes> nodes
+run_bench() {
+    local nodes=$1
+    local manager_host="127.0.0.1"
+    local json="$OUT_DIR/bench_n${nodes}.json"
+    local remote_json="$json"
+    if [ ${#HOST_LIST[@]} -gt 0 ]; then
+        manager_host="${HOST_LIST[0]}"
+        remote_json="/tmp/dsm_bench_n${nodes}.json"
+    fi
+
+    echo -e "${BLUE}Benchmarking $nodes nodes...${NC}"
+    local pids=()
+    run_node 0 "$nodes" --manager --nodes "$nodes" --port "$PORT" --json "$remote_json"
+    pids+=($!)
+    sleep 1
+    for ((id = 1; id < nodes; id++)); do
+        run_node "$id" "$nodes" --worker --node-id "$id" --nodes "$nodes" \
+            --manager-host "$manager_host" --manager-port "$PORT"
+        pids+=($!)
+    done
+
+    local failed=0
+    for pid in "${pids[@]}"; do
+        wait "$pid" || failed=1
+    done
+
+    if [ ${#HOST_LIST[@]} -gt 0 ]; then
+        scp -q "${HOST_LIST[0]}:$remote_json" "$json" || failed=1
+    fi
+
+    if [ $failed -ne 0 ]; then
+        echo -e "${RED}✗ Benchmark on $nodes nodes failed (logs in $OUT_DIR)${NC}"
+        return 1
+    fi
+    echo -e "${GREEN}✓ Results: $json${NC}"
+}
+
+if [ $SWEEP -eq 1 ]; then
+    for ((n = 2; n <= NODES; n++)); do
+        run_bench "$n"
+    done
+else
+    run_bench "$NODES"
+fi
@@ -0,0 +1,167 @@
+#!/bin/bash
+# Script to run the two- and four-node multinode tests on localhost in every
+# configuration a protocol change has to pass
+
+set -e
+
+# Default values
+PORT=5000
+TEST_BINARY="./build/test_test_multinode"
+OUT_DIR="./build/multinode"
+RUNS=1
+FOUR_NODE_REPEATS=3
+TIMEOUT=150
+
+# Configurations: flags given to both nodes. Handler threads and the
+# userfaultfd fault threads race each other on the same pages, so they
+# are run together as well as apart. The restart run goes last, from the
+# checkpoint the run before it took.
+CONFIGS=(
+    ""
+    "--release --prefetch 8 --handlers 4"
+    "--dissemination --release"
+    "--handlers 4"
+    "--distributed-directory"
+    "--userfaultfd"
+    "--handlers 4 --userfaultfd"
+)
+
+# Four-node configurations. With three or more writers a page is handed
+# on while earlier hand-offs are still in flight, which two nodes never
+# do; those races are intermittent, so each of these runs several times.
+FOUR_NODE_CONFIGS=(
+    ""
+    "--handlers 4"
+    "--release"
+    "--handlers 4 --adaptive"
+    "--handlers 4 --distributed-directory"
+)
+
+# Colors
+GREEN='\033[0;32m'
+BLUE='\033[0;34m'
+RED='\033[0;31m'
+NC='\033[0m' # No Color
+
+# Parse arguments
+while [[ $# -gt 0 ]]; do
+    case $1 in
+        --port)
+            PORT="$2"
+            shift 2
+            ;;
+        --test)
+            TEST_BINARY="$2"
+            shift 2
+            ;;
+        --out)
+            OUT_DIR="$2"
+            shift 2
+            ;;
+        --runs)
+            RUNS="$2"
+            shift 2
+            ;;
+        --four-node-repeats)
+            FOUR_NODE_REPEATS="$2"
+            shift 2
+            ;;
+        --timeout)
+            TIMEOUT="$2"
+            shift 2
+            ;;
+        -h|--help)
+            echo "Usage: $0 [OPTIONS]"
+            echo ""
+            echo "Options:"
+            echo "  --port P           First manager port; each run takes the next few (default: 5000)"
+            echo "  --test PATH        Path to test binary (default: ./build/test_test_multinode)"
+            echo "  --out DIR          Directory for node logs (default: ./build/multinode)"
+            echo "  --runs N           Run every configuration N times (default: 1)"
+            echo "  --four-node-repeats N  Run each four-node configuration N times per run (default: 3)"
+            echo "  --timeout S        Seconds a run may take (default: 150)"
+            echo "  -h, --help         Show this help message"
+            echo ""
+            echo "Example:"
+            echo "  $0 --runs 16"
+            exit 0
+            ;;
+        *)
+            echo "Unknown option: $1"
+            echo "Use --help for usage information"
+            exit 1
+            ;;
+    esac
+done
+
+# Check if test binary exists
+if [ ! -f "$TEST_BINARY" ]; then
+    echo -e "${RED}Error: Test binary not found at $TEST_BINARY${NC}"
+    echo "Please run 'make build-tests' first"
+    exit 1
+fi
+
+mkdir -p "$OUT_DIR"
+
+# A node passed if it got through every test and none failed
+# (test_multinode exits 0 either way)
+node_passed() {
+    grep -aq "All tests completed" "$1" && ! grep -aq "FAILED" "$1"
+}
+
+# Run every node once: run_cluster <name> <port> <nodes> <flags...>
+run_cluster() {
+    local name=$1 port=$2 nodes=$3
+    shift 3
+    local logs=("$OUT_DIR/${name}_node0.log")
+    local pids=()
+
+    timeout "$TIMEOUT" "$TEST_BINARY" --manager --nodes "$nodes" --port "$port" "$@" > "${logs[0]}" 2>&1 &
+    pids+=($!)
+    sleep 1
+    for ((node = 1; node < nodes; node++)); do
+        logs+=("$OUT_DIR/${name}_node${node}.log")
+        timeout "$TIMEOUT" "$TEST_BINARY" --worker --node-id "$node" --nodes "$nodes" \
+            --manager-host 127.0.0.1 --manager-port "$port" "$@" > "${logs[$node]}" 2>&1 &
+        pids+=($!)
+    done
+    for pid in "${pids[@]}"; do
+        wait "$pid" || true
+    done
+
+    local log
+    for log in "${logs[@]}"; do
+        if ! node_passed "$log"; then
+            echo -e "${RED}✗ $name failed (logs: ${logs[*]})${NC}"
+            return 1
+        fi
+    done
+    echo -e "${GREEN}✓ $name${NC}"
+    return 0
+}
+
+failed=0
+port=$PORT
+for ((run = 1; run <= RUNS; run++)); do
+    echo -e "${BLUE}Run $run/$RUNS${NC}"
+    for i in "${!CONFIGS[@]}"; do
+        read -r -a flags <<< "${CONFIGS[$i]}"
+        run_cluster "run${run}_config${i}" "$port" 2 "${flags[@]}" || failed=$((failed + 1))
+        port=$((port + 3))
+    done
+    run_cluster "run${run}_restart" "$port" 2 --restore /tmp/dsm_checkpoint || failed=$((failed + 1))
+    port=$((port + 3))
+    for i in "${!FOUR_NODE_CONFIGS[@]}"; do
+        read -r -a flags <<< "${FOUR_NODE_CONFIGS[$i]}"
+        for ((repeat = 1; repeat <= FOUR_NODE_REPEATS; repeat++)); do
+            run_cluster "run${run}_four${i}_${repeat}" "$port" 4 "${flags[@]}" || failed=$((failed + 1))
+            port=$((port + 5))
+        done
+    done
+done
+
+if [ $failed -ne 0 ]; then
+    echo -e "${RED}✗ $failed multinode runs failed${NC}"
+    exit 1
+fi
+echo -e "${GREEN}✓ All multinode runs passed${NC}"
@@ -0,0 +1,453 @@
+/**
+ * @file async_access.c
+ * @brief Non-blocking dsm_acquire_async() requests implementation
+ */
+
+#include "async_access.h"
+#include "prefetch.h"
+#include "page_migration.h"
+#include "dsm/dsm.h"
+#include "../core/log.h"
+#include "../core/dsm_context.h"
+#include "../core/perf_log.h"
+#include "../core/stats.h"
+#include "../memory/page_index.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * One dsm_acquire_async() request
+ */
+typedef struct async_request_s {
+    void *addr;                      /**< Range as passed by the caller */
+    size_t len;
+    access_type_t access;
+    dsm_async_callback_t callback;
+    void *arg;
+    uintptr_t pos;                   /**< First page not yet known to allow the access */
+    uintptr_t end;                   /**< End of the range */
+    uint64_t fetch_after_ns;         /**< When pages still in flight are fetched directly */
+    int status;                      /**< Result once completed */
+    struct async_request_s *next;
+} async_request_t;
+
+static struct {
+    pthread_mutex_t lock;            /**< Protects everything below but outstanding */
+    pthread_cond_t wake;             /**< Signaled on submit, notify and stop */
+    async_request_t *pending_head;   /**< Requests for the service thread, oldest first */
+    async_request_t *pending_tail;
+    async_request_t *done_head;      /**< Completed requests, oldest first */
+    async_request_t *done_tail;
+    int outstanding;                 /**< Requests not yet completed (atomic) */
+    bool kicked;                     /**< Service thread should look again without waiting */
+    bool running;                    /**< Service thread keeps running while set */
+    bool started;                    /**< Service thread and event_fd exist */
+    int event_fd;                    /**< Readable while done_head is set */
+    pthread_t thread;
+} g_async = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .event_fd = -1
+};
+
+/* ============================ */
+/*       Service Thread         */
+/* ============================ */
+
+/**
+ * Advance a request over one page
+ *
+ * @param pending Set if the page is still being fetched by someone else
+ * @return DSM_SUCCESS, or the error of a fetch the service thread made
+ */
+static int advance_page(async_request_t *req, page_table_t *table, page_entry_t *entry,
+                        bool *pending) {
+    pthread_mutex_lock(&table->lock);
+    page_state_t state = entry->state;
+    pthread_mutex_unlock(&table->lock);
+
+    if (state == PAGE_STATE_READ_WRITE ||
+        (state == PAGE_STATE_READ_ONLY && req->access == ACCESS_READ)) {
+        return DSM_SUCCESS;
+    }
+
+    if (state == PAGE_STATE_INVALID) {
+        pthread_mutex_lock(page_entry_lock(entry));
+        bool in_flight = entry->request_pending || entry->prefetch_pending;
+        pthread_mutex_unlock(page_entry_lock(entry));
+
+        if (in_flight && perf_get_timestamp_ns() < req->fetch_after_ns) {
+            *pending = true;
+            return DSM_SUCCESS;
+        }
+
+        /* Nothing on its way (the prefetch failed, was cancelled or the page
+         * is the owner's), or it is overdue: fetch as a fault would */
+        int rc = fetch_page_read_entry(table, entry);
+        if (rc != DSM_SUCCESS || req->access == ACCESS_READ) {
+            return rc;
+        }
+    }
+
+    return prefetch_make_writable(table, entry);
+}
+
+/**
+ * Advance a request as far as its pages allow
+ *
+ * @param pending Set if the request must be looked at again
+ * @return DSM_SUCCESS, or the error that completes the request
+ */
+static int advance_request(async_request_t *req, bool *pending) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    *pending = false;
+    while (req->pos < req->end) {
+        page_table_t *table = NULL;
+        pthread_mutex_lock(&ctx->lock);
+        page_entry_t *entry = page_index_lookup_addr((void *)req->pos, &table);
+        if (entry) {
+            page_table_acquire(table);
+        }
+        pthread_mutex_unlock(&ctx->lock);
+
+        /* Gaps, and allocations freed since the request, are skipped */
+        if (!entry) {
+            req->pos += PAGE_SIZE;
+            continue;
+        }
+
+        uintptr_t next = (uintptr_t)entry->local_addr + table->block_size;
+        int rc = advance_page(req, table, entry, pending);
+        page_table_release(table);
+        if (rc != DSM_SUCCESS || *pending) {
+            return rc;
+        }
+        req->pos = next;
+    }
+    return DSM_SUCCESS;
+}
+
+static void wait_for_work(void) {
+    if (g_async.kicked || !g_async.running) {
+        return;
+    }
+    if (!g_async.pending_head) {
+        pthread_cond_wait(&g_async.wake, &g_async.lock);
+        return;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += (long)ASYNC_POLL_MS * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&g_async.wake, &g_async.lock, &deadline);
+}
+
+static void* async_service_thread(void *arg) {
+    (void)arg;
+    LOG_DEBUG("Async access service thread started");
+
+    pthread_mutex_lock(&g_async.lock);
+    while (g_async.running) {
+        wait_for_work();
+        if (!g_async.running) {
+            break;
+        }
+        g_async.kicked = false;
+        async_request_t *list = g_async.pending_head;
+        g_async.pending_head = NULL;
+        g_async.pending_tail = NULL;
+        pthread_mutex_unlock(&g_async.lock);
+
+        async_request_t *keep = NULL, *keep_last = NULL;
+        async_request_t *done = NULL, *done_last = NULL;
+        int completed = 0;
+        while (list) {
+            async_request_t *req = list;
+            list = req->next;
+            req->next = NULL;
+
+            bool pending;
+            req->status = advance_request(req, &pending);
+            if (pending && req->status == DSM_SUCCESS) {
+                if (keep_last) {
+                    keep_last->next = req;
+                } else {
+                    keep = req;
+                }
+                keep_last = req;
+            } else {
+                if (req->status != DSM_SUCCESS) {
+                    LOG_WARN("dsm_acquire_async: request for %p failed (rc=%d)", req->addr, req->status);
+                }
+                if (done_last) {
+                    done_last->next = req;
+                } else {
+                    done = req;
+                }
+                done_last = req;
+                completed++;
+            }
+        }
+
+        pthread_mutex_lock(&g_async.lock);
+        /* Requests kept from this pass go ahead of those submitted meanwhile */
+        if (keep) {
+            keep_last->next = g_async.pending_head;
+            if (!g_async.pending_head) {
+                g_async.pending_tail = keep_last;
+            }
+            g_async.pending_head = keep;
+        }
+        if (done) {
+            if (g_async.done_tail) {
+                g_async.done_tail->next = done;
+            } else {
+                g_async.done_head = done;
+            }
+            g_async.done_tail = done_last;
+            __atomic_sub_fetch(&g_async.outstanding, completed, __ATOMIC_RELEASE);
+
+            uint64_t one = 1;
+            if (write(g_async.event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+                LOG_WARN("Failed to signal async completion eventfd");
+            }
+        }
+    }
+    pthread_mutex_unlock(&g_async.lock);
+
+    LOG_DEBUG("Async access service thread stopped");
+    return NULL;
+}
+
+/**
+ * Create the eventfd and service thread on first use
+ * Caller holds g_async.lock.
+ */
+static int ensure_started(void) {
+    if (g_async.started) {
+        return DSM_SUCCESS;
+    }
+
+    g_async.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (g_async.event_fd < 0) {
+        LOG_ERROR("Failed to create async completion eventfd");
+        return DSM_ERROR_INIT;
+    }
+    g_async.running = true;
+    if (pthread_create(&g_async.thread, NULL, async_service_thread, NULL) != 0) {
+        LOG_ERROR("Failed to create async access service thread");
+        g_async.running = false;
+        close(g_async.event_fd);
+        g_async.event_fd = -1;
+        return DSM_ERROR_INIT;
+    }
+    g_async.started = true;
+    return DSM_SUCCESS;
+}
+
+void async_access_notify(void) {
+    if (__atomic_load_n(&g_async.outstanding, __ATOMIC_ACQUIRE) == 0) {
+        return;
+    }
+    pthread_mutex_lock(&g_async.lock);
+    g_async.kicked = true;
+    pthread_cond_signal(&g_async.wake);
+    pthread_mutex_unlock(&g_async.lock);
+}
+
+static int free_requests(async_request_t *list) {
+    int count = 0;
+    while (list) {
+        async_request_t *next = list->next;
+        free(list);
+        list = next;
+        count++;
+    }
+    return count;
+}
+
+void async_access_stop(void) {
+    pthread_mutex_lock(&g_async.lock);
+    if (!g_async.started) {
+        pthread_mutex_unlock(&g_async.lock);
+        return;
+    }
+    g_async.running = false;
+    pthread_cond_signal(&g_async.wake);
+    pthread_mutex_unlock(&g_async.lock);
+
+    pthread_join(g_async.thread, NULL);
+
+    pthread_mutex_lock(&g_async.lock);
+    int dropped = free_requests(g_async.pending_head) + free_requests(g_async.done_head);
+    g_async.pending_head = NULL;
+    g_async.pending_tail = NULL;
+    g_async.done_head = NULL;
+    g_async.done_tail = NULL;
+    __atomic_store_n(&g_async.outstanding, 0, __ATOMIC_RELEASE);
+    g_async.kicked = false;
+    close(g_async.event_fd);
+    g_async.event_fd = -1;
+    g_async.started = false;
+    pthread_mutex_unlock(&g_async.lock);
+
+    if (dropped > 0) {
+        LOG_WARN("Dropped %d dsm_acquire_async() requests at finalize", dropped);
+    }
+}
+
+/* ============================ */
+/*       Public API             */
+/* ============================ */
+
+int dsm_acquire_async(void *addr, size_t len, access_type_t access,
+                      dsm_async_callback_t callback, void *arg) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (!ctx || !ctx->initialized) {
+        return DSM_ERROR_INIT;
+    }
+    if (!addr || len == 0 || (access != ACCESS_READ && access != ACCESS_WRITE)) {
+        return DSM_ERROR_INVALID;
+    }
+
+    uintptr_t start = (uintptr_t)addr & ~(uintptr_t)(PAGE_SIZE - 1);
+    uintptr_t end = (uintptr_t)addr + len;
+    if (end < start) {
+        return DSM_ERROR_INVALID;
+    }
+
+    async_request_t *req = calloc(1, sizeof(*req));
+    if (!req) {
+        return DSM_ERROR_MEMORY;
+    }
+    req->addr = addr;
+    req->len = len;
+    req->access = access;
+    req->callback = callback;
+    req->arg = arg;
+    req->pos = start;
+    req->end = end;
+    req->fetch_after_ns = perf_get_timestamp_ns() + (uint64_t)PREFETCH_RANGE_TIMEOUT_MS * 1000000ULL;
+
+    /* Issue the prefetches here, one allocation at a time, as dsm_prefetch() does */
+    bool found = false;
+    int requested = 0;
+    uintptr_t pos = start;
+    while (pos < end) {
+        page_table_t *table = NULL;
+        pthread_mutex_lock(&ctx->lock);
+        page_entry_t *entry = page_index_lookup_addr((void *)pos, &table);
+        if (entry) {
+            page_table_acquire(table);
+        }
+        pthread_mutex_unlock(&ctx->lock);
+
+        if (!entry) {
+            pos += PAGE_SIZE;
+            continue;
+        }
+        found = true;
+
+        uintptr_t table_end = (uintptr_t)table->base_addr + table->num_pages * table->block_size;
+        size_t first = (size_t)(entry - table->entries);
+        size_t last = (size_t)(((end < table_end ? end : table_end) - 1 -
+                                (uintptr_t)table->base_addr) / table->block_size);
+        requested += prefetch_pages(table, first, last + 1);
+        page_table_release(table);
+        pos = table_end;
+    }
+    if (!found) {
+        free(req);
+        return DSM_ERROR_NOT_FOUND;
+    }
+
+    pthread_mutex_lock(&g_async.lock);
+    int rc = ensure_started();
+    if (rc != DSM_SUCCESS) {
+        pthread_mutex_unlock(&g_async.lock);
+        free(req);
+        return rc;
+    }
+    if (g_async.pending_tail) {
+        g_async.pending_tail->next = req;
+    } else {
+        g_async.pending_head = req;
+    }
+    g_async.pending_tail = req;
+    __atomic_add_fetch(&g_async.outstanding, 1, __ATOMIC_RELEASE);
+    g_async.kicked = true;
+    pthread_cond_signal(&g_async.wake);
+    pthread_mutex_unlock(&g_async.lock);
+
+    STATS_INC(async_acquires);
+    LOG_DEBUG("dsm_acquire_async: %zu bytes at %p, %d pages requested", len, addr, requested);
+    return DSM_SUCCESS;
+}
+
+int dsm_poll(int max_completions) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (!ctx || !ctx->initialized) {
+        return DSM_ERROR_INIT;
+    }
+
+    pthread_mutex_lock(&g_async.lock);
+    async_request_t *list = g_async.done_head;
+    async_request_t *last = NULL;
+    int count = 0;
+    for (async_request_t *req = list;
+         req && (max_completions <= 0 || count < max_completions); req = req->next) {
+        last = req;
+        count++;
+    }
+    if (last) {
+        g_async.done_head = last->next;
+        if (!g_async.done_head) {
+            g_async.done_tail = NULL;
+        }
+        last->next = NULL;
+    }
+
+    /* The descriptor stays readable only while completions are left */
+    if (g_async.started && count > 0 && !g_async.done_head) {
+        uint64_t value;
+        if (read(g_async.event_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+            LOG_WARN("Failed to clear async completion eventfd");
+        }
+    }
+    pthread_mutex_unlock(&g_async.lock);
+
+    /* Callbacks run unlocked: they may submit further requests */
+    async_request_t *req = count > 0 ? list : NULL;
+    while (req) {
+        async_request_t *next = req->next;
+        if (req->callback) {
+            req->callback(req->addr, req->len, req->status, req->arg);
+        }
+        free(req);
+        req = next;
+    }
+    return count;
+}
+
+int dsm_async_fd(void) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (!ctx || !ctx->initialized) {
+        return DSM_ERROR_INIT;
+    }
+
+    pthread_mutex_lock(&g_async.lock);
+    int rc = ensure_started();
+    int fd = g_async.event_fd;
+    pthread_mutex_unlock(&g_async.lock);
+    return rc == DSM_SUCCESS ? fd : rc;
+}
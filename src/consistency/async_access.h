@@ -0,0 +1,41 @@
+/**
+ * @file async_access.h
+ * @brief Non-blocking dsm_acquire_async() requests and their completion
+ *
+ * dsm_acquire_async() issues the prefetches of a range on the caller's
+ * thread and hands the request to a service thread, started on first use.
+ * The service thread walks each outstanding request page by page: a page
+ * still being fetched leaves the request outstanding, a page that has no
+ * fetch in flight, or whose prefetch is older than PREFETCH_RANGE_TIMEOUT_MS,
+ * is fetched on the service thread as a fault would, and for ACCESS_WRITE a
+ * present page is then made writable. Reads therefore travel in batches
+ * while write upgrades, and fetches a prefetch missed, are serialized on
+ * the service thread; neither ever blocks the caller.
+ *
+ * The service thread runs when a prefetch reply is installed (see
+ * async_access_notify()) and every ASYNC_POLL_MS while requests are
+ * outstanding, which catches prefetches that failed or were cancelled.
+ * Completed requests wait on a list for dsm_poll(), and an eventfd is
+ * readable while that list is not empty.
+ */
+
+#ifndef ASYNC_ACCESS_H
+#define ASYNC_ACCESS_H
+
+/** How often outstanding requests are checked without a reply to wake the service thread */
+#define ASYNC_POLL_MS 10
+
+/**
+ * Wake the service thread because a prefetched page was installed
+ * Called by the PAGE_REPLY handler; cheap when no request is outstanding.
+ */
+void async_access_notify(void);
+
+/**
+ * Stop the service thread and drop outstanding and uncollected requests
+ * Their callbacks do not run. Called by dsm_finalize() while the network
+ * is still up, so a fetch in progress on the service thread can finish.
+ */
+void async_access_stop(void);
+
+#endif /* ASYNC_ACCESS_H */
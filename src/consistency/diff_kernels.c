@@ -0,0 +1,218 @@
+/**
+ * @file diff_kernels.c
+ * @brief Vectorized page compare kernels implementation
+ */
+
+#include "diff_kernels.h"
+#include "../core/log.h"
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DIFF_HAVE_X86 1
+#endif
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define DIFF_HAVE_NEON 1
+#endif
+
+/** Run header: [uint16 offset][uint16 length] */
+#define DIFF_RUN_HEADER 4
+
+/* ============================ */
+/*       Compare Kernels        */
+/* ============================ */
+
+static void masks_scalar(const uint8_t *page, const uint8_t *twin, uint64_t *masks) {
+    for (int b = 0; b < DIFF_BLOCKS_PER_PAGE; b++) {
+        const uint8_t *p = page + b * DIFF_BLOCK_SIZE;
+        const uint8_t *t = twin + b * DIFF_BLOCK_SIZE;
+        uint64_t mask = 0;
+
+        for (int w = 0; w < DIFF_BLOCK_SIZE; w += 8) {
+            uint64_t pw, tw;
+            memcpy(&pw, p + w, sizeof(pw));
+            memcpy(&tw, t + w, sizeof(tw));
+            if (pw == tw) {
+                continue;
+            }
+            /* Byte compares keep this independent of endianness */
+            for (int j = 0; j < 8; j++) {
+                if (p[w + j] != t[w + j]) {
+                    mask |= 1ULL << (w + j);
+                }
+            }
+        }
+        masks[b] = mask;
+    }
+}
+
+#ifdef DIFF_HAVE_X86
+__attribute__((target("avx2")))
+static void masks_avx2(const uint8_t *page, const uint8_t *twin, uint64_t *masks) {
+    for (int b = 0; b < DIFF_BLOCKS_PER_PAGE; b++) {
+        const uint8_t *p = page + b * DIFF_BLOCK_SIZE;
+        const uint8_t *t = twin + b * DIFF_BLOCK_SIZE;
+
+        __m256i eq_lo = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)p),
+                                          _mm256_loadu_si256((const __m256i *)t));
+        __m256i eq_hi = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 32)),
+                                          _mm256_loadu_si256((const __m256i *)(t + 32)));
+        uint64_t equal = (uint32_t)_mm256_movemask_epi8(eq_lo) |
+                         ((uint64_t)(uint32_t)_mm256_movemask_epi8(eq_hi) << 32);
+        masks[b] = ~equal;
+    }
+}
+
+__attribute__((target("avx512bw")))
+static void masks_avx512(const uint8_t *page, const uint8_t *twin, uint64_t *masks) {
+    for (int b = 0; b < DIFF_BLOCKS_PER_PAGE; b++) {
+        __m512i p = _mm512_loadu_si512((const void *)(page + b * DIFF_BLOCK_SIZE));
+        __m512i t = _mm512_loadu_si512((const void *)(twin + b * DIFF_BLOCK_SIZE));
+        masks[b] = _mm512_cmpneq_epi8_mask(p, t);
+    }
+}
+#endif
+
+#ifdef DIFF_HAVE_NEON
+/** Changed-byte bits of one 16-byte chunk */
+static inline uint64_t neon_chunk_mask(const uint8_t *p, const uint8_t *t) {
+    static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                        1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t changed = vmvnq_u8(vceqq_u8(vld1q_u8(p), vld1q_u8(t)));
+    uint8x16_t bits = vandq_u8(changed, vld1q_u8(weights));
+    return (uint64_t)vaddv_u8(vget_low_u8(bits)) |
+           ((uint64_t)vaddv_u8(vget_high_u8(bits)) << 8);
+}
+
+static void masks_neon(const uint8_t *page, const uint8_t *twin, uint64_t *masks) {
+    for (int b = 0; b < DIFF_BLOCKS_PER_PAGE; b++) {
+        const uint8_t *p = page + b * DIFF_BLOCK_SIZE;
+        const uint8_t *t = twin + b * DIFF_BLOCK_SIZE;
+        masks[b] = neon_chunk_mask(p, t) |
+                   (neon_chunk_mask(p + 16, t + 16) << 16) |
+                   (neon_chunk_mask(p + 32, t + 32) << 32) |
+                   (neon_chunk_mask(p + 48, t + 48) << 48);
+    }
+}
+#endif
+
+/* ============================ */
+/*       Kernel Selection       */
+/* ============================ */
+
+/* Fastest first */
+static const diff_kernel_t g_kernels[] = {
+#ifdef DIFF_HAVE_X86
+    { "avx512", masks_avx512 },
+    { "avx2",   masks_avx2 },
+#endif
+#ifdef DIFF_HAVE_NEON
+    { "neon",   masks_neon },
+#endif
+    { "scalar", masks_scalar },
+};
+
+#define DIFF_NUM_KERNELS (sizeof(g_kernels) / sizeof(g_kernels[0]))
+
+static const diff_kernel_t *g_selected = NULL;
+static pthread_once_t g_select_once = PTHREAD_ONCE_INIT;
+
+static bool kernel_supported(const diff_kernel_t *kernel) {
+#ifdef DIFF_HAVE_X86
+    if (kernel->compute_masks == masks_avx512) {
+        return __builtin_cpu_supports("avx512bw");
+    }
+    if (kernel->compute_masks == masks_avx2) {
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+    /* NEON is part of the AArch64 baseline */
+    (void)kernel;
+    return true;
+}
+
+static void select_kernel(void) {
+#ifdef DIFF_HAVE_X86
+    __builtin_cpu_init();
+#endif
+    for (size_t i = 0; i < DIFF_NUM_KERNELS; i++) {
+        if (kernel_supported(&g_kernels[i])) {
+            g_selected = &g_kernels[i];
+            break;
+        }
+    }
+    LOG_DEBUG("Page diff kernel: %s", g_selected->name);
+}
+
+const diff_kernel_t* diff_kernel_select(void) {
+    pthread_once(&g_select_once, select_kernel);
+    return g_selected;
+}
+
+const diff_kernel_t* diff_kernel_get(const char *name) {
+    if (!name) {
+        return NULL;
+    }
+#ifdef DIFF_HAVE_X86
+    __builtin_cpu_init();
+#endif
+    for (size_t i = 0; i < DIFF_NUM_KERNELS; i++) {
+        if (strcmp(g_kernels[i].name, name) == 0) {
+            return kernel_supported(&g_kernels[i]) ? &g_kernels[i] : NULL;
+        }
+    }
+    return NULL;
+}
+
+/* ============================ */
+/*       Run Extraction         */
+/* ============================ */
+
+/**
+ * First byte at or after pos whose change bit equals want, or PAGE_SIZE
+ */
+static size_t next_bit(const uint64_t *masks, size_t pos, bool want) {
+    size_t b = pos / DIFF_BLOCK_SIZE;
+    if (b >= DIFF_BLOCKS_PER_PAGE) {
+        return PAGE_SIZE;
+    }
+
+    uint64_t m = (want ? masks[b] : ~masks[b]) & (~0ULL << (pos % DIFF_BLOCK_SIZE));
+    while (m == 0) {
+        if (++b == DIFF_BLOCKS_PER_PAGE) {
+            return PAGE_SIZE;
+        }
+        m = want ? masks[b] : ~masks[b];
+    }
+    return b * DIFF_BLOCK_SIZE + (size_t)__builtin_ctzll(m);
+}
+
+size_t diff_encode(const diff_kernel_t *kernel, const uint8_t *page, const uint8_t *twin,
+                   uint8_t *out, int *num_runs) {
+    uint64_t masks[DIFF_BLOCKS_PER_PAGE];
+    kernel->compute_masks(page, twin, masks);
+
+    size_t len = 0;
+    int runs = 0;
+    size_t pos = 0;
+
+    while ((pos = next_bit(masks, pos, true)) < PAGE_SIZE) {
+        size_t end = next_bit(masks, pos, false);
+
+        uint16_t offset = (uint16_t)pos;
+        uint16_t length = (uint16_t)(end - pos);
+        memcpy(out + len, &offset, sizeof(offset));
+        memcpy(out + len + 2, &length, sizeof(length));
+        memcpy(out + len + DIFF_RUN_HEADER, page + pos, length);
+        len += DIFF_RUN_HEADER + length;
+        runs++;
+
+        pos = end;
+    }
+
+    *num_runs = runs;
+    return len;
+}
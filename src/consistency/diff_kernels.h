@@ -0,0 +1,69 @@
+/**
+ * @file diff_kernels.h
+ * @brief Vectorized page compare kernels for release consistency diffs
+ *
+ * A kernel compares a page with its twin and produces one 64-bit mask per
+ * 64-byte block, bit i set when byte i of the block changed. Runs are then
+ * cut from the masks with count-trailing-zeros, so unchanged stretches cost
+ * one vector compare per block and no per-byte branches.
+ *
+ * The best kernel the CPU supports (AVX-512BW, AVX2, NEON, else scalar) is
+ * picked once at first use.
+ */
+
+#ifndef DIFF_KERNELS_H
+#define DIFF_KERNELS_H
+
+#include "dsm/types.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/** Bytes covered by one change mask */
+#define DIFF_BLOCK_SIZE 64
+
+/** Change masks per page */
+#define DIFF_BLOCKS_PER_PAGE (PAGE_SIZE / DIFF_BLOCK_SIZE)
+
+/**
+ * Compare kernel: fill masks[DIFF_BLOCKS_PER_PAGE] for a page and its twin
+ */
+typedef void (*diff_mask_fn)(const uint8_t *page, const uint8_t *twin, uint64_t *masks);
+
+/**
+ * A compare kernel
+ */
+typedef struct {
+    const char *name;          /**< "avx512", "avx2", "neon" or "scalar" */
+    diff_mask_fn compute_masks;
+} diff_kernel_t;
+
+/**
+ * Best kernel supported by this CPU (selected once, thread safe)
+ */
+const diff_kernel_t* diff_kernel_select(void);
+
+/**
+ * Look up a kernel by name
+ *
+ * @param name Kernel name
+ * @return Kernel, or NULL if unknown or not supported by this CPU
+ */
+const diff_kernel_t* diff_kernel_get(const char *name);
+
+/**
+ * Encode the changed bytes of a page as runs using a given kernel
+ *
+ * Same output as rc_encode_diff(): runs of [uint16 offset][uint16 length]
+ * [bytes], each covering only changed bytes.
+ *
+ * @param kernel Compare kernel
+ * @param page Current page contents
+ * @param twin Page contents at the first write
+ * @param out Output buffer of at least RC_DIFF_MAX_ENCODED bytes
+ * @param num_runs Output: number of runs
+ * @return Encoded size in bytes (0 if the page is unchanged)
+ */
+size_t diff_encode(const diff_kernel_t *kernel, const uint8_t *page, const uint8_t *twin,
+                   uint8_t *out, int *num_runs);
+
+#endif /* DIFF_KERNELS_H */
@@ -1,115 +1,327 @@
 /**
  * @file directory.c
- * @brief Page directory implementation (hash table-based)
+ * @brief Page directory implementation (range-indexed flat storage)
  */
 
 #include "directory.h"
 #include "page_migration.h"
+#include "release_consistency.h"
 #include "../core/log.h"
 #include "../core/dsm_context.h"
+#include "../core/stats.h"
 #include "../network/handlers.h"
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <time.h>
 
-/* Hash function for page IDs */
-static inline size_t hash_page_id(page_id_t page_id, size_t table_size) {
-    return page_id % table_size;
+/* Hash function for allocation ranges */
+static inline size_t hash_range(page_id_t base) {
+    return (size_t)((base >> PAGE_ID_ALLOC_SHIFT) * 0x9E3779B97F4A7C15ULL >> 56) %
+           DIRECTORY_RANGE_BUCKETS;
 }
 
-/* Find entry in hash table, or return NULL if not found */
-static directory_entry_t* find_entry(page_directory_t *dir, page_id_t page_id) {
-    size_t bucket = hash_page_id(page_id, dir->table_size);
-    directory_entry_t *entry = dir->buckets[bucket];
+/* First page ID of the allocation a page belongs to */
+static inline page_id_t range_base(page_id_t page_id) {
+    return page_id & ~(page_id_t)(PAGE_ID_MAX_PAGES - 1);
+}
+
+/* Lock guarding a page's entry */
+static inline pthread_mutex_t *entry_lock(page_directory_t *dir, page_id_t page_id) {
+    return &dir->stripes[page_id % DIRECTORY_LOCK_STRIPES];
+}
+
+/* ============================ */
+/*     Sharer Bitmap Helpers    */
+/* ============================ */
 
-    while (entry != NULL) {
-        if (entry->page_id == page_id) {
-            return entry;
+static bool sharer_test(const sharer_list_t *set, node_id_t node) {
+    if (node < 64) {
+        return (set->bits >> node) & 1ULL;
+    }
+    uint32_t word = (node - 64) / 64;
+    return word < set->ext_words && ((set->ext_bits[word] >> ((node - 64) % 64)) & 1ULL);
+}
+
+static int sharer_add(sharer_list_t *set, node_id_t node) {
+    if (sharer_test(set, node)) {
+        return DSM_SUCCESS;
+    }
+
+    if (node < 64) {
+        set->bits |= 1ULL << node;
+    } else {
+        uint32_t word = (node - 64) / 64;
+        if (word >= set->ext_words) {
+            /* Grow to cover this node, at least doubling to amortize */
+            uint32_t new_words = set->ext_words ? set->ext_words * 2 : 1;
+            while (new_words <= word) {
+                new_words *= 2;
+            }
+            uint64_t *grown = realloc(set->ext_bits, new_words * sizeof(uint64_t));
+            if (!grown) {
+                return DSM_ERROR_MEMORY;
+            }
+            memset(grown + set->ext_words, 0, (new_words - set->ext_words) * sizeof(uint64_t));
+            set->ext_bits = grown;
+            set->ext_words = new_words;
         }
-        entry = entry->next;
+        set->ext_bits[word] |= 1ULL << ((node - 64) % 64);
     }
 
-    return NULL;
+    set->count++;
+    return DSM_SUCCESS;
 }
 
-/* Find or create entry in hash table */
-static directory_entry_t* find_or_create_entry(page_directory_t *dir, page_id_t page_id) {
-    size_t bucket = hash_page_id(page_id, dir->table_size);
-    directory_entry_t *entry = dir->buckets[bucket];
+static bool sharer_remove(sharer_list_t *set, node_id_t node) {
+    if (!sharer_test(set, node)) {
+        return false;
+    }
+    if (node < 64) {
+        set->bits &= ~(1ULL << node);
+    } else {
+        set->ext_bits[(node - 64) / 64] &= ~(1ULL << ((node - 64) % 64));
+    }
+    set->count--;
+    return true;
+}
+
+static void sharer_clear(sharer_list_t *set) {
+    set->bits = 0;
+    if (set->ext_bits) {
+        memset(set->ext_bits, 0, set->ext_words * sizeof(uint64_t));
+    }
+    set->count = 0;
+}
+
+static void sharer_free(sharer_list_t *set) {
+    free(set->ext_bits);
+    set->ext_bits = NULL;
+    set->ext_words = 0;
+    set->bits = 0;
+    set->count = 0;
+}
 
-    /* Search for existing entry */
-    while (entry != NULL) {
-        if (entry->page_id == page_id) {
-            return entry;
+/* Expand the bitmap into an ascending node ID list (at most max entries) */
+static int sharer_to_array(const sharer_list_t *set, node_id_t *out, int max) {
+    int n = 0;
+    for (uint64_t w = set->bits; w && n < max; w &= w - 1) {
+        out[n++] = (node_id_t)__builtin_ctzll(w);
+    }
+    for (uint32_t i = 0; i < set->ext_words && n < max; i++) {
+        for (uint64_t w = set->ext_bits[i]; w && n < max; w &= w - 1) {
+            out[n++] = (node_id_t)(64 + i * 64 + __builtin_ctzll(w));
         }
-        entry = entry->next;
     }
+    return n;
+}
 
-    /* Entry not found, create new one */
-    entry = malloc(sizeof(directory_entry_t));
-    if (!entry) {
-        LOG_ERROR("Failed to allocate directory entry for page %lu", page_id);
-        return NULL;
+/* ============================ */
+/*     Access Counters          */
+/* ============================ */
+
+static uint64_t access_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void access_reset(directory_access_t *access) {
+    memset(access, 0, sizeof(*access));
+    access->dominant_writer = DSM_NODE_NONE;
+}
+
+/* Halve the counts once they are large, so the pattern follows recent accesses */
+static void access_age(directory_access_t *access) {
+    if (access->reads + access->writes >= DIRECTORY_ACCESS_AGE_LIMIT) {
+        access->reads >>= 1;
+        access->writes >>= 1;
+        access->invalidations >>= 1;
+        access->dominant_votes >>= 1;
+    }
+}
+
+static void access_note_read(directory_access_t *access) {
+    access->reads++;
+    access_age(access);
+}
+
+/**
+ * Record a write access granted to writer by a page owned by old_owner
+ * Enough ownership moves within one window freeze the page.
+ */
+static void access_note_write(directory_access_t *access, page_id_t page_id,
+                              node_id_t old_owner, node_id_t writer) {
+    access->writes++;
+
+    if (access->dominant_writer == writer) {
+        access->dominant_votes++;
+    } else if (access->dominant_votes == 0) {
+        access->dominant_writer = writer;
+        access->dominant_votes = 1;
+    } else {
+        access->dominant_votes--;
+    }
+
+    if (old_owner != DSM_NODE_NONE && old_owner != writer) {
+        access->transfers++;
+
+        uint64_t now = access_now_ns();
+        if (now - access->window_start_ns > DIRECTORY_PINGPONG_WINDOW_MS * 1000000ULL) {
+            access->window_start_ns = now;
+            access->window_transfers = 0;
+        }
+        if (++access->window_transfers >= DIRECTORY_PINGPONG_TRANSFERS) {
+            /* Nobody has kept the page long enough to be worth favouring */
+            access->frozen_until_ns = now + DIRECTORY_COOLING_MS * 1000000ULL;
+            access->window_transfers = 0;
+            access->dominant_votes = 0;
+            STATS_INC(pingpong_freezes);
+            LOG_DEBUG("Page %lu ping-pongs (last move %u -> %u), frozen for %d ms",
+                      page_id, old_owner, writer, DIRECTORY_COOLING_MS);
+        }
+    }
+
+    access_age(access);
+}
+
+/* ============================ */
+/*     Range Storage            */
+/* ============================ */
+
+static directory_range_t *range_find(page_directory_t *dir, page_id_t base) {
+    directory_range_t *range = __atomic_load_n(&dir->ranges[hash_range(base)], __ATOMIC_ACQUIRE);
+    while (range != NULL && range->base != base) {
+        range = range->next;
     }
+    return range;
+}
 
-    /* Initialize entry */
-    entry->page_id = page_id;
-    entry->owner = (node_id_t)-1;  /* Invalid owner initially */
-    entry->sharers.count = 0;
-    entry->is_valid = true;
-    pthread_mutex_init(&entry->lock, NULL);
+/**
+ * Slot of a page's entry
+ * With create, missing storage is allocated; otherwise NULL is returned
+ * for pages no entry was ever created in the chunk of.
+ */
+static directory_entry_t *entry_slot(page_directory_t *dir, page_id_t page_id, bool create) {
+    page_id_t base = range_base(page_id);
+    size_t index = (size_t)(page_id - base);
+    size_t chunk = index >> DIRECTORY_CHUNK_SHIFT;
+
+    directory_range_t *range = range_find(dir, base);
+    directory_entry_t *entries =
+        range ? __atomic_load_n(&range->chunks[chunk], __ATOMIC_ACQUIRE) : NULL;
+    if (entries || !create) {
+        return entries ? &entries[index & (DIRECTORY_CHUNK_PAGES - 1)] : NULL;
+    }
 
-    /* Insert at head of bucket chain */
-    entry->next = dir->buckets[bucket];
-    dir->buckets[bucket] = entry;
-    dir->num_entries++;
+    /* Slow path: add the range and/or chunk, checking again under the lock */
+    pthread_mutex_lock(&dir->lock);
+    range = range_find(dir, base);
+    if (!range) {
+        range = calloc(1, sizeof(directory_range_t));
+        if (!range) {
+            pthread_mutex_unlock(&dir->lock);
+            LOG_ERROR("Failed to allocate directory range for page %lu", page_id);
+            return NULL;
+        }
+        range->base = base;
+        size_t bucket = hash_range(base);
+        range->next = dir->ranges[bucket];
+        __atomic_store_n(&dir->ranges[bucket], range, __ATOMIC_RELEASE);
+        LOG_DEBUG("Created directory range at page %lu", base);
+    }
+    entries = range->chunks[chunk];
+    if (!entries) {
+        entries = calloc(DIRECTORY_CHUNK_PAGES, sizeof(directory_entry_t));
+        if (!entries) {
+            pthread_mutex_unlock(&dir->lock);
+            LOG_ERROR("Failed to allocate directory entries for page %lu", page_id);
+            return NULL;
+        }
+        __atomic_store_n(&range->chunks[chunk], entries, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&dir->lock);
 
-    LOG_DEBUG("Created directory entry for page %lu (bucket %zu, total entries: %zu)",
-              page_id, bucket, dir->num_entries);
+    return &entries[index & (DIRECTORY_CHUNK_PAGES - 1)];
+}
+
+/* Find entry, or return NULL if not found */
+static directory_entry_t* find_entry(page_directory_t *dir, page_id_t page_id) {
+    directory_entry_t *entry = entry_slot(dir, page_id, false);
+    return entry && __atomic_load_n(&entry->is_valid, __ATOMIC_ACQUIRE) ? entry : NULL;
+}
+
+/* Find or create entry */
+static directory_entry_t* find_or_create_entry(page_directory_t *dir, page_id_t page_id) {
+    directory_entry_t *entry = entry_slot(dir, page_id, true);
+    if (!entry || __atomic_load_n(&entry->is_valid, __ATOMIC_ACQUIRE)) {
+        return entry;
+    }
+
+    pthread_mutex_t *lock = entry_lock(dir, page_id);
+    pthread_mutex_lock(lock);
+    if (!entry->is_valid) {
+        /* Initialize entry */
+        entry->page_id = page_id;
+        entry->owner = (node_id_t)-1;  /* Invalid owner initially */
+        entry->first_touch = false;
+        sharer_clear(&entry->sharers);   /* Keeps a removed entry's extension */
+        access_reset(&entry->access);
+        __atomic_store_n(&entry->is_valid, true, __ATOMIC_RELEASE);
+
+        size_t total = __atomic_add_fetch(&dir->num_entries, 1, __ATOMIC_RELAXED);
+        LOG_DEBUG("Created directory entry for page %lu (total entries: %zu)", page_id, total);
+    }
+    pthread_mutex_unlock(lock);
 
     return entry;
 }
 
 page_directory_t* directory_create(size_t table_size) {
-    page_directory_t *dir = malloc(sizeof(page_directory_t));
+    page_directory_t *dir = calloc(1, sizeof(page_directory_t));
     if (!dir) {
         LOG_ERROR("Failed to allocate directory");
         return NULL;
     }
 
-    /* Allocate hash table buckets (initialized to NULL) */
-    dir->buckets = calloc(table_size, sizeof(directory_entry_t*));
-    if (!dir->buckets) {
-        LOG_ERROR("Failed to allocate directory buckets");
-        free(dir);
-        return NULL;
+    for (int i = 0; i < DIRECTORY_LOCK_STRIPES; i++) {
+        pthread_mutex_init(&dir->stripes[i], NULL);
     }
-
+    pthread_mutex_init(&dir->lock, NULL);
     dir->table_size = table_size;
     dir->num_entries = 0;  /* Entries are created on-demand */
-    pthread_mutex_init(&dir->lock, NULL);
 
-    LOG_INFO("Created page directory with %zu buckets (hash table)", table_size);
+    LOG_INFO("Created page directory (flat range storage, %d lock stripes)", DIRECTORY_LOCK_STRIPES);
     return dir;
 }
 
 void directory_destroy(page_directory_t *dir) {
     if (!dir) return;
 
-    /* Free all entries in hash table */
-    for (size_t i = 0; i < dir->table_size; i++) {
-        directory_entry_t *entry = dir->buckets[i];
-        while (entry != NULL) {
-            directory_entry_t *next = entry->next;
-            pthread_mutex_destroy(&entry->lock);
-            free(entry);
-            entry = next;
+    /* Free all ranges and their entries */
+    for (size_t b = 0; b < DIRECTORY_RANGE_BUCKETS; b++) {
+        directory_range_t *range = dir->ranges[b];
+        while (range != NULL) {
+            directory_range_t *next = range->next;
+            for (size_t c = 0; c < DIRECTORY_RANGE_CHUNKS; c++) {
+                directory_entry_t *entries = range->chunks[c];
+                if (!entries) {
+                    continue;
+                }
+                for (size_t i = 0; i < DIRECTORY_CHUNK_PAGES; i++) {
+                    sharer_free(&entries[i].sharers);
+                }
+                free(entries);
+            }
+            free(range);
+            range = next;
         }
     }
 
+    for (int i = 0; i < DIRECTORY_LOCK_STRIPES; i++) {
+        pthread_mutex_destroy(&dir->stripes[i]);
+    }
     pthread_mutex_destroy(&dir->lock);
-    free(dir->buckets);
     free(dir);
 }
 
@@ -124,9 +336,9 @@ int directory_lookup(page_directory_t *dir, page_id_t page_id, node_id_t *owner)
         return DSM_ERROR_MEMORY;
     }
 
-    pthread_mutex_lock(&entry->lock);
+    pthread_mutex_lock(entry_lock(dir, page_id));
     *owner = entry->owner;
-    pthread_mutex_unlock(&entry->lock);
+    pthread_mutex_unlock(entry_lock(dir, page_id));
 
     return DSM_SUCCESS;
 }
@@ -142,35 +354,29 @@ int directory_add_reader(page_directory_t *dir, page_id_t page_id, node_id_t rea
         return DSM_ERROR_MEMORY;
     }
 
-    pthread_mutex_lock(&entry->lock);
+    pthread_mutex_lock(entry_lock(dir, page_id));
+    access_note_read(&entry->access);
 
-    /* Check if already in sharer list */
-    for (int i = 0; i < entry->sharers.count; i++) {
-        if (entry->sharers.nodes[i] == reader) {
-            pthread_mutex_unlock(&entry->lock);
-            return DSM_SUCCESS;  /* Already a sharer */
-        }
+    /* Check if already in sharer set */
+    if (sharer_test(&entry->sharers, reader)) {
+        pthread_mutex_unlock(entry_lock(dir, page_id));
+        return DSM_SUCCESS;  /* Already a sharer */
     }
 
-    /* Add to sharer list */
-    if (entry->sharers.count < MAX_SHARERS) {
-        entry->sharers.nodes[entry->sharers.count++] = reader;
-        LOG_DEBUG("Added node %u as sharer for page %lu", reader, page_id);
-    } else {
-        LOG_WARN("Sharer list full for page %lu", page_id);
-        pthread_mutex_unlock(&entry->lock);
-        return DSM_ERROR_BUSY;
+    /* Add to sharer set */
+    if (sharer_add(&entry->sharers, reader) != DSM_SUCCESS) {
+        LOG_ERROR("Failed to grow sharer set for page %lu (node %u)", page_id, reader);
+        pthread_mutex_unlock(entry_lock(dir, page_id));
+        return DSM_ERROR_MEMORY;
     }
+    LOG_DEBUG("Added node %u as sharer for page %lu", reader, page_id);
 
     /* Capture state for replication */
     node_id_t owner_copy = entry->owner;
-    int num_sharers = entry->sharers.count;
     node_id_t sharers_copy[MAX_SHARERS];
-    for (int i = 0; i < num_sharers; i++) {
-        sharers_copy[i] = entry->sharers.nodes[i];
-    }
+    int num_sharers = sharer_to_array(&entry->sharers, sharers_copy, MAX_SHARERS);
 
-    pthread_mutex_unlock(&entry->lock);
+    pthread_mutex_unlock(entry_lock(dir, page_id));
 
     /* Replicate to backup */
     dsm_context_t *ctx = dsm_get_context();
@@ -194,47 +400,36 @@ int directory_set_writer(page_directory_t *dir, page_id_t page_id, node_id_t wri
         return DSM_ERROR_MEMORY;
     }
 
-    pthread_mutex_lock(&entry->lock);
+    pthread_mutex_lock(entry_lock(dir, page_id));
+
+    /* Capture sharers (also needed for replication below) */
+    node_id_t sharers_copy[MAX_SHARERS];
+    int num_sharers = sharer_to_array(&entry->sharers, sharers_copy, MAX_SHARERS);
 
     /* Build invalidation list from current sharers */
     *num_invalidate = 0;
-    for (int i = 0; i < entry->sharers.count; i++) {
-        node_id_t sharer = entry->sharers.nodes[i];
-        if (sharer != writer) {  /* Don't invalidate the new writer */
-            invalidate_list[(*num_invalidate)++] = sharer;
+    for (int i = 0; i < num_sharers; i++) {
+        if (sharers_copy[i] != writer) {  /* Don't invalidate the new writer */
+            invalidate_list[(*num_invalidate)++] = sharers_copy[i];
         }
     }
 
-    /* If current owner is different and not the writer, add to invalidation list */
-    if (entry->owner != writer && entry->owner != (node_id_t)-1) {
-        bool already_in_list = false;
-        for (int i = 0; i < *num_invalidate; i++) {
-            if (invalidate_list[i] == entry->owner) {
-                already_in_list = true;
-                break;
-            }
-        }
-        if (!already_in_list) {
-            invalidate_list[(*num_invalidate)++] = entry->owner;
-        }
+    /* If current owner is different, not the writer and not already a sharer, invalidate it too */
+    if (entry->owner != writer && entry->owner != (node_id_t)-1 &&
+        !sharer_test(&entry->sharers, entry->owner) && *num_invalidate < MAX_SHARERS) {
+        invalidate_list[(*num_invalidate)++] = entry->owner;
     }
 
     /* Set new owner but DO NOT clear sharers yet
      * Sharers will be cleared after all invalidation ACKs are received
      * This prevents a race where new readers could be added before invalidations complete */
+    access_note_write(&entry->access, page_id, entry->owner, writer);
     entry->owner = writer;
 
     LOG_DEBUG("Set node %u as writer for page %lu (%d nodes to invalidate)",
               writer, page_id, *num_invalidate);
 
-    /* Capture state for replication */
-    int num_sharers = entry->sharers.count;
-    node_id_t sharers_copy[MAX_SHARERS];
-    for (int i = 0; i < num_sharers; i++) {
-        sharers_copy[i] = entry->sharers.nodes[i];
-    }
-
-    pthread_mutex_unlock(&entry->lock);
+    pthread_mutex_unlock(entry_lock(dir, page_id));
 
     /* Replicate to backup */
     dsm_context_t *ctx = dsm_get_context();
@@ -257,11 +452,11 @@ int directory_clear_sharers(page_directory_t *dir, page_id_t page_id) {
         return DSM_SUCCESS;  /* No entry, nothing to clear */
     }
 
-    pthread_mutex_lock(&entry->lock);
-    entry->sharers.count = 0;
+    pthread_mutex_lock(entry_lock(dir, page_id));
+    sharer_clear(&entry->sharers);
     node_id_t owner_copy = entry->owner;
     LOG_DEBUG("Cleared sharer list for page %lu", page_id);
-    pthread_mutex_unlock(&entry->lock);
+    pthread_mutex_unlock(entry_lock(dir, page_id));
 
     /* Replicate to backup */
     dsm_context_t *ctx = dsm_get_context();
@@ -273,6 +468,38 @@ int directory_clear_sharers(page_directory_t *dir, page_id_t page_id) {
     return DSM_SUCCESS;
 }
 
+int directory_remove_sharers(page_directory_t *dir, page_id_t page_id,
+                             const node_id_t *nodes, int count) {
+    if (!dir || (count > 0 && !nodes)) {
+        return DSM_ERROR_INVALID;
+    }
+
+    /* Find entry (don't create if doesn't exist) */
+    directory_entry_t *entry = find_entry(dir, page_id);
+    if (!entry) {
+        return DSM_SUCCESS;  /* No entry, nothing to remove */
+    }
+
+    pthread_mutex_lock(entry_lock(dir, page_id));
+    for (int i = 0; i < count; i++) {
+        sharer_remove(&entry->sharers, nodes[i]);
+    }
+    node_id_t owner_copy = entry->owner;
+    node_id_t sharers_copy[MAX_SHARERS];
+    int num_sharers = sharer_to_array(&entry->sharers, sharers_copy, MAX_SHARERS);
+    LOG_DEBUG("Removed %d invalidated sharers of page %lu, %d left", count, page_id, num_sharers);
+    pthread_mutex_unlock(entry_lock(dir, page_id));
+
+    /* Replicate to backup */
+    dsm_context_t *ctx = dsm_get_context();
+    if (ctx->config.is_manager && !ctx->network.backup_state.is_promoted) {
+        extern int send_state_sync_dir(page_id_t page_id, node_id_t owner, const node_id_t *sharers, int num_sharers);
+        send_state_sync_dir(page_id, owner_copy, sharers_copy, num_sharers);
+    }
+
+    return DSM_SUCCESS;
+}
+
 int directory_remove_sharer(page_directory_t *dir, page_id_t page_id, node_id_t node) {
     if (!dir) {
         return DSM_ERROR_INVALID;
@@ -284,22 +511,14 @@ int directory_remove_sharer(page_directory_t *dir, page_id_t page_id, node_id_t
         return DSM_SUCCESS;  /* Entry doesn't exist, nothing to remove */
     }
 
-    pthread_mutex_lock(&entry->lock);
+    pthread_mutex_lock(entry_lock(dir, page_id));
 
-    /* Find and remove node from sharer list */
-    for (int i = 0; i < entry->sharers.count; i++) {
-        if (entry->sharers.nodes[i] == node) {
-            /* Shift remaining elements */
-            for (int j = i; j < entry->sharers.count - 1; j++) {
-                entry->sharers.nodes[j] = entry->sharers.nodes[j + 1];
-            }
-            entry->sharers.count--;
-            LOG_DEBUG("Removed node %u from sharers of page %lu", node, page_id);
-            break;
-        }
+    /* Remove node from sharer set */
+    if (sharer_remove(&entry->sharers, node)) {
+        LOG_DEBUG("Removed node %u from sharers of page %lu", node, page_id);
     }
 
-    pthread_mutex_unlock(&entry->lock);
+    pthread_mutex_unlock(entry_lock(dir, page_id));
     return DSM_SUCCESS;
 }
 
@@ -316,18 +535,19 @@ int directory_get_sharers(page_directory_t *dir, page_id_t page_id,
         return DSM_SUCCESS;
     }
 
-    pthread_mutex_lock(&entry->lock);
+    pthread_mutex_lock(entry_lock(dir, page_id));
 
-    *count = entry->sharers.count;
-    for (int i = 0; i < entry->sharers.count; i++) {
-        sharers[i] = entry->sharers.nodes[i];
-    }
+    *count = sharer_to_array(&entry->sharers, sharers, MAX_SHARERS);
 
-    pthread_mutex_unlock(&entry->lock);
+    pthread_mutex_unlock(entry_lock(dir, page_id));
     return DSM_SUCCESS;
 }
 
-int directory_set_owner(page_directory_t *dir, page_id_t page_id, node_id_t owner) {
+/**
+ * Set the owner of a page, unless *keep is its owner (keep NULL: always)
+ */
+static int set_owner(page_directory_t *dir, page_id_t page_id, node_id_t owner,
+                     const node_id_t *keep) {
     if (!dir) {
         return DSM_ERROR_INVALID;
     }
@@ -338,17 +558,23 @@ int directory_set_owner(page_directory_t *dir, page_id_t page_id, node_id_t owne
         return DSM_ERROR_MEMORY;
     }
 
-    pthread_mutex_lock(&entry->lock);
+    pthread_mutex_lock(entry_lock(dir, page_id));
+    if (keep && entry->owner == *keep && *keep != owner) {
+        pthread_mutex_unlock(entry_lock(dir, page_id));
+        return DSM_ERROR_BUSY;
+    }
+
+    /* Placement and repeated updates of the same owner are not writes */
+    if (entry->owner != DSM_NODE_NONE && entry->owner != owner) {
+        access_note_write(&entry->access, page_id, entry->owner, owner);
+    }
     entry->owner = owner;
 
     /* Capture sharers for replication */
-    int num_sharers = entry->sharers.count;
     node_id_t sharers_copy[MAX_SHARERS];
-    for (int i = 0; i < num_sharers; i++) {
-        sharers_copy[i] = entry->sharers.nodes[i];
-    }
+    int num_sharers = sharer_to_array(&entry->sharers, sharers_copy, MAX_SHARERS);
 
-    pthread_mutex_unlock(&entry->lock);
+    pthread_mutex_unlock(entry_lock(dir, page_id));
 
     /* Replicate to backup (if manager and not promoted)
      * NOTE: This is done AFTER releasing the entry lock to avoid blocking
@@ -368,40 +594,87 @@ int directory_set_owner(page_directory_t *dir, page_id_t page_id, node_id_t owne
     return DSM_SUCCESS;
 }
 
-int directory_remove_entry(page_directory_t *dir, page_id_t page_id) {
+int directory_set_owner(page_directory_t *dir, page_id_t page_id, node_id_t owner) {
+    return set_owner(dir, page_id, owner, NULL);
+}
+
+int directory_update_owner(page_directory_t *dir, page_id_t page_id, node_id_t owner,
+                           node_id_t keep) {
+    return set_owner(dir, page_id, owner, &keep);
+}
+
+int directory_set_first_touch(page_directory_t *dir, page_id_t page_id) {
     if (!dir) {
         return DSM_ERROR_INVALID;
     }
 
-    size_t bucket = hash_page_id(page_id, dir->table_size);
+    directory_entry_t *entry = find_or_create_entry(dir, page_id);
+    if (!entry) {
+        return DSM_ERROR_MEMORY;
+    }
 
-    pthread_mutex_lock(&dir->lock);
+    pthread_mutex_lock(entry_lock(dir, page_id));
+    entry->owner = DSM_NODE_NONE;
+    entry->first_touch = true;
+    pthread_mutex_unlock(entry_lock(dir, page_id));
+    return DSM_SUCCESS;
+}
 
-    directory_entry_t **curr = &dir->buckets[bucket];
+int directory_claim_owner(page_directory_t *dir, page_id_t page_id, node_id_t claimant,
+                          node_id_t *owner) {
+    if (!dir || !owner) {
+        return DSM_ERROR_INVALID;
+    }
 
-    /* Search for entry in chain */
-    while (*curr != NULL) {
-        if ((*curr)->page_id == page_id) {
-            /* Found it - remove from chain */
-            directory_entry_t *to_free = *curr;
-            *curr = to_free->next;  /* Unlink from chain */
-            dir->num_entries--;
+    directory_entry_t *entry = find_or_create_entry(dir, page_id);
+    if (!entry) {
+        return DSM_ERROR_MEMORY;
+    }
 
-            pthread_mutex_unlock(&dir->lock);
+    pthread_mutex_lock(entry_lock(dir, page_id));
+    bool claimed = entry->first_touch && entry->owner == DSM_NODE_NONE;
+    if (claimed) {
+        entry->owner = claimant;
+        entry->first_touch = false;
+    }
+    *owner = entry->owner;
+    pthread_mutex_unlock(entry_lock(dir, page_id));
 
-            /* Free the entry (destroy its mutex first) */
-            pthread_mutex_destroy(&to_free->lock);
-            free(to_free);
+    if (claimed) {
+        LOG_DEBUG("Page %lu claimed by node %u on first touch", page_id, claimant);
+        /* Replicates the new owner to the backup like any other owner change */
+        directory_set_owner(dir, page_id, claimant);
+    }
+    return DSM_SUCCESS;
+}
 
-            LOG_DEBUG("Removed directory entry for page %lu (total entries: %zu)",
-                      page_id, dir->num_entries);
-            return DSM_SUCCESS;
-        }
-        curr = &(*curr)->next;
+int directory_remove_entry(page_directory_t *dir, page_id_t page_id) {
+    if (!dir) {
+        return DSM_ERROR_INVALID;
     }
 
-    pthread_mutex_unlock(&dir->lock);
-    return DSM_SUCCESS;  /* Entry not found, nothing to remove */
+    directory_entry_t *entry = find_entry(dir, page_id);
+    if (!entry) {
+        return DSM_SUCCESS;  /* Entry not found, nothing to remove */
+    }
+
+    /* The slot stays allocated with its chunk; only its state is dropped */
+    pthread_mutex_t *lock = entry_lock(dir, page_id);
+    pthread_mutex_lock(lock);
+    bool removed = entry->is_valid;
+    if (removed) {
+        __atomic_store_n(&entry->is_valid, false, __ATOMIC_RELEASE);
+        sharer_free(&entry->sharers);
+        entry->owner = (node_id_t)-1;
+        entry->first_touch = false;
+    }
+    pthread_mutex_unlock(lock);
+
+    if (removed) {
+        size_t total = __atomic_sub_fetch(&dir->num_entries, 1, __ATOMIC_RELAXED);
+        LOG_DEBUG("Removed directory entry for page %lu (total entries: %zu)", page_id, total);
+    }
+    return DSM_SUCCESS;
 }
 
 int directory_handle_node_failure(page_directory_t *dir, node_id_t failed_node) {
@@ -414,46 +687,48 @@ int directory_handle_node_failure(page_directory_t *dir, node_id_t failed_node)
     int pages_cleared = 0;
     int sharers_removed = 0;
 
-    pthread_mutex_lock(&dir->lock);
+    /* Linear scan of every range's entries */
+    for (size_t b = 0; b < DIRECTORY_RANGE_BUCKETS; b++) {
+        for (directory_range_t *range = __atomic_load_n(&dir->ranges[b], __ATOMIC_ACQUIRE);
+             range != NULL; range = range->next) {
+            for (size_t c = 0; c < DIRECTORY_RANGE_CHUNKS; c++) {
+                directory_entry_t *entries = __atomic_load_n(&range->chunks[c], __ATOMIC_ACQUIRE);
+                if (!entries) {
+                    continue;
+                }
 
-    /* Iterate through all buckets in hash table */
-    for (size_t bucket = 0; bucket < dir->table_size; bucket++) {
-        directory_entry_t *entry = dir->buckets[bucket];
+                for (size_t i = 0; i < DIRECTORY_CHUNK_PAGES; i++) {
+                    directory_entry_t *entry = &entries[i];
+                    page_id_t page_id = range->base + (c << DIRECTORY_CHUNK_SHIFT) + i;
+                    pthread_mutex_t *lock = entry_lock(dir, page_id);
 
-        /* Iterate through linked list in this bucket */
-        while (entry != NULL) {
-            pthread_mutex_lock(&entry->lock);
+                    pthread_mutex_lock(lock);
+                    if (!entry->is_valid) {
+                        pthread_mutex_unlock(lock);
+                        continue;
+                    }
 
-            /* If failed node owns this page, mark as unowned */
-            if (entry->owner == failed_node) {
-                entry->owner = (node_id_t)-1;  /* No owner */
-                pages_cleared++;
-                LOG_DEBUG("Cleared ownership of page %lu (was owned by failed node %u)",
-                         entry->page_id, failed_node);
-            }
+                    /* If failed node owns this page, mark as unowned */
+                    if (entry->owner == failed_node) {
+                        entry->owner = (node_id_t)-1;  /* No owner */
+                        pages_cleared++;
+                        LOG_DEBUG("Cleared ownership of page %lu (was owned by failed node %u)",
+                                 page_id, failed_node);
+                    }
 
-            /* Remove failed node from sharer list */
-            for (int i = 0; i < entry->sharers.count; i++) {
-                if (entry->sharers.nodes[i] == failed_node) {
-                    /* Shift remaining elements */
-                    for (int j = i; j < entry->sharers.count - 1; j++) {
-                        entry->sharers.nodes[j] = entry->sharers.nodes[j + 1];
+                    /* Remove failed node from sharer set */
+                    if (sharer_remove(&entry->sharers, failed_node)) {
+                        sharers_removed++;
+                        LOG_DEBUG("Removed failed node %u from sharers of page %lu",
+                                 failed_node, page_id);
                     }
-                    entry->sharers.count--;
-                    sharers_removed++;
-                    LOG_DEBUG("Removed failed node %u from sharers of page %lu",
-                             failed_node, entry->page_id);
-                    break;  /* Node can only appear once in sharer list */
+
+                    pthread_mutex_unlock(lock);
                 }
             }
-
-            pthread_mutex_unlock(&entry->lock);
-            entry = entry->next;
         }
     }
 
-    pthread_mutex_unlock(&dir->lock);
-
     LOG_INFO("Node %u failure cleanup complete: %d pages cleared, %d sharer entries removed",
              failed_node, pages_cleared, sharers_removed);
 
@@ -471,17 +746,17 @@ int directory_reclaim_ownership(page_directory_t *dir, page_id_t page_id, node_i
         return DSM_ERROR_MEMORY;
     }
 
-    pthread_mutex_lock(&entry->lock);
+    pthread_mutex_lock(entry_lock(dir, page_id));
 
     node_id_t old_owner = entry->owner;
 
     /* Transfer ownership to new owner */
     entry->owner = new_owner;
 
-    /* Clear sharer list (new owner has exclusive access) */
-    entry->sharers.count = 0;
+    /* Clear sharer set (new owner has exclusive access) */
+    sharer_clear(&entry->sharers);
 
-    pthread_mutex_unlock(&entry->lock);
+    pthread_mutex_unlock(entry_lock(dir, page_id));
 
     LOG_INFO("Reclaimed ownership of page %lu: old_owner=%u (failed), new_owner=%u",
              page_id, old_owner, new_owner);
@@ -489,67 +764,192 @@ int directory_reclaim_ownership(page_directory_t *dir, page_id_t page_id, node_i
     return DSM_SUCCESS;
 }
 
-int query_directory_manager(page_id_t page_id, node_id_t *owner) {
+int directory_note_invalidations(page_directory_t *dir, page_id_t page_id, int count) {
+    if (!dir || count < 0) {
+        return DSM_ERROR_INVALID;
+    }
+
+    directory_entry_t *entry = find_entry(dir, page_id);
+    if (!entry) {
+        return DSM_SUCCESS;
+    }
+
+    pthread_mutex_lock(entry_lock(dir, page_id));
+    entry->access.invalidations += (uint32_t)count;
+    pthread_mutex_unlock(entry_lock(dir, page_id));
+    return DSM_SUCCESS;
+}
+
+int directory_get_access(page_directory_t *dir, page_id_t page_id, directory_access_t *access) {
+    if (!dir || !access) {
+        return DSM_ERROR_INVALID;
+    }
+
+    directory_entry_t *entry = find_entry(dir, page_id);
+    if (!entry) {
+        access_reset(access);
+        return DSM_SUCCESS;
+    }
+
+    pthread_mutex_lock(entry_lock(dir, page_id));
+    *access = entry->access;
+    pthread_mutex_unlock(entry_lock(dir, page_id));
+    return DSM_SUCCESS;
+}
+
+directory_advice_t directory_advise(page_directory_t *dir, page_id_t page_id, node_id_t node) {
+    directory_access_t access;
+    if (directory_get_access(dir, page_id, &access) != DSM_SUCCESS) {
+        return DIRECTORY_ADVICE_NONE;
+    }
+
+    if (access.frozen_until_ns != 0 && access_now_ns() < access.frozen_until_ns) {
+        return DIRECTORY_ADVICE_FROZEN;
+    }
+    if (access.reads >= DIRECTORY_READ_MOSTLY_MIN &&
+        access.reads >= (uint64_t)access.writes * DIRECTORY_READ_MOSTLY_RATIO) {
+        return DIRECTORY_ADVICE_REPLICATE;
+    }
+    if (access.dominant_writer == node && access.dominant_votes >= DIRECTORY_MIGRATE_VOTES) {
+        return DIRECTORY_ADVICE_MIGRATE;
+    }
+    return DIRECTORY_ADVICE_NONE;
+}
+
+directory_advice_t directory_advice_for(page_id_t page_id, node_id_t node) {
     dsm_context_t *ctx = dsm_get_context();
+    if (!ctx->config.adaptive || rc_enabled() || !directory_is_local(page_id)) {
+        return DIRECTORY_ADVICE_NONE;
+    }
+    page_directory_t *dir = get_page_directory();
+    return dir ? directory_advise(dir, page_id, node) : DIRECTORY_ADVICE_NONE;
+}
 
-    /* PHASE 7: Check if we are the manager (could be Node 0 or promoted backup) */
-    if (ctx->config.is_manager || ctx->network.backup_state.is_promoted) {
-        page_directory_t *dir = get_page_directory();
-        return directory_lookup(dir, page_id, owner);
+int directory_note_advice(page_directory_t *dir, page_id_t page_id, directory_advice_t advice) {
+    if (!dir) {
+        return DSM_ERROR_INVALID;
+    }
+
+    directory_entry_t *entry = find_entry(dir, page_id);
+    if (!entry) {
+        return DSM_SUCCESS;
+    }
+
+    pthread_mutex_lock(entry_lock(dir, page_id));
+    entry->access.advice = (uint8_t)advice;
+    pthread_mutex_unlock(entry_lock(dir, page_id));
+    return DSM_SUCCESS;
+}
+
+directory_advice_t directory_page_advice(page_directory_t *dir, page_id_t page_id) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (!ctx->config.adaptive || rc_enabled()) {
+        return DIRECTORY_ADVICE_NONE;
+    }
+    if (directory_is_local(page_id)) {
+        return directory_advice_for(page_id, ctx->node_id);
+    }
+
+    directory_access_t access;
+    if (directory_get_access(dir, page_id, &access) != DSM_SUCCESS) {
+        return DIRECTORY_ADVICE_NONE;
     }
+    return (directory_advice_t)access.advice;
+}
+
+bool directory_distributed(void) {
+    dsm_context_t *ctx = dsm_get_context();
+    return ctx->config.directory == DSM_DIRECTORY_DISTRIBUTED && ctx->config.num_nodes > 1;
+}
 
-    /* If not manager, query manager via network */
-    pthread_mutex_lock(&ctx->network.dir_tracker.lock);
+node_id_t directory_node(page_id_t page_id) {
+    dsm_context_t *ctx = dsm_get_context();
 
     /* PHASE 7: Determine current manager (could be promoted backup) */
-    node_id_t manager_id = 0;  /* Default to Node 0 */
-    if (ctx->network.backup_state.current_manager != (node_id_t)-1 &&
-        ctx->network.backup_state.current_manager != 0) {
+    node_id_t manager_id = 0;
+    if (ctx->network.backup_state.current_manager != (node_id_t)-1) {
         manager_id = ctx->network.backup_state.current_manager;
-        LOG_DEBUG("Using promoted manager Node %u instead of Node 0", manager_id);
+    }
+    if (!directory_distributed()) {
+        return manager_id;
+    }
+
+    page_id_t run = (page_id & (PAGE_ID_MAX_PAGES - 1)) >> DIRECTORY_HOME_SHIFT;
+    page_id_t alloc = (page_id >> PAGE_ID_ALLOC_SHIFT) & (PAGE_ID_MAX_ALLOCATIONS - 1);
+    page_id_t spread = run + alloc + PAGE_ID_NODE(page_id);
+    node_id_t home = (node_id_t)(spread % (page_id_t)ctx->config.num_nodes);
+
+    /* A failed home's entries are gone; the manager answers from its own */
+    pthread_mutex_lock(&ctx->lock);
+    bool failed = home < (node_id_t)ctx->network.max_nodes && ctx->network.nodes[home].is_failed;
+    pthread_mutex_unlock(&ctx->lock);
+    return failed ? manager_id : home;
+}
+
+bool directory_is_local(page_id_t page_id) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    /* PHASE 7: The manager could be Node 0 or the promoted backup */
+    if (!directory_distributed()) {
+        return ctx->config.is_manager || ctx->network.backup_state.is_promoted;
+    }
+    return directory_node(page_id) == ctx->node_id;
+}
+
+int query_directory_manager(page_id_t page_id, node_id_t *owner) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    if (directory_is_local(page_id)) {
+        page_directory_t *dir = get_page_directory();
+        return directory_claim_owner(dir, page_id, ctx->node_id, owner);
+    }
+
+    /* Otherwise query the directory node via network.
+     * Each query gets its own slot in the in-flight table, so concurrent
+     * faulting threads no longer serialize behind a single round trip. */
+    node_id_t manager_id = directory_node(page_id);
+
+    /* A failed manager cannot answer; the caller waits for the promotion
+     * (a failed home already maps to the manager) */
+    pthread_mutex_lock(&ctx->lock);
+    bool manager_failed = manager_id < (node_id_t)ctx->network.max_nodes &&
+                          ctx->network.nodes[manager_id].is_failed;
+    pthread_mutex_unlock(&ctx->lock);
+    if (manager_failed) {
+        LOG_DEBUG("Manager Node %u failed, not querying page %lu", manager_id, page_id);
+        return DSM_ERROR_NETWORK;
     }
 
-    LOG_INFO("Querying directory for page %lu from manager Node %u (active=%d, complete=%d) from thread %d",
-             page_id, manager_id, ctx->network.dir_tracker.active, ctx->network.dir_tracker.complete,
-             (int)pthread_self());
+    uint64_t request_id = 0;
+    int slot = pending_query_register(&ctx->network.dir_queries, page_id, 5, &request_id);
+    if (slot < 0) {
+        return slot;
+    }
 
-    /* Setup tracker */
-    ctx->network.dir_tracker.page_id = page_id;
-    ctx->network.dir_tracker.active = true;
-    ctx->network.dir_tracker.complete = false;
+    LOG_DEBUG("Querying directory for page %lu from Node %u (request %lu) from thread %d",
+              page_id, manager_id, request_id, (int)pthread_self());
 
-    /* Send query to current manager */
-    int rc = send_dir_query(manager_id, page_id);
+    /* Send query to the page's directory node */
+    int rc = send_dir_query(manager_id, page_id, request_id);
     if (rc != DSM_SUCCESS) {
         LOG_ERROR("Failed to send DIR_QUERY for page %lu", page_id);
-        ctx->network.dir_tracker.active = false;
-        pthread_mutex_unlock(&ctx->network.dir_tracker.lock);
+        pending_query_cancel(&ctx->network.dir_queries, slot);
         return rc;
     }
 
-    LOG_INFO("Waiting for DIR_REPLY for page %lu...", page_id);
-
-    /* Wait for reply */
-    struct timespec timeout;
-    clock_gettime(CLOCK_REALTIME, &timeout);
-    timeout.tv_sec += 5; /* 5 second timeout (increased for WAN scenarios) */
+    LOG_DEBUG("Waiting for DIR_REPLY for page %lu...", page_id);
 
-    while (!ctx->network.dir_tracker.complete) {
-        rc = pthread_cond_timedwait(&ctx->network.dir_tracker.cv,
-                                   &ctx->network.dir_tracker.lock, &timeout);
-        if (rc == ETIMEDOUT) {
-            LOG_ERROR("Timeout querying directory manager for page %lu (active=%d, complete=%d)",
-                      page_id, ctx->network.dir_tracker.active, ctx->network.dir_tracker.complete);
-            ctx->network.dir_tracker.active = false;
-            pthread_mutex_unlock(&ctx->network.dir_tracker.lock);
-            return DSM_ERROR_TIMEOUT;
-        }
+    /* Wait for reply (5 second timeout, increased for WAN scenarios) */
+    pending_query_t result;
+    rc = pending_query_wait(&ctx->network.dir_queries, slot, 5, &result);
+    if (rc != DSM_SUCCESS) {
+        LOG_ERROR("Timeout querying directory manager for page %lu (request %lu)",
+                  page_id, request_id);
+        return DSM_ERROR_TIMEOUT;
     }
 
-    *owner = ctx->network.dir_tracker.owner;
-    LOG_INFO("DIR_QUERY complete for page %lu: owner=node %u", page_id, *owner);
-    ctx->network.dir_tracker.active = false;
+    *owner = result.owner;
+    LOG_DEBUG("DIR_QUERY complete for page %lu: owner=node %u", page_id, *owner);
 
-    pthread_mutex_unlock(&ctx->network.dir_tracker.lock);
     return DSM_SUCCESS;
 }
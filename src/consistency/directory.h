@@ -2,54 +2,142 @@
  * @file directory.h
  * @brief Page directory for tracking ownership and sharers
  *
- * This module maintains a centralized directory of page ownership and sharer lists,
+ * This module maintains the directory of page ownership and sharer lists,
  * implementing the single-writer/multiple-reader consistency protocol.
+ * Every node keeps one. The manager's answers for all pages, or with
+ * DSM_DIRECTORY_DISTRIBUTED each page's home node answers for it (see
+ * directory_node()).
  */
 
 #ifndef DIRECTORY_H
 #define DIRECTORY_H
 
 #include "dsm/types.h"
+#include "../memory/page_table.h"
 #include <pthread.h>
 #include <stdbool.h>
 
-/* Maximum number of sharers per page */
-#define MAX_SHARERS 16
-
 /**
- * List of nodes that have read-only copies
+ * Set of nodes that have read-only copies (bitmap indexed by node ID)
+ *
+ * Nodes 0-63 live in the inline word; higher node IDs spill into a
+ * heap-allocated extension that grows on demand.
  */
 typedef struct {
-    node_id_t nodes[MAX_SHARERS];
-    int count;
+    uint64_t bits;             /**< Nodes 0-63 */
+    uint64_t *ext_bits;        /**< Nodes 64 and up (NULL until needed) */
+    uint32_t ext_words;        /**< Number of words in ext_bits */
+    int count;                 /**< Number of bits set */
 } sharer_list_t;
 
 /**
- * Directory entry for one page (hash table node with chaining)
+ * Observed accesses to one page
+ *
+ * Reads count every read copy recorded, writes every write access
+ * granted, transfers the writes that moved ownership to another node.
+ * Counts are halved together once their sum reaches
+ * DIRECTORY_ACCESS_AGE_LIMIT, so old history fades. The dominant writer is
+ * a majority vote over the writes: a write by the candidate adds a vote,
+ * one by another node takes a vote away, and the candidate changes when
+ * its votes run out.
+ */
+typedef struct {
+    uint32_t reads;            /**< Read copies recorded */
+    uint32_t writes;           /**< Write accesses granted */
+    uint32_t invalidations;    /**< Copies invalidated by writes */
+    uint32_t transfers;        /**< Ownership moves between nodes */
+    node_id_t dominant_writer; /**< Majority candidate (DSM_NODE_NONE before the first write) */
+    uint32_t dominant_votes;   /**< Votes left to the candidate */
+    uint32_t window_transfers; /**< Transfers in the current ping-pong window */
+    uint64_t window_start_ns;  /**< Start of that window (CLOCK_MONOTONIC) */
+    uint64_t frozen_until_ns;  /**< Adaptive grants are off until then (ping-pong) */
+    uint8_t advice;            /**< directory_advice_t the page's directory node last sent this node */
+} directory_access_t;
+
+/**
+ * Directory entry for one page (slot in its range's flat storage)
  */
-typedef struct directory_entry_s {
+typedef struct {
     page_id_t page_id;
     node_id_t owner;           /**< Current owner (has write access) */
     sharer_list_t sharers;     /**< Nodes with read-only copies */
     bool is_valid;             /**< True if entry is in use */
-    pthread_mutex_t lock;      /**< Per-entry lock */
-    struct directory_entry_s *next;  /**< Next entry in hash chain */
+    bool first_touch;          /**< Unowned until the first node that faults on it claims it */
+    directory_access_t access; /**< Access pattern seen by this directory */
 } directory_entry_t;
 
 /**
- * Page directory structure (hash table implementation)
+ * What the access pattern of a page suggests (dsm_config_t.adaptive)
+ */
+typedef enum {
+    DIRECTORY_ADVICE_NONE = 0, /**< Use the plain protocol */
+    DIRECTORY_ADVICE_MIGRATE,  /**< Dominant writer: take ownership on a read fault */
+    DIRECTORY_ADVICE_REPLICATE,/**< Read-mostly: fetch a copy again after it is invalidated */
+    DIRECTORY_ADVICE_FROZEN    /**< Ping-pong: plain protocol until the cooling period ends */
+} directory_advice_t;
+
+/** Counts are halved when reads + writes reach this */
+#define DIRECTORY_ACCESS_AGE_LIMIT (1u << 16)
+/** Votes the dominant writer needs before its read faults take ownership */
+#define DIRECTORY_MIGRATE_VOTES 3
+/** Reads per write that make a page read-mostly */
+#define DIRECTORY_READ_MOSTLY_RATIO 8
+/** Reads before a page can be read-mostly */
+#define DIRECTORY_READ_MOSTLY_MIN 8
+/** Window over which ownership transfers are counted */
+#define DIRECTORY_PINGPONG_WINDOW_MS 50
+/** Transfers within one window that freeze a page */
+#define DIRECTORY_PINGPONG_TRANSFERS 8
+/** How long a frozen page stays on the plain protocol */
+#define DIRECTORY_COOLING_MS 200
+
+/** Entries per storage chunk */
+#define DIRECTORY_CHUNK_SHIFT 10
+#define DIRECTORY_CHUNK_PAGES (1u << DIRECTORY_CHUNK_SHIFT)
+/** Chunks covering one allocation's page ID range */
+#define DIRECTORY_RANGE_CHUNKS (PAGE_ID_MAX_PAGES / DIRECTORY_CHUNK_PAGES)
+/** Hash buckets for allocation ranges */
+#define DIRECTORY_RANGE_BUCKETS 256
+/** Locks striped over the entries */
+#define DIRECTORY_LOCK_STRIPES 256
+/** Consecutive pages of an allocation that share a home (DSM_DIRECTORY_DISTRIBUTED) */
+#define DIRECTORY_HOME_SHIFT 4
+
+/**
+ * Storage for the page IDs of one allocation
+ *
+ * Page IDs of an allocation are dense (see page_table.h), so its entries
+ * are flat arrays indexed by page, allocated a chunk at a time as pages
+ * are first tracked. Chunks never move or shrink before the directory is
+ * destroyed, so entry pointers stay valid.
+ */
+typedef struct directory_range_s {
+    page_id_t base;            /**< First page ID of the allocation */
+    directory_entry_t *chunks[DIRECTORY_RANGE_CHUNKS]; /**< NULL until a page in it is tracked */
+    struct directory_range_s *next;  /**< Next range in hash chain */
+} directory_range_t;
+
+/**
+ * Page directory structure (range-indexed flat storage)
+ *
+ * Lookups read ranges and chunks without locking; both are published
+ * once, under lock, and only freed by directory_destroy(). An entry is
+ * guarded by the stripe of its page ID, so consecutive pages use
+ * different locks.
  */
 typedef struct page_directory_s {
-    directory_entry_t **buckets;    /**< Hash table buckets (array of linked lists) */
-    size_t table_size;              /**< Number of hash buckets */
-    size_t num_entries;             /**< Number of pages currently tracked */
-    pthread_mutex_t lock;           /**< Global directory lock */
+    directory_range_t *ranges[DIRECTORY_RANGE_BUCKETS]; /**< Ranges by allocation */
+    pthread_mutex_t stripes[DIRECTORY_LOCK_STRIPES];    /**< Entry locks */
+    pthread_mutex_t lock;           /**< Serializes adding ranges and chunks */
+    size_t table_size;              /**< Size hint given to directory_create() */
+    size_t num_entries;             /**< Number of pages currently tracked (atomic) */
 } page_directory_t;
 
 /**
  * Create a page directory
+ * Storage grows with the page IDs tracked.
  *
- * @param num_pages Number of pages to track
+ * @param num_pages Number of pages expected (hint only)
  * @return Pointer to directory, or NULL on failure
  */
 page_directory_t* directory_create(size_t num_pages);
@@ -87,7 +175,7 @@ int directory_add_reader(page_directory_t *dir, page_id_t page_id, node_id_t rea
  * @param dir Page directory
  * @param page_id Page identifier
  * @param writer Node requesting write access
- * @param invalidate_list Output: list of nodes to invalidate
+ * @param invalidate_list Output: list of nodes to invalidate (room for MAX_SHARERS)
  * @param num_invalidate Output: number of nodes to invalidate
  * @return DSM_SUCCESS on success, error code on failure
  */
@@ -109,7 +197,7 @@ int directory_remove_sharer(page_directory_t *dir, page_id_t page_id, node_id_t
  *
  * @param dir Page directory
  * @param page_id Page identifier
- * @param sharers Output: array of sharer node IDs
+ * @param sharers Output: array of sharer node IDs (room for MAX_SHARERS), ascending
  * @param count Output: number of sharers
  * @return DSM_SUCCESS on success, error code on failure
  */
@@ -126,6 +214,44 @@ int directory_get_sharers(page_directory_t *dir, page_id_t page_id,
  */
 int directory_set_owner(page_directory_t *dir, page_id_t page_id, node_id_t owner);
 
+/**
+ * Set the owner of a page unless another node has claimed it meanwhile
+ *
+ * @param dir Page directory
+ * @param page_id Page identifier
+ * @param owner New owner node ID
+ * @param keep Owner that stays: it took the page after owner did
+ * @return DSM_SUCCESS on success, DSM_ERROR_BUSY if keep owns the page,
+ *         error code on failure
+ */
+int directory_update_owner(page_directory_t *dir, page_id_t page_id, node_id_t owner,
+                           node_id_t keep);
+
+/**
+ * Leave a page unowned until its first fault (DSM_PLACEMENT_FIRST_TOUCH)
+ *
+ * @param dir Page directory
+ * @param page_id Page identifier
+ * @return DSM_SUCCESS on success, error code on failure
+ */
+int directory_set_first_touch(page_directory_t *dir, page_id_t page_id);
+
+/**
+ * Look up the owner of a page on behalf of a faulting node
+ *
+ * Like directory_lookup(), but a first-touch page nobody has claimed
+ * becomes owned by the claimant, so concurrent first faults agree on one
+ * owner.
+ *
+ * @param dir Page directory
+ * @param page_id Page identifier
+ * @param claimant Node that faulted on the page
+ * @param owner Output: owner node ID (claimant if it claimed the page)
+ * @return DSM_SUCCESS on success, error code on failure
+ */
+int directory_claim_owner(page_directory_t *dir, page_id_t page_id, node_id_t claimant,
+                          node_id_t *owner);
+
 /**
  * Clear all sharers for a page
  * Should be called after all invalidation ACKs are received
@@ -136,6 +262,20 @@ int directory_set_owner(page_directory_t *dir, page_id_t page_id, node_id_t owne
  */
 int directory_clear_sharers(page_directory_t *dir, page_id_t page_id);
 
+/**
+ * Remove the sharers a writer has invalidated
+ * Unlike directory_clear_sharers(), readers added while the invalidations
+ * were out stay listed, so they are invalidated in turn.
+ *
+ * @param dir Page directory
+ * @param page_id Page identifier
+ * @param nodes Nodes to remove
+ * @param count Entries in nodes
+ * @return DSM_SUCCESS on success, error code on failure
+ */
+int directory_remove_sharers(page_directory_t *dir, page_id_t page_id,
+                             const node_id_t *nodes, int count);
+
 /**
  * Remove a directory entry (frees memory)
  * Should be called when a page is freed
@@ -171,9 +311,102 @@ int directory_handle_node_failure(page_directory_t *dir, node_id_t failed_node);
 int directory_reclaim_ownership(page_directory_t *dir, page_id_t page_id, node_id_t new_owner);
 
 /**
- * Query the directory manager (Node 0) for the current owner of a page.
- * If this node is Node 0, it performs a local lookup.
- * Otherwise, it sends a request to Node 0 and waits for the reply.
+ * Count copies of a page invalidated by a write
+ *
+ * @param dir Page directory
+ * @param page_id Page identifier
+ * @param count Copies invalidated
+ * @return DSM_SUCCESS on success, error code on failure
+ */
+int directory_note_invalidations(page_directory_t *dir, page_id_t page_id, int count);
+
+/**
+ * Copy the access counters of a page
+ *
+ * @param dir Page directory
+ * @param page_id Page identifier
+ * @param access Output: counters (all zero for an untracked page)
+ * @return DSM_SUCCESS on success, error code on failure
+ */
+int directory_get_access(page_directory_t *dir, page_id_t page_id, directory_access_t *access);
+
+/**
+ * Classify the access pattern of a page for one node
+ *
+ * A frozen page gets DIRECTORY_ADVICE_FROZEN until its cooling period
+ * ends. Otherwise a read-mostly page gets DIRECTORY_ADVICE_REPLICATE, and
+ * a page whose dominant writer is node, with DIRECTORY_MIGRATE_VOTES or
+ * more, gets DIRECTORY_ADVICE_MIGRATE.
+ *
+ * @param dir Page directory
+ * @param page_id Page identifier
+ * @param node Node the advice is for
+ * @return Advice (DIRECTORY_ADVICE_NONE for an untracked page)
+ */
+directory_advice_t directory_advise(page_directory_t *dir, page_id_t page_id, node_id_t node);
+
+/**
+ * Advice the page's directory node sends a node with a DIR_REPLY or INVALIDATE
+ *
+ * @param page_id Page identifier
+ * @param node Node the message goes to
+ * @return directory_advise() from this directory on the page's directory
+ *         node with dsm_config_t.adaptive (not under release consistency),
+ *         else DIRECTORY_ADVICE_NONE
+ */
+directory_advice_t directory_advice_for(page_id_t page_id, node_id_t node);
+
+/**
+ * Keep the advice a page's directory node sent this node
+ *
+ * @param dir Page directory
+ * @param page_id Page identifier
+ * @param advice Advice from the DIR_REPLY or INVALIDATE
+ * @return DSM_SUCCESS on success, error code on failure
+ */
+int directory_note_advice(page_directory_t *dir, page_id_t page_id, directory_advice_t advice);
+
+/**
+ * Advice for this node's own accesses to a page
+ *
+ * Only the page's directory node sees every node's accesses, so it alone
+ * decides: on it this is directory_advice_for() this node, elsewhere the
+ * advice it last sent (directory_note_advice()).
+ *
+ * @param dir Page directory
+ * @param page_id Page identifier
+ * @return Advice (DIRECTORY_ADVICE_NONE without dsm_config_t.adaptive)
+ */
+directory_advice_t directory_page_advice(page_directory_t *dir, page_id_t page_id);
+
+/**
+ * Whether pages have home nodes (DSM_DIRECTORY_DISTRIBUTED on a cluster)
+ */
+bool directory_distributed(void);
+
+/**
+ * Node whose directory answers for a page
+ *
+ * The current manager, or with the distributed directory the page's home:
+ * runs of 2^DIRECTORY_HOME_SHIFT pages are dealt out over the nodes in
+ * turn, each allocation starting at a different node. Pages of a failed
+ * home fall to the manager.
+ *
+ * @param page_id Page identifier
+ * @return Node ID
+ */
+node_id_t directory_node(page_id_t page_id);
+
+/**
+ * Whether this node's directory answers for a page
+ */
+bool directory_is_local(page_id_t page_id);
+
+/**
+ * Query the directory node of a page for its current owner.
+ * If this node is the directory node, it performs a local lookup.
+ * Otherwise, it sends a request there and waits for the reply.
+ * Either way a first-touch page nobody owns yet is claimed by this node.
  *
  * @param page_id Page identifier
  * @param owner Output: current owner node ID
@@ -5,11 +5,15 @@
 
 #include "page_migration.h"
 #include "directory.h"
+#include "prefetch.h"
 #include "../core/log.h"
 #include "../core/dsm_context.h"
+#include "../core/stats.h"
 #include "../core/perf_log.h"
 #include "../memory/page_table.h"
+#include "../memory/page_index.h"
 #include "../memory/permission.h"
+#include "../memory/userfault.h"
 #include "../network/handlers.h"
 #include <stdlib.h>
 #include <string.h>
@@ -20,9 +24,14 @@
 /* Global page directory (managed by manager node or replicated) */
 static page_directory_t *g_directory = NULL;
 
+/* Fetch retries that follow a write elsewhere before they cost an attempt */
+#define MAX_FREE_REFETCHES 8
+
 /**
  * Wait for manager reconnection after failover
- * Called when manager (Node 0) has failed and we're waiting for backup promotion
+ * Called when manager (Node 0) has failed and we're waiting for backup promotion.
+ * Sleeps on backup_state.manager_cv, so the caller resumes as soon as
+ * MANAGER_PROMOTION arrives rather than on the next poll.
  *
  * @param timeout_ms Timeout in milliseconds
  * @return DSM_SUCCESS if new manager is ready, DSM_ERROR_TIMEOUT if timeout
@@ -32,25 +41,21 @@ static int wait_for_manager_reconnection(int timeout_ms) {
 
     LOG_INFO("Waiting for manager reconnection (timeout=%dms)...", timeout_ms);
 
-    struct timespec start, now;
-    clock_gettime(CLOCK_MONOTONIC, &start);
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
 
     /* Wait for either:
      * 1. Manager (Node 0) to recover (unlikely in hot backup scenario)
      * 2. Backup (Node 1) to promote and become new manager
      */
+    pthread_mutex_lock(&ctx->lock);
     while (1) {
-        clock_gettime(CLOCK_MONOTONIC, &now);
-        long elapsed_ms = (now.tv_sec - start.tv_sec) * 1000 +
-                         (now.tv_nsec - start.tv_nsec) / 1000000;
-
-        if (elapsed_ms >= timeout_ms) {
-            LOG_ERROR("Timeout waiting for manager reconnection (%ld ms elapsed)", elapsed_ms);
-            return DSM_ERROR_TIMEOUT;
-        }
-
-        pthread_mutex_lock(&ctx->lock);
-
         /* Check if Node 0 has recovered */
         if (!ctx->network.nodes[0].is_failed) {
             pthread_mutex_unlock(&ctx->lock);
@@ -67,10 +72,12 @@ static int wait_for_manager_reconnection(int timeout_ms) {
             return DSM_SUCCESS;
         }
 
-        pthread_mutex_unlock(&ctx->lock);
-
-        /* Sleep briefly before checking again */
-        usleep(100000);  /* 100ms */
+        if (pthread_cond_timedwait(&ctx->network.backup_state.manager_cv,
+                                   &ctx->lock, &deadline) == ETIMEDOUT) {
+            pthread_mutex_unlock(&ctx->lock);
+            LOG_ERROR("Timeout waiting for manager reconnection (%d ms)", timeout_ms);
+            return DSM_ERROR_TIMEOUT;
+        }
     }
 }
 
@@ -106,49 +113,146 @@ void set_page_directory(page_directory_t *dir) {
     LOG_INFO("Page directory updated (failover support)");
 }
 
-int fetch_page_read(page_id_t page_id) {
+/**
+ * Resolve the node to send a PAGE_REQUEST to
+ *
+ * Workers first try the probable owner cached in entry->owner, which is kept
+ * current by PAGE_REQUEST (WRITE), INVALIDATE and earlier DIR_REPLYs. The
+ * manager forwards a request to the directory owner, and a stale owner NACKs
+ * with MSG_ERROR, so a wrong hint costs one retry at most. The directory is
+ * only consulted on a miss or after a failed attempt.
+ *
+ * @param table Page table holding the entry
+ * @param entry Page entry
+ * @param page_id Page ID
+ * @param use_hint True to try the cached owner before asking the manager
+ * @param owner Output: owner to request the page from
+ * @return DSM_SUCCESS or error code from query_directory_manager
+ */
+static int resolve_page_owner(page_table_t *table, page_entry_t *entry, page_id_t page_id,
+                              bool use_hint, node_id_t *owner) {
     dsm_context_t *ctx = dsm_get_context();
-    int final_result = DSM_SUCCESS;
 
-    LOG_INFO("fetch_page_read called for page %lu by thread %d", page_id, (int)pthread_self());
+    pthread_mutex_lock(&table->lock);
+    node_id_t hint = entry->owner;
+    pthread_mutex_unlock(&table->lock);
 
-    if (!ctx || ctx->num_allocations == 0 || !g_directory) {
-        LOG_ERROR("DSM not initialized");
-        return DSM_ERROR_INIT;
-    }
+    /* The directory node's lookup is local, so the hint only pays off elsewhere */
+    if (use_hint && !directory_is_local(page_id) &&
+        hint != ctx->node_id && hint < (node_id_t)ctx->network.max_nodes) {
+        pthread_mutex_lock(&ctx->lock);
+        bool hint_failed = ctx->network.nodes[hint].is_failed;
+        pthread_mutex_unlock(&ctx->lock);
 
-    /* Search all page tables for this page ID */
-    page_entry_t *entry = NULL;
-    page_table_t *owning_table = NULL;
+        if (!hint_failed) {
+            LOG_DEBUG("Using owner hint node %u for page %lu (skipping DIR_QUERY)", hint, page_id);
+            *owner = hint;
+            return DSM_SUCCESS;
+        }
+    }
 
-    pthread_mutex_lock(&ctx->lock);
-    for (int i = 0; i < ctx->num_allocations; i++) {
-        if (ctx->page_tables[i]) {
-            entry = page_table_lookup_by_id(ctx->page_tables[i], page_id);
-            if (entry) {
-                owning_table = ctx->page_tables[i];
-                page_table_acquire(owning_table); /* Protected: Prevent use-after-free */
-                break;
-            }
+    int rc = query_directory_manager(page_id, owner);
+    if (rc == DSM_SUCCESS && *owner < (node_id_t)ctx->network.max_nodes) {
+        /* Refresh the hint with the authoritative answer; the first owner
+         * of a first-touch page also becomes its home */
+        pthread_mutex_lock(&table->lock);
+        entry->owner = *owner;
+        if (entry->home == DSM_NODE_NONE) {
+            entry->home = *owner;
         }
+        pthread_mutex_unlock(&table->lock);
     }
-    pthread_mutex_unlock(&ctx->lock);
+    return rc;
+}
 
-    if (!entry) {
-        LOG_ERROR("Page %lu not found in any page table", page_id);
-        return DSM_ERROR_NOT_FOUND;
+/**
+ * Version of the copy this node still holds of a page, 0 if none
+ * Sent with PAGE_REQUEST so the owner can skip the page data when it matches.
+ */
+static uint64_t cached_page_version(page_table_t *table, page_entry_t *entry) {
+    pthread_mutex_lock(&table->lock);
+    uint64_t version = entry->version;
+    pthread_mutex_unlock(&table->lock);
+    return version;
+}
+
+/**
+ * Zero a page whose only valid copy was on a failed node
+ * Under userfaultfd the block is dropped instead: touching it here would
+ * fault, and granting access then maps it filled with zeros.
+ */
+static void zero_lost_page(page_table_t *table, page_entry_t *entry) {
+    if (userfault_active()) {
+        set_page_permission(entry->local_addr, PAGE_PERM_NONE);
+    } else {
+        memset(entry->local_addr, 0, table->block_size);
+    }
+}
+
+/**
+ * Note a remote fetch in the calling thread's fault path for the latency
+ * histograms. Mirrors send_page_request(): other nodes reach any owner but
+ * the page's directory node through the directory node.
+ */
+static void note_remote_path(page_id_t page_id, node_id_t owner, bool queued) {
+    unsigned path = STATS_PATH_REMOTE;
+    if (queued) {
+        path |= STATS_PATH_QUEUED;
+    }
+    if (!directory_is_local(page_id) && owner != directory_node(page_id)) {
+        path |= STATS_PATH_FORWARDED;
+    }
+    stats_fault_path = path;
+}
+
+/**
+ * Count a fetch retried because the page changed hands while it was out
+ *
+ * Each such retry follows another node's write, so the first few cost no
+ * attempt and no backoff. A page written without pause would keep the
+ * fetch looping, so past MAX_FREE_REFETCHES they count as failed attempts.
+ */
+static void count_refetch(int *refetches, int *retries) {
+    if (++*refetches > MAX_FREE_REFETCHES) {
+        (*retries)++;
+        usleep(100000 * *retries);
+    }
+}
+
+/**
+ * Fetch a page for read access with a reference to its table already held
+ * The reference is released before returning.
+ */
+static int fetch_page_read_ref(page_table_t *owning_table, page_entry_t *entry) {
+    dsm_context_t *ctx = dsm_get_context();
+    page_id_t page_id = entry->id;
+    int final_result = DSM_SUCCESS;
+
+    LOG_DEBUG("fetch_page_read called for page %lu by thread %d", page_id, (int)pthread_self());
+
+    /* A prefetch already in flight is cheaper to wait for than a new request */
+    if (prefetch_wait(owning_table, entry)) {
+        goto cleanup;
+    }
+
+    /* A page on its way to a writer is read from that writer once it lands */
+    if (directory_is_local(page_id)) {
+        handoff_wait(page_id);
     }
 
     int retries = 0;
     const int MAX_RETRIES = 3;
+    bool refetch = false;  /* Set once a reply was dropped as invalidated */
+    int refetches = 0;
 
     while (retries < MAX_RETRIES) {
-        /* Look up current owner in directory */
+        /* Look up current owner (cached hint on the first attempt, directory after) */
         node_id_t owner;
-        int rc = query_directory_manager(page_id, &owner);
+        int rc = resolve_page_owner(owning_table, entry, page_id, retries == 0 && !refetch, &owner);
         if (rc != DSM_SUCCESS) {
-            /* PHASE 7: Check if manager failed and wait for promotion */
-            if (rc == DSM_ERROR_TIMEOUT) {
+            /* PHASE 7: Check if manager failed and wait for promotion
+             * (queries to a failed manager are aborted or refused at once) */
+            if (rc == DSM_ERROR_TIMEOUT || rc == DSM_ERROR_NETWORK) {
                 pthread_mutex_lock(&ctx->lock);
                 bool manager_failed = ctx->network.nodes[0].is_failed;
                 pthread_mutex_unlock(&ctx->lock);
@@ -159,7 +263,6 @@ int fetch_page_read(page_id_t page_id) {
                     if (wait_rc == DSM_SUCCESS) {
                         LOG_INFO("New manager ready, retrying directory query");
                         retries++;
-                        usleep(100000);  /* Brief pause before retry */
                         continue;  /* Retry with new manager */
                     } else {
                         LOG_ERROR("Timeout waiting for manager promotion");
@@ -177,21 +280,40 @@ int fetch_page_read(page_id_t page_id) {
         LOG_DEBUG("Fetching page %lu for read from node %u (attempt %d/%d)", 
                   page_id, owner, retries + 1, MAX_RETRIES);
 
-        /* If we are the owner, just upgrade permission */
+        /* If we are the owner, just upgrade permission, unless a write
+         * request served since the lookup took the page (the hand-over
+         * holds the entry lock) or an INVALIDATE named another owner. The
+         * state is set under the same locks, before the permission */
         if (owner == ctx->node_id) {
-            rc = set_page_permission(entry->local_addr, PAGE_PERM_READ);
+            pthread_mutex_lock(page_entry_lock(entry));
+            pthread_mutex_lock(&owning_table->lock);
+            bool handed_over = entry->handed_over || entry->owner != ctx->node_id;
+            if (!handed_over) {
+                entry->state = PAGE_STATE_READ_ONLY;
+            }
+            pthread_mutex_unlock(&owning_table->lock);
+            if (!handed_over) {
+                rc = set_page_permission(entry->local_addr, PAGE_PERM_READ);
+            }
+            pthread_mutex_unlock(page_entry_lock(entry));
+            if (handed_over) {
+                LOG_DEBUG("Page %lu was handed to a writer, looking up its owner", page_id);
+                refetch = true;
+                count_refetch(&refetches, &retries);
+                continue;
+            }
             if (rc != DSM_SUCCESS) {
                 final_result = rc;
                 goto cleanup;
             }
-            entry->state = PAGE_STATE_READ_ONLY;
+            stats_fault_path = 0;
             LOG_DEBUG("Page %lu already owned, upgraded to READ_ONLY", page_id);
             final_result = DSM_SUCCESS;
             goto cleanup;
         }
 
         /* Task 8.1: Request queuing to prevent thundering herd */
-        pthread_mutex_lock(&entry->entry_lock);
+        pthread_mutex_lock(page_entry_lock(entry));
 
         /* Check if another thread is already fetching this page */
         if (entry->request_pending) {
@@ -206,11 +328,11 @@ int fetch_page_read(page_id_t page_id) {
             timeout.tv_sec += 5;  /* 5 second timeout */
 
             while (entry->request_pending) {
-                rc = pthread_cond_timedwait(&entry->ready_cv, &entry->entry_lock, &timeout);
+                rc = pthread_cond_timedwait(page_entry_ready_cv(entry), page_entry_lock(entry), &timeout);
                 if (rc != 0) {
                     LOG_ERROR("Timeout waiting for page %lu (queued thread)", page_id);
                     entry->num_waiting_threads--;
-                    pthread_mutex_unlock(&entry->entry_lock);
+                    pthread_mutex_unlock(page_entry_lock(entry));
                     perf_log_timeout();  /* Task 8.6 */
                     final_result = DSM_ERROR_TIMEOUT;
                     goto cleanup;
@@ -221,8 +343,13 @@ int fetch_page_read(page_id_t page_id) {
 
             /* CRITICAL FIX (BUG 1): Check fetch result before returning */
             int result = entry->fetch_result;
-            pthread_mutex_unlock(&entry->entry_lock);
+            pthread_mutex_unlock(page_entry_lock(entry));
 
+            if (result == DSM_ERROR_BUSY) {
+                refetch = true;  /* Invalidated in flight, see below */
+                count_refetch(&refetches, &retries);
+                continue;
+            }
             if (result != DSM_SUCCESS) {
                 LOG_WARN("Page %lu fetch failed in primary thread (result=%d), retrying...", page_id, result);
                 /* If primary failed, we retry the whole loop */
@@ -231,6 +358,7 @@ int fetch_page_read(page_id_t page_id) {
                 continue;
             }
 
+            note_remote_path(page_id, owner, true);
             LOG_DEBUG("Page %lu now available after queued wait", page_id);
             final_result = DSM_SUCCESS;
             goto cleanup;
@@ -238,17 +366,19 @@ int fetch_page_read(page_id_t page_id) {
 
         /* This thread will fetch the page */
         entry->request_pending = true;
-        pthread_mutex_unlock(&entry->entry_lock);
+        entry->fetch_invalidated = false;
+        pthread_mutex_unlock(page_entry_lock(entry));
 
         /* Send PAGE_REQUEST with READ access */
-        rc = send_page_request(owner, page_id, ACCESS_READ);
+        rc = send_page_request(owner, page_id, ACCESS_READ,
+                               cached_page_version(owning_table, entry));
         if (rc != DSM_SUCCESS) {
             LOG_ERROR("Failed to send PAGE_REQUEST to node %u", owner);
-            pthread_mutex_lock(&entry->entry_lock);
+            pthread_mutex_lock(page_entry_lock(entry));
             entry->fetch_result = rc;  /* BUG FIX: Set result before waking waiters */
             entry->request_pending = false;
-            pthread_cond_broadcast(&entry->ready_cv);  /* Wake any waiters */
-            pthread_mutex_unlock(&entry->entry_lock);
+            pthread_cond_broadcast(page_entry_ready_cv(entry));  /* Wake any waiters */
+            pthread_mutex_unlock(page_entry_lock(entry));
             
             retries++;
             usleep(100000 * retries);
@@ -256,20 +386,20 @@ int fetch_page_read(page_id_t page_id) {
         }
 
         /* Wait for PAGE_REPLY (with timeout) */
-        pthread_mutex_lock(&entry->entry_lock);
+        pthread_mutex_lock(page_entry_lock(entry));
         struct timespec timeout;
         clock_gettime(CLOCK_REALTIME, &timeout);
         timeout.tv_sec += 5;  /* 5 second timeout (Task 8.2) */
 
         while (entry->request_pending) {
-            rc = pthread_cond_timedwait(&entry->ready_cv, &entry->entry_lock, &timeout);
+            rc = pthread_cond_timedwait(page_entry_ready_cv(entry), page_entry_lock(entry), &timeout);
             if (rc != 0) {
                 LOG_ERROR("Timeout waiting for page %lu from node %u", page_id, owner);
 
                 /* CRITICAL FIX: Check if owner has failed and attempt recovery */
                 bool owner_failed = false;
                 pthread_mutex_lock(&ctx->lock);
-                if (owner < MAX_NODES && ctx->network.nodes[owner].is_failed) {
+                if (owner < (node_id_t)ctx->network.max_nodes && ctx->network.nodes[owner].is_failed) {
                     owner_failed = true;
                 }
                 pthread_mutex_unlock(&ctx->lock);
@@ -282,7 +412,12 @@ int fetch_page_read(page_id_t page_id) {
                     directory_reclaim_ownership(g_directory, page_id, ctx->node_id);
 
                     /* Initialize page with zeros (data lost from failed node) */
-                    memset(entry->local_addr, 0, PAGE_SIZE);
+                    zero_lost_page(owning_table, entry);
+
+                    /* Zeroed contents are a new version no other copy matches */
+                    pthread_mutex_lock(&owning_table->lock);
+                    entry->version = page_next_version();
+                    pthread_mutex_unlock(&owning_table->lock);
 
                     /* Set permission to READ */
                     rc = set_page_permission(entry->local_addr, PAGE_PERM_READ);
@@ -290,19 +425,21 @@ int fetch_page_read(page_id_t page_id) {
                         LOG_ERROR("Failed to set page permission after recovery");
                         entry->fetch_result = rc;
                         entry->request_pending = false;
-                        pthread_cond_broadcast(&entry->ready_cv);
-                        pthread_mutex_unlock(&entry->entry_lock);
+                        pthread_cond_broadcast(page_entry_ready_cv(entry));
+                        pthread_mutex_unlock(page_entry_lock(entry));
                         final_result = rc;
                         goto cleanup;
                     }
 
                     entry->state = PAGE_STATE_READ_ONLY;
                     entry->owner = ctx->node_id;
+                    entry->handed_over = false;
+                    note_remote_path(page_id, owner, false);  /* Paid the remote timeout */
 
                     entry->fetch_result = DSM_SUCCESS;
                     entry->request_pending = false;
-                    pthread_cond_broadcast(&entry->ready_cv);
-                    pthread_mutex_unlock(&entry->entry_lock);
+                    pthread_cond_broadcast(page_entry_ready_cv(entry));
+                    pthread_mutex_unlock(page_entry_lock(entry));
 
                     LOG_INFO("Successfully recovered page %lu from failed node %u", page_id, owner);
                     final_result = DSM_SUCCESS;  /* Recovery successful */
@@ -315,8 +452,8 @@ int fetch_page_read(page_id_t page_id) {
                 /* We assume timeout for now if we are here and rc != 0 */
                 entry->fetch_result = DSM_ERROR_TIMEOUT;
                 entry->request_pending = false;
-                pthread_cond_broadcast(&entry->ready_cv);  /* Wake any waiters with error */
-                pthread_mutex_unlock(&entry->entry_lock);
+                pthread_cond_broadcast(page_entry_ready_cv(entry));  /* Wake any waiters with error */
+                pthread_mutex_unlock(page_entry_lock(entry));
                 perf_log_timeout();  /* Task 8.6 */
 
                 /* Retry loop will catch this */
@@ -328,7 +465,7 @@ int fetch_page_read(page_id_t page_id) {
         int result = entry->fetch_result;
         if (!entry->request_pending) {
              /* Loop finished (either success or error signaled) */
-             pthread_mutex_unlock(&entry->entry_lock);
+             pthread_mutex_unlock(page_entry_lock(entry));
              
              if (result == DSM_SUCCESS) {
                  /* Success path */
@@ -339,14 +476,19 @@ int fetch_page_read(page_id_t page_id) {
                      goto cleanup;
                  }
                  
-                 entry->state = PAGE_STATE_READ_ONLY;
-                 pthread_mutex_lock(&ctx->stats_lock);
-                 ctx->stats.pages_fetched++;
-                 pthread_mutex_unlock(&ctx->stats_lock);
+                 /* The reply handler set the state before waking us */
+                 STATS_INC(pages_fetched);
+                 note_remote_path(page_id, owner, false);
                  
                  LOG_DEBUG("Successfully fetched page %lu for read", page_id);
                  final_result = DSM_SUCCESS;
                  goto cleanup;
+             } else if (result == DSM_ERROR_BUSY) {
+                 /* Written while the reply was in flight */
+                 LOG_DEBUG("Page %lu invalidated during fetch, fetching again", page_id);
+                 refetch = true;
+                 count_refetch(&refetches, &retries);
+                 continue;
              } else {
                  /* Error path (including DSM_ERROR_INVALID from stale owner) */
                  LOG_WARN("Fetch failed with code %d, retrying...", result);
@@ -356,7 +498,7 @@ int fetch_page_read(page_id_t page_id) {
              }
         } else {
             /* Should not happen if logic above is correct (lock held) */
-            pthread_mutex_unlock(&entry->entry_lock);
+            pthread_mutex_unlock(page_entry_lock(entry));
         }
     }
 
@@ -370,49 +512,39 @@ cleanup:
     return final_result;
 }
 
-int fetch_page_write(page_id_t page_id) {
+/**
+ * Fetch a page for write access with a reference to its table already held
+ * The reference is released before returning.
+ */
+static int fetch_page_write_ref(page_table_t *owning_table, page_entry_t *entry) {
     dsm_context_t *ctx = dsm_get_context();
+    page_id_t page_id = entry->id;
     int final_result = DSM_SUCCESS;
 
-    LOG_INFO("fetch_page_write called for page %lu by thread %d", page_id, (int)pthread_self());
+    LOG_DEBUG("fetch_page_write called for page %lu by thread %d", page_id, (int)pthread_self());
 
-    if (!ctx || ctx->num_allocations == 0 || !g_directory) {
-        LOG_ERROR("DSM not initialized");
-        return DSM_ERROR_INIT;
-    }
+    /* Let a prefetch in flight land first; the write request then skips the data */
+    prefetch_wait(owning_table, entry);
 
-    /* Search all page tables for this page ID */
-    page_entry_t *entry = NULL;
-    page_table_t *owning_table = NULL;
-
-    pthread_mutex_lock(&ctx->lock);
-    for (int i = 0; i < ctx->num_allocations; i++) {
-        if (ctx->page_tables[i]) {
-            entry = page_table_lookup_by_id(ctx->page_tables[i], page_id);
-            if (entry) {
-                owning_table = ctx->page_tables[i];
-                page_table_acquire(owning_table); /* Protected: Prevent use-after-free */
-                break;
-            }
-        }
-    }
-    pthread_mutex_unlock(&ctx->lock);
-
-    if (!entry) {
-        LOG_ERROR("Page %lu not found in any page table", page_id);
-        return DSM_ERROR_NOT_FOUND;
-    }
+    /* The directory node's own writes take their turn in the page's
+     * hand-offs, so requests for the page wait until it has landed here */
+    bool directory_local = directory_is_local(page_id);
+    bool handoff_held = directory_local && handoff_acquire(page_id);
 
     int retries = 0;
     const int MAX_RETRIES = 3;
+    int refetches = 0;
 
     while (retries < MAX_RETRIES) {
-        /* Look up current owner and get invalidation list */
+        /* Look up current owner and get invalidation list
+         * Writes always ask the directory: the sharer list comes from the owner,
+         * so a stale hint here could miss invalidations */
         node_id_t owner;
-        int rc = query_directory_manager(page_id, &owner);
+        int rc = resolve_page_owner(owning_table, entry, page_id, false, &owner);
         if (rc != DSM_SUCCESS) {
-            /* PHASE 7: Check if manager failed and wait for promotion */
-            if (rc == DSM_ERROR_TIMEOUT) {
+            /* PHASE 7: Check if manager failed and wait for promotion
+             * (queries to a failed manager are aborted or refused at once) */
+            if (rc == DSM_ERROR_TIMEOUT || rc == DSM_ERROR_NETWORK) {
                 pthread_mutex_lock(&ctx->lock);
                 bool manager_failed = ctx->network.nodes[0].is_failed;
                 pthread_mutex_unlock(&ctx->lock);
@@ -423,7 +555,6 @@ int fetch_page_write(page_id_t page_id) {
                     if (wait_rc == DSM_SUCCESS) {
                         LOG_INFO("New manager ready, retrying directory query for WRITE");
                         retries++;
-                        usleep(100000);  /* Brief pause before retry */
                         continue;  /* Retry with new manager */
                     } else {
                         LOG_ERROR("Timeout waiting for manager promotion (WRITE)");
@@ -442,7 +573,7 @@ int fetch_page_write(page_id_t page_id) {
                   page_id, owner, retries + 1, MAX_RETRIES);
 
         /* Task 8.1: Request queuing for write requests */
-        pthread_mutex_lock(&entry->entry_lock);
+        pthread_mutex_lock(page_entry_lock(entry));
 
         /* Check if another thread is already fetching this page for write */
         if (entry->request_pending) {
@@ -457,11 +588,11 @@ int fetch_page_write(page_id_t page_id) {
             timeout.tv_sec += 10;  /* 10 second timeout for writes (longer than reads) */
 
             while (entry->request_pending) {
-                rc = pthread_cond_timedwait(&entry->ready_cv, &entry->entry_lock, &timeout);
+                rc = pthread_cond_timedwait(page_entry_ready_cv(entry), page_entry_lock(entry), &timeout);
                 if (rc != 0) {
                     LOG_ERROR("Timeout waiting for page %lu (write, queued thread)", page_id);
                     entry->num_waiting_threads--;
-                    pthread_mutex_unlock(&entry->entry_lock);
+                    pthread_mutex_unlock(page_entry_lock(entry));
                     perf_log_timeout();  /* Task 8.6 */
                     final_result = DSM_ERROR_TIMEOUT;
                     goto cleanup;
@@ -472,8 +603,12 @@ int fetch_page_write(page_id_t page_id) {
 
             /* CRITICAL FIX (BUG 2): Check fetch result before returning */
             int result = entry->fetch_result;
-            pthread_mutex_unlock(&entry->entry_lock);
+            pthread_mutex_unlock(page_entry_lock(entry));
 
+            if (result == DSM_ERROR_BUSY) {
+                count_refetch(&refetches, &retries);
+                continue;  /* Shared during its upgrade, see below */
+            }
             if (result != DSM_SUCCESS) {
                 LOG_WARN("Page %lu write fetch failed in primary thread (result=%d), retrying...", page_id, result);
                 /* If primary failed, we retry the whole loop */
@@ -482,90 +617,117 @@ int fetch_page_write(page_id_t page_id) {
                 continue;
             }
 
+            note_remote_path(page_id, owner, true);
             LOG_DEBUG("Page %lu now available after queued write wait", page_id);
             final_result = DSM_SUCCESS;
             goto cleanup;
         }
 
+        /* A write request served since the lookup took the page */
+        if (owner == ctx->node_id && entry->handed_over) {
+            pthread_mutex_unlock(page_entry_lock(entry));
+            LOG_DEBUG("Page %lu was handed to a writer, looking up its owner", page_id);
+            count_refetch(&refetches, &retries);
+            continue;
+        }
+
         /* This thread will fetch the page */
         entry->request_pending = true;
-        pthread_mutex_unlock(&entry->entry_lock);
+        uint32_t reads_served = entry->reads_served;
 
-        /* CRITICAL FIX (BUG #8): Query current owner for complete sharer list
-         * The owner has been tracking all nodes that requested READ access */
+        /* Update our local directory; it returns the sharers it knows of.
+         * Under the entry lock, which a hand-over holds while it names its
+         * writer in the manager's directory, so this cannot name us again
+         * after it */
         node_id_t invalidate_list[MAX_SHARERS];
         int num_invalidate = 0;
-
-        if (owner != ctx->node_id) {
-            /* Query owner for sharers before invalidating */
-            pthread_mutex_lock(&ctx->network.sharer_tracker.lock);
-            ctx->network.sharer_tracker.page_id = page_id;
-            ctx->network.sharer_tracker.active = true;
-            ctx->network.sharer_tracker.complete = false;
-            ctx->network.sharer_tracker.num_sharers = 0;
-
-            rc = send_sharer_query(owner, page_id);
-            if (rc == DSM_SUCCESS) {
-                /* Wait for reply with timeout */
-                struct timespec timeout;
-                clock_gettime(CLOCK_REALTIME, &timeout);
-                timeout.tv_sec += 2;
-
-                while (!ctx->network.sharer_tracker.complete) {
-                    rc = pthread_cond_timedwait(&ctx->network.sharer_tracker.cv,
-                                               &ctx->network.sharer_tracker.lock, &timeout);
-                    if (rc == ETIMEDOUT) {
-                        LOG_WARN("Timeout querying sharers for page %lu from node %u",
-                                page_id, owner);
-                        break;
-                    }
-                }
-
-                /* Copy sharers to invalidation list */
-                if (ctx->network.sharer_tracker.complete) {
-                    for (int i = 0; i < ctx->network.sharer_tracker.num_sharers && i < MAX_SHARERS; i++) {
-                        invalidate_list[num_invalidate++] = ctx->network.sharer_tracker.sharers[i];
-                    }
-                    LOG_DEBUG("Got %d sharers for page %lu from owner", num_invalidate, page_id);
-                }
-            }
-
-            ctx->network.sharer_tracker.active = false;
-            pthread_mutex_unlock(&ctx->network.sharer_tracker.lock);
-        }
-
-        /* Also add current owner to invalidation list if different from us */
-        if (owner != ctx->node_id) {
-            bool already_in_list = false;
-            for (int i = 0; i < num_invalidate; i++) {
-                if (invalidate_list[i] == owner) {
-                    already_in_list = true;
-                    break;
-                }
-            }
-            if (!already_in_list && num_invalidate < MAX_SHARERS) {
-                invalidate_list[num_invalidate++] = owner;
-            }
-        }
-
-        /* Update our local directory */
         rc = directory_set_writer(g_directory, page_id, ctx->node_id,
                                   invalidate_list, &num_invalidate);
         if (rc != DSM_SUCCESS) {
             LOG_ERROR("Failed to update local directory for page %lu", page_id);
-            pthread_mutex_lock(&entry->entry_lock);
             entry->fetch_result = rc;
             entry->request_pending = false;
-            pthread_cond_broadcast(&entry->ready_cv);
-            pthread_mutex_unlock(&entry->entry_lock);
+            pthread_cond_broadcast(page_entry_ready_cv(entry));
+            pthread_mutex_unlock(page_entry_lock(entry));
             final_result = rc;
             goto cleanup;
         }
+        pthread_mutex_unlock(page_entry_lock(entry));
+
+        /* Exactly these leave the sharer list once acked (and this node) */
+        node_id_t invalidated[MAX_SHARERS + 1];
+        int num_invalidated = num_invalidate;
+        memcpy(invalidated, invalidate_list, (size_t)num_invalidate * sizeof(node_id_t));
+        invalidated[num_invalidated++] = ctx->node_id;
+
+        /* CRITICAL FIX: Never invalidate the owner we fetch from
+         * The PAGE_REQUEST below makes the owner invalidate its own copy as it
+         * hands the page over. Invalidated first, it would have no page left
+         * to serve, and writes it made since our copy was taken would be lost */
+        if (owner != ctx->node_id) {
+            int kept = 0;
+            for (int i = 0; i < num_invalidate; i++) {
+                if (invalidate_list[i] != owner) {
+                    invalidate_list[kept++] = invalidate_list[i];
+                }
+            }
+            num_invalidate = kept;
+        }
+
+        int acks_expected = num_invalidate;
+        bool upgrade_sent = false;
+        if (!directory_local && owner != ctx->node_id) {
+            /* One PAGE_UPGRADE: the directory node invalidates the sharers,
+             * then forwards the write request to the owner, which skips the
+             * data if our copy is current */
+            node_id_t manager_id = directory_node(page_id);
+
+            rc = send_page_upgrade(manager_id, page_id, owner,
+                                   cached_page_version(owning_table, entry),
+                                   invalidate_list, num_invalidate);
+            if (rc != DSM_SUCCESS) {
+                LOG_ERROR("Failed to send PAGE_UPGRADE for page %lu to node %u",
+                          page_id, manager_id);
+                pthread_mutex_lock(page_entry_lock(entry));
+                entry->fetch_result = rc;
+                entry->request_pending = false;
+                pthread_cond_broadcast(page_entry_ready_cv(entry));
+                pthread_mutex_unlock(page_entry_lock(entry));
 
-        /* Initialize ACK counter before sending invalidations */
-        pthread_mutex_lock(&entry->entry_lock);
-        entry->pending_inv_acks = num_invalidate;
-        pthread_mutex_unlock(&entry->entry_lock);
+                retries++;
+                usleep(100000 * retries);
+                continue;
+            }
+            upgrade_sent = true;
+            acks_expected = 0;
+            num_invalidate = 0;  /* The manager sends them */
+        } else if (!directory_local) {
+            /* CRITICAL FIX (BUG #8): Every read of a page passed through its
+             * directory node, so that node invalidates all sharers in
+             * parallel and sends one aggregated ACK */
+            node_id_t manager_id = directory_node(page_id);
+
+            pthread_mutex_lock(page_entry_lock(entry));
+            entry->pending_inv_acks = 1;
+            pthread_mutex_unlock(page_entry_lock(entry));
+
+            rc = send_invalidate_fanout(manager_id, page_id, DSM_NODE_NONE,
+                                        invalidate_list, num_invalidate);
+            if (rc != DSM_SUCCESS) {
+                LOG_WARN("Failed to send INVALIDATE_FANOUT for page %lu to node %u",
+                         page_id, manager_id);
+                pthread_mutex_lock(page_entry_lock(entry));
+                entry->pending_inv_acks = 0;
+                pthread_mutex_unlock(page_entry_lock(entry));
+            }
+            acks_expected = 1;
+            num_invalidate = 0;  /* The manager sends them */
+        } else {
+            /* Initialize ACK counter before sending invalidations */
+            pthread_mutex_lock(page_entry_lock(entry));
+            entry->pending_inv_acks = (int16_t)num_invalidate;
+            pthread_mutex_unlock(page_entry_lock(entry));
+        }
 
         /* CRITICAL FIX #3: Send invalidations to all sharers (skip failed nodes) */
         for (int i = 0; i < num_invalidate; i++) {
@@ -574,7 +736,7 @@ int fetch_page_write(page_id_t page_id) {
             /* Skip failed nodes */
             bool is_failed = false;
             pthread_mutex_lock(&ctx->lock);
-            if (target < MAX_NODES && ctx->network.nodes[target].is_failed) {
+            if (target < (node_id_t)ctx->network.max_nodes && ctx->network.nodes[target].is_failed) {
                 is_failed = true;
                 LOG_WARN("Skipping invalidation to failed node %u for page %lu",
                          target, page_id);
@@ -583,38 +745,36 @@ int fetch_page_write(page_id_t page_id) {
 
             if (is_failed) {
                 /* Decrement pending count for failed node */
-                pthread_mutex_lock(&entry->entry_lock);
+                pthread_mutex_lock(page_entry_lock(entry));
                 entry->pending_inv_acks--;
-                pthread_mutex_unlock(&entry->entry_lock);
+                pthread_mutex_unlock(page_entry_lock(entry));
                 continue;
             }
 
             LOG_DEBUG("Sending invalidation for page %lu to node %u",
                       page_id, target);
-            rc = send_invalidate(target, page_id);
+            rc = send_invalidate(target, page_id, ctx->node_id);
             if (rc != DSM_SUCCESS) {
                 LOG_WARN("Failed to send invalidation to node %u", target);
                 /* Decrement pending count if send failed */
-                pthread_mutex_lock(&entry->entry_lock);
+                pthread_mutex_lock(page_entry_lock(entry));
                 entry->pending_inv_acks--;
-                pthread_mutex_unlock(&entry->entry_lock);
+                pthread_mutex_unlock(page_entry_lock(entry));
             } else {
                 /* Update stats only on successful send */
-                pthread_mutex_lock(&ctx->stats_lock);
-                ctx->stats.invalidations_sent++;
-                pthread_mutex_unlock(&ctx->stats_lock);
+                STATS_INC(invalidations_sent);
             }
         }
 
         /* Wait for all invalidation ACKs with timeout */
-        if (num_invalidate > 0) {
-            pthread_mutex_lock(&entry->entry_lock);
+        if (acks_expected > 0) {
+            pthread_mutex_lock(page_entry_lock(entry));
             struct timespec timeout;
             clock_gettime(CLOCK_REALTIME, &timeout);
             timeout.tv_sec += 5;  /* 5 second timeout for ACKs */
 
             while (entry->pending_inv_acks > 0) {
-                rc = pthread_cond_timedwait(&entry->inv_ack_cv, &entry->entry_lock, &timeout);
+                rc = pthread_cond_timedwait(page_entry_inv_ack_cv(entry), page_entry_lock(entry), &timeout);
                 if (rc == ETIMEDOUT) {
                     LOG_WARN("Timeout waiting for %d invalidation ACKs for page %lu",
                              entry->pending_inv_acks, page_id);
@@ -622,24 +782,28 @@ int fetch_page_write(page_id_t page_id) {
                     break;
                 }
             }
-            pthread_mutex_unlock(&entry->entry_lock);
+            pthread_mutex_unlock(page_entry_lock(entry));
             LOG_DEBUG("Received all invalidation ACKs for page %lu", page_id);
         }
 
-        /* All invalidations complete - now safe to clear sharers */
-        directory_clear_sharers(g_directory, page_id);
-
         /* If we were not the owner, request page data */
         if (owner != ctx->node_id) {
-            /* Send PAGE_REQUEST with WRITE access */
-            rc = send_page_request(owner, page_id, ACCESS_WRITE);
+            /* All invalidations complete - now safe to drop those sharers */
+            directory_remove_sharers(g_directory, page_id, invalidated, num_invalidated);
+
+            /* Send PAGE_REQUEST with WRITE access, unless the upgrade carries it */
+            rc = DSM_SUCCESS;
+            if (!upgrade_sent) {
+                rc = send_page_request(owner, page_id, ACCESS_WRITE,
+                                       cached_page_version(owning_table, entry));
+            }
             if (rc != DSM_SUCCESS) {
                 LOG_ERROR("Failed to send PAGE_REQUEST to node %u", owner);
-                pthread_mutex_lock(&entry->entry_lock);
+                pthread_mutex_lock(page_entry_lock(entry));
                 entry->fetch_result = rc;  /* BUG FIX: Set result before waking waiters */
                 entry->request_pending = false;
-                pthread_cond_broadcast(&entry->ready_cv);
-                pthread_mutex_unlock(&entry->entry_lock);
+                pthread_cond_broadcast(page_entry_ready_cv(entry));
+                pthread_mutex_unlock(page_entry_lock(entry));
                 
                 retries++;
                 usleep(100000 * retries);
@@ -647,20 +811,20 @@ int fetch_page_write(page_id_t page_id) {
             }
 
             /* Wait for PAGE_REPLY (with timeout) */
-            pthread_mutex_lock(&entry->entry_lock);
+            pthread_mutex_lock(page_entry_lock(entry));
             struct timespec timeout;
             clock_gettime(CLOCK_REALTIME, &timeout);
             timeout.tv_sec += 10;  /* 10 second timeout (Task 8.2) */
 
             while (entry->request_pending) {
-                rc = pthread_cond_timedwait(&entry->ready_cv, &entry->entry_lock, &timeout);
+                rc = pthread_cond_timedwait(page_entry_ready_cv(entry), page_entry_lock(entry), &timeout);
                 if (rc != 0) {
                     LOG_ERROR("Timeout waiting for page %lu from node %u (WRITE)", page_id, owner);
 
                     /* CRITICAL FIX: Check if owner has failed and attempt recovery */
                     bool owner_failed = false;
                     pthread_mutex_lock(&ctx->lock);
-                    if (owner < MAX_NODES && ctx->network.nodes[owner].is_failed) {
+                    if (owner < (node_id_t)ctx->network.max_nodes && ctx->network.nodes[owner].is_failed) {
                         owner_failed = true;
                     }
                     pthread_mutex_unlock(&ctx->lock);
@@ -673,7 +837,7 @@ int fetch_page_write(page_id_t page_id) {
                         directory_reclaim_ownership(g_directory, page_id, ctx->node_id);
 
                         /* Initialize page with zeros (data lost from failed node) */
-                        memset(entry->local_addr, 0, PAGE_SIZE);
+                        zero_lost_page(owning_table, entry);
 
                         /* Set permission to READ_WRITE */
                         rc = set_page_permission(entry->local_addr, PAGE_PERM_READ_WRITE);
@@ -681,19 +845,21 @@ int fetch_page_write(page_id_t page_id) {
                             LOG_ERROR("Failed to set page permission after recovery");
                             entry->fetch_result = rc;
                             entry->request_pending = false;
-                            pthread_cond_broadcast(&entry->ready_cv);
-                            pthread_mutex_unlock(&entry->entry_lock);
+                            pthread_cond_broadcast(page_entry_ready_cv(entry));
+                            pthread_mutex_unlock(page_entry_lock(entry));
                             final_result = rc;
                             goto cleanup;
                         }
 
                         entry->state = PAGE_STATE_READ_WRITE;
                         entry->owner = ctx->node_id;
+                        entry->handed_over = false;
+                        note_remote_path(page_id, owner, false);  /* Paid the remote timeout */
 
                         entry->fetch_result = DSM_SUCCESS;
                         entry->request_pending = false;
-                        pthread_cond_broadcast(&entry->ready_cv);
-                        pthread_mutex_unlock(&entry->entry_lock);
+                        pthread_cond_broadcast(page_entry_ready_cv(entry));
+                        pthread_mutex_unlock(page_entry_lock(entry));
 
                         LOG_INFO("Successfully recovered page %lu from failed node %u (WRITE)",
                                  page_id, owner);
@@ -704,8 +870,8 @@ int fetch_page_write(page_id_t page_id) {
                     /* Check if error or timeout */
                     entry->fetch_result = DSM_ERROR_TIMEOUT;
                     entry->request_pending = false;
-                    pthread_cond_broadcast(&entry->ready_cv);  /* Wake any waiters with error */
-                    pthread_mutex_unlock(&entry->entry_lock);
+                    pthread_cond_broadcast(page_entry_ready_cv(entry));  /* Wake any waiters with error */
+                    pthread_mutex_unlock(page_entry_lock(entry));
                     perf_log_timeout();  /* Task 8.6 */
 
                     /* Retry loop catches this */
@@ -716,13 +882,12 @@ int fetch_page_write(page_id_t page_id) {
             /* Check result */
             int result = entry->fetch_result;
             if (!entry->request_pending) {
-                 pthread_mutex_unlock(&entry->entry_lock);
+                 pthread_mutex_unlock(page_entry_lock(entry));
                  
                  if (result == DSM_SUCCESS) {
                      /* Success - Update stats */
-                     pthread_mutex_lock(&ctx->stats_lock);
-                     ctx->stats.pages_fetched++;
-                     pthread_mutex_unlock(&ctx->stats_lock);
+                     STATS_INC(pages_fetched);
+                     note_remote_path(page_id, owner, false);
                  } else {
                      LOG_WARN("Fetch write failed with code %d, retrying...", result);
                      retries++;
@@ -730,40 +895,65 @@ int fetch_page_write(page_id_t page_id) {
                      continue;
                  }
             } else {
-                pthread_mutex_unlock(&entry->entry_lock);
+                pthread_mutex_unlock(page_entry_lock(entry));
             }
         } else {
-            /* We already own it, just upgrade permission */
+            /* We already own it, just upgrade permission, unless a read was
+             * served while the invalidations were out: that reader may be
+             * one just invalidated, reading again, so no sharer is dropped
+             * and the invalidations go out again. Checked under the entry
+             * lock that serving a read holds (share_for_read()), as is a
+             * hand-over to a writer served meanwhile (handle_page_request()) */
+            pthread_mutex_lock(page_entry_lock(entry));
+            if (entry->handed_over) {
+                entry->fetch_result = DSM_ERROR_BUSY;
+                entry->request_pending = false;
+                pthread_cond_broadcast(page_entry_ready_cv(entry));
+                pthread_mutex_unlock(page_entry_lock(entry));
+                LOG_DEBUG("Page %lu was handed to a writer during its upgrade, fetching it", page_id);
+                count_refetch(&refetches, &retries);
+                continue;
+            }
+            if (entry->reads_served != reads_served) {
+                entry->fetch_result = DSM_ERROR_BUSY;
+                entry->request_pending = false;
+                pthread_cond_broadcast(page_entry_ready_cv(entry));
+                pthread_mutex_unlock(page_entry_lock(entry));
+                LOG_DEBUG("Page %lu was shared during its upgrade, invalidating again", page_id);
+                count_refetch(&refetches, &retries);
+                continue;
+            }
+
+            /* All invalidations complete - now safe to drop those sharers */
+            directory_remove_sharers(g_directory, page_id, invalidated, num_invalidated);
+
             rc = set_page_permission(entry->local_addr, PAGE_PERM_READ_WRITE);
             if (rc != DSM_SUCCESS) {
-                pthread_mutex_lock(&entry->entry_lock);
                 entry->fetch_result = rc;  /* BUG FIX: Set error result before waking waiters */
                 entry->request_pending = false;
-                pthread_cond_broadcast(&entry->ready_cv);
-                pthread_mutex_unlock(&entry->entry_lock);
+                pthread_cond_broadcast(page_entry_ready_cv(entry));
+                pthread_mutex_unlock(page_entry_lock(entry));
                 final_result = rc;
                 goto cleanup;
             }
 
+            /* Update local state (a fetched page's was set by the reply
+             * handler) before a read served next can look at it */
+            entry->state = PAGE_STATE_READ_WRITE;
+            entry->owner = ctx->node_id;
+
             /* Clear request pending flag with success result */
-            pthread_mutex_lock(&entry->entry_lock);
             entry->fetch_result = DSM_SUCCESS;  /* BUG FIX: Set success result */
             entry->request_pending = false;
-            pthread_cond_broadcast(&entry->ready_cv);
-            pthread_mutex_unlock(&entry->entry_lock);
+            pthread_cond_broadcast(page_entry_ready_cv(entry));
+            pthread_mutex_unlock(page_entry_lock(entry));
+            stats_fault_path = 0;
         }
 
-        /* Update local state */
-        entry->state = PAGE_STATE_READ_WRITE;
-        entry->owner = ctx->node_id;
-
-        /* PHASE 7: Send OWNER_UPDATE to current manager (could be promoted backup) */
-        node_id_t manager_id = 0;
-        if (ctx->network.backup_state.current_manager != (node_id_t)-1) {
-            manager_id = ctx->network.backup_state.current_manager;
-        }
-        if (ctx->node_id != manager_id && !ctx->config.is_manager) {
-            send_owner_update(manager_id, page_id, ctx->node_id);
+        /* PHASE 7: Send OWNER_UPDATE to the directory node (the current
+         * manager, which could be the promoted backup, or the page's home) */
+        if (!directory_is_local(page_id)) {
+            send_owner_update(directory_node(page_id), page_id, ctx->node_id);
         }
 
         LOG_DEBUG("Successfully fetched page %lu for write", page_id);
@@ -775,8 +965,83 @@ int fetch_page_write(page_id_t page_id) {
     final_result = DSM_ERROR_TIMEOUT;
 
 cleanup:
+    if (handoff_held) {
+        handoff_release(page_id, ctx->node_id);
+    }
     if (owning_table) {
         page_table_release(owning_table);
     }
     return final_result;
 }
+
+/**
+ * Look up a page by ID and take a reference to its table
+ *
+ * @return DSM_SUCCESS with *table referenced, or error code
+ */
+static int acquire_page_entry(page_id_t page_id, page_table_t **table, page_entry_t **entry) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    if (!ctx || ctx->num_allocations == 0 || !g_directory) {
+        LOG_ERROR("DSM not initialized");
+        return DSM_ERROR_INIT;
+    }
+
+    /* Hold ctx->lock so dsm_free() cannot drop the table before the reference is taken */
+    pthread_mutex_lock(&ctx->lock);
+    *entry = page_index_lookup_id(page_id, table);
+    if (*entry) {
+        page_table_acquire(*table);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (!*entry) {
+        LOG_ERROR("Page %lu not found in any page table", page_id);
+        return DSM_ERROR_NOT_FOUND;
+    }
+    return DSM_SUCCESS;
+}
+
+/**
+ * Take a reference to a table already resolved by the caller
+ */
+static int acquire_resolved_entry(page_table_t *table, page_entry_t *entry) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    if (!table || !entry) {
+        return DSM_ERROR_INVALID;
+    }
+    if (!ctx || ctx->num_allocations == 0 || !g_directory) {
+        LOG_ERROR("DSM not initialized");
+        return DSM_ERROR_INIT;
+    }
+
+    /* The caller found the table through the page index; dsm_free() keeps
+     * unpublished tables alive for a grace period, which covers this window */
+    page_table_acquire(table);
+    return DSM_SUCCESS;
+}
+
+int fetch_page_read(page_id_t page_id) {
+    page_table_t *table;
+    page_entry_t *entry;
+    int rc = acquire_page_entry(page_id, &table, &entry);
+    return rc == DSM_SUCCESS ? fetch_page_read_ref(table, entry) : rc;
+}
+
+int fetch_page_read_entry(page_table_t *table, page_entry_t *entry) {
+    int rc = acquire_resolved_entry(table, entry);
+    return rc == DSM_SUCCESS ? fetch_page_read_ref(table, entry) : rc;
+}
+
+int fetch_page_write(page_id_t page_id) {
+    page_table_t *table;
+    page_entry_t *entry;
+    int rc = acquire_page_entry(page_id, &table, &entry);
+    return rc == DSM_SUCCESS ? fetch_page_write_ref(table, entry) : rc;
+}
+
+int fetch_page_write_entry(page_table_t *table, page_entry_t *entry) {
+    int rc = acquire_resolved_entry(table, entry);
+    return rc == DSM_SUCCESS ? fetch_page_write_ref(table, entry) : rc;
+}
@@ -10,6 +10,7 @@
 #define PAGE_MIGRATION_H
 
 #include "dsm/types.h"
+#include "../memory/page_table.h"
 
 /**
  * Fetch a page for read access
@@ -27,6 +28,18 @@
  */
 int fetch_page_read(page_id_t page_id);
 
+/**
+ * Fetch a page for read access given its already resolved entry
+ *
+ * Same as fetch_page_read() but skips the page ID lookup; used by the
+ * fault handler, which has already found the entry by address.
+ *
+ * @param table Page table holding the entry
+ * @param entry Page entry to fetch
+ * @return DSM_SUCCESS on success, error code on failure
+ */
+int fetch_page_read_entry(page_table_t *table, page_entry_t *entry);
+
 /**
  * Fetch a page for write access
  *
@@ -46,6 +59,15 @@ int fetch_page_read(page_id_t page_id);
  */
 int fetch_page_write(page_id_t page_id);
 
+/**
+ * Fetch a page for write access given its already resolved entry
+ *
+ * @param table Page table holding the entry
+ * @param entry Page entry to fetch
+ * @return DSM_SUCCESS on success, error code on failure
+ */
+int fetch_page_write_entry(page_table_t *table, page_entry_t *entry);
+
 /**
  * Initialize consistency module
  *
@@ -0,0 +1,425 @@
+/**
+ * @file prefetch.c
+ * @brief Bulk page prefetch and fault-stream prefetcher implementation
+ */
+
+#include "prefetch.h"
+#include "directory.h"
+#include "page_migration.h"
+#include "release_consistency.h"
+#include "../core/log.h"
+#include "../core/dsm_context.h"
+#include "../core/stats.h"
+#include "../memory/page_index.h"
+#include "../network/handlers.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* ============================ */
+/*       Waiting                */
+/* ============================ */
+
+static void deadline_after_ms(struct timespec *deadline, int ms) {
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += ms / 1000;
+    deadline->tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+/**
+ * Wait until a page's prefetch completes or the deadline passes
+ * A prefetch still in flight at the deadline is abandoned.
+ *
+ * @return true if the page is now present
+ */
+static bool wait_prefetched(page_table_t *table, page_entry_t *entry,
+                            const struct timespec *deadline) {
+    pthread_mutex_lock(page_entry_lock(entry));
+    if (!entry->prefetch_pending) {
+        pthread_mutex_unlock(page_entry_lock(entry));
+        return false;
+    }
+
+    entry->num_waiting_threads++;
+    while (entry->prefetch_pending) {
+        if (pthread_cond_timedwait(page_entry_ready_cv(entry), page_entry_lock(entry), deadline) != 0) {
+            LOG_DEBUG("Prefetch of page %lu still in flight, abandoning it", entry->id);
+            entry->prefetch_pending = false;
+            break;
+        }
+    }
+    entry->num_waiting_threads--;
+    pthread_mutex_unlock(page_entry_lock(entry));
+
+    /* Failed and cancelled prefetches also clear the flag; only a reply
+     * that installed the page leaves it valid */
+    pthread_mutex_lock(&table->lock);
+    bool present = entry->state != PAGE_STATE_INVALID;
+    pthread_mutex_unlock(&table->lock);
+    return present;
+}
+
+bool prefetch_wait(page_table_t *table, page_entry_t *entry) {
+    struct timespec deadline;
+    deadline_after_ms(&deadline, PREFETCH_WAIT_MS);
+    if (!wait_prefetched(table, entry, &deadline)) {
+        return false;
+    }
+
+    STATS_INC(prefetch_hits);
+    stats_fault_path = STATS_PATH_REMOTE | STATS_PATH_QUEUED;
+    LOG_DEBUG("Page %lu arrived by prefetch", entry->id);
+    return true;
+}
+
+void prefetch_cancel(page_entry_t *entry) {
+    pthread_mutex_lock(page_entry_lock(entry));
+    if (entry->prefetch_pending) {
+        entry->prefetch_pending = false;
+        pthread_cond_broadcast(page_entry_ready_cv(entry));
+    }
+    pthread_mutex_unlock(page_entry_lock(entry));
+}
+
+/* ============================ */
+/*       Issuing                */
+/* ============================ */
+
+/**
+ * Pages of one PAGE_BATCH_REQUEST being built
+ */
+typedef struct {
+    node_id_t target;                         /**< Node the batch is sent to */
+    int count;                                /**< Pages in the batch */
+    page_batch_entry_t pages[PAGE_BATCH_MAX]; /**< Wire entries */
+    page_entry_t *entries[PAGE_BATCH_MAX];    /**< Matching local entries */
+} prefetch_batch_t;
+
+/**
+ * Send a batch; on failure its pages are released for normal fetching
+ *
+ * @return Pages requested
+ */
+static int flush_batch(prefetch_batch_t *batch) {
+    if (batch->count == 0) {
+        return 0;
+    }
+
+    int sent = batch->count;
+    int rc = send_page_batch_request(batch->target, batch->pages, batch->count);
+    if (rc == DSM_SUCCESS) {
+        STATS_INC(prefetch_requests);
+    } else {
+        LOG_WARN("Failed to send PAGE_BATCH_REQUEST to node %u (rc=%d)", batch->target, rc);
+        for (int i = 0; i < batch->count; i++) {
+            prefetch_cancel(batch->entries[i]);
+        }
+        sent = 0;
+    }
+    batch->count = 0;
+    return sent;
+}
+
+/**
+ * Node to send a page's prefetch to
+ *
+ * The page's directory node asks its directory and skips pages it owns.
+ * Other nodes send the request to the directory node (the manager, or the
+ * page's home), which proxies pages it does not hold; they only skip pages
+ * their owner hint says are theirs.
+ *
+ * @return false if the page should not be prefetched
+ */
+static bool prefetch_target(page_id_t page_id, node_id_t hint, node_id_t *target) {
+    dsm_context_t *ctx = dsm_get_context();
+    node_id_t owner = hint;
+    bool local = directory_is_local(page_id);
+
+    if (local) {
+        page_directory_t *dir = get_page_directory();
+        if (!dir || directory_lookup(dir, page_id, &owner) != DSM_SUCCESS) {
+            return false;
+        }
+    }
+    if (owner == ctx->node_id || owner >= (node_id_t)ctx->network.max_nodes) {
+        return false;
+    }
+
+    *target = local ? owner : directory_node(page_id);
+    return true;
+}
+
+/**
+ * Prefetch pages first, first + stride, ... below end of a table
+ * Pages that are present or already being fetched are skipped.
+ *
+ * @return Pages requested
+ */
+static int prefetch_range(page_table_t *table, size_t first, size_t end, size_t stride) {
+    prefetch_batch_t batch;
+    batch.count = 0;
+    int requested = 0;
+
+    for (size_t i = first; i < end; i += stride) {
+        page_entry_t *entry = &table->entries[i];
+
+        pthread_mutex_lock(&table->lock);
+        bool invalid = entry->state == PAGE_STATE_INVALID;
+        uint64_t version = entry->version;
+        node_id_t hint = entry->owner;
+        pthread_mutex_unlock(&table->lock);
+
+        node_id_t target;
+        if (!invalid || !prefetch_target(entry->id, hint, &target)) {
+            continue;
+        }
+
+        pthread_mutex_lock(page_entry_lock(entry));
+        bool claimed = !entry->request_pending && !entry->prefetch_pending;
+        if (claimed) {
+            entry->prefetch_pending = true;
+        }
+        pthread_mutex_unlock(page_entry_lock(entry));
+        if (!claimed) {
+            continue;
+        }
+
+        if (batch.count > 0 && (batch.target != target || batch.count == PAGE_BATCH_MAX)) {
+            requested += flush_batch(&batch);
+        }
+        batch.target = target;
+        batch.pages[batch.count].page_id = entry->id;
+        batch.pages[batch.count].cached_version = version;
+        batch.entries[batch.count] = entry;
+        batch.count++;
+    }
+
+    requested += flush_batch(&batch);
+    return requested;
+}
+
+int prefetch_pages(page_table_t *table, size_t first, size_t end) {
+    return prefetch_range(table, first, end, 1);
+}
+
+/* ============================ */
+/*       dsm_prefetch()         */
+/* ============================ */
+
+int prefetch_make_writable(page_table_t *table, page_entry_t *entry) {
+    if (rc_enabled()) {
+        return rc_write_fault(table, entry);
+    }
+
+    pthread_mutex_lock(&table->lock);
+    bool writable = entry->state == PAGE_STATE_READ_WRITE;
+    pthread_mutex_unlock(&table->lock);
+
+    /* The page was just fetched for read, so the upgrade carries no data */
+    return writable ? DSM_SUCCESS : fetch_page_write_entry(table, entry);
+}
+
+int dsm_prefetch(void *addr, size_t len, access_type_t access) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (!ctx || !ctx->initialized) {
+        return DSM_ERROR_INIT;
+    }
+    if (!addr || len == 0 || (access != ACCESS_READ && access != ACCESS_WRITE)) {
+        return DSM_ERROR_INVALID;
+    }
+
+    uintptr_t start = (uintptr_t)addr & ~(uintptr_t)(PAGE_SIZE - 1);
+    uintptr_t end = (uintptr_t)addr + len;
+    if (end < start) {
+        return DSM_ERROR_INVALID;
+    }
+
+    struct timespec deadline;
+    deadline_after_ms(&deadline, PREFETCH_RANGE_TIMEOUT_MS);
+
+    bool found = false;
+    int requested = 0;
+    int result = DSM_SUCCESS;
+    uintptr_t pos = start;
+
+    /* One allocation at a time, each under a table reference */
+    while (pos < end) {
+        page_table_t *table = NULL;
+        pthread_mutex_lock(&ctx->lock);
+        page_entry_t *entry = page_index_lookup_addr((void *)pos, &table);
+        if (entry) {
+            page_table_acquire(table);
+        }
+        pthread_mutex_unlock(&ctx->lock);
+
+        if (!entry) {
+            pos += PAGE_SIZE;
+            continue;
+        }
+        found = true;
+
+        uintptr_t table_end = (uintptr_t)table->base_addr + table->num_pages * table->block_size;
+        size_t first = (size_t)(entry - table->entries);
+        size_t last = (size_t)(((end < table_end ? end : table_end) - 1 -
+                                (uintptr_t)table->base_addr) / table->block_size);
+
+        requested += prefetch_range(table, first, last + 1, 1);
+        for (size_t i = first; i <= last; i++) {
+            wait_prefetched(table, &table->entries[i], &deadline);
+        }
+
+        if (access == ACCESS_WRITE) {
+            for (size_t i = first; i <= last && result == DSM_SUCCESS; i++) {
+                result = prefetch_make_writable(table, &table->entries[i]);
+            }
+        }
+
+        page_table_release(table);
+        if (result != DSM_SUCCESS) {
+            LOG_ERROR("dsm_prefetch: failed to make page writable (rc=%d)", result);
+            return result;
+        }
+        pos = table_end;
+    }
+
+    LOG_DEBUG("dsm_prefetch: %zu bytes at %p, %d pages requested", len, addr, requested);
+    return found ? DSM_SUCCESS : DSM_ERROR_NOT_FOUND;
+}
+
+/* ============================ */
+/*       Fault Prefetcher       */
+/* ============================ */
+
+/**
+ * Remote fault stream of one thread
+ */
+typedef struct {
+    const page_table_t *table; /**< Allocation of the stream (identity only, never dereferenced) */
+    size_t last;               /**< Page index of the last fault */
+    size_t delta;              /**< Last distance between faults, while learning */
+    size_t stride;             /**< Confirmed stride in pages, 0 while learning */
+    size_t ahead;              /**< Furthest page index prefetched */
+    int depth;                 /**< Current window in strides */
+} prefetch_stream_t;
+
+static __thread prefetch_stream_t t_stream;
+
+void prefetch_on_fault(page_table_t *table, page_entry_t *entry) {
+    dsm_context_t *ctx = dsm_get_context();
+    int max_depth = ctx->config.prefetch_depth;
+    if (max_depth <= 0) {
+        return;
+    }
+    if (max_depth > PREFETCH_MAX_DEPTH) {
+        max_depth = PREFETCH_MAX_DEPTH;
+    }
+
+    prefetch_stream_t *s = &t_stream;
+    size_t i = (size_t)(entry - table->entries);
+
+    /* Only forward streams within one allocation are followed */
+    if (s->table != table || i < s->last) {
+        *s = (prefetch_stream_t){ .table = table, .last = i, .ahead = i };
+        return;
+    }
+    if (i == s->last) {
+        return;  /* Read then write fault on the same page */
+    }
+
+    size_t delta = i - s->last;
+    if (s->stride > 0 && i <= s->ahead + s->stride) {
+        /* Continues the stream: the pages in between arrived without faulting */
+        s->depth = s->depth * 2 < max_depth ? s->depth * 2 : max_depth;
+    } else if (delta == s->delta) {
+        s->stride = delta;
+        s->depth = max_depth < 2 ? max_depth : 2;
+        s->ahead = i;
+    } else {
+        s->delta = delta;
+        s->stride = 0;
+        s->ahead = i;
+        s->last = i;
+        return;
+    }
+    s->last = i;
+
+    size_t first = (s->ahead > i ? s->ahead : i) + s->stride;
+    size_t limit = i + (size_t)s->depth * s->stride;
+    if (limit >= table->num_pages) {
+        limit = table->num_pages - 1;
+    }
+    if (first > limit) {
+        return;
+    }
+
+    /* The fault path released its reference; dsm_free() keeps tables
+     * found through the page index alive for a grace period */
+    page_table_acquire(table);
+    int requested = prefetch_range(table, first, limit + 1, s->stride);
+    page_table_release(table);
+
+    s->ahead = first + (limit - first) / s->stride * s->stride;
+    LOG_DEBUG("Prefetcher: fault on page %lu, stride %zu, %d pages requested up to index %zu",
+              entry->id, s->stride, requested, s->ahead);
+}
+
+/* ============================ */
+/*       Replicas               */
+/* ============================ */
+
+static pthread_mutex_t g_replica_lock = PTHREAD_MUTEX_INITIALIZER;
+static page_id_t g_replicas[PREFETCH_REPLICA_MAX];
+static int g_num_replicas = 0;
+
+void prefetch_note_replica(page_id_t page_id) {
+    pthread_mutex_lock(&g_replica_lock);
+    bool queued = false;
+    for (int i = 0; i < g_num_replicas && !queued; i++) {
+        queued = g_replicas[i] == page_id;
+    }
+    if (!queued && g_num_replicas < PREFETCH_REPLICA_MAX) {
+        g_replicas[g_num_replicas++] = page_id;
+    }
+    pthread_mutex_unlock(&g_replica_lock);
+}
+
+int prefetch_replicas(void) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    page_id_t pages[PREFETCH_REPLICA_MAX];
+    pthread_mutex_lock(&g_replica_lock);
+    int count = g_num_replicas;
+    memcpy(pages, g_replicas, (size_t)count * sizeof(page_id_t));
+    g_num_replicas = 0;
+    pthread_mutex_unlock(&g_replica_lock);
+
+    /* One page at a time: replicas are few and rarely neighbours */
+    int requested = 0;
+    for (int i = 0; i < count; i++) {
+        page_table_t *table = NULL;
+        pthread_mutex_lock(&ctx->lock);
+        page_entry_t *entry = page_index_lookup_id(pages[i], &table);
+        if (entry) {
+            page_table_acquire(table);
+        }
+        pthread_mutex_unlock(&ctx->lock);
+        if (!entry) {
+            continue;  /* Freed since it was queued */
+        }
+
+        size_t index = (size_t)(entry - table->entries);
+        requested += prefetch_range(table, index, index + 1, 1);
+        page_table_release(table);
+    }
+
+    if (requested > 0) {
+        STATS_ADD(adaptive_replicas, requested);
+        LOG_DEBUG("Prefetching %d read-mostly replicas of %d queued", requested, count);
+    }
+    return requested;
+}
@@ -0,0 +1,111 @@
+/**
+ * @file prefetch.h
+ * @brief Bulk page prefetch and fault-stream prefetcher
+ *
+ * A prefetch requests pages before they are touched, several per
+ * PAGE_BATCH_REQUEST, and does not wait for them; the owner sends them
+ * back together in a PAGE_BATCH_REPLY. A prefetched page is marked
+ * prefetch_pending until its reply installs it read-only; a
+ * fault on it in the meantime waits briefly for the reply instead of
+ * sending a request of its own, then falls back to a normal fetch.
+ *
+ * Prefetches come from dsm_prefetch() and from the fault prefetcher,
+ * enabled with dsm_config_t.prefetch_depth > 0: each thread's remote
+ * faults are watched for a constant stride within one allocation, and
+ * once two equal strides are seen the next pages of the stream are
+ * prefetched. The window starts small and doubles up to prefetch_depth
+ * pages while the stream continues.
+ *
+ * With dsm_config_t.adaptive, read-mostly pages (see directory_page_advice())
+ * that a write invalidated are queued as replicas and prefetched again
+ * when the node leaves its next barrier, when the writer is done.
+ */
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include "dsm/types.h"
+#include "../memory/page_table.h"
+#include <stdbool.h>
+
+/** How long a fault waits for a prefetch in flight before fetching itself */
+#define PREFETCH_WAIT_MS 200
+
+/** How long dsm_prefetch() waits for the pages it requested */
+#define PREFETCH_RANGE_TIMEOUT_MS 5000
+
+/** Largest prefetch window, in pages */
+#define PREFETCH_MAX_DEPTH 64
+
+/** Invalidated read-mostly pages queued for the next barrier (more are dropped) */
+#define PREFETCH_REPLICA_MAX 256
+
+/**
+ * Wait for a prefetch of a page that is in flight
+ *
+ * Called by the fetch path before it requests a page. If the prefetch
+ * does not complete within PREFETCH_WAIT_MS it is abandoned (its reply
+ * will be dropped) and the caller fetches the page itself.
+ *
+ * @param table Page table holding the entry
+ * @param entry Page entry
+ * @return true if a prefetch installed the page, false if the caller must fetch it
+ */
+bool prefetch_wait(page_table_t *table, page_entry_t *entry);
+
+/**
+ * Abandon a prefetch of a page, if one is in flight
+ *
+ * Its reply will be dropped; threads waiting on it fetch the page themselves.
+ *
+ * @param entry Page entry
+ */
+void prefetch_cancel(page_entry_t *entry);
+
+/**
+ * Prefetch pages first .. end - 1 of a table without waiting for them
+ * Pages that are present or already being fetched are skipped.
+ *
+ * @param table Page table, referenced by the caller
+ * @param first Index of the first page
+ * @param end Index past the last page
+ * @return Pages requested
+ */
+int prefetch_pages(page_table_t *table, size_t first, size_t end);
+
+/**
+ * Make one present page writable, as a write fault on it would
+ *
+ * @param table Page table holding the entry
+ * @param entry Page entry, valid on this node
+ * @return DSM_SUCCESS once the page is writable, error code otherwise
+ */
+int prefetch_make_writable(page_table_t *table, page_entry_t *entry);
+
+/**
+ * Feed a remote fault to the calling thread's stream detector
+ *
+ * Prefetches the next pages of the stream if the fault continues one.
+ * Does nothing unless dsm_config_t.prefetch_depth > 0.
+ *
+ * @param table Page table holding the entry
+ * @param entry Entry of the page that faulted
+ */
+void prefetch_on_fault(page_table_t *table, page_entry_t *entry);
+
+/**
+ * Queue an invalidated read-mostly page to be fetched again
+ *
+ * @param page_id Page ID
+ */
+void prefetch_note_replica(page_id_t page_id);
+
+/**
+ * Prefetch the pages queued by prefetch_note_replica()
+ * Called on barrier exit; does not wait for the pages.
+ *
+ * @return Pages requested
+ */
+int prefetch_replicas(void);
+
+#endif /* PREFETCH_H */
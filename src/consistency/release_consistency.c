@@ -0,0 +1,668 @@
+/**
+ * @file release_consistency.c
+ * @brief Multiple-writer release consistency implementation
+ */
+
+#include "release_consistency.h"
+#include "page_migration.h"
+#include "diff_kernels.h"
+#include "../core/log.h"
+#include "../core/dsm_context.h"
+#include "../core/stats.h"
+#include "../core/perf_log.h"
+#include "../core/sharing_profile.h"
+#include "../memory/page_index.h"
+#include "../memory/permission.h"
+#include "../network/handlers.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+
+/** Run header: [uint16 offset][uint16 length] */
+#define RC_RUN_HEADER 4
+
+/* Outstanding diff ACKs of this node's releases */
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t acked;
+    int pending;                       /**< Diffs sent but not yet acknowledged */
+    int failures;                      /**< Diffs that failed to send or were rejected */
+    int error;                         /**< First of those errors */
+    int dirty;                         /**< Pages with a twin (atomic, skips empty releases) */
+    rc_notices_t notices;              /**< Pages written since the last barrier arrival */
+} g_rc = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .acked = PTHREAD_COND_INITIALIZER,
+    .pending = 0,
+    .failures = 0,
+    .error = DSM_SUCCESS,
+    .dirty = 0
+};
+
+bool rc_enabled(void) {
+    dsm_context_t *ctx = dsm_get_context();
+    return ctx->config.consistency == DSM_CONSISTENCY_RELEASE;
+}
+
+/* ============================ */
+/*       Write Notices          */
+/* ============================ */
+
+void rc_notices_merge(rc_notices_t *into, const page_id_t *pages, int count, bool overflow) {
+    if (overflow) {
+        into->overflow = true;
+    }
+    for (int i = 0; i < count && !into->overflow; i++) {
+        int j = 0;
+        while (j < into->count && into->pages[j] != pages[i]) {
+            j++;
+        }
+        if (j < into->count) {
+            continue;
+        }
+        if (into->count == BARRIER_NOTICE_MAX) {
+            into->overflow = true;
+            break;
+        }
+        into->pages[into->count++] = pages[i];
+    }
+    if (into->overflow) {
+        into->count = 0;
+    }
+}
+
+/** Record that this node changed a page */
+static void note_write(page_id_t page_id) {
+    pthread_mutex_lock(&g_rc.lock);
+    rc_notices_merge(&g_rc.notices, &page_id, 1, false);
+    pthread_mutex_unlock(&g_rc.lock);
+}
+
+void rc_take_notices(rc_notices_t *out) {
+    pthread_mutex_lock(&g_rc.lock);
+    out->overflow = g_rc.notices.overflow;
+    out->count = g_rc.notices.count;
+    memcpy(out->pages, g_rc.notices.pages, (size_t)out->count * sizeof(page_id_t));
+    g_rc.notices.overflow = false;
+    g_rc.notices.count = 0;
+    pthread_mutex_unlock(&g_rc.lock);
+}
+
+/* ============================ */
+/*       Diff Encoding          */
+/* ============================ */
+
+size_t rc_encode_diff(const uint8_t *page, const uint8_t *twin, uint8_t *out, int *num_runs) {
+    /* Byte-exact runs: an unchanged byte inside a run could overwrite
+     * another writer's change at the home */
+    return diff_encode(diff_kernel_select(), page, twin, out, num_runs);
+}
+
+int rc_apply_runs(uint8_t *page, const uint8_t *data, size_t len, int num_runs) {
+    size_t pos = 0;
+    for (int r = 0; r < num_runs; r++) {
+        if (pos + RC_RUN_HEADER > len) {
+            return DSM_ERROR_INVALID;
+        }
+        uint16_t offset, length;
+        memcpy(&offset, data + pos, sizeof(offset));
+        memcpy(&length, data + pos + 2, sizeof(length));
+        pos += RC_RUN_HEADER;
+
+        if ((size_t)offset + length > PAGE_SIZE || pos + length > len) {
+            return DSM_ERROR_INVALID;
+        }
+        memcpy(page + offset, data + pos, length);
+        pos += length;
+    }
+    return pos == len ? DSM_SUCCESS : DSM_ERROR_INVALID;
+}
+
+/**
+ * Attribute the runs of one OS page's diff to the sharing profiler
+ * The runs were just encoded by rc_encode_diff(), so they are well formed.
+ */
+static void profile_diff_runs(page_id_t page_id, size_t block_size, size_t sub_page,
+                              const uint8_t *data, size_t len) {
+    size_t pos = 0;
+    while (pos + RC_RUN_HEADER <= len) {
+        uint16_t offset, length;
+        memcpy(&offset, data + pos, sizeof(offset));
+        memcpy(&length, data + pos + 2, sizeof(length));
+        sharing_profile_write(page_id, block_size, sub_page * PAGE_SIZE + offset, length);
+        pos += RC_RUN_HEADER + length;
+    }
+}
+
+/* ============================ */
+/*       Write Faults           */
+/* ============================ */
+
+/** Home of a page; DSM_NODE_NONE for a first-touch page not yet claimed */
+static node_id_t page_home(page_table_t *table, const page_entry_t *entry) {
+    pthread_mutex_lock(&table->lock);
+    node_id_t home = entry->home;
+    pthread_mutex_unlock(&table->lock);
+    return home;
+}
+
+int rc_write_fault(page_table_t *table, page_entry_t *entry) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    node_id_t home = page_home(table, entry);
+    if (home == DSM_NODE_NONE) {
+        /* First touch: the read fetch claims the page or learns who did */
+        int rc = fetch_page_read_entry(table, entry);
+        if (rc != DSM_SUCCESS) {
+            return rc;
+        }
+        home = page_home(table, entry);
+    }
+
+    /* The home's copy is the master: no twin, no diff */
+    if (home == ctx->node_id) {
+        pthread_mutex_lock(page_entry_lock(entry));
+        int rc = set_page_permission(entry->local_addr, PAGE_PERM_READ_WRITE);
+        if (rc == DSM_SUCCESS) {
+            entry->state = PAGE_STATE_READ_WRITE;
+        }
+        pthread_mutex_unlock(page_entry_lock(entry));
+
+        /* Readers downgrade the home copy, so later writes fault here again */
+        if (rc == DSM_SUCCESS) {
+            note_write(entry->id);
+        }
+        return rc;
+    }
+
+    /* An acquire on another thread may invalidate the page between the fetch
+     * and the twin, so retry a few times */
+    for (int attempt = 0; attempt < 3; attempt++) {
+        if (entry->state == PAGE_STATE_INVALID) {
+            int rc = fetch_page_read_entry(table, entry);
+            if (rc != DSM_SUCCESS) {
+                return rc;
+            }
+        }
+
+        pthread_mutex_lock(page_entry_lock(entry));
+        if (entry->state == PAGE_STATE_INVALID) {
+            pthread_mutex_unlock(page_entry_lock(entry));
+            continue;
+        }
+
+        if (!entry->twin) {
+            /* mmap rather than malloc: this runs in the SIGSEGV handler */
+            void *twin = mmap(NULL, table->block_size, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (twin == MAP_FAILED) {
+                pthread_mutex_unlock(page_entry_lock(entry));
+                LOG_ERROR("Failed to allocate twin for page %lu", entry->id);
+                return DSM_ERROR_MEMORY;
+            }
+            memcpy(twin, entry->local_addr, table->block_size);
+            entry->twin = twin;
+            __atomic_fetch_add(&g_rc.dirty, 1, __ATOMIC_RELAXED);
+            STATS_INC(twins_created);
+        }
+
+        int rc = set_page_permission(entry->local_addr, PAGE_PERM_READ_WRITE);
+        if (rc == DSM_SUCCESS) {
+            entry->state = PAGE_STATE_READ_WRITE;
+        }
+        pthread_mutex_unlock(page_entry_lock(entry));
+
+        LOG_DEBUG("Page %lu twinned for write (home node %u)", entry->id, home);
+        return rc;
+    }
+
+    LOG_ERROR("Page %lu kept being invalidated during write fault", entry->id);
+    return DSM_ERROR_BUSY;
+}
+
+/* ============================ */
+/*       Release / Acquire      */
+/* ============================ */
+
+/** A page collected for flushing or invalidation, with a reference on its table */
+typedef struct {
+    page_table_t *table;
+    page_entry_t *entry;
+} rc_page_ref_t;
+
+/** Pages a release must flush: those with a twin */
+static bool is_dirty(const page_entry_t *entry, node_id_t self) {
+    (void)self;
+    return __atomic_load_n(&entry->twin, __ATOMIC_RELAXED) != NULL;
+}
+
+/** Pages an acquire may invalidate: cached copies of other homes' pages */
+static bool is_cached_copy(const page_entry_t *entry, node_id_t self) {
+    return entry->home != self &&
+           (entry->state != PAGE_STATE_INVALID || entry->prefetch_pending);
+}
+
+/**
+ * Collect matching entries and reference their tables
+ *
+ * Callers work on the list after ctx->lock is dropped:
+ * set_page_permission() takes ctx->lock itself.
+ */
+static rc_page_ref_t* collect_entries(bool (*match)(const page_entry_t *, node_id_t),
+                                   int hint, int *count) {
+    dsm_context_t *ctx = dsm_get_context();
+    int capacity = hint + 16;
+    rc_page_ref_t *list = malloc((size_t)capacity * sizeof(rc_page_ref_t));
+    int n = 0;
+
+    pthread_mutex_lock(&ctx->lock);
+    for (int t = 0; list && t < ctx->num_allocations; t++) {
+        page_table_t *table = ctx->page_tables[t];
+        for (size_t i = 0; table && i < table->num_pages; i++) {
+            page_entry_t *entry = &table->entries[i];
+            if (!match(entry, ctx->node_id)) {
+                continue;
+            }
+            if (n == capacity) {
+                /* More pages matched while scanning */
+                rc_page_ref_t *grown = realloc(list, (size_t)capacity * 2 * sizeof(rc_page_ref_t));
+                if (!grown) {
+                    break;
+                }
+                list = grown;
+                capacity *= 2;
+            }
+            page_table_acquire(table);
+            list[n].table = table;
+            list[n].entry = entry;
+            n++;
+        }
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    *count = n;
+    return list;
+}
+
+/**
+ * Send the encoded diff of one OS page home, split at run boundaries
+ *
+ * @return Number of PAGE_DIFF messages sent (each adds one pending ACK)
+ */
+static int send_diff_runs(page_entry_t *entry, uint16_t sub_page, const uint8_t *encoded, size_t len) {
+    /* One run never exceeds PAGE_DIFF_MAX_DATA */
+    node_id_t home = entry->home;
+    int sent = 0;
+    size_t start = 0, pos = 0;
+    int runs = 0;
+    while (pos <= len) {
+        size_t run_len = 0;
+        if (pos < len) {
+            uint16_t length;
+            memcpy(&length, encoded + pos + 2, sizeof(length));
+            run_len = RC_RUN_HEADER + length;
+        }
+
+        if (pos == len || pos + run_len - start > PAGE_DIFF_MAX_DATA) {
+            if (runs > 0) {
+                /* Count the ACK before sending so a fast ACK cannot be lost */
+                pthread_mutex_lock(&g_rc.lock);
+                g_rc.pending++;
+                pthread_mutex_unlock(&g_rc.lock);
+
+                int rc = send_page_diff(home, entry->id, sub_page, encoded + start,
+                                        (uint16_t)(pos - start), (uint16_t)runs);
+                if (rc == DSM_SUCCESS) {
+                    sent++;
+                    STATS_INC(diffs_sent);
+                    STATS_ADD(diff_bytes_sent, pos - start);
+                } else {
+                    LOG_ERROR("Failed to send diff for page %lu to home node %u (rc=%d)",
+                              entry->id, home, rc);
+                    rc_diff_acked(rc);  /* Its twin is gone: the release fails */
+                }
+            }
+            if (pos == len) {
+                break;
+            }
+            start = pos;
+            runs = 0;
+        }
+        pos += run_len;
+        runs++;
+    }
+
+    return sent;
+}
+
+/**
+ * Diff one page against its twin, drop the twin and send the runs home
+ *
+ * Every OS page of a block is encoded before the twin is dropped, so later
+ * writes (which make a new twin) are never mixed into this diff.
+ *
+ * @param encoded Scratch buffer of RC_DIFF_MAX_ENCODED bytes per OS page of the block
+ * @return Number of PAGE_DIFF messages sent (each adds one pending ACK)
+ */
+static int flush_page(page_table_t *table, page_entry_t *entry, uint8_t *encoded) {
+    size_t sub_pages = table->block_size / PAGE_SIZE;
+    size_t lens[DSM_MAX_BLOCK_SIZE / PAGE_SIZE];
+
+    pthread_mutex_lock(page_entry_lock(entry));
+    if (!entry->twin) {
+        /* Flushed by a concurrent release */
+        pthread_mutex_unlock(page_entry_lock(entry));
+        return 0;
+    }
+
+    /* Write-protect first so no store can slip in between the diff and
+     * dropping the twin; later writes fault and make a new twin. The
+     * release's batch did so unless the page was written to again since. */
+    if (entry->state != PAGE_STATE_READ_ONLY) {
+        set_page_permission(entry->local_addr, PAGE_PERM_READ);
+    }
+    entry->state = PAGE_STATE_READ_ONLY;
+
+    int total_runs = 0;
+    for (size_t k = 0; k < sub_pages; k++) {
+        int num_runs = 0;
+        lens[k] = rc_encode_diff((const uint8_t *)entry->local_addr + k * PAGE_SIZE,
+                                 (const uint8_t *)entry->twin + k * PAGE_SIZE,
+                                 encoded + k * RC_DIFF_MAX_ENCODED, &num_runs);
+        total_runs += num_runs;
+    }
+
+    munmap(entry->twin, table->block_size);
+    entry->twin = NULL;
+    __atomic_fetch_sub(&g_rc.dirty, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(page_entry_lock(entry));
+
+    if (total_runs == 0) {
+        return 0;
+    }
+    note_write(entry->id);
+    if (sharing_profile_enabled()) {
+        for (size_t k = 0; k < sub_pages; k++) {
+            profile_diff_runs(entry->id, table->block_size, k,
+                              encoded + k * RC_DIFF_MAX_ENCODED, lens[k]);
+        }
+    }
+
+    int sent = 0;
+    for (size_t k = 0; k < sub_pages; k++) {
+        if (lens[k] > 0) {
+            sent += send_diff_runs(entry, (uint16_t)k, encoded + k * RC_DIFF_MAX_ENCODED, lens[k]);
+        }
+    }
+    return sent;
+}
+
+/**
+ * Queue the write-protection of one dirty page ahead of its diff
+ */
+static void protect_dirty(page_table_t *table, page_entry_t *entry, perm_batch_t *batch) {
+    pthread_mutex_lock(page_entry_lock(entry));
+    if (entry->twin && entry->state == PAGE_STATE_READ_WRITE) {
+        perm_batch_add(batch, table, entry, PAGE_PERM_READ);
+    }
+    pthread_mutex_unlock(page_entry_lock(entry));
+}
+
+int rc_release(void) {
+    if (!rc_enabled() || __atomic_load_n(&g_rc.dirty, __ATOMIC_RELAXED) == 0) {
+        return DSM_SUCCESS;
+    }
+
+    int count = 0;
+    rc_page_ref_t *dirty = collect_entries(is_dirty, __atomic_load_n(&g_rc.dirty, __ATOMIC_RELAXED),
+                                        &count);
+
+    /* Scratch for the largest dirty block */
+    size_t max_block = PAGE_SIZE;
+    for (int i = 0; dirty && i < count; i++) {
+        if (dirty[i].table->block_size > max_block) {
+            max_block = dirty[i].table->block_size;
+        }
+    }
+    uint8_t *encoded = malloc(max_block / PAGE_SIZE * RC_DIFF_MAX_ENCODED);
+    if (!dirty || !encoded) {
+        for (int i = 0; dirty && i < count; i++) {
+            page_table_release(dirty[i].table);
+        }
+        free(dirty);
+        free(encoded);
+        LOG_ERROR("Out of memory flushing diffs");
+        return DSM_ERROR_MEMORY;
+    }
+
+    /* One mprotect() per run of dirty pages rather than one per page */
+    perm_batch_t batch;
+    perm_batch_init(&batch);
+    for (int i = 0; i < count; i++) {
+        protect_dirty(dirty[i].table, dirty[i].entry, &batch);
+    }
+    perm_batch_apply(&batch);
+    perm_batch_destroy(&batch);
+
+    for (int i = 0; i < count; i++) {
+        flush_page(dirty[i].table, dirty[i].entry, encoded);
+        page_table_release(dirty[i].table);
+    }
+    free(encoded);
+    free(dirty);
+
+    /* The next acquirer reads from the homes, so they must have every diff */
+    struct timespec timeout;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec += RC_DIFF_ACK_TIMEOUT_SEC;
+
+    int result = DSM_SUCCESS;
+    pthread_mutex_lock(&g_rc.lock);
+    while (g_rc.pending > 0) {
+        if (pthread_cond_timedwait(&g_rc.acked, &g_rc.lock, &timeout) == ETIMEDOUT) {
+            LOG_WARN("Timeout waiting for %d diff ACKs", g_rc.pending);
+            g_rc.pending = 0;
+            result = DSM_ERROR_TIMEOUT;
+            break;
+        }
+    }
+    if (g_rc.failures > 0) {
+        LOG_ERROR("%d diffs failed to reach or apply at their home nodes", g_rc.failures);
+        if (result == DSM_SUCCESS) {
+            result = g_rc.error;
+        }
+        g_rc.failures = 0;
+        g_rc.error = DSM_SUCCESS;
+    }
+    pthread_mutex_unlock(&g_rc.lock);
+
+    if (result == DSM_ERROR_TIMEOUT) {
+        perf_log_timeout();
+    }
+    LOG_DEBUG("Release flushed %d dirty pages", count);
+    return result;
+}
+
+/**
+ * Drop one cached copy; pages being fetched or dirty again are left alone
+ * The page is INVALID on return; its protection follows with the batch.
+ * @return true if the page was invalidated
+ */
+static bool invalidate_cached(page_table_t *table, page_entry_t *entry, perm_batch_t *batch) {
+    bool invalidated = false;
+    pthread_mutex_lock(page_entry_lock(entry));
+    if (entry->prefetch_pending) {
+        /* The owner may have read the page before the releases we now see */
+        entry->prefetch_pending = false;
+        pthread_cond_broadcast(page_entry_ready_cv(entry));
+    }
+    if (!entry->request_pending && !entry->twin && entry->state != PAGE_STATE_INVALID) {
+        perm_batch_add(batch, table, entry, PAGE_PERM_NONE);
+        invalidated = true;
+    }
+    pthread_mutex_unlock(page_entry_lock(entry));
+    return invalidated;
+}
+
+void rc_acquire(void) {
+    if (!rc_enabled()) {
+        return;
+    }
+
+    /* Writes made outside any critical section still reach their homes */
+    rc_release();
+
+    int count = 0;
+    rc_page_ref_t *cached = collect_entries(is_cached_copy, 0, &count);
+    if (!cached) {
+        LOG_ERROR("Out of memory invalidating cached pages");
+        return;
+    }
+
+    perm_batch_t batch;
+    perm_batch_init(&batch);
+    int invalidated = 0;
+    for (int i = 0; i < count; i++) {
+        if (invalidate_cached(cached[i].table, cached[i].entry, &batch)) {
+            invalidated++;
+        }
+    }
+    perm_batch_apply(&batch);
+    perm_batch_destroy(&batch);
+
+    for (int i = 0; i < count; i++) {
+        page_table_release(cached[i].table);
+    }
+    free(cached);
+
+    LOG_DEBUG("Acquire invalidated %d cached pages", invalidated);
+}
+
+void rc_acquire_notices(const rc_notices_t *notices) {
+    if (!rc_enabled()) {
+        return;
+    }
+    if (notices->overflow) {
+        rc_acquire();
+        return;
+    }
+
+    rc_release();
+
+    /* Tables stay referenced until the batch is applied; without room to
+     * hold the references each page is applied on its own */
+    dsm_context_t *ctx = dsm_get_context();
+    page_table_t **tables = malloc((size_t)notices->count * sizeof(page_table_t *));
+    int held = 0;
+    perm_batch_t batch;
+    perm_batch_init(&batch);
+
+    int invalidated = 0;
+    for (int i = 0; i < notices->count; i++) {
+        page_table_t *table = NULL;
+        pthread_mutex_lock(&ctx->lock);
+        page_entry_t *entry = page_index_lookup_id(notices->pages[i], &table);
+        bool cached = entry && is_cached_copy(entry, ctx->node_id);
+        if (cached) {
+            page_table_acquire(table);
+        }
+        pthread_mutex_unlock(&ctx->lock);
+
+        if (!cached) {
+            continue;
+        }
+        if (invalidate_cached(table, entry, &batch)) {
+            invalidated++;
+        }
+        if (tables) {
+            tables[held++] = table;
+        } else {
+            perm_batch_apply(&batch);
+            page_table_release(table);
+        }
+    }
+    perm_batch_apply(&batch);
+    perm_batch_destroy(&batch);
+
+    for (int i = 0; i < held; i++) {
+        page_table_release(tables[i]);
+    }
+    free(tables);
+    STATS_ADD(notice_invalidations, invalidated);
+
+    LOG_DEBUG("Barrier exit invalidated %d of %d noticed pages", invalidated, notices->count);
+}
+
+/* ============================ */
+/*       Diff Messages          */
+/* ============================ */
+
+int rc_apply_diff(page_id_t page_id, uint16_t sub_page, const uint8_t *data, size_t len, int num_runs) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    page_table_t *table = NULL;
+    pthread_mutex_lock(&ctx->lock);
+    page_entry_t *entry = page_index_lookup_id(page_id, &table);
+    if (entry) {
+        page_table_acquire(table);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (!entry) {
+        LOG_ERROR("Diff for unknown page %lu", page_id);
+        return DSM_ERROR_NOT_FOUND;
+    }
+    if ((size_t)sub_page >= table->block_size / PAGE_SIZE) {
+        LOG_ERROR("Diff for OS page %u of page %lu, which has %zu", sub_page, page_id,
+                  table->block_size / PAGE_SIZE);
+        page_table_release(table);
+        return DSM_ERROR_INVALID;
+    }
+
+    int rc = DSM_SUCCESS;
+    pthread_mutex_lock(page_entry_lock(entry));
+    if (entry->state == PAGE_STATE_INVALID && entry->home != ctx->node_id) {
+        LOG_ERROR("Diff for page %lu but the home copy is INVALID", page_id);
+        rc = DSM_ERROR_INVALID;
+    } else {
+        if (entry->state != PAGE_STATE_READ_WRITE) {
+            rc = set_page_permission(entry->local_addr, PAGE_PERM_READ_WRITE);
+            if (rc == DSM_SUCCESS) {
+                entry->state = PAGE_STATE_READ_WRITE;
+            }
+        }
+        if (rc == DSM_SUCCESS) {
+            rc = rc_apply_runs((uint8_t *)entry->local_addr + (size_t)sub_page * PAGE_SIZE,
+                               data, len, num_runs);
+        }
+        if (rc == DSM_SUCCESS) {
+            /* Merged contents: no cached copy elsewhere matches any more */
+            pthread_mutex_lock(&table->lock);
+            entry->version = page_next_version();
+            pthread_mutex_unlock(&table->lock);
+        }
+    }
+    pthread_mutex_unlock(page_entry_lock(entry));
+    page_table_release(table);
+
+    if (rc == DSM_SUCCESS) {
+        STATS_INC(diffs_applied);
+    }
+    return rc;
+}
+
+void rc_diff_acked(int result) {
+    pthread_mutex_lock(&g_rc.lock);
+    if (result != DSM_SUCCESS && g_rc.failures++ == 0) {
+        g_rc.error = result;
+    }
+    if (g_rc.pending > 0) {
+        g_rc.pending--;
+    }
+    if (g_rc.pending == 0) {
+        pthread_cond_broadcast(&g_rc.acked);
+    }
+    pthread_mutex_unlock(&g_rc.lock);
+}
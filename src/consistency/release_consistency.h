@@ -0,0 +1,164 @@
+/**
+ * @file release_consistency.h
+ * @brief Multiple-writer release consistency with twins and diffs
+ *
+ * Opt-in alternative to the single-writer invalidation protocol, enabled
+ * with dsm_config_t.consistency = DSM_CONSISTENCY_RELEASE. Every page has a
+ * fixed home, its initial owner under the allocation's placement (for a
+ * first-touch page, the node that claimed it), which holds the master copy:
+ *
+ * - A write fault on a non-home page makes a twin (a copy of the page) and
+ *   grants write access locally; ownership never moves, so nodes writing
+ *   disjoint parts of one page no longer ping-pong it.
+ * - At release (dsm_lock_release(), dsm_barrier() arrival) each dirty page
+ *   is compared with its twin and the changed bytes are sent to the home
+ *   as run-length PAGE_DIFFs, one OS page at a time for blocks larger
+ *   than PAGE_SIZE. The release waits until every home has applied its
+ *   diffs.
+ * - At acquire (dsm_lock_acquire(), dsm_barrier() exit) cached copies of
+ *   non-home pages are invalidated, so the next access fetches the merged
+ *   page from its home.
+ *
+ * Programs must be data-race free: two nodes may write the same page
+ * between synchronizations, but not the same bytes.
+ *
+ * Barriers do not invalidate every cached copy. Each node keeps write
+ * notices, the pages it diffed or wrote as their home since its last
+ * arrival, and sends them with BARRIER_ARRIVE; the manager returns their
+ * union with BARRIER_RELEASE and only those pages are invalidated at exit.
+ * Lock acquires, and barriers whose notices overflowed, still invalidate
+ * every cached copy.
+ */
+
+#ifndef RELEASE_CONSISTENCY_H
+#define RELEASE_CONSISTENCY_H
+
+#include "dsm/types.h"
+#include "../memory/page_table.h"
+#include "../network/protocol.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Largest encoding of one page's diff (every other byte changed) */
+#define RC_DIFF_MAX_ENCODED (PAGE_SIZE + 4 * (PAGE_SIZE / 2))
+
+/** How long a release waits for diff ACKs */
+#define RC_DIFF_ACK_TIMEOUT_SEC 5
+
+/**
+ * Check whether release consistency is enabled on this node
+ */
+bool rc_enabled(void);
+
+/**
+ * Handle a write fault under release consistency
+ *
+ * Home pages are simply made writable. Other pages are fetched for read
+ * if not present, twinned and made writable.
+ *
+ * @param table Page table holding the entry
+ * @param entry Faulting page entry
+ * @return DSM_SUCCESS on success, error code on failure
+ */
+int rc_write_fault(page_table_t *table, page_entry_t *entry);
+
+/**
+ * Send diffs of all dirty pages to their homes and wait for the ACKs
+ *
+ * Dirty pages become READ_ONLY again and lose their twins.
+ *
+ * @return DSM_SUCCESS, DSM_ERROR_TIMEOUT if a home did not acknowledge, or
+ *         the first error of a diff that could not be sent or applied
+ *         (its writes did not reach the home)
+ */
+int rc_release(void);
+
+/**
+ * Invalidate cached copies of non-home pages
+ *
+ * Pages that are being fetched or are dirty again are left alone;
+ * prefetches still in flight are abandoned.
+ */
+void rc_acquire(void);
+
+/**
+ * Write notices: pages written during a barrier episode
+ */
+typedef struct rc_notices_s {
+    bool overflow;                       /**< More pages than fit: treat every page as written */
+    int count;                           /**< Entries in pages */
+    page_id_t pages[BARRIER_NOTICE_MAX]; /**< Written pages, without duplicates */
+} rc_notices_t;
+
+/**
+ * Add write notices to a set
+ *
+ * @param into Set to add to
+ * @param pages Written pages
+ * @param count Entries in pages
+ * @param overflow Whether the notices being added had overflowed
+ */
+void rc_notices_merge(rc_notices_t *into, const page_id_t *pages, int count, bool overflow);
+
+/**
+ * Move this node's write notices into out and start a new set
+ *
+ * Called at barrier arrival, after rc_release().
+ */
+void rc_take_notices(rc_notices_t *out);
+
+/**
+ * Barrier exit: invalidate cached copies of the pages in a notice set
+ *
+ * Like rc_acquire(), but other cached copies are kept: no node wrote them
+ * during the episode. Falls back to rc_acquire() if notices overflowed.
+ */
+void rc_acquire_notices(const rc_notices_t *notices);
+
+/**
+ * Encode the bytes that differ between a page and its twin
+ *
+ * Output is a sequence of runs [uint16 offset][uint16 length][bytes];
+ * every run covers only changed bytes, so diffs from writers of disjoint
+ * bytes can be applied in any order. Uses the fastest compare kernel the
+ * CPU supports (see diff_kernels.h).
+ *
+ * @param page Current page contents
+ * @param twin Page contents at the first write
+ * @param out Output buffer of at least RC_DIFF_MAX_ENCODED bytes
+ * @param num_runs Output: number of runs
+ * @return Encoded size in bytes (0 if the page is unchanged)
+ */
+size_t rc_encode_diff(const uint8_t *page, const uint8_t *twin, uint8_t *out, int *num_runs);
+
+/**
+ * Apply encoded runs to a page
+ *
+ * @param page Page to update
+ * @param data Encoded runs
+ * @param len Bytes of data
+ * @param num_runs Number of runs in data
+ * @return DSM_SUCCESS, or DSM_ERROR_INVALID if a run is malformed
+ */
+int rc_apply_runs(uint8_t *page, const uint8_t *data, size_t len, int num_runs);
+
+/**
+ * Home side: apply a received PAGE_DIFF to the master copy
+ *
+ * @param page_id Page ID
+ * @param sub_page OS page of the page's block the runs apply to
+ * @param data Encoded runs
+ * @param len Bytes of data
+ * @param num_runs Number of runs
+ * @return DSM_SUCCESS on success, error code on failure
+ */
+int rc_apply_diff(page_id_t page_id, uint16_t sub_page, const uint8_t *data, size_t len, int num_runs);
+
+/**
+ * Writer side: account for a PAGE_DIFF_ACK
+ *
+ * @param result Result reported by the home, or the error sending the diff
+ */
+void rc_diff_acked(int result);
+
+#endif /* RELEASE_CONSISTENCY_H */
@@ -0,0 +1,1029 @@
+/**
+ * @file rma.c
+ * @brief One-sided dsm_get() / dsm_put() and remote atomic implementation
+ */
+
+#include "rma.h"
+#include "directory.h"
+#include "page_migration.h"
+#include "release_consistency.h"
+#include "dsm/dsm.h"
+#include "../core/log.h"
+#include "../core/dsm_context.h"
+#include "../core/stats.h"
+#include "../memory/page_index.h"
+#include "../network/handlers.h"
+#include "../network/msg_pool.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** Service thread wakeup interval while idle */
+#define RMA_POLL_MS 100
+
+/** Requests served per wakeup before re-checking the queue */
+#define RMA_BATCH_MAX 16
+
+/** Progress of one segment of a transfer */
+typedef enum {
+    RMA_SEG_PENDING = 0,  /**< Not sent yet, or to be sent again */
+    RMA_SEG_SENT,         /**< Request in flight */
+    RMA_SEG_DONE,         /**< Bytes transferred, or atomic applied */
+    RMA_SEG_FAILED        /**< Left to the fault path */
+} rma_seg_state_t;
+
+/**
+ * Bytes of one page moved by a transfer
+ */
+typedef struct {
+    page_id_t page_id;      /**< Page holding the bytes */
+    uint32_t offset;        /**< Offset of the bytes in the page's block */
+    uint32_t len;           /**< Bytes (at most RMA_MAX_DATA) */
+    uint8_t *local;         /**< The bytes in the caller's buffer (an atomic's old value) */
+    uint8_t *dsm;           /**< The bytes in DSM memory, for the fault path */
+    node_id_t target;       /**< Node the segment is sent to next */
+    rma_seg_state_t state;  /**< Progress */
+    bool frozen;            /**< Page frozen for ping-pong: served at its owner only */
+} rma_seg_t;
+
+/**
+ * Transfer in flight
+ * Segments are guarded by g_rma.lock once the transfer is listed.
+ */
+struct dsm_rma_s {
+    uint64_t id;               /**< op_id of its requests */
+    rma_op_t op;               /**< Operation of every segment */
+    int num_segs;              /**< Entries of segs */
+    rma_seg_t *segs;           /**< Segments, in address order */
+    int in_flight;             /**< Segments in RMA_SEG_SENT */
+    int rounds;                /**< Times pending segments were sent */
+    uint8_t operands[16];      /**< An atomic's request data */
+    struct timespec deadline;  /**< When unfinished segments go to the fault path */
+    pthread_cond_t replied;    /**< Signaled when in_flight drops */
+    struct dsm_rma_s *next;    /**< Next listed transfer */
+};
+
+static struct {
+    pthread_mutex_t lock;      /**< Protects ops, next_id, queue and running */
+    dsm_rma_t *ops;            /**< Transfers that may still get replies */
+    uint64_t next_id;          /**< op_id of the next transfer */
+    msg_queue_t *queue;        /**< Requests for the service thread, NULL when stopped */
+    volatile bool running;     /**< Service thread keeps running while set */
+    pthread_t thread;
+} g_rma = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .ops = NULL,
+    .next_id = 1,
+    .queue = NULL,
+    .running = false
+};
+
+static void deadline_after_ms(struct timespec *deadline, int ms) {
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += ms / 1000;
+    deadline->tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+static bool deadline_passed(const struct timespec *deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return now.tv_sec > deadline->tv_sec ||
+           (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
+
+/**
+ * Whether the page's directory node froze a page for ping-pong
+ * Its puts and atomics then stay remote rather than move it here.
+ */
+static bool page_frozen(page_id_t page_id) {
+    page_directory_t *dir = get_page_directory();
+    return dir && directory_page_advice(dir, page_id) == DIRECTORY_ADVICE_FROZEN;
+}
+
+/**
+ * Whether this node serves op on a page without taking it from elsewhere
+ *
+ * Gets are served from any valid copy. Puts and atomics need the node that
+ * keeps the page: its owner, or under release consistency its home, whose
+ * write fault (if the copy is read-only) invalidates the other copies.
+ */
+static bool rma_holds(page_table_t *table, page_entry_t *entry, rma_op_t op) {
+    node_id_t self = dsm_get_context()->node_id;
+    pthread_mutex_lock(&table->lock);
+    node_id_t keeper = rc_enabled() ? entry->home : entry->owner;
+    bool held = keeper == self || (op == RMA_GET && entry->state != PAGE_STATE_INVALID);
+    pthread_mutex_unlock(&table->lock);
+    return held;
+}
+
+size_t rma_request_data_len(uint8_t op, const rma_segment_t *seg) {
+    switch (op) {
+        case RMA_GET:       return 0;
+        case RMA_CAS:       return 2 * (size_t)seg->len;
+        default:            return seg->len;
+    }
+}
+
+/** Whether a segment of op lies in its block (and is a word, for an atomic) */
+static bool segment_valid(rma_op_t op, const rma_segment_t *seg, size_t block_size) {
+    if ((uint64_t)seg->offset + seg->len > block_size) {
+        return false;
+    }
+    return op <= RMA_PUT || ((seg->len == 4 || seg->len == 8) && seg->offset % seg->len == 0);
+}
+
+/**
+ * Apply op to len bytes at addr
+ *
+ * @param in A put's bytes or an atomic's operands
+ * @param out Where a get's bytes or an atomic's old value go
+ */
+static void rma_apply(rma_op_t op, uint8_t *addr, uint32_t len, const uint8_t *in, uint8_t *out) {
+    if (op == RMA_GET) {
+        memcpy(out, addr, len);
+        return;
+    }
+    if (op == RMA_PUT) {
+        memcpy(addr, in, len);
+        return;
+    }
+
+    if (len == 4) {
+        uint32_t operand, desired = 0, old;
+        memcpy(&operand, in, 4);
+        if (op == RMA_FETCH_ADD) {
+            old = __atomic_fetch_add((uint32_t *)addr, operand, __ATOMIC_SEQ_CST);
+        } else if (op == RMA_CAS) {
+            memcpy(&desired, in + 4, 4);
+            old = operand;
+            __atomic_compare_exchange_n((uint32_t *)addr, &old, desired, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+        } else {
+            old = __atomic_exchange_n((uint32_t *)addr, operand, __ATOMIC_SEQ_CST);
+        }
+        memcpy(out, &old, 4);
+    } else {
+        uint64_t operand, desired = 0, old;
+        memcpy(&operand, in, 8);
+        if (op == RMA_FETCH_ADD) {
+            old = __atomic_fetch_add((uint64_t *)addr, operand, __ATOMIC_SEQ_CST);
+        } else if (op == RMA_CAS) {
+            memcpy(&desired, in + 8, 8);
+            old = operand;
+            __atomic_compare_exchange_n((uint64_t *)addr, &old, desired, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+        } else {
+            old = __atomic_exchange_n((uint64_t *)addr, operand, __ATOMIC_SEQ_CST);
+        }
+        memcpy(out, &old, 8);
+    }
+}
+
+/* ============================ */
+/*       Serving                */
+/* ============================ */
+
+/**
+ * Serve one segment of another node's request
+ *
+ * @param in A put's bytes or an atomic's operands
+ * @param out Where a get's bytes or an atomic's old value go
+ */
+static rma_status_t serve_segment(rma_op_t op, const rma_segment_t *seg, const uint8_t *in, uint8_t *out) {
+    dsm_context_t *ctx = dsm_get_context();
+    page_table_t *table = NULL;
+    pthread_mutex_lock(&ctx->lock);
+    page_entry_t *entry = page_index_lookup_id(seg->page_id, &table);
+    if (entry) {
+        page_table_acquire(table);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    if (!entry) {
+        return RMA_FAILED;
+    }
+
+    rma_status_t status = RMA_MOVED;
+    if (!segment_valid(op, seg, table->block_size)) {
+        LOG_ERROR("RMA segment of page %lu at %u+%u invalid for op %d in its %zu-byte block",
+                  seg->page_id, seg->offset, seg->len, (int)op, table->block_size);
+        status = RMA_FAILED;
+    } else if (rma_holds(table, entry, op)) {
+        /* Through the mapping, so a copy being invalidated or a read-only
+         * page takes the normal fault path */
+        rma_apply(op, (uint8_t *)entry->local_addr + seg->offset, seg->len, in, out);
+        STATS_INC(rma_segments_served);
+        status = RMA_DONE;
+    }
+    page_table_release(table);
+    return status;
+}
+
+/**
+ * Serve a request and send its RMA_REPLY
+ */
+static void serve_request(const message_t *msg, const uint8_t *data, size_t data_len) {
+    const rma_request_payload_t *req = &msg->payload.rma_request;
+    rma_op_t op = (rma_op_t)req->op;
+    int num_segments = req->num_segments <= RMA_MAX_SEGMENTS ? req->num_segments : RMA_MAX_SEGMENTS;
+
+    size_t total = 0;
+    for (int i = 0; op != RMA_PUT && i < num_segments; i++) {
+        total += req->segments[i].len;
+    }
+    uint8_t *out = total > 0 ? malloc(total) : NULL;
+
+    rma_result_t results[RMA_MAX_SEGMENTS];
+    size_t in = 0;
+    size_t used = 0;
+    for (int i = 0; i < num_segments; i++) {
+        const rma_segment_t *seg = &req->segments[i];
+        size_t in_len = rma_request_data_len(op, seg);
+        rma_status_t status = RMA_FAILED;
+        if (in + in_len <= data_len && (op == RMA_PUT || out)) {
+            status = serve_segment(op, seg, data + in, out + used);
+        }
+        in += in_len;
+        if (op != RMA_PUT && status == RMA_DONE) {
+            used += seg->len;
+        }
+        results[i].index = seg->index;
+        results[i].status = (uint8_t)status;
+    }
+
+    LOG_DEBUG("Served RMA_REQUEST %lu from node %u: %d segments, %zu bytes returned",
+              req->op_id, req->requester, num_segments, used);
+    struct iovec iov = { .iov_base = out, .iov_len = used };
+    send_rma_reply(req->requester, req->op_id, op, results, num_segments, &iov, used > 0 ? 1 : 0);
+    free(out);
+}
+
+int rma_serve_inline(const message_t *msg, const uint8_t *data, size_t data_len) {
+    const rma_request_payload_t *req = &msg->payload.rma_request;
+    if (req->op < RMA_FETCH_ADD || req->op > RMA_SWAP || req->num_segments != 1) {
+        return DSM_ERROR_BUSY;
+    }
+    const rma_segment_t *seg = &req->segments[0];
+    if (data_len != rma_request_data_len(req->op, seg)) {
+        return DSM_ERROR_BUSY;
+    }
+
+    dsm_context_t *ctx = dsm_get_context();
+    page_table_t *table = NULL;
+    pthread_mutex_lock(&ctx->lock);
+    page_entry_t *entry = page_index_lookup_id(seg->page_id, &table);
+    if (entry) {
+        page_table_acquire(table);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    if (!entry) {
+        return DSM_ERROR_BUSY;
+    }
+
+    /* Only this page's handler changes its protection, so a copy writable
+     * now stays writable until the atomic is done */
+    pthread_mutex_lock(&table->lock);
+    bool writable = entry->state == PAGE_STATE_READ_WRITE;
+    pthread_mutex_unlock(&table->lock);
+    if (!writable || !rma_holds(table, entry, (rma_op_t)req->op) ||
+        !segment_valid((rma_op_t)req->op, seg, table->block_size)) {
+        page_table_release(table);
+        return DSM_ERROR_BUSY;
+    }
+
+    uint8_t old[8];
+    rma_apply((rma_op_t)req->op, (uint8_t *)entry->local_addr + seg->offset, seg->len, data, old);
+    page_table_release(table);
+    STATS_INC(rma_segments_served);
+
+    rma_result_t result = { .index = seg->index, .status = RMA_DONE };
+    struct iovec iov = { .iov_base = old, .iov_len = seg->len };
+    send_rma_reply(req->requester, req->op_id, (rma_op_t)req->op, &result, 1, &iov, 1);
+    return DSM_SUCCESS;
+}
+
+static void* rma_service_thread(void *arg) {
+    msg_queue_t *queue = (msg_queue_t *)arg;
+    msg_queue_entry_t *batch[RMA_BATCH_MAX];
+
+    LOG_DEBUG("RMA service thread started");
+
+    for (;;) {
+        msg_queue_wait(queue, RMA_POLL_MS);
+
+        int n = msg_queue_dequeue_batch(queue, batch, RMA_BATCH_MAX);
+        for (int i = 0; i < n; i++) {
+            serve_request(&batch[i]->msg, batch[i]->data, batch[i]->data_len);
+            msg_pool_put(batch[i]);
+        }
+
+        /* Exit only once the queue is drained so every request is answered */
+        if (n == 0 && !g_rma.running) {
+            break;
+        }
+    }
+
+    LOG_DEBUG("RMA service thread stopped");
+    return NULL;
+}
+
+int rma_start(const dsm_config_t *config) {
+    if (config->num_nodes <= 1) {
+        return DSM_SUCCESS;
+    }
+
+    pthread_mutex_lock(&g_rma.lock);
+    if (g_rma.queue) {
+        pthread_mutex_unlock(&g_rma.lock);
+        return DSM_SUCCESS;
+    }
+
+    msg_queue_t *queue = msg_queue_create();
+    if (!queue) {
+        pthread_mutex_unlock(&g_rma.lock);
+        return DSM_ERROR_INIT;
+    }
+    g_rma.running = true;
+    if (pthread_create(&g_rma.thread, NULL, rma_service_thread, queue) != 0) {
+        LOG_ERROR("Failed to create RMA service thread");
+        g_rma.running = false;
+        pthread_mutex_unlock(&g_rma.lock);
+        msg_queue_destroy(queue);
+        return DSM_ERROR_INIT;
+    }
+    g_rma.queue = queue;
+    pthread_mutex_unlock(&g_rma.lock);
+    return DSM_SUCCESS;
+}
+
+void rma_stop(void) {
+    pthread_mutex_lock(&g_rma.lock);
+    msg_queue_t *queue = g_rma.queue;
+    g_rma.queue = NULL;
+    g_rma.running = false;
+    pthread_mutex_unlock(&g_rma.lock);
+
+    if (!queue) {
+        return;
+    }
+    pthread_join(g_rma.thread, NULL);
+    msg_queue_destroy(queue);
+}
+
+int rma_serve(const message_t *msg, const struct iovec *data, int num_data) {
+    size_t total = 0;
+    for (int i = 0; i < num_data; i++) {
+        total += data[i].iov_len;
+    }
+
+    uint8_t *copy = NULL;
+    if (total > 0) {
+        copy = malloc(total);
+        if (!copy) {
+            return DSM_ERROR_MEMORY;
+        }
+        size_t pos = 0;
+        for (int i = 0; i < num_data; i++) {
+            memcpy(copy + pos, data[i].iov_base, data[i].iov_len);
+            pos += data[i].iov_len;
+        }
+    }
+
+    /* Served off the dispatcher: a put may fault and wait for messages */
+    pthread_mutex_lock(&g_rma.lock);
+    int rc = g_rma.queue ? msg_queue_enqueue_data(g_rma.queue, msg, msg->header.sender, copy, total)
+                         : DSM_ERROR_INIT;
+    pthread_mutex_unlock(&g_rma.lock);
+    if (rc != DSM_SUCCESS) {
+        free(copy);
+    }
+    return rc;
+}
+
+/* ============================ */
+/*       Requesting             */
+/* ============================ */
+
+/** Look up the listed transfer with an op_id (under g_rma.lock) */
+static dsm_rma_t* find_op(uint64_t id) {
+    dsm_rma_t *op = g_rma.ops;
+    while (op && op->id != id) {
+        op = op->next;
+    }
+    return op;
+}
+
+/**
+ * Node to send a pending segment to
+ *
+ * The first round uses the owner (home) hint. Later rounds ask the
+ * directory: its own on the page's directory node, or an unaddressed
+ * request the manager resolves elsewhere.
+ */
+static node_id_t segment_target(const rma_seg_t *seg, bool resolve) {
+    if (!resolve) {
+        return seg->target;
+    }
+    node_id_t owner = DSM_NODE_NONE;
+    if (directory_is_local(seg->page_id)) {
+        page_directory_t *dir = get_page_directory();
+        if (!dir || directory_lookup(dir, seg->page_id, &owner) != DSM_SUCCESS) {
+            return DSM_NODE_NONE;
+        }
+    }
+    return owner;
+}
+
+/**
+ * Send every pending segment, one RMA_REQUEST per target and at most
+ * RMA_MAX_SEGMENTS segments or RMA_MAX_DATA bytes each
+ *
+ * Segments no request can be sent for are left to the fault path.
+ */
+static void issue_segments(dsm_rma_t *op) {
+    dsm_context_t *ctx = dsm_get_context();
+    rma_segment_t wire[RMA_MAX_SEGMENTS];
+    struct iovec iov[RMA_MAX_SEGMENTS];
+    int index[RMA_MAX_SEGMENTS];
+
+    pthread_mutex_lock(&g_rma.lock);
+    bool resolve = op->rounds > 0;
+    op->rounds++;
+    for (int i = 0; i < op->num_segs; i++) {
+        if (op->segs[i].state != RMA_SEG_PENDING) {
+            continue;
+        }
+        node_id_t target = segment_target(&op->segs[i], resolve);
+        op->segs[i].target = target;
+        /* Only the manager resolves unaddressed requests, and this node
+         * found the bytes were not here. With the distributed directory
+         * the manager may not know the owner either */
+        if (target == ctx->node_id || target >= (node_id_t)ctx->network.max_nodes) {
+            if (target != DSM_NODE_NONE || ctx->config.is_manager || directory_distributed()) {
+                op->segs[i].state = RMA_SEG_FAILED;
+            }
+        }
+    }
+
+    for (;;) {
+        /* Gather the next batch: the first pending segment's target */
+        int count = 0;
+        size_t bytes = 0;
+        node_id_t target = DSM_NODE_NONE;
+        for (int i = 0; i < op->num_segs && count < RMA_MAX_SEGMENTS; i++) {
+            rma_seg_t *seg = &op->segs[i];
+            if (seg->state != RMA_SEG_PENDING || (count > 0 && seg->target != target) ||
+                bytes + seg->len > RMA_MAX_DATA) {
+                continue;
+            }
+            target = seg->target;
+            wire[count].page_id = seg->page_id;
+            wire[count].offset = seg->offset;
+            wire[count].len = seg->len;
+            wire[count].index = (uint32_t)i;
+            iov[count].iov_base = op->op == RMA_PUT ? seg->local : op->operands;
+            iov[count].iov_len = rma_request_data_len(op->op, &wire[count]);
+            index[count++] = i;
+            bytes += seg->len;
+            seg->state = RMA_SEG_SENT;
+        }
+        if (count == 0) {
+            break;
+        }
+        op->in_flight += count;
+        pthread_mutex_unlock(&g_rma.lock);
+
+        /* Replies may arrive as soon as this returns; they only complete
+         * segments still SENT */
+        int rc = send_rma_request(target, op->id, op->op, wire, count,
+                                  iov, op->op == RMA_GET ? 0 : count);
+
+        pthread_mutex_lock(&g_rma.lock);
+        if (rc == DSM_SUCCESS) {
+            STATS_INC(rma_requests);
+            continue;
+        }
+        LOG_WARN("Failed to send RMA_REQUEST %lu to node %d (rc=%d)", op->id,
+                 target == DSM_NODE_NONE ? 0 : (int)target, rc);
+        for (int k = 0; k < count; k++) {
+            if (op->segs[index[k]].state == RMA_SEG_SENT) {
+                op->segs[index[k]].state = RMA_SEG_FAILED;
+                op->in_flight--;
+            }
+        }
+    }
+    pthread_mutex_unlock(&g_rma.lock);
+}
+
+int rma_complete(const message_t *msg, const uint8_t *data, size_t data_len) {
+    const rma_reply_payload_t *reply = &msg->payload.rma_reply;
+    int num_results = reply->num_results <= RMA_MAX_SEGMENTS ? reply->num_results : RMA_MAX_SEGMENTS;
+
+    pthread_mutex_lock(&g_rma.lock);
+    dsm_rma_t *op = find_op(reply->op_id);
+    if (!op) {
+        pthread_mutex_unlock(&g_rma.lock);
+        LOG_DEBUG("Dropping RMA_REPLY for finished transfer %lu", reply->op_id);
+        return DSM_ERROR_NOT_FOUND;
+    }
+
+    /* The whole frame is checked first so a malformed one copies nothing */
+    size_t total = 0;
+    bool valid = reply->op == op->op;
+    for (int i = 0; i < num_results && valid; i++) {
+        valid = reply->results[i].index < (uint32_t)op->num_segs;
+        if (valid && op->op != RMA_PUT && reply->results[i].status == RMA_DONE) {
+            total += op->segs[reply->results[i].index].len;
+        }
+    }
+    if (valid && total != data_len) {
+        valid = false;
+    }
+    if (!valid) {
+        LOG_ERROR("Malformed RMA_REPLY %lu from node %u (%zu data bytes)",
+                  reply->op_id, msg->header.sender, data_len);
+    }
+
+    size_t offset = 0;
+    for (int i = 0; i < num_results; i++) {
+        if (reply->results[i].index >= (uint32_t)op->num_segs) {
+            continue;
+        }
+        rma_seg_t *seg = &op->segs[reply->results[i].index];
+        uint8_t status = valid ? reply->results[i].status : RMA_FAILED;
+        size_t at = offset;
+        if (op->op != RMA_PUT && status == RMA_DONE) {
+            offset += seg->len;
+        }
+        if (seg->state != RMA_SEG_SENT) {
+            continue;
+        }
+
+        if (status == RMA_DONE) {
+            if (op->op != RMA_PUT) {
+                memcpy(seg->local, data + at, seg->len);
+            }
+            if (op->op <= RMA_PUT) {
+                STATS_ADD(rma_bytes, seg->len);
+            }
+            seg->state = RMA_SEG_DONE;
+        } else if (status == RMA_MOVED) {
+            seg->state = RMA_SEG_PENDING;
+        } else {
+            seg->state = RMA_SEG_FAILED;
+        }
+        op->in_flight--;
+    }
+    pthread_cond_broadcast(&op->replied);
+    pthread_mutex_unlock(&g_rma.lock);
+
+    return valid ? DSM_SUCCESS : DSM_ERROR_INVALID;
+}
+
+/**
+ * Whether a listed transfer is done with the network (under g_rma.lock)
+ *
+ * @param retry Set if segments wait to be sent again
+ */
+static bool op_settled(const dsm_rma_t *op, bool *retry) {
+    *retry = false;
+    if (op->in_flight > 0) {
+        return false;
+    }
+    bool frozen = false;
+    for (int i = 0; i < op->num_segs; i++) {
+        if (op->segs[i].state == RMA_SEG_PENDING) {
+            *retry = true;
+            frozen = frozen || op->segs[i].frozen;
+        }
+    }
+    return !*retry || (op->rounds >= RMA_MAX_ROUNDS && !frozen);
+}
+
+/**
+ * Unlist a transfer, move its unfinished segments through the fault path
+ * and free it
+ *
+ * An atomic is only applied here if no request for it may have arrived,
+ * and only under sequential consistency, where the write fault makes this
+ * node the page's only writer.
+ *
+ * @return DSM_SUCCESS, DSM_ERROR_TIMEOUT for an atomic whose reply never
+ *         arrived, or DSM_ERROR_NETWORK for one no home could be asked
+ */
+static int finish_op(dsm_rma_t *op) {
+    pthread_mutex_lock(&g_rma.lock);
+    dsm_rma_t **link = &g_rma.ops;
+    while (*link && *link != op) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = op->next;
+    }
+    pthread_mutex_unlock(&g_rma.lock);
+
+    /* No reply touches the segments from here on */
+    int rc = DSM_SUCCESS;
+    int fallbacks = 0;
+    for (int i = 0; i < op->num_segs; i++) {
+        rma_seg_t *seg = &op->segs[i];
+        if (seg->state == RMA_SEG_DONE) {
+            continue;
+        }
+        if (op->op > RMA_PUT) {
+            if (seg->state == RMA_SEG_SENT) {
+                LOG_WARN("RMA atomic %lu on page %lu unanswered; not retried", op->id, seg->page_id);
+                rc = DSM_ERROR_TIMEOUT;
+            } else if (rc_enabled()) {
+                rc = DSM_ERROR_NETWORK;
+            } else {
+                rma_apply(op->op, seg->dsm, seg->len, op->operands, seg->local);
+                fallbacks++;
+            }
+            continue;
+        }
+        if (op->op == RMA_GET) {
+            memcpy(seg->local, seg->dsm, seg->len);
+        } else {
+            memcpy(seg->dsm, seg->local, seg->len);
+        }
+        STATS_ADD(rma_bytes, seg->len);
+        fallbacks++;
+    }
+    if (fallbacks > 0) {
+        STATS_ADD(rma_fallbacks, fallbacks);
+        LOG_DEBUG("RMA transfer %lu: %d segments completed through faults", op->id, fallbacks);
+    }
+
+    pthread_cond_destroy(&op->replied);
+    free(op->segs);
+    free(op);
+    return rc;
+}
+
+/** Node keeping a page, as far as this node knows */
+static node_id_t owner_hint(page_table_t *table, page_entry_t *entry) {
+    node_id_t owner;
+    if (directory_is_local(entry->id)) {
+        page_directory_t *dir = get_page_directory();
+        if (dir && directory_lookup(dir, entry->id, &owner) == DSM_SUCCESS) {
+            return owner;
+        }
+    }
+    pthread_mutex_lock(&table->lock);
+    owner = rc_enabled() ? entry->home : entry->owner;
+    pthread_mutex_unlock(&table->lock);
+    return owner;
+}
+
+/** Give a built transfer its op_id and list it for replies */
+static void list_op(dsm_rma_t *op) {
+    pthread_cond_init(&op->replied, NULL);
+    deadline_after_ms(&op->deadline, RMA_TIMEOUT_MS);
+    pthread_mutex_lock(&g_rma.lock);
+    op->id = g_rma.next_id++;
+    op->next = g_rma.ops;
+    g_rma.ops = op;
+    pthread_mutex_unlock(&g_rma.lock);
+}
+
+/**
+ * Split a range into segments, copy the bytes held here and send the rest
+ */
+static int rma_start_op(rma_op_t kind, uint8_t *local, uint8_t *dsm_addr, size_t len,
+                        dsm_rma_t **handle) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (!ctx || !ctx->initialized) {
+        return DSM_ERROR_INIT;
+    }
+    if (!local || !dsm_addr || len == 0 || !handle) {
+        return DSM_ERROR_INVALID;
+    }
+    uintptr_t start = (uintptr_t)dsm_addr;
+    uintptr_t end = start + len;
+    if (end < start) {
+        return DSM_ERROR_INVALID;
+    }
+
+    dsm_rma_t *op = calloc(1, sizeof(*op));
+    if (!op) {
+        return DSM_ERROR_MEMORY;
+    }
+    op->op = kind;
+    int capacity = 0;
+    bool *held = NULL;
+
+    /* One block piece at a time; the whole range is checked before any
+     * byte is copied */
+    int rc = DSM_SUCCESS;
+    uintptr_t pos = start;
+    while (pos < end) {
+        page_table_t *table = NULL;
+        pthread_mutex_lock(&ctx->lock);
+        page_entry_t *entry = page_index_lookup_addr((void *)pos, &table);
+        if (entry) {
+            page_table_acquire(table);
+        }
+        pthread_mutex_unlock(&ctx->lock);
+        if (!entry) {
+            rc = DSM_ERROR_NOT_FOUND;
+            break;
+        }
+
+        if (op->num_segs == capacity) {
+            int grown = capacity ? capacity * 2 : 16;
+            rma_seg_t *segs = realloc(op->segs, (size_t)grown * sizeof(*segs));
+            bool *flags = realloc(held, (size_t)grown * sizeof(*flags));
+            if (segs) {
+                op->segs = segs;
+            }
+            if (flags) {
+                held = flags;
+            }
+            if (!segs || !flags) {
+                page_table_release(table);
+                rc = DSM_ERROR_MEMORY;
+                break;
+            }
+            capacity = grown;
+        }
+
+        size_t offset = pos - (uintptr_t)entry->local_addr;
+        size_t n = table->block_size - offset;
+        if (n > end - pos) {
+            n = end - pos;
+        }
+        if (n > RMA_MAX_DATA) {
+            n = RMA_MAX_DATA;
+        }
+
+        rma_seg_t *seg = &op->segs[op->num_segs];
+        seg->page_id = entry->id;
+        seg->offset = (uint32_t)offset;
+        seg->len = (uint32_t)n;
+        seg->local = local + (pos - start);
+        seg->dsm = (uint8_t *)pos;
+        seg->state = RMA_SEG_PENDING;
+        seg->frozen = kind != RMA_GET && page_frozen(entry->id);
+        held[op->num_segs] = rma_holds(table, entry, kind);
+        seg->target = held[op->num_segs] ? ctx->node_id : owner_hint(table, entry);
+        op->num_segs++;
+
+        page_table_release(table);
+        pos += n;
+    }
+
+    if (rc != DSM_SUCCESS) {
+        free(held);
+        free(op->segs);
+        free(op);
+        return rc;
+    }
+
+    for (int i = 0; i < op->num_segs; i++) {
+        rma_seg_t *seg = &op->segs[i];
+        if (!held[i]) {
+            continue;
+        }
+        if (kind == RMA_GET) {
+            memcpy(seg->local, seg->dsm, seg->len);
+        } else {
+            memcpy(seg->dsm, seg->local, seg->len);
+        }
+        STATS_ADD(rma_bytes, seg->len);
+        seg->state = RMA_SEG_DONE;
+    }
+    free(held);
+
+    list_op(op);
+    issue_segments(op);
+
+    LOG_DEBUG("RMA transfer %lu: %s of %zu bytes at %p in %d segments",
+              op->id, kind == RMA_PUT ? "put" : "get", len, (void *)dsm_addr, op->num_segs);
+    *handle = op;
+    return DSM_SUCCESS;
+}
+
+/* ============================ */
+/*       Public API             */
+/* ============================ */
+
+int dsm_get_nb(void *local_buf, const void *dsm_addr, size_t len, dsm_rma_t **handle) {
+    return rma_start_op(RMA_GET, local_buf, (uint8_t *)dsm_addr, len, handle);
+}
+
+int dsm_put_nb(void *dsm_addr, const void *local_buf, size_t len, dsm_rma_t **handle) {
+    return rma_start_op(RMA_PUT, (uint8_t *)local_buf, dsm_addr, len, handle);
+}
+
+int dsm_rma_wait(dsm_rma_t *handle) {
+    if (!handle) {
+        return DSM_ERROR_INVALID;
+    }
+
+    pthread_mutex_lock(&g_rma.lock);
+    for (;;) {
+        bool retry;
+        if (op_settled(handle, &retry)) {
+            break;
+        }
+        if (retry) {
+            if (deadline_passed(&handle->deadline)) {
+                break;
+            }
+            /* Only a frozen page's segments go past the round limit */
+            bool pause = handle->rounds >= RMA_MAX_ROUNDS;
+            pthread_mutex_unlock(&g_rma.lock);
+            if (pause) {
+                usleep(RMA_FROZEN_RETRY_US);
+            }
+            issue_segments(handle);
+            pthread_mutex_lock(&g_rma.lock);
+            continue;
+        }
+        if (pthread_cond_timedwait(&handle->replied, &g_rma.lock, &handle->deadline) == ETIMEDOUT) {
+            LOG_WARN("RMA transfer %lu: %d segments unanswered after %d ms",
+                     handle->id, handle->in_flight, RMA_TIMEOUT_MS);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_rma.lock);
+
+    return finish_op(handle);
+}
+
+int dsm_rma_test(dsm_rma_t *handle, bool *done) {
+    if (!handle || !done) {
+        return DSM_ERROR_INVALID;
+    }
+
+    pthread_mutex_lock(&g_rma.lock);
+    bool retry;
+    bool settled = op_settled(handle, &retry);
+    if (!settled && retry) {
+        pthread_mutex_unlock(&g_rma.lock);
+        issue_segments(handle);
+        pthread_mutex_lock(&g_rma.lock);
+        settled = op_settled(handle, &retry);
+    }
+    pthread_mutex_unlock(&g_rma.lock);
+
+    *done = settled || deadline_passed(&handle->deadline);
+    return *done ? finish_op(handle) : DSM_SUCCESS;
+}
+
+int dsm_get(void *local_buf, const void *dsm_addr, size_t len) {
+    dsm_rma_t *handle;
+    int rc = dsm_get_nb(local_buf, dsm_addr, len, &handle);
+    return rc == DSM_SUCCESS ? dsm_rma_wait(handle) : rc;
+}
+
+int dsm_put(void *dsm_addr, const void *local_buf, size_t len) {
+    dsm_rma_t *handle;
+    int rc = dsm_put_nb(dsm_addr, local_buf, len, &handle);
+    return rc == DSM_SUCCESS ? dsm_rma_wait(handle) : rc;
+}
+
+/**
+ * Apply an atomic to a naturally aligned word of DSM memory
+ *
+ * Applied in place when this node keeps the page, otherwise sent to the
+ * keeper as a one-segment request.
+ *
+ * @param a Addend, expected or new value
+ * @param b Desired value (RMA_CAS)
+ * @param old Receives the word's previous value (may be NULL)
+ */
+static int rma_atomic(rma_op_t kind, void *addr, size_t width, uint64_t a, uint64_t b, uint64_t *old) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (!ctx || !ctx->initialized) {
+        return DSM_ERROR_INIT;
+    }
+    if (!addr || (uintptr_t)addr % width != 0) {
+        return DSM_ERROR_INVALID;
+    }
+
+    page_table_t *table = NULL;
+    pthread_mutex_lock(&ctx->lock);
+    page_entry_t *entry = page_index_lookup_addr(addr, &table);
+    if (entry) {
+        page_table_acquire(table);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    if (!entry) {
+        return DSM_ERROR_NOT_FOUND;
+    }
+
+    if (rc_enabled()) {
+        pthread_mutex_lock(&table->lock);
+        bool homeless = entry->home == DSM_NODE_NONE;
+        pthread_mutex_unlock(&table->lock);
+        if (homeless) {
+            /* The first touch claims the home or learns it */
+            (void)*(volatile uint8_t *)addr;
+        }
+    }
+
+    uint8_t in[16];
+    uint8_t out[8] = {0};
+    if (width == 4) {
+        uint32_t words[2] = { (uint32_t)a, (uint32_t)b };
+        memcpy(in, words, sizeof(words));
+    } else {
+        uint64_t words[2] = { a, b };
+        memcpy(in, words, sizeof(words));
+    }
+
+    int rc = DSM_SUCCESS;
+    if (rma_holds(table, entry, kind)) {
+        rma_apply(kind, addr, (uint32_t)width, in, out);
+        page_table_release(table);
+    } else {
+        dsm_rma_t *op = calloc(1, sizeof(*op));
+        rma_seg_t *seg = calloc(1, sizeof(*seg));
+        if (!op || !seg) {
+            page_table_release(table);
+            free(op);
+            free(seg);
+            return DSM_ERROR_MEMORY;
+        }
+        op->op = kind;
+        op->num_segs = 1;
+        op->segs = seg;
+        memcpy(op->operands, in, sizeof(in));
+        seg->page_id = entry->id;
+        seg->offset = (uint32_t)((uintptr_t)addr - (uintptr_t)entry->local_addr);
+        seg->len = (uint32_t)width;
+        seg->local = out;
+        seg->dsm = addr;
+        seg->state = RMA_SEG_PENDING;
+        seg->frozen = page_frozen(entry->id);
+        seg->target = owner_hint(table, entry);
+        page_table_release(table);
+
+        list_op(op);
+        issue_segments(op);
+        rc = dsm_rma_wait(op);
+    }
+    if (rc != DSM_SUCCESS) {
+        return rc;
+    }
+
+    STATS_INC(atomic_ops);
+    if (old) {
+        if (width == 4) {
+            uint32_t word;
+            memcpy(&word, out, 4);
+            *old = word;
+        } else {
+            memcpy(old, out, 8);
+        }
+    }
+    return DSM_SUCCESS;
+}
+
+int dsm_atomic_fetch_add32(void *addr, uint32_t value, uint32_t *old) {
+    uint64_t prev;
+    int rc = rma_atomic(RMA_FETCH_ADD, addr, 4, value, 0, &prev);
+    if (rc == DSM_SUCCESS && old) {
+        *old = (uint32_t)prev;
+    }
+    return rc;
+}
+
+int dsm_atomic_fetch_add64(void *addr, uint64_t value, uint64_t *old) {
+    return rma_atomic(RMA_FETCH_ADD, addr, 8, value, 0, old);
+}
+
+int dsm_atomic_cas32(void *addr, uint32_t expected, uint32_t desired, uint32_t *old) {
+    uint64_t prev;
+    int rc = rma_atomic(RMA_CAS, addr, 4, expected, desired, &prev);
+    if (rc == DSM_SUCCESS && old) {
+        *old = (uint32_t)prev;
+    }
+    return rc;
+}
+
+int dsm_atomic_cas64(void *addr, uint64_t expected, uint64_t desired, uint64_t *old) {
+    return rma_atomic(RMA_CAS, addr, 8, expected, desired, old);
+}
+
+int dsm_atomic_swap32(void *addr, uint32_t value, uint32_t *old) {
+    uint64_t prev;
+    int rc = rma_atomic(RMA_SWAP, addr, 4, value, 0, &prev);
+    if (rc == DSM_SUCCESS && old) {
+        *old = (uint32_t)prev;
+    }
+    return rc;
+}
+
+int dsm_atomic_swap64(void *addr, uint64_t value, uint64_t *old) {
+    return rma_atomic(RMA_SWAP, addr, 8, value, 0, old);
+}
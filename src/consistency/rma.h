@@ -0,0 +1,113 @@
+/**
+ * @file rma.h
+ * @brief One-sided dsm_get() / dsm_put() transfers and remote atomics
+ *
+ * A transfer is split into segments, the bytes of one page each. Pages
+ * this node holds are copied in place; the others are read or written at
+ * the node holding them with RMA_REQUESTs, one per target and up to
+ * RMA_MAX_SEGMENTS segments or RMA_MAX_DATA bytes each. No page changes
+ * owner and the requester's page permissions are untouched.
+ *
+ * A page is held, for a get, by any node with a valid copy (under release
+ * consistency, the home or a node with a cached copy) and, for a put, by
+ * its owner (the home under release consistency). Requests first go to
+ * the owner hint of each page; a target that no longer holds a page
+ * answers RMA_MOVED and the segment is sent again through the manager's
+ * directory. Segments still unfinished after RMA_MAX_ROUNDS rounds or
+ * RMA_TIMEOUT_MS are completed through the fault path, as a plain memcpy
+ * would, so a transfer always completes. A page frozen for ping-pong
+ * (dsm_config_t.adaptive) is the exception to the round limit: the fault
+ * path would move it, so its segments keep going to its owner, every
+ * RMA_FROZEN_RETRY_US, until RMA_TIMEOUT_MS.
+ *
+ * Targets serve requests on one service thread rather than the
+ * dispatcher, because a put into a page held read-only goes through the
+ * normal write fault: the owner keeps the page and its other copies are
+ * invalidated, exactly as for a local write.
+ *
+ * dsm_atomic_*() are one-segment requests executed by the page's owner
+ * (home under release consistency) on its mapping. A target whose copy is
+ * writable applies them on the dispatcher, in order with the page's other
+ * messages; otherwise the service thread does, after the write fault. An
+ * atomic is applied exactly once: one whose reply never arrives reports
+ * DSM_ERROR_TIMEOUT instead of being retried.
+ */
+
+#ifndef RMA_H
+#define RMA_H
+
+#include "dsm/types.h"
+#include "../network/protocol.h"
+#include <sys/uio.h>
+
+/** How long a transfer waits for replies before completing through faults */
+#define RMA_TIMEOUT_MS 10000
+
+/** Times an unfinished segment is sent before it completes through a fault */
+#define RMA_MAX_ROUNDS 3
+
+/** Pause between further rounds for a frozen page */
+#define RMA_FROZEN_RETRY_US 1000
+
+/**
+ * Start the service thread that answers other nodes' RMA_REQUESTs
+ * No-op for a single-node run.
+ *
+ * @param config DSM configuration
+ * @return DSM_SUCCESS, or DSM_ERROR_INIT if the thread cannot be created
+ */
+int rma_start(const dsm_config_t *config);
+
+/**
+ * Serve the requests already queued and stop the service thread
+ */
+void rma_stop(void);
+
+/**
+ * Queue an RMA_REQUEST addressed to this node for the service thread
+ *
+ * @param msg Request (its segments are served here)
+ * @param data A put's bytes, in segment order (copied)
+ * @param num_data Entries of data
+ * @return DSM_SUCCESS, DSM_ERROR_INIT if the service is not running, or
+ *         DSM_ERROR_MEMORY
+ */
+int rma_serve(const message_t *msg, const struct iovec *data, int num_data);
+
+/**
+ * Apply an atomic RMA_REQUEST addressed to this node on the calling thread
+ *
+ * Only done when the page is writable here, so the operation cannot fault;
+ * the caller must be the handler of the page's shard.
+ *
+ * @param msg Request
+ * @param data Its operands
+ * @param data_len Bytes of data
+ * @return DSM_SUCCESS once the reply is sent, DSM_ERROR_BUSY if the
+ *         request must go to rma_serve() instead
+ */
+int rma_serve_inline(const message_t *msg, const uint8_t *data, size_t data_len);
+
+/**
+ * Bytes of request data a segment carries
+ *
+ * @param op rma_op_t of the request
+ * @param seg Segment
+ * @return seg->len for a put, the operands for an atomic, 0 for a get
+ */
+size_t rma_request_data_len(uint8_t op, const rma_segment_t *seg);
+
+/**
+ * Apply an RMA_REPLY to the operation that sent the request
+ * Replies for operations already completed are dropped.
+ *
+ * @param msg Reply
+ * @param data The bytes of a get's RMA_DONE segments or an atomic's old
+ *             value, in result order
+ * @param data_len Bytes of data
+ * @return DSM_SUCCESS, DSM_ERROR_NOT_FOUND for an unknown operation, or
+ *         DSM_ERROR_INVALID if data does not match the results
+ */
+int rma_complete(const message_t *msg, const uint8_t *data, size_t data_len);
+
+#endif /* RMA_H */
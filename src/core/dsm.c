@@ -7,16 +7,109 @@
 #include "dsm_context.h"
 #include "log.h"
 #include "perf_log.h"
+#include "stats.h"
+#include "sharing_profile.h"
+#include "metrics.h"
+#include "../memory/checkpoint.h"
 #include "../memory/fault_handler.h"
+#include "../memory/userfault.h"
+#include "../consistency/async_access.h"
 #include "../consistency/page_migration.h"
 #include "../consistency/directory.h"
+#include "../consistency/rma.h"
 #include "../network/network.h"
 #include "../network/handlers.h"
+#include "../network/transport.h"
+#include "../network/replication.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+/** Longest the manager waits for all workers to join */
+#define BOOTSTRAP_TIMEOUT_SEC 60
+
+/**
+ * Initialize Node 1 as the primary backup (PHASE 9)
+ * Workers do this before NODE_JOIN, so the manager never replicates to a
+ * backup that has no shadow tables yet.
+ *
+ * @return DSM_SUCCESS, or DSM_ERROR_MEMORY (the caller cleans up)
+ */
+static int init_backup_state(const dsm_config_t *config) {
+    LOG_INFO("Initializing Node 1 as primary backup for hot failover");
+
+    dsm_context_t *ctx = dsm_get_context();
+    pthread_mutex_lock(&ctx->lock);
+
+    /* Set backup flags */
+    ctx->network.backup_state.is_backup = true;
+    ctx->network.backup_state.is_primary_backup = true;
+    ctx->network.backup_state.is_promoted = false;
+    ctx->network.backup_state.current_manager = 0;  /* Node 0 is initial manager */
+    ctx->network.backup_state.last_sync_seq = 0;
+
+    /* Create shadow directory structure for replication (100K buckets as per plan) */
+    ctx->network.backup_state.backup_directory = directory_create(100000);
+    if (!ctx->network.backup_state.backup_directory) {
+        LOG_ERROR("Failed to create backup directory");
+        pthread_mutex_unlock(&ctx->lock);
+        return DSM_ERROR_MEMORY;
+    }
+
+    /* Shadow lock and barrier tables start zeroed in dsm_context_init()
+     * and grow on demand; entries are allocated lazily */
+
+    /* Initialize promotion lock to prevent split-brain */
+    pthread_mutex_init(&ctx->network.backup_state.promotion_lock, NULL);
+
+    pthread_mutex_unlock(&ctx->lock);
+
+    /* Prepare backup server socket (bind but don't listen yet) */
+    /* IMPORTANT: Bind to manager's port, not this node's port! */
+    uint16_t manager_port = config->manager_port;  /* Port manager listens on */
+    int rc = network_prepare_backup_server(manager_port);
+    if (rc != DSM_SUCCESS) {
+        LOG_WARN("Failed to prepare backup server socket on port %u (rc=%d), continuing anyway", manager_port, rc);
+        /* Not fatal - can still function as backup without pre-bound socket */
+    }
+
+    LOG_INFO("Node 1 initialized as primary backup (shadow directory created, promotion lock initialized)");
+    return DSM_SUCCESS;
+}
+
+/**
+ * Wait on membership_cv until pred() holds or timeout_sec pass
+ *
+ * @return true if pred() held
+ */
+static bool wait_for_membership(bool (*pred)(dsm_context_t *ctx, int arg), int arg, int timeout_sec) {
+    dsm_context_t *ctx = dsm_get_context();
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_sec;
+
+    pthread_mutex_lock(&ctx->lock);
+    int rc = 0;
+    while (!pred(ctx, arg) && rc != ETIMEDOUT) {
+        rc = pthread_cond_timedwait(&ctx->network.membership_cv, &ctx->lock, &deadline);
+    }
+    bool done = pred(ctx, arg);
+    pthread_mutex_unlock(&ctx->lock);
+    return done;
+}
+
+static bool workers_joined(dsm_context_t *ctx, int expected) {
+    return ctx->network.num_nodes >= expected;
+}
+
+static bool roster_received(dsm_context_t *ctx, int unused) {
+    (void)unused;
+    return ctx->network.roster_size > 0;
+}
 
 int dsm_init(const dsm_config_t *config) {
     if (!config) {
@@ -24,7 +117,11 @@ int dsm_init(const dsm_config_t *config) {
         return DSM_ERROR_INVALID;
     }
 
+    uint64_t start_ns = perf_get_timestamp_ns();
     log_init(config->log_level);
+    if (config->log_async && log_start_async() != 0) {
+        LOG_WARN("Async logging unavailable, logging synchronously");
+    }
     LOG_INFO("Initializing DSM (node_id=%u, port=%u)",
              config->node_id, config->port);
 
@@ -34,6 +131,12 @@ int dsm_init(const dsm_config_t *config) {
         return rc;
     }
 
+    /* Profiling is optional: a run without it is still useful */
+    if (config->sharing_profile_pages > 0 &&
+        sharing_profile_init(config->sharing_profile_pages) != DSM_SUCCESS) {
+        LOG_WARN("Sharing profiler unavailable, continuing without it");
+    }
+
     rc = install_fault_handler();
     if (rc != DSM_SUCCESS) {
         LOG_ERROR("Failed to install fault handler");
@@ -41,6 +144,15 @@ int dsm_init(const dsm_config_t *config) {
         return rc;
     }
 
+    /* Peers' dsm_get()/dsm_put() requests are served from here on */
+    rc = rma_start(config);
+    if (rc != DSM_SUCCESS) {
+        LOG_ERROR("Failed to start the one-sided transfer service");
+        uninstall_fault_handler();
+        dsm_context_cleanup();
+        return rc;
+    }
+
     /* Initialize network layer */
     if (config->num_nodes > 1) {
         if (config->is_manager) {
@@ -49,16 +161,23 @@ int dsm_init(const dsm_config_t *config) {
             rc = network_server_init(config->port);
             if (rc != DSM_SUCCESS) {
                 LOG_ERROR("Failed to initialize network server");
+                rma_stop();
                 uninstall_fault_handler();
                 dsm_context_cleanup();
                 return rc;
             }
 
-            /* Start message dispatcher */
-            rc = network_start_dispatcher();
+            /* Open the transport backend before any peer can offer it */
+            rc = transport_init(config->transport, !config->disable_shm,
+                                dsm_get_context()->network.max_nodes);
+            if (rc == DSM_SUCCESS) {
+                /* Start message dispatcher */
+                rc = network_start_dispatcher();
+            }
             if (rc != DSM_SUCCESS) {
                 LOG_ERROR("Failed to start network dispatcher");
                 network_shutdown();
+                rma_stop();
                 uninstall_fault_handler();
                 dsm_context_cleanup();
                 return rc;
@@ -67,36 +186,32 @@ int dsm_init(const dsm_config_t *config) {
             /* CRITICAL FIX #2: Start heartbeat thread for failure detection */
             start_heartbeat_thread();
 
-            /* Wait for all workers to connect */
+            /* Directory, lock and barrier changes are batched to the backup;
+             * without the shipper each one is sent as it is recorded */
+            if (replication_start(config->replication) != DSM_SUCCESS) {
+                LOG_WARN("Replication log shipper unavailable, replicating synchronously");
+            }
+
+            /* Wait for all workers to join: NODE_JOIN broadcasts membership_cv */
             LOG_INFO("Waiting for %d workers to connect...", config->num_nodes - 1);
             dsm_context_t *ctx = dsm_get_context();
             int expected_workers = config->num_nodes - 1;
-            int timeout_seconds = 60;
-
-            for (int i = 0; i < timeout_seconds * 10; i++) {
-                pthread_mutex_lock(&ctx->lock);
-                int connected = ctx->network.num_nodes;
-                pthread_mutex_unlock(&ctx->lock);
-
-                if (connected >= expected_workers) {
-                    LOG_INFO("All %d workers connected", expected_workers);
-                    break;
-                }
-
-                usleep(100000);  /* 100ms */
-
-                if (i == timeout_seconds * 10 - 1) {
-                    LOG_ERROR("Timeout waiting for workers (got %d, expected %d)",
-                             connected, expected_workers);
-                    network_shutdown();
-                    uninstall_fault_handler();
-                    dsm_context_cleanup();
-                    return DSM_ERROR_TIMEOUT;
-                }
+            if (!wait_for_membership(workers_joined, expected_workers, BOOTSTRAP_TIMEOUT_SEC)) {
+                LOG_ERROR("Timeout waiting for workers (got %d, expected %d)",
+                          ctx->network.num_nodes, expected_workers);
+                network_shutdown();
+                rma_stop();
+                uninstall_fault_handler();
+                dsm_context_cleanup();
+                return DSM_ERROR_TIMEOUT;
             }
+            LOG_INFO("All %d workers connected", expected_workers);
 
-            /* Give workers a moment to complete their setup */
-            sleep(1);
+            /* Each worker joined once ready, so one roster releases them all */
+            rc = send_node_roster();
+            if (rc != DSM_SUCCESS) {
+                LOG_WARN("Failed to send the roster to every worker (rc=%d)", rc);
+            }
 
         } else {
             /* Worker: Connect to manager */
@@ -106,16 +221,23 @@ int dsm_init(const dsm_config_t *config) {
             rc = network_connect_to_node(0, config->manager_host, config->manager_port);
             if (rc != DSM_SUCCESS) {
                 LOG_ERROR("Failed to connect to manager");
+                rma_stop();
                 uninstall_fault_handler();
                 dsm_context_cleanup();
                 return rc;
             }
 
-            /* Start message dispatcher */
-            rc = network_start_dispatcher();
+            /* Open the transport backend before any peer can offer it */
+            rc = transport_init(config->transport, !config->disable_shm,
+                                dsm_get_context()->network.max_nodes);
+            if (rc == DSM_SUCCESS) {
+                /* Start message dispatcher */
+                rc = network_start_dispatcher();
+            }
             if (rc != DSM_SUCCESS) {
                 LOG_ERROR("Failed to start network dispatcher");
                 network_shutdown();
+                rma_stop();
                 uninstall_fault_handler();
                 dsm_context_cleanup();
                 return rc;
@@ -124,71 +246,79 @@ int dsm_init(const dsm_config_t *config) {
             /* CRITICAL FIX #2: Start heartbeat thread for failure detection */
             start_heartbeat_thread();
 
+            if (config->node_id == 1) {
+                rc = init_backup_state(config);
+                if (rc != DSM_SUCCESS) {
+                    network_shutdown();
+                    rma_stop();
+                    uninstall_fault_handler();
+                    dsm_context_cleanup();
+                    return rc;
+                }
+            }
+
+            /* Other workers open links to us on first use (on any port if
+             * ours is taken); without a listener they reach us through
+             * the manager */
+            if (network_peer_server_init(config->port) != DSM_SUCCESS &&
+                (config->port == 0 || network_peer_server_init(0) != DSM_SUCCESS)) {
+                LOG_WARN("No listener for peer links, traffic from other workers is relayed");
+            }
+
             /* Send NODE_JOIN to identify ourselves to the manager */
             LOG_INFO("Sending NODE_JOIN to manager (node_id=%u)", config->node_id);
             extern int send_node_join(node_id_t node_id, const char *hostname, uint16_t port);
-            rc = send_node_join(config->node_id, "worker", config->port);
+            rc = send_node_join(config->node_id, "worker", dsm_get_context()->network.peer_server_port);
             if (rc != DSM_SUCCESS) {
                 LOG_WARN("Failed to send NODE_JOIN (rc=%d), but continuing", rc);
             }
 
-            /* Give manager time to process NODE_JOIN */
-            usleep(100000);  /* 100ms */
+            /* Move the connection to the transport backend if both ends
+             * have one, or else spread it over tcp_lanes sockets; frames
+             * flow over the first socket until the handshake is done */
+            if (transport_offer(0) != DSM_SUCCESS) {
+                LOG_WARN("Transport offer to manager failed, staying on TCP");
+            }
+
+            /* The roster arrives once every node has joined; the manager
+             * waits up to BOOTSTRAP_TIMEOUT_SEC for the last one */
+            if (!wait_for_membership(roster_received, 0, BOOTSTRAP_TIMEOUT_SEC + 5)) {
+                LOG_WARN("No roster from the manager, continuing");
+            }
 
             LOG_INFO("Connected to manager successfully");
         }
     }
 
-    /* PHASE 9: Initialize backup state for Node 1 (primary backup) */
-    if (config->node_id == 1) {
-        LOG_INFO("Initializing Node 1 as primary backup for hot failover");
-
-        dsm_context_t *ctx = dsm_get_context();
-        pthread_mutex_lock(&ctx->lock);
-
-        /* Set backup flags */
-        ctx->network.backup_state.is_backup = true;
-        ctx->network.backup_state.is_primary_backup = true;
-        ctx->network.backup_state.is_promoted = false;
-        ctx->network.backup_state.current_manager = 0;  /* Node 0 is initial manager */
-        ctx->network.backup_state.last_sync_seq = 0;
-
-        /* Create shadow directory structure for replication (100K buckets as per plan) */
-        ctx->network.backup_state.backup_directory = directory_create(100000);
-        if (!ctx->network.backup_state.backup_directory) {
-            LOG_ERROR("Failed to create backup directory");
-            pthread_mutex_unlock(&ctx->lock);
+    /* PHASE 9: Initialize backup state for Node 1 (primary backup); a
+     * worker did so before joining */
+    if (config->node_id == 1 && (config->num_nodes <= 1 || config->is_manager)) {
+        rc = init_backup_state(config);
+        if (rc != DSM_SUCCESS) {
             network_shutdown();
+            rma_stop();
             uninstall_fault_handler();
             dsm_context_cleanup();
-            return DSM_ERROR_MEMORY;
-        }
-
-        /* Initialize shadow lock structures (256 locks max) */
-        for (int i = 0; i < 256; i++) {
-            ctx->network.backup_state.backup_locks[i] = NULL;  /* Lazy allocation */
-        }
-
-        /* Initialize shadow barrier structures (256 barriers max) */
-        for (int i = 0; i < 256; i++) {
-            ctx->network.backup_state.backup_barriers[i] = NULL;  /* Lazy allocation */
+            return rc;
         }
+    }
 
-        /* Initialize promotion lock to prevent split-brain */
-        pthread_mutex_init(&ctx->network.backup_state.promotion_lock, NULL);
-
-        pthread_mutex_unlock(&ctx->lock);
-
-        /* Prepare backup server socket (bind but don't listen yet) */
-        /* IMPORTANT: Bind to manager's port, not this node's port! */
-        uint16_t manager_port = config->manager_port;  /* Port manager listens on */
-        rc = network_prepare_backup_server(manager_port);
+    /* Restart from a checkpoint once every node is up */
+    if (config->restore_path) {
+        rc = checkpoint_restore(config->restore_path);
         if (rc != DSM_SUCCESS) {
-            LOG_WARN("Failed to prepare backup server socket on port %u (rc=%d), continuing anyway", manager_port, rc);
-            /* Not fatal - can still function as backup without pre-bound socket */
+            LOG_ERROR("Failed to restore checkpoint %s (rc=%d)", config->restore_path, rc);
+            dsm_finalize();
+            return rc;
         }
+    }
+
+    /* Startup time is a counter so it shows up with the other statistics */
+    STATS_ADD(bootstrap_ns, perf_get_timestamp_ns() - start_ns);
 
-        LOG_INFO("Node 1 initialized as primary backup (shadow directory created, promotion lock initialized)");
+    /* Monitoring is optional too */
+    if (metrics_start(config) != DSM_SUCCESS) {
+        LOG_WARN("Live metrics unavailable, continuing without them");
     }
 
     /* Note: consistency module will be initialized when dsm_malloc() creates page table */
@@ -202,6 +332,13 @@ int dsm_finalize(void) {
 
     dsm_context_t *ctx = dsm_get_context();
 
+    /* Final snapshot before teardown changes the counters */
+    metrics_stop();
+
+    /* Requests already received are answered while the network is up */
+    async_access_stop();
+    rma_stop();
+
     /* PHASE 9: Cleanup backup state if this is Node 1 */
     if (ctx->config.node_id == 1 && ctx->network.backup_state.is_backup) {
         LOG_INFO("Cleaning up backup state for Node 1");
@@ -213,7 +350,7 @@ int dsm_finalize(void) {
         }
 
         /* Destroy shadow locks (if any were allocated) */
-        for (int i = 0; i < 256; i++) {
+        for (int i = 0; i < ctx->network.backup_state.backup_locks_capacity; i++) {
             if (ctx->network.backup_state.backup_locks[i]) {
                 free(ctx->network.backup_state.backup_locks[i]);
                 ctx->network.backup_state.backup_locks[i] = NULL;
@@ -221,7 +358,7 @@ int dsm_finalize(void) {
         }
 
         /* Destroy shadow barriers (if any were allocated) */
-        for (int i = 0; i < 256; i++) {
+        for (int i = 0; i < ctx->network.backup_state.backup_barriers_capacity; i++) {
             if (ctx->network.backup_state.backup_barriers[i]) {
                 free(ctx->network.backup_state.backup_barriers[i]);
                 ctx->network.backup_state.backup_barriers[i] = NULL;
@@ -239,11 +376,14 @@ int dsm_finalize(void) {
         network_shutdown();
     }
 
+    handoff_cleanup();
     consistency_cleanup();
     uninstall_fault_handler();
     perf_log_cleanup();  /* Clean up performance logging resources */
+    sharing_profile_cleanup();
     dsm_context_cleanup();
     LOG_INFO("DSM finalized");
+    log_stop_async();
     return DSM_SUCCESS;
 }
 
@@ -257,24 +397,50 @@ int dsm_get_num_nodes(void) {
     return ctx->config.num_nodes;
 }
 
+dsm_fault_engine_t dsm_get_fault_engine(void) {
+    return userfault_active() ? DSM_FAULT_USERFAULTFD : DSM_FAULT_SIGSEGV;
+}
+
+dsm_transport_t dsm_get_transport(void) {
+    return transport_active();
+}
+
+dsm_transport_t dsm_get_peer_transport(node_id_t node) {
+    return transport_peer_kind(node);
+}
+
 int dsm_get_stats(dsm_stats_t *stats) {
     if (!stats) {
         return DSM_ERROR_INVALID;
     }
 
-    dsm_context_t *ctx = dsm_get_context();
-    pthread_mutex_lock(&ctx->stats_lock);
-    *stats = ctx->stats;
-    pthread_mutex_unlock(&ctx->stats_lock);
+    stats_collect(stats);
+
+    return DSM_SUCCESS;
+}
+
+int dsm_get_latency_histogram(dsm_fault_path_t path, dsm_latency_histogram_t *hist) {
+    if (!hist || (unsigned)path >= DSM_FAULT_PATH_COUNT) {
+        return DSM_ERROR_INVALID;
+    }
+
+    stats_collect_histogram(path, hist);
+
+    return DSM_SUCCESS;
+}
+
+int dsm_get_peer_stats(node_id_t peer, dsm_peer_stats_t *out) {
+    if (!out || peer >= DSM_MAX_PEER_STATS) {
+        return DSM_ERROR_INVALID;
+    }
+
+    stats_collect_peer(peer, out);
 
     return DSM_SUCCESS;
 }
 
 int dsm_reset_stats(void) {
-    dsm_context_t *ctx = dsm_get_context();
-    pthread_mutex_lock(&ctx->stats_lock);
-    memset(&ctx->stats, 0, sizeof(dsm_stats_t));
-    pthread_mutex_unlock(&ctx->stats_lock);
+    stats_reset();
     return DSM_SUCCESS;
 }
 
@@ -291,7 +457,8 @@ void dsm_print_stats(void) {
            stats.invalidations_sent, stats.invalidations_received);
     printf("Network:           %lu bytes sent, %lu bytes received\n",
            stats.network_bytes_sent, stats.network_bytes_received);
-    printf("Locks Acquired:    %lu\n", stats.lock_acquires);
+    printf("Locks Acquired:    %lu (%lu from a cached token, %lu shared)\n",
+           stats.lock_acquires, stats.lock_cached_acquires, stats.lock_shared_acquires);
     printf("Barrier Waits:     %lu\n", stats.barrier_waits);
     printf("======================\n\n");
 }
@@ -5,9 +5,22 @@
 
 #include "dsm_context.h"
 #include "log.h"
+#include "stats.h"
+#include "../memory/page_index.h"
+#include "../network/msg_pool.h"
+#include "../network/network.h"
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+
+/* Superseded page_tables array awaiting cleanup */
+typedef struct retired_table_s {
+    void *table;
+    struct retired_table_s *next;
+} retired_table_t;
 
 /* Global singleton instance */
 static dsm_context_t g_dsm_context = {
@@ -31,25 +44,72 @@ int dsm_context_init(const dsm_config_t *config) {
         return DSM_SUCCESS;
     }
 
+    /* Size the node tables: node IDs index them directly */
+    int max_nodes = config->max_nodes;
+    if (max_nodes <= 0) {
+        max_nodes = config->num_nodes > MAX_NODES ? config->num_nodes : MAX_NODES;
+    }
+    if (max_nodes < config->num_nodes || max_nodes > MAX_SHARERS ||
+        config->node_id >= (node_id_t)max_nodes) {
+        LOG_ERROR("Invalid node capacity %d (num_nodes=%d, node_id=%u, limit=%d)",
+                  max_nodes, config->num_nodes, config->node_id, MAX_SHARERS);
+        return DSM_ERROR_INVALID;
+    }
+
+    ctx->network.nodes = calloc(max_nodes, sizeof(node_info_t));
+    /* Every node may have all its TCP lanes and a peer link pending at once */
+    ctx->network.pending_sockets = calloc((size_t)max_nodes * (MAX_TCP_LANES + 1), sizeof(int));
+    ctx->network.alloc_tracker.acks_received = calloc(max_nodes, sizeof(bool));
+    if (!ctx->network.nodes || !ctx->network.pending_sockets ||
+        !ctx->network.alloc_tracker.acks_received) {
+        LOG_ERROR("Failed to allocate node tables (%d nodes)", max_nodes);
+        free(ctx->network.nodes);
+        free(ctx->network.pending_sockets);
+        free(ctx->network.alloc_tracker.acks_received);
+        ctx->network.nodes = NULL;
+        ctx->network.pending_sockets = NULL;
+        ctx->network.alloc_tracker.acks_received = NULL;
+        return DSM_ERROR_MEMORY;
+    }
+    ctx->network.max_nodes = max_nodes;
+    ctx->network.max_pending = max_nodes * (MAX_TCP_LANES + 1);
+    ctx->network.blocked_lanes = 0;
+
     /* Copy config */
     memcpy(&ctx->config, config, sizeof(dsm_config_t));
     ctx->node_id = config->node_id;
 
     /* Initialize mutexes */
     pthread_mutex_init(&ctx->lock, NULL);
-    pthread_mutex_init(&ctx->stats_lock, NULL);
     pthread_mutex_init(&ctx->allocation_lock, NULL);  /* BUG FIX (BUG 3): Initialize allocation lock */
 
     /* Initialize network state */
     ctx->network.server_sockfd = -1;
     ctx->network.server_port = config->port;
+    ctx->network.peer_server_sockfd = -1;
+    ctx->network.peer_server_port = 0;
     ctx->network.num_nodes = 0;
+    ctx->network.roster_size = 0;
+    pthread_cond_init(&ctx->network.membership_cv, NULL);
     ctx->network.running = false;
     ctx->network.dispatcher_thread = 0;
     ctx->network.heartbeat_thread = 0;
-    ctx->network.send_queue = msg_queue_create();
+    ctx->network.senders_running = false;
+
+    /* Dispatcher event loop: sockets are registered once at accept/connect */
+    ctx->network.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    ctx->network.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ctx->network.epoll_fd < 0 || ctx->network.wake_fd < 0) {
+        LOG_ERROR("Failed to create dispatcher event loop");
+        if (ctx->network.epoll_fd >= 0) close(ctx->network.epoll_fd);
+        if (ctx->network.wake_fd >= 0) close(ctx->network.wake_fd);
+        return DSM_ERROR_INIT;
+    }
+    struct epoll_event wake_ev = { .events = EPOLLIN, .data.fd = ctx->network.wake_fd };
+    epoll_ctl(ctx->network.epoll_fd, EPOLL_CTL_ADD, ctx->network.wake_fd, &wake_ev);
     ctx->network.num_pending = 0;
     pthread_mutex_init(&ctx->network.pending_lock, NULL);
+    pthread_mutex_init(&ctx->network.rx_lock, NULL);
     ctx->network.next_seq_num = 1;  /* Start at 1 (0 reserved) */
     pthread_mutex_init(&ctx->network.seq_lock, NULL);
 
@@ -59,22 +119,13 @@ int dsm_context_init(const dsm_config_t *config) {
     ctx->network.alloc_tracker.received_acks = 0;
     pthread_mutex_init(&ctx->network.alloc_tracker.lock, NULL);
     pthread_cond_init(&ctx->network.alloc_tracker.all_acks_cv, NULL);
-    for (int i = 0; i < MAX_NODES; i++) {
+    for (int i = 0; i < ctx->network.max_nodes; i++) {
         ctx->network.alloc_tracker.acks_received[i] = false;
     }
 
-    /* Initialize directory query tracker */
-    ctx->network.dir_tracker.active = false;
-    ctx->network.dir_tracker.complete = false;
-    pthread_mutex_init(&ctx->network.dir_tracker.lock, NULL);
-    pthread_cond_init(&ctx->network.dir_tracker.cv, NULL);
-
-    /* Initialize sharer query tracker (BUG #8 fix) */
-    ctx->network.sharer_tracker.active = false;
-    ctx->network.sharer_tracker.complete = false;
-    ctx->network.sharer_tracker.num_sharers = 0;
-    pthread_mutex_init(&ctx->network.sharer_tracker.lock, NULL);
-    pthread_cond_init(&ctx->network.sharer_tracker.cv, NULL);
+    /* Initialize directory and sharer query tables (BUG #8 fix) */
+    pending_query_table_init(&ctx->network.dir_queries);
+    pending_query_table_init(&ctx->network.sharer_queries);
 
     /* Initialize hot backup state */
     ctx->network.backup_state.is_backup = false;
@@ -86,46 +137,78 @@ int dsm_context_init(const dsm_config_t *config) {
     ctx->network.backup_state.backup_server_sockfd = -1;
     ctx->network.backup_state.backup_server_port = 0;
     pthread_mutex_init(&ctx->network.backup_state.promotion_lock, NULL);
-    for (int i = 0; i < 256; i++) {
-        ctx->network.backup_state.backup_locks[i] = NULL;
-        ctx->network.backup_state.backup_barriers[i] = NULL;
-    }
-
-    for (int i = 0; i < MAX_NODES; i++) {
+    pthread_cond_init(&ctx->network.backup_state.manager_cv, NULL);
+    ctx->network.backup_state.backup_locks = NULL;
+    ctx->network.backup_state.backup_locks_capacity = 0;
+    ctx->network.backup_state.backup_barriers = NULL;
+    ctx->network.backup_state.backup_barriers_capacity = 0;
+    dsm_table_grow(&ctx->network.backup_state.backup_locks,
+                   &ctx->network.backup_state.backup_locks_capacity);
+    dsm_table_grow(&ctx->network.backup_state.backup_barriers,
+                   &ctx->network.backup_state.backup_barriers_capacity);
+
+    for (int i = 0; i < ctx->network.max_nodes; i++) {
         ctx->network.nodes[i].connected = false;
         ctx->network.nodes[i].sockfd = -1;
         ctx->network.nodes[i].last_heartbeat_time = 0;
         ctx->network.nodes[i].missed_heartbeats = 0;
         ctx->network.nodes[i].is_failed = false;
+        pthread_mutex_init(&ctx->network.nodes[i].send_lock, NULL);
+        for (int l = 0; l < MAX_TCP_LANES - 1; l++) {
+            ctx->network.nodes[i].lane_fds[l] = -1;
+        }
+        ctx->network.nodes[i].num_lanes = 0;
+        ctx->network.nodes[i].lanes_tx = false;
+        ctx->network.nodes[i].lanes_rx = false;
+        ctx->network.nodes[i].lanes_wanted = 0;
+        ctx->network.nodes[i].send_queue = msg_queue_create();
+        ctx->network.nodes[i].sender_started = false;
+        ctx->network.nodes[i].peer_addr = 0;
+        ctx->network.nodes[i].peer_port = 0;
+        ctx->network.nodes[i].peer_sockfd = -1;
+        ctx->network.nodes[i].peer_rx_sockfd = -1;
+        ctx->network.nodes[i].peer_failed = false;
+        pthread_mutex_init(&ctx->network.nodes[i].peer_lock, NULL);
+    }
+
+    for (int i = 0; i < ctx->network.max_pending; i++) {
         ctx->network.pending_sockets[i] = -1;
     }
 
     /* Initialize lock manager */
     pthread_mutex_init(&ctx->lock_mgr.lock, NULL);
     ctx->lock_mgr.num_locks = 0;
-    memset(ctx->lock_mgr.locks, 0, sizeof(ctx->lock_mgr.locks));
+    ctx->lock_mgr.locks = NULL;
+    ctx->lock_mgr.capacity = 0;
+    dsm_table_grow((void ***)&ctx->lock_mgr.locks, &ctx->lock_mgr.capacity);
 
     /* Initialize barrier manager */
     pthread_mutex_init(&ctx->barrier_mgr.lock, NULL);
-    ctx->barrier_mgr.max_barriers = 256;
-    ctx->barrier_mgr.barriers = calloc(ctx->barrier_mgr.max_barriers,
-                                       sizeof(dsm_barrier_t));
+    ctx->barrier_mgr.barriers = NULL;
+    ctx->barrier_mgr.max_barriers = 0;
+    ctx->barrier_mgr.first_free = 0;
+    memset(ctx->barrier_mgr.buckets, 0, sizeof(ctx->barrier_mgr.buckets));
+    dsm_table_grow((void ***)&ctx->barrier_mgr.barriers, &ctx->barrier_mgr.max_barriers);
 
     /* Initialize statistics */
-    memset(&ctx->stats, 0, sizeof(dsm_stats_t));
+    stats_reset();
 
     /* Page table will be initialized when first DSM memory is allocated */
     ctx->page_table = NULL;
     ctx->num_allocations = 0;
     ctx->num_local_allocations = 0;  /* CRITICAL FIX: Initialize local allocation counter */
-    for (int i = 0; i < 32; i++) {
-        ctx->page_tables[i] = NULL;
-    }
+    ctx->collective_window = NULL;
+    ctx->collective_used = 0;
+    ctx->num_collective_allocations = 0;
+    ctx->page_tables = NULL;
+    ctx->page_tables_capacity = 0;
+    ctx->retired_page_tables = NULL;
+    dsm_table_grow((void ***)&ctx->page_tables, &ctx->page_tables_capacity);
 
     ctx->initialized = true;
 
-    LOG_INFO("DSM context initialized (node_id=%u, port=%u)",
-             ctx->node_id, config->port);
+    LOG_INFO("DSM context initialized (node_id=%u, port=%u, max_nodes=%d)",
+             ctx->node_id, config->port, ctx->network.max_nodes);
     return DSM_SUCCESS;
 }
 
@@ -141,16 +224,25 @@ void dsm_context_cleanup(void) {
     /* Stop network */
     ctx->network.running = false;
 
-    /* Cleanup network */
-    if (ctx->network.send_queue) {
-        msg_queue_destroy(ctx->network.send_queue);
-    }
+    /* Cleanup network: sender threads must be gone before their queues */
+    extern void network_stop_senders(void);
+    network_stop_senders();
 
     /* Close all connections */
-    for (int i = 0; i < MAX_NODES; i++) {
+    for (int i = 0; i < ctx->network.max_nodes; i++) {
         if (ctx->network.nodes[i].sockfd >= 0) {
             close(ctx->network.nodes[i].sockfd);
         }
+        if (ctx->network.nodes[i].peer_sockfd >= 0) {
+            close(ctx->network.nodes[i].peer_sockfd);
+        }
+        if (ctx->network.nodes[i].peer_rx_sockfd >= 0) {
+            close(ctx->network.nodes[i].peer_rx_sockfd);
+        }
+        msg_queue_destroy(ctx->network.nodes[i].send_queue);
+        ctx->network.nodes[i].send_queue = NULL;
+        pthread_mutex_destroy(&ctx->network.nodes[i].send_lock);
+        pthread_mutex_destroy(&ctx->network.nodes[i].peer_lock);
     }
 
     /* Close pending connections */
@@ -162,28 +254,61 @@ void dsm_context_cleanup(void) {
     }
     pthread_mutex_unlock(&ctx->network.pending_lock);
     pthread_mutex_destroy(&ctx->network.pending_lock);
+    network_release_rx();
+    pthread_mutex_destroy(&ctx->network.rx_lock);
+
+    /* Every queue is gone; give the entries they returned back to malloc */
+    msg_pool_trim();
+
+    /* Free node tables (loops over max_nodes become no-ops) */
+    ctx->network.max_nodes = 0;
+    free(ctx->network.nodes);
+    ctx->network.nodes = NULL;
+    free(ctx->network.pending_sockets);
+    ctx->network.pending_sockets = NULL;
+
+    /* Close dispatcher event loop */
+    if (ctx->network.epoll_fd >= 0) {
+        close(ctx->network.epoll_fd);
+        ctx->network.epoll_fd = -1;
+    }
+    if (ctx->network.wake_fd >= 0) {
+        close(ctx->network.wake_fd);
+        ctx->network.wake_fd = -1;
+    }
     pthread_mutex_destroy(&ctx->network.seq_lock);
 
     /* Cleanup allocation tracker */
     pthread_mutex_destroy(&ctx->network.alloc_tracker.lock);
     pthread_cond_destroy(&ctx->network.alloc_tracker.all_acks_cv);
+    free(ctx->network.alloc_tracker.acks_received);
+    ctx->network.alloc_tracker.acks_received = NULL;
 
-    /* Cleanup directory query tracker */
-    pthread_mutex_destroy(&ctx->network.dir_tracker.lock);
-    pthread_cond_destroy(&ctx->network.dir_tracker.cv);
-
-    /* Cleanup sharer query tracker */
-    pthread_mutex_destroy(&ctx->network.sharer_tracker.lock);
-    pthread_cond_destroy(&ctx->network.sharer_tracker.cv);
+    /* Cleanup directory and sharer query tables */
+    pending_query_table_destroy(&ctx->network.dir_queries);
+    pending_query_table_destroy(&ctx->network.sharer_queries);
 
     /* Cleanup hot backup state */
     pthread_mutex_destroy(&ctx->network.backup_state.promotion_lock);
+    pthread_cond_destroy(&ctx->network.backup_state.manager_cv);
     if (ctx->network.backup_state.backup_directory) {
         /* Will be cast and freed properly in directory cleanup */
         extern void directory_destroy(void *dir);
         directory_destroy(ctx->network.backup_state.backup_directory);
         ctx->network.backup_state.backup_directory = NULL;
     }
+    for (int i = 0; i < ctx->network.backup_state.backup_locks_capacity; i++) {
+        free(ctx->network.backup_state.backup_locks[i]);
+    }
+    free(ctx->network.backup_state.backup_locks);
+    ctx->network.backup_state.backup_locks = NULL;
+    ctx->network.backup_state.backup_locks_capacity = 0;
+    for (int i = 0; i < ctx->network.backup_state.backup_barriers_capacity; i++) {
+        free(ctx->network.backup_state.backup_barriers[i]);
+    }
+    free(ctx->network.backup_state.backup_barriers);
+    ctx->network.backup_state.backup_barriers = NULL;
+    ctx->network.backup_state.backup_barriers_capacity = 0;
 
     if (ctx->network.server_sockfd >= 0) {
         close(ctx->network.server_sockfd);
@@ -191,22 +316,39 @@ void dsm_context_cleanup(void) {
 
     /* Cleanup locks */
     pthread_mutex_lock(&ctx->lock_mgr.lock);
-    for (int i = 0; i < ctx->lock_mgr.num_locks; i++) {
+    for (int i = 0; i < ctx->lock_mgr.capacity; i++) {
         if (ctx->lock_mgr.locks[i]) {
             free(ctx->lock_mgr.locks[i]);
         }
     }
+    free(ctx->lock_mgr.locks);
+    ctx->lock_mgr.locks = NULL;
+    ctx->lock_mgr.capacity = 0;
     pthread_mutex_unlock(&ctx->lock_mgr.lock);
     pthread_mutex_destroy(&ctx->lock_mgr.lock);
 
     /* Cleanup barriers */
-    if (ctx->barrier_mgr.barriers) {
-        free(ctx->barrier_mgr.barriers);
+    for (int i = 0; i < ctx->barrier_mgr.max_barriers; i++) {
+        if (ctx->barrier_mgr.barriers[i]) {
+            free(ctx->barrier_mgr.barriers[i]->notices);
+            free(ctx->barrier_mgr.barriers[i]->released);
+            free(ctx->barrier_mgr.barriers[i]->combined);
+            free(ctx->barrier_mgr.barriers[i]->result);
+            free(ctx->barrier_mgr.barriers[i]->heard[0]);
+            free(ctx->barrier_mgr.barriers[i]->heard[1]);
+        }
+        free(ctx->barrier_mgr.barriers[i]);
     }
+    free(ctx->barrier_mgr.barriers);
+    ctx->barrier_mgr.barriers = NULL;
+    ctx->barrier_mgr.max_barriers = 0;
+    ctx->barrier_mgr.first_free = 0;
+    memset(ctx->barrier_mgr.buckets, 0, sizeof(ctx->barrier_mgr.buckets));
     pthread_mutex_destroy(&ctx->barrier_mgr.lock);
 
     /* Cleanup all page tables */
-    for (int i = 0; i < ctx->num_allocations && i < 32; i++) {
+    page_index_cleanup();
+    for (int i = 0; i < ctx->num_allocations; i++) {
         if (ctx->page_tables[i]) {
             page_table_destroy(ctx->page_tables[i]);
             ctx->page_tables[i] = NULL;
@@ -214,11 +356,70 @@ void dsm_context_cleanup(void) {
     }
     ctx->page_table = NULL;
     ctx->num_allocations = 0;
+    free(ctx->page_tables);
+    ctx->page_tables = NULL;
+    ctx->page_tables_capacity = 0;
+    if (ctx->collective_window) {
+        munmap(ctx->collective_window, DSM_COLLECTIVE_WINDOW_BYTES);
+        ctx->collective_window = NULL;
+    }
+    while (ctx->retired_page_tables) {
+        retired_table_t *retired = ctx->retired_page_tables;
+        ctx->retired_page_tables = retired->next;
+        free(retired->table);
+        free(retired);
+    }
 
+    pthread_cond_destroy(&ctx->network.membership_cv);
     pthread_mutex_destroy(&ctx->lock);
-    pthread_mutex_destroy(&ctx->stats_lock);
     pthread_mutex_destroy(&ctx->allocation_lock);  /* BUG FIX: Destroy allocation_lock to prevent resource leak */
 
     ctx->initialized = false;
     LOG_INFO("DSM context cleanup complete");
 }
+
+int dsm_table_grow(void ***slots, int *capacity) {
+    int new_capacity = *capacity > 0 ? *capacity * 2 : DSM_TABLE_INITIAL_CAPACITY;
+
+    void **grown = realloc(*slots, (size_t)new_capacity * sizeof(void *));
+    if (!grown) {
+        LOG_ERROR("Failed to grow table to %d slots", new_capacity);
+        return DSM_ERROR_MEMORY;
+    }
+    memset(grown + *capacity, 0, (size_t)(new_capacity - *capacity) * sizeof(void *));
+
+    *slots = grown;
+    *capacity = new_capacity;
+    return DSM_SUCCESS;
+}
+
+int dsm_reserve_page_table_slot(void) {
+    dsm_context_t *ctx = &g_dsm_context;
+
+    if (ctx->num_allocations < ctx->page_tables_capacity) {
+        return DSM_SUCCESS;
+    }
+
+    /* Copy into a new array rather than realloc: a concurrent fault may
+     * still be scanning the old one, so it is only retired */
+    int new_capacity = ctx->page_tables_capacity * 2;
+    page_table_t **grown = calloc((size_t)new_capacity, sizeof(page_table_t *));
+    retired_table_t *retired = malloc(sizeof(retired_table_t));
+    if (!grown || !retired) {
+        LOG_ERROR("Failed to grow page table list to %d allocations", new_capacity);
+        free(grown);
+        free(retired);
+        return DSM_ERROR_MEMORY;
+    }
+    memcpy(grown, ctx->page_tables, (size_t)ctx->num_allocations * sizeof(page_table_t *));
+
+    retired->table = ctx->page_tables;
+    retired->next = ctx->retired_page_tables;
+    ctx->retired_page_tables = retired;
+
+    __atomic_store_n(&ctx->page_tables, grown, __ATOMIC_RELEASE);
+    ctx->page_tables_capacity = new_capacity;
+
+    LOG_DEBUG("Page table list grown to %d allocations", new_capacity);
+    return DSM_SUCCESS;
+}
@@ -9,11 +9,22 @@
 #include "dsm/types.h"
 #include "../memory/page_table.h"
 #include "../network/protocol.h"
+#include "../network/pending_query.h"
+#include "../network/transport.h"
 #include "../sync/lock.h"
 #include "../sync/barrier.h"
 #include <pthread.h>
 #include <stdbool.h>
 
+/** Initial capacity of the growable lock, barrier and allocation tables */
+#define DSM_TABLE_INITIAL_CAPACITY 256
+
+/** Address of the window dsm_malloc_collective() carves regions from (the same on every node) */
+#define DSM_COLLECTIVE_WINDOW_BASE ((uintptr_t)0x600000000000ULL)
+
+/** Size of the collective window: address space only, backed where pages are touched */
+#define DSM_COLLECTIVE_WINDOW_BYTES ((size_t)1 << 40)
+
 /**
  * Node information
  */
@@ -25,9 +36,30 @@ typedef struct {
     bool connected;
 
     /* Failure detection */
-    uint64_t last_heartbeat_time;  /**< Timestamp of last heartbeat (nanoseconds) */
+    uint64_t last_heartbeat_time;  /**< Monotonic time any frame from the node was last received (ns, atomic) */
+    uint64_t last_send_time;       /**< Monotonic time a frame to the node was last written (ns, atomic) */
     int missed_heartbeats;         /**< Consecutive missed heartbeats */
     bool is_failed;                /**< True if node is considered failed */
+
+    /* Outbound path */
+    pthread_mutex_t send_lock;     /**< Serializes writes on sockfd and lane_fds */
+    transport_conn_t *transport;   /**< Backend frames are written to instead of sockfd (under send_lock) */
+    int lane_fds[MAX_TCP_LANES - 1]; /**< Extra sockets for sharded frames (-1 = none) */
+    int num_lanes;                 /**< Lane sockets joined so far */
+    bool lanes_tx;                 /**< Sharded frames are written to lane_fds (under send_lock) */
+    bool lanes_rx;                 /**< Peer switched: lane_fds are read */
+    int lanes_wanted;              /**< Lanes the peer (or we) opened */
+    msg_queue_t *send_queue;       /**< Async outbound messages (drained by sender_thread) */
+    pthread_t sender_thread;       /**< Per-peer sender thread */
+    bool sender_started;           /**< True once sender_thread is running */
+
+    /* Direct link between workers, opened on first use (network_peer_link()) */
+    uint32_t peer_addr;            /**< IPv4 address it joined from (network byte order) */
+    uint16_t peer_port;            /**< Port it takes peer links on (0 = none, or unreachable) */
+    int peer_sockfd;               /**< Link we send on: opened by us, or adopted from the peer (-1 = none) */
+    int peer_rx_sockfd;            /**< A second link the peer opened meanwhile, only read (-1 = none) */
+    bool peer_failed;              /**< Link broke: traffic goes through the manager again */
+    pthread_mutex_t peer_lock;     /**< Serializes opening and adopting peer_sockfd */
 } node_info_t;
 
 /**
@@ -38,42 +70,45 @@ typedef struct {
     page_id_t end_page_id;         /**< End of allocation being tracked */
     int expected_acks;             /**< Number of ACKs expected */
     int received_acks;             /**< Number of ACKs received */
-    bool acks_received[MAX_NODES]; /**< Track which nodes have ACK'd */
+    bool *acks_received;           /**< Track which nodes have ACK'd (max_nodes entries) */
     pthread_mutex_t lock;          /**< Lock for this structure */
     pthread_cond_t all_acks_cv;    /**< Signaled when all ACKs received */
     bool active;                   /**< True if tracking an allocation */
 } alloc_ack_tracker_t;
 
-/**
- * Directory Query Tracker
- */
-typedef struct {
-    page_id_t page_id;           /**< Page being queried */
-    node_id_t owner;             /**< Owner returned */
-    bool active;                 /**< Is query active? */
-    bool complete;               /**< Is query complete? */
-    pthread_mutex_t lock;        /**< Lock */
-    pthread_cond_t cv;           /**< Wait variable */
-} dir_query_tracker_t;
-
 /**
  * Network state
  */
 typedef struct {
     int server_sockfd;
     uint16_t server_port;
-    node_info_t nodes[MAX_NODES];
-    int num_nodes;
+    int peer_server_sockfd;        /**< Workers: listens for peer links (-1 = none) */
+    uint16_t peer_server_port;     /**< Port of peer_server_sockfd, sent with NODE_JOIN */
+    pthread_t peer_accept_thread;  /**< Accepts on peer_server_sockfd */
+    node_info_t *nodes;            /**< Indexed by node ID (max_nodes entries) */
+    int max_nodes;                 /**< Node table capacity (node IDs are < max_nodes) */
+    int num_nodes;                 /**< Workers joined (manager) */
+    int roster_size;               /**< Members listed in the manager's NODE_ROSTER, 0 before it (workers) */
+    pthread_cond_t membership_cv;  /**< Broadcast with ctx->lock on NODE_JOIN and NODE_ROSTER */
     pthread_t dispatcher_thread;
     pthread_t heartbeat_thread;    /**< Heartbeat sender/checker thread */
-    msg_queue_t *send_queue;
     bool running;
+    bool senders_running;          /**< Cleared to stop per-peer sender threads */
+    int epoll_fd;                  /**< Dispatcher event loop (edge-triggered) */
+    int wake_fd;                   /**< eventfd to wake the dispatcher */
 
     /* Pending connections (not yet identified with NODE_JOIN) */
-    int pending_sockets[MAX_NODES];
+    int *pending_sockets;          /**< max_pending entries */
     int num_pending;
+    int max_pending;               /**< max_nodes * (MAX_TCP_LANES + 1) */
+    int blocked_lanes;             /**< Lane sockets not read until their peer switches (under lock) */
     pthread_mutex_t pending_lock;
 
+    /* Frames read off each socket but not dispatched yet, indexed by sockfd */
+    struct socket_rx_s **rx_sockets; /**< rx_capacity entries (NULL = never read) */
+    int rx_capacity;
+    pthread_mutex_t rx_lock;       /**< Guards rx_sockets; taken with pending_lock held, never the reverse */
+
     /* Sequence number for messages (for debugging and message tracking) */
     uint64_t next_seq_num;
     pthread_mutex_t seq_lock;
@@ -81,19 +116,11 @@ typedef struct {
     /* Allocation ACK tracking */
     alloc_ack_tracker_t alloc_tracker;
 
-    /* Directory Query tracking */
-    dir_query_tracker_t dir_tracker;
+    /* Outstanding DIR_QUERY round trips, keyed by (page_id, request_id) */
+    pending_query_table_t dir_queries;
 
-    /* Sharer query tracker (for complete invalidation - BUG #8 fix) */
-    struct {
-        pthread_mutex_t lock;
-        pthread_cond_t cv;
-        page_id_t page_id;
-        node_id_t sharers[32];  /* Use fixed size to avoid circular dependency */
-        int num_sharers;
-        bool active;
-        bool complete;
-    } sharer_tracker;
+    /* Outstanding SHARER_QUERY round trips (for complete invalidation - BUG #8 fix) */
+    pending_query_table_t sharer_queries;
 
     /* Hot backup state (for failover support) */
     struct {
@@ -103,9 +130,12 @@ typedef struct {
         node_id_t current_manager;             /**< Track active manager */
         uint64_t last_sync_seq;                /**< Replication sequence */
         void *backup_directory;                /**< Shadow directory (page_directory_t*) */
-        void *backup_locks[256];               /**< Shadow locks (dsm_lock_t*) */
-        void *backup_barriers[256];            /**< Shadow barriers (dsm_barrier_t*) */
+        void **backup_locks;                   /**< Shadow locks (dsm_lock_t*), growable */
+        int backup_locks_capacity;             /**< Slots in backup_locks */
+        void **backup_barriers;                /**< Shadow barriers (dsm_barrier_t*), growable */
+        int backup_barriers_capacity;          /**< Slots in backup_barriers */
         pthread_mutex_t promotion_lock;        /**< Prevent split-brain */
+        pthread_cond_t manager_cv;             /**< Broadcast (under ctx->lock) when current_manager changes or node 0 recovers */
         int backup_server_sockfd;              /**< Backup server socket (separate from worker socket) */
         uint16_t backup_server_port;           /**< Port for backup server */
     } backup_state;
@@ -115,7 +145,8 @@ typedef struct {
  * Lock manager state
  */
 typedef struct {
-    struct dsm_lock_s *locks[256];
+    struct dsm_lock_s **locks;     /**< Growable slot array (NULL = free) */
+    int capacity;                  /**< Slots in locks */
     int num_locks;
     pthread_mutex_t lock;
 } lock_manager_t;
@@ -130,10 +161,15 @@ typedef struct {
 
     /* Memory management */
     page_table_t *page_table;  /* Primary page table (for backward compatibility) */
-    page_table_t *page_tables[32];  /* Support up to 32 separate allocations */
+    page_table_t **page_tables;  /* Growable; readers may scan it without ctx->lock */
+    int page_tables_capacity;  /* Slots in page_tables */
+    void *retired_page_tables;  /* Superseded page_tables arrays, freed at cleanup */
     int num_allocations;  /* Total allocations (local + remote) */
     int num_local_allocations;  /* CRITICAL: Track only LOCAL allocations for allocation_index calculation */
     pthread_mutex_t allocation_lock;  /* BUG FIX (BUG 3): Serialize allocations to prevent tracker corruption */
+    void *collective_window;  /* Shared address window of dsm_malloc_collective(), reserved on first use */
+    size_t collective_used;  /* Window bytes handed out: the same on every node */
+    int num_collective_allocations;  /* Collective calls so far: the same on every node */
 
     /* Network */
     network_state_t network;
@@ -142,9 +178,7 @@ typedef struct {
     lock_manager_t lock_mgr;
     barrier_manager_t barrier_mgr;
 
-    /* Statistics */
-    dsm_stats_t stats;
-    pthread_mutex_t stats_lock;
+    /* Statistics live in per-thread counter blocks (see stats.h) */
 
     /* Global lock for context operations */
     pthread_mutex_t lock;
@@ -165,4 +199,35 @@ int dsm_context_init(const dsm_config_t *config);
  */
 void dsm_context_cleanup(void);
 
+/**
+ * Double the capacity of a table of object pointers
+ *
+ * New slots are NULL. The caller must hold the lock that protects the table.
+ *
+ * @param slots Table to grow (may be NULL when *capacity is 0)
+ * @param capacity In/out: number of slots
+ * @return DSM_SUCCESS on success, DSM_ERROR_MEMORY on failure
+ */
+int dsm_table_grow(void ***slots, int *capacity);
+
+/**
+ * Make room for one more entry in ctx->page_tables
+ *
+ * Must be called with ctx->lock held. The fault handler scans page_tables
+ * without the lock, so a superseded array is retired (freed at cleanup)
+ * rather than freed immediately.
+ *
+ * @return DSM_SUCCESS on success, DSM_ERROR_MEMORY on failure
+ */
+int dsm_reserve_page_table_slot(void);
+
+/**
+ * Reserve the collective window at its fixed address, once
+ * Every node must get the same address, so a window that cannot be placed
+ * there is an error rather than moved. Caller holds ctx->allocation_lock.
+ *
+ * @return DSM_SUCCESS, or DSM_ERROR_MEMORY if the address range is taken
+ */
+int dsm_reserve_collective_window(void);
+
 #endif /* DSM_CONTEXT_H */
@@ -12,6 +12,10 @@
 #include <unistd.h>
 #include <sys/syscall.h>
 #include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sched.h>
 
 /* ============================ */
 /*     Global State             */
@@ -23,6 +27,56 @@ log_level_t g_log_level = LOG_LEVEL_INFO;
 /** Mutex for thread-safe logging */
 static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/**
+ * One captured log call
+ *
+ * Integer arguments are stored widened to 64 bits after the conversion's
+ * own cast, doubles by value, strings as an offset into strings[]. With
+ * fmt NULL, strings[] holds the message already formatted.
+ */
+typedef struct {
+    uint64_t time_ns;
+    long tid;
+    const char *file;
+    const char *fmt;
+    int line;
+    uint8_t level;
+    uint8_t num_args;
+    uint64_t args[LOG_ASYNC_MAX_ARGS];
+    char strings[LOG_ASYNC_STRING_BYTES];
+} log_record_t;
+
+/** Single-producer ring of one thread's records */
+typedef struct log_ring_s {
+    uint64_t head;                     /**< Next record to write (owner thread) */
+    uint64_t tail;                     /**< Next record to format (writer thread) */
+    int busy;                          /**< Owner is between the async check and publishing */
+    int in_use;                        /**< Claimed by a live thread */
+    struct log_ring_s *next;           /**< Registry link (push-only) */
+    log_record_t records[LOG_RING_RECORDS];
+} log_ring_t;
+
+static struct {
+    log_ring_t *rings;                 /**< All rings ever created */
+    pthread_mutex_t lock;              /**< Serializes start/stop and wakeups */
+    pthread_cond_t wake;
+    pthread_t thread;
+    bool running;                      /**< Writer thread exists */
+    int async;                         /**< Callers enqueue instead of writing */
+    pthread_key_t ring_key;            /**< Releases a ring when its thread exits */
+    pthread_once_t key_once;
+} g_async = {
+    .rings = NULL,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .running = false,
+    .async = 0,
+    .key_once = PTHREAD_ONCE_INIT
+};
+
+static __thread log_ring_t *tls_ring = NULL;
+static __thread long tls_tid = 0;
+
 /** ANSI color codes for terminal output */
 #define COLOR_RESET   "\033[0m"
 #define COLOR_RED     "\033[31m"
@@ -36,25 +90,32 @@ static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
 /* ============================ */
 
 /**
- * Get current thread ID (Linux-specific)
+ * Get current thread ID (Linux-specific, cached per thread)
  */
 static long get_thread_id(void) {
-    return (long)syscall(SYS_gettid);
+    if (tls_tid == 0) {
+        tls_tid = (long)syscall(SYS_gettid);
+    }
+    return tls_tid;
 }
 
-/**
- * Get current timestamp string
- */
-static void get_timestamp(char *buffer, size_t size) {
+static uint64_t now_ns(void) {
     struct timespec ts;
     clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
 
+/**
+ * Format a CLOCK_REALTIME time as the line timestamp
+ */
+static void get_timestamp(uint64_t time_ns, char *buffer, size_t size) {
+    time_t sec = (time_t)(time_ns / 1000000000ULL);
     struct tm tm_info;
-    localtime_r(&ts.tv_sec, &tm_info);
+    localtime_r(&sec, &tm_info);
 
     snprintf(buffer, size, "%02d:%02d:%02d.%03ld",
              tm_info.tm_hour, tm_info.tm_min, tm_info.tm_sec,
-             ts.tv_nsec / 1000000);
+             (long)(time_ns % 1000000000ULL) / 1000000);
 }
 
 /**
@@ -80,6 +141,475 @@ static const char* get_level_color(log_level_t level) {
     }
 }
 
+/**
+ * Write one line's prefix, as "[time] [LEVEL] [tid] file:line - "
+ * Caller holds log_mutex.
+ */
+static void write_prefix(log_level_t level, uint64_t time_ns, long tid,
+                         const char *file, int line) {
+    char timestamp[32];
+    get_timestamp(time_ns, timestamp, sizeof(timestamp));
+
+    /* Extract just the filename (not full path) */
+    const char *filename = strrchr(file, '/');
+    filename = filename ? filename + 1 : file;
+
+    /* Check if output is to a terminal (for colors) */
+    int use_color = isatty(fileno(stderr));
+
+    if (use_color) {
+        fprintf(stderr, "%s[%s]%s %s[%s]%s [%s%ld%s] %s%s:%d%s - ",
+                COLOR_GRAY, timestamp, COLOR_RESET,
+                get_level_color(level), get_level_string(level), COLOR_RESET,
+                COLOR_GRAY, tid, COLOR_RESET,
+                COLOR_GRAY, filename, line, COLOR_RESET);
+    } else {
+        fprintf(stderr, "[%s] [%s] [%ld] %s:%d - ",
+                timestamp, get_level_string(level), tid, filename, line);
+    }
+}
+
+/* ============================ */
+/*     Argument Capture         */
+/* ============================ */
+
+typedef enum {
+    ARG_SIGNED,
+    ARG_UNSIGNED,
+    ARG_DOUBLE,
+    ARG_STRING,
+    ARG_POINTER,
+    ARG_CHAR
+} arg_kind_t;
+
+/** One printf conversion, as far as capturing and replaying it needs */
+typedef struct {
+    const char *start;                 /**< The '%' */
+    size_t flags_len;                  /**< Flags, width and precision after '%' */
+    int stars;                         /**< '*' widths/precisions (int arguments before the value) */
+    int length;                        /**< 0, 'H' (hh), 'h', 'l', 'q' (ll), 'z', 'j', 't' */
+    char conv;                         /**< Conversion character */
+    arg_kind_t kind;
+} log_spec_t;
+
+/**
+ * Parse the conversion at p (just past a '%')
+ *
+ * @return Pointer past the conversion, or NULL if it cannot be captured
+ *         (long double, %n, or an unknown conversion)
+ */
+static const char *parse_spec(const char *p, log_spec_t *spec) {
+    spec->start = p - 1;
+    spec->stars = 0;
+    spec->length = 0;
+
+    while (*p && strchr("-+ #0'", *p)) {
+        p++;
+    }
+    if (*p == '*') {
+        spec->stars++;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->stars++;
+            p++;
+        } else {
+            while (*p >= '0' && *p <= '9') {
+                p++;
+            }
+        }
+    }
+    spec->flags_len = (size_t)(p - spec->start) - 1;
+
+    switch (*p) {
+        case 'h': spec->length = (p[1] == 'h') ? 'H' : 'h'; p += (p[1] == 'h') ? 2 : 1; break;
+        case 'l': spec->length = (p[1] == 'l') ? 'q' : 'l'; p += (p[1] == 'l') ? 2 : 1; break;
+        case 'z': case 'j': case 't': spec->length = *p++; break;
+        case 'L': return NULL;
+        default: break;
+    }
+
+    spec->conv = *p;
+    switch (*p) {
+        case 'd': case 'i': spec->kind = ARG_SIGNED; break;
+        case 'u': case 'o': case 'x': case 'X': spec->kind = ARG_UNSIGNED; break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            spec->kind = ARG_DOUBLE;
+            break;
+        case 's': spec->kind = ARG_STRING; break;
+        case 'p': spec->kind = ARG_POINTER; break;
+        case 'c': spec->kind = ARG_CHAR; break;
+        default: return NULL;
+    }
+    if (spec->length != 0 && spec->kind != ARG_SIGNED && spec->kind != ARG_UNSIGNED) {
+        return NULL;
+    }
+    return p + 1;
+}
+
+static int64_t read_signed(int length, va_list *ap) {
+    switch (length) {
+        case 'H': return (signed char)va_arg(*ap, int);
+        case 'h': return (short)va_arg(*ap, int);
+        case 'l': return va_arg(*ap, long);
+        case 'q': return va_arg(*ap, long long);
+        case 'z': return (int64_t)va_arg(*ap, ssize_t);
+        case 'j': return va_arg(*ap, intmax_t);
+        case 't': return va_arg(*ap, ptrdiff_t);
+        default:  return va_arg(*ap, int);
+    }
+}
+
+static uint64_t read_unsigned(int length, va_list *ap) {
+    switch (length) {
+        case 'H': return (unsigned char)va_arg(*ap, unsigned int);
+        case 'h': return (unsigned short)va_arg(*ap, unsigned int);
+        case 'l': return va_arg(*ap, unsigned long);
+        case 'q': return va_arg(*ap, unsigned long long);
+        case 'z': return va_arg(*ap, size_t);
+        case 'j': return va_arg(*ap, uintmax_t);
+        case 't': return (uint64_t)va_arg(*ap, ptrdiff_t);
+        default:  return va_arg(*ap, unsigned int);
+    }
+}
+
+/**
+ * Store a call's arguments in rec by walking its format
+ *
+ * @return false if the call must be formatted by the caller instead
+ */
+static bool capture_args(log_record_t *rec, const char *fmt, va_list *ap) {
+    size_t used = 0;
+    int n = 0;
+
+    for (const char *p = fmt; *p; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        if (p[1] == '%') {
+            p++;
+            continue;
+        }
+
+        log_spec_t spec;
+        const char *end = parse_spec(p + 1, &spec);
+        if (!end || n + spec.stars + 1 > LOG_ASYNC_MAX_ARGS) {
+            return false;
+        }
+        for (int i = 0; i < spec.stars; i++) {
+            rec->args[n++] = (uint64_t)(int64_t)va_arg(*ap, int);
+        }
+
+        switch (spec.kind) {
+            case ARG_SIGNED:   rec->args[n++] = (uint64_t)read_signed(spec.length, ap); break;
+            case ARG_UNSIGNED: rec->args[n++] = read_unsigned(spec.length, ap); break;
+            case ARG_CHAR:     rec->args[n++] = (uint64_t)(int64_t)va_arg(*ap, int); break;
+            case ARG_POINTER:  rec->args[n++] = (uint64_t)(uintptr_t)va_arg(*ap, void *); break;
+            case ARG_DOUBLE: {
+                double d = va_arg(*ap, double);
+                memcpy(&rec->args[n++], &d, sizeof(d));
+                break;
+            }
+            case ARG_STRING: {
+                const char *str = va_arg(*ap, const char *);
+                if (!str) {
+                    str = "(null)";
+                }
+                size_t len = strlen(str) + 1;
+                if (used + len > sizeof(rec->strings)) {
+                    return false;
+                }
+                memcpy(rec->strings + used, str, len);
+                rec->args[n++] = used;
+                used += len;
+                break;
+            }
+        }
+        p = end - 1;
+    }
+
+    rec->num_args = (uint8_t)n;
+    return true;
+}
+
+/**
+ * Format one captured conversion
+ */
+static int format_spec(char *out, size_t size, const log_spec_t *spec,
+                       const log_record_t *rec, const uint64_t *args) {
+    /* Integers were widened at capture, so replay with an ll modifier */
+    char conv[32];
+    size_t len = spec->flags_len + 1;
+    if (len + 4 > sizeof(conv)) {
+        return 0;
+    }
+    memcpy(conv, spec->start, len);
+    if (spec->kind == ARG_SIGNED || spec->kind == ARG_UNSIGNED) {
+        conv[len++] = 'l';
+        conv[len++] = 'l';
+    }
+    conv[len++] = spec->conv;
+    conv[len] = '\0';
+
+    int w = spec->stars > 0 ? (int)args[0] : 0;
+    int pr = spec->stars > 1 ? (int)args[1] : 0;
+    uint64_t v = args[spec->stars];
+
+#define FORMAT_VALUE(value) \
+    (spec->stars == 0 ? snprintf(out, size, conv, value) : \
+     spec->stars == 1 ? snprintf(out, size, conv, w, value) : \
+                        snprintf(out, size, conv, w, pr, value))
+
+    switch (spec->kind) {
+        case ARG_SIGNED:   return FORMAT_VALUE((long long)(int64_t)v);
+        case ARG_UNSIGNED: return FORMAT_VALUE((unsigned long long)v);
+        case ARG_CHAR:     return FORMAT_VALUE((int)(int64_t)v);
+        case ARG_POINTER:  return FORMAT_VALUE((void *)(uintptr_t)v);
+        case ARG_STRING:   return FORMAT_VALUE(rec->strings + v);
+        case ARG_DOUBLE: {
+            double d;
+            memcpy(&d, &v, sizeof(d));
+            return FORMAT_VALUE(d);
+        }
+    }
+#undef FORMAT_VALUE
+    return 0;
+}
+
+/**
+ * Rebuild a captured call's message
+ *
+ * @return Length of the whole message, as snprintf(); out holds it only
+ *         if this is below size
+ */
+static size_t format_record(const log_record_t *rec, char *out, size_t size) {
+    if (!rec->fmt) {
+        return (size_t)snprintf(out, size, "%s", rec->strings);
+    }
+
+    size_t pos = 0;
+    int n = 0;
+    for (const char *p = rec->fmt; *p; p++) {
+        if (*p != '%' || p[1] == '%') {
+            char c = *p;
+            if (c == '%') {
+                p++;
+            }
+            if (pos + 1 < size) {
+                out[pos] = c;
+            }
+            pos++;
+            continue;
+        }
+
+        log_spec_t spec;
+        const char *end = parse_spec(p + 1, &spec);
+        if (!end) {
+            break;
+        }
+        int len = format_spec(pos < size ? out + pos : NULL, pos < size ? size - pos : 0,
+                              &spec, rec, &rec->args[n]);
+        if (len > 0) {
+            pos += (size_t)len;
+        }
+        n += spec.stars + 1;
+        p = end - 1;
+    }
+    out[pos < size ? pos : size - 1] = '\0';
+    return pos;
+}
+
+/* ============================ */
+/*     Async Writer             */
+/* ============================ */
+
+static void ring_release(void *arg) {
+    log_ring_t *ring = (log_ring_t *)arg;
+    __atomic_store_n(&ring->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void create_ring_key(void) {
+    pthread_key_create(&g_async.ring_key, ring_release);
+}
+
+static log_ring_t *ring_claim(void) {
+    /* Reuse a ring left behind by an exited thread */
+    log_ring_t *ring = __atomic_load_n(&g_async.rings, __ATOMIC_ACQUIRE);
+    for (; ring; ring = ring->next) {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&ring->in_use, &expected, 1, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    if (!ring) {
+        ring = calloc(1, sizeof(log_ring_t));
+        if (!ring) {
+            return NULL;
+        }
+        ring->in_use = 1;
+
+        log_ring_t *head = __atomic_load_n(&g_async.rings, __ATOMIC_RELAXED);
+        do {
+            ring->next = head;
+        } while (!__atomic_compare_exchange_n(&g_async.rings, &head, ring, true,
+                                              __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+
+    pthread_setspecific(g_async.ring_key, ring);
+    tls_ring = ring;
+    return ring;
+}
+
+static void wake_writer(void) {
+    pthread_mutex_lock(&g_async.lock);
+    pthread_cond_signal(&g_async.wake);
+    pthread_mutex_unlock(&g_async.lock);
+}
+
+/**
+ * Write every queued record, oldest first across rings
+ */
+static void drain_rings(void) {
+    char text[1024];
+
+    pthread_mutex_lock(&log_mutex);
+    for (;;) {
+        log_ring_t *oldest = NULL;
+        const log_record_t *rec = NULL;
+        for (log_ring_t *ring = __atomic_load_n(&g_async.rings, __ATOMIC_ACQUIRE);
+             ring; ring = ring->next) {
+            uint64_t tail = ring->tail;
+            if (tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) {
+                continue;
+            }
+            const log_record_t *r = &ring->records[tail % LOG_RING_RECORDS];
+            if (!rec || r->time_ns < rec->time_ns) {
+                oldest = ring;
+                rec = r;
+            }
+        }
+        if (!oldest) {
+            break;
+        }
+
+        /* A line longer than text is formatted again at its full length */
+        size_t len = format_record(rec, text, sizeof(text));
+        char *line = len < sizeof(text) ? text : malloc(len + 1);
+        if (line != text && line) {
+            format_record(rec, line, len + 1);
+        }
+        write_prefix((log_level_t)rec->level, rec->time_ns, rec->tid, rec->file, rec->line);
+        fputs(line ? line : text, stderr);
+        fputc('\n', stderr);
+        if (line != text) {
+            free(line);
+        }
+        __atomic_store_n(&oldest->tail, oldest->tail + 1, __ATOMIC_RELEASE);
+    }
+    fflush(stderr);
+    pthread_mutex_unlock(&log_mutex);
+}
+
+static void* writer_thread(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&g_async.lock);
+    while (g_async.running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += (long)LOG_ASYNC_POLL_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&g_async.wake, &g_async.lock, &deadline);
+
+        pthread_mutex_unlock(&g_async.lock);
+        drain_rings();
+        pthread_mutex_lock(&g_async.lock);
+    }
+    pthread_mutex_unlock(&g_async.lock);
+
+    drain_rings();
+    return NULL;
+}
+
+/**
+ * Queue a call on the calling thread's ring
+ *
+ * A call whose arguments cannot be captured is queued formatted, if the
+ * message fits in strings[].
+ *
+ * @param too_long Set when the call was not queued because its message
+ *        does not fit a record
+ * @return false if logging is synchronous (or no ring is available, or
+ *         the message is too long) and the caller must write the line itself
+ */
+static bool log_enqueue(log_level_t level, const char *file, int line,
+                        const char *fmt, va_list ap, bool *too_long) {
+    log_ring_t *ring = tls_ring ? tls_ring : ring_claim();
+    if (!ring) {
+        return false;
+    }
+
+    /* Paired with log_stop_async(): it waits for busy rings after
+     * clearing async, so no record is published after the final drain */
+    __atomic_store_n(&ring->busy, 1, __ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&g_async.async, __ATOMIC_SEQ_CST)) {
+        __atomic_store_n(&ring->busy, 0, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    uint64_t head = ring->head;
+    while (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= LOG_RING_RECORDS) {
+        wake_writer();
+        struct timespec pause = { .tv_sec = 0, .tv_nsec = 100000 };
+        nanosleep(&pause, NULL);
+    }
+
+    log_record_t *rec = &ring->records[head % LOG_RING_RECORDS];
+    rec->time_ns = now_ns();
+    rec->tid = get_thread_id();
+    rec->file = file;
+    rec->line = line;
+    rec->level = (uint8_t)level;
+    rec->fmt = fmt;
+
+    va_list copy;
+    va_copy(copy, ap);
+    bool captured = capture_args(rec, fmt, &copy);
+    va_end(copy);
+    if (!captured) {
+        rec->fmt = NULL;
+        rec->num_args = 0;
+        va_copy(copy, ap);
+        int len = vsnprintf(rec->strings, sizeof(rec->strings), fmt, copy);
+        va_end(copy);
+        if (len < 0 || (size_t)len >= sizeof(rec->strings)) {
+            __atomic_store_n(&ring->busy, 0, __ATOMIC_RELEASE);
+            *too_long = true;
+            return false;
+        }
+    }
+
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->busy, 0, __ATOMIC_RELEASE);
+
+    if (level <= LOG_LEVEL_ERROR ||
+        head + 1 - __atomic_load_n(&ring->tail, __ATOMIC_RELAXED) >= LOG_RING_RECORDS / 2) {
+        wake_writer();
+    }
+    return true;
+}
+
 /* ============================ */
 /*     Public Functions         */
 /* ============================ */
@@ -102,46 +632,80 @@ log_level_t log_get_level(void) {
     return level;
 }
 
+int log_start_async(void) {
+    pthread_once(&g_async.key_once, create_ring_key);
+
+    pthread_mutex_lock(&g_async.lock);
+    if (g_async.running) {
+        pthread_mutex_unlock(&g_async.lock);
+        return 0;
+    }
+    g_async.running = true;
+    if (pthread_create(&g_async.thread, NULL, writer_thread, NULL) != 0) {
+        g_async.running = false;
+        pthread_mutex_unlock(&g_async.lock);
+        return -1;
+    }
+    __atomic_store_n(&g_async.async, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&g_async.lock);
+    return 0;
+}
+
+void log_stop_async(void) {
+    pthread_mutex_lock(&g_async.lock);
+    if (!g_async.running) {
+        pthread_mutex_unlock(&g_async.lock);
+        return;
+    }
+    __atomic_store_n(&g_async.async, 0, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&g_async.lock);
+
+    /* Let callers already past the check publish, then drain for the last time */
+    for (log_ring_t *ring = __atomic_load_n(&g_async.rings, __ATOMIC_ACQUIRE);
+         ring; ring = ring->next) {
+        while (__atomic_load_n(&ring->busy, __ATOMIC_SEQ_CST)) {
+            sched_yield();
+        }
+    }
+
+    pthread_mutex_lock(&g_async.lock);
+    g_async.running = false;
+    pthread_cond_signal(&g_async.wake);
+    pthread_mutex_unlock(&g_async.lock);
+    pthread_join(g_async.thread, NULL);
+}
+
 void log_message(log_level_t level, const char *file, int line,
                  const char *func, const char *fmt, ...) {
+    (void)func;
 
     /* Check if we should log this level */
     if (level > g_log_level) {
         return;
     }
 
-    /* Lock for thread safety */
-    pthread_mutex_lock(&log_mutex);
-
-    /* Get timestamp */
-    char timestamp[32];
-    get_timestamp(timestamp, sizeof(timestamp));
+    va_list args;
+    va_start(args, fmt);
 
-    /* Get thread ID */
-    long tid = get_thread_id();
+    bool too_long = false;
+    if (__atomic_load_n(&g_async.async, __ATOMIC_RELAXED) &&
+        log_enqueue(level, file, line, fmt, args, &too_long)) {
+        va_end(args);
+        return;
+    }
 
-    /* Extract just the filename (not full path) */
-    const char *filename = strrchr(file, '/');
-    filename = filename ? filename + 1 : file;
+    /* Written here in full, after the lines queued before it */
+    if (too_long) {
+        drain_rings();
+    }
 
-    /* Check if output is to a terminal (for colors) */
-    int use_color = isatty(fileno(stderr));
+    /* Lock for thread safety */
+    pthread_mutex_lock(&log_mutex);
 
     /* Print log prefix */
-    if (use_color) {
-        fprintf(stderr, "%s[%s]%s %s[%s]%s [%s%ld%s] %s%s:%d%s - ",
-                COLOR_GRAY, timestamp, COLOR_RESET,
-                get_level_color(level), get_level_string(level), COLOR_RESET,
-                COLOR_GRAY, tid, COLOR_RESET,
-                COLOR_GRAY, filename, line, COLOR_RESET);
-    } else {
-        fprintf(stderr, "[%s] [%s] [%ld] %s:%d - ",
-                timestamp, get_level_string(level), tid, filename, line);
-    }
+    write_prefix(level, now_ns(), get_thread_id(), file, line);
 
     /* Print the actual message */
-    va_list args;
-    va_start(args, fmt);
     vfprintf(stderr, fmt, args);
     va_end(args);
 
@@ -3,6 +3,15 @@
  * @brief Thread-safe logging infrastructure for DSM
  *
  * Provides leveled logging with timestamps and thread information.
+ *
+ * Two knobs keep logging off the fault path:
+ *
+ * - DSM_LOG_COMPILE_LEVEL (make LOG_LEVEL=n) is the most verbose level
+ *   compiled in. Calls above it are removed by the compiler, arguments and
+ *   all, whatever the runtime level.
+ * - log_start_async() moves formatting and writing to a background thread.
+ *   A call then only copies its format pointer and arguments into the
+ *   calling thread's ring; the writer merges the rings by timestamp.
  */
 
 #ifndef LOG_H
@@ -22,6 +31,30 @@ typedef enum {
     LOG_LEVEL_DEBUG        /**< Debug messages (verbose) */
 } log_level_t;
 
+/**
+ * Most verbose level compiled in (LOG_LEVEL_* value)
+ * Default keeps every level; 2 compiles out INFO and DEBUG.
+ */
+#ifndef DSM_LOG_COMPILE_LEVEL
+#define DSM_LOG_COMPILE_LEVEL 4
+#endif
+
+/** Records one thread's async ring holds */
+#define LOG_RING_RECORDS 256
+
+/** Arguments an async record captures; calls with more are formatted by the caller */
+#define LOG_ASYNC_MAX_ARGS 12
+
+/**
+ * Bytes of string arguments an async record copies
+ * A call whose message still does not fit is written in full by the
+ * caller, after the lines queued before it.
+ */
+#define LOG_ASYNC_STRING_BYTES 192
+
+/** Background thread wakeup interval while idle */
+#define LOG_ASYNC_POLL_MS 50
+
 /* ============================ */
 /*     Global Log Level         */
 /* ============================ */
@@ -53,6 +86,22 @@ void log_set_level(log_level_t level);
  */
 log_level_t log_get_level(void);
 
+/**
+ * Format log lines on a background thread from now on
+ *
+ * ERROR lines wake the writer at once; the rest are written within
+ * LOG_ASYNC_POLL_MS. A thread whose ring is full waits for the writer
+ * rather than drop lines.
+ *
+ * @return 0 (also when already started), or -1 if the thread cannot be created
+ */
+int log_start_async(void);
+
+/**
+ * Write every queued line and go back to synchronous logging
+ */
+void log_stop_async(void);
+
 /**
  * Internal logging function (don't call directly, use macros)
  *
@@ -76,7 +125,7 @@ void log_message(log_level_t level, const char *file, int line,
  */
 #define LOG_ERROR(fmt, ...) \
     do { \
-        if (g_log_level >= LOG_LEVEL_ERROR) { \
+        if (DSM_LOG_COMPILE_LEVEL >= LOG_LEVEL_ERROR && g_log_level >= LOG_LEVEL_ERROR) { \
             log_message(LOG_LEVEL_ERROR, __FILE__, __LINE__, __func__, \
                        fmt, ##__VA_ARGS__); \
         } \
@@ -88,7 +137,7 @@ void log_message(log_level_t level, const char *file, int line,
  */
 #define LOG_WARN(fmt, ...) \
     do { \
-        if (g_log_level >= LOG_LEVEL_WARN) { \
+        if (DSM_LOG_COMPILE_LEVEL >= LOG_LEVEL_WARN && g_log_level >= LOG_LEVEL_WARN) { \
             log_message(LOG_LEVEL_WARN, __FILE__, __LINE__, __func__, \
                        fmt, ##__VA_ARGS__); \
         } \
@@ -100,7 +149,7 @@ void log_message(log_level_t level, const char *file, int line,
  */
 #define LOG_INFO(fmt, ...) \
     do { \
-        if (g_log_level >= LOG_LEVEL_INFO) { \
+        if (DSM_LOG_COMPILE_LEVEL >= LOG_LEVEL_INFO && g_log_level >= LOG_LEVEL_INFO) { \
             log_message(LOG_LEVEL_INFO, __FILE__, __LINE__, __func__, \
                        fmt, ##__VA_ARGS__); \
         } \
@@ -112,7 +161,7 @@ void log_message(log_level_t level, const char *file, int line,
  */
 #define LOG_DEBUG(fmt, ...) \
     do { \
-        if (g_log_level >= LOG_LEVEL_DEBUG) { \
+        if (DSM_LOG_COMPILE_LEVEL >= LOG_LEVEL_DEBUG && g_log_level >= LOG_LEVEL_DEBUG) { \
             log_message(LOG_LEVEL_DEBUG, __FILE__, __LINE__, __func__, \
                        fmt, ##__VA_ARGS__); \
         } \
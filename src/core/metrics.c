@@ -0,0 +1,657 @@
+/**
+ * @file metrics.c
+ * @brief Live metrics publisher and Prometheus endpoint implementation
+ */
+
+#include "metrics.h"
+#include "dsm_context.h"
+#include "log.h"
+#include "stats.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/** How often the endpoint thread checks for shutdown while idle */
+#define METRICS_POLL_MS 200
+
+/** Bytes of an HTTP request read before answering */
+#define METRICS_REQUEST_BYTES 1024
+
+/** Connections served at once; more wait in the listen backlog */
+#define METRICS_MAX_CLIENTS 8
+
+/** A connection not answered and written out by then is closed */
+#define METRICS_CLIENT_TIMEOUT_MS 1000
+
+/** Address the endpoint listens on when dsm_config_t.metrics_bind is NULL */
+#define METRICS_DEFAULT_BIND "127.0.0.1"
+
+/**
+ * One connection to the endpoint: its request is read, then its
+ * response written, both without blocking
+ */
+typedef struct {
+    int fd;                    /**< -1 = slot free */
+    char request[METRICS_REQUEST_BYTES];
+    size_t got;                /**< Request bytes read */
+    char *response;            /**< Response being written (NULL while reading) */
+    size_t response_len;
+    size_t sent;               /**< Response bytes written */
+    uint64_t deadline_ns;      /**< Closed at this CLOCK_MONOTONIC time */
+} metrics_client_t;
+
+/** Name, help text and kind of one dsm_stats_t field */
+typedef struct {
+    const char *name;
+    const char *help;
+    size_t index;              /**< STATS_INDEX() of the field */
+    bool gauge;                /**< Not a running total */
+} metric_field_t;
+
+#define COUNTER(field, help) { #field, help, STATS_INDEX(field), false }
+#define GAUGE(field, help)   { #field, help, STATS_INDEX(field), true }
+
+static const metric_field_t g_fields[] = {
+    COUNTER(page_faults, "Page faults"),
+    COUNTER(read_faults, "Read faults"),
+    COUNTER(write_faults, "Write faults"),
+    COUNTER(pages_fetched, "Pages fetched from other nodes"),
+    COUNTER(pages_sent, "Pages sent to other nodes"),
+    COUNTER(page_data_skipped, "Grants sent without data"),
+    COUNTER(pages_compressed, "Pages sent zero-elided or compressed"),
+    COUNTER(compression_bytes_saved, "Page bytes not sent thanks to compression"),
+    COUNTER(invalidations_sent, "Invalidations sent"),
+    COUNTER(invalidations_received, "Invalidations received"),
+    COUNTER(network_bytes_sent, "Protocol bytes sent"),
+    COUNTER(network_bytes_received, "Protocol bytes received"),
+    COUNTER(lock_acquires, "Lock acquisitions"),
+    COUNTER(barrier_waits, "Barrier synchronizations"),
+    COUNTER(total_fault_latency_ns, "Fault handling time in nanoseconds"),
+    GAUGE(max_fault_latency_ns, "Longest fault in nanoseconds"),
+    GAUGE(min_fault_latency_ns, "Shortest fault in nanoseconds"),
+    COUNTER(queued_requests, "Page requests queued behind another"),
+    COUNTER(requests_forwarded, "Page requests passed on to the owner"),
+    COUNTER(false_sharing_events, "Potential false sharing detections"),
+    COUNTER(network_retries, "Network send retries"),
+    COUNTER(network_failures, "Network sends failed after retries"),
+    COUNTER(timeouts, "Request timeouts"),
+    COUNTER(twins_created, "Twins made on first write to a page"),
+    COUNTER(diffs_sent, "Diff messages sent to home nodes"),
+    COUNTER(diff_bytes_sent, "Changed bytes carried by diffs"),
+    COUNTER(diffs_applied, "Diff messages applied as home node"),
+    COUNTER(write_notices_sent, "Written pages reported with barrier arrivals"),
+    COUNTER(notice_invalidations, "Copies dropped at barrier exit by a write notice"),
+    COUNTER(prefetch_requests, "Page batch requests sent"),
+    COUNTER(pages_prefetched, "Pages installed by a prefetch"),
+    COUNTER(prefetch_hits, "Faults served by a prefetch in flight"),
+    COUNTER(async_acquires, "Asynchronous acquire requests queued"),
+    COUNTER(lock_cached_acquires, "Acquires served by a cached lock token"),
+    COUNTER(lock_recalls, "Cached lock tokens recalled"),
+    COUNTER(lock_shared_acquires, "Read acquires of reader-writer locks"),
+    COUNTER(batched_pages, "Pages whose protection changed in a batch"),
+    COUNTER(batched_mprotects, "mprotect calls taken by batches"),
+    GAUGE(bootstrap_ns, "Time dsm_init took in nanoseconds"),
+    COUNTER(peer_links_opened, "Direct links opened to other workers"),
+    COUNTER(heartbeats_sent, "Heartbeats sent to idle peers"),
+    COUNTER(probe_requests_sent, "Indirect probes asked for about silent peers"),
+    COUNTER(probe_acks_received, "Silent peers found alive by an indirect probe"),
+    COUNTER(adaptive_migrations, "Read faults that migrated ownership"),
+    COUNTER(adaptive_replicas, "Read-mostly pages fetched again at a barrier"),
+    COUNTER(pingpong_freezes, "Pages frozen for ping-ponging"),
+    COUNTER(rma_requests, "RMA requests sent"),
+    COUNTER(rma_bytes, "Bytes moved by dsm_get and dsm_put"),
+    COUNTER(rma_segments_served, "RMA segments served for other nodes"),
+    COUNTER(rma_fallbacks, "RMA segments completed through the fault path"),
+    COUNTER(atomic_ops, "DSM atomic operations completed"),
+    COUNTER(collectives, "Collective calls completed"),
+    COUNTER(collective_bytes, "Bytes contributed to or received from collectives"),
+};
+
+_Static_assert(sizeof(g_fields) / sizeof(g_fields[0]) == STATS_NUM_COUNTERS,
+               "every dsm_stats_t field needs a metric");
+
+static struct {
+    pthread_mutex_t lock;      /**< Serializes publishes */
+    dsm_metrics_page_t *page;  /**< Published page, NULL when off */
+    bool mapped;               /**< page is an mmap of fd */
+    int fd;
+    dsm_metrics_page_t scratch; /**< Snapshot being assembled */
+    node_id_t node_id;
+    int num_peers;
+    int interval_ms;
+    bool running;              /**< Cleared to stop the threads */
+    pthread_mutex_t wait_lock;
+    pthread_cond_t wait_cv;    /**< Wakes the publisher early on shutdown */
+    pthread_t publisher;
+    bool publisher_started;
+    int listen_fd;
+    pthread_t server;
+    bool server_started;
+} g_metrics = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wait_lock = PTHREAD_MUTEX_INITIALIZER,
+    .wait_cv = PTHREAD_COND_INITIALIZER,
+    .fd = -1,
+    .listen_fd = -1
+};
+
+static uint64_t realtime_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/** Fill the fields that never change */
+static void init_page_header(dsm_metrics_page_t *page, node_id_t node_id, int interval_ms) {
+    memset(page, 0, sizeof(*page));
+    page->magic = DSM_METRICS_MAGIC;
+    page->version = DSM_METRICS_VERSION;
+    page->size = sizeof(*page);
+    page->node_id = node_id;
+    page->pid = (uint32_t)getpid();
+    page->interval_ms = (uint32_t)interval_ms;
+    page->num_counters = STATS_NUM_COUNTERS;
+    page->num_paths = DSM_FAULT_PATH_COUNT;
+    page->num_buckets = DSM_LATENCY_BUCKETS;
+    page->stats_offset = offsetof(dsm_metrics_page_t, stats);
+    page->histograms_offset = offsetof(dsm_metrics_page_t, histograms);
+    page->peers_offset = offsetof(dsm_metrics_page_t, peers);
+
+    size_t pos = 0;
+    for (size_t i = 0; i < STATS_NUM_COUNTERS; i++) {
+        for (size_t f = 0; f < STATS_NUM_COUNTERS; f++) {
+            if (g_fields[f].index == i) {
+                pos += (size_t)snprintf(page->counter_names + pos,
+                                        sizeof(page->counter_names) - pos, "%s\n", g_fields[f].name);
+                break;
+            }
+        }
+    }
+    pos = 0;
+    for (int p = 0; p < DSM_FAULT_PATH_COUNT; p++) {
+        pos += (size_t)snprintf(page->path_names + pos, sizeof(page->path_names) - pos,
+                                "%s\n", stats_fault_path_name(p));
+    }
+}
+
+void metrics_fill_page(dsm_metrics_page_t *page, node_id_t node_id, int num_peers) {
+    if (num_peers > DSM_MAX_PEER_STATS) {
+        num_peers = DSM_MAX_PEER_STATS;
+    }
+
+    page->node_id = node_id;
+    page->publish_time_ns = realtime_ns();
+    stats_collect(&page->stats);
+    for (int p = 0; p < DSM_FAULT_PATH_COUNT; p++) {
+        stats_collect_histogram(p, &page->histograms[p]);
+    }
+    page->num_peers = (uint32_t)num_peers;
+    for (int peer = 0; peer < num_peers; peer++) {
+        stats_collect_peer((node_id_t)peer, &page->peers[peer]);
+    }
+}
+
+/** Copy the snapshot into the published page under the sequence lock */
+static void publish_locked(void) {
+    dsm_metrics_page_t *page = g_metrics.page;
+    dsm_metrics_page_t *snap = &g_metrics.scratch;
+
+    /* Assemble first so the odd window is one memcpy long */
+    metrics_fill_page(snap, g_metrics.node_id, g_metrics.num_peers);
+    snap->publishes = page->publishes + 1;
+
+    uint64_t seq = page->seq;
+    __atomic_store_n(&page->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    size_t off = offsetof(dsm_metrics_page_t, publish_time_ns);
+    memcpy((uint8_t *)page + off, (const uint8_t *)snap + off, sizeof(*page) - off);
+    __atomic_store_n(&page->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+int metrics_publish(void) {
+    pthread_mutex_lock(&g_metrics.lock);
+    int rc = DSM_ERROR_INIT;
+    if (g_metrics.page) {
+        publish_locked();
+        rc = DSM_SUCCESS;
+    }
+    pthread_mutex_unlock(&g_metrics.lock);
+    return rc;
+}
+
+static void *publisher_thread(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&g_metrics.wait_lock);
+    while (g_metrics.running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        uint64_t ns = (uint64_t)deadline.tv_nsec + (uint64_t)g_metrics.interval_ms * 1000000ULL;
+        deadline.tv_sec += (time_t)(ns / 1000000000ULL);
+        deadline.tv_nsec = (long)(ns % 1000000000ULL);
+        pthread_cond_timedwait(&g_metrics.wait_cv, &g_metrics.wait_lock, &deadline);
+        if (!g_metrics.running) {
+            break;
+        }
+
+        pthread_mutex_unlock(&g_metrics.wait_lock);
+        metrics_publish();
+        pthread_mutex_lock(&g_metrics.wait_lock);
+    }
+    pthread_mutex_unlock(&g_metrics.wait_lock);
+    return NULL;
+}
+
+static void write_metric_header(FILE *out, const char *name, const char *help, const char *type) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void metrics_write_prometheus(FILE *out, const dsm_metrics_page_t *page) {
+    const uint64_t *counters = (const uint64_t *)&page->stats;
+    unsigned node = page->node_id;
+    char name[128];
+
+    for (size_t f = 0; f < STATS_NUM_COUNTERS; f++) {
+        const metric_field_t *field = &g_fields[f];
+        snprintf(name, sizeof(name), "dsm_%s%s", field->name, field->gauge ? "" : "_total");
+        write_metric_header(out, name, field->help, field->gauge ? "gauge" : "counter");
+        fprintf(out, "%s{node=\"%u\"} %lu\n", name, node, counters[field->index]);
+    }
+
+    write_metric_header(out, "dsm_fault_latency_seconds", "Fault latency by fault path", "summary");
+    static const struct { const char *label; size_t offset; } quantiles[] = {
+        {"0.5", offsetof(dsm_latency_histogram_t, p50_ns)},
+        {"0.9", offsetof(dsm_latency_histogram_t, p90_ns)},
+        {"0.99", offsetof(dsm_latency_histogram_t, p99_ns)},
+        {"0.999", offsetof(dsm_latency_histogram_t, p999_ns)},
+    };
+    for (int p = 0; p < DSM_FAULT_PATH_COUNT; p++) {
+        const dsm_latency_histogram_t *h = &page->histograms[p];
+        const char *path = stats_fault_path_name(p);
+        for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++) {
+            uint64_t ns = *(const uint64_t *)((const uint8_t *)h + quantiles[q].offset);
+            fprintf(out, "dsm_fault_latency_seconds{node=\"%u\",path=\"%s\",quantile=\"%s\"} %.9f\n",
+                    node, path, quantiles[q].label, ns / 1e9);
+        }
+        fprintf(out, "dsm_fault_latency_seconds_sum{node=\"%u\",path=\"%s\"} %.9f\n",
+                node, path, h->total_ns / 1e9);
+        fprintf(out, "dsm_fault_latency_seconds_count{node=\"%u\",path=\"%s\"} %lu\n",
+                node, path, h->count);
+    }
+
+    static const struct { const char *name; const char *help; size_t offset; } peer_fields[] = {
+        {"dsm_peer_frames_sent_total", "Frames written to the peer",
+         offsetof(dsm_peer_stats_t, frames_sent)},
+        {"dsm_peer_bytes_sent_total", "Bytes written to the peer",
+         offsetof(dsm_peer_stats_t, bytes_sent)},
+        {"dsm_peer_frames_received_total", "Frames read from the peer",
+         offsetof(dsm_peer_stats_t, frames_received)},
+        {"dsm_peer_bytes_received_total", "Bytes read from the peer",
+         offsetof(dsm_peer_stats_t, bytes_received)},
+    };
+    uint32_t num_peers = page->num_peers < DSM_MAX_PEER_STATS ? page->num_peers : DSM_MAX_PEER_STATS;
+    for (size_t f = 0; f < sizeof(peer_fields) / sizeof(peer_fields[0]); f++) {
+        write_metric_header(out, peer_fields[f].name, peer_fields[f].help, "counter");
+        for (uint32_t peer = 0; peer < num_peers; peer++) {
+            const dsm_peer_stats_t *ps = &page->peers[peer];
+            if (ps->frames_sent == 0 && ps->frames_received == 0) {
+                continue;
+            }
+            uint64_t v = *(const uint64_t *)((const uint8_t *)ps + peer_fields[f].offset);
+            fprintf(out, "%s{node=\"%u\",peer=\"%u\"} %lu\n", peer_fields[f].name, node, peer, v);
+        }
+    }
+
+    write_metric_header(out, "dsm_metrics_publish_time_seconds",
+                        "Time the snapshot was taken", "gauge");
+    fprintf(out, "dsm_metrics_publish_time_seconds{node=\"%u\"} %.3f\n",
+            node, page->publish_time_ns / 1e9);
+}
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/** Queue an HTTP response with body on client */
+static void set_response(metrics_client_t *client, const char *status, const char *type,
+                         const char *body, size_t len) {
+    char head[256];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+                     "Connection: close\r\n\r\n", status, type, len);
+    client->response = malloc((size_t)n + len);
+    if (!client->response) {
+        return;
+    }
+    memcpy(client->response, head, (size_t)n);
+    memcpy(client->response + n, body, len);
+    client->response_len = (size_t)n + len;
+    client->sent = 0;
+}
+
+/** Build the response to the request client has read */
+static void answer_request(metrics_client_t *client) {
+    const char *request = client->request;
+    if (strncmp(request, "GET /metrics", 12) != 0 ||
+        (request[12] != ' ' && request[12] != '?')) {
+        const char *body = "Not found: try /metrics\n";
+        set_response(client, "404 Not Found", "text/plain", body, strlen(body));
+        return;
+    }
+
+    /* Read the page the way an external tool would */
+    dsm_metrics_page_t *snap = malloc(sizeof(*snap));
+    if (!snap || dsm_metrics_read(g_metrics.page, snap) != 0) {
+        free(snap);
+        const char *body = "Metrics busy\n";
+        set_response(client, "503 Service Unavailable", "text/plain", body, strlen(body));
+        return;
+    }
+
+    char *body = NULL;
+    size_t len = 0;
+    FILE *out = open_memstream(&body, &len);
+    if (out) {
+        metrics_write_prometheus(out, snap);
+        fclose(out);
+        set_response(client, "200 OK", "text/plain; version=0.0.4", body, len);
+    }
+    free(body);
+    free(snap);
+}
+
+static void close_client(metrics_client_t *client) {
+    close(client->fd);
+    free(client->response);
+    client->fd = -1;
+    client->response = NULL;
+}
+
+/**
+ * Read what client sent, or write what it is owed
+ *
+ * @return false once the connection is done with (answered, closed or broken)
+ */
+static bool serve_client(metrics_client_t *client) {
+    if (!client->response) {
+        ssize_t n = recv(client->fd, client->request + client->got,
+                         sizeof(client->request) - 1 - client->got, MSG_DONTWAIT);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            return true;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        client->got += (size_t)n;
+        client->request[client->got] = '\0';
+        if (!strstr(client->request, "\r\n\r\n") && !strstr(client->request, "\n\n") &&
+            client->got < sizeof(client->request) - 1) {
+            return true;
+        }
+        answer_request(client);
+        if (!client->response) {
+            return false;
+        }
+    }
+
+    while (client->sent < client->response_len) {
+        ssize_t n = send(client->fd, client->response + client->sent,
+                         client->response_len - client->sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        client->sent += (size_t)n;
+    }
+    return false;
+}
+
+/**
+ * Endpoint thread: one poll() over the listener and every open connection
+ *
+ * Connections are read and written only when poll() says they are ready,
+ * so a client that connects and sends nothing holds up no other; it is
+ * closed once METRICS_CLIENT_TIMEOUT_MS has passed.
+ */
+static void *server_thread(void *arg) {
+    (void)arg;
+    metrics_client_t clients[METRICS_MAX_CLIENTS];
+    for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+        clients[i].response = NULL;
+    }
+
+    while (g_metrics.running) {
+        struct pollfd pfds[METRICS_MAX_CLIENTS + 1];
+        int slot_of[METRICS_MAX_CLIENTS + 1];
+        int nfds = 0;
+        int open_clients = 0;
+        for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+            if (clients[i].fd >= 0) {
+                pfds[nfds].fd = clients[i].fd;
+                pfds[nfds].events = clients[i].response ? POLLOUT : POLLIN;
+                pfds[nfds].revents = 0;
+                slot_of[nfds++] = i;
+                open_clients++;
+            }
+        }
+        /* With every slot taken, new connections wait in the backlog */
+        if (open_clients < METRICS_MAX_CLIENTS) {
+            pfds[nfds].fd = g_metrics.listen_fd;
+            pfds[nfds].events = POLLIN;
+            pfds[nfds].revents = 0;
+            slot_of[nfds++] = -1;
+        }
+
+        int ready = poll(pfds, (nfds_t)nfds, METRICS_POLL_MS);
+        uint64_t now = monotonic_ns();
+
+        for (int p = 0; p < nfds && ready > 0; p++) {
+            if (pfds[p].revents == 0) {
+                continue;
+            }
+            if (slot_of[p] >= 0) {
+                metrics_client_t *client = &clients[slot_of[p]];
+                if (!serve_client(client)) {
+                    close_client(client);
+                }
+                continue;
+            }
+
+            int fd;
+            while (open_clients < METRICS_MAX_CLIENTS &&
+                   (fd = accept(g_metrics.listen_fd, NULL, NULL)) >= 0) {
+                for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+                    if (clients[i].fd < 0) {
+                        clients[i].fd = fd;
+                        clients[i].got = 0;
+                        clients[i].deadline_ns = now + METRICS_CLIENT_TIMEOUT_MS * 1000000ULL;
+                        open_clients++;
+                        break;
+                    }
+                }
+            }
+        }
+
+        for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+            if (clients[i].fd >= 0 && now >= clients[i].deadline_ns) {
+                close_client(&clients[i]);
+            }
+        }
+    }
+
+    for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        if (clients[i].fd >= 0) {
+            close_client(&clients[i]);
+        }
+    }
+    return NULL;
+}
+
+/** Map metrics_path, or allocate a private page when there is none */
+static int open_page(const char *path) {
+    if (!path) {
+        g_metrics.page = calloc(1, sizeof(dsm_metrics_page_t));
+        g_metrics.mapped = false;
+        return g_metrics.page ? DSM_SUCCESS : DSM_ERROR_MEMORY;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("Failed to open metrics file %s: %s", path, strerror(errno));
+        return DSM_ERROR_INIT;
+    }
+    if (ftruncate(fd, (off_t)sizeof(dsm_metrics_page_t)) != 0) {
+        LOG_ERROR("Failed to size metrics file %s: %s", path, strerror(errno));
+        close(fd);
+        return DSM_ERROR_INIT;
+    }
+    void *page = mmap(NULL, sizeof(dsm_metrics_page_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (page == MAP_FAILED) {
+        LOG_ERROR("Failed to map metrics file %s: %s", path, strerror(errno));
+        close(fd);
+        return DSM_ERROR_INIT;
+    }
+
+    g_metrics.page = page;
+    g_metrics.mapped = true;
+    g_metrics.fd = fd;
+    return DSM_SUCCESS;
+}
+
+static void close_page(void) {
+    if (g_metrics.mapped) {
+        munmap(g_metrics.page, sizeof(dsm_metrics_page_t));
+        close(g_metrics.fd);
+    } else {
+        free(g_metrics.page);
+    }
+    g_metrics.page = NULL;
+    g_metrics.mapped = false;
+    g_metrics.fd = -1;
+}
+
+static int open_listener(const char *host, int port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        LOG_ERROR("Invalid metrics bind address %s (IPv4 address expected)", host);
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+        LOG_ERROR("Failed to listen for metrics on %s:%d: %s", host, port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int metrics_start(const dsm_config_t *config) {
+    if (!config || (!config->metrics_path && config->metrics_port <= 0)) {
+        return DSM_SUCCESS;
+    }
+
+    int rc = open_page(config->metrics_path);
+    if (rc != DSM_SUCCESS) {
+        return rc;
+    }
+
+    g_metrics.node_id = config->node_id;
+    g_metrics.interval_ms = config->metrics_interval_ms > 0 ? config->metrics_interval_ms
+                                                            : METRICS_DEFAULT_INTERVAL_MS;
+    dsm_context_t *ctx = dsm_get_context();
+    g_metrics.num_peers = ctx->network.max_nodes > 0 ? ctx->network.max_nodes : config->num_nodes;
+    if (g_metrics.num_peers > DSM_MAX_PEER_STATS) {
+        g_metrics.num_peers = DSM_MAX_PEER_STATS;
+    }
+
+    init_page_header(g_metrics.page, g_metrics.node_id, g_metrics.interval_ms);
+    init_page_header(&g_metrics.scratch, g_metrics.node_id, g_metrics.interval_ms);
+    metrics_publish();
+
+    const char *bind_host = config->metrics_bind ? config->metrics_bind : METRICS_DEFAULT_BIND;
+    if (config->metrics_port > 0) {
+        g_metrics.listen_fd = open_listener(bind_host, config->metrics_port);
+        if (g_metrics.listen_fd < 0) {
+            close_page();
+            return DSM_ERROR_INIT;
+        }
+    }
+
+    g_metrics.running = true;
+    g_metrics.publisher_started =
+        pthread_create(&g_metrics.publisher, NULL, publisher_thread, NULL) == 0;
+    if (g_metrics.listen_fd >= 0) {
+        g_metrics.server_started =
+            pthread_create(&g_metrics.server, NULL, server_thread, NULL) == 0;
+    }
+    if (!g_metrics.publisher_started) {
+        LOG_WARN("Metrics publisher thread failed to start, page updates on demand only");
+    }
+
+    LOG_INFO("Publishing metrics every %d ms to %s", g_metrics.interval_ms,
+             config->metrics_path ? config->metrics_path : "memory");
+    if (g_metrics.listen_fd >= 0) {
+        LOG_INFO("Prometheus metrics on %s:%d at /metrics", bind_host, config->metrics_port);
+    }
+    return DSM_SUCCESS;
+}
+
+void metrics_stop(void) {
+    if (!g_metrics.page) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_metrics.wait_lock);
+    __atomic_store_n(&g_metrics.running, false, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&g_metrics.wait_cv);
+    pthread_mutex_unlock(&g_metrics.wait_lock);
+
+    if (g_metrics.publisher_started) {
+        pthread_join(g_metrics.publisher, NULL);
+        g_metrics.publisher_started = false;
+    }
+    if (g_metrics.server_started) {
+        pthread_join(g_metrics.server, NULL);
+        g_metrics.server_started = false;
+    }
+    if (g_metrics.listen_fd >= 0) {
+        close(g_metrics.listen_fd);
+        g_metrics.listen_fd = -1;
+    }
+
+    /* Leave the final counters for tools that read the file afterwards */
+    metrics_publish();
+
+    pthread_mutex_lock(&g_metrics.lock);
+    close_page();
+    pthread_mutex_unlock(&g_metrics.lock);
+}
@@ -0,0 +1,73 @@
+/**
+ * @file metrics.h
+ * @brief Live metrics publisher and Prometheus endpoint
+ *
+ * Started by dsm_init() when dsm_config_t.metrics_path or metrics_port is
+ * set. A publisher thread snapshots the counters every metrics_interval_ms
+ * into a dsm_metrics_page_t (see dsm/metrics.h): the mapped metrics_path
+ * file, or private memory when only the endpoint is on. The fault path is
+ * untouched; it keeps updating its per-thread counters as before.
+ *
+ * With metrics_port set, a second thread answers "GET /metrics" on that
+ * port with the latest snapshot in Prometheus text format, one request per
+ * connection. It listens on metrics_bind, loopback unless set, and serves
+ * its connections together without blocking on any of them.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "dsm/metrics.h"
+#include "dsm/types.h"
+#include <stdio.h>
+
+/** Publish interval when dsm_config_t.metrics_interval_ms is 0 */
+#define METRICS_DEFAULT_INTERVAL_MS 1000
+
+/**
+ * Map the metrics page and start the publisher (and endpoint)
+ *
+ * @param config DSM configuration (metrics_path, metrics_port, metrics_bind,
+ *               metrics_interval_ms)
+ * @return DSM_SUCCESS (also when both are off), DSM_ERROR_INIT if the file
+ *         cannot be mapped or the port bound, or DSM_ERROR_MEMORY
+ */
+int metrics_start(const dsm_config_t *config);
+
+/**
+ * Publish a last snapshot, stop the threads and unmap the page
+ *
+ * The file is left in place holding the final snapshot.
+ */
+void metrics_stop(void);
+
+/**
+ * Write a snapshot now instead of at the next interval
+ *
+ * @return DSM_SUCCESS, or DSM_ERROR_INIT if metrics are off
+ */
+int metrics_publish(void);
+
+/**
+ * Fill a page with a snapshot of the current counters
+ * Used by the publisher; the page's seq is left untouched.
+ *
+ * @param page Page to fill
+ * @param node_id Publishing node
+ * @param num_peers Peer entries to fill
+ */
+void metrics_fill_page(dsm_metrics_page_t *page, node_id_t node_id, int num_peers);
+
+/**
+ * Write a snapshot in Prometheus text exposition format
+ *
+ * Counters become dsm_<field>_total, maxima, minima and bootstrap time
+ * gauges, each histogram a dsm_fault_latency_seconds summary labelled by
+ * path, and each peer with traffic dsm_peer_*_total series labelled by peer.
+ *
+ * @param out Stream to write to
+ * @param page Snapshot
+ */
+void metrics_write_prometheus(FILE *out, const dsm_metrics_page_t *page);
+
+#endif /* METRICS_H */
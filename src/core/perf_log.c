@@ -6,20 +6,22 @@
 #include "perf_log.h"
 #include "log.h"
 #include "dsm_context.h"
+#include "stats.h"
+#include "trace.h"
+#include "sharing_profile.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <pthread.h>
 
 /* Global performance log state */
 static struct {
-    FILE *log_file;
-    pthread_mutex_t lock;
     bool initialized;
+    bool tracing;              /**< Binary trace running for log_path */
     char log_path[256];
+    char trace_path[272];
 } g_perf_log = {
-    .log_file = NULL,
-    .initialized = false
+    .initialized = false,
+    .tracing = false
 };
 
 int perf_log_init(const char *log_file) {
@@ -28,21 +30,19 @@ int perf_log_init(const char *log_file) {
         return DSM_SUCCESS;
     }
 
-    pthread_mutex_init(&g_perf_log.lock, NULL);
-
     if (log_file) {
-        g_perf_log.log_file = fopen(log_file, "w");
-        if (!g_perf_log.log_file) {
-            LOG_ERROR("Failed to open performance log file: %s", log_file);
-            return DSM_ERROR_INIT;
-        }
-
+        /* Events are recorded to a binary trace and converted to CSV at cleanup */
         strncpy(g_perf_log.log_path, log_file, sizeof(g_perf_log.log_path) - 1);
+        snprintf(g_perf_log.trace_path, sizeof(g_perf_log.trace_path), "%s.trace",
+                 g_perf_log.log_path);
 
-        /* Write CSV header */
-        fprintf(g_perf_log.log_file,
-                "timestamp_ns,event_type,page_id,access_type,latency_ns,was_queued\n");
-        fflush(g_perf_log.log_file);
+        dsm_context_t *ctx = dsm_get_context();
+        int rc = trace_start(g_perf_log.trace_path, ctx ? ctx->node_id : 0);
+        if (rc != DSM_SUCCESS) {
+            LOG_ERROR("Failed to open performance log file: %s", log_file);
+            return rc;
+        }
+        g_perf_log.tracing = true;
 
         LOG_INFO("Performance logging initialized: %s", log_file);
     }
@@ -56,119 +56,50 @@ void perf_log_cleanup(void) {
         return;
     }
 
-    pthread_mutex_lock(&g_perf_log.lock);
-
-    if (g_perf_log.log_file) {
-        fclose(g_perf_log.log_file);
-        g_perf_log.log_file = NULL;
+    if (g_perf_log.tracing) {
+        trace_stop();
+        int rows = trace_convert_csv(g_perf_log.trace_path, g_perf_log.log_path);
+        if (rows >= 0) {
+            LOG_INFO("Performance log written: %s (%d events)", g_perf_log.log_path, rows);
+        }
+        g_perf_log.tracing = false;
     }
 
     g_perf_log.initialized = false;
-    pthread_mutex_unlock(&g_perf_log.lock);
-
-    pthread_mutex_destroy(&g_perf_log.lock);
 }
 
 void perf_log_fault(page_id_t page_id, access_type_t access_type,
                     uint64_t latency_ns, bool was_queued) {
-    if (!g_perf_log.initialized) {
-        return;
-    }
-
-    dsm_context_t *ctx = dsm_get_context();
-    if (!ctx) {
-        return;
-    }
-
-    /* Update statistics */
-    pthread_mutex_lock(&ctx->stats_lock);
-
-    /* Track latency */
-    ctx->stats.total_fault_latency_ns += latency_ns;
-    if (latency_ns > ctx->stats.max_fault_latency_ns) {
-        ctx->stats.max_fault_latency_ns = latency_ns;
-    }
-    if (ctx->stats.min_fault_latency_ns == 0 ||
-        latency_ns < ctx->stats.min_fault_latency_ns) {
-        ctx->stats.min_fault_latency_ns = latency_ns;
-    }
-
+    /* Track latency (lock-free per-thread counters, kept even without a log file) */
+    stats_record_fault_latency(latency_ns);
     if (was_queued) {
-        ctx->stats.queued_requests++;
+        STATS_INC(queued_requests);
     }
 
-    pthread_mutex_unlock(&ctx->stats_lock);
-
-    /* Log to CSV file */
-    pthread_mutex_lock(&g_perf_log.lock);
-    if (g_perf_log.log_file) {
-        uint64_t timestamp = perf_get_timestamp_ns();
-        fprintf(g_perf_log.log_file,
-                "%lu,PAGE_FAULT,%lu,%s,%lu,%d\n",
-                timestamp, page_id,
-                access_type == ACCESS_READ ? "READ" : "WRITE",
-                latency_ns, was_queued ? 1 : 0);
-        fflush(g_perf_log.log_file);
-    }
-    pthread_mutex_unlock(&g_perf_log.lock);
+    trace_event(TRACE_PAGE_FAULT, page_id, (uint8_t)access_type, latency_ns,
+                was_queued ? TRACE_FLAG_QUEUED : 0, TRACE_NODE_NONE);
 }
 
 void perf_log_false_sharing(page_id_t page_id) {
-    dsm_context_t *ctx = dsm_get_context();
-    if (!ctx) {
-        return;
-    }
-
-    pthread_mutex_lock(&ctx->stats_lock);
-    ctx->stats.false_sharing_events++;
-    pthread_mutex_unlock(&ctx->stats_lock);
-
-    pthread_mutex_lock(&g_perf_log.lock);
-    if (g_perf_log.log_file) {
-        uint64_t timestamp = perf_get_timestamp_ns();
-        fprintf(g_perf_log.log_file,
-                "%lu,FALSE_SHARING,%lu,NA,0,0\n",
-                timestamp, page_id);
-        fflush(g_perf_log.log_file);
-    }
-    pthread_mutex_unlock(&g_perf_log.lock);
+    STATS_INC(false_sharing_events);
+    trace_event(TRACE_FALSE_SHARING, page_id, TRACE_ACCESS_NONE, 0, 0, TRACE_NODE_NONE);
 
     LOG_DEBUG("False sharing detected on page %lu", page_id);
 }
 
 void perf_log_network_retry(void) {
-    dsm_context_t *ctx = dsm_get_context();
-    if (!ctx) {
-        return;
-    }
-
-    pthread_mutex_lock(&ctx->stats_lock);
-    ctx->stats.network_retries++;
-    pthread_mutex_unlock(&ctx->stats_lock);
+    STATS_INC(network_retries);
 }
 
 void perf_log_network_failure(void) {
-    dsm_context_t *ctx = dsm_get_context();
-    if (!ctx) {
-        return;
-    }
-
-    pthread_mutex_lock(&ctx->stats_lock);
-    ctx->stats.network_failures++;
-    pthread_mutex_unlock(&ctx->stats_lock);
+    STATS_INC(network_failures);
 }
 
 void perf_log_timeout(void) {
-    dsm_context_t *ctx = dsm_get_context();
-    if (!ctx) {
-        return;
-    }
-
-    pthread_mutex_lock(&ctx->stats_lock);
-    ctx->stats.timeouts++;
-    pthread_mutex_unlock(&ctx->stats_lock);
+    STATS_INC(timeouts);
 }
 
+
 int perf_log_export_stats(void) {
     dsm_context_t *ctx = dsm_get_context();
     if (!ctx) {
@@ -184,41 +115,96 @@ int perf_log_export_stats(void) {
         return DSM_ERROR_INIT;
     }
 
-    pthread_mutex_lock(&ctx->stats_lock);
+    dsm_stats_t stats;
+    stats_collect(&stats);
 
     fprintf(f, "metric,value\n");
     fprintf(f, "node_id,%u\n", ctx->node_id);
-    fprintf(f, "page_faults,%lu\n", ctx->stats.page_faults);
-    fprintf(f, "read_faults,%lu\n", ctx->stats.read_faults);
-    fprintf(f, "write_faults,%lu\n", ctx->stats.write_faults);
-    fprintf(f, "pages_fetched,%lu\n", ctx->stats.pages_fetched);
-    fprintf(f, "pages_sent,%lu\n", ctx->stats.pages_sent);
-    fprintf(f, "invalidations_sent,%lu\n", ctx->stats.invalidations_sent);
-    fprintf(f, "invalidations_received,%lu\n", ctx->stats.invalidations_received);
-    fprintf(f, "network_bytes_sent,%lu\n", ctx->stats.network_bytes_sent);
-    fprintf(f, "network_bytes_received,%lu\n", ctx->stats.network_bytes_received);
+    fprintf(f, "page_faults,%lu\n", stats.page_faults);
+    fprintf(f, "read_faults,%lu\n", stats.read_faults);
+    fprintf(f, "write_faults,%lu\n", stats.write_faults);
+    fprintf(f, "pages_fetched,%lu\n", stats.pages_fetched);
+    fprintf(f, "pages_sent,%lu\n", stats.pages_sent);
+    fprintf(f, "page_data_skipped,%lu\n", stats.page_data_skipped);
+    fprintf(f, "pages_compressed,%lu\n", stats.pages_compressed);
+    fprintf(f, "compression_bytes_saved,%lu\n", stats.compression_bytes_saved);
+    fprintf(f, "invalidations_sent,%lu\n", stats.invalidations_sent);
+    fprintf(f, "invalidations_received,%lu\n", stats.invalidations_received);
+    fprintf(f, "network_bytes_sent,%lu\n", stats.network_bytes_sent);
+    fprintf(f, "network_bytes_received,%lu\n", stats.network_bytes_received);
 
     /* Performance metrics */
     uint64_t avg_latency = 0;
-    if (ctx->stats.page_faults > 0) {
-        avg_latency = ctx->stats.total_fault_latency_ns / ctx->stats.page_faults;
+    if (stats.page_faults > 0) {
+        avg_latency = stats.total_fault_latency_ns / stats.page_faults;
     }
     fprintf(f, "avg_fault_latency_ns,%lu\n", avg_latency);
     fprintf(f, "avg_fault_latency_us,%lu\n", avg_latency / 1000);
-    fprintf(f, "max_fault_latency_ns,%lu\n", ctx->stats.max_fault_latency_ns);
-    fprintf(f, "max_fault_latency_us,%lu\n", ctx->stats.max_fault_latency_ns / 1000);
-    fprintf(f, "min_fault_latency_ns,%lu\n", ctx->stats.min_fault_latency_ns);
-    fprintf(f, "min_fault_latency_us,%lu\n", ctx->stats.min_fault_latency_ns / 1000);
-    fprintf(f, "queued_requests,%lu\n", ctx->stats.queued_requests);
-    fprintf(f, "false_sharing_events,%lu\n", ctx->stats.false_sharing_events);
-    fprintf(f, "network_retries,%lu\n", ctx->stats.network_retries);
-    fprintf(f, "network_failures,%lu\n", ctx->stats.network_failures);
-    fprintf(f, "timeouts,%lu\n", ctx->stats.timeouts);
-
-    pthread_mutex_unlock(&ctx->stats_lock);
+    fprintf(f, "max_fault_latency_ns,%lu\n", stats.max_fault_latency_ns);
+    fprintf(f, "max_fault_latency_us,%lu\n", stats.max_fault_latency_ns / 1000);
+    fprintf(f, "min_fault_latency_ns,%lu\n", stats.min_fault_latency_ns);
+    fprintf(f, "min_fault_latency_us,%lu\n", stats.min_fault_latency_ns / 1000);
+    fprintf(f, "queued_requests,%lu\n", stats.queued_requests);
+    fprintf(f, "requests_forwarded,%lu\n", stats.requests_forwarded);
+    fprintf(f, "false_sharing_events,%lu\n", stats.false_sharing_events);
+    fprintf(f, "network_retries,%lu\n", stats.network_retries);
+    fprintf(f, "network_failures,%lu\n", stats.network_failures);
+    fprintf(f, "timeouts,%lu\n", stats.timeouts);
+    fprintf(f, "twins_created,%lu\n", stats.twins_created);
+    fprintf(f, "diffs_sent,%lu\n", stats.diffs_sent);
+    fprintf(f, "diff_bytes_sent,%lu\n", stats.diff_bytes_sent);
+    fprintf(f, "diffs_applied,%lu\n", stats.diffs_applied);
+    fprintf(f, "write_notices_sent,%lu\n", stats.write_notices_sent);
+    fprintf(f, "notice_invalidations,%lu\n", stats.notice_invalidations);
+    fprintf(f, "prefetch_requests,%lu\n", stats.prefetch_requests);
+    fprintf(f, "pages_prefetched,%lu\n", stats.pages_prefetched);
+    fprintf(f, "prefetch_hits,%lu\n", stats.prefetch_hits);
+    fprintf(f, "async_acquires,%lu\n", stats.async_acquires);
+    fprintf(f, "lock_cached_acquires,%lu\n", stats.lock_cached_acquires);
+    fprintf(f, "lock_recalls,%lu\n", stats.lock_recalls);
+    fprintf(f, "lock_shared_acquires,%lu\n", stats.lock_shared_acquires);
+    fprintf(f, "batched_pages,%lu\n", stats.batched_pages);
+    fprintf(f, "batched_mprotects,%lu\n", stats.batched_mprotects);
+    fprintf(f, "bootstrap_ns,%lu\n", stats.bootstrap_ns);
+    fprintf(f, "peer_links_opened,%lu\n", stats.peer_links_opened);
+    fprintf(f, "heartbeats_sent,%lu\n", stats.heartbeats_sent);
+    fprintf(f, "probe_requests_sent,%lu\n", stats.probe_requests_sent);
+    fprintf(f, "probe_acks_received,%lu\n", stats.probe_acks_received);
+    fprintf(f, "adaptive_migrations,%lu\n", stats.adaptive_migrations);
+    fprintf(f, "adaptive_replicas,%lu\n", stats.adaptive_replicas);
+    fprintf(f, "pingpong_freezes,%lu\n", stats.pingpong_freezes);
+    fprintf(f, "rma_requests,%lu\n", stats.rma_requests);
+    fprintf(f, "rma_bytes,%lu\n", stats.rma_bytes);
+    fprintf(f, "rma_segments_served,%lu\n", stats.rma_segments_served);
+    fprintf(f, "rma_fallbacks,%lu\n", stats.rma_fallbacks);
+    fprintf(f, "atomic_ops,%lu\n", stats.atomic_ops);
+    fprintf(f, "collectives,%lu\n", stats.collectives);
+    fprintf(f, "collective_bytes,%lu\n", stats.collective_bytes);
+
+    /* Fault latency percentiles per path */
+    for (int p = 0; p < DSM_FAULT_PATH_COUNT; p++) {
+        dsm_latency_histogram_t hist;
+        stats_collect_histogram((dsm_fault_path_t)p, &hist);
+        const char *name = stats_fault_path_name(p);
+        fprintf(f, "fault_%s_count,%lu\n", name, hist.count);
+        fprintf(f, "fault_%s_p50_ns,%lu\n", name, hist.p50_ns);
+        fprintf(f, "fault_%s_p90_ns,%lu\n", name, hist.p90_ns);
+        fprintf(f, "fault_%s_p99_ns,%lu\n", name, hist.p99_ns);
+        fprintf(f, "fault_%s_p999_ns,%lu\n", name, hist.p999_ns);
+        fprintf(f, "fault_%s_max_ns,%lu\n", name, hist.max_ns);
+    }
 
     fclose(f);
     LOG_INFO("Statistics exported to: %s", stats_file);
+
+    /* The ranked sharing profile goes next to the statistics */
+    if (sharing_profile_enabled()) {
+        char sharing_file[512];
+        snprintf(sharing_file, sizeof(sharing_file), "dsm_sharing_node%u.csv", ctx->node_id);
+        if (sharing_profile_export(sharing_file, ctx->node_id) < 0) {
+            return DSM_ERROR_INIT;
+        }
+    }
     return DSM_SUCCESS;
 }
 
@@ -228,33 +214,90 @@ void perf_log_print_summary(void) {
         return;
     }
 
-    pthread_mutex_lock(&ctx->stats_lock);
+    dsm_stats_t stats;
+    stats_collect(&stats);
 
     printf("\n");
     printf("========================================\n");
     printf("  DSM Performance Summary (Node %u)\n", ctx->node_id);
     printf("========================================\n");
-    printf("Page Faults:         %lu\n", ctx->stats.page_faults);
-    printf("  Read Faults:       %lu\n", ctx->stats.read_faults);
-    printf("  Write Faults:      %lu\n", ctx->stats.write_faults);
-    printf("Pages Fetched:       %lu\n", ctx->stats.pages_fetched);
-    printf("Pages Sent:          %lu\n", ctx->stats.pages_sent);
-    printf("Invalidations Sent:  %lu\n", ctx->stats.invalidations_sent);
-    printf("Invalidations Rcvd:  %lu\n", ctx->stats.invalidations_received);
+    printf("Page Faults:         %lu\n", stats.page_faults);
+    printf("  Read Faults:       %lu\n", stats.read_faults);
+    printf("  Write Faults:      %lu\n", stats.write_faults);
+    printf("Pages Fetched:       %lu\n", stats.pages_fetched);
+    printf("Pages Sent:          %lu\n", stats.pages_sent);
+    printf("  Data Skipped:      %lu\n", stats.page_data_skipped);
+    printf("  Compressed:        %lu (%lu bytes saved)\n",
+           stats.pages_compressed, stats.compression_bytes_saved);
+    printf("Invalidations Sent:  %lu\n", stats.invalidations_sent);
+    printf("Invalidations Rcvd:  %lu\n", stats.invalidations_received);
 
     printf("\nPerformance Metrics:\n");
-    if (ctx->stats.page_faults > 0) {
-        uint64_t avg = ctx->stats.total_fault_latency_ns / ctx->stats.page_faults;
+    if (stats.page_faults > 0) {
+        uint64_t avg = stats.total_fault_latency_ns / stats.page_faults;
         printf("  Avg Fault Latency: %lu us\n", avg / 1000);
-        printf("  Max Fault Latency: %lu us\n", ctx->stats.max_fault_latency_ns / 1000);
-        printf("  Min Fault Latency: %lu us\n", ctx->stats.min_fault_latency_ns / 1000);
+        printf("  Max Fault Latency: %lu us\n", stats.max_fault_latency_ns / 1000);
+        printf("  Min Fault Latency: %lu us\n", stats.min_fault_latency_ns / 1000);
+    }
+    printf("  Queued Requests:   %lu\n", stats.queued_requests);
+    printf("  Forwarded:         %lu\n", stats.requests_forwarded);
+    printf("  False Sharing:     %lu\n", stats.false_sharing_events);
+    printf("  Network Retries:   %lu\n", stats.network_retries);
+    printf("  Network Failures:  %lu\n", stats.network_failures);
+    printf("  Timeouts:          %lu\n", stats.timeouts);
+    if (stats.twins_created > 0 || stats.diffs_applied > 0) {
+        printf("  Twins Created:     %lu\n", stats.twins_created);
+        printf("  Diffs Sent:        %lu (%lu bytes)\n", stats.diffs_sent, stats.diff_bytes_sent);
+        printf("  Diffs Applied:     %lu\n", stats.diffs_applied);
+        printf("  Write Notices:     %lu sent, %lu invalidations\n",
+               stats.write_notices_sent, stats.notice_invalidations);
+    }
+    if (stats.prefetch_requests > 0 || stats.pages_prefetched > 0) {
+        printf("  Prefetch Requests: %lu\n", stats.prefetch_requests);
+        printf("  Pages Prefetched:  %lu (%lu faults hit in flight)\n",
+               stats.pages_prefetched, stats.prefetch_hits);
+    }
+    if (stats.async_acquires > 0) {
+        printf("  Async Acquires:    %lu\n", stats.async_acquires);
+    }
+    if (stats.batched_pages > 0) {
+        printf("  Batched Pages:     %lu (%lu mprotect calls)\n",
+               stats.batched_pages, stats.batched_mprotects);
+    }
+    printf("  Bootstrap:         %.1f ms\n", stats.bootstrap_ns / 1e6);
+    if (stats.peer_links_opened > 0) {
+        printf("  Peer Links:        %lu opened\n", stats.peer_links_opened);
+    }
+    printf("  Heartbeats Sent:   %lu\n", stats.heartbeats_sent);
+    if (stats.probe_requests_sent > 0 || stats.probe_acks_received > 0) {
+        printf("  Indirect Probes:   %lu asked, %lu answered\n",
+               stats.probe_requests_sent, stats.probe_acks_received);
+    }
+    if (stats.adaptive_migrations > 0 || stats.adaptive_replicas > 0 || stats.pingpong_freezes > 0) {
+        printf("  Adaptive:          %lu migrations, %lu replicas, %lu freezes\n",
+               stats.adaptive_migrations, stats.adaptive_replicas, stats.pingpong_freezes);
+    }
+    if (stats.rma_bytes > 0 || stats.rma_segments_served > 0 || stats.atomic_ops > 0) {
+        printf("  One-Sided:         %lu bytes, %lu atomics, %lu requests, %lu served, %lu fallbacks\n",
+               stats.rma_bytes, stats.atomic_ops, stats.rma_requests, stats.rma_segments_served,
+               stats.rma_fallbacks);
+    }
+    if (stats.collectives > 0) {
+        printf("  Collectives:       %lu calls, %lu bytes\n", stats.collectives, stats.collective_bytes);
     }
-    printf("  Queued Requests:   %lu\n", ctx->stats.queued_requests);
-    printf("  False Sharing:     %lu\n", ctx->stats.false_sharing_events);
-    printf("  Network Retries:   %lu\n", ctx->stats.network_retries);
-    printf("  Network Failures:  %lu\n", ctx->stats.network_failures);
-    printf("  Timeouts:          %lu\n", ctx->stats.timeouts);
-    printf("========================================\n\n");
 
-    pthread_mutex_unlock(&ctx->stats_lock);
+    printf("\nFault Latency (us):  %8s %8s %8s %8s %8s %8s\n",
+           "count", "p50", "p90", "p99", "p99.9", "max");
+    for (int p = 0; p < DSM_FAULT_PATH_COUNT; p++) {
+        dsm_latency_histogram_t hist;
+        stats_collect_histogram((dsm_fault_path_t)p, &hist);
+        if (hist.count == 0) {
+            continue;
+        }
+        printf("  %-18s %8lu %8lu %8lu %8lu %8lu %8lu\n", stats_fault_path_name(p),
+               hist.count, hist.p50_ns / 1000, hist.p90_ns / 1000, hist.p99_ns / 1000,
+               hist.p999_ns / 1000, hist.max_ns / 1000);
+    }
+    sharing_profile_print(stdout, SHARING_PROFILE_SUMMARY_PAGES);
+    printf("========================================\n\n");
 }
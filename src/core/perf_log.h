@@ -6,6 +6,10 @@
  * - CSV export of statistics
  * - Latency tracking
  * - False sharing detection
+ *
+ * Events go to the binary trace recorder (trace.h) rather than being
+ * formatted on the hot path; the CSV event log is produced from the trace
+ * when logging is cleaned up.
  */
 
 #ifndef PERF_LOG_H
@@ -18,6 +22,9 @@
 /**
  * Initialize performance logging
  *
+ * Starts a binary trace at "<log_file>.trace"; perf_log_cleanup() converts
+ * it to the CSV event log at log_file.
+ *
  * @param log_file Path to CSV log file (NULL to disable)
  * @return DSM_SUCCESS on success, error code on failure
  */
@@ -25,12 +32,16 @@ int perf_log_init(const char *log_file);
 
 /**
  * Cleanup performance logging
+ * Stops the trace and writes the CSV event log.
  */
 void perf_log_cleanup(void);
 
 /**
  * Record a page fault event
  *
+ * Latency statistics are always updated; the event is traced only when
+ * perf_log_init() opened a log file.
+ *
  * @param page_id Page that faulted
  * @param access_type Read or write
  * @param latency_ns Latency in nanoseconds
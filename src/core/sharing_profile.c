@@ -0,0 +1,309 @@
+/**
+ * @file sharing_profile.c
+ * @brief Per-page false-sharing and contention profiler implementation
+ */
+
+#include "sharing_profile.h"
+#include "dsm/dsm.h"
+#include "log.h"
+#include "perf_log.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Open-addressed table of page records */
+static struct {
+    pthread_mutex_t lock;
+    sharing_page_t *slots;     /**< capacity records */
+    bool *used;                /**< Slot holds a record */
+    size_t capacity;           /**< Power of two, at least twice max_pages */
+    size_t count;              /**< Records in use */
+    size_t max_pages;          /**< Records allowed */
+    uint64_t dropped;          /**< Updates for pages past max_pages */
+} g_sharing = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static inline size_t hash_page(page_id_t page_id, size_t capacity) {
+    return (size_t)((page_id * 0x9E3779B97F4A7C15ULL) >> 32) & (capacity - 1);
+}
+
+/**
+ * Find a page's record, adding it if there is room
+ * Caller holds g_sharing.lock.
+ *
+ * @return Record, or NULL if the profiler is off or full
+ */
+static sharing_page_t *find_page_locked(page_id_t page_id, bool create) {
+    if (!g_sharing.slots) {
+        return NULL;
+    }
+
+    size_t i = hash_page(page_id, g_sharing.capacity);
+    while (g_sharing.used[i]) {
+        if (g_sharing.slots[i].page_id == page_id) {
+            return &g_sharing.slots[i];
+        }
+        i = (i + 1) & (g_sharing.capacity - 1);
+    }
+
+    if (!create) {
+        return NULL;
+    }
+    if (g_sharing.count >= g_sharing.max_pages) {
+        g_sharing.dropped++;
+        return NULL;
+    }
+    g_sharing.used[i] = true;
+    g_sharing.count++;
+    memset(&g_sharing.slots[i], 0, sizeof(sharing_page_t));
+    g_sharing.slots[i].page_id = page_id;
+    return &g_sharing.slots[i];
+}
+
+int sharing_profile_init(int max_pages) {
+    if (max_pages <= 0) {
+        return DSM_ERROR_INVALID;
+    }
+
+    size_t capacity = 1;
+    while (capacity < (size_t)max_pages * 2) {
+        capacity <<= 1;
+    }
+
+    sharing_page_t *slots = calloc(capacity, sizeof(sharing_page_t));
+    bool *used = calloc(capacity, sizeof(bool));
+    if (!slots || !used) {
+        free(slots);
+        free(used);
+        LOG_ERROR("Failed to allocate sharing profile for %d pages", max_pages);
+        return DSM_ERROR_MEMORY;
+    }
+
+    pthread_mutex_lock(&g_sharing.lock);
+    free(g_sharing.slots);
+    free(g_sharing.used);
+    g_sharing.slots = slots;
+    g_sharing.used = used;
+    g_sharing.capacity = capacity;
+    g_sharing.count = 0;
+    g_sharing.max_pages = (size_t)max_pages;
+    g_sharing.dropped = 0;
+    pthread_mutex_unlock(&g_sharing.lock);
+
+    LOG_INFO("Sharing profiler tracking up to %d pages", max_pages);
+    return DSM_SUCCESS;
+}
+
+void sharing_profile_cleanup(void) {
+    pthread_mutex_lock(&g_sharing.lock);
+    if (g_sharing.dropped > 0) {
+        LOG_WARN("Sharing profiler ignored %lu updates past its %zu pages",
+                 g_sharing.dropped, g_sharing.max_pages);
+    }
+    free(g_sharing.slots);
+    free(g_sharing.used);
+    g_sharing.slots = NULL;
+    g_sharing.used = NULL;
+    g_sharing.capacity = 0;
+    g_sharing.count = 0;
+    pthread_mutex_unlock(&g_sharing.lock);
+}
+
+bool sharing_profile_enabled(void) {
+    return __atomic_load_n(&g_sharing.slots, __ATOMIC_RELAXED) != NULL;
+}
+
+void sharing_profile_write(page_id_t page_id, size_t block_size, size_t offset, size_t len) {
+    if (!sharing_profile_enabled() || block_size == 0 || offset >= block_size || len == 0) {
+        return;
+    }
+    if (len > block_size - offset) {
+        len = block_size - offset;
+    }
+
+    size_t cell_size = block_size / SHARING_PROFILE_CELLS;
+    if (cell_size == 0) {
+        cell_size = 1;
+    }
+    size_t first = offset / cell_size;
+    size_t last = (offset + len - 1) / cell_size;
+    if (last >= SHARING_PROFILE_CELLS) {
+        last = SHARING_PROFILE_CELLS - 1;
+    }
+
+    node_id_t self = dsm_get_node_id();
+
+    pthread_mutex_lock(&g_sharing.lock);
+    sharing_page_t *page = find_page_locked(page_id, true);
+    if (page) {
+        page->writes++;
+        page->wrote = true;
+        if (self < 64) {
+            page->writers |= 1ULL << self;
+        }
+        for (size_t c = first; c <= last; c++) {
+            page->cells[c]++;
+        }
+    }
+    pthread_mutex_unlock(&g_sharing.lock);
+}
+
+void sharing_profile_invalidated(page_id_t page_id, node_id_t writer) {
+    if (!sharing_profile_enabled()) {
+        return;
+    }
+
+    bool pingpong = false;
+    pthread_mutex_lock(&g_sharing.lock);
+    sharing_page_t *page = find_page_locked(page_id, true);
+    if (page) {
+        page->invalidations++;
+        if (writer < 64) {
+            page->writers |= 1ULL << writer;
+        }
+        /* We wrote it and another writer took it away */
+        pingpong = page->wrote && writer != dsm_get_node_id();
+        if (pingpong) {
+            page->pingpongs++;
+        }
+        page->wrote = false;
+    }
+    pthread_mutex_unlock(&g_sharing.lock);
+
+    if (pingpong) {
+        perf_log_false_sharing(page_id);
+    }
+}
+
+int sharing_profile_get(page_id_t page_id, sharing_page_t *out) {
+    if (!out) {
+        return DSM_ERROR_INVALID;
+    }
+
+    pthread_mutex_lock(&g_sharing.lock);
+    sharing_page_t *page = find_page_locked(page_id, false);
+    if (page) {
+        *out = *page;
+    }
+    pthread_mutex_unlock(&g_sharing.lock);
+    return page ? DSM_SUCCESS : DSM_ERROR_NOT_FOUND;
+}
+
+/* Most contended first: ping-pongs, then invalidations, then writes */
+static int compare_contention(const void *a, const void *b) {
+    const sharing_page_t *pa = a, *pb = b;
+    if (pa->pingpongs != pb->pingpongs) {
+        return pa->pingpongs < pb->pingpongs ? 1 : -1;
+    }
+    if (pa->invalidations != pb->invalidations) {
+        return pa->invalidations < pb->invalidations ? 1 : -1;
+    }
+    if (pa->writes != pb->writes) {
+        return pa->writes < pb->writes ? 1 : -1;
+    }
+    return pa->page_id < pb->page_id ? -1 : pa->page_id > pb->page_id;
+}
+
+/**
+ * Copy every record, ranked
+ *
+ * @param count Output: records copied
+ * @return Array to free(), or NULL if there are none
+ */
+static sharing_page_t *ranked_pages(size_t *count) {
+    *count = 0;
+    pthread_mutex_lock(&g_sharing.lock);
+    sharing_page_t *pages = g_sharing.count ? malloc(g_sharing.count * sizeof(sharing_page_t)) : NULL;
+    if (pages) {
+        for (size_t i = 0; i < g_sharing.capacity; i++) {
+            if (g_sharing.used[i]) {
+                pages[(*count)++] = g_sharing.slots[i];
+            }
+        }
+    }
+    pthread_mutex_unlock(&g_sharing.lock);
+
+    if (pages) {
+        qsort(pages, *count, sizeof(sharing_page_t), compare_contention);
+    }
+    return pages;
+}
+
+/* Writers as "0;3;5" */
+static void format_writers(uint64_t writers, char *buf, size_t len) {
+    size_t pos = 0;
+    buf[0] = '\0';
+    for (uint64_t w = writers; w && pos + 4 < len; w &= w - 1) {
+        pos += (size_t)snprintf(buf + pos, len - pos, pos ? ";%d" : "%d", __builtin_ctzll(w));
+    }
+}
+
+int sharing_profile_export(const char *path, node_id_t node_id) {
+    if (!path) {
+        return DSM_ERROR_INVALID;
+    }
+    if (!sharing_profile_enabled()) {
+        return DSM_ERROR_INIT;
+    }
+
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        LOG_ERROR("Failed to open sharing profile file: %s", path);
+        return DSM_ERROR_INIT;
+    }
+
+    fprintf(f, "rank,page_id,node_id,writers,num_writers,writes,invalidations,pingpongs");
+    for (int c = 0; c < SHARING_PROFILE_CELLS; c++) {
+        fprintf(f, ",c%d", c);
+    }
+    fprintf(f, "\n");
+
+    size_t count;
+    sharing_page_t *pages = ranked_pages(&count);
+    for (size_t i = 0; i < count; i++) {
+        const sharing_page_t *page = &pages[i];
+        char writers[256];
+        format_writers(page->writers, writers, sizeof(writers));
+        fprintf(f, "%zu,%lu,%u,%s,%d,%u,%u,%u", i + 1, page->page_id, node_id, writers,
+                __builtin_popcountll(page->writers), page->writes, page->invalidations,
+                page->pingpongs);
+        for (int c = 0; c < SHARING_PROFILE_CELLS; c++) {
+            fprintf(f, ",%u", page->cells[c]);
+        }
+        fprintf(f, "\n");
+    }
+    free(pages);
+    fclose(f);
+
+    LOG_INFO("Sharing profile written: %s (%zu pages)", path, count);
+    return (int)count;
+}
+
+void sharing_profile_print(FILE *out, int max_pages) {
+    if (!out || !sharing_profile_enabled()) {
+        return;
+    }
+
+    size_t count;
+    sharing_page_t *pages = ranked_pages(&count);
+    fprintf(out, "\nMost Contended Pages (of %zu profiled):\n", count);
+    fprintf(out, "  %-20s %-12s %9s %9s %9s  %s\n",
+            "page", "writers", "pingpong", "invalid", "writes", "cells written");
+    for (size_t i = 0; i < count && i < (size_t)max_pages; i++) {
+        const sharing_page_t *page = &pages[i];
+        char writers[256];
+        format_writers(page->writers, writers, sizeof(writers));
+
+        /* One character per cell: '.' untouched, '#' written */
+        char cells[SHARING_PROFILE_CELLS + 1];
+        for (int c = 0; c < SHARING_PROFILE_CELLS; c++) {
+            cells[c] = page->cells[c] ? '#' : '.';
+        }
+        cells[SHARING_PROFILE_CELLS] = '\0';
+
+        fprintf(out, "  %-20lu %-12s %9u %9u %9u  %s\n", page->page_id, writers,
+                page->pingpongs, page->invalidations, page->writes, cells);
+    }
+    free(pages);
+}
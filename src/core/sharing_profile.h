@@ -0,0 +1,121 @@
+/**
+ * @file sharing_profile.h
+ * @brief Per-page false-sharing and contention profiler
+ *
+ * Enabled with dsm_config_t.sharing_profile_pages > 0. Each node records,
+ * for up to that many pages, what it can see of the page's writers:
+ *
+ *   - where it writes: the block is split into SHARING_PROFILE_CELLS cells
+ *     (a cache line each for 4 KiB pages). Under sequential consistency
+ *     each write fault counts the cell of the faulting address (under
+ *     userfaultfd the kernel may round it to the page). Under release
+ *     consistency every run of the diffs sent at release counts the
+ *     cells it covers, so ranges are exact
+ *   - which nodes write it: itself, and the writer of every INVALIDATE it
+ *     receives (nodes below 64)
+ *   - how often it loses the page: invalidations, and ping-pongs, the
+ *     invalidations of a page it had written since the previous one. Each
+ *     ping-pong is also reported with perf_log_false_sharing()
+ *
+ * sharing_profile_export() writes the pages ranked by ping-pongs, then
+ * invalidations, to dsm_sharing_node<N>.csv with one column per cell.
+ * Files from all nodes merged by page show which nodes write which cells:
+ * writers on disjoint cells share falsely and can be laid out apart.
+ *
+ * All updates take one lock; the profiler is meant for diagnosis runs.
+ */
+
+#ifndef SHARING_PROFILE_H
+#define SHARING_PROFILE_H
+
+#include "dsm/types.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** Cells a block is split into for write attribution */
+#define SHARING_PROFILE_CELLS 64
+
+/** Pages listed in the console summary */
+#define SHARING_PROFILE_SUMMARY_PAGES 10
+
+/**
+ * Profile of one page as seen by this node
+ */
+typedef struct {
+    page_id_t page_id;
+    uint64_t writers;          /**< Bitmap of writer nodes 0-63 */
+    uint32_t writes;           /**< Write faults (or diff runs) recorded here */
+    uint32_t invalidations;    /**< INVALIDATEs received */
+    uint32_t pingpongs;        /**< Invalidations after a write of ours */
+    bool wrote;                /**< Wrote since the last invalidation */
+    uint32_t cells[SHARING_PROFILE_CELLS]; /**< Writes per cell */
+} sharing_page_t;
+
+/**
+ * Start profiling
+ *
+ * @param max_pages Pages tracked; writes to further pages are not recorded
+ * @return DSM_SUCCESS, DSM_ERROR_INVALID or DSM_ERROR_MEMORY
+ */
+int sharing_profile_init(int max_pages);
+
+/**
+ * Stop profiling and free the records
+ */
+void sharing_profile_cleanup(void);
+
+/**
+ * Check whether the profiler is running
+ */
+bool sharing_profile_enabled(void);
+
+/**
+ * Record a write by this node
+ *
+ * @param page_id Page written
+ * @param block_size Bytes in the page's block
+ * @param offset First byte written, from the start of the block
+ * @param len Bytes written (1 for a sampled fault address)
+ */
+void sharing_profile_write(page_id_t page_id, size_t block_size, size_t offset, size_t len);
+
+/**
+ * Record an invalidation of this node's copy
+ *
+ * @param page_id Page invalidated
+ * @param writer Node whose write invalidated it
+ */
+void sharing_profile_invalidated(page_id_t page_id, node_id_t writer);
+
+/**
+ * Copy the profile of one page
+ *
+ * @param page_id Page ID
+ * @param out Output: profile
+ * @return DSM_SUCCESS, or DSM_ERROR_NOT_FOUND if the page has none
+ */
+int sharing_profile_get(page_id_t page_id, sharing_page_t *out);
+
+/**
+ * Write the ranked profile as CSV
+ *
+ * Header: rank,page_id,node_id,writers,num_writers,writes,invalidations,
+ * pingpongs,c0..c63, where writers lists node IDs separated by ';'.
+ *
+ * @param path File to write
+ * @param node_id This node, written to every row
+ * @return Pages written, or a negative error code
+ */
+int sharing_profile_export(const char *path, node_id_t node_id);
+
+/**
+ * Print the pages that lost ownership most often
+ *
+ * @param out Stream to print to
+ * @param max_pages Most pages to list
+ */
+void sharing_profile_print(FILE *out, int max_pages);
+
+#endif /* SHARING_PROFILE_H */
@@ -0,0 +1,277 @@
+/**
+ * @file stats.c
+ * @brief Lock-free per-thread statistics counters implementation
+ */
+
+#include "stats.h"
+#include <string.h>
+
+/** One thread's counters, padded so threads never share a cache line */
+typedef struct {
+    uint64_t counters[STATS_NUM_COUNTERS];
+} __attribute__((aligned(64))) stats_block_t;
+
+/* Last block is shared by threads beyond STATS_MAX_THREADS */
+static stats_block_t g_blocks[STATS_MAX_THREADS + 1];
+static int g_blocks_claimed = 0;
+
+__thread uint64_t *stats_tls_block = NULL;
+__thread unsigned stats_fault_path = 0;
+
+/**
+ * Fault latency histogram
+ * Shared by all threads: faults take microseconds, so relaxed increments on
+ * a shared bucket are cheap next to them, and per-thread copies would cost
+ * DSM_FAULT_PATH_COUNT * DSM_LATENCY_BUCKETS * 8 bytes per thread.
+ */
+typedef struct {
+    uint64_t total_ns;
+    uint64_t min_ns;                   /**< 0 until the first fault */
+    uint64_t max_ns;
+    uint64_t buckets[DSM_LATENCY_BUCKETS];
+} __attribute__((aligned(64))) latency_hist_t;
+
+static latency_hist_t g_hist[DSM_FAULT_PATH_COUNT];
+
+/** Short names for the fault path histograms, indexed by dsm_fault_path_t */
+static const char *const fault_path_names[DSM_FAULT_PATH_COUNT] = {
+    "all", "read", "write", "local_upgrade", "remote_fetch",
+    "queued", "leader", "forwarded", "direct"
+};
+
+/**
+ * Per-peer traffic
+ * Updated once per frame by the threads that write and read sockets, so
+ * shared relaxed counters suffice; each peer gets its own cache line.
+ */
+typedef struct {
+    dsm_peer_stats_t counts;
+} __attribute__((aligned(64))) peer_stats_t;
+
+static peer_stats_t g_peers[DSM_MAX_PEER_STATS];
+
+uint64_t* stats_claim_block(void) {
+    /* Blocks are never released: counts of exited threads must stay in the totals */
+    int index = __atomic_fetch_add(&g_blocks_claimed, 1, __ATOMIC_RELAXED);
+    if (index > STATS_MAX_THREADS) {
+        index = STATS_MAX_THREADS;
+    }
+    stats_tls_block = g_blocks[index].counters;
+    return stats_tls_block;
+}
+
+/** Number of blocks that may hold counts */
+static int blocks_in_use(void) {
+    int claimed = __atomic_load_n(&g_blocks_claimed, __ATOMIC_RELAXED);
+    return claimed > STATS_MAX_THREADS ? STATS_MAX_THREADS + 1 : claimed;
+}
+
+void stats_record_fault_latency(uint64_t latency_ns) {
+    uint64_t *block = stats_tls_block;
+    if (!block) {
+        block = stats_claim_block();
+    }
+
+    __atomic_fetch_add(&block[STATS_INDEX(total_fault_latency_ns)], latency_ns, __ATOMIC_RELAXED);
+
+    /* CAS loops only matter for the shared overflow block */
+    uint64_t *max = &block[STATS_INDEX(max_fault_latency_ns)];
+    uint64_t cur = __atomic_load_n(max, __ATOMIC_RELAXED);
+    while (latency_ns > cur &&
+           !__atomic_compare_exchange_n(max, &cur, latency_ns, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+
+    /* 0 means no fault recorded yet */
+    uint64_t *min = &block[STATS_INDEX(min_fault_latency_ns)];
+    cur = __atomic_load_n(min, __ATOMIC_RELAXED);
+    while ((cur == 0 || latency_ns < cur) &&
+           !__atomic_compare_exchange_n(min, &cur, latency_ns, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static int latency_bucket(uint64_t ns) {
+    const int sub = 1 << DSM_LATENCY_SUB_BITS;
+    if (ns < (uint64_t)sub) {
+        return (int)ns;
+    }
+    int exp = 63 - __builtin_clzll(ns);
+    int index = (exp - DSM_LATENCY_SUB_BITS + 1) * sub +
+                (int)((ns >> (exp - DSM_LATENCY_SUB_BITS)) & (uint64_t)(sub - 1));
+    return index < DSM_LATENCY_BUCKETS ? index : DSM_LATENCY_BUCKETS - 1;
+}
+
+/** First latency past bucket index (its exclusive upper edge) */
+static uint64_t bucket_end(int index) {
+    const int sub = 1 << DSM_LATENCY_SUB_BITS;
+    index++;
+    if (index < sub) {
+        return (uint64_t)index;
+    }
+    return (uint64_t)(sub + index % sub) << (index / sub - 1);
+}
+
+static void update_max(uint64_t *slot, uint64_t v) {
+    uint64_t cur = __atomic_load_n(slot, __ATOMIC_RELAXED);
+    while (v > cur &&
+           !__atomic_compare_exchange_n(slot, &cur, v, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static void update_min(uint64_t *slot, uint64_t v) {
+    uint64_t cur = __atomic_load_n(slot, __ATOMIC_RELAXED);
+    while ((cur == 0 || v < cur) &&
+           !__atomic_compare_exchange_n(slot, &cur, v, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static void hist_record(dsm_fault_path_t path, int bucket, uint64_t latency_ns) {
+    latency_hist_t *h = &g_hist[path];
+    __atomic_fetch_add(&h->buckets[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->total_ns, latency_ns, __ATOMIC_RELAXED);
+    update_max(&h->max_ns, latency_ns);
+    update_min(&h->min_ns, latency_ns);
+}
+
+void stats_record_fault_histogram(bool is_write, unsigned path, uint64_t latency_ns) {
+    int bucket = latency_bucket(latency_ns);
+
+    hist_record(DSM_FAULT_PATH_ALL, bucket, latency_ns);
+    hist_record(is_write ? DSM_FAULT_PATH_WRITE : DSM_FAULT_PATH_READ, bucket, latency_ns);
+
+    if (!(path & STATS_PATH_REMOTE)) {
+        hist_record(DSM_FAULT_PATH_LOCAL_UPGRADE, bucket, latency_ns);
+        return;
+    }
+    hist_record(DSM_FAULT_PATH_REMOTE_FETCH, bucket, latency_ns);
+    hist_record((path & STATS_PATH_QUEUED) ? DSM_FAULT_PATH_QUEUED : DSM_FAULT_PATH_LEADER,
+                bucket, latency_ns);
+    hist_record((path & STATS_PATH_FORWARDED) ? DSM_FAULT_PATH_FORWARDED : DSM_FAULT_PATH_DIRECT,
+                bucket, latency_ns);
+}
+
+/** Upper edge of the bucket holding the rank-th smallest latency (1-based) */
+static uint64_t hist_value_at_rank(const dsm_latency_histogram_t *h, uint64_t rank) {
+    uint64_t seen = 0;
+    for (int i = 0; i < DSM_LATENCY_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            uint64_t edge = bucket_end(i) - 1;
+            return edge < h->max_ns ? edge : h->max_ns;
+        }
+    }
+    return h->max_ns;
+}
+
+/** Latency at or below which per_mille / 1000 of the faults fall */
+static uint64_t hist_percentile(const dsm_latency_histogram_t *h, uint64_t per_mille) {
+    if (h->count == 0) {
+        return 0;
+    }
+    uint64_t rank = (h->count * per_mille + 999) / 1000;
+    return hist_value_at_rank(h, rank ? rank : 1);
+}
+
+const char *stats_fault_path_name(dsm_fault_path_t path) {
+    return (unsigned)path < DSM_FAULT_PATH_COUNT ? fault_path_names[path] : "unknown";
+}
+
+void stats_collect_histogram(dsm_fault_path_t path, dsm_latency_histogram_t *out) {
+    memset(out, 0, sizeof(*out));
+    if ((unsigned)path >= DSM_FAULT_PATH_COUNT) {
+        return;
+    }
+
+    const latency_hist_t *h = &g_hist[path];
+    for (int i = 0; i < DSM_LATENCY_BUCKETS; i++) {
+        out->buckets[i] = __atomic_load_n(&h->buckets[i], __ATOMIC_RELAXED);
+        out->count += out->buckets[i];
+    }
+    out->total_ns = __atomic_load_n(&h->total_ns, __ATOMIC_RELAXED);
+    out->min_ns = __atomic_load_n(&h->min_ns, __ATOMIC_RELAXED);
+    out->max_ns = __atomic_load_n(&h->max_ns, __ATOMIC_RELAXED);
+
+    out->p50_ns = hist_percentile(out, 500);
+    out->p90_ns = hist_percentile(out, 900);
+    out->p99_ns = hist_percentile(out, 990);
+    out->p999_ns = hist_percentile(out, 999);
+}
+
+void stats_peer_sent(node_id_t peer, uint64_t frames, uint64_t bytes) {
+    if (peer >= DSM_MAX_PEER_STATS) {
+        return;
+    }
+    __atomic_fetch_add(&g_peers[peer].counts.frames_sent, frames, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&g_peers[peer].counts.bytes_sent, bytes, __ATOMIC_RELAXED);
+}
+
+void stats_peer_received(node_id_t peer, uint64_t bytes) {
+    if (peer >= DSM_MAX_PEER_STATS) {
+        return;
+    }
+    __atomic_fetch_add(&g_peers[peer].counts.frames_received, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&g_peers[peer].counts.bytes_received, bytes, __ATOMIC_RELAXED);
+}
+
+void stats_collect_peer(node_id_t peer, dsm_peer_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    if (peer >= DSM_MAX_PEER_STATS) {
+        return;
+    }
+    const dsm_peer_stats_t *c = &g_peers[peer].counts;
+    out->frames_sent = __atomic_load_n(&c->frames_sent, __ATOMIC_RELAXED);
+    out->bytes_sent = __atomic_load_n(&c->bytes_sent, __ATOMIC_RELAXED);
+    out->frames_received = __atomic_load_n(&c->frames_received, __ATOMIC_RELAXED);
+    out->bytes_received = __atomic_load_n(&c->bytes_received, __ATOMIC_RELAXED);
+}
+
+void stats_collect(dsm_stats_t *out) {
+    uint64_t sum[STATS_NUM_COUNTERS] = {0};
+    const size_t max_index = STATS_INDEX(max_fault_latency_ns);
+    const size_t min_index = STATS_INDEX(min_fault_latency_ns);
+
+    int n = blocks_in_use();
+    for (int b = 0; b < n; b++) {
+        for (size_t i = 0; i < STATS_NUM_COUNTERS; i++) {
+            uint64_t v = __atomic_load_n(&g_blocks[b].counters[i], __ATOMIC_RELAXED);
+            if (i == max_index) {
+                if (v > sum[i]) sum[i] = v;
+            } else if (i == min_index) {
+                if (v != 0 && (sum[i] == 0 || v < sum[i])) sum[i] = v;
+            } else {
+                sum[i] += v;
+            }
+        }
+    }
+
+    _Static_assert(sizeof(dsm_stats_t) == sizeof(sum), "dsm_stats_t must only hold uint64_t counters");
+    memcpy(out, sum, sizeof(sum));
+}
+
+void stats_reset(void) {
+    int n = blocks_in_use();
+    for (int b = 0; b < n; b++) {
+        for (size_t i = 0; i < STATS_NUM_COUNTERS; i++) {
+            __atomic_store_n(&g_blocks[b].counters[i], 0, __ATOMIC_RELAXED);
+        }
+    }
+
+    for (int p = 0; p < DSM_FAULT_PATH_COUNT; p++) {
+        latency_hist_t *h = &g_hist[p];
+        for (int i = 0; i < DSM_LATENCY_BUCKETS; i++) {
+            __atomic_store_n(&h->buckets[i], 0, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&h->total_ns, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&h->min_ns, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&h->max_ns, 0, __ATOMIC_RELAXED);
+    }
+
+    for (int p = 0; p < DSM_MAX_PEER_STATS; p++) {
+        dsm_peer_stats_t *c = &g_peers[p].counts;
+        __atomic_store_n(&c->frames_sent, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&c->bytes_sent, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&c->frames_received, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&c->bytes_received, 0, __ATOMIC_RELAXED);
+    }
+}
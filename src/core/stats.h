@@ -0,0 +1,127 @@
+/**
+ * @file stats.h
+ * @brief Lock-free per-thread statistics counters
+ *
+ * Every thread increments its own cache-line aligned copy of dsm_stats_t
+ * with relaxed atomics, so counting costs a few nanoseconds, takes no
+ * lock and is safe from the SIGSEGV handler. Readers sum all copies.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include "dsm/types.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/** Threads with a private counter block; later threads share one extra block */
+#define STATS_MAX_THREADS 256
+
+/** Number of uint64_t counters in dsm_stats_t */
+#define STATS_NUM_COUNTERS (sizeof(dsm_stats_t) / sizeof(uint64_t))
+
+/** Index of a dsm_stats_t field in a counter block */
+#define STATS_INDEX(field) (offsetof(dsm_stats_t, field) / sizeof(uint64_t))
+
+/** Add n to a dsm_stats_t field for the calling thread */
+#define STATS_ADD(field, n) stats_add(STATS_INDEX(field), (uint64_t)(n))
+
+/** Increment a dsm_stats_t field for the calling thread */
+#define STATS_INC(field) stats_add(STATS_INDEX(field), 1)
+
+/** Claim the calling thread's counter block (first use only) */
+uint64_t* stats_claim_block(void);
+
+/** Calling thread's counter block, NULL until its first update */
+extern __thread uint64_t *stats_tls_block;
+
+static inline void stats_add(size_t index, uint64_t n) {
+    uint64_t *block = stats_tls_block;
+    if (!block) {
+        block = stats_claim_block();
+    }
+    __atomic_fetch_add(&block[index], n, __ATOMIC_RELAXED);
+}
+
+/**
+ * Record one page fault's handling latency
+ * Updates total, max and min fault latency
+ *
+ * @param latency_ns Latency in nanoseconds
+ */
+void stats_record_fault_latency(uint64_t latency_ns);
+
+/* Fault path bits noted by the fetch code for the current fault */
+#define STATS_PATH_REMOTE    0x1   /**< Page came from another node */
+#define STATS_PATH_QUEUED    0x2   /**< Waited on another thread's fetch */
+#define STATS_PATH_FORWARDED 0x4   /**< Request routed through the manager */
+
+/**
+ * Path taken by the calling thread's current fault (STATS_PATH_* bits)
+ * The fault handler clears it before handling; 0 means local upgrade.
+ */
+extern __thread unsigned stats_fault_path;
+
+/**
+ * Record a fault's latency in the histograms of every path it took
+ *
+ * @param is_write True for write faults
+ * @param path STATS_PATH_* bits for the fault
+ * @param latency_ns Latency in nanoseconds
+ */
+void stats_record_fault_histogram(bool is_write, unsigned path, uint64_t latency_ns);
+
+/**
+ * Short name of a fault path ("all", "read", "remote_fetch", ...)
+ */
+const char *stats_fault_path_name(dsm_fault_path_t path);
+
+/**
+ * Snapshot one fault path's histogram and compute its percentiles
+ *
+ * @param path Fault path
+ * @param out Output histogram
+ */
+void stats_collect_histogram(dsm_fault_path_t path, dsm_latency_histogram_t *out);
+
+/**
+ * Count frames written to a peer
+ *
+ * @param peer Destination (ignored from DSM_MAX_PEER_STATS up)
+ * @param frames Frames written in one go
+ * @param bytes Bytes written
+ */
+void stats_peer_sent(node_id_t peer, uint64_t frames, uint64_t bytes);
+
+/**
+ * Count a frame read from a peer
+ *
+ * @param peer Sender (ignored from DSM_MAX_PEER_STATS up)
+ * @param bytes Bytes of the frame
+ */
+void stats_peer_received(node_id_t peer, uint64_t bytes);
+
+/**
+ * Snapshot one peer's traffic counters
+ *
+ * @param peer Peer node ID, below DSM_MAX_PEER_STATS
+ * @param out Output counters
+ */
+void stats_collect_peer(node_id_t peer, dsm_peer_stats_t *out);
+
+/**
+ * Sum all threads' counters
+ *
+ * Counters are read with relaxed loads, so a snapshot taken while other
+ * threads are counting may be a few events behind.
+ *
+ * @param out Output statistics
+ */
+void stats_collect(dsm_stats_t *out);
+
+/**
+ * Zero all threads' counters, the latency histograms and the peer counters
+ */
+void stats_reset(void);
+
+#endif /* STATS_H */
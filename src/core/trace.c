@@ -0,0 +1,357 @@
+/**
+ * @file trace.c
+ * @brief Binary event trace recorder implementation
+ */
+
+#include "trace.h"
+#include "log.h"
+#include "perf_log.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#define TRACE_RING_MASK (TRACE_RING_RECORDS - 1)
+
+/**
+ * Single-producer single-consumer ring
+ *
+ * The owning thread advances head, the drain thread advances tail. Rings
+ * are mmap()ed (async-signal-safe) on a thread's first event and are never
+ * unmapped, so a producer racing trace_stop() can never touch freed memory;
+ * a ring whose thread exited is reused by the next new thread.
+ */
+typedef struct trace_ring_s {
+    uint64_t head __attribute__((aligned(64)));
+    uint64_t tail __attribute__((aligned(64)));
+    uint64_t dropped;
+    int in_use;                        /**< Claimed by a live thread */
+    struct trace_ring_s *next;         /**< Registry link (push-only) */
+    trace_record_t records[TRACE_RING_RECORDS];
+} trace_ring_t;
+
+int trace_active = 0;
+
+static struct {
+    trace_ring_t *rings;               /**< All rings ever created */
+    pthread_mutex_t lock;              /**< Serializes start/stop and draining */
+    pthread_cond_t wake;
+    pthread_t drain_thread;
+    bool running;
+    FILE *file;
+    pthread_key_t ring_key;            /**< Releases a ring when its thread exits */
+    pthread_once_t key_once;
+} g_trace = {
+    .rings = NULL,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .running = false,
+    .file = NULL,
+    .key_once = PTHREAD_ONCE_INIT
+};
+
+static __thread trace_ring_t *tls_ring = NULL;
+
+static void ring_release(void *arg) {
+    trace_ring_t *ring = (trace_ring_t *)arg;
+    __atomic_store_n(&ring->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void create_ring_key(void) {
+    pthread_key_create(&g_trace.ring_key, ring_release);
+}
+
+static trace_ring_t* ring_claim(void) {
+    /* Reuse a ring left behind by an exited thread */
+    trace_ring_t *ring = __atomic_load_n(&g_trace.rings, __ATOMIC_ACQUIRE);
+    for (; ring; ring = ring->next) {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&ring->in_use, &expected, 1, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    if (!ring) {
+        void *mem = mmap(NULL, sizeof(trace_ring_t), PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            return NULL;
+        }
+        ring = (trace_ring_t *)mem;
+        ring->in_use = 1;
+
+        trace_ring_t *head = __atomic_load_n(&g_trace.rings, __ATOMIC_RELAXED);
+        do {
+            ring->next = head;
+        } while (!__atomic_compare_exchange_n(&g_trace.rings, &head, ring, true,
+                                              __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+
+    pthread_setspecific(g_trace.ring_key, ring);
+    tls_ring = ring;
+    return ring;
+}
+
+void trace_record(trace_event_t type, uint64_t id, uint8_t access,
+                  uint64_t latency_ns, uint8_t flags, uint32_t node) {
+    trace_ring_t *ring = tls_ring;
+    if (!ring && !(ring = ring_claim())) {
+        return;
+    }
+
+    uint64_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= TRACE_RING_RECORDS) {
+        __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    trace_record_t *rec = &ring->records[head & TRACE_RING_MASK];
+    rec->timestamp_ns = perf_get_timestamp_ns();
+    rec->id = id;
+    rec->latency_ns = latency_ns;
+    rec->type = (uint16_t)type;
+    rec->access = access;
+    rec->flags = flags;
+    rec->node = node;
+
+    /* Publish the record to the drain thread */
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/** Move every ring's pending records to the file (g_trace.lock held) */
+static void drain_rings(void) {
+    trace_ring_t *ring = __atomic_load_n(&g_trace.rings, __ATOMIC_ACQUIRE);
+    for (; ring; ring = ring->next) {
+        uint64_t tail = ring->tail;
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+        while (tail != head) {
+            /* Write up to the end of the ring, then wrap */
+            uint64_t start = tail & TRACE_RING_MASK;
+            uint64_t n = head - tail;
+            if (n > TRACE_RING_RECORDS - start) {
+                n = TRACE_RING_RECORDS - start;
+            }
+            if (g_trace.file) {
+                fwrite(&ring->records[start], sizeof(trace_record_t), n, g_trace.file);
+            }
+            tail += n;
+        }
+
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+}
+
+static void* drain_thread(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&g_trace.lock);
+    while (g_trace.running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += TRACE_DRAIN_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&g_trace.wake, &g_trace.lock, &deadline);
+        drain_rings();
+    }
+    pthread_mutex_unlock(&g_trace.lock);
+    return NULL;
+}
+
+int trace_start(const char *path, node_id_t node_id) {
+    if (!path) {
+        return DSM_ERROR_INVALID;
+    }
+
+    pthread_once(&g_trace.key_once, create_ring_key);
+
+    pthread_mutex_lock(&g_trace.lock);
+
+    if (g_trace.running) {
+        pthread_mutex_unlock(&g_trace.lock);
+        LOG_WARN("Trace already running");
+        return DSM_SUCCESS;
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        pthread_mutex_unlock(&g_trace.lock);
+        LOG_ERROR("Failed to open trace file %s: %s", path, strerror(errno));
+        return DSM_ERROR_INIT;
+    }
+
+    trace_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_FILE_VERSION;
+    header.record_size = sizeof(trace_record_t);
+    header.node_id = node_id;
+    fwrite(&header, sizeof(header), 1, file);
+
+    /* Discard events left over from an earlier trace */
+    g_trace.file = NULL;
+    drain_rings();
+
+    g_trace.file = file;
+    g_trace.running = true;
+    if (pthread_create(&g_trace.drain_thread, NULL, drain_thread, NULL) != 0) {
+        g_trace.running = false;
+        g_trace.file = NULL;
+        pthread_mutex_unlock(&g_trace.lock);
+        fclose(file);
+        LOG_ERROR("Failed to create trace drain thread");
+        return DSM_ERROR_INIT;
+    }
+
+    __atomic_store_n(&trace_active, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&g_trace.lock);
+
+    LOG_INFO("Binary trace recording to %s", path);
+    return DSM_SUCCESS;
+}
+
+void trace_stop(void) {
+    pthread_mutex_lock(&g_trace.lock);
+    if (!g_trace.running) {
+        pthread_mutex_unlock(&g_trace.lock);
+        return;
+    }
+
+    __atomic_store_n(&trace_active, 0, __ATOMIC_RELEASE);
+    g_trace.running = false;
+    pthread_cond_signal(&g_trace.wake);
+    pthread_mutex_unlock(&g_trace.lock);
+
+    pthread_join(g_trace.drain_thread, NULL);
+
+    /* Final drain; events racing the flag above may still land in a later trace's discard */
+    pthread_mutex_lock(&g_trace.lock);
+    drain_rings();
+    fclose(g_trace.file);
+    g_trace.file = NULL;
+    pthread_mutex_unlock(&g_trace.lock);
+
+    uint64_t dropped = trace_dropped();
+    if (dropped > 0) {
+        LOG_WARN("Trace dropped %lu events (ring full)", dropped);
+    }
+}
+
+uint64_t trace_dropped(void) {
+    uint64_t dropped = 0;
+    trace_ring_t *ring = __atomic_load_n(&g_trace.rings, __ATOMIC_ACQUIRE);
+    for (; ring; ring = ring->next) {
+        dropped += __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+    }
+    return dropped;
+}
+
+/* ============================ */
+/*       CSV Conversion         */
+/* ============================ */
+
+static const char* event_name(uint16_t type) {
+    switch (type) {
+        case TRACE_PAGE_FAULT:    return "PAGE_FAULT";
+        case TRACE_FALSE_SHARING: return "FALSE_SHARING";
+        case TRACE_PAGE_REQUEST:  return "PAGE_REQUEST";
+        case TRACE_PAGE_REPLY:    return "PAGE_REPLY";
+        case TRACE_INVALIDATE:    return "INVALIDATE";
+        case TRACE_LOCK_ACQUIRE:  return "LOCK_ACQUIRE";
+        case TRACE_LOCK_RELEASE:  return "LOCK_RELEASE";
+        case TRACE_BARRIER:       return "BARRIER";
+        default:                  return "UNKNOWN";
+    }
+}
+
+static const char* access_name(uint8_t access) {
+    switch (access) {
+        case ACCESS_READ:  return "READ";
+        case ACCESS_WRITE: return "WRITE";
+        default:           return "NA";
+    }
+}
+
+static int compare_records(const void *a, const void *b) {
+    uint64_t ta = ((const trace_record_t *)a)->timestamp_ns;
+    uint64_t tb = ((const trace_record_t *)b)->timestamp_ns;
+    return (ta > tb) - (ta < tb);
+}
+
+int trace_convert_csv(const char *trace_path, const char *csv_path) {
+    if (!trace_path || !csv_path) {
+        return DSM_ERROR_INVALID;
+    }
+
+    FILE *in = fopen(trace_path, "rb");
+    if (!in) {
+        LOG_ERROR("Failed to open trace file %s: %s", trace_path, strerror(errno));
+        return DSM_ERROR_NOT_FOUND;
+    }
+
+    trace_file_header_t header;
+    if (fread(&header, sizeof(header), 1, in) != 1 ||
+        memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != TRACE_FILE_VERSION ||
+        header.record_size != sizeof(trace_record_t)) {
+        fclose(in);
+        LOG_ERROR("%s is not a version %d DSM trace", trace_path, TRACE_FILE_VERSION);
+        return DSM_ERROR_INVALID;
+    }
+
+    /* Rings are drained in per-thread batches; load everything and sort */
+    size_t capacity = 4096, count = 0;
+    trace_record_t *records = malloc(capacity * sizeof(trace_record_t));
+    while (records) {
+        if (count == capacity) {
+            trace_record_t *grown = realloc(records, 2 * capacity * sizeof(trace_record_t));
+            if (!grown) {
+                free(records);
+                records = NULL;
+                break;
+            }
+            records = grown;
+            capacity *= 2;
+        }
+        size_t n = fread(&records[count], sizeof(trace_record_t), capacity - count, in);
+        if (n == 0) {
+            break;
+        }
+        count += n;
+    }
+    fclose(in);
+
+    if (!records) {
+        LOG_ERROR("Out of memory reading trace %s", trace_path);
+        return DSM_ERROR_MEMORY;
+    }
+
+    qsort(records, count, sizeof(trace_record_t), compare_records);
+
+    FILE *out = fopen(csv_path, "w");
+    if (!out) {
+        free(records);
+        LOG_ERROR("Failed to create %s: %s", csv_path, strerror(errno));
+        return DSM_ERROR_INIT;
+    }
+
+    fprintf(out, "timestamp_ns,event_type,page_id,access_type,latency_ns,was_queued\n");
+    for (size_t i = 0; i < count; i++) {
+        const trace_record_t *rec = &records[i];
+        fprintf(out, "%lu,%s,%lu,%s,%lu,%d\n",
+                rec->timestamp_ns, event_name(rec->type), rec->id,
+                access_name(rec->access), rec->latency_ns,
+                (rec->flags & TRACE_FLAG_QUEUED) ? 1 : 0);
+    }
+    fclose(out);
+    free(records);
+
+    return (int)count;
+}
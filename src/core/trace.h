@@ -0,0 +1,134 @@
+/**
+ * @file trace.h
+ * @brief Binary event trace recorder
+ *
+ * Events are written as fixed-size binary records into a per-thread
+ * single-producer ring buffer with no lock and no system call, so the
+ * recorder is cheap enough to leave on and safe to use from the SIGSEGV
+ * handler. A background thread drains all rings into a compact trace file,
+ * which trace_convert_csv() turns into the perf_log.csv format read by the
+ * visualizer.
+ *
+ * Trace file layout: trace_file_header_t followed by trace_record_t records
+ * in per-thread batches (not globally time ordered).
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "dsm/types.h"
+#include <stdint.h>
+
+/** Records per thread ring (power of two); events are dropped when full */
+#define TRACE_RING_RECORDS 4096
+
+/** Drain thread wakeup interval */
+#define TRACE_DRAIN_MS 50
+
+/** Trace file magic ("DSMTRACE") and format version */
+#define TRACE_FILE_MAGIC "DSMTRACE"
+#define TRACE_FILE_VERSION 1
+
+/** Traced event types */
+typedef enum {
+    TRACE_PAGE_FAULT = 1,     /**< Fault handled (latency = handling time) */
+    TRACE_FALSE_SHARING,      /**< Potential false sharing detected */
+    TRACE_PAGE_REQUEST,       /**< PAGE_REQUEST sent (node = destination) */
+    TRACE_PAGE_REPLY,         /**< PAGE_REPLY received (node = sender) */
+    TRACE_INVALIDATE,         /**< INVALIDATE received (node = sender) */
+    TRACE_LOCK_ACQUIRE,       /**< Lock acquired (latency = wait time) */
+    TRACE_LOCK_RELEASE,       /**< Lock released */
+    TRACE_BARRIER             /**< Barrier passed (latency = wait time) */
+} trace_event_t;
+
+/** trace_record_t.access for events without an access type */
+#define TRACE_ACCESS_NONE 0xFF
+
+/** trace_record_t.flags: the request was queued behind another thread */
+#define TRACE_FLAG_QUEUED 0x1
+
+/** trace_record_t.node when no peer applies */
+#define TRACE_NODE_NONE UINT32_MAX
+
+/**
+ * One trace event (32 bytes on disk)
+ */
+typedef struct {
+    uint64_t timestamp_ns;     /**< perf_get_timestamp_ns() at the event */
+    uint64_t id;               /**< Page, lock or barrier ID */
+    uint64_t latency_ns;       /**< Event latency, 0 if not measured */
+    uint16_t type;             /**< trace_event_t */
+    uint8_t access;            /**< access_type_t or TRACE_ACCESS_NONE */
+    uint8_t flags;             /**< TRACE_FLAG_* */
+    uint32_t node;             /**< Peer node or TRACE_NODE_NONE */
+} __attribute__((packed)) trace_record_t;
+
+/**
+ * Trace file header
+ */
+typedef struct {
+    char magic[8];             /**< TRACE_FILE_MAGIC (not NUL terminated) */
+    uint32_t version;          /**< TRACE_FILE_VERSION */
+    uint32_t record_size;      /**< sizeof(trace_record_t) */
+    uint32_t node_id;          /**< Node that wrote the trace */
+    uint32_t reserved;
+} __attribute__((packed)) trace_file_header_t;
+
+/** Nonzero while a trace is being recorded; checked before every event */
+extern int trace_active;
+
+/**
+ * Start recording to a trace file and start the drain thread
+ *
+ * @param path Trace file to create
+ * @param node_id Node ID stored in the file header
+ * @return DSM_SUCCESS on success, error code on failure
+ */
+int trace_start(const char *path, node_id_t node_id);
+
+/**
+ * Stop recording, drain all rings and close the trace file
+ */
+void trace_stop(void);
+
+/**
+ * Record an event (out-of-line part of trace_event())
+ */
+void trace_record(trace_event_t type, uint64_t id, uint8_t access,
+                  uint64_t latency_ns, uint8_t flags, uint32_t node);
+
+/**
+ * Record an event if tracing is active
+ *
+ * @param type Event type
+ * @param id Page, lock or barrier ID
+ * @param access access_type_t or TRACE_ACCESS_NONE
+ * @param latency_ns Latency in nanoseconds (0 if not measured)
+ * @param flags TRACE_FLAG_* bits
+ * @param node Peer node or TRACE_NODE_NONE
+ */
+static inline void trace_event(trace_event_t type, uint64_t id, uint8_t access,
+                               uint64_t latency_ns, uint8_t flags, uint32_t node) {
+    if (__atomic_load_n(&trace_active, __ATOMIC_RELAXED)) {
+        trace_record(type, id, access, latency_ns, flags, node);
+    }
+}
+
+/**
+ * Number of events dropped because a ring was full
+ */
+uint64_t trace_dropped(void);
+
+/**
+ * Convert a trace file to CSV
+ *
+ * Writes timestamp_ns,event_type,page_id,access_type,latency_ns,was_queued
+ * rows sorted by timestamp, the format of the perf_log.csv event log.
+ *
+ * @param trace_path Trace file written by trace_start()
+ * @param csv_path CSV file to create
+ * @return Number of records converted, or negative error code
+ */
+int trace_convert_csv(const char *trace_path, const char *csv_path);
+
+#endif /* TRACE_H */
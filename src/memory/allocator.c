@@ -7,6 +7,8 @@
 #include "../core/dsm_context.h"
 #include "../core/log.h"
 #include "page_table.h"
+#include "page_index.h"
+#include "userfault.h"
 #include "../consistency/page_migration.h"
 #include "../consistency/directory.h"
 #include "../network/handlers.h"
@@ -16,6 +18,50 @@
 #include <unistd.h>
 
 void* dsm_malloc(size_t size) {
+    return dsm_malloc_attr(size, NULL);
+}
+
+void* dsm_malloc_ex(size_t size, dsm_compression_t compression, size_t block_size) {
+    dsm_alloc_attr_t attr;
+    dsm_alloc_attr_init(&attr);
+    attr.compression = compression;
+    attr.block_size = block_size;
+    return dsm_malloc_attr(size, &attr);
+}
+
+void dsm_alloc_attr_init(dsm_alloc_attr_t *attr) {
+    if (!attr) {
+        return;
+    }
+    dsm_context_t *ctx = dsm_get_context();
+    attr->compression = ctx->config.compression;
+    attr->block_size = PAGE_SIZE;
+    attr->placement = DSM_PLACEMENT_LOCAL;
+    attr->home_node = ctx->node_id;
+}
+
+/**
+ * Map an allocation's region with no access
+ * Huge-page blocks try MAP_HUGETLB first and fall back to normal pages,
+ * which behave the same apart from TLB reach.
+ */
+static void* map_region(size_t size, size_t block_size) {
+#ifdef MAP_HUGETLB
+    if (block_size == DSM_MAX_BLOCK_SIZE) {
+        void *addr = mmap(NULL, size, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (addr != MAP_FAILED) {
+            return addr;
+        }
+        LOG_DEBUG("No huge pages for %zu bytes, using normal pages", size);
+    }
+#else
+    (void)block_size;
+#endif
+    return mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+}
+
+void* dsm_malloc_attr(size_t size, const dsm_alloc_attr_t *attr_in) {
     if (size == 0) {
         LOG_ERROR("dsm_malloc: size is 0");
         return NULL;
@@ -27,40 +73,82 @@ void* dsm_malloc(size_t size) {
         return NULL;
     }
 
-    /* Round up to page boundary */
-    size_t aligned_size = ((size + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
-    size_t num_pages = aligned_size / PAGE_SIZE;
+    dsm_alloc_attr_t attr;
+    if (attr_in) {
+        attr = *attr_in;
+    } else {
+        dsm_alloc_attr_init(&attr);
+    }
+
+    if ((unsigned)attr.compression > DSM_COMPRESSION_LZ) {
+        LOG_ERROR("dsm_malloc: invalid compression mode %d", attr.compression);
+        return NULL;
+    }
+
+    if (attr.block_size == 0) {
+        attr.block_size = PAGE_SIZE;
+    }
+    if (!page_block_size_valid(attr.block_size)) {
+        LOG_ERROR("dsm_malloc: invalid block size %zu (power-of-two multiple of %d up to %d)",
+                  attr.block_size, PAGE_SIZE, DSM_MAX_BLOCK_SIZE);
+        return NULL;
+    }
 
-    LOG_INFO("dsm_malloc: size=%zu, aligned=%zu, pages=%zu",
-             size, aligned_size, num_pages);
+    if ((unsigned)attr.placement > DSM_PLACEMENT_HOME) {
+        LOG_ERROR("dsm_malloc: invalid placement %d", attr.placement);
+        return NULL;
+    }
+    if (attr.placement == DSM_PLACEMENT_HOME) {
+        if (attr.home_node >= (node_id_t)ctx->config.num_nodes) {
+            LOG_ERROR("dsm_malloc: home node %u outside the %d-node cluster",
+                      attr.home_node, ctx->config.num_nodes);
+            return NULL;
+        }
+    } else {
+        attr.home_node = ctx->node_id;  /* Placement base of the other policies */
+    }
+    size_t block_size = attr.block_size;
+
+    /* Round up to block boundary */
+    size_t aligned_size = ((size + block_size - 1) / block_size) * block_size;
+    size_t num_pages = aligned_size / block_size;
+
+    LOG_INFO("dsm_malloc: size=%zu, aligned=%zu, pages=%zu of %zu bytes",
+             size, aligned_size, num_pages, block_size);
 
     /* Allocate using mmap with PROT_NONE (no access initially) */
-    void *addr = mmap(NULL, aligned_size, PROT_NONE,
-                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    void *addr = map_region(aligned_size, block_size);
     if (addr == MAP_FAILED) {
         LOG_ERROR("mmap failed for size %zu", aligned_size);
         return NULL;
     }
+    if (userfault_register(addr, aligned_size) != DSM_SUCCESS) {
+        munmap(addr, aligned_size);
+        return NULL;
+    }
 
     /* Create page table for this allocation */
     pthread_mutex_lock(&ctx->lock);
 
-    if (ctx->num_allocations >= 32) {
+    if (dsm_reserve_page_table_slot() != DSM_SUCCESS) {
         pthread_mutex_unlock(&ctx->lock);
         munmap(addr, aligned_size);
-        LOG_ERROR("Maximum number of allocations (32) exceeded");
+        LOG_ERROR("Failed to grow page table list (%d allocations)", ctx->num_allocations);
         return NULL;
     }
 
     /* CRITICAL FIX: Use num_local_allocations for allocation_index to prevent
      * remote allocations from corrupting local page ID assignment */
-    page_table_t *new_table = page_table_create(addr, aligned_size, ctx->node_id, ctx->num_local_allocations);
+    page_table_t *new_table = page_table_create(addr, aligned_size, ctx->node_id, ctx->num_local_allocations,
+                                                block_size);
     if (!new_table) {
         pthread_mutex_unlock(&ctx->lock);
         munmap(addr, aligned_size);
         LOG_ERROR("Failed to create page table");
         return NULL;
     }
+    new_table->compression = attr.compression;
+    page_table_place(new_table, attr.placement, attr.home_node, ctx->config.num_nodes);
 
     /* Add to list of page tables */
     ctx->page_tables[ctx->num_allocations] = new_table;
@@ -85,7 +173,21 @@ void* dsm_malloc(size_t size) {
         }
     }
 
-    /* Set this node as owner of all allocated pages
+    /* Publish to the lock-free index used by the fault handler */
+    if (page_index_insert(new_table) != DSM_SUCCESS) {
+        ctx->page_tables[ctx->num_allocations - 1] = NULL;
+        ctx->num_allocations--;
+        ctx->num_local_allocations--;
+        if (ctx->page_table == new_table) {
+            ctx->page_table = NULL;
+        }
+        page_table_destroy(new_table);
+        pthread_mutex_unlock(&ctx->lock);
+        munmap(addr, aligned_size);
+        return NULL;
+    }
+
+    /* Register the placed owners of all allocated pages
      * NOTE: We temporarily disable state sync during this loop to avoid
      * blocking on network sends while holding ctx->lock. State will be
      * synced when pages are actually accessed (on demand). */
@@ -96,17 +198,19 @@ void* dsm_malloc(size_t size) {
         ctx->config.is_manager = false;  /* Disable sync temporarily */
         
         for (size_t i = 0; i < num_pages; i++) {
-            page_id_t global_page_id = new_table->entries[i].id;
+            const page_entry_t *entry = &new_table->entries[i];
 
             /* Set owner in directory using hash table API */
-            directory_set_owner(dir, global_page_id, ctx->node_id);
-
-            /* Set owner in page table (ctx->lock already held) */
-            new_table->entries[i].owner = ctx->node_id;
+            if (entry->owner == DSM_NODE_NONE) {
+                directory_set_first_touch(dir, entry->id);
+            } else {
+                directory_set_owner(dir, entry->id, entry->owner);
+            }
         }
         
         ctx->config.is_manager = was_manager;  /* Restore manager flag */
-        LOG_INFO("Set node %u as owner of %zu pages", ctx->node_id, num_pages);
+        LOG_INFO("Registered %zu pages (placement %d, base node %u)",
+                 num_pages, attr.placement, attr.home_node);
     }
 
     pthread_mutex_unlock(&ctx->lock);
@@ -126,7 +230,7 @@ void* dsm_malloc(size_t size) {
         /* Count connected nodes (excluding self) */
         int expected_acks = 0;
         pthread_mutex_lock(&ctx->lock);
-        for (int i = 0; i < MAX_NODES; i++) {
+        for (int i = 0; i < ctx->network.max_nodes; i++) {
             if (ctx->network.nodes[i].connected &&
                 ctx->network.nodes[i].id != ctx->node_id &&
                 !ctx->network.nodes[i].is_failed) {
@@ -138,9 +242,12 @@ void* dsm_malloc(size_t size) {
         LOG_INFO("Broadcasting SVAS allocation: pages %lu-%lu at addr=%p, size=%zu (owner=node %u, expecting %d ACKs)",
                  start_page_id, end_page_id, addr, aligned_size, ctx->node_id, expected_acks);
 
-        int rc = send_alloc_notify(start_page_id, end_page_id, ctx->node_id, num_pages, addr, aligned_size);
+        expect_alloc_acks(start_page_id, end_page_id, expected_acks);
+        int rc = send_alloc_notify(start_page_id, end_page_id, ctx->node_id, num_pages, addr, aligned_size,
+                                   &attr);
         if (rc != DSM_SUCCESS) {
             LOG_WARN("Failed to broadcast allocation notification");
+            cancel_alloc_acks();
             pthread_mutex_unlock(&ctx->allocation_lock);  /* BUG FIX: Release lock before return */
             /* Don't fail allocation, but don't wait for ACKs */
             return addr;
@@ -153,7 +260,7 @@ void* dsm_malloc(size_t size) {
             if (rc != DSM_SUCCESS) {
                 /* Log which nodes didn't ACK */
                 pthread_mutex_lock(&ctx->network.alloc_tracker.lock);
-                for (int i = 0; i < MAX_NODES; i++) {
+                for (int i = 0; i < ctx->network.max_nodes; i++) {
                     if (!ctx->network.alloc_tracker.acks_received[i] &&
                         ctx->network.nodes[i].connected &&
                         ctx->network.nodes[i].id != ctx->node_id) {
@@ -177,6 +284,186 @@ void* dsm_malloc(size_t size) {
     return addr;
 }
 
+int dsm_reserve_collective_window(void) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (ctx->collective_window) {
+        return DSM_SUCCESS;
+    }
+
+    void *hint = (void*)DSM_COLLECTIVE_WINDOW_BASE;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+#ifdef MAP_FIXED_NOREPLACE
+    flags |= MAP_FIXED_NOREPLACE;
+#endif
+    void *addr = mmap(hint, DSM_COLLECTIVE_WINDOW_BYTES, PROT_NONE, flags, -1, 0);
+    if (addr == MAP_FAILED || addr != hint) {
+        if (addr != MAP_FAILED) {
+            munmap(addr, DSM_COLLECTIVE_WINDOW_BYTES);
+        }
+        LOG_ERROR("Cannot reserve the collective window at %p", hint);
+        return DSM_ERROR_MEMORY;
+    }
+
+    ctx->collective_window = addr;
+    return DSM_SUCCESS;
+}
+
+/**
+ * Set up this node's page table for a collective region
+ * Pages are placed as DSM_PLACEMENT_BLOCK, whose runs are exactly the
+ * partitions since the region holds a whole number of them per node.
+ */
+static int create_collective_table(dsm_context_t *ctx, void *addr, size_t total_size,
+                                   page_id_t start_page_id, const dsm_alloc_attr_t *attr) {
+#ifdef MAP_HUGETLB
+    /* The window is already mapped with normal pages, which need no mmap */
+    if (attr->block_size == DSM_MAX_BLOCK_SIZE &&
+        mmap(addr, total_size, PROT_NONE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0) == MAP_FAILED) {
+        LOG_DEBUG("No huge pages for %zu bytes, using normal pages", total_size);
+    }
+#endif
+    if (userfault_register(addr, total_size) != DSM_SUCCESS) {
+        return DSM_ERROR_MEMORY;
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+
+    if (dsm_reserve_page_table_slot() != DSM_SUCCESS) {
+        pthread_mutex_unlock(&ctx->lock);
+        LOG_ERROR("Failed to grow page table list (%d allocations)", ctx->num_allocations);
+        return DSM_ERROR_MEMORY;
+    }
+
+    page_table_t *new_table = page_table_create_remote(addr, total_size, ctx->node_id, start_page_id,
+                                                       attr->block_size);
+    if (!new_table) {
+        pthread_mutex_unlock(&ctx->lock);
+        return DSM_ERROR_MEMORY;
+    }
+    new_table->compression = attr->compression;
+    page_table_place(new_table, DSM_PLACEMENT_BLOCK, 0, ctx->config.num_nodes);
+
+    ctx->page_tables[ctx->num_allocations] = new_table;
+    ctx->num_allocations++;
+
+    if (!get_page_directory()) {
+        int rc = consistency_init(100000);
+        if (rc != DSM_SUCCESS && rc != DSM_ERROR_INIT) {
+            LOG_ERROR("Failed to initialize consistency module");
+            ctx->page_tables[ctx->num_allocations - 1] = NULL;
+            ctx->num_allocations--;
+            page_table_destroy(new_table);
+            pthread_mutex_unlock(&ctx->lock);
+            return rc;
+        }
+    }
+    if (ctx->page_table == NULL) {
+        ctx->page_table = new_table;
+    }
+
+    /* Publish to the lock-free index used by the fault handler */
+    if (page_index_insert(new_table) != DSM_SUCCESS) {
+        ctx->page_tables[ctx->num_allocations - 1] = NULL;
+        ctx->num_allocations--;
+        if (ctx->page_table == new_table) {
+            ctx->page_table = NULL;
+        }
+        page_table_destroy(new_table);
+        pthread_mutex_unlock(&ctx->lock);
+        return DSM_ERROR_MEMORY;
+    }
+
+    /* As for a remote ALLOC_NOTIFY, the directory is filled in without
+     * ctx->lock: the manager records each owner for the backup */
+    pthread_mutex_unlock(&ctx->lock);
+
+    page_directory_t *dir = get_page_directory();
+    if (dir) {
+        for (size_t i = 0; i < new_table->num_pages; i++) {
+            directory_set_owner(dir, new_table->entries[i].id, new_table->entries[i].owner);
+        }
+    }
+    return DSM_SUCCESS;
+}
+
+void* dsm_malloc_collective(size_t size_per_node, const dsm_alloc_attr_t *attr_in, size_t *stride) {
+    if (size_per_node == 0) {
+        LOG_ERROR("dsm_malloc_collective: size is 0");
+        return NULL;
+    }
+
+    dsm_context_t *ctx = dsm_get_context();
+    if (!ctx->initialized) {
+        LOG_ERROR("DSM not initialized");
+        return NULL;
+    }
+
+    dsm_alloc_attr_t attr;
+    if (attr_in) {
+        attr = *attr_in;
+    } else {
+        dsm_alloc_attr_init(&attr);
+    }
+    if (attr.block_size == 0) {
+        attr.block_size = PAGE_SIZE;
+    }
+    if ((unsigned)attr.compression > DSM_COMPRESSION_LZ || !page_block_size_valid(attr.block_size)) {
+        LOG_ERROR("dsm_malloc_collective: invalid compression %d or block size %zu",
+                  attr.compression, attr.block_size);
+        return NULL;
+    }
+
+    /* Layout depends only on the arguments and the call count, so every
+     * node computes the same one without asking anyone */
+    int num_nodes = ctx->config.num_nodes;
+    size_t part_size = ((size_per_node + attr.block_size - 1) / attr.block_size) * attr.block_size;
+    size_t total_size = part_size * (size_t)num_nodes;
+
+    pthread_mutex_lock(&ctx->allocation_lock);
+    int index = ctx->num_collective_allocations;
+    size_t offset = ctx->collective_used;
+    bool fits = index < PAGE_ID_MAX_ALLOCATIONS &&
+                total_size / attr.block_size <= PAGE_ID_MAX_PAGES &&
+                total_size <= DSM_COLLECTIVE_WINDOW_BYTES - offset;
+    if (fits) {
+        ctx->num_collective_allocations++;
+        ctx->collective_used += total_size;
+    }
+    int rc = fits ? dsm_reserve_collective_window() : DSM_ERROR_MEMORY;
+    pthread_mutex_unlock(&ctx->allocation_lock);
+
+    void *addr = NULL;
+    if (rc == DSM_SUCCESS) {
+        addr = (char*)ctx->collective_window + offset;
+        rc = create_collective_table(ctx, addr, total_size,
+                                     PAGE_ID_BASE(PAGE_ID_COLLECTIVE_NODE, index), &attr);
+    } else if (!fits) {
+        LOG_ERROR("dsm_malloc_collective: %zu bytes do not fit the collective window", total_size);
+    }
+
+    LOG_INFO("dsm_malloc_collective: %d partitions of %zu bytes at %p (collective %d)",
+             num_nodes, part_size, addr, index);
+
+    /* One barrier replaces the per-node ALLOC_NOTIFY/ACK rounds: past it,
+     * every node has the table and can serve requests for its pages */
+    if (num_nodes > 1) {
+        int barrier_rc = dsm_barrier(DSM_BARRIER_COLLECTIVE, num_nodes);
+        if (barrier_rc != DSM_SUCCESS && rc == DSM_SUCCESS) {
+            dsm_free(addr);
+            rc = barrier_rc;
+        }
+    }
+    if (rc != DSM_SUCCESS) {
+        return NULL;
+    }
+
+    if (stride) {
+        *stride = part_size;
+    }
+    return addr;
+}
+
 int dsm_free(void *ptr) {
     if (!ptr) {
         return DSM_SUCCESS;
@@ -213,10 +500,8 @@ int dsm_free(void *ptr) {
     size_t num_pages = target_table->num_pages;
 
     /* CRITICAL FIX: Determine if this is a local allocation by checking page ID range
-     * Local allocations have page IDs in range [node_id * 1000000, (node_id + 1) * 1000000) */
-    page_id_t local_page_start = (page_id_t)ctx->node_id * 1000000;
-    page_id_t local_page_end = ((page_id_t)ctx->node_id + 1) * 1000000;
-    bool is_local_allocation = (start_page_id >= local_page_start && start_page_id < local_page_end);
+     * Local allocations carry this node's ID in the top bits of their page IDs */
+    bool is_local_allocation = (PAGE_ID_NODE(start_page_id) == ctx->node_id);
 
     /* Clean up directory entries for all pages in this allocation
      * This prevents memory leak in the directory */
@@ -229,7 +514,8 @@ int dsm_free(void *ptr) {
         LOG_DEBUG("Removed %zu directory entries for freed allocation", num_pages);
     }
 
-    /* Remove from list and compact - this prevents new references from being acquired */
+    /* Remove from the index and list - this prevents new references from being acquired */
+    page_index_remove(target_table);
     for (int i = target_index; i < ctx->num_allocations - 1; i++) {
         ctx->page_tables[i] = ctx->page_tables[i + 1];
     }
@@ -255,8 +541,14 @@ int dsm_free(void *ptr) {
     usleep(10000); // Grace period to allow concurrent faults to finish using the table
     page_table_release(target_table);
 
-    /* Unmap memory */
-    if (munmap(ptr, size) != 0) {
+    /* Unmap memory; a collective region goes back to the reserved window */
+    if (PAGE_ID_NODE(start_page_id) == PAGE_ID_COLLECTIVE_NODE) {
+        if (mmap(ptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED,
+                 -1, 0) == MAP_FAILED) {
+            LOG_ERROR("Failed to return %p to the collective window", ptr);
+            return DSM_ERROR_MEMORY;
+        }
+    } else if (munmap(ptr, size) != 0) {
         LOG_ERROR("munmap failed");
         return DSM_ERROR_MEMORY;
     }
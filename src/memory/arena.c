@@ -0,0 +1,374 @@
+/**
+ * @file arena.c
+ * @brief Shared-heap arena allocator on top of dsm_malloc_attr()
+ *
+ * An arena is one DSM allocation with DSM_PLACEMENT_BLOCK, so node n owns
+ * the n-th run of its pages. Each node carves objects only from its own
+ * run: small objects from one-page slabs of a single size class, larger
+ * ones from whole pages. Objects of different nodes never share a page,
+ * and allocating or freeing needs no messages. All bookkeeping is local
+ * memory; the DSM pages hold nothing but object data.
+ */
+
+#include "dsm/dsm.h"
+#include "../core/dsm_context.h"
+#include "../core/log.h"
+#include "page_table.h"
+#include "page_index.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/** Smallest object size (and alignment) */
+#define ARENA_MIN_OBJECT 16
+
+/** Size classes: ARENA_MIN_OBJECT << class, up to ARENA_MAX_SMALL */
+#define ARENA_NUM_CLASSES 8
+
+/** Largest object served from a slab; larger ones get whole pages */
+#define ARENA_MAX_SMALL (ARENA_MIN_OBJECT << (ARENA_NUM_CLASSES - 1))
+
+/** Words of a slab's free bitmap (one bit per smallest object) */
+#define ARENA_SLAB_WORDS (PAGE_SIZE / ARENA_MIN_OBJECT / 64)
+
+/**
+ * One page of objects of one size class
+ */
+typedef struct arena_slab_s {
+    uint8_t *base;                        /**< Page holding the objects */
+    int size_class;                       /**< Objects are ARENA_MIN_OBJECT << size_class bytes */
+    int num_free;                         /**< Objects not allocated */
+    uint64_t free_bits[ARENA_SLAB_WORDS]; /**< Bit i set: object i is free */
+    struct arena_slab_s *prev;            /**< Neighbours in the class's partial list */
+    struct arena_slab_s *next;
+} arena_slab_t;
+
+/**
+ * Use of one page of this node's run
+ */
+typedef struct {
+    arena_slab_t *slab;        /**< Slab on the page, or NULL */
+    uint32_t run;              /**< Pages of the large object starting here, 0 otherwise */
+} arena_page_t;
+
+struct dsm_arena_s {
+    void *base;                           /**< DSM allocation backing the arena */
+    uint8_t *local_base;                  /**< First page of this node's run */
+    size_t local_pages;                   /**< Pages in this node's run */
+    arena_page_t *pages;                  /**< Use of each page of the run */
+    uint64_t *used;                       /**< Bitmap of pages in use */
+    size_t hint;                          /**< No free page below this index */
+    arena_slab_t *partial[ARENA_NUM_CLASSES]; /**< Slabs with free objects */
+    pthread_mutex_t lock;
+};
+
+/* ============================ */
+/*       Pages                  */
+/* ============================ */
+
+static bool page_used(const dsm_arena_t *arena, size_t i) {
+    return (arena->used[i / 64] >> (i % 64)) & 1;
+}
+
+static void mark_pages(dsm_arena_t *arena, size_t first, size_t count, bool used) {
+    for (size_t i = first; i < first + count; i++) {
+        if (used) {
+            arena->used[i / 64] |= 1ULL << (i % 64);
+        } else {
+            arena->used[i / 64] &= ~(1ULL << (i % 64));
+        }
+    }
+    if (!used && first < arena->hint) {
+        arena->hint = first;
+    }
+}
+
+/**
+ * Take the first run of count free pages
+ * @return Index of the run in this node's pages, or local_pages if none
+ */
+static size_t take_pages(dsm_arena_t *arena, size_t count) {
+    size_t start = arena->hint;
+    size_t len = 0;
+
+    for (size_t i = arena->hint; i < arena->local_pages; i++) {
+        if (page_used(arena, i)) {
+            len = 0;
+            start = i + 1;
+            continue;
+        }
+        if (++len == count) {
+            mark_pages(arena, start, count, true);
+            if (start == arena->hint) {
+                arena->hint = start + count;
+            }
+            return start;
+        }
+    }
+    return arena->local_pages;
+}
+
+/* ============================ */
+/*       Slabs                  */
+/* ============================ */
+
+static void partial_push(dsm_arena_t *arena, arena_slab_t *slab) {
+    slab->prev = NULL;
+    slab->next = arena->partial[slab->size_class];
+    if (slab->next) {
+        slab->next->prev = slab;
+    }
+    arena->partial[slab->size_class] = slab;
+}
+
+static void partial_remove(dsm_arena_t *arena, arena_slab_t *slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        arena->partial[slab->size_class] = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->prev = slab->next = NULL;
+}
+
+static int slab_capacity(int size_class) {
+    return PAGE_SIZE / (ARENA_MIN_OBJECT << size_class);
+}
+
+/** Smallest size class that holds size bytes */
+static int size_class_of(size_t size) {
+    int size_class = 0;
+    while ((size_t)(ARENA_MIN_OBJECT << size_class) < size) {
+        size_class++;
+    }
+    return size_class;
+}
+
+static arena_slab_t* slab_create(dsm_arena_t *arena, int size_class) {
+    size_t page = take_pages(arena, 1);
+    if (page == arena->local_pages) {
+        return NULL;
+    }
+
+    arena_slab_t *slab = calloc(1, sizeof(arena_slab_t));
+    if (!slab) {
+        mark_pages(arena, page, 1, false);
+        return NULL;
+    }
+
+    slab->base = arena->local_base + page * PAGE_SIZE;
+    slab->size_class = size_class;
+    slab->num_free = slab_capacity(size_class);
+    for (int i = 0; i < slab->num_free; i++) {
+        slab->free_bits[i / 64] |= 1ULL << (i % 64);
+    }
+    arena->pages[page].slab = slab;
+    partial_push(arena, slab);
+    return slab;
+}
+
+static void* slab_alloc(dsm_arena_t *arena, arena_slab_t *slab) {
+    for (int w = 0; w < ARENA_SLAB_WORDS; w++) {
+        if (slab->free_bits[w] == 0) {
+            continue;
+        }
+        int bit = __builtin_ctzll(slab->free_bits[w]);
+        slab->free_bits[w] &= ~(1ULL << bit);
+        if (--slab->num_free == 0) {
+            partial_remove(arena, slab);
+        }
+        return slab->base + (size_t)(w * 64 + bit) * (ARENA_MIN_OBJECT << slab->size_class);
+    }
+    return NULL;
+}
+
+/* ============================ */
+/*       Public API             */
+/* ============================ */
+
+/**
+ * Set up this node's view of an arena over a DSM allocation
+ */
+static dsm_arena_t* arena_open(void *base, size_t total_size) {
+    dsm_context_t *ctx = dsm_get_context();
+    size_t num_pages = total_size / PAGE_SIZE;
+    int num_nodes = ctx->config.num_nodes > 1 ? ctx->config.num_nodes : 1;
+    size_t part = num_nodes > 1 ? ctx->node_id : 0;
+
+    /* This node's run, as DSM_PLACEMENT_BLOCK placed it */
+    size_t run = (num_pages + (size_t)num_nodes - 1) / (size_t)num_nodes;
+    size_t first = part * run < num_pages ? part * run : num_pages;
+    size_t last = first + run < num_pages ? first + run : num_pages;
+
+    dsm_arena_t *arena = calloc(1, sizeof(dsm_arena_t));
+    if (!arena) {
+        return NULL;
+    }
+    arena->base = base;
+    arena->local_base = (uint8_t *)base + first * PAGE_SIZE;
+    arena->local_pages = last - first;
+    arena->pages = calloc(arena->local_pages + 1, sizeof(arena_page_t));
+    arena->used = calloc(arena->local_pages / 64 + 1, sizeof(uint64_t));
+    if (!arena->pages || !arena->used) {
+        free(arena->pages);
+        free(arena->used);
+        free(arena);
+        return NULL;
+    }
+    pthread_mutex_init(&arena->lock, NULL);
+
+    LOG_INFO("Arena at %p: node %u carves pages %zu-%zu of %zu",
+             base, ctx->node_id, first, last, num_pages);
+    return arena;
+}
+
+dsm_arena_t* dsm_arena_create(size_t size) {
+    if (size == 0) {
+        LOG_ERROR("dsm_arena_create: size is 0");
+        return NULL;
+    }
+
+    dsm_alloc_attr_t attr;
+    dsm_alloc_attr_init(&attr);
+    attr.placement = DSM_PLACEMENT_BLOCK;
+
+    void *base = dsm_malloc_attr(size, &attr);
+    if (!base) {
+        return NULL;
+    }
+
+    size_t aligned_size = (size + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    dsm_arena_t *arena = arena_open(base, aligned_size);
+    if (!arena) {
+        dsm_free(base);
+    }
+    return arena;
+}
+
+dsm_arena_t* dsm_arena_attach(void *base) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (!ctx->initialized || !base) {
+        return NULL;
+    }
+
+    page_table_t *table = NULL;
+    pthread_mutex_lock(&ctx->lock);
+    page_entry_t *entry = page_index_lookup_addr(base, &table);
+    bool is_arena = entry && table->base_addr == base && table->block_size == PAGE_SIZE &&
+                    table->placement == DSM_PLACEMENT_BLOCK;
+    size_t total_size = is_arena ? table->total_size : 0;
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (!is_arena) {
+        LOG_ERROR("dsm_arena_attach: %p is not the base of an arena allocation", base);
+        return NULL;
+    }
+    return arena_open(base, total_size);
+}
+
+void* dsm_arena_alloc(dsm_arena_t *arena, size_t size) {
+    if (!arena || size == 0) {
+        return NULL;
+    }
+
+    void *ptr = NULL;
+    pthread_mutex_lock(&arena->lock);
+
+    if (size <= ARENA_MAX_SMALL) {
+        int size_class = size_class_of(size);
+        arena_slab_t *slab = arena->partial[size_class];
+        if (!slab) {
+            slab = slab_create(arena, size_class);
+        }
+        if (slab) {
+            ptr = slab_alloc(arena, slab);
+        }
+    } else {
+        size_t count = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+        size_t page = take_pages(arena, count);
+        if (page < arena->local_pages) {
+            arena->pages[page].run = (uint32_t)count;
+            ptr = arena->local_base + page * PAGE_SIZE;
+        }
+    }
+
+    pthread_mutex_unlock(&arena->lock);
+
+    if (!ptr) {
+        LOG_WARN("dsm_arena_alloc: out of arena memory for %zu bytes", size);
+    }
+    return ptr;
+}
+
+int dsm_arena_free(dsm_arena_t *arena, void *ptr) {
+    if (!arena) {
+        return DSM_ERROR_INVALID;
+    }
+    if (!ptr) {
+        return DSM_SUCCESS;
+    }
+
+    uint8_t *p = ptr;
+    if (p < arena->local_base || p >= arena->local_base + arena->local_pages * PAGE_SIZE) {
+        LOG_ERROR("dsm_arena_free: %p was not allocated by this node", ptr);
+        return DSM_ERROR_INVALID;
+    }
+
+    size_t page = (size_t)(p - arena->local_base) / PAGE_SIZE;
+    int rc = DSM_ERROR_INVALID;
+    pthread_mutex_lock(&arena->lock);
+
+    arena_page_t *info = &arena->pages[page];
+    if (info->slab) {
+        arena_slab_t *slab = info->slab;
+        size_t object_size = (size_t)ARENA_MIN_OBJECT << slab->size_class;
+        size_t offset = (size_t)(p - slab->base);
+        size_t index = offset / object_size;
+        uint64_t bit = 1ULL << (index % 64);
+
+        if (offset % object_size == 0 && !(slab->free_bits[index / 64] & bit)) {
+            slab->free_bits[index / 64] |= bit;
+            if (slab->num_free++ == 0) {
+                partial_push(arena, slab);
+            }
+            if (slab->num_free == slab_capacity(slab->size_class)) {
+                /* Empty slabs go back to the pages */
+                partial_remove(arena, slab);
+                info->slab = NULL;
+                mark_pages(arena, page, 1, false);
+                free(slab);
+            }
+            rc = DSM_SUCCESS;
+        }
+    } else if (info->run > 0 && (size_t)(p - arena->local_base) % PAGE_SIZE == 0) {
+        mark_pages(arena, page, info->run, false);
+        info->run = 0;
+        rc = DSM_SUCCESS;
+    }
+
+    pthread_mutex_unlock(&arena->lock);
+
+    if (rc != DSM_SUCCESS) {
+        LOG_ERROR("dsm_arena_free: %p is not an allocated object", ptr);
+    }
+    return rc;
+}
+
+int dsm_arena_destroy(dsm_arena_t *arena) {
+    if (!arena) {
+        return DSM_ERROR_INVALID;
+    }
+
+    for (size_t i = 0; i < arena->local_pages; i++) {
+        free(arena->pages[i].slab);
+    }
+    void *base = arena->base;
+    pthread_mutex_destroy(&arena->lock);
+    free(arena->pages);
+    free(arena->used);
+    free(arena);
+
+    return dsm_free(base);
+}
@@ -0,0 +1,662 @@
+/**
+ * @file checkpoint.c
+ * @brief Coordinated checkpoints and restart implementation
+ */
+
+#include "checkpoint.h"
+#include "dsm/dsm.h"
+#include "page_table.h"
+#include "page_index.h"
+#include "permission.h"
+#include "userfault.h"
+#include "../core/dsm_context.h"
+#include "../core/log.h"
+#include "../consistency/directory.h"
+#include "../consistency/page_migration.h"
+#include "../consistency/release_consistency.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ============================ */
+/*       File Layout            */
+/* ============================ */
+
+/**
+ * Start of a snapshot file
+ */
+typedef struct {
+    char magic[8];                     /**< CHECKPOINT_MAGIC */
+    uint32_t version;                  /**< CHECKPOINT_VERSION */
+    uint32_t page_size;                /**< PAGE_SIZE of the writer */
+    uint32_t node_id;                  /**< Node that wrote the file */
+    uint32_t num_nodes;                /**< Cluster size */
+    uint32_t consistency;              /**< dsm_consistency_t */
+    uint32_t num_tables;               /**< Allocation descriptors that follow */
+    uint64_t checkpoint_id;            /**< Chosen by the manager, the same in every node's file */
+    int32_t num_local_allocations;     /**< ctx->num_local_allocations */
+    int32_t num_collective_allocations;/**< ctx->num_collective_allocations */
+    uint64_t collective_used;          /**< ctx->collective_used */
+    uint64_t file_size;                /**< Bytes of the whole file */
+} checkpoint_header_t;
+
+/**
+ * One allocation
+ */
+typedef struct {
+    uint64_t base_addr;                /**< Address on every node */
+    uint64_t total_size;               /**< Bytes */
+    uint64_t block_size;               /**< Bytes per page */
+    uint64_t num_pages;                /**< Pages (total_size / block_size) */
+    uint64_t start_page_id;            /**< Global ID of the first page */
+    uint64_t pages_offset;             /**< File offset of the page records */
+    uint64_t image_offset;             /**< File offset of the image (PAGE_SIZE aligned) */
+    uint32_t compression;              /**< dsm_compression_t */
+    uint32_t placement;                /**< dsm_placement_t */
+} checkpoint_table_t;
+
+/**
+ * One page of an allocation
+ */
+typedef struct {
+    uint64_t version;                  /**< Page version */
+    uint32_t owner;                    /**< Directory owner on the page's directory node, owner hint elsewhere */
+    uint32_t home;                     /**< Home node */
+    uint8_t state;                     /**< page_state_t if the block is in the image, else INVALID */
+    uint8_t reserved[7];
+} checkpoint_page_t;
+
+static size_t align_page(size_t n) {
+    return (n + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+}
+
+static void snapshot_path(char *path, size_t len, const char *dir, node_id_t node_id) {
+    snprintf(path, len, CHECKPOINT_FILE_FORMAT, dir, node_id);
+}
+
+/* ============================ */
+/*       Writing                */
+/* ============================ */
+
+/**
+ * Record one allocation's pages, copying in the blocks this node answers for
+ *
+ * @return Blocks copied
+ */
+static size_t save_table(page_table_t *table, uint8_t *map, const checkpoint_table_t *desc) {
+    dsm_context_t *ctx = dsm_get_context();
+    page_directory_t *dir = get_page_directory();
+    checkpoint_page_t *pages = (checkpoint_page_t *)(map + desc->pages_offset);
+    bool release = rc_enabled();
+    size_t saved = 0;
+
+    for (size_t i = 0; i < table->num_pages; i++) {
+        page_entry_t *entry = &table->entries[i];
+
+        pthread_mutex_lock(&table->lock);
+        page_state_t state = entry->state;
+        node_id_t owner = entry->owner;
+        node_id_t home = entry->home;
+        uint64_t version = entry->version;
+        pthread_mutex_unlock(&table->lock);
+
+        node_id_t dir_owner;
+        if (dir && directory_is_local(entry->id) &&
+            directory_lookup(dir, entry->id, &dir_owner) == DSM_SUCCESS) {
+            owner = dir_owner;
+        }
+
+        /* The block's current contents are the owner's, or under release
+         * consistency the home's once the barrier has merged the diffs */
+        bool keep = state != PAGE_STATE_INVALID &&
+                    (release ? home == ctx->node_id : owner == ctx->node_id);
+
+        pages[i].version = version;
+        pages[i].owner = owner;
+        pages[i].home = home;
+        pages[i].state = keep ? (uint8_t)state : (uint8_t)PAGE_STATE_INVALID;
+        if (keep) {
+            memcpy(map + desc->image_offset + i * table->block_size, entry->local_addr, table->block_size);
+            saved++;
+        }
+    }
+    return saved;
+}
+
+/**
+ * Write this node's snapshot file
+ * The file is built under a temporary name and renamed into place.
+ */
+static int write_snapshot(const char *dir, uint64_t checkpoint_id) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        LOG_ERROR("Cannot create checkpoint directory %s: %s", dir, strerror(errno));
+        return DSM_ERROR_INVALID;
+    }
+    char path[PATH_MAX];
+    char tmp_path[PATH_MAX + 8];
+    snapshot_path(path, sizeof(path), dir, ctx->node_id);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    /* Tables stay referenced while their pages are copied */
+    pthread_mutex_lock(&ctx->lock);
+    int num_tables = 0;
+    page_table_t **tables = calloc((size_t)ctx->num_allocations + 1, sizeof(*tables));
+    if (tables) {
+        for (int i = 0; i < ctx->num_allocations; i++) {
+            if (ctx->page_tables[i]) {
+                page_table_acquire(ctx->page_tables[i]);
+                tables[num_tables++] = ctx->page_tables[i];
+            }
+        }
+    }
+    checkpoint_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.page_size = PAGE_SIZE;
+    header.node_id = ctx->node_id;
+    header.num_nodes = (uint32_t)ctx->config.num_nodes;
+    header.consistency = (uint32_t)ctx->config.consistency;
+    header.num_tables = (uint32_t)num_tables;
+    header.checkpoint_id = checkpoint_id;
+    header.num_local_allocations = ctx->num_local_allocations;
+    header.num_collective_allocations = ctx->num_collective_allocations;
+    header.collective_used = ctx->collective_used;
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (!tables) {
+        return DSM_ERROR_MEMORY;
+    }
+
+    checkpoint_table_t *descs = calloc((size_t)num_tables + 1, sizeof(*descs));
+    if (!descs) {
+        for (int i = 0; i < num_tables; i++) {
+            page_table_release(tables[i]);
+        }
+        free(tables);
+        return DSM_ERROR_MEMORY;
+    }
+
+    /* Header, descriptors and page records, then the page-aligned images */
+    size_t offset = sizeof(header) + (size_t)num_tables * sizeof(checkpoint_table_t);
+    for (int t = 0; t < num_tables; t++) {
+        descs[t].base_addr = (uintptr_t)tables[t]->base_addr;
+        descs[t].total_size = tables[t]->total_size;
+        descs[t].block_size = tables[t]->block_size;
+        descs[t].num_pages = tables[t]->num_pages;
+        descs[t].start_page_id = tables[t]->start_page_id;
+        descs[t].compression = (uint32_t)tables[t]->compression;
+        descs[t].placement = (uint32_t)tables[t]->placement;
+        descs[t].pages_offset = offset;
+        offset += tables[t]->num_pages * sizeof(checkpoint_page_t);
+    }
+    offset = align_page(offset);
+    for (int t = 0; t < num_tables; t++) {
+        descs[t].image_offset = offset;
+        offset += tables[t]->total_size;
+    }
+    header.file_size = offset;
+
+    int rc = DSM_SUCCESS;
+    size_t saved = 0;
+    size_t total_pages = 0;
+    uint8_t *map = MAP_FAILED;
+    int fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)header.file_size) != 0) {
+        LOG_ERROR("Cannot create snapshot %s: %s", tmp_path, strerror(errno));
+        rc = DSM_ERROR_INVALID;
+    } else {
+        /* Blocks not copied stay holes of the sparse file */
+        map = mmap(NULL, header.file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            LOG_ERROR("Cannot map snapshot %s: %s", tmp_path, strerror(errno));
+            rc = DSM_ERROR_MEMORY;
+        }
+    }
+
+    if (rc == DSM_SUCCESS) {
+        memcpy(map, &header, sizeof(header));
+        memcpy(map + sizeof(header), descs, (size_t)num_tables * sizeof(checkpoint_table_t));
+        for (int t = 0; t < num_tables; t++) {
+            saved += save_table(tables[t], map, &descs[t]);
+            total_pages += tables[t]->num_pages;
+        }
+        if (msync(map, header.file_size, MS_SYNC) != 0) {
+            LOG_ERROR("Failed to write snapshot %s: %s", tmp_path, strerror(errno));
+            rc = DSM_ERROR_INVALID;
+        }
+    }
+
+    if (map != MAP_FAILED) {
+        munmap(map, header.file_size);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (rc == DSM_SUCCESS && rename(tmp_path, path) != 0) {
+        LOG_ERROR("Cannot move snapshot into place as %s: %s", path, strerror(errno));
+        rc = DSM_ERROR_INVALID;
+    }
+    if (rc != DSM_SUCCESS) {
+        unlink(tmp_path);
+    }
+
+    for (int i = 0; i < num_tables; i++) {
+        page_table_release(tables[i]);
+    }
+    free(tables);
+    free(descs);
+
+    if (rc == DSM_SUCCESS) {
+        LOG_INFO("Checkpoint %lu: %zu of %zu pages in %d allocations saved to %s",
+                 checkpoint_id, saved, total_pages, num_tables, path);
+    }
+    return rc;
+}
+
+int dsm_checkpoint(const char *dir) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (!ctx || !ctx->initialized) {
+        return DSM_ERROR_INIT;
+    }
+    if (!dir || !*dir) {
+        return DSM_ERROR_INVALID;
+    }
+    int num_nodes = ctx->config.num_nodes;
+
+    /* Quiescent point: past it no page moves until the last round below */
+    int rc = dsm_barrier(DSM_BARRIER_CHECKPOINT, num_nodes);
+    if (rc != DSM_SUCCESS) {
+        return rc;
+    }
+
+    uint64_t checkpoint_id = 0;
+    if (ctx->node_id == 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        checkpoint_id = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+    }
+    rc = dsm_broadcast(&checkpoint_id, sizeof(checkpoint_id), 0);
+    if (rc != DSM_SUCCESS) {
+        return rc;
+    }
+
+    /* Every node reports the worst result, and nobody resumes before all are written */
+    int32_t result = write_snapshot(dir, checkpoint_id);
+    rc = dsm_allreduce(&result, 1, DSM_TYPE_INT32, DSM_REDUCE_MIN);
+    if (rc != DSM_SUCCESS) {
+        return rc;
+    }
+    if (result != DSM_SUCCESS) {
+        LOG_ERROR("Checkpoint %lu to %s failed (rc=%d)", checkpoint_id, dir, result);
+    }
+    return result;
+}
+
+/* ============================ */
+/*       Restoring              */
+/* ============================ */
+
+/**
+ * A snapshot file being restored
+ */
+typedef struct {
+    int fd;                            /**< Open snapshot */
+    size_t file_size;                  /**< Its size */
+    checkpoint_header_t header;        /**< Validated header */
+    checkpoint_table_t *descs;         /**< Validated descriptors (header.num_tables) */
+    void **regions;                    /**< Address of each mapped region, NULL until mapped */
+    const uint8_t *map;                /**< Read-only mapping of the whole file, once regions are mapped */
+} snapshot_t;
+
+static void close_snapshot(snapshot_t *snap) {
+    if (snap->map) {
+        munmap((void *)snap->map, snap->file_size);
+    }
+    if (snap->fd >= 0) {
+        close(snap->fd);
+    }
+    free(snap->descs);
+    free(snap->regions);
+}
+
+/**
+ * Open and check this node's snapshot file
+ *
+ * Only the header and descriptors are read: nothing is mapped before the
+ * regions are back at their addresses, where it could be placed instead.
+ *
+ * @return DSM_SUCCESS, DSM_ERROR_NOT_FOUND, DSM_ERROR_INVALID or DSM_ERROR_MEMORY
+ */
+static int open_snapshot(const char *dir, snapshot_t *snap) {
+    dsm_context_t *ctx = dsm_get_context();
+    char path[PATH_MAX];
+    snapshot_path(path, sizeof(path), dir, ctx->node_id);
+
+    snap->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (snap->fd < 0) {
+        LOG_ERROR("No snapshot %s: %s", path, strerror(errno));
+        return DSM_ERROR_NOT_FOUND;
+    }
+    struct stat st;
+    checkpoint_header_t *header = &snap->header;
+    if (fstat(snap->fd, &st) != 0 ||
+        pread(snap->fd, header, sizeof(*header), 0) != (ssize_t)sizeof(*header)) {
+        LOG_ERROR("Snapshot %s is truncated", path);
+        return DSM_ERROR_INVALID;
+    }
+    snap->file_size = (size_t)st.st_size;
+
+    size_t descs_size = (size_t)header->num_tables * sizeof(checkpoint_table_t);
+    if (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != CHECKPOINT_VERSION || header->page_size != PAGE_SIZE ||
+        header->file_size != snap->file_size || sizeof(*header) + descs_size > snap->file_size) {
+        LOG_ERROR("%s is not a snapshot of this DSM version", path);
+        return DSM_ERROR_INVALID;
+    }
+    if (header->node_id != ctx->node_id || header->num_nodes != (uint32_t)ctx->config.num_nodes ||
+        header->consistency != (uint32_t)ctx->config.consistency) {
+        LOG_ERROR("Snapshot %s is of node %u of %u (consistency %u), not of this node",
+                  path, header->node_id, header->num_nodes, header->consistency);
+        return DSM_ERROR_INVALID;
+    }
+
+    snap->descs = calloc((size_t)header->num_tables + 1, sizeof(*snap->descs));
+    snap->regions = calloc((size_t)header->num_tables + 1, sizeof(*snap->regions));
+    if (!snap->descs || !snap->regions) {
+        return DSM_ERROR_MEMORY;
+    }
+    if (pread(snap->fd, snap->descs, descs_size, sizeof(*header)) != (ssize_t)descs_size) {
+        LOG_ERROR("Snapshot %s is truncated", path);
+        return DSM_ERROR_INVALID;
+    }
+    for (uint32_t t = 0; t < header->num_tables; t++) {
+        const checkpoint_table_t *d = &snap->descs[t];
+        if (!page_block_size_valid(d->block_size) || d->total_size == 0 ||
+            d->total_size != d->num_pages * d->block_size ||
+            d->pages_offset + d->num_pages * sizeof(checkpoint_page_t) > snap->file_size ||
+            d->image_offset % PAGE_SIZE != 0 || d->image_offset + d->total_size > snap->file_size) {
+            LOG_ERROR("Snapshot %s: allocation %u is malformed", path, t);
+            return DSM_ERROR_INVALID;
+        }
+    }
+    return DSM_SUCCESS;
+}
+
+static bool desc_collective(const checkpoint_table_t *desc) {
+    return PAGE_ID_NODE(desc->start_page_id) == PAGE_ID_COLLECTIVE_NODE;
+}
+
+/**
+ * Give a restored region's address range back
+ */
+static void unmap_region(void *addr, size_t size, bool collective) {
+    if (collective) {
+        mmap(addr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+    } else {
+        munmap(addr, size);
+    }
+}
+
+/**
+ * Map one allocation at its address
+ *
+ * Under the SIGSEGV engine the image itself is mapped privately, so blocks
+ * are read from the file on first touch and writes stay in memory.
+ */
+static void* map_restored_region(int fd, const checkpoint_table_t *desc) {
+    dsm_context_t *ctx = dsm_get_context();
+    void *base = (void *)(uintptr_t)desc->base_addr;
+    bool collective = desc_collective(desc);
+    int flags = MAP_PRIVATE;
+
+    if (collective) {
+        /* Replaces part of the reserved window */
+        pthread_mutex_lock(&ctx->allocation_lock);
+        int rc = dsm_reserve_collective_window();
+        pthread_mutex_unlock(&ctx->allocation_lock);
+        if (rc != DSM_SUCCESS) {
+            return NULL;
+        }
+        flags |= MAP_FIXED;
+    } else {
+#ifdef MAP_FIXED_NOREPLACE
+        flags |= MAP_FIXED_NOREPLACE;
+#endif
+    }
+
+    void *addr;
+    if (userfault_active()) {
+        addr = mmap(base, desc->total_size, PROT_NONE, flags | MAP_ANONYMOUS, -1, 0);
+    } else {
+        addr = mmap(base, desc->total_size, PROT_NONE, flags, fd, (off_t)desc->image_offset);
+    }
+    if (addr != MAP_FAILED && addr != base) {
+        munmap(addr, desc->total_size);
+        addr = MAP_FAILED;
+    }
+    if (addr == MAP_FAILED) {
+        LOG_ERROR("Cannot map restored allocation at %p (%lu bytes): address range is taken",
+                  base, desc->total_size);
+        return NULL;
+    }
+    if (userfault_register(addr, desc->total_size) != DSM_SUCCESS) {
+        unmap_region(addr, desc->total_size, collective);
+        return NULL;
+    }
+    return addr;
+}
+
+/**
+ * Publish a restored page table, as dsm_malloc() does
+ */
+static int publish_table(dsm_context_t *ctx, page_table_t *table) {
+    pthread_mutex_lock(&ctx->lock);
+    if (dsm_reserve_page_table_slot() != DSM_SUCCESS) {
+        pthread_mutex_unlock(&ctx->lock);
+        return DSM_ERROR_MEMORY;
+    }
+    if (!get_page_directory()) {
+        int rc = consistency_init(100000);
+        if (rc != DSM_SUCCESS && rc != DSM_ERROR_INIT) {
+            pthread_mutex_unlock(&ctx->lock);
+            return rc;
+        }
+    }
+    if (page_index_insert(table) != DSM_SUCCESS) {
+        pthread_mutex_unlock(&ctx->lock);
+        return DSM_ERROR_MEMORY;
+    }
+    ctx->page_tables[ctx->num_allocations++] = table;
+    if (ctx->page_table == NULL) {
+        ctx->page_table = table;
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    return DSM_SUCCESS;
+}
+
+/**
+ * Rebuild the page table of a mapped region
+ * The region belongs to the table once published, and is given back if
+ * publishing fails.
+ *
+ * @param restored Incremented for each block restored valid
+ */
+static int restore_table(const snapshot_t *snap, const checkpoint_table_t *desc, void *addr,
+                         size_t *restored) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    page_table_t *table = page_table_create_remote(addr, desc->total_size, DSM_NODE_NONE,
+                                                   desc->start_page_id, desc->block_size);
+    if (!table) {
+        unmap_region(addr, desc->total_size, desc_collective(desc));
+        return DSM_ERROR_MEMORY;
+    }
+    table->compression = (dsm_compression_t)desc->compression;
+    table->placement = (dsm_placement_t)desc->placement;
+
+    const checkpoint_page_t *pages = (const checkpoint_page_t *)(snap->map + desc->pages_offset);
+    for (size_t i = 0; i < table->num_pages; i++) {
+        table->entries[i].owner = pages[i].owner;
+        table->entries[i].home = pages[i].home;
+        table->entries[i].version = pages[i].version;
+    }
+
+    int rc = publish_table(ctx, table);
+    if (rc != DSM_SUCCESS) {
+        page_table_destroy(table);
+        unmap_region(addr, desc->total_size, desc_collective(desc));
+        return rc;
+    }
+
+    /* Saved blocks are valid again; their contents are already mapped
+     * unless userfaultfd needs them installed. Their protections are
+     * batched, one mprotect() per run of the table. */
+    perm_batch_t batch;
+    perm_batch_init(&batch);
+    for (size_t i = 0; i < table->num_pages; i++) {
+        if (pages[i].state == PAGE_STATE_INVALID) {
+            continue;
+        }
+        page_entry_t *entry = &table->entries[i];
+        if (userfault_active()) {
+            rc = userfault_install(table, entry, snap->map + desc->image_offset + i * desc->block_size);
+            if (rc != DSM_SUCCESS) {
+                break;
+            }
+        }
+
+        /* Under release consistency a write must fault to get its twin */
+        bool writable = pages[i].state == PAGE_STATE_READ_WRITE && !rc_enabled();
+        rc = perm_batch_add(&batch, table, entry, writable ? PAGE_PERM_READ_WRITE : PAGE_PERM_READ);
+        if (rc != DSM_SUCCESS) {
+            break;
+        }
+
+        /* A write permission stamps a new version: keep the saved one */
+        pthread_mutex_lock(&table->lock);
+        entry->version = pages[i].version;
+        pthread_mutex_unlock(&table->lock);
+        (*restored)++;
+    }
+    int applied = perm_batch_apply(&batch);
+    perm_batch_destroy(&batch);
+    if (rc == DSM_SUCCESS) {
+        rc = applied;
+    }
+    if (rc != DSM_SUCCESS) {
+        LOG_ERROR("Failed to restore the pages of allocation %p (rc=%d)", addr, rc);
+        return rc;
+    }
+
+    /* As for a remote ALLOC_NOTIFY; sharers are gone with their copies */
+    page_directory_t *dir = get_page_directory();
+    if (dir) {
+        for (size_t i = 0; i < table->num_pages; i++) {
+            if (pages[i].owner == DSM_NODE_NONE) {
+                directory_set_first_touch(dir, table->entries[i].id);
+            } else {
+                directory_set_owner(dir, table->entries[i].id, pages[i].owner);
+            }
+        }
+    }
+    return DSM_SUCCESS;
+}
+
+/**
+ * Map every region back, then rebuild the page tables from the file
+ */
+static int restore_snapshot(snapshot_t *snap, size_t *restored) {
+    dsm_context_t *ctx = dsm_get_context();
+    uint32_t num_tables = snap->header.num_tables;
+    int rc = DSM_SUCCESS;
+
+    for (uint32_t t = 0; t < num_tables && rc == DSM_SUCCESS; t++) {
+        snap->regions[t] = map_restored_region(snap->fd, &snap->descs[t]);
+        if (!snap->regions[t]) {
+            rc = DSM_ERROR_MEMORY;
+        }
+    }
+    if (rc == DSM_SUCCESS) {
+        void *map = mmap(NULL, snap->file_size, PROT_READ, MAP_PRIVATE, snap->fd, 0);
+        if (map == MAP_FAILED) {
+            LOG_ERROR("Cannot map snapshot: %s", strerror(errno));
+            rc = DSM_ERROR_MEMORY;
+        } else {
+            snap->map = map;
+        }
+    }
+
+    /* Past a failure the remaining regions are given back */
+    uint32_t next = 0;
+    while (rc == DSM_SUCCESS && next < num_tables) {
+        rc = restore_table(snap, &snap->descs[next], snap->regions[next], restored);
+        next++;
+    }
+    for (uint32_t t = next; rc != DSM_SUCCESS && t < num_tables; t++) {
+        if (snap->regions[t]) {
+            unmap_region(snap->regions[t], snap->descs[t].total_size, desc_collective(&snap->descs[t]));
+        }
+    }
+
+    /* New allocations must not reuse the restored page IDs or window */
+    if (rc == DSM_SUCCESS) {
+        pthread_mutex_lock(&ctx->allocation_lock);
+        pthread_mutex_lock(&ctx->lock);
+        ctx->num_local_allocations = snap->header.num_local_allocations;
+        ctx->num_collective_allocations = snap->header.num_collective_allocations;
+        ctx->collective_used = snap->header.collective_used;
+        pthread_mutex_unlock(&ctx->lock);
+        pthread_mutex_unlock(&ctx->allocation_lock);
+    }
+    return rc;
+}
+
+int checkpoint_restore(const char *dir) {
+    snapshot_t snap;
+    memset(&snap, 0, sizeof(snap));
+    snap.fd = -1;
+
+    int rc = open_snapshot(dir, &snap);
+
+    /* Every node must restore the same checkpoint: max(id) == min(id) */
+    uint64_t id = rc == DSM_SUCCESS ? snap.header.checkpoint_id : 0;
+    uint64_t ids[2] = { id, ~id };
+    int agree = dsm_allreduce(ids, 2, DSM_TYPE_UINT64, DSM_REDUCE_MAX);
+    if (agree != DSM_SUCCESS) {
+        rc = agree;
+    } else if (rc == DSM_SUCCESS && (ids[0] != id || ~ids[1] != id)) {
+        LOG_ERROR("Snapshots in %s are from different checkpoints", dir);
+        rc = DSM_ERROR_INVALID;
+    }
+
+    size_t restored = 0;
+    if (rc == DSM_SUCCESS) {
+        rc = restore_snapshot(&snap, &restored);
+    }
+
+    /* No node faults on a restored page before its owner has the table */
+    int32_t result = rc;
+    agree = dsm_allreduce(&result, 1, DSM_TYPE_INT32, DSM_REDUCE_MIN);
+    if (agree != DSM_SUCCESS) {
+        result = agree;
+    }
+
+    if (result == DSM_SUCCESS) {
+        LOG_INFO("Restored checkpoint %lu from %s: %u allocations, %zu pages valid here",
+                 id, dir, snap.header.num_tables, restored);
+    }
+
+    /* Restored regions keep their own mappings of the file */
+    close_snapshot(&snap);
+    return result;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file checkpoint.h
+ * @brief Coordinated checkpoints of the shared address space, and restart
+ *
+ * dsm_checkpoint() is collective. The nodes quiesce at a barrier (under
+ * release consistency its release also brings every home copy up to date);
+ * the manager picks a checkpoint ID and broadcasts it, and each node then
+ * writes one snapshot file, CHECKPOINT_FILE_FORMAT in the checkpoint
+ * directory, through a shared mapping of it:
+ *
+ * - a header naming the node, cluster size, consistency model and ID,
+ * - one descriptor per allocation: address, size, block size, page IDs,
+ * - one record per page: owner, home, version and local state,
+ * - an image of each allocation, holding the blocks this node is
+ *   responsible for (the owner's under sequential consistency, the home's
+ *   under release consistency) and holes elsewhere.
+ *
+ * Each page's directory node (the manager, or with the distributed
+ * directory the page's home) records its directory's owner of the page,
+ * the other nodes their owner hints. A last collective round agrees on the result, so a
+ * checkpoint has either succeeded on every node or failed on every node.
+ *
+ * With dsm_config_t.restore_path, dsm_init() restores the snapshot once the
+ * cluster is up. Each allocation is mapped again at its old address and
+ * every node rebuilds its page tables and its directory from its file. Only the blocks a node saved are valid afterwards; other copies
+ * start INVALID and are fetched from their owner as usual. Under the
+ * SIGSEGV engine the image is mapped privately from the file, so restored
+ * blocks are read from it by the kernel only when first touched. The
+ * userfaultfd engine cannot register such a mapping, so there the saved
+ * blocks are copied in at restore.
+ *
+ * Locks, barriers, arenas' handles and in-flight requests are not part of a
+ * snapshot: a checkpoint is only taken while no DSM request is in flight.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+/** Snapshot file of a node in the checkpoint directory */
+#define CHECKPOINT_FILE_FORMAT "%s/node-%u.dsmckpt"
+
+/** First bytes of a snapshot file */
+#define CHECKPOINT_MAGIC "DSMCKPT1"
+
+/** Snapshot layout version */
+#define CHECKPOINT_VERSION 1
+
+/**
+ * Restore this node from its snapshot in a checkpoint directory
+ *
+ * Collective: called by dsm_init() on every node once the cluster is up,
+ * before any allocation is made. Only returns DSM_SUCCESS if every node
+ * restored the same checkpoint.
+ *
+ * @param dir Checkpoint directory given to dsm_checkpoint()
+ * @return DSM_SUCCESS, DSM_ERROR_NOT_FOUND if the file is missing,
+ *         DSM_ERROR_INVALID if it does not match this node and cluster or
+ *         another node's file is from a different checkpoint, or
+ *         DSM_ERROR_MEMORY if an allocation cannot be mapped at its address
+ */
+int checkpoint_restore(const char *dir);
+
+#endif /* CHECKPOINT_H */
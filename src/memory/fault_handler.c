@@ -6,10 +6,18 @@
 #define _GNU_SOURCE
 #include "fault_handler.h"
 #include "page_table.h"
+#include "page_index.h"
 #include "permission.h"
+#include "userfault.h"
 #include "../core/log.h"
 #include "../core/dsm_context.h"
+#include "../core/stats.h"
+#include "../core/perf_log.h"
+#include "../core/sharing_profile.h"
+#include "../consistency/directory.h"
 #include "../consistency/page_migration.h"
+#include "../consistency/release_consistency.h"
+#include "../consistency/prefetch.h"
 #include <signal.h>
 #include <string.h>
 #include <unistd.h>
@@ -19,6 +27,8 @@
 static struct sigaction old_sa;
 
 static void dsm_fault_handler(int sig, siginfo_t *info, void *context);
+static int handle_read_fault_entry(page_table_t *table, page_entry_t *entry);
+static int handle_write_fault_entry(page_table_t *table, page_entry_t *entry);
 
 int install_fault_handler(void) {
     struct sigaction sa;
@@ -34,10 +44,19 @@ int install_fault_handler(void) {
     }
 
     LOG_INFO("SIGSEGV handler installed");
+
+    /* The handler stays installed under userfaultfd: it reports faults
+     * outside DSM regions, and serves DSM ones if userfaultfd is missing */
+    dsm_context_t *ctx = dsm_get_context();
+    if (ctx->config.fault_engine == DSM_FAULT_USERFAULTFD &&
+        userfault_init(ctx->config.num_fault_threads) != DSM_SUCCESS) {
+        LOG_WARN("userfaultfd fault engine unavailable, using SIGSEGV");
+    }
     return DSM_SUCCESS;
 }
 
 void uninstall_fault_handler(void) {
+    userfault_shutdown();
     sigaction(SIGSEGV, &old_sa, NULL);
     LOG_INFO("SIGSEGV handler uninstalled");
 }
@@ -57,17 +76,9 @@ static void dsm_fault_handler(int sig, siginfo_t *info, void *context) {
         return;
     }
 
-    /* Check if fault is in any DSM region */
-    page_entry_t *entry = NULL;
-
-    for (int i = 0; i < ctx->num_allocations; i++) {
-        if (ctx->page_tables[i]) {
-            entry = page_table_lookup_by_addr(ctx->page_tables[i], fault_addr);
-            if (entry) {
-                break;
-            }
-        }
-    }
+    /* Check if fault is in any DSM region (lock-free O(log n) index lookup) */
+    page_table_t *table = NULL;
+    page_entry_t *entry = page_index_lookup_addr(fault_addr, &table);
 
     if (!entry) {
         LOG_ERROR("[%ld] Fault at %p - not in any DSM region", tid, fault_addr);
@@ -77,11 +88,6 @@ static void dsm_fault_handler(int sig, siginfo_t *info, void *context) {
         return;
     }
 
-    /* Update stats */
-    pthread_mutex_lock(&ctx->stats_lock);
-    ctx->stats.page_faults++;
-    pthread_mutex_unlock(&ctx->stats_lock);
-
     /* Detect if this was a read or write fault using architecture-specific error code */
     bool is_write_fault = false;
 
@@ -114,15 +120,7 @@ static void dsm_fault_handler(int sig, siginfo_t *info, void *context) {
               tid, fault_addr, entry->id, entry->state);
 #endif
 
-    /* Handle fault based on type */
-    int rc;
-    if (is_write_fault) {
-        rc = handle_write_fault(fault_addr);
-    } else {
-        rc = handle_read_fault(fault_addr);
-    }
-
-    if (rc != DSM_SUCCESS) {
+    if (service_page_fault(table, entry, is_write_fault, fault_addr) != DSM_SUCCESS) {
         LOG_ERROR("[%ld] Failed to handle %s fault at %p",
                   tid, is_write_fault ? "write" : "read", fault_addr);
         signal(SIGSEGV, SIG_DFL);
@@ -130,62 +128,114 @@ static void dsm_fault_handler(int sig, siginfo_t *info, void *context) {
     }
 }
 
-int handle_read_fault(void *addr) {
-    dsm_context_t *ctx = dsm_get_context();
+int service_page_fault(page_table_t *table, page_entry_t *entry, bool is_write, void *fault_addr) {
+    /* Update stats */
+    STATS_INC(page_faults);
+    uint64_t start_ns = perf_get_timestamp_ns();
 
-    /* Find entry in any page table */
-    page_entry_t *entry = NULL;
-    for (int i = 0; i < ctx->num_allocations; i++) {
-        if (ctx->page_tables[i]) {
-            entry = page_table_lookup_by_addr(ctx->page_tables[i], addr);
-            if (entry) break;
-        }
+    /* Handle fault based on type; the resolved entry is passed down so the
+     * fetch path does not look it up again; the fetch code notes the path taken */
+    stats_fault_path = 0;
+    bool was_invalid = entry->state == PAGE_STATE_INVALID;
+    int rc;
+    if (is_write) {
+        rc = handle_write_fault_entry(table, entry);
+    } else {
+        rc = handle_read_fault_entry(table, entry);
+    }
+    if (rc != DSM_SUCCESS) {
+        return rc;
+    }
+
+    if (is_write && sharing_profile_enabled()) {
+        sharing_profile_write(entry->id, table->block_size,
+                              (size_t)((uintptr_t)fault_addr - (uintptr_t)entry->local_addr), 1);
     }
 
+    uint64_t latency_ns = perf_get_timestamp_ns() - start_ns;
+    unsigned path = stats_fault_path;
+    stats_record_fault_histogram(is_write, path, latency_ns);
+    perf_log_fault(entry->id, is_write ? ACCESS_WRITE : ACCESS_READ,
+                   latency_ns, (path & STATS_PATH_QUEUED) != 0);
+
+    /* Pages that had to come from another node drive the stream prefetcher */
+    if (was_invalid && (path & STATS_PATH_REMOTE)) {
+        prefetch_on_fault(table, entry);
+    }
+    return DSM_SUCCESS;
+}
+
+int handle_read_fault(void *addr) {
+    page_table_t *table = NULL;
+    page_entry_t *entry = page_index_lookup_addr(addr, &table);
     if (!entry) {
         return DSM_ERROR_NOT_FOUND;
     }
+    return handle_read_fault_entry(table, entry);
+}
+
+/**
+ * Check whether a read fault should fetch the page for write
+ * True when dsm_config_t.adaptive is set and the page's directory node
+ * found this node its dominant writer (directory_page_advice()); never
+ * under release consistency.
+ */
+static bool adaptive_take_ownership(const page_entry_t *entry) {
+    page_directory_t *dir = get_page_directory();
+    return dir && directory_page_advice(dir, entry->id) == DIRECTORY_ADVICE_MIGRATE;
+}
 
-    pthread_mutex_lock(&ctx->stats_lock);
-    ctx->stats.read_faults++;
-    pthread_mutex_unlock(&ctx->stats_lock);
+static int handle_read_fault_entry(page_table_t *table, page_entry_t *entry) {
+    STATS_INC(read_faults);
 
     /* State transition: INVALID -> READ_ONLY */
     if (entry->state == PAGE_STATE_INVALID) {
+        /* Adaptive protocol: the page's dominant writer takes ownership right
+         * away, instead of a read copy and then a write fault to upgrade it */
+        if (adaptive_take_ownership(entry)) {
+            int rc = fetch_page_write_entry(table, entry);
+            if (rc != DSM_SUCCESS) {
+                LOG_ERROR("Failed to fetch page %lu for write on read fault", entry->id);
+                return rc;
+            }
+            STATS_INC(adaptive_migrations);
+            LOG_DEBUG("Read fault: page %lu taken READ_WRITE by its dominant writer", entry->id);
+            return DSM_SUCCESS;
+        }
+
         /* Fetch page from remote owner */
-        int rc = fetch_page_read(entry->id);
+        int rc = fetch_page_read_entry(table, entry);
         if (rc != DSM_SUCCESS) {
             LOG_ERROR("Failed to fetch page %lu for read", entry->id);
             return rc;
         }
         LOG_DEBUG("Read fault: page %lu fetched and set to READ_ONLY", entry->id);
-    } else if (entry->state == PAGE_STATE_READ_ONLY) {
-        /* Already have read access, this shouldn't happen */
-        LOG_WARN("Read fault on page %lu which is already READ_ONLY", entry->id);
+    } else {
+        /* Access is already granted: a batched downgrade was applied after
+         * the page was granted again, so only the protection is stale */
+        LOG_DEBUG("Read fault on page %lu which is already readable, reapplying protection", entry->id);
+        return sync_page_protection(table, entry);
     }
 
     return DSM_SUCCESS;
 }
 
 int handle_write_fault(void *addr) {
-    dsm_context_t *ctx = dsm_get_context();
-
-    /* Find entry in any page table */
-    page_entry_t *entry = NULL;
-    for (int i = 0; i < ctx->num_allocations; i++) {
-        if (ctx->page_tables[i]) {
-            entry = page_table_lookup_by_addr(ctx->page_tables[i], addr);
-            if (entry) break;
-        }
-    }
-
+    page_table_t *table = NULL;
+    page_entry_t *entry = page_index_lookup_addr(addr, &table);
     if (!entry) {
         return DSM_ERROR_NOT_FOUND;
     }
+    return handle_write_fault_entry(table, entry);
+}
 
-    pthread_mutex_lock(&ctx->stats_lock);
-    ctx->stats.write_faults++;
-    pthread_mutex_unlock(&ctx->stats_lock);
+static int handle_write_fault_entry(page_table_t *table, page_entry_t *entry) {
+    STATS_INC(write_faults);
+
+    /* Multiple writers: twin the page instead of taking ownership */
+    if (rc_enabled()) {
+        return rc_write_fault(table, entry);
+    }
 
     /* State transitions:
      * INVALID -> READ_WRITE
@@ -193,15 +243,16 @@ int handle_write_fault(void *addr) {
      */
     if (entry->state == PAGE_STATE_INVALID || entry->state == PAGE_STATE_READ_ONLY) {
         /* Fetch page with write access (will invalidate remote copies) */
-        int rc = fetch_page_write(entry->id);
+        int rc = fetch_page_write_entry(table, entry);
         if (rc != DSM_SUCCESS) {
             LOG_ERROR("Failed to fetch page %lu for write", entry->id);
             return rc;
         }
         LOG_DEBUG("Write fault: page %lu fetched and set to READ_WRITE", entry->id);
     } else if (entry->state == PAGE_STATE_READ_WRITE) {
-        /* Already have write access, this shouldn't happen */
-        LOG_WARN("Write fault on page %lu which is already READ_WRITE", entry->id);
+        /* Stale protection, as for reads */
+        LOG_DEBUG("Write fault on page %lu which is already READ_WRITE, reapplying protection", entry->id);
+        return sync_page_protection(table, entry);
     }
 
     return DSM_SUCCESS;
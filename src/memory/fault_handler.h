@@ -6,16 +6,33 @@
 #ifndef FAULT_HANDLER_H
 #define FAULT_HANDLER_H
 
+#include "page_table.h"
+#include <stdbool.h>
+
 /**
  * Install SIGSEGV signal handler
+ * Also starts the userfaultfd engine when the configuration asks for it;
+ * if the kernel does not offer it, faults stay on SIGSEGV.
  */
 int install_fault_handler(void);
 
 /**
- * Uninstall fault handler
+ * Uninstall fault handler (and stop the userfaultfd engine)
  */
 void uninstall_fault_handler(void);
 
+/**
+ * Run the fault protocol for one access to a DSM page
+ * Shared by the SIGSEGV handler and the userfaultfd fault threads.
+ *
+ * @param table Page table of the entry
+ * @param entry Page the access faulted on
+ * @param is_write True for a write access
+ * @param fault_addr Address the access faulted at (attributes writes for the sharing profiler)
+ * @return DSM_SUCCESS once the page allows the access
+ */
+int service_page_fault(page_table_t *table, page_entry_t *entry, bool is_write, void *fault_addr);
+
 /**
  * Handle read fault
  */
@@ -0,0 +1,223 @@
+/**
+ * @file page_index.c
+ * @brief Sorted address and page ID index implementation
+ */
+
+#include "page_index.h"
+#include "../core/log.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+/** How long a replaced snapshot stays readable (longer than dsm_free's grace period) */
+#define PAGE_INDEX_GRACE_MS 100
+
+/** Half-open key range [start, end) covered by one page table */
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    page_table_t *table;
+} index_range_t;
+
+/**
+ * Immutable index snapshot
+ * by_addr and by_id each hold count ranges sorted by start.
+ */
+typedef struct index_snapshot_s {
+    int count;
+    index_range_t *by_id;
+    struct timespec retired_at;
+    struct index_snapshot_s *next_retired;
+    index_range_t by_addr[];
+} index_snapshot_t;
+
+static struct {
+    index_snapshot_t *current;     /**< Published snapshot (atomic pointer) */
+    index_snapshot_t *retired;     /**< Replaced snapshots awaiting their grace period */
+} g_index = { NULL, NULL };
+
+static index_snapshot_t* snapshot_alloc(int count) {
+    index_snapshot_t *snap = malloc(sizeof(index_snapshot_t) +
+                                    2 * (size_t)count * sizeof(index_range_t));
+    if (!snap) {
+        return NULL;
+    }
+    snap->count = count;
+    snap->by_id = snap->by_addr + count;
+    snap->next_retired = NULL;
+    return snap;
+}
+
+/** Copy ranges into dst, inserting add at its sorted position and dropping skip */
+static int copy_ranges(index_range_t *dst, const index_range_t *src, int count,
+                       const index_range_t *add, const page_table_t *skip) {
+    int n = 0;
+    bool added = (add == NULL);
+    for (int i = 0; i < count; i++) {
+        if (src[i].table == skip) {
+            continue;
+        }
+        if (!added && add->start < src[i].start) {
+            dst[n++] = *add;
+            added = true;
+        }
+        dst[n++] = src[i];
+    }
+    if (!added) {
+        dst[n++] = *add;
+    }
+    return n;
+}
+
+static uint64_t elapsed_ms(const struct timespec *since, const struct timespec *now) {
+    return (uint64_t)(now->tv_sec - since->tv_sec) * 1000 +
+           (now->tv_nsec - since->tv_nsec) / 1000000;
+}
+
+/** Publish snap and retire the previous snapshot; frees expired ones */
+static void snapshot_publish(index_snapshot_t *snap) {
+    index_snapshot_t *old = g_index.current;
+    __atomic_store_n(&g_index.current, snap, __ATOMIC_RELEASE);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    /* Retired list is newest first, so everything after the first expired
+     * snapshot has expired as well */
+    index_snapshot_t **link = &g_index.retired;
+    while (*link && elapsed_ms(&(*link)->retired_at, &now) < PAGE_INDEX_GRACE_MS) {
+        link = &(*link)->next_retired;
+    }
+    index_snapshot_t *expired = *link;
+    *link = NULL;
+    while (expired) {
+        index_snapshot_t *next = expired->next_retired;
+        free(expired);
+        expired = next;
+    }
+
+    if (old) {
+        old->retired_at = now;
+        old->next_retired = g_index.retired;
+        g_index.retired = old;
+    }
+}
+
+int page_index_insert(page_table_t *table) {
+    if (!table) {
+        return DSM_ERROR_INVALID;
+    }
+
+    index_snapshot_t *old = g_index.current;
+    int old_count = old ? old->count : 0;
+
+    index_snapshot_t *snap = snapshot_alloc(old_count + 1);
+    if (!snap) {
+        LOG_ERROR("Failed to allocate page index (%d tables)", old_count + 1);
+        return DSM_ERROR_MEMORY;
+    }
+
+    index_range_t by_addr = {
+        .start = (uintptr_t)table->base_addr,
+        .end = (uintptr_t)table->base_addr + table->total_size,
+        .table = table
+    };
+    index_range_t by_id = {
+        .start = table->start_page_id,
+        .end = table->start_page_id + table->num_pages,
+        .table = table
+    };
+
+    copy_ranges(snap->by_addr, old ? old->by_addr : NULL, old_count, &by_addr, NULL);
+    copy_ranges(snap->by_id, old ? old->by_id : NULL, old_count, &by_id, NULL);
+
+    snapshot_publish(snap);
+    LOG_DEBUG("Page index: added table %p (%d tables)", (void*)table, snap->count);
+    return DSM_SUCCESS;
+}
+
+int page_index_remove(page_table_t *table) {
+    index_snapshot_t *old = g_index.current;
+    if (!table || !old) {
+        return DSM_ERROR_NOT_FOUND;
+    }
+
+    index_snapshot_t *snap = snapshot_alloc(old->count - 1);
+    if (!snap) {
+        LOG_ERROR("Failed to allocate page index (%d tables)", old->count - 1);
+        return DSM_ERROR_MEMORY;
+    }
+
+    int n = copy_ranges(snap->by_addr, old->by_addr, old->count, NULL, table);
+    if (n != snap->count) {
+        free(snap);
+        return DSM_ERROR_NOT_FOUND;
+    }
+    copy_ranges(snap->by_id, old->by_id, old->count, NULL, table);
+
+    snapshot_publish(snap);
+    LOG_DEBUG("Page index: removed table %p (%d tables)", (void*)table, snap->count);
+    return DSM_SUCCESS;
+}
+
+/** Binary search for the range containing key */
+static const index_range_t* find_range(const index_range_t *ranges, int count, uint64_t key) {
+    /* Find the first range starting after key; the candidate is the one before */
+    int lo = 0, hi = count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (ranges[mid].start <= key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0 || key >= ranges[lo - 1].end) {
+        return NULL;
+    }
+    return &ranges[lo - 1];
+}
+
+page_entry_t* page_index_lookup_addr(void *addr, page_table_t **table) {
+    index_snapshot_t *snap = __atomic_load_n(&g_index.current, __ATOMIC_ACQUIRE);
+    if (!snap || !addr) {
+        return NULL;
+    }
+
+    const index_range_t *range = find_range(snap->by_addr, snap->count, (uintptr_t)addr);
+    if (!range) {
+        return NULL;
+    }
+
+    if (table) {
+        *table = range->table;
+    }
+    return &range->table->entries[((uintptr_t)addr - range->start) / range->table->block_size];
+}
+
+page_entry_t* page_index_lookup_id(page_id_t page_id, page_table_t **table) {
+    index_snapshot_t *snap = __atomic_load_n(&g_index.current, __ATOMIC_ACQUIRE);
+    if (!snap) {
+        return NULL;
+    }
+
+    const index_range_t *range = find_range(snap->by_id, snap->count, page_id);
+    if (!range) {
+        return NULL;
+    }
+
+    if (table) {
+        *table = range->table;
+    }
+    return &range->table->entries[page_id - range->start];
+}
+
+void page_index_cleanup(void) {
+    free(__atomic_exchange_n(&g_index.current, NULL, __ATOMIC_ACQ_REL));
+
+    while (g_index.retired) {
+        index_snapshot_t *next = g_index.retired->next_retired;
+        free(g_index.retired);
+        g_index.retired = next;
+    }
+}
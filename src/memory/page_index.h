@@ -0,0 +1,60 @@
+/**
+ * @file page_index.h
+ * @brief Sorted address and page ID index over all page tables
+ *
+ * The index maps a faulting address or a global page ID to its page table
+ * in O(log n) without taking any lock, so it is safe to use from the
+ * SIGSEGV handler. Readers binary-search an immutable snapshot; writers
+ * (holding ctx->lock) publish a rebuilt snapshot and retire the old one,
+ * which is only freed after a grace period.
+ */
+
+#ifndef PAGE_INDEX_H
+#define PAGE_INDEX_H
+
+#include "page_table.h"
+
+/**
+ * Add a page table to the index
+ * Caller must hold ctx->lock
+ *
+ * @param table Page table to add
+ * @return DSM_SUCCESS on success, DSM_ERROR_MEMORY on failure
+ */
+int page_index_insert(page_table_t *table);
+
+/**
+ * Remove a page table from the index
+ * Caller must hold ctx->lock. Lookups that raced the removal may still
+ * return the table until the grace period expires.
+ *
+ * @param table Page table to remove
+ * @return DSM_SUCCESS on success, error code on failure
+ */
+int page_index_remove(page_table_t *table);
+
+/**
+ * Find the page entry covering an address (lock-free, async-signal-safe)
+ *
+ * @param addr Address inside a DSM allocation
+ * @param table Output: owning page table (may be NULL)
+ * @return Page entry, or NULL if addr is not in any allocation
+ */
+page_entry_t* page_index_lookup_addr(void *addr, page_table_t **table);
+
+/**
+ * Find the page entry for a global page ID (lock-free, async-signal-safe)
+ *
+ * @param page_id Global page identifier
+ * @param table Output: owning page table (may be NULL)
+ * @return Page entry, or NULL if no allocation holds page_id
+ */
+page_entry_t* page_index_lookup_id(page_id_t page_id, page_table_t **table);
+
+/**
+ * Free the index and every retired snapshot
+ * Only call once no fault or handler can be running
+ */
+void page_index_cleanup(void);
+
+#endif /* PAGE_INDEX_H */
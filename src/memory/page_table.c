@@ -8,15 +8,35 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <sys/mman.h>
+
+_Static_assert(sizeof(page_entry_t) <= 64, "page_entry_t must fit in one cache line");
+
+/* Statically initialized: creating a table touches no wait object */
+page_wait_bucket_t g_page_wait_buckets[PAGE_WAIT_BUCKETS] = {
+    [0 ... PAGE_WAIT_BUCKETS - 1] = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .ready_cv = PTHREAD_COND_INITIALIZER,
+        .inv_ack_cv = PTHREAD_COND_INITIALIZER,
+    },
+};
+
+bool page_block_size_valid(size_t block_size) {
+    return block_size >= PAGE_SIZE && block_size <= DSM_MAX_BLOCK_SIZE &&
+           (block_size & (block_size - 1)) == 0;
+}
 
-page_table_t* page_table_create(void *base_addr, size_t size, node_id_t node_id, int allocation_index) {
-    if (!base_addr || size == 0) {
-        LOG_ERROR("Invalid parameters: base_addr=%p, size=%zu", base_addr, size);
+page_table_t* page_table_create(void *base_addr, size_t size, node_id_t node_id, int allocation_index,
+                                size_t block_size) {
+    if (!base_addr || size == 0 || !page_block_size_valid(block_size)) {
+        LOG_ERROR("Invalid parameters: base_addr=%p, size=%zu, block_size=%zu",
+                  base_addr, size, block_size);
         return NULL;
     }
 
-    if (allocation_index < 0 || allocation_index >= 32) {
-        LOG_ERROR("Invalid allocation_index: %d (must be 0-31)", allocation_index);
+    if (allocation_index < 0 || allocation_index >= PAGE_ID_MAX_ALLOCATIONS) {
+        LOG_ERROR("Invalid allocation_index: %d (must be 0-%d)",
+                  allocation_index, PAGE_ID_MAX_ALLOCATIONS - 1);
         return NULL;
     }
 
@@ -28,17 +48,17 @@ page_table_t* page_table_create(void *base_addr, size_t size, node_id_t node_id,
 
     table->base_addr = base_addr;
     table->total_size = size;
-    table->num_pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    table->block_size = block_size;
+    table->num_pages = (size + block_size - 1) / block_size;
 
-    /* Each node gets 1M page IDs, divided into 32 allocation slots of ~31,250 pages each
-     * This allows up to 32 allocations per node with unique page IDs
-     * Each allocation can have up to ~31,250 pages (128MB with 4KB pages) */
-    table->start_page_id = (page_id_t)node_id * 1000000 + allocation_index * 31250;
+    /* Page IDs are [node | allocation | page] bit fields (see page_table.h), so
+     * every allocation a node makes gets its own range of PAGE_ID_MAX_PAGES IDs */
+    table->start_page_id = PAGE_ID_BASE(node_id, allocation_index);
 
     /* Verify allocation doesn't exceed the page ID space for this allocation slot */
-    if (table->num_pages > 31250) {
-        LOG_ERROR("Allocation too large: %zu pages exceeds limit of 31,250 pages per allocation",
-                  table->num_pages);
+    if (table->num_pages > PAGE_ID_MAX_PAGES) {
+        LOG_ERROR("Allocation too large: %zu pages exceeds limit of %llu pages per allocation",
+                  table->num_pages, (unsigned long long)PAGE_ID_MAX_PAGES);
         free(table);
         return NULL;
     }
@@ -52,33 +72,39 @@ page_table_t* page_table_create(void *base_addr, size_t size, node_id_t node_id,
 
     pthread_mutex_init(&table->lock, NULL);
     table->refcount = 1;  /* Initial reference held by creator */
+    table->compression = DSM_COMPRESSION_NONE;
+    table->placement = DSM_PLACEMENT_LOCAL;
 
     /* Initialize all entries with globally unique page IDs */
     for (size_t i = 0; i < table->num_pages; i++) {
         table->entries[i].id = table->start_page_id + i;
-        table->entries[i].local_addr = (char*)base_addr + (i * PAGE_SIZE);
+        table->entries[i].local_addr = (char*)base_addr + (i * block_size);
         table->entries[i].owner = node_id;
+        table->entries[i].home = node_id;
         table->entries[i].state = PAGE_STATE_INVALID;
         table->entries[i].version = 0;
         table->entries[i].is_allocated = true;
         table->entries[i].request_pending = false;
+        table->entries[i].prefetch_pending = false;
+        table->entries[i].fetch_invalidated = false;
+        table->entries[i].handed_over = false;
+        table->entries[i].reads_served = 0;
         table->entries[i].num_waiting_threads = 0;
         table->entries[i].fetch_result = DSM_SUCCESS;  /* Initialize to success */
         table->entries[i].pending_inv_acks = 0;
-        pthread_cond_init(&table->entries[i].ready_cv, NULL);
-        pthread_cond_init(&table->entries[i].inv_ack_cv, NULL);
-        pthread_mutex_init(&table->entries[i].entry_lock, NULL);
     }
 
-    LOG_INFO("Page table created: base=%p, size=%zu, pages=%zu, id_range=%lu-%lu",
-             base_addr, size, table->num_pages, table->start_page_id,
+    LOG_INFO("Page table created: base=%p, size=%zu, pages=%zu of %zu bytes, id_range=%lu-%lu",
+             base_addr, size, table->num_pages, block_size, table->start_page_id,
              table->start_page_id + table->num_pages - 1);
     return table;
 }
 
-page_table_t* page_table_create_remote(void *base_addr, size_t size, node_id_t owner, page_id_t start_page_id) {
-    if (!base_addr || size == 0) {
-        LOG_ERROR("Invalid parameters: base_addr=%p, size=%zu", base_addr, size);
+page_table_t* page_table_create_remote(void *base_addr, size_t size, node_id_t owner, page_id_t start_page_id,
+                                       size_t block_size) {
+    if (!base_addr || size == 0 || !page_block_size_valid(block_size)) {
+        LOG_ERROR("Invalid parameters: base_addr=%p, size=%zu, block_size=%zu",
+                  base_addr, size, block_size);
         return NULL;
     }
 
@@ -90,7 +116,8 @@ page_table_t* page_table_create_remote(void *base_addr, size_t size, node_id_t o
 
     table->base_addr = base_addr;
     table->total_size = size;
-    table->num_pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    table->block_size = block_size;
+    table->num_pages = (size + block_size - 1) / block_size;
     table->start_page_id = start_page_id;  /* Use remote node's page IDs */
 
     table->entries = calloc(table->num_pages, sizeof(page_entry_t));
@@ -102,30 +129,66 @@ page_table_t* page_table_create_remote(void *base_addr, size_t size, node_id_t o
 
     pthread_mutex_init(&table->lock, NULL);
     table->refcount = 1;
+    table->compression = DSM_COMPRESSION_NONE;
+    table->placement = DSM_PLACEMENT_LOCAL;
 
     /* Initialize all entries with remote page IDs and owner */
     for (size_t i = 0; i < table->num_pages; i++) {
         table->entries[i].id = start_page_id + i;
-        table->entries[i].local_addr = (char*)base_addr + (i * PAGE_SIZE);
+        table->entries[i].local_addr = (char*)base_addr + (i * block_size);
         table->entries[i].owner = owner;  /* Remote owner */
+        table->entries[i].home = owner;
         table->entries[i].state = PAGE_STATE_INVALID;  /* Start invalid, will fetch on fault */
         table->entries[i].version = 0;
         table->entries[i].is_allocated = true;
         table->entries[i].request_pending = false;
+        table->entries[i].prefetch_pending = false;
+        table->entries[i].fetch_invalidated = false;
+        table->entries[i].handed_over = false;
+        table->entries[i].reads_served = 0;
         table->entries[i].num_waiting_threads = 0;
         table->entries[i].fetch_result = DSM_SUCCESS;  /* Initialize to success */
         table->entries[i].pending_inv_acks = 0;
-        pthread_cond_init(&table->entries[i].ready_cv, NULL);
-        pthread_cond_init(&table->entries[i].inv_ack_cv, NULL);
-        pthread_mutex_init(&table->entries[i].entry_lock, NULL);
     }
 
-    LOG_INFO("Remote page table created: base=%p, size=%zu, pages=%zu, id_range=%lu-%lu (owner=node %u)",
-             base_addr, size, table->num_pages, start_page_id,
+    LOG_INFO("Remote page table created: base=%p, size=%zu, pages=%zu of %zu bytes, id_range=%lu-%lu (owner=node %u)",
+             base_addr, size, table->num_pages, block_size, start_page_id,
              start_page_id + table->num_pages - 1, owner);
     return table;
 }
 
+node_id_t page_placement_owner(dsm_placement_t placement, node_id_t home, size_t index,
+                               size_t num_pages, int num_nodes) {
+    /* Alone, every node is the whole cluster, whatever its ID */
+    if (num_nodes <= 1 && placement != DSM_PLACEMENT_FIRST_TOUCH) {
+        return home;
+    }
+
+    switch (placement) {
+        case DSM_PLACEMENT_BLOCK: {
+            size_t run = (num_pages + (size_t)num_nodes - 1) / (size_t)num_nodes;
+            return (node_id_t)(index / run);
+        }
+        case DSM_PLACEMENT_CYCLIC:
+            return (node_id_t)(index % (size_t)num_nodes);
+        case DSM_PLACEMENT_FIRST_TOUCH:
+            return DSM_NODE_NONE;
+        case DSM_PLACEMENT_LOCAL:
+        case DSM_PLACEMENT_HOME:
+        default:
+            return home;
+    }
+}
+
+void page_table_place(page_table_t *table, dsm_placement_t placement, node_id_t home, int num_nodes) {
+    table->placement = placement;
+    for (size_t i = 0; i < table->num_pages; i++) {
+        node_id_t owner = page_placement_owner(placement, home, i, table->num_pages, num_nodes);
+        table->entries[i].owner = owner;
+        table->entries[i].home = owner;
+    }
+}
+
 void page_table_destroy(page_table_t *table) {
     if (!table) {
         return;
@@ -133,9 +196,9 @@ void page_table_destroy(page_table_t *table) {
 
     if (table->entries) {
         for (size_t i = 0; i < table->num_pages; i++) {
-            pthread_cond_destroy(&table->entries[i].ready_cv);
-            pthread_cond_destroy(&table->entries[i].inv_ack_cv);
-            pthread_mutex_destroy(&table->entries[i].entry_lock);
+            if (table->entries[i].twin) {
+                munmap(table->entries[i].twin, table->block_size);
+            }
         }
         free(table->entries);
     }
@@ -187,7 +250,7 @@ page_entry_t* page_table_lookup_by_addr(page_table_t *table, void *addr) {
 
     /* Calculate page index */
     size_t offset = (char*)addr - (char*)table->base_addr;
-    size_t page_idx = offset / PAGE_SIZE;
+    size_t page_idx = offset / table->block_size;
 
     if (page_idx >= table->num_pages) {
         return NULL;
@@ -255,7 +318,7 @@ page_id_t page_addr_to_id(page_table_t *table, void *addr) {
     }
 
     size_t offset = (char*)addr - (char*)table->base_addr;
-    return table->start_page_id + (offset / PAGE_SIZE);
+    return table->start_page_id + (offset / table->block_size);
 }
 
 void* page_id_to_addr(page_table_t *table, page_id_t page_id) {
@@ -271,5 +334,5 @@ void* page_id_to_addr(page_table_t *table, page_id_t page_id) {
 
     /* Convert global page ID to local index */
     size_t local_idx = page_id - table->start_page_id;
-    return (char*)table->base_addr + (local_idx * PAGE_SIZE);
+    return (char*)table->base_addr + (local_idx * table->block_size);
 }
@@ -11,6 +11,34 @@
 
 #include "dsm/types.h"
 #include <pthread.h>
+#include <stdint.h>
+
+/* ============================ */
+/*       Page ID Layout         */
+/* ============================ */
+
+/*
+ * Global page IDs are [node_id | allocation_index | page_index]:
+ * bits 40-63 hold the creating node, bits 20-39 the node-local allocation
+ * index and bits 0-19 the page within the allocation.
+ */
+#define PAGE_ID_ALLOC_SHIFT 20
+#define PAGE_ID_NODE_SHIFT 40
+
+/** Pages per allocation (4GB with 4KB pages) */
+#define PAGE_ID_MAX_PAGES (1ULL << PAGE_ID_ALLOC_SHIFT)
+/** Allocations per node over the node's lifetime */
+#define PAGE_ID_MAX_ALLOCATIONS (1 << (PAGE_ID_NODE_SHIFT - PAGE_ID_ALLOC_SHIFT))
+
+/** First page ID of a node's allocation */
+#define PAGE_ID_BASE(node_id, alloc_index) \
+    (((page_id_t)(node_id) << PAGE_ID_NODE_SHIFT) | ((page_id_t)(alloc_index) << PAGE_ID_ALLOC_SHIFT))
+
+/** Node that created the allocation a page ID belongs to */
+#define PAGE_ID_NODE(page_id) ((node_id_t)((page_id) >> PAGE_ID_NODE_SHIFT))
+
+/** Node field of dsm_malloc_collective() regions, whose pages no single node created */
+#define PAGE_ID_COLLECTIVE_NODE ((node_id_t)((1ULL << (64 - PAGE_ID_NODE_SHIFT)) - 1))
 
 /* ============================ */
 /*     Page Entry Structure     */
@@ -19,28 +47,87 @@
 /**
  * Single page table entry
  *
- * Tracks the state and metadata for one page in the DSM system.
+ * Tracks the state and metadata for one page in the DSM system. A DSM
+ * "page" is the allocation's coherence block: table->block_size bytes,
+ * one or more OS pages that are fetched, protected and invalidated
+ * together under one page ID.
+ *
+ * Entries hold no synchronization objects of their own: the lock and
+ * condition variables of an entry are those of the wait bucket it hashes
+ * to (see page_entry_lock()), so an entry fits in one cache line and a
+ * table needs no per-page initialization.
  */
 typedef struct {
     page_id_t id;              /**< Unique page identifier */
     void *local_addr;          /**< Local virtual address */
-    node_id_t owner;           /**< Current owner node */
-    page_state_t state;        /**< Current state (INVALID/READ_ONLY/READ_WRITE) */
     uint64_t version;          /**< Version number for consistency */
-    bool is_allocated;         /**< True if entry is in use */
 
-    /* For request queuing (Task 8.1) */
-    bool request_pending;      /**< True if page transfer in progress */
+    /* Release consistency, guarded by page_entry_lock() */
+    void *twin;                /**< Copy of the block taken at the first write since the last release, or NULL */
+
+    node_id_t owner;           /**< Current owner node (DSM_NODE_NONE: first-touch page not yet claimed) */
+    node_id_t home;            /**< Initial owner: the master copy under release consistency */
+    page_state_t state;        /**< Current state (INVALID/READ_ONLY/READ_WRITE) */
+
+    /* For request queuing (Task 8.1), guarded by page_entry_lock() */
     int num_waiting_threads;   /**< Number of threads waiting for this page */
     int fetch_result;          /**< Result of fetch operation (DSM_SUCCESS or error code) */
-    pthread_cond_t ready_cv;   /**< Condition variable for waiting threads */
-    pthread_mutex_t entry_lock;/**< Per-entry lock for finer-grained locking */
 
-    /* For invalidation ACK tracking */
-    int pending_inv_acks;      /**< Number of pending invalidation ACKs */
-    pthread_cond_t inv_ack_cv; /**< Condition variable for waiting on ACKs */
+    /* For invalidation ACK tracking, guarded by page_entry_lock() */
+    uint32_t reads_served;     /**< Read copies served as the owner */
+    int16_t pending_inv_acks;  /**< Number of pending invalidation ACKs (at most MAX_SHARERS) */
+
+    bool is_allocated;         /**< True if entry is in use */
+    bool request_pending;      /**< True if page transfer in progress */
+    bool prefetch_pending;     /**< True if a prefetch of the page is in flight (nobody waits on it yet) */
+    bool fetch_invalidated;    /**< An INVALIDATE arrived during this read fetch (guarded by page_entry_lock()) */
+    bool mapped;               /**< userfaultfd engine: block mapped since it was last dropped (guarded by table lock) */
+    bool handed_over;          /**< Handed to a writer, no copy fetched since (guarded by page_entry_lock()) */
 } page_entry_t;
 
+/* ============================ */
+/*       Page Wait Buckets      */
+/* ============================ */
+
+/** Wait buckets page entries hash to (a power of two) */
+#define PAGE_WAIT_BUCKETS 1024
+
+/**
+ * Lock and condition variables shared by the entries hashing to it
+ *
+ * Waiters on one condition variable may be waiting for different pages,
+ * so every wait rechecks its own entry's flag and every wake-up is a
+ * broadcast. No thread holds two entry locks at once, so two entries
+ * sharing a bucket cannot deadlock.
+ */
+typedef struct {
+    pthread_mutex_t lock;      /**< Entry lock */
+    pthread_cond_t ready_cv;   /**< Signalled when a fetch or prefetch completes */
+    pthread_cond_t inv_ack_cv; /**< Signalled when an entry's invalidation ACKs are all in */
+} __attribute__((aligned(64))) page_wait_bucket_t;
+
+extern page_wait_bucket_t g_page_wait_buckets[PAGE_WAIT_BUCKETS];
+
+/** Wait bucket of an entry; consecutive entries get consecutive buckets */
+static inline page_wait_bucket_t *page_wait_bucket(const page_entry_t *entry) {
+    return &g_page_wait_buckets[((uintptr_t)entry / sizeof(page_entry_t)) & (PAGE_WAIT_BUCKETS - 1)];
+}
+
+/** Lock guarding an entry's request, ACK and twin fields */
+static inline pthread_mutex_t *page_entry_lock(const page_entry_t *entry) {
+    return &page_wait_bucket(entry)->lock;
+}
+
+/** Condition variable for threads waiting for an entry's page to arrive */
+static inline pthread_cond_t *page_entry_ready_cv(const page_entry_t *entry) {
+    return &page_wait_bucket(entry)->ready_cv;
+}
+
+/** Condition variable for a thread waiting for an entry's invalidation ACKs */
+static inline pthread_cond_t *page_entry_inv_ack_cv(const page_entry_t *entry) {
+    return &page_wait_bucket(entry)->inv_ack_cv;
+}
+
 /* ============================ */
 /*     Page Table Structure     */
 /* ============================ */
@@ -54,27 +141,40 @@ typedef struct {
 typedef struct {
     void *base_addr;           /**< Base virtual address of DSM region */
     size_t total_size;         /**< Total size in bytes */
-    size_t num_pages;          /**< Number of pages */
+    size_t num_pages;          /**< Number of pages (coherence blocks) */
     page_id_t start_page_id;   /**< First global page ID for this table */
     page_entry_t *entries;     /**< Array of page entries */
     pthread_mutex_t lock;      /**< Mutex for thread-safe access */
     int refcount;              /**< Reference count to prevent premature destruction */
+    dsm_compression_t compression; /**< How this allocation's pages are sent (set at creation) */
+    size_t block_size;         /**< Bytes per page: a power-of-two multiple of PAGE_SIZE */
+    dsm_placement_t placement; /**< How the initial owners were chosen (set at creation) */
 } page_table_t;
 
 /* ============================ */
 /*     Function Declarations    */
 /* ============================ */
 
+/**
+ * Check a coherence block size
+ *
+ * @param block_size Bytes per page
+ * @return true for a power-of-two multiple of PAGE_SIZE up to DSM_MAX_BLOCK_SIZE
+ */
+bool page_block_size_valid(size_t block_size);
+
 /**
  * Create a new page table
  *
  * @param base_addr Base address of DSM region
  * @param size Total size of region in bytes
  * @param node_id Node ID for globally unique page ID assignment
- * @param allocation_index Index of this allocation (0-31) for unique page ID assignment
+ * @param allocation_index Index of this allocation (0..PAGE_ID_MAX_ALLOCATIONS-1) for unique page ID assignment
+ * @param block_size Bytes per page (see page_block_size_valid())
  * @return Pointer to page table, or NULL on failure
  */
-page_table_t* page_table_create(void *base_addr, size_t size, node_id_t node_id, int allocation_index);
+page_table_t* page_table_create(void *base_addr, size_t size, node_id_t node_id, int allocation_index,
+                                size_t block_size);
 
 /**
  * Create a page table for a remote allocation (SVAS)
@@ -86,9 +186,37 @@ page_table_t* page_table_create(void *base_addr, size_t size, node_id_t node_id,
  * @param size Total size of region in bytes
  * @param owner Remote owner node ID
  * @param start_page_id Starting page ID from remote node
+ * @param block_size Bytes per page, as on the owner
  * @return Pointer to page table, or NULL on failure
  */
-page_table_t* page_table_create_remote(void *base_addr, size_t size, node_id_t owner, page_id_t start_page_id);
+page_table_t* page_table_create_remote(void *base_addr, size_t size, node_id_t owner, page_id_t start_page_id,
+                                       size_t block_size);
+
+/**
+ * Initial owner of one page of an allocation
+ *
+ * Every node computes this from the same ALLOC_NOTIFY fields, so all
+ * page tables and directories agree on it.
+ *
+ * @param placement Placement policy
+ * @param home Allocating node, or the home node for DSM_PLACEMENT_HOME
+ * @param index Page index within the allocation
+ * @param num_pages Pages in the allocation
+ * @param num_nodes Nodes the pages are spread over
+ * @return Owner node, or DSM_NODE_NONE for DSM_PLACEMENT_FIRST_TOUCH
+ */
+node_id_t page_placement_owner(dsm_placement_t placement, node_id_t home, size_t index,
+                               size_t num_pages, int num_nodes);
+
+/**
+ * Set the initial owner and home of every page of a new table
+ *
+ * @param table Page table not yet published to other threads
+ * @param placement Placement policy
+ * @param home Allocating node, or the home node for DSM_PLACEMENT_HOME
+ * @param num_nodes Nodes the pages are spread over
+ */
+void page_table_place(page_table_t *table, dsm_placement_t placement, node_id_t home, int num_nodes);
 
 /**
  * Destroy a page table
@@ -117,7 +245,7 @@ void page_table_release(page_table_t *table);
  * Look up page entry by virtual address
  *
  * @param table Page table
- * @param addr Virtual address (will be aligned to page boundary)
+ * @param addr Any address within the page's block
  * @return Pointer to page entry, or NULL if not found
  */
 page_entry_t* page_table_lookup_by_addr(page_table_t *table, void *addr);
@@ -152,10 +280,10 @@ int page_table_set_owner(page_table_t *table, page_id_t page_id, node_id_t owner
 int page_table_set_state(page_table_t *table, page_id_t page_id, page_state_t state);
 
 /**
- * Get page base address (align address to page boundary)
+ * Get OS page base address (align address to a PAGE_SIZE boundary)
  *
  * @param addr Any address within a page
- * @return Base address of the page
+ * @return Base address of the OS page
  */
 void* page_get_base_addr(void *addr);
 
@@ -5,12 +5,25 @@
 
 #include "permission.h"
 #include "page_table.h"
+#include "page_index.h"
+#include "userfault.h"
 #include "../core/log.h"
 #include "../core/dsm_context.h"
+#include "../core/stats.h"
 #include <sys/mman.h>
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 
+/* Per-node version counter; see page_next_version() */
+static uint64_t g_version_counter = 0;
+
+uint64_t page_next_version(void) {
+    dsm_context_t *ctx = dsm_get_context();
+    uint64_t n = __atomic_add_fetch(&g_version_counter, 1, __ATOMIC_RELAXED);
+    return (n << 16) | (ctx->node_id & 0xFFFF);
+}
+
 int get_prot_flags(page_perm_t perm) {
     switch (perm) {
         case PAGE_PERM_NONE:
@@ -24,6 +37,28 @@ int get_prot_flags(page_perm_t perm) {
     }
 }
 
+/**
+ * Record the state a permission grants (set_page_permission())
+ */
+static void update_entry_state(page_table_t *table, page_entry_t *entry, page_perm_t perm) {
+    pthread_mutex_lock(&table->lock);
+
+    switch (perm) {
+        case PAGE_PERM_NONE:
+            entry->state = PAGE_STATE_INVALID;
+            break;
+        case PAGE_PERM_READ:
+            entry->state = PAGE_STATE_READ_ONLY;
+            break;
+        case PAGE_PERM_READ_WRITE:
+            entry->state = PAGE_STATE_READ_WRITE;
+            entry->version = page_next_version();
+            break;
+    }
+
+    pthread_mutex_unlock(&table->lock);
+}
+
 int set_page_permission(void *addr, page_perm_t perm) {
     if (!addr) {
         LOG_ERROR("NULL address");
@@ -36,50 +71,39 @@ int set_page_permission(void *addr, page_perm_t perm) {
         return DSM_ERROR_INIT;
     }
 
-    /* Align to page boundary */
+    /* Find the page entry for this address */
+    page_entry_t *entry = NULL;
+    page_table_t *owning_table = NULL;
+    pthread_mutex_lock(&ctx->lock);
+    entry = page_index_lookup_addr(addr, &owning_table);
+    pthread_mutex_unlock(&ctx->lock);
+
+    /* Under userfaultfd the mapping, not the protection, carries the state */
+    if (entry && owning_table && userfault_active()) {
+        return userfault_set_permission(owning_table, entry, perm);
+    }
+
+    /* A DSM page is its allocation's whole coherence block; anything else
+     * is protected one OS page at a time */
     void *page_base = page_get_base_addr(addr);
+    size_t len = PAGE_SIZE;
+    if (entry && owning_table) {
+        page_base = entry->local_addr;
+        len = owning_table->block_size;
+    }
 
     /* Get protection flags */
     int prot = get_prot_flags(perm);
 
     /* Change permissions */
-    if (mprotect(page_base, PAGE_SIZE, prot) != 0) {
+    if (mprotect(page_base, len, prot) != 0) {
         LOG_ERROR("mprotect failed: %s", strerror(errno));
         return DSM_ERROR_PERMISSION;
     }
 
-    /* Search all page tables for this address */
-    page_entry_t *entry = NULL;
-    page_table_t *owning_table = NULL;
-    pthread_mutex_lock(&ctx->lock);
-    for (int i = 0; i < ctx->num_allocations; i++) {
-        if (ctx->page_tables[i]) {
-            entry = page_table_lookup_by_addr(ctx->page_tables[i], page_base);
-            if (entry) {
-                owning_table = ctx->page_tables[i];
-                break;
-            }
-        }
-    }
-    pthread_mutex_unlock(&ctx->lock);
-
     /* Update page table state */
     if (entry && owning_table) {
-        pthread_mutex_lock(&owning_table->lock);
-
-        switch (perm) {
-            case PAGE_PERM_NONE:
-                entry->state = PAGE_STATE_INVALID;
-                break;
-            case PAGE_PERM_READ:
-                entry->state = PAGE_STATE_READ_ONLY;
-                break;
-            case PAGE_PERM_READ_WRITE:
-                entry->state = PAGE_STATE_READ_WRITE;
-                break;
-        }
-
-        pthread_mutex_unlock(&owning_table->lock);
+        update_entry_state(owning_table, entry, perm);
 
         LOG_DEBUG("Page %p permission set to %d (state=%d)",
                   page_base, perm, entry->state);
@@ -87,3 +111,106 @@ int set_page_permission(void *addr, page_perm_t perm) {
 
     return DSM_SUCCESS;
 }
+
+int sync_page_protection(page_table_t *table, page_entry_t *entry) {
+    if (userfault_active()) {
+        return DSM_SUCCESS;
+    }
+
+    pthread_mutex_lock(&table->lock);
+    page_state_t state = entry->state;
+    pthread_mutex_unlock(&table->lock);
+
+    page_perm_t perm = state == PAGE_STATE_READ_WRITE ? PAGE_PERM_READ_WRITE :
+                       state == PAGE_STATE_READ_ONLY ? PAGE_PERM_READ : PAGE_PERM_NONE;
+    if (mprotect(entry->local_addr, table->block_size, get_prot_flags(perm)) != 0) {
+        LOG_ERROR("mprotect failed: %s", strerror(errno));
+        return DSM_ERROR_PERMISSION;
+    }
+    return DSM_SUCCESS;
+}
+
+/* ============================ */
+/*       Permission Batches     */
+/* ============================ */
+
+void perm_batch_init(perm_batch_t *batch) {
+    batch->ranges = NULL;
+    batch->count = 0;
+    batch->capacity = 0;
+}
+
+int perm_batch_add(perm_batch_t *batch, page_table_t *table, page_entry_t *entry, page_perm_t perm) {
+    if (userfault_active()) {
+        return userfault_set_permission(table, entry, perm);
+    }
+
+    uintptr_t start = (uintptr_t)entry->local_addr;
+    perm_range_t *last = batch->count > 0 ? &batch->ranges[batch->count - 1] : NULL;
+    if (last && last->perm == perm && last->start + last->len == start) {
+        /* Pages are usually added in address order */
+        last->len += table->block_size;
+    } else {
+        if (batch->count == batch->capacity) {
+            int capacity = batch->capacity > 0 ? batch->capacity * 2 : 64;
+            perm_range_t *grown = realloc(batch->ranges, (size_t)capacity * sizeof(perm_range_t));
+            if (!grown) {
+                return set_page_permission(entry->local_addr, perm);
+            }
+            batch->ranges = grown;
+            batch->capacity = capacity;
+        }
+        batch->ranges[batch->count++] = (perm_range_t){ .start = start, .len = table->block_size,
+                                                        .perm = perm };
+    }
+
+    update_entry_state(table, entry, perm);
+    STATS_INC(batched_pages);
+    return DSM_SUCCESS;
+}
+
+static int compare_ranges(const void *a, const void *b) {
+    uintptr_t x = ((const perm_range_t *)a)->start;
+    uintptr_t y = ((const perm_range_t *)b)->start;
+    return (x > y) - (x < y);
+}
+
+int perm_batch_apply(perm_batch_t *batch) {
+    if (batch->count == 0) {
+        return DSM_SUCCESS;
+    }
+
+    /* Runs added out of order may still adjoin */
+    qsort(batch->ranges, (size_t)batch->count, sizeof(perm_range_t), compare_ranges);
+    int merged = 0;
+    for (int i = 1; i < batch->count; i++) {
+        perm_range_t *run = &batch->ranges[merged];
+        const perm_range_t *next = &batch->ranges[i];
+        if (next->perm == run->perm && run->start + run->len == next->start) {
+            run->len += next->len;
+        } else {
+            batch->ranges[++merged] = *next;
+        }
+    }
+    batch->count = merged + 1;
+
+    int result = DSM_SUCCESS;
+    for (int i = 0; i < batch->count; i++) {
+        const perm_range_t *run = &batch->ranges[i];
+        if (mprotect((void *)run->start, run->len, get_prot_flags(run->perm)) != 0) {
+            LOG_ERROR("mprotect of %zu bytes at %p failed: %s",
+                      run->len, (void *)run->start, strerror(errno));
+            result = DSM_ERROR_PERMISSION;
+        }
+    }
+
+    STATS_ADD(batched_mprotects, batch->count);
+    LOG_DEBUG("Applied permission batch as %d mprotect calls", batch->count);
+    batch->count = 0;
+    return result;
+}
+
+void perm_batch_destroy(perm_batch_t *batch) {
+    free(batch->ranges);
+    perm_batch_init(batch);
+}
@@ -7,15 +7,92 @@
 #define PERMISSION_H
 
 #include "dsm/types.h"
+#include "page_table.h"
+#include <stdint.h>
 
 /**
  * Set page permission
+ *
+ * Applies to the whole coherence block of the DSM page containing addr.
+ * Granting PAGE_PERM_READ_WRITE starts a new version of the page, since
+ * its contents may change from then on.
  */
 int set_page_permission(void *addr, page_perm_t perm);
 
+/**
+ * Allocate a page version number
+ *
+ * Versions are unique across nodes (node ID in the low 16 bits), so two
+ * copies of a page with the same nonzero version hold the same bytes.
+ * 0 is never returned: it means "no valid copy".
+ */
+uint64_t page_next_version(void);
+
 /**
  * Get PROT flags from page_perm_t
  */
 int get_prot_flags(page_perm_t perm);
 
+/**
+ * Reapply the protection a page's state grants, without a new version
+ * Repairs a page whose batched downgrade landed after it was granted
+ * access again. No-op under userfaultfd, where the mapping is the state.
+ */
+int sync_page_protection(page_table_t *table, page_entry_t *entry);
+
+/* ============================ */
+/*       Permission Batches     */
+/* ============================ */
+
+/**
+ * One run of contiguous memory given the same protection
+ */
+typedef struct {
+    uintptr_t start;   /**< First byte */
+    size_t len;        /**< Bytes */
+    page_perm_t perm;  /**< Protection */
+} perm_range_t;
+
+/**
+ * Permission changes of many pages, applied with one mprotect() per run
+ *
+ * perm_batch_add() changes a page's state at once; perm_batch_apply()
+ * issues the protections. Until then a downgraded page can still be
+ * accessed, so callers apply the batch before relying on the downgrade,
+ * and hold references on the pages' tables until it is applied.
+ */
+typedef struct {
+    perm_range_t *ranges; /**< Runs collected so far */
+    int count;            /**< Runs in use */
+    int capacity;         /**< Runs allocated */
+} perm_batch_t;
+
+/**
+ * Start an empty batch
+ */
+void perm_batch_init(perm_batch_t *batch);
+
+/**
+ * Set a page's permission as part of a batch
+ *
+ * The state changes now (as set_page_permission() would change it) and
+ * the protection at perm_batch_apply(). Under userfaultfd, or if the batch
+ * cannot grow, the permission is applied immediately instead.
+ *
+ * @return DSM_SUCCESS, or DSM_ERROR_PERMISSION
+ */
+int perm_batch_add(perm_batch_t *batch, page_table_t *table, page_entry_t *entry, page_perm_t perm);
+
+/**
+ * Apply and empty a batch, merging runs that adjoin
+ *
+ * @return DSM_SUCCESS, or DSM_ERROR_PERMISSION if any mprotect() failed
+ */
+int perm_batch_apply(perm_batch_t *batch);
+
+/**
+ * Free a batch's memory (after perm_batch_apply())
+ */
+void perm_batch_destroy(perm_batch_t *batch);
+
 #endif /* PERMISSION_H */
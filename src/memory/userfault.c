@@ -0,0 +1,367 @@
+/**
+ * @file userfault.c
+ * @brief userfaultfd fault engine implementation
+ */
+
+#define _GNU_SOURCE
+#include "userfault.h"
+#include "fault_handler.h"
+#include "page_index.h"
+#include "permission.h"
+#include "../core/log.h"
+#include <linux/userfaultfd.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Fault messages read from the userfaultfd at once */
+#define USERFAULT_MSG_BATCH 16
+
+/** ioctls a registered region must support */
+#define USERFAULT_RANGE_IOCTLS ((1ULL << _UFFDIO_COPY) | (1ULL << _UFFDIO_WRITEPROTECT) | \
+                                (1ULL << _UFFDIO_WAKE))
+
+static struct {
+    int fd;                                   /**< userfaultfd, -1 when inactive */
+    int stop_pipe[2];                         /**< Written once to stop the fault threads */
+    pthread_t threads[USERFAULT_MAX_THREADS]; /**< Fault threads */
+    int num_threads;                          /**< Fault threads started */
+    bool active;                              /**< Regions fault through the userfaultfd */
+} g_uffd = { .fd = -1, .stop_pipe = { -1, -1 } };
+
+/* Source of zero-filled blocks (never written, so it stays on the zero page) */
+static uint8_t g_zero_block[DSM_MAX_BLOCK_SIZE];
+
+/* ============================ */
+/*       Block Mapping          */
+/* ============================ */
+
+/**
+ * Write-protect a mapped range or lift its protection
+ * Lifting it does not wake faulting threads: a fetch is complete only once
+ * its fault thread has also updated the directory, so that thread wakes them.
+ */
+static int write_protect(void *addr, size_t len, bool protect) {
+    struct uffdio_writeprotect wp = {
+        .range = { .start = (uintptr_t)addr, .len = len },
+        .mode = protect ? UFFDIO_WRITEPROTECT_MODE_WP : UFFDIO_WRITEPROTECT_MODE_DONTWAKE,
+    };
+    if (ioctl(g_uffd.fd, UFFDIO_WRITEPROTECT, &wp) != 0) {
+        LOG_ERROR("UFFDIO_WRITEPROTECT failed at %p: %s", addr, strerror(errno));
+        return DSM_ERROR_PERMISSION;
+    }
+    return DSM_SUCCESS;
+}
+
+static void wake_range(void *addr, size_t len) {
+    struct uffdio_range range = { .start = (uintptr_t)addr, .len = len };
+    if (ioctl(g_uffd.fd, UFFDIO_WAKE, &range) != 0) {
+        LOG_WARN("UFFDIO_WAKE failed at %p: %s", addr, strerror(errno));
+    }
+}
+
+/**
+ * Map a block that is not mapped yet, write-protected or not
+ * Faulting threads are not woken; the fault thread wakes them.
+ * Caller holds table->lock.
+ *
+ * @param data table->block_size bytes, or NULL for zeros
+ * @return DSM_SUCCESS, DSM_ERROR_BUSY if the block was already mapped
+ *         (it was touched directly), or DSM_ERROR_MEMORY
+ */
+static int map_block(page_table_t *table, page_entry_t *entry, const void *data, bool protect) {
+    if (entry->mapped) {
+        return DSM_ERROR_BUSY;
+    }
+
+    struct uffdio_copy copy = {
+        .dst = (uintptr_t)entry->local_addr,
+        .src = (uintptr_t)(data ? data : g_zero_block),
+        .len = table->block_size,
+        .mode = UFFDIO_COPY_MODE_DONTWAKE | (protect ? UFFDIO_COPY_MODE_WP : 0),
+    };
+    while (ioctl(g_uffd.fd, UFFDIO_COPY, &copy) != 0) {
+        if (errno == EEXIST) {
+            entry->mapped = true;
+            return DSM_ERROR_BUSY;
+        }
+        if (errno != EAGAIN) {
+            LOG_ERROR("UFFDIO_COPY of page %lu failed: %s", entry->id, strerror(errno));
+            return DSM_ERROR_MEMORY;
+        }
+        /* Interrupted part way: continue after the bytes already copied */
+        if (copy.copy > 0) {
+            copy.dst += (uint64_t)copy.copy;
+            copy.src += (uint64_t)copy.copy;
+            copy.len -= (uint64_t)copy.copy;
+        }
+        copy.copy = 0;
+    }
+
+    entry->mapped = true;
+    return DSM_SUCCESS;
+}
+
+int userfault_set_permission(page_table_t *table, page_entry_t *entry, page_perm_t perm) {
+    void *addr = entry->local_addr;
+    size_t len = table->block_size;
+    int rc = DSM_SUCCESS;
+
+    /* The mapping and the state change together, so a fault thread never
+     * sees a granted state on a block that is about to be dropped */
+    pthread_mutex_lock(&table->lock);
+    if (perm == PAGE_PERM_NONE) {
+        if (madvise(addr, len, MADV_DONTNEED) != 0) {
+            LOG_ERROR("madvise(MADV_DONTNEED) failed for page %lu: %s", entry->id, strerror(errno));
+            rc = DSM_ERROR_PERMISSION;
+        } else {
+            entry->mapped = false;
+            entry->state = PAGE_STATE_INVALID;
+            entry->version = 0;  /* The bytes are gone */
+        }
+    } else {
+        bool protect = perm == PAGE_PERM_READ;
+        rc = map_block(table, entry, NULL, protect);
+        if (rc == DSM_SUCCESS || rc == DSM_ERROR_BUSY) {
+            rc = write_protect(addr, len, protect);
+        }
+        if (rc == DSM_SUCCESS) {
+            entry->state = protect ? PAGE_STATE_READ_ONLY : PAGE_STATE_READ_WRITE;
+            if (!protect) {
+                entry->version = page_next_version();
+            }
+        }
+    }
+    pthread_mutex_unlock(&table->lock);
+
+    if (rc == DSM_SUCCESS) {
+        LOG_DEBUG("Page %lu permission set to %d (state=%d, userfaultfd)", entry->id, perm, entry->state);
+    }
+    return rc;
+}
+
+int userfault_install(page_table_t *table, page_entry_t *entry, const void *data) {
+    pthread_mutex_lock(&table->lock);
+    int rc = map_block(table, entry, data, true);
+    if (rc == DSM_ERROR_BUSY) {
+        /* Touched while INVALID: overwrite it in place */
+        rc = write_protect(entry->local_addr, table->block_size, false);
+        if (rc == DSM_SUCCESS) {
+            if (data) {
+                memcpy(entry->local_addr, data, table->block_size);
+            } else {
+                memset(entry->local_addr, 0, table->block_size);
+            }
+            rc = write_protect(entry->local_addr, table->block_size, true);
+        }
+    }
+    pthread_mutex_unlock(&table->lock);
+    return rc;
+}
+
+/* ============================ */
+/*       Fault Threads          */
+/* ============================ */
+
+/**
+ * Check whether a missing fault was resolved before it was read
+ * A granted block that is not mapped lost a race with an invalidation:
+ * it is marked INVALID so the fault fetches it.
+ */
+static bool fault_resolved(page_table_t *table, page_entry_t *entry) {
+    pthread_mutex_lock(&table->lock);
+    bool resolved = entry->state != PAGE_STATE_INVALID && entry->mapped;
+    if (!resolved && entry->state != PAGE_STATE_INVALID) {
+        LOG_DEBUG("Page %lu is granted but not mapped, fetching it again", entry->id);
+        entry->state = PAGE_STATE_INVALID;
+    }
+    pthread_mutex_unlock(&table->lock);
+    return resolved;
+}
+
+static void serve_fault(const struct uffd_msg *msg) {
+    void *fault_addr = (void *)(uintptr_t)msg->arg.pagefault.address;
+    uint64_t flags = msg->arg.pagefault.flags;
+    bool is_write = (flags & (UFFD_PAGEFAULT_FLAG_WRITE | UFFD_PAGEFAULT_FLAG_WP)) != 0;
+
+    page_table_t *table = NULL;
+    page_entry_t *entry = page_index_lookup_addr(fault_addr, &table);
+    if (!entry) {
+        /* Registered regions are indexed until they are unmapped */
+        LOG_ERROR("Userfault at %p - not in any DSM region", fault_addr);
+        wake_range(page_get_base_addr(fault_addr), PAGE_SIZE);
+        return;
+    }
+
+    LOG_DEBUG("Userfault at %p (page_id=%lu, state=%d, flags=0x%lx, %s)",
+              fault_addr, entry->id, entry->state, (unsigned long)flags,
+              is_write ? "WRITE" : "READ");
+
+    if (!(flags & UFFD_PAGEFAULT_FLAG_WP) && fault_resolved(table, entry)) {
+        wake_range(entry->local_addr, table->block_size);
+        return;
+    }
+
+    if (service_page_fault(table, entry, is_write, fault_addr) != DSM_SUCCESS) {
+        /* As under SIGSEGV: the access cannot complete, so the process dies */
+        LOG_ERROR("Failed to handle %s userfault at %p", is_write ? "write" : "read", fault_addr);
+        signal(SIGSEGV, SIG_DFL);
+        raise(SIGSEGV);
+        return;
+    }
+    wake_range(entry->local_addr, table->block_size);
+}
+
+static void* fault_thread_main(void *arg) {
+    (void)arg;
+    struct pollfd fds[2] = {
+        { .fd = g_uffd.fd, .events = POLLIN },
+        { .fd = g_uffd.stop_pipe[0], .events = POLLIN },
+    };
+
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("poll on userfaultfd failed: %s", strerror(errno));
+            break;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+
+        /* Every fault thread polls; the others find the messages taken */
+        struct uffd_msg msgs[USERFAULT_MSG_BATCH];
+        ssize_t n = read(g_uffd.fd, msgs, sizeof(msgs));
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("read from userfaultfd failed: %s", strerror(errno));
+            break;
+        }
+        for (size_t i = 0; i < (size_t)n / sizeof(msgs[0]); i++) {
+            if (msgs[i].event == UFFD_EVENT_PAGEFAULT) {
+                serve_fault(&msgs[i]);
+            }
+        }
+    }
+    return NULL;
+}
+
+/* ============================ */
+/*       Lifecycle              */
+/* ============================ */
+
+int userfault_init(int num_threads) {
+    if (g_uffd.active) {
+        return DSM_SUCCESS;
+    }
+    if (num_threads <= 0) {
+        num_threads = USERFAULT_DEFAULT_THREADS;
+    }
+    if (num_threads > USERFAULT_MAX_THREADS) {
+        num_threads = USERFAULT_MAX_THREADS;
+    }
+
+    int fd = (int)syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK);
+    if (fd < 0) {
+        LOG_WARN("userfaultfd not available: %s", strerror(errno));
+        return DSM_ERROR_INIT;
+    }
+
+    struct uffdio_api api = { .api = UFFD_API, .features = UFFD_FEATURE_PAGEFAULT_FLAG_WP };
+    if (ioctl(fd, UFFDIO_API, &api) != 0) {
+        LOG_WARN("userfaultfd has no write-protect faults: %s", strerror(errno));
+        close(fd);
+        return DSM_ERROR_INIT;
+    }
+    if (pipe2(g_uffd.stop_pipe, O_CLOEXEC) != 0) {
+        LOG_ERROR("Failed to create userfault stop pipe: %s", strerror(errno));
+        close(fd);
+        return DSM_ERROR_INIT;
+    }
+
+    g_uffd.fd = fd;
+    g_uffd.num_threads = 0;
+    for (int i = 0; i < num_threads; i++) {
+        if (pthread_create(&g_uffd.threads[i], NULL, fault_thread_main, NULL) != 0) {
+            LOG_ERROR("Failed to start fault thread %d", i);
+            userfault_shutdown();
+            return DSM_ERROR_INIT;
+        }
+        g_uffd.num_threads++;
+    }
+
+    g_uffd.active = true;
+    LOG_INFO("userfaultfd fault engine started with %d fault threads", num_threads);
+    return DSM_SUCCESS;
+}
+
+void userfault_shutdown(void) {
+    if (g_uffd.fd < 0) {
+        return;
+    }
+
+    g_uffd.active = false;
+    if (write(g_uffd.stop_pipe[1], "x", 1) != 1) {
+        LOG_WARN("Failed to signal fault threads: %s", strerror(errno));
+    }
+    for (int i = 0; i < g_uffd.num_threads; i++) {
+        pthread_join(g_uffd.threads[i], NULL);
+    }
+    g_uffd.num_threads = 0;
+
+    /* Closing the userfaultfd unregisters every region */
+    close(g_uffd.fd);
+    close(g_uffd.stop_pipe[0]);
+    close(g_uffd.stop_pipe[1]);
+    g_uffd.fd = -1;
+    g_uffd.stop_pipe[0] = g_uffd.stop_pipe[1] = -1;
+    LOG_INFO("userfaultfd fault engine stopped");
+}
+
+bool userfault_active(void) {
+    return g_uffd.active;
+}
+
+int userfault_register(void *addr, size_t len) {
+    if (!g_uffd.active) {
+        return DSM_SUCCESS;
+    }
+
+    /* One readable and writable VMA; the userfaultfd enforces access */
+    if (mprotect(addr, len, PROT_READ | PROT_WRITE) != 0) {
+        LOG_ERROR("mprotect of DSM region %p failed: %s", addr, strerror(errno));
+        return DSM_ERROR_MEMORY;
+    }
+
+    struct uffdio_register reg = {
+        .range = { .start = (uintptr_t)addr, .len = len },
+        .mode = UFFDIO_REGISTER_MODE_MISSING | UFFDIO_REGISTER_MODE_WP,
+    };
+    if (ioctl(g_uffd.fd, UFFDIO_REGISTER, &reg) != 0) {
+        LOG_ERROR("UFFDIO_REGISTER of DSM region %p (%zu bytes) failed: %s",
+                  addr, len, strerror(errno));
+        return DSM_ERROR_MEMORY;
+    }
+    if ((reg.ioctls & USERFAULT_RANGE_IOCTLS) != USERFAULT_RANGE_IOCTLS) {
+        LOG_ERROR("DSM region %p lacks userfaultfd copy/write-protect support", addr);
+        return DSM_ERROR_MEMORY;
+    }
+
+    LOG_DEBUG("DSM region %p (%zu bytes) registered with userfaultfd", addr, len);
+    return DSM_SUCCESS;
+}
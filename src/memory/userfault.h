@@ -0,0 +1,89 @@
+/**
+ * @file userfault.h
+ * @brief userfaultfd fault engine
+ *
+ * Alternative to the SIGSEGV handler, selected with
+ * dsm_config_t.fault_engine. DSM regions are mapped readable and writable
+ * once and registered with one userfaultfd in missing and write-protect
+ * modes, so permission changes never split VMAs:
+ *
+ * - INVALID blocks are not mapped (MADV_DONTNEED drops them), so any
+ *   access raises a missing fault.
+ * - READ_ONLY blocks are mapped write-protected, so a write raises a
+ *   write-protect fault.
+ * - READ_WRITE blocks are mapped without protection.
+ *
+ * Faults are read from the userfaultfd by dedicated fault threads, which
+ * run the same fetch protocol as the SIGSEGV handler and then wake the
+ * faulting thread. PAGE_REPLY data is installed with UFFDIO_COPY straight
+ * from the receive buffer.
+ *
+ * A block that is not mapped but whose state grants access holds zeros:
+ * it is filled with zeros when access is granted or on its first fault.
+ * Dropping an invalidated block discards its bytes, so under this engine
+ * an INVALID page has no cached version to offer the owner.
+ */
+
+#ifndef USERFAULT_H
+#define USERFAULT_H
+
+#include "page_table.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Fault threads started when dsm_config_t.num_fault_threads is 0 */
+#define USERFAULT_DEFAULT_THREADS 4
+
+/** Fault threads at most */
+#define USERFAULT_MAX_THREADS 64
+
+/**
+ * Open the userfaultfd and start the fault threads
+ *
+ * @param num_threads Fault threads (0 = USERFAULT_DEFAULT_THREADS)
+ * @return DSM_SUCCESS, or DSM_ERROR_INIT if the kernel does not offer
+ *         userfaultfd with write-protect faults to this process
+ */
+int userfault_init(int num_threads);
+
+/**
+ * Stop the fault threads and close the userfaultfd
+ */
+void userfault_shutdown(void);
+
+/**
+ * Check whether DSM regions fault through userfaultfd
+ */
+bool userfault_active(void);
+
+/**
+ * Make a freshly mapped DSM region fault through userfaultfd
+ * No-op under the SIGSEGV engine.
+ *
+ * @param addr Region mapped with PROT_NONE and not yet published
+ * @param len Region length
+ * @return DSM_SUCCESS, or DSM_ERROR_MEMORY if the region cannot be registered
+ */
+int userfault_register(void *addr, size_t len);
+
+/**
+ * Set the permission and state of a block (set_page_permission())
+ *
+ * @param table Page table of the entry
+ * @param entry Page entry
+ * @param perm New permission
+ * @return DSM_SUCCESS, or DSM_ERROR_PERMISSION
+ */
+int userfault_set_permission(page_table_t *table, page_entry_t *entry, page_perm_t perm);
+
+/**
+ * Install a fetched block, write-protected until its permission is set
+ *
+ * @param table Page table of the entry
+ * @param entry INVALID page entry being fetched
+ * @param data table->block_size bytes, or NULL for zeros
+ * @return DSM_SUCCESS, or DSM_ERROR_MEMORY
+ */
+int userfault_install(page_table_t *table, page_entry_t *entry, const void *data);
+
+#endif /* USERFAULT_H */
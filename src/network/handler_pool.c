@@ -0,0 +1,290 @@
+/**
+ * @file handler_pool.c
+ * @brief Message handler thread pool implementation
+ */
+
+#include "handler_pool.h"
+#include "handlers.h"
+#include "msg_pool.h"
+#include "../core/log.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+/** Messages handled per wakeup before re-checking the queue */
+#define HANDLER_BATCH_MAX 16
+/** Worker wakeup interval while idle */
+#define HANDLER_POLL_MS 100
+
+typedef struct {
+    pthread_t thread;
+    msg_queue_t *queue;
+    int index;
+} handler_worker_t;
+
+static struct {
+    pthread_mutex_t lock;       /**< Protects active and the worker array */
+    bool active;                /**< Accepting submissions */
+    volatile bool running;      /**< Workers keep running while set */
+    int num_workers;
+    handler_worker_t workers[MAX_HANDLER_THREADS];
+} g_pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .active = false,
+    .running = false,
+    .num_workers = 0
+};
+
+/**
+ * Map a message to the object whose handlers must run in order
+ *
+ * Lock and barrier IDs are offset into separate key spaces so that lock 3
+ * and page 3 do not needlessly serialize on one worker.
+ *
+ * @return true and *key set if the message can be handled off the poller
+ */
+static bool shard_key(const message_t *msg, uint64_t *key) {
+    switch (msg->header.type) {
+        case MSG_PAGE_REQUEST:   *key = msg->payload.page_request.page_id; return true;
+        case MSG_PAGE_REPLY:     *key = msg->payload.page_reply.page_id; return true;
+        case MSG_INVALIDATE:     *key = msg->payload.invalidate.page_id; return true;
+        case MSG_INVALIDATE_ACK: *key = msg->payload.invalidate_ack.page_id; return true;
+        case MSG_INVALIDATE_FANOUT: *key = msg->payload.invalidate_fanout.page_id; return true;
+        case MSG_PAGE_UPGRADE:      *key = msg->payload.page_upgrade.request.page_id; return true;
+        case MSG_DIR_QUERY:      *key = msg->payload.dir_query.page_id; return true;
+        case MSG_DIR_REPLY:      *key = msg->payload.dir_reply.page_id; return true;
+        case MSG_OWNER_UPDATE:   *key = msg->payload.owner_update.page_id; return true;
+        case MSG_SHARER_QUERY:   *key = msg->payload.sharer_query.page_id; return true;
+        case MSG_SHARER_REPLY:   *key = msg->payload.sharer_reply.page_id; return true;
+        case MSG_ERROR:          *key = msg->payload.error.page_id; return true;
+        case MSG_ALLOC_NOTIFY:   *key = msg->payload.alloc_notify.start_page_id; return true;
+        case MSG_ALLOC_ACK:      *key = msg->payload.alloc_ack.start_page_id; return true;
+        case MSG_PAGE_DIFF:      *key = msg->payload.page_diff.page_id; return true;
+        case MSG_PAGE_DIFF_ACK:  *key = msg->payload.page_diff_ack.page_id; return true;
+        /* Keyed by its first page; the handler hands pages of other shards on */
+        case MSG_PAGE_BATCH_REQUEST:
+            if (msg->payload.page_batch_request.num_pages == 0) {
+                return false;
+            }
+            *key = msg->payload.page_batch_request.pages[0].page_id;
+            return true;
+        /* Keyed by its first page: an atomic is applied in order with the
+         * page's other messages, which alone change its protection */
+        case MSG_RMA_REQUEST:
+            if (msg->payload.rma_request.num_segments == 0) {
+                return false;
+            }
+            *key = msg->payload.rma_request.segments[0].page_id;
+            return true;
+
+        case MSG_LOCK_REQUEST:   *key = (1ULL << 62) | msg->payload.lock_request.lock_id; return true;
+        case MSG_LOCK_GRANT:     *key = (1ULL << 62) | msg->payload.lock_grant.lock_id; return true;
+        case MSG_LOCK_RELEASE:   *key = (1ULL << 62) | msg->payload.lock_release.lock_id; return true;
+        case MSG_LOCK_RECALL:    *key = (1ULL << 62) | msg->payload.lock_recall.lock_id; return true;
+
+        case MSG_BARRIER_ARRIVE:  *key = (2ULL << 62) | msg->payload.barrier_arrive.barrier_id; return true;
+        case MSG_BARRIER_RELEASE: *key = (2ULL << 62) | msg->payload.barrier_release.barrier_id; return true;
+        case MSG_BARRIER_SIGNAL:  *key = (2ULL << 62) | msg->payload.barrier_signal.barrier_id; return true;
+
+        default:
+            /* NODE_JOIN and PEER_HELLO need the socket; membership,
+             * heartbeat, replication and failover traffic is rare and
+             * order-sensitive across objects.
+             * PAGE_BATCH_REPLY is split into per-page PAGE_REPLYs on the
+             * poller, which are sharded in turn. TRANSPORT_CONNECT and
+             * TCP_LANE change where the poller reads the peer's next
+             * frames from. */
+            return false;
+    }
+}
+
+static int shard_index(uint64_t key, int num_workers) {
+    /* Page IDs are bit fields (node|alloc|page); mix before modulo */
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (int)(key % (uint64_t)num_workers);
+}
+
+static void* handler_worker_thread(void *arg) {
+    handler_worker_t *worker = (handler_worker_t *)arg;
+    msg_queue_entry_t *batch[HANDLER_BATCH_MAX];
+
+    LOG_DEBUG("Handler worker %d started", worker->index);
+
+    for (;;) {
+        msg_queue_wait(worker->queue, HANDLER_POLL_MS);
+
+        int n = msg_queue_dequeue_batch(worker->queue, batch, HANDLER_BATCH_MAX);
+        for (int i = 0; i < n; i++) {
+            if (batch[i]->data) {
+                dispatch_bulk_message(&batch[i]->msg, batch[i]->data, batch[i]->data_len);
+            } else {
+                dispatch_message(&batch[i]->msg, -1);
+            }
+            msg_pool_put(batch[i]);
+        }
+
+        /* Exit only once the queue is drained so no received message is lost */
+        if (n == 0 && !g_pool.running) {
+            break;
+        }
+    }
+
+    LOG_DEBUG("Handler worker %d stopped", worker->index);
+    return NULL;
+}
+
+int handler_pool_start(int num_threads) {
+    if (num_threads < 1 || num_threads > MAX_HANDLER_THREADS) {
+        LOG_ERROR("Invalid handler pool size %d (1..%d)", num_threads, MAX_HANDLER_THREADS);
+        return DSM_ERROR_INVALID;
+    }
+
+    pthread_mutex_lock(&g_pool.lock);
+
+    if (g_pool.active) {
+        pthread_mutex_unlock(&g_pool.lock);
+        return DSM_SUCCESS;
+    }
+
+    g_pool.running = true;
+    g_pool.num_workers = 0;
+
+    for (int i = 0; i < num_threads; i++) {
+        handler_worker_t *worker = &g_pool.workers[i];
+        worker->index = i;
+        worker->queue = msg_queue_create();
+        if (!worker->queue) {
+            break;
+        }
+        if (pthread_create(&worker->thread, NULL, handler_worker_thread, worker) != 0) {
+            LOG_ERROR("Failed to create handler worker %d", i);
+            msg_queue_destroy(worker->queue);
+            worker->queue = NULL;
+            break;
+        }
+        g_pool.num_workers++;
+    }
+
+    if (g_pool.num_workers != num_threads) {
+        /* Tear down whatever was started */
+        g_pool.running = false;
+        for (int i = 0; i < g_pool.num_workers; i++) {
+            pthread_join(g_pool.workers[i].thread, NULL);
+            msg_queue_destroy(g_pool.workers[i].queue);
+            g_pool.workers[i].queue = NULL;
+        }
+        g_pool.num_workers = 0;
+        pthread_mutex_unlock(&g_pool.lock);
+        return DSM_ERROR_INIT;
+    }
+
+    g_pool.active = true;
+    pthread_mutex_unlock(&g_pool.lock);
+
+    LOG_INFO("Handler pool started with %d workers", num_threads);
+    return DSM_SUCCESS;
+}
+
+void handler_pool_stop(void) {
+    pthread_mutex_lock(&g_pool.lock);
+
+    if (!g_pool.active) {
+        pthread_mutex_unlock(&g_pool.lock);
+        return;
+    }
+
+    /* New submissions fall back to inline dispatch from here on */
+    g_pool.active = false;
+    g_pool.running = false;
+    int num_workers = g_pool.num_workers;
+    g_pool.num_workers = 0;
+
+    pthread_mutex_unlock(&g_pool.lock);
+
+    for (int i = 0; i < num_workers; i++) {
+        pthread_join(g_pool.workers[i].thread, NULL);
+        msg_queue_destroy(g_pool.workers[i].queue);
+        g_pool.workers[i].queue = NULL;
+    }
+
+    LOG_INFO("Handler pool stopped");
+}
+
+bool handler_pool_active(void) {
+    pthread_mutex_lock(&g_pool.lock);
+    bool active = g_pool.active;
+    pthread_mutex_unlock(&g_pool.lock);
+    return active;
+}
+
+int handler_pool_page_shard(page_id_t page_id) {
+    pthread_mutex_lock(&g_pool.lock);
+    int shard = g_pool.active ? shard_index(page_id, g_pool.num_workers) : -1;
+    pthread_mutex_unlock(&g_pool.lock);
+    return shard;
+}
+
+int handler_pool_message_shard(const message_t *msg, int num_shards) {
+    uint64_t key;
+    if (msg->header.type == MSG_PAGE_BATCH_REPLY && msg->payload.page_batch_reply.num_pages > 0) {
+        key = msg->payload.page_batch_reply.pages[0].page_id;
+    } else if (!shard_key(msg, &key)) {
+        return -1;
+    }
+    return shard_index(key, num_shards);
+}
+
+int handler_pool_key_shard(page_id_t page_id, int num_shards) {
+    return shard_index(page_id, num_shards);
+}
+
+int handler_pool_submit(const message_t *msg) {
+    return handler_pool_submit_bulk(msg, NULL, 0);
+}
+
+int handler_pool_submit_bulk(const message_t *msg, uint8_t *data, size_t data_len) {
+    if (!msg) {
+        return DSM_ERROR_INVALID;
+    }
+
+    msg_queue_entry_t *entry = msg_pool_copy(msg);
+    if (!entry) {
+        return DSM_ERROR_INVALID;
+    }
+    entry->data = data;
+    entry->data_len = data_len;
+
+    int rc = handler_pool_submit_entry(entry);
+    if (rc != DSM_SUCCESS) {
+        entry->data = NULL;
+        msg_pool_put(entry);
+    }
+    return rc;
+}
+
+int handler_pool_submit_entry(msg_queue_entry_t *entry) {
+    if (!entry) {
+        return DSM_ERROR_INVALID;
+    }
+
+    uint64_t key;
+    if (!shard_key(&entry->msg, &key)) {
+        return DSM_ERROR_INVALID;
+    }
+
+    pthread_mutex_lock(&g_pool.lock);
+
+    if (!g_pool.active) {
+        pthread_mutex_unlock(&g_pool.lock);
+        return DSM_ERROR_INVALID;
+    }
+
+    /* Enqueue under the pool lock so stop cannot destroy the queue under us */
+    handler_worker_t *worker = &g_pool.workers[shard_index(key, g_pool.num_workers)];
+    entry->dest = entry->msg.header.sender;
+    int rc = msg_queue_push(worker->queue, entry);
+
+    pthread_mutex_unlock(&g_pool.lock);
+    return rc == DSM_SUCCESS ? DSM_SUCCESS : DSM_ERROR_INVALID;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file handler_pool.h
+ * @brief Message handler thread pool
+ *
+ * The dispatcher thread only reads framed messages; handling is done by a
+ * fixed pool of worker threads. Messages are sharded by the object they
+ * concern (page, lock, barrier or allocation), so all messages for one
+ * object are handled in arrival order by the same worker while unrelated
+ * objects proceed in parallel.
+ */
+
+#ifndef HANDLER_POOL_H
+#define HANDLER_POOL_H
+
+#include "protocol.h"
+#include <stdbool.h>
+
+/** Upper bound on dsm_config_t.num_handler_threads */
+#define MAX_HANDLER_THREADS 64
+
+/**
+ * Start the handler pool
+ *
+ * @param num_threads Number of worker threads (1..MAX_HANDLER_THREADS)
+ * @return DSM_SUCCESS on success, error code on failure
+ */
+int handler_pool_start(int num_threads);
+
+/**
+ * Drain queued messages and stop all worker threads
+ */
+void handler_pool_stop(void);
+
+/**
+ * Check whether the pool is accepting messages
+ */
+bool handler_pool_active(void);
+
+/**
+ * Worker that handles messages for a page
+ *
+ * Messages for pages with the same shard are never handled concurrently.
+ *
+ * @param page_id Page ID
+ * @return Worker index, or -1 while the pool is stopped (all messages inline)
+ */
+int handler_pool_page_shard(page_id_t page_id);
+
+/**
+ * Shard of a message among num_shards, by the key the pool orders it by
+ *
+ * Used to spread traffic over a peer's TCP lanes without reordering the
+ * messages of one object. A PAGE_BATCH_REPLY counts as a message for its
+ * first page here.
+ *
+ * @param msg Message
+ * @param num_shards Number of shards (> 0)
+ * @return Shard index, or -1 for messages without a shard key
+ */
+int handler_pool_message_shard(const message_t *msg, int num_shards);
+
+/**
+ * Shard of a page among num_shards, as handler_pool_message_shard() maps
+ * messages for it
+ */
+int handler_pool_key_shard(page_id_t page_id, int num_shards);
+
+/**
+ * Hand a received message to the worker that owns its shard
+ *
+ * Messages without a shard key (node membership, heartbeats, replication
+ * and failover traffic) are not accepted and must be dispatched inline by
+ * the caller; so are all messages while the pool is stopped.
+ *
+ * @param msg Received message (copied)
+ * @return DSM_SUCCESS if queued, DSM_ERROR_INVALID if the caller must dispatch inline
+ */
+int handler_pool_submit(const message_t *msg);
+
+/**
+ * Hand a received bulk frame to the worker that owns its shard
+ *
+ * Like handler_pool_submit(); once queued, data belongs to the pool and
+ * is passed to dispatch_bulk_message() with the message.
+ *
+ * @param msg Received message (copied)
+ * @param data malloc'd bulk data of the frame, or NULL
+ * @param data_len Bytes of data
+ * @return DSM_SUCCESS if queued, DSM_ERROR_INVALID if the caller must dispatch inline
+ */
+int handler_pool_submit_bulk(const message_t *msg, uint8_t *data, size_t data_len);
+
+/**
+ * Hand a received message to the worker that owns its shard, without a copy
+ *
+ * Like handler_pool_submit_bulk(); once queued, the entry and its data
+ * belong to the pool, which returns them with msg_pool_put().
+ *
+ * @param entry Entry from msg_pool_get() holding the message and its data
+ * @return DSM_SUCCESS if queued, DSM_ERROR_INVALID if the caller must
+ *         dispatch inline (the entry is still the caller's)
+ */
+int handler_pool_submit_entry(msg_queue_entry_t *entry);
+
+#endif /* HANDLER_POOL_H */
@@ -5,16 +5,32 @@
 
 #include "handlers.h"
 #include "network.h"
+#include "page_codec.h"
+#include "handler_pool.h"
+#include "msg_pool.h"
+#include "replication.h"
 #include "../core/log.h"
 #include "../core/dsm_context.h"
+#include "../core/stats.h"
+#include "../core/sharing_profile.h"
+#include "../core/trace.h"
 #include "../memory/page_table.h"
+#include "../memory/page_index.h"
 #include "../memory/permission.h"
+#include "../memory/userfault.h"
+#include "../consistency/async_access.h"
 #include "../consistency/directory.h"
 #include "../consistency/page_migration.h"
+#include "../consistency/prefetch.h"
+#include "../consistency/release_consistency.h"
+#include "../consistency/rma.h"
 #include <string.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
 #include <unistd.h>
 #include <time.h>
 
@@ -34,67 +50,12 @@
 static inline size_t get_message_wire_size(msg_type_t msg_type) {
     size_t size = 4 + sizeof(msg_header_t);  /* 4-byte length prefix + header */
 
-    switch (msg_type) {
-        case MSG_PAGE_REQUEST:
-            return size + sizeof(page_request_payload_t);
-        case MSG_PAGE_REPLY:
-            return size + sizeof(page_reply_payload_t);  /* Includes 4KB page data */
-        case MSG_INVALIDATE:
-            return size + sizeof(invalidate_payload_t);
-        case MSG_INVALIDATE_ACK:
-            return size + sizeof(invalidate_ack_payload_t);
-        case MSG_LOCK_REQUEST:
-            return size + sizeof(lock_request_payload_t);
-        case MSG_LOCK_GRANT:
-            return size + sizeof(lock_grant_payload_t);
-        case MSG_LOCK_RELEASE:
-            return size + sizeof(lock_release_payload_t);
-        case MSG_BARRIER_ARRIVE:
-            return size + sizeof(barrier_arrive_payload_t);
-        case MSG_BARRIER_RELEASE:
-            return size + sizeof(barrier_release_payload_t);
-        case MSG_ALLOC_NOTIFY:
-            return size + sizeof(alloc_notify_payload_t);
-        case MSG_ALLOC_ACK:
-            return size + sizeof(alloc_ack_payload_t);
-        case MSG_NODE_JOIN:
-            return size + sizeof(node_join_payload_t);
-        case MSG_NODE_LEAVE:
-            return size + sizeof(node_leave_payload_t);
-        case MSG_HEARTBEAT:
-            return size;  /* No payload */
-        case MSG_HEARTBEAT_ACK:
-            return size + sizeof(heartbeat_ack_payload_t);
-        case MSG_DIR_QUERY:
-            return size + sizeof(dir_query_payload_t);
-        case MSG_DIR_REPLY:
-            return size + sizeof(dir_reply_payload_t);
-        case MSG_OWNER_UPDATE:
-            return size + sizeof(owner_update_payload_t);
-        case MSG_NODE_FAILED:
-            return size + sizeof(node_failed_payload_t);
-        case MSG_SHARER_QUERY:
-            return size + sizeof(sharer_query_payload_t);
-        case MSG_SHARER_REPLY:
-            return size + sizeof(sharer_reply_payload_t);
-        case MSG_ERROR:
-            return size + sizeof(error_payload_t);
-        case MSG_STATE_SYNC_DIR:
-            return size + sizeof(state_sync_dir_payload_t);
-        case MSG_STATE_SYNC_LOCK:
-            return size + sizeof(state_sync_lock_payload_t);
-        case MSG_STATE_SYNC_BARRIER:
-            return size + sizeof(state_sync_barrier_payload_t);
-        case MSG_STATE_SYNC_NODE:
-            return size + sizeof(state_sync_node_payload_t);
-        case MSG_MANAGER_PROMOTION:
-            return size + sizeof(manager_promotion_payload_t);
-        case MSG_RECONNECT_REQUEST:
-            return size + sizeof(reconnect_request_payload_t);
-        default:
-            LOG_WARN("Unknown message type %d for size calculation", msg_type);
-            return size;  /* Return header size as fallback */
+    size_t payload_size = message_payload_size(msg_type);
+    if (payload_size == (size_t)-1) {
+        LOG_WARN("Unknown message type %d for size calculation", msg_type);
+        return size;  /* Return header size as fallback */
     }
+    return size + payload_size;  /* PAGE_REPLY includes 4KB page data */
 }
 
 /**
@@ -108,9 +69,7 @@ static inline void track_bytes_sent(msg_type_t msg_type) {
     if (!ctx) return;
 
     size_t bytes = get_message_wire_size(msg_type);
-    pthread_mutex_lock(&ctx->stats_lock);
-    ctx->stats.network_bytes_sent += bytes;
-    pthread_mutex_unlock(&ctx->stats_lock);
+    STATS_ADD(network_bytes_sent, bytes);
 }
 
 /**
@@ -124,9 +83,283 @@ static inline void track_bytes_received(msg_type_t msg_type) {
     if (!ctx) return;
 
     size_t bytes = get_message_wire_size(msg_type);
-    pthread_mutex_lock(&ctx->stats_lock);
-    ctx->stats.network_bytes_received += bytes;
-    pthread_mutex_unlock(&ctx->stats_lock);
+    STATS_ADD(network_bytes_received, bytes);
+}
+
+/** Next hop towards dest: workers reach other workers through the manager */
+static node_id_t route_via_manager(node_id_t dest) {
+    dsm_context_t *ctx = dsm_get_context();
+    return (!ctx->config.is_manager && dest != 0) ? 0 : dest;
+}
+
+/**
+ * Next hop towards dest for traffic the manager would only relay: the
+ * link to the worker itself, opened on first use, else the manager
+ *
+ * Page requests and replies keep the star route: the manager records
+ * sharers and orders invalidations as it relays them.
+ */
+static node_id_t route_direct(node_id_t dest) {
+    return network_peer_link(dest) ? dest : route_via_manager(dest);
+}
+
+/**
+ * Next hop towards dest for directory traffic of a page
+ *
+ * With the distributed directory a page's home is addressed straight over
+ * the peer link, opened on first use; the manager could not tell a relayed
+ * request from one meant for its own directory. Otherwise the star link.
+ */
+static node_id_t route_peer(node_id_t dest) {
+    if (directory_distributed()) {
+        network_peer_link(dest);
+    }
+    return dest;
+}
+
+/* ============================ */
+/*   Write Hand-offs            */
+/* ============================ */
+
+/* A hand-off its writer never confirmed is given up after this long
+ * (writers wait 10 seconds for the page, then send a new request) */
+#define HANDOFF_STALE_SEC 10
+
+/**
+ * Directory node: a page on its way to a writer
+ *
+ * Taken when the page's directory node (the manager, or the page's home)
+ * accepts a write (PAGE_UPGRADE, INVALIDATE_FANOUT or its own write fault)
+ * and dropped at the writer's OWNER_UPDATE. Other
+ * requests for the page are parked meanwhile and handled again in arrival
+ * order. The next hand-off then starts from the owner the directory names
+ * once this one is done, instead of from an owner that has just given the
+ * page away, and no reader copies the page between the writer's
+ * invalidations and the hand-over.
+ */
+typedef struct handoff_s {
+    page_id_t page_id;           /**< Page being handed over */
+    node_id_t writer;            /**< Node it goes to, DSM_NODE_NONE: the next one to report */
+    time_t started;              /**< When the write was accepted */
+    msg_queue_entry_t *parked;   /**< Requests held back, oldest first */
+    msg_queue_entry_t *parked_tail;
+    struct handoff_s *next;
+} handoff_t;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t done;         /**< Broadcast when a hand-off ends */
+    handoff_t *head;
+} g_handoffs = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+    .head = NULL
+};
+
+/** Link to the page's hand-off, or to the list's end; caller holds the lock */
+static handoff_t **handoff_find_locked(page_id_t page_id) {
+    handoff_t **link = &g_handoffs.head;
+    while (*link && (*link)->page_id != page_id) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+/**
+ * Unlink a hand-off and return its parked requests; caller holds the lock
+ */
+static msg_queue_entry_t *handoff_end_locked(handoff_t **link) {
+    handoff_t *h = *link;
+    msg_queue_entry_t *parked = h->parked;
+    *link = h->next;
+    free(h);
+    pthread_cond_broadcast(&g_handoffs.done);
+    return parked;
+}
+
+/**
+ * Start a hand-off of a page to writer; caller holds the lock
+ * @return The new hand-off, NULL when out of memory
+ */
+static handoff_t *handoff_start_locked(page_id_t page_id, node_id_t writer) {
+    handoff_t *h = calloc(1, sizeof(handoff_t));
+    if (!h) {
+        LOG_ERROR("Out of memory tracking the hand-off of page %lu to node %u", page_id, writer);
+        return NULL;
+    }
+    h->page_id = page_id;
+    h->writer = writer;
+    h->started = time(NULL);
+    h->next = g_handoffs.head;
+    g_handoffs.head = h;
+    return h;
+}
+
+/**
+ * Handle parked requests again, each on its page's handler as if it had
+ * just arrived; a request for a page still in flight is parked anew
+ */
+static void handoff_replay(msg_queue_entry_t *parked) {
+    while (parked) {
+        msg_queue_entry_t *entry = parked;
+        parked = entry->next;
+        entry->next = NULL;
+        if (handler_pool_submit_entry(entry) != DSM_SUCCESS) {
+            dispatch_message(&entry->msg, -1);
+            msg_pool_put(entry);
+        }
+    }
+}
+
+/**
+ * Directory node: let a page request, upgrade or fan-out through, or park it
+ *
+ * @param msg Message to park if the page is in flight
+ * @param writer Node the message asks to write the page, DSM_NODE_NONE for a read
+ * @param bouncer Old owner that sent the request back, DSM_NODE_NONE if none
+ * @return true if the caller handles msg now, false if it was parked
+ */
+static bool handoff_admit(const message_t *msg, page_id_t page_id, node_id_t writer,
+                          node_id_t bouncer) {
+    /* An old owner sends back what it can no longer serve. While the
+     * directory still names it, its writer has not reported yet */
+    bool behind = false;
+    if (bouncer != DSM_NODE_NONE) {
+        page_directory_t *dir = get_page_directory();
+        node_id_t owner = DSM_NODE_NONE;
+        behind = dir && directory_lookup(dir, page_id, &owner) == DSM_SUCCESS && owner == bouncer;
+    }
+
+    msg_queue_entry_t *stale = NULL;
+    bool admit = true;
+
+    pthread_mutex_lock(&g_handoffs.lock);
+    handoff_t **link = handoff_find_locked(page_id);
+    handoff_t *h = *link;
+    if (h && time(NULL) - h->started > HANDOFF_STALE_SEC) {
+        LOG_WARN("Giving up the hand-off of page %lu to node %u", page_id, h->writer);
+        stale = handoff_end_locked(link);
+        h = NULL;
+    }
+
+    if (h && (h->writer != writer || writer == DSM_NODE_NONE || behind)) {
+        /* Another hand-off is in flight, or the writer's is and the
+         * directory has nothing newer to send this request to: wait */
+        admit = false;
+    } else if (h) {
+        /* The writer asking again, after a failed attempt */
+        h->started = time(NULL);
+    } else if (behind) {
+        h = handoff_start_locked(page_id, DSM_NODE_NONE);
+        admit = h == NULL;
+    } else if (writer != DSM_NODE_NONE) {
+        handoff_start_locked(page_id, writer);
+    }
+
+    if (!admit) {
+        msg_queue_entry_t *entry = msg_pool_copy(msg);
+        if (entry) {
+            entry->next = NULL;
+            if (h->parked_tail) {
+                h->parked_tail->next = entry;
+            } else {
+                h->parked = entry;
+            }
+            h->parked_tail = entry;
+            LOG_DEBUG("Parked message type %d for page %lu behind its hand-off to node %u",
+                      msg->header.type, page_id, h->writer);
+        } else {
+            admit = true;
+        }
+    }
+    pthread_mutex_unlock(&g_handoffs.lock);
+
+    handoff_replay(stale);
+    return admit;
+}
+
+/** Directory node: is a hand-off of the page in flight? */
+static bool handoff_busy(page_id_t page_id) {
+    pthread_mutex_lock(&g_handoffs.lock);
+    bool busy = *handoff_find_locked(page_id) != NULL;
+    pthread_mutex_unlock(&g_handoffs.lock);
+    return busy;
+}
+
+/**
+ * Directory node: end the hand-off of a page to writer and replay what it held back
+ * A hand-off waiting for any owner change ends at any writer's report.
+ */
+void handoff_release(page_id_t page_id, node_id_t writer) {
+    msg_queue_entry_t *parked = NULL;
+
+    pthread_mutex_lock(&g_handoffs.lock);
+    handoff_t **link = handoff_find_locked(page_id);
+    if (*link && ((*link)->writer == writer || (*link)->writer == DSM_NODE_NONE)) {
+        parked = handoff_end_locked(link);
+    }
+    pthread_mutex_unlock(&g_handoffs.lock);
+
+    handoff_replay(parked);
+}
+
+/**
+ * Directory node: wait for another node's hand-off of a page to end
+ * With take set, the page is then handed to this node until
+ * handoff_release(); a hand-off not ended in time is given up.
+ *
+ * @return true if this call took the page
+ */
+static bool handoff_wait_turn(page_id_t page_id, bool take) {
+    dsm_context_t *ctx = dsm_get_context();
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += HANDOFF_STALE_SEC;
+
+    msg_queue_entry_t *stale = NULL;
+    bool taken = false;
+
+    pthread_mutex_lock(&g_handoffs.lock);
+    handoff_t **link = handoff_find_locked(page_id);
+    while (*link && (*link)->writer != ctx->node_id) {
+        if (pthread_cond_timedwait(&g_handoffs.done, &g_handoffs.lock, &deadline) == ETIMEDOUT) {
+            link = handoff_find_locked(page_id);
+            if (*link && (*link)->writer != ctx->node_id) {
+                LOG_WARN("Giving up the hand-off of page %lu to node %u", page_id, (*link)->writer);
+                stale = handoff_end_locked(link);
+            }
+            break;
+        }
+        link = handoff_find_locked(page_id);
+    }
+    if (take && !*handoff_find_locked(page_id)) {
+        taken = handoff_start_locked(page_id, ctx->node_id) != NULL;
+    }
+    pthread_mutex_unlock(&g_handoffs.lock);
+
+    handoff_replay(stale);
+    return taken;
+}
+
+bool handoff_acquire(page_id_t page_id) {
+    return handoff_wait_turn(page_id, true);
+}
+
+void handoff_wait(page_id_t page_id) {
+    handoff_wait_turn(page_id, false);
+}
+
+void handoff_cleanup(void) {
+    pthread_mutex_lock(&g_handoffs.lock);
+    while (g_handoffs.head) {
+        msg_queue_entry_t *parked = handoff_end_locked(&g_handoffs.head);
+        while (parked) {
+            msg_queue_entry_t *next = parked->next;
+            msg_pool_put(parked);
+            parked = next;
+        }
+    }
+    pthread_mutex_unlock(&g_handoffs.lock);
 }
 
 /* ============================ */
@@ -134,7 +367,8 @@ static inline void track_bytes_received(msg_type_t msg_type) {
 /* ============================ */
 
 /* PAGE_REQUEST */
-int send_page_request(node_id_t owner, page_id_t page_id, access_type_t access) {
+int send_page_request(node_id_t owner, page_id_t page_id, access_type_t access,
+                      uint64_t cached_version) {
     dsm_context_t *ctx = dsm_get_context();
     message_t msg;
     memset(&msg, 0, sizeof(msg));
@@ -147,22 +381,27 @@ int send_page_request(node_id_t owner, page_id_t page_id, access_type_t access)
     msg.payload.page_request.page_id = page_id;
     msg.payload.page_request.access = access;
     msg.payload.page_request.requester = ctx->node_id;
-
-    /* CRITICAL FIX #5: Workers send PAGE_REQUEST through manager (star topology)
-     * In star topology, workers are only connected to the manager, not to each other.
-     * When a worker needs a page from another worker:
-     * - Send the request to the manager (node 0)
-     * - Manager will proxy it to the actual owner
-     * - Owner will reply back through the manager
+    msg.payload.page_request.cached_version = cached_version;
+    msg.payload.page_request.accept_encodings = page_codec_supported();
+
+    /* CRITICAL FIX #5: Workers send PAGE_REQUEST through the directory node
+     * The page's directory node (the manager, or with the distributed
+     * directory the page's home) records sharers and orders hand-offs:
+     * - Send the request to the directory node
+     * - It will proxy it to the actual owner
+     * - Owner will reply back (through the manager in the star topology)
      */
     node_id_t target = owner;
-    if (!ctx->config.is_manager && owner != 0) {
-        /* Worker requesting from another worker: route through manager */
-        target = 0;  /* Send to manager */
-        LOG_DEBUG("Worker routing PAGE_REQUEST for page %lu (owner=node %u) through manager",
-                  page_id, owner);
+    node_id_t directory = directory_node(page_id);
+    if (!directory_is_local(page_id) && owner != directory) {
+        /* Owner is another node: route through the directory node */
+        target = directory;
+        LOG_DEBUG("Routing PAGE_REQUEST for page %lu (owner=node %u) through node %u",
+                  page_id, owner, directory);
     }
+    target = route_peer(target);
 
+    trace_event(TRACE_PAGE_REQUEST, page_id, (uint8_t)access, 0, 0, target);
     LOG_DEBUG("Sending PAGE_REQUEST for page %lu to node %u (final owner=node %u)",
               page_id, target, owner);
     int rc = network_send(target, &msg);
@@ -172,6 +411,162 @@ int send_page_request(node_id_t owner, page_id_t page_id, access_type_t access)
     return rc;
 }
 
+/**
+ * Downgrade the owner's writable copy of a page it is about to share
+ *
+ * Done before the page is read for a READ reply, so any later write faults
+ * and starts a new version. The requester's copy then holds exactly the
+ * bytes of the version it is labelled with.
+ */
+static int downgrade_for_read(page_table_t *table, page_entry_t *entry, node_id_t requester) {
+    pthread_mutex_lock(&table->lock);
+    bool writable = entry->state == PAGE_STATE_READ_WRITE;
+    pthread_mutex_unlock(&table->lock);
+
+    if (!writable) {
+        return DSM_SUCCESS;
+    }
+
+    LOG_DEBUG("Downgrading page %lu to READ_ONLY (shared with node %u)",
+              entry->id, requester);
+    int rc = set_page_permission(entry->local_addr, PAGE_PERM_READ);
+    if (rc != DSM_SUCCESS) {
+        LOG_ERROR("Failed to set page %lu permission to READ", entry->id);
+    }
+    return rc;
+}
+
+/**
+ * Write-protect a page we own before it is handed to a writer
+ * A write fault here meanwhile then fetches the page, from the writer.
+ */
+static int revoke_write(page_table_t *table, page_entry_t *entry) {
+    pthread_mutex_lock(&table->lock);
+    bool writable = entry->state == PAGE_STATE_READ_WRITE;
+    pthread_mutex_unlock(&table->lock);
+
+    if (!writable) {
+        return DSM_SUCCESS;
+    }
+
+    int rc = set_page_permission(entry->local_addr, PAGE_PERM_READ);
+    if (rc != DSM_SUCCESS) {
+        LOG_ERROR("Failed to write-protect page %lu for its hand-over", entry->id);
+    }
+    return rc;
+}
+
+/**
+ * Undo hand_over_page() when the reply could not be sent
+ *
+ * The page comes back read-only; a write here upgrades it again.
+ */
+static void take_back_page(page_table_t *table, page_entry_t *entry) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    if (directory_is_local(entry->id)) {
+        page_directory_t *dir = get_page_directory();
+        if (dir) {
+            directory_set_owner(dir, entry->id, ctx->node_id);
+        }
+    }
+
+    pthread_mutex_lock(&table->lock);
+    entry->state = PAGE_STATE_READ_ONLY;
+    entry->owner = ctx->node_id;
+    pthread_mutex_unlock(&table->lock);
+    entry->handed_over = false;
+    set_page_permission(entry->local_addr, PAGE_PERM_READ);
+}
+
+/**
+ * Drop our copy of a page handed to a writer
+ *
+ * Called under the page's entry lock, before the reply goes out.
+ */
+static int hand_over_page(page_table_t *table, page_entry_t *entry, node_id_t requester) {
+    LOG_DEBUG("Downgrading page %lu to INVALID (transferred to node %u)",
+              entry->id, requester);
+
+    /* The directory node's own faults find the owner in its directory:
+     * name the requester before the next fault here, not at its
+     * OWNER_UPDATE, or that fault finds this node still the owner and
+     * keeps a stale copy */
+    if (directory_is_local(entry->id)) {
+        page_directory_t *dir = get_page_directory();
+        if (dir) {
+            directory_set_owner(dir, entry->id, requester);
+        }
+    }
+
+    /* State first: a fault here meanwhile then fetches the page rather
+     * than reapplying a stale protection */
+    pthread_mutex_lock(&table->lock);
+    entry->state = PAGE_STATE_INVALID;
+    entry->owner = requester;
+    pthread_mutex_unlock(&table->lock);
+    entry->handed_over = true;
+
+    int rc = set_page_permission(entry->local_addr, PAGE_PERM_NONE);
+    if (rc != DSM_SUCCESS) {
+        LOG_ERROR("Failed to set page %lu permission to NONE", entry->id);
+        take_back_page(table, entry);
+    }
+    return rc;
+}
+
+/**
+ * Record a node that was sent a read copy of a page we own
+ */
+static void track_read_sharer(page_id_t page_id, node_id_t requester) {
+    LOG_DEBUG("Keeping page %lu as shared (node %u also has read access)",
+              page_id, requester);
+
+    /* CRITICAL FIX (BUG #8): Track requester as sharer in owner's directory
+     * This ensures future writers can get complete sharer list for invalidations */
+    page_directory_t *dir = get_page_directory();
+    if (dir) {
+        int rc = directory_add_reader(dir, page_id, requester);
+        if (rc != DSM_SUCCESS && rc != DSM_ERROR_BUSY) {
+            LOG_WARN("Failed to add node %u as sharer for page %lu", requester, page_id);
+        } else {
+            LOG_DEBUG("Tracked node %u as sharer for page %lu in owner's directory",
+                     requester, page_id);
+        }
+    }
+}
+
+/**
+ * Share a page we own with a reader: list it as a sharer and downgrade
+ *
+ * All under the page's entry lock, which this node's own write upgrade
+ * holds to look for reads served since it began and make the page
+ * writable. That upgrade either counts the reader and invalidates again,
+ * or is already done and faults again at its next write after the
+ * downgrade.
+ */
+static int share_for_read(page_table_t *table, page_entry_t *entry, node_id_t requester) {
+    pthread_mutex_lock(page_entry_lock(entry));
+    track_read_sharer(entry->id, requester);
+    entry->reads_served++;
+    int rc = downgrade_for_read(table, entry, requester);
+    pthread_mutex_unlock(page_entry_lock(entry));
+    return rc;
+}
+
+/**
+ * Manager: record the requester of a read it proxies to a worker owner
+ *
+ * Every read of a worker's page passes through the manager, so its
+ * directory knows all sharers and can fan out invalidations itself.
+ */
+static void track_proxied_reader(page_id_t page_id, node_id_t requester) {
+    page_directory_t *dir = get_page_directory();
+    if (dir && directory_add_reader(dir, page_id, requester) != DSM_SUCCESS) {
+        LOG_WARN("Failed to track node %u as sharer of proxied page %lu", requester, page_id);
+    }
+}
+
 int handle_page_request(const message_t *msg) {
     /* Track received bytes */
     track_bytes_received(MSG_PAGE_REQUEST);
@@ -189,21 +584,25 @@ int handle_page_request(const message_t *msg) {
         return DSM_ERROR_INIT;
     }
 
-    /* Search all page tables for this page ID
-     * Hold ctx->lock to prevent race with dsm_free() compacting the array
+    /* Requests for a page on its way to a writer wait for it to arrive.
+     * One an old owner sent back names that owner as the sender */
+    if (directory_is_local(page_id) && requester != ctx->node_id) {
+        node_id_t sender = msg->header.sender;
+        node_id_t bouncer = sender != requester && sender != ctx->node_id ? sender : DSM_NODE_NONE;
+        if (!handoff_admit(msg, page_id, access == ACCESS_WRITE ? requester : DSM_NODE_NONE, bouncer)) {
+            return DSM_SUCCESS;
+        }
+    }
+
+    /* Look up the page in the page index
+     * Hold ctx->lock to prevent race with dsm_free() removing the table
      * Acquire reference before unlocking to prevent the table from being freed */
     page_entry_t *entry = NULL;
     page_table_t *owning_table = NULL;
     pthread_mutex_lock(&ctx->lock);
-    for (int i = 0; i < ctx->num_allocations; i++) {
-        if (ctx->page_tables[i]) {
-            entry = page_table_lookup_by_id(ctx->page_tables[i], page_id);
-            if (entry) {
-                owning_table = ctx->page_tables[i];
-                page_table_acquire(owning_table);  /* Acquire reference while holding ctx->lock */
-                break;
-            }
-        }
+    entry = page_index_lookup_id(page_id, &owning_table);
+    if (entry) {
+        page_table_acquire(owning_table);  /* Acquire reference while holding ctx->lock */
     }
     pthread_mutex_unlock(&ctx->lock);
 
@@ -214,7 +613,7 @@ int handle_page_request(const message_t *msg) {
          * The original requester ID is preserved in the message, so the owner can reply
          * directly back through the manager.
          */
-        if (ctx->config.is_manager) {
+        if (directory_is_local(page_id)) {
             /* Query directory to find the actual owner */
             page_directory_t *dir = get_page_directory();
             if (dir) {
@@ -222,24 +621,31 @@ int handle_page_request(const message_t *msg) {
                 int lookup_rc = directory_lookup(dir, page_id, &actual_owner);
 
                 if (lookup_rc == DSM_SUCCESS &&
-                    actual_owner != ctx->node_id &&
-                    actual_owner < MAX_NODES) {
+                    actual_owner != ctx->node_id && actual_owner != requester &&
+                    actual_owner < (node_id_t)ctx->network.max_nodes) {
 
-                    LOG_INFO("Manager proxying PAGE_REQUEST for page %lu from node %u to actual owner node %u",
-                             page_id, requester, actual_owner);
+                    LOG_DEBUG("Manager proxying PAGE_REQUEST for page %lu from node %u to actual owner node %u",
+                              page_id, requester, actual_owner);
 
                     /* Forward the request to the actual owner
                      * CRITICAL: Update sender to manager (node 0) so receiver accepts it */
                     message_t forward_msg;
-                    memcpy(&forward_msg, msg, sizeof(message_t));
+                    forward_msg.header = msg->header;
+                    forward_msg.payload.page_request = msg->payload.page_request;
                     forward_msg.header.sender = ctx->node_id;  /* Set sender to manager */
 
-                    int rc = network_send(actual_owner, &forward_msg);
+                    /* Counted first: the owner can answer, and the requester
+                     * read the stats, before this thread runs again */
+                    STATS_INC(requests_forwarded);
+                    int rc = network_send(route_peer(actual_owner), &forward_msg);
                     if (rc != DSM_SUCCESS) {
                         LOG_ERROR("Failed to forward PAGE_REQUEST to node %u", actual_owner);
                         return rc;
                     }
 
+                    if (access == ACCESS_READ) {
+                        track_proxied_reader(page_id, requester);
+                    }
                     LOG_DEBUG("Successfully forwarded PAGE_REQUEST to node %u", actual_owner);
                     return DSM_SUCCESS;
                 }
@@ -255,44 +661,87 @@ int handle_page_request(const message_t *msg) {
      * This prevents serving stale data when directory is out of sync */
     pthread_mutex_lock(&owning_table->lock);
     page_state_t current_state = entry->state;
+    bool owned = entry->owner == ctx->node_id;
     pthread_mutex_unlock(&owning_table->lock);
 
+    /* A page placed on this node that it never touched is still all zeros:
+     * make it readable so it can be served like any other owned page */
+    if (current_state == PAGE_STATE_INVALID && owned) {
+        pthread_mutex_lock(page_entry_lock(entry));
+        int perm_rc = DSM_SUCCESS;
+        if (entry->state == PAGE_STATE_INVALID) {
+            perm_rc = set_page_permission(entry->local_addr, PAGE_PERM_READ);
+            if (perm_rc == DSM_SUCCESS) {
+                entry->state = PAGE_STATE_READ_ONLY;
+                LOG_DEBUG("Materialized untouched page %lu to serve node %u", page_id, requester);
+            }
+        }
+        current_state = entry->state;
+        pthread_mutex_unlock(page_entry_lock(entry));
+        if (perm_rc != DSM_SUCCESS) {
+            page_table_release(owning_table);
+            return perm_rc;
+        }
+    }
+
     if (current_state == PAGE_STATE_INVALID) {
         page_table_release(owning_table);
 
         /* CRITICAL FIX #6: Manager proxies PAGE_REQUEST for INVALID pages
          * When manager has SVAS mapping for a worker's allocation, the page is INVALID
          * in manager's table. Manager must proxy the request to the actual owner. */
-        if (ctx->config.is_manager) {
+        if (directory_is_local(page_id)) {
             page_directory_t *dir = get_page_directory();
             if (dir) {
                 node_id_t actual_owner = 0;
                 int lookup_rc = directory_lookup(dir, page_id, &actual_owner);
 
                 if (lookup_rc == DSM_SUCCESS &&
-                    actual_owner != ctx->node_id &&
-                    actual_owner < MAX_NODES) {
+                    actual_owner != ctx->node_id && actual_owner != requester &&
+                    actual_owner < (node_id_t)ctx->network.max_nodes) {
 
-                    LOG_INFO("Manager proxying PAGE_REQUEST for INVALID page %lu from node %u to actual owner node %u",
-                             page_id, requester, actual_owner);
+                    LOG_DEBUG("Manager proxying PAGE_REQUEST for INVALID page %lu from node %u to actual owner node %u",
+                              page_id, requester, actual_owner);
 
                     /* CRITICAL: Update sender to manager so receiver accepts it */
                     message_t forward_msg;
-                    memcpy(&forward_msg, msg, sizeof(message_t));
+                    forward_msg.header = msg->header;
+                    forward_msg.payload.page_request = msg->payload.page_request;
                     forward_msg.header.sender = ctx->node_id;  /* Set sender to manager */
 
-                    int rc = network_send(actual_owner, &forward_msg);
+                    /* Counted before sending, as above */
+                    STATS_INC(requests_forwarded);
+                    int rc = network_send(route_peer(actual_owner), &forward_msg);
                     if (rc != DSM_SUCCESS) {
                         LOG_ERROR("Failed to forward PAGE_REQUEST to node %u (rc=%d)", actual_owner, rc);
                         return rc;
                     }
 
-                    LOG_INFO("Successfully forwarded PAGE_REQUEST for INVALID page %lu to node %u", page_id, actual_owner);
+                    if (access == ACCESS_READ) {
+                        track_proxied_reader(page_id, requester);
+                    }
+                    LOG_DEBUG("Successfully forwarded PAGE_REQUEST for INVALID page %lu to node %u", page_id, actual_owner);
                     return DSM_SUCCESS;
                 }
             }
         }
 
+        /* A worker that handed the page on sends the request back to the
+         * directory node, which holds it until the writer that has the page
+         * reports, then forwards it there */
+        node_id_t manager_id = directory_node(page_id);
+        if (!directory_is_local(page_id) && requester != manager_id) {
+            message_t forward_msg;
+            forward_msg.header = msg->header;
+            forward_msg.payload.page_request = msg->payload.page_request;
+            forward_msg.header.sender = ctx->node_id;
+            if (network_send(route_peer(manager_id), &forward_msg) == DSM_SUCCESS) {
+                LOG_DEBUG("Page %lu is no longer here, sent node %u's request back to node %u",
+                          page_id, requester, manager_id);
+                return DSM_SUCCESS;
+            }
+        }
+
         LOG_ERROR("Cannot serve page %lu - page is INVALID (no longer owner)", page_id);
         /* Send error message to requester */
         message_t err_msg;
@@ -304,85 +753,116 @@ int handle_page_request(const message_t *msg) {
         err_msg.payload.error.page_id = page_id;
         snprintf(err_msg.payload.error.error_msg, 256,
                  "Page %lu is INVALID - requester should retry directory lookup", page_id);
-        network_send(requester, &err_msg);
+
+        /* A request the manager forwarded came from another worker: the
+         * error goes straight to it (an ERROR relayed by the manager would
+         * be taken as the manager's own). Without a link the requester
+         * times out and retries. */
+        if (route_direct(requester) == requester) {
+            network_send(requester, &err_msg);
+        } else {
+            LOG_WARN("No link to node %u for the error on page %lu", requester, page_id);
+        }
         return DSM_ERROR_INVALID;
     }
 
-    /* Send page data with the requested access type */
-    int rc = send_page_reply(requester, page_id, access, entry->local_addr);
-    if (rc != DSM_SUCCESS) {
-        page_table_release(owning_table);
-        return rc;
-    }
+    int rc;
 
-    /* Update stats */
-    pthread_mutex_lock(&ctx->stats_lock);
-    ctx->stats.pages_sent++;
-    pthread_mutex_unlock(&ctx->stats_lock);
+    /* READ: downgrade a writable copy before it is read for the reply, and
+     * list the requester as a sharer before it has the copy, so a write
+     * fault here after the reply goes out invalidates it */
+    if (access == ACCESS_READ) {
+        rc = share_for_read(owning_table, entry, requester);
+        if (rc != DSM_SUCCESS) {
+            page_table_release(owning_table);
+            return rc;
+        }
+    }
 
-    /* If request is for WRITE access, downgrade our copy */
+    /* WRITE: stop local writes before the page is read for the reply, or
+     * one made before the copy is dropped is lost with it. The entry
+     * lock, which this node's own write upgrade takes to check it still
+     * owns the page, is held until the page is handed over */
     if (access == ACCESS_WRITE) {
-        LOG_DEBUG("Downgrading page %lu to INVALID (transferred to node %u)",
-                  page_id, requester);
-
-        /* Check return value of set_page_permission */
-        rc = set_page_permission(entry->local_addr, PAGE_PERM_NONE);
+        pthread_mutex_lock(page_entry_lock(entry));
+        rc = revoke_write(owning_table, entry);
         if (rc != DSM_SUCCESS) {
-            LOG_ERROR("Failed to set page %lu permission to NONE", page_id);
+            pthread_mutex_unlock(page_entry_lock(entry));
             page_table_release(owning_table);
             return rc;
         }
+    }
 
-        /* Acquire page table lock before modifying entry state/owner */
-        pthread_mutex_lock(&owning_table->lock);
-        entry->state = PAGE_STATE_INVALID;
-        entry->owner = requester;
-        pthread_mutex_unlock(&owning_table->lock);
-    } else {
-        /* For READ access, we keep our copy and can also share */
-        LOG_DEBUG("Keeping page %lu as shared (node %u also has read access)",
-                  page_id, requester);
-
-        pthread_mutex_lock(&owning_table->lock);
-        if (entry->state == PAGE_STATE_READ_WRITE) {
-            pthread_mutex_unlock(&owning_table->lock);
-
-            /* Check return value of set_page_permission */
-            rc = set_page_permission(entry->local_addr, PAGE_PERM_READ);
-            if (rc != DSM_SUCCESS) {
-                LOG_ERROR("Failed to set page %lu permission to READ", page_id);
+    /* Skip the page bytes when the requester still caches this version */
+    pthread_mutex_lock(&owning_table->lock);
+    uint64_t version = entry->version;
+    pthread_mutex_unlock(&owning_table->lock);
+    uint64_t cached_version = msg->payload.page_request.cached_version;
+    bool copy_current = cached_version != 0 && cached_version == version;
+
+    /* Compress only as far as both the allocation and the requester allow */
+    dsm_compression_t compression =
+        page_codec_negotiate(owning_table->compression, msg->payload.page_request.accept_encodings);
+
+    /* WRITE: the copy here is dropped before the reply goes out, so the
+     * page is sent from a snapshot. Dropped after, a read here could still
+     * see it once the requester has written and passed a barrier */
+    const void *data = copy_current ? NULL : entry->local_addr;
+    void *snapshot = NULL;
+    if (access == ACCESS_WRITE) {
+        if (data) {
+            snapshot = malloc(owning_table->block_size);
+            if (!snapshot) {
+                pthread_mutex_unlock(page_entry_lock(entry));
                 page_table_release(owning_table);
-                return rc;
+                return DSM_ERROR_MEMORY;
             }
-
-            /* Downgrade to READ_ONLY since someone else has a copy */
-            pthread_mutex_lock(&owning_table->lock);
-            entry->state = PAGE_STATE_READ_ONLY;
-            pthread_mutex_unlock(&owning_table->lock);
-        } else {
-            pthread_mutex_unlock(&owning_table->lock);
+            memcpy(snapshot, data, owning_table->block_size);
+            data = snapshot;
         }
 
-        /* CRITICAL FIX (BUG #8): Track requester as sharer in owner's directory
-         * This ensures future writers can get complete sharer list for invalidations */
-        page_directory_t *dir = get_page_directory();
-        if (dir) {
-            rc = directory_add_reader(dir, page_id, requester);
-            if (rc != DSM_SUCCESS && rc != DSM_ERROR_BUSY) {
-                LOG_WARN("Failed to add node %u as sharer for page %lu", requester, page_id);
-            } else {
-                LOG_DEBUG("Tracked node %u as sharer for page %lu in owner's directory",
-                         requester, page_id);
-            }
+        rc = hand_over_page(owning_table, entry, requester);
+        if (rc != DSM_SUCCESS) {
+            free(snapshot);
+            pthread_mutex_unlock(page_entry_lock(entry));
+            page_table_release(owning_table);
+            return rc;
         }
     }
 
-    page_table_release(owning_table);
-    return DSM_SUCCESS;
+    /* Send page data with the requested access type */
+    rc = send_page_reply(requester, page_id, access, data, version, compression,
+                         owning_table->block_size);
+    free(snapshot);
+    if (rc != DSM_SUCCESS) {
+        if (access == ACCESS_WRITE) {
+            /* Not handed over after all: keep the page readable */
+            take_back_page(owning_table, entry);
+            pthread_mutex_unlock(page_entry_lock(entry));
+        }
+        page_table_release(owning_table);
+        return rc;
+    }
+
+    /* Update stats */
+    if (copy_current) {
+        STATS_INC(page_data_skipped);
+    } else {
+        STATS_INC(pages_sent);
+    }
+
+    if (access == ACCESS_WRITE) {
+        pthread_mutex_unlock(page_entry_lock(entry));
+    }
+
+    page_table_release(owning_table);
+    return DSM_SUCCESS;
 }
 
 /* PAGE_REPLY */
-int send_page_reply(node_id_t requester, page_id_t page_id, access_type_t access, const void *data) {
+int send_page_reply(node_id_t requester, page_id_t page_id, access_type_t access,
+                    const void *data, uint64_t version, dsm_compression_t compression,
+                    size_t block_size) {
     dsm_context_t *ctx = dsm_get_context();
     message_t msg;
     memset(&msg, 0, sizeof(msg));
@@ -392,10 +872,39 @@ int send_page_reply(node_id_t requester, page_id_t page_id, access_type_t access
     msg.header.sender = ctx->node_id;
 
     msg.payload.page_reply.page_id = page_id;
-    msg.payload.page_reply.version = 0;
+    msg.payload.page_reply.version = version;
     msg.payload.page_reply.access = access;
+    msg.payload.page_reply.copy_current = data == NULL;
     msg.payload.page_reply.requester = requester;  /* CRITICAL FIX #5: Include requester for manager proxying */
-    memcpy(msg.payload.page_reply.data, data, PAGE_SIZE);
+    msg.payload.page_reply.encoding = PAGE_ENCODING_RAW;
+    msg.payload.page_reply.data_len = PAGE_SIZE;
+
+    /* Raw page bytes are not copied into msg: network_send_page() writes them
+     * to the socket straight from the caller's page (zero-copy). Compressed
+     * pages are encoded into msg's data[] and sent from there. */
+    const void *wire_data = data;
+    if (block_size > PAGE_SIZE) {
+        /* A whole block goes out as bulk data; of the encodings only zero
+         * elision applies to it */
+        msg.payload.page_reply.block_size = (uint32_t)block_size;
+        msg.payload.page_reply.data_len = 0;
+        if (data && compression != DSM_COMPRESSION_NONE && page_codec_is_zero(data, block_size)) {
+            msg.payload.page_reply.encoding = PAGE_ENCODING_ZERO;
+            wire_data = NULL;
+            STATS_INC(pages_compressed);
+            STATS_ADD(compression_bytes_saved, block_size);
+        }
+    } else if (data && compression != DSM_COMPRESSION_NONE) {
+        uint8_t encoding;
+        size_t len = page_codec_encode(data, compression, msg.payload.page_reply.data, &encoding);
+        if (encoding != PAGE_ENCODING_RAW) {
+            msg.payload.page_reply.encoding = encoding;
+            msg.payload.page_reply.data_len = (uint16_t)len;
+            wire_data = msg.payload.page_reply.data;
+            STATS_INC(pages_compressed);
+            STATS_ADD(compression_bytes_saved, PAGE_SIZE - len);
+        }
+    }
 
     /* CRITICAL FIX #7: Workers send PAGE_REPLY through manager (star topology)
      * In star topology, workers are only connected to the manager, not to each other.
@@ -405,25 +914,114 @@ int send_page_reply(node_id_t requester, page_id_t page_id, access_type_t access
      * - The requester field in the message tells the manager where to forward it
      */
     node_id_t target = requester;
-    if (!ctx->config.is_manager && requester != 0) {
+    if (directory_distributed()) {
+        /* No directory node on the way back: straight over the peer link */
+        target = route_direct(requester);
+    } else if (!ctx->config.is_manager && requester != 0) {
         /* Worker replying to another worker: route through manager */
         target = 0;  /* Send to manager */
         LOG_DEBUG("Worker routing PAGE_REPLY for page %lu (requester=node %u) through manager",
                   page_id, requester);
     }
 
-    LOG_DEBUG("Sending PAGE_REPLY for page %lu to node %u (final requester=node %u, access=%s)",
-              page_id, target, requester, access == ACCESS_READ ? "READ" : "WRITE");
-    int rc = network_send(target, &msg);
+    LOG_DEBUG("Sending PAGE_REPLY for page %lu to node %u (final requester=node %u, access=%s%s, %zu data bytes)",
+              page_id, target, requester, access == ACCESS_READ ? "READ" : "WRITE",
+              data ? "" : ", copy current", page_reply_data_len(&msg) + page_reply_bulk_len(&msg));
+    int rc = wire_data ? network_send_page(target, &msg, wire_data) : network_send(target, &msg);
     if (rc == DSM_SUCCESS) {
-        track_bytes_sent(MSG_PAGE_REPLY);  /* ~4100 bytes including 4KB page data */
+        STATS_ADD(network_bytes_sent, 4 + sizeof(msg_header_t) + message_wire_payload_size(&msg) +
+                  page_reply_bulk_len(&msg));
     }
     return rc;
 }
 
+/**
+ * Fail the fetch a PAGE_REPLY could not complete
+ * The local copy is no longer trusted, so the retry asks for the full page.
+ */
+static void fail_page_fetch(page_table_t *table, page_entry_t *entry) {
+    pthread_mutex_lock(&table->lock);
+    entry->version = 0;
+    pthread_mutex_unlock(&table->lock);
+
+    pthread_mutex_lock(page_entry_lock(entry));
+    if (entry->request_pending) {
+        entry->fetch_result = DSM_ERROR_INVALID;
+        entry->request_pending = false;
+        pthread_cond_broadcast(page_entry_ready_cv(entry));
+    }
+    if (entry->prefetch_pending) {
+        entry->prefetch_pending = false;
+        pthread_cond_broadcast(page_entry_ready_cv(entry));
+    }
+    pthread_mutex_unlock(page_entry_lock(entry));
+}
+
 int handle_page_reply(const message_t *msg) {
-    /* Track received bytes */
-    track_bytes_received(MSG_PAGE_REPLY);  /* ~4100 bytes including 4KB page data */
+    return handle_page_reply_data(msg, msg->payload.page_reply.data, page_reply_data_len(msg));
+}
+
+/**
+ * Copy a PAGE_REPLY's data into a page that is writable for the copy
+ * @return DSM_SUCCESS, or DSM_ERROR_INVALID if the data does not fill the page
+ */
+static int install_page_data(const message_t *msg, const uint8_t *data, size_t data_len,
+                             void *page, size_t block_size) {
+    uint8_t encoding = msg->payload.page_reply.encoding;
+    if (block_size == PAGE_SIZE) {
+        /* Copy page data, decompressing it if the owner encoded it */
+        if (encoding == PAGE_ENCODING_RAW) {
+            memcpy(page, data, PAGE_SIZE);
+            return DSM_SUCCESS;
+        }
+        return page_codec_decode(encoding, data, data_len, page);
+    }
+
+    if (encoding == PAGE_ENCODING_ZERO) {
+        memset(page, 0, block_size);
+        return DSM_SUCCESS;
+    }
+    if (encoding != PAGE_ENCODING_RAW || data_len != block_size) {
+        return DSM_ERROR_INVALID;
+    }
+    memcpy(page, data, block_size);
+    return DSM_SUCCESS;
+}
+
+/**
+ * Install a PAGE_REPLY's data into a block that is not mapped (userfaultfd)
+ * Raw pages are copied straight from the receive buffer; compressed ones
+ * are decoded into a bounce page first.
+ * @return DSM_SUCCESS, DSM_ERROR_INVALID if the data does not fill the page,
+ *         or DSM_ERROR_MEMORY
+ */
+static int install_page_data_userfault(const message_t *msg, const uint8_t *data, size_t data_len,
+                                       page_table_t *table, page_entry_t *entry) {
+    uint8_t encoding = msg->payload.page_reply.encoding;
+    if (encoding == PAGE_ENCODING_ZERO) {
+        return userfault_install(table, entry, NULL);
+    }
+    if (encoding == PAGE_ENCODING_RAW) {
+        if (table->block_size > PAGE_SIZE && data_len != table->block_size) {
+            return DSM_ERROR_INVALID;
+        }
+        return userfault_install(table, entry, data);
+    }
+    if (table->block_size > PAGE_SIZE) {
+        return DSM_ERROR_INVALID;
+    }
+
+    uint8_t page[PAGE_SIZE];
+    int rc = page_codec_decode(encoding, data, data_len, page);
+    return rc == DSM_SUCCESS ? userfault_install(table, entry, page) : rc;
+}
+
+int handle_page_reply_data(const message_t *msg, const uint8_t *data, size_t data_len) {
+    /* Track received bytes (only the data bytes in use were on the wire) */
+    STATS_ADD(network_bytes_received, 4 + sizeof(msg_header_t) + message_wire_payload_size(msg) +
+              page_reply_bulk_len(msg));
+    bool copy_current = msg->payload.page_reply.copy_current != 0;
+    const void *wire_data = data ? (const void *)data : (const void *)msg->payload.page_reply.data;
 
     page_id_t page_id = msg->payload.page_reply.page_id;
     uint64_t version = msg->payload.page_reply.version;
@@ -431,8 +1029,9 @@ int handle_page_reply(const message_t *msg) {
     node_id_t sender = msg->header.sender;
     node_id_t requester = msg->payload.page_reply.requester;
 
-    LOG_INFO("HANDLER: Handling PAGE_REPLY for page %lu (version %lu, access=%s) from sender=%u, requester=%u",
+    LOG_DEBUG("HANDLER: Handling PAGE_REPLY for page %lu (version %lu, access=%s) from sender=%u, requester=%u",
               page_id, version, access == ACCESS_READ ? "READ" : "WRITE", sender, requester);
+    trace_event(TRACE_PAGE_REPLY, page_id, (uint8_t)access, 0, 0, sender);
 
     dsm_context_t *ctx = dsm_get_context();
     if (ctx->num_allocations == 0) {
@@ -448,9 +1047,9 @@ int handle_page_reply(const message_t *msg) {
      */
     if (ctx->config.is_manager && requester != ctx->node_id) {
         /* Verify this is a valid forward scenario */
-        if (requester < MAX_NODES && requester != sender) {
-            LOG_INFO("HANDLER: Manager forwarding PAGE_REPLY for page %lu from node %u to requester node %u",
-                     page_id, sender, requester);
+        if (requester < (node_id_t)ctx->network.max_nodes && requester != sender) {
+            LOG_DEBUG("HANDLER: Manager forwarding PAGE_REPLY for page %lu from node %u to requester node %u",
+                      page_id, sender, requester);
 
             pthread_mutex_lock(&ctx->lock);
             bool target_connected = ctx->network.nodes[requester].connected;
@@ -461,43 +1060,39 @@ int handle_page_reply(const message_t *msg) {
                 return DSM_ERROR_NETWORK;
             }
 
-            /* Forward with manager as sender */
+            /* Forward with manager as sender; only header and page metadata are
+             * copied, the page bytes go out straight from the received message */
             message_t forward_msg;
-            memcpy(&forward_msg, msg, sizeof(message_t));
+            memcpy(&forward_msg.header, &msg->header, sizeof(msg_header_t));
+            memcpy(&forward_msg.payload, &msg->payload, offsetof(page_reply_payload_t, data));
             forward_msg.header.sender = ctx->node_id;
 
-            int rc = network_send(requester, &forward_msg);
+            int rc = network_send_page(requester, &forward_msg, wire_data);
             if (rc != DSM_SUCCESS) {
                 LOG_ERROR("HANDLER: Failed to forward PAGE_REPLY to node %u (rc=%d)", requester, rc);
                 return rc;
             }
 
-            LOG_INFO("HANDLER: Successfully forwarded PAGE_REPLY for page %lu to node %u", page_id, requester);
+            LOG_DEBUG("HANDLER: Successfully forwarded PAGE_REPLY for page %lu to node %u", page_id, requester);
             return DSM_SUCCESS;
         }
     }
 
-    /* Search all page tables for this page ID
-     * Hold ctx->lock to prevent race with dsm_free() compacting the array
+    /* Look up the page in the page index
+     * Hold ctx->lock to prevent race with dsm_free() removing the table
      * Acquire reference before unlocking to prevent the table from being freed */
     page_entry_t *entry = NULL;
     page_table_t *owning_table = NULL;
     pthread_mutex_lock(&ctx->lock);
-    for (int i = 0; i < ctx->num_allocations; i++) {
-        if (ctx->page_tables[i]) {
-            entry = page_table_lookup_by_id(ctx->page_tables[i], page_id);
-            if (entry) {
-                owning_table = ctx->page_tables[i];
-                page_table_acquire(owning_table);  /* Acquire reference while holding ctx->lock */
-                break;
-            }
-        }
+    entry = page_index_lookup_id(page_id, &owning_table);
+    if (entry) {
+        page_table_acquire(owning_table);  /* Acquire reference while holding ctx->lock */
     }
     pthread_mutex_unlock(&ctx->lock);
 
     if (!entry || !owning_table) {
-        LOG_INFO("HANDLER: Page %lu not found in local tables (is_manager=%d, requester=%u)",
-                 page_id, ctx->config.is_manager, msg->payload.page_reply.requester);
+        LOG_DEBUG("HANDLER: Page %lu not found in local tables (is_manager=%d, requester=%u)",
+                  page_id, ctx->config.is_manager, msg->payload.page_reply.requester);
 
         /* CRITICAL FIX #5: Manager proxies PAGE_REPLY to actual requester
          * When manager receives PAGE_REPLY for a page it doesn't need, this is likely
@@ -513,15 +1108,16 @@ int handle_page_reply(const message_t *msg) {
             /* Verify this is a valid forward scenario */
             if (original_requester != ctx->node_id &&
                 original_requester != sender &&
-                original_requester < MAX_NODES) {
+                original_requester < (node_id_t)ctx->network.max_nodes) {
 
-                LOG_INFO("Manager proxying PAGE_REPLY for page %lu from node %u to original requester node %u",
-                         page_id, sender, original_requester);
+                LOG_DEBUG("Manager proxying PAGE_REPLY for page %lu from node %u to original requester node %u",
+                          page_id, sender, original_requester);
 
                 /* Forward the reply to the original requester
                  * CRITICAL: Update sender to manager so receiver accepts it */
                 message_t forward_msg;
-                memcpy(&forward_msg, msg, sizeof(message_t));
+                memcpy(&forward_msg.header, &msg->header, sizeof(msg_header_t));
+                memcpy(&forward_msg.payload, &msg->payload, offsetof(page_reply_payload_t, data));
                 forward_msg.header.sender = ctx->node_id;  /* Set sender to manager */
 
                 pthread_mutex_lock(&ctx->lock);
@@ -534,7 +1130,7 @@ int handle_page_reply(const message_t *msg) {
                     return DSM_ERROR_NETWORK;
                 }
 
-                int rc = network_send(original_requester, &forward_msg);
+                int rc = network_send_page(original_requester, &forward_msg, wire_data);
                 if (rc != DSM_SUCCESS) {
                     LOG_ERROR("Failed to forward PAGE_REPLY to node %u", original_requester);
                     return rc;
@@ -549,23 +1145,104 @@ int handle_page_reply(const message_t *msg) {
         return DSM_ERROR_NOT_FOUND;
     }
 
-    LOG_INFO("HANDLER: Found page %lu in local table, copying data and waking waiters", page_id);
+    /* Only a fetch or prefetch in flight may be completed: a late reply to an
+     * abandoned request must not overwrite the page, and a prefetch must not
+     * replace a copy the page got some other way in the meantime */
+    pthread_mutex_lock(page_entry_lock(entry));
+    bool fetching = entry->request_pending;
+    bool prefetching = entry->prefetch_pending;
+    bool invalidated = fetching && entry->fetch_invalidated;
+    pthread_mutex_unlock(page_entry_lock(entry));
+    bool expected = fetching;
+    if (!fetching && prefetching) {
+        pthread_mutex_lock(&owning_table->lock);
+        expected = entry->state == PAGE_STATE_INVALID;
+        pthread_mutex_unlock(&owning_table->lock);
+    }
+    if (!expected) {
+        LOG_DEBUG("HANDLER: Dropping unexpected PAGE_REPLY for page %lu from node %u",
+                  page_id, sender);
+        if (prefetching) {
+            prefetch_cancel(entry);
+        }
+        page_table_release(owning_table);
+        return DSM_SUCCESS;
+    }
 
-    /* CRITICAL FIX: Temporarily enable write access for memcpy
-     * The dispatcher thread handles PAGE_REPLY and must copy data into shared memory.
-     * If the page is in NO_ACCESS or READ_ONLY state, memcpy will trigger a write fault
-     * ON THE DISPATCHER THREAD, causing a deadlock (dispatcher can't receive its own replies).
-     * Solution: Temporarily grant write access, copy data, then set final permission. */
-    int rc = set_page_permission(entry->local_addr, PAGE_PERM_READ_WRITE);
-    if (rc != DSM_SUCCESS) {
-        LOG_ERROR("Failed to grant temporary write access for page %lu data copy", page_id);
+    /* The page was written after this read copy was taken: installing it
+     * would leave a stale copy nobody invalidates, so the fetch is retried */
+    if (invalidated && access == ACCESS_READ) {
+        LOG_DEBUG("HANDLER: Dropping PAGE_REPLY for page %lu invalidated in flight", page_id);
+        pthread_mutex_lock(page_entry_lock(entry));
+        entry->fetch_result = DSM_ERROR_BUSY;
+        entry->request_pending = false;
+        pthread_cond_broadcast(page_entry_ready_cv(entry));
+        pthread_mutex_unlock(page_entry_lock(entry));
         page_table_release(owning_table);
-        return rc;
+        return DSM_SUCCESS;
     }
 
-    /* Copy page data */
-    memcpy(entry->local_addr, msg->payload.page_reply.data, PAGE_SIZE);
-    entry->version = version;
+    int rc;
+    if (copy_current) {
+        /* Grant only: the bytes we cached are the owner's current version */
+        pthread_mutex_lock(&owning_table->lock);
+        bool cached = entry->version != 0 && entry->version == version;
+        pthread_mutex_unlock(&owning_table->lock);
+
+        if (!cached) {
+            LOG_ERROR("HANDLER: Data-less PAGE_REPLY for page %lu version %lu, but no cached copy",
+                      page_id, version);
+            fail_page_fetch(owning_table, entry);
+            page_table_release(owning_table);
+            return DSM_ERROR_INVALID;
+        }
+
+        LOG_DEBUG("HANDLER: Page %lu cached copy is current (version %lu), waking waiters",
+                  page_id, version);
+    } else {
+        LOG_DEBUG("HANDLER: Found page %lu in local table, copying data and waking waiters", page_id);
+
+        /* The reply must carry a page of this allocation's block size */
+        size_t block_size = owning_table->block_size;
+        size_t reply_block = msg->payload.page_reply.block_size > PAGE_SIZE ?
+                             msg->payload.page_reply.block_size : PAGE_SIZE;
+        if (reply_block != block_size) {
+            LOG_ERROR("HANDLER: PAGE_REPLY for page %lu carries %zu bytes, pages here are %zu",
+                      page_id, reply_block, block_size);
+            fail_page_fetch(owning_table, entry);
+            page_table_release(owning_table);
+            return DSM_ERROR_INVALID;
+        }
+
+        if (userfault_active()) {
+            /* The block stays unreachable until its permission is set below */
+            rc = install_page_data_userfault(msg, data, data_len, owning_table, entry);
+        } else {
+            /* CRITICAL FIX: Temporarily enable write access for memcpy
+             * The dispatcher thread handles PAGE_REPLY and must copy data into shared memory.
+             * If the page is in NO_ACCESS or READ_ONLY state, memcpy will trigger a write fault
+             * ON THE DISPATCHER THREAD, causing a deadlock (dispatcher can't receive its own replies).
+             * Solution: Temporarily grant write access, copy data, then set final permission. */
+            rc = set_page_permission(entry->local_addr, PAGE_PERM_READ_WRITE);
+            if (rc != DSM_SUCCESS) {
+                LOG_ERROR("Failed to grant temporary write access for page %lu data copy", page_id);
+                page_table_release(owning_table);
+                return rc;
+            }
+
+            rc = install_page_data(msg, data, data_len, entry->local_addr, block_size);
+        }
+        if (rc != DSM_SUCCESS) {
+            LOG_ERROR("HANDLER: Cannot install encoding %u of PAGE_REPLY for page %lu (rc=%d)",
+                      msg->payload.page_reply.encoding, page_id, rc);
+            fail_page_fetch(owning_table, entry);
+            page_table_release(owning_table);
+            return rc;
+        }
+        pthread_mutex_lock(&owning_table->lock);
+        entry->version = version;
+        pthread_mutex_unlock(&owning_table->lock);
+    }
 
     /* Set appropriate permission based on requested access type
      * This ensures coherence protocol correctness:
@@ -584,21 +1261,46 @@ int handle_page_reply(const message_t *msg) {
     LOG_DEBUG("Copied page %lu data and set permission to %s",
               page_id, permission == PAGE_PERM_READ ? "READ" : "READ_WRITE");
 
+    /* Take ownership before waking the faulting thread: a request served
+     * here before it runs again must find this node the owner */
+    if (fetching && access == ACCESS_WRITE) {
+        pthread_mutex_lock(&owning_table->lock);
+        entry->owner = ctx->node_id;
+        pthread_mutex_unlock(&owning_table->lock);
+    }
+
     /* Signal waiting threads (Task 8.1: wake all queued requesters) */
-    pthread_mutex_lock(&entry->entry_lock);
+    pthread_mutex_lock(page_entry_lock(entry));
     int waiters = entry->num_waiting_threads;
+    bool prefetched = entry->prefetch_pending;
+    entry->fetch_result = DSM_SUCCESS;  /* Not an earlier attempt's error */
+    entry->handed_over = false;
     entry->request_pending = false;
-    pthread_cond_broadcast(&entry->ready_cv);  /* Wake ALL waiting threads */
-    pthread_mutex_unlock(&entry->entry_lock);
+    entry->prefetch_pending = false;
+    pthread_cond_broadcast(page_entry_ready_cv(entry));  /* Wake ALL waiting threads */
+    pthread_mutex_unlock(page_entry_lock(entry));
 
-    LOG_INFO("HANDLER: Woke %d waiting threads for page %lu, request_pending set to false", waiters, page_id);
+    LOG_DEBUG("HANDLER: Woke %d waiting threads for page %lu, request_pending set to false", waiters, page_id);
+
+    /* A prefetch has no fetching thread to register us as a reader */
+    if (prefetched && !fetching) {
+        page_directory_t *dir = get_page_directory();
+        if (dir) {
+            rc = directory_add_reader(dir, page_id, ctx->node_id);
+            if (rc != DSM_SUCCESS && rc != DSM_ERROR_BUSY) {
+                LOG_WARN("Failed to add reader to directory for prefetched page %lu", page_id);
+            }
+        }
+        STATS_INC(pages_prefetched);
+        async_access_notify();
+    }
 
     page_table_release(owning_table);
     return DSM_SUCCESS;
 }
 
 /* INVALIDATE */
-int send_invalidate(node_id_t target, page_id_t page_id) {
+int send_invalidate(node_id_t target, page_id_t page_id, node_id_t new_owner) {
     dsm_context_t *ctx = dsm_get_context();
     message_t msg;
     memset(&msg, 0, sizeof(msg));
@@ -608,10 +1310,11 @@ int send_invalidate(node_id_t target, page_id_t page_id) {
     msg.header.sender = ctx->node_id;
 
     msg.payload.invalidate.page_id = page_id;
-    msg.payload.invalidate.new_owner = ctx->node_id;
+    msg.payload.invalidate.new_owner = new_owner;
+    msg.payload.invalidate.advice = (uint8_t)directory_advice_for(page_id, target);
 
     LOG_DEBUG("Sending INVALIDATE for page %lu to node %u", page_id, target);
-    int rc = network_send(target, &msg);
+    int rc = network_send_async(route_peer(target), &msg);
     if (rc == DSM_SUCCESS) {
         track_bytes_sent(MSG_INVALIDATE);
     }
@@ -630,52 +1333,55 @@ int send_invalidate_ack(node_id_t target, page_id_t page_id) {
     msg.payload.invalidate_ack.page_id = page_id;
     msg.payload.invalidate_ack.acker = ctx->node_id;
 
-    int rc = network_send(target, &msg);
+    int rc = network_send_async(route_peer(target), &msg);
     if (rc == DSM_SUCCESS) {
         track_bytes_sent(MSG_INVALIDATE_ACK);
     }
     return rc;
 }
 
-int handle_invalidate(const message_t *msg) {
-    /* Track received bytes */
-    track_bytes_received(MSG_INVALIDATE);
-
-    page_id_t page_id = msg->payload.invalidate.page_id;
-    node_id_t new_owner = msg->payload.invalidate.new_owner;
-
-    LOG_DEBUG("Handling INVALIDATE for page %lu (new_owner=%u)", page_id, new_owner);
-
+/**
+ * Drop this node's copy of a page that new_owner now writes
+ *
+ * @param set_dir_owner Record new_owner in the directory; the manager waits
+ *        for the writer's OWNER_UPDATE instead, as the write request that
+ *        follows a fan-out must still be proxied to the old owner
+ * @param advice Advice the page's directory node sent with the INVALIDATE
+ */
+static void invalidate_local_copy(page_id_t page_id, node_id_t new_owner, bool set_dir_owner,
+                                  directory_advice_t advice) {
     dsm_context_t *ctx = dsm_get_context();
 
-    /* Search all page tables for this page ID
-     * Hold ctx->lock to prevent race with dsm_free() compacting the array
+    /* Look up the page in the page index
+     * Hold ctx->lock to prevent race with dsm_free() removing the table
      * Acquire reference before unlocking to prevent the table from being freed */
     page_entry_t *entry = NULL;
     page_table_t *owning_table = NULL;
     pthread_mutex_lock(&ctx->lock);
-    for (int i = 0; i < ctx->num_allocations; i++) {
-        if (ctx->page_tables[i]) {
-            entry = page_table_lookup_by_id(ctx->page_tables[i], page_id);
-            if (entry) {
-                owning_table = ctx->page_tables[i];
-                page_table_acquire(owning_table);  /* Acquire reference while holding ctx->lock */
-                break;
-            }
-        }
+    entry = page_index_lookup_id(page_id, &owning_table);
+    if (entry) {
+        page_table_acquire(owning_table);  /* Acquire reference while holding ctx->lock */
     }
     pthread_mutex_unlock(&ctx->lock);
 
     if (!entry || !owning_table) {
         LOG_WARN("Page %lu not found in any table, ignoring invalidation", page_id);
-        /* Still send ACK even if page not found */
-        return send_invalidate_ack(msg->header.sender, page_id);
+        return;
     }
 
     /* Update stats */
-    pthread_mutex_lock(&ctx->stats_lock);
-    ctx->stats.invalidations_received++;
-    pthread_mutex_unlock(&ctx->stats_lock);
+    STATS_INC(invalidations_received);
+    sharing_profile_invalidated(page_id, new_owner);
+
+    /* A prefetch in flight may carry the page as it was before this write,
+     * and so may the reply to a read fetch: the owner lists the reader as a
+     * sharer before sending it, so this INVALIDATE can arrive first */
+    prefetch_cancel(entry);
+    pthread_mutex_lock(page_entry_lock(entry));
+    if (entry->request_pending) {
+        entry->fetch_invalidated = true;
+    }
+    pthread_mutex_unlock(page_entry_lock(entry));
 
     /* Set page to INVALID */
     int rc = set_page_permission(entry->local_addr, PAGE_PERM_NONE);
@@ -694,136 +1400,568 @@ int handle_invalidate(const message_t *msg) {
      * Critical for coherence protocol correctness */
     page_directory_t *dir = get_page_directory();
     if (dir) {
-        directory_set_owner(dir, page_id, new_owner);
+        if (set_dir_owner) {
+            directory_set_owner(dir, page_id, new_owner);
+        }
         directory_remove_sharer(dir, page_id, ctx->node_id);
+        directory_note_invalidations(dir, page_id, 1);
         LOG_DEBUG("Updated directory: page %lu now owned by node %u", page_id, new_owner);
+
+        /* A page this node mostly reads is fetched again at the next barrier */
+        if (!directory_is_local(page_id)) {
+            directory_note_advice(dir, page_id, advice);
+        }
+        if (directory_page_advice(dir, page_id) == DIRECTORY_ADVICE_REPLICATE) {
+            prefetch_note_replica(page_id);
+        }
     }
 
     LOG_DEBUG("Invalidated page %lu (state=INVALID, new_owner=%u)",
               page_id, new_owner);
-
-    /* Send ACK */
     page_table_release(owning_table);
-    return send_invalidate_ack(msg->header.sender, page_id);
 }
 
-int handle_invalidate_ack(const message_t *msg) {
+int handle_invalidate(const message_t *msg) {
     /* Track received bytes */
-    track_bytes_received(MSG_INVALIDATE_ACK);
+    track_bytes_received(MSG_INVALIDATE);
 
-    page_id_t page_id = msg->payload.invalidate_ack.page_id;
-    node_id_t acker = msg->payload.invalidate_ack.acker;
+    page_id_t page_id = msg->payload.invalidate.page_id;
+    node_id_t new_owner = msg->payload.invalidate.new_owner;
 
-    LOG_DEBUG("Received INVALIDATE_ACK for page %lu from node %u", page_id, acker);
+    LOG_DEBUG("Handling INVALIDATE for page %lu (new_owner=%u)", page_id, new_owner);
+    trace_event(TRACE_INVALIDATE, page_id, TRACE_ACCESS_NONE, 0, 0, msg->header.sender);
 
-    dsm_context_t *ctx = dsm_get_context();
+    invalidate_local_copy(page_id, new_owner, true,
+                          (directory_advice_t)msg->payload.invalidate.advice);
 
-    /* Find the page entry to decrement pending ACK counter */
-    page_entry_t *entry = NULL;
-    pthread_mutex_lock(&ctx->lock);
-    for (int i = 0; i < ctx->num_allocations; i++) {
-        if (ctx->page_tables[i]) {
-            entry = page_table_lookup_by_id(ctx->page_tables[i], page_id);
-            if (entry) break;
+    /* Send ACK (also for pages not found, so the writer does not wait) */
+    return send_invalidate_ack(msg->header.sender, page_id);
+}
+
+/* INVALIDATE_FANOUT */
+
+/* Fan-outs whose ACKs stopped coming are dropped after this long
+ * (their writer gave up waiting after 5 seconds) */
+#define FANOUT_STALE_SEC 30
+
+/**
+ * Directory node: an INVALIDATE_FANOUT still collecting ACKs
+ */
+typedef struct inv_fanout_s {
+    page_id_t page_id;         /**< Page being written */
+    node_id_t writer;          /**< Node waiting for the aggregated ACK */
+    int pending;               /**< Targets that have not acked */
+    int num_targets;           /**< Entries in targets */
+    node_id_t *targets;        /**< Invalidated nodes, DSM_NODE_NONE once acked */
+    time_t started;            /**< When the INVALIDATEs went out */
+    bool upgrade;              /**< PAGE_UPGRADE: forward request instead of acking */
+    page_request_payload_t request; /**< Write request of a PAGE_UPGRADE */
+    struct inv_fanout_s *next;
+} inv_fanout_t;
+
+static struct {
+    pthread_mutex_t lock;
+    inv_fanout_t *head;
+} g_fanouts = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .head = NULL
+};
+
+static void fanout_free(inv_fanout_t *f) {
+    free(f->targets);
+    free(f);
+}
+
+/**
+ * Start collecting ACKs for a fan-out; drops stale ones and any earlier
+ * fan-out of the same page, whose writer has moved on
+ */
+static int fanout_register(page_id_t page_id, node_id_t writer, const node_id_t *targets,
+                           int num_targets, const page_request_payload_t *upgrade) {
+    inv_fanout_t *f = calloc(1, sizeof(inv_fanout_t));
+    node_id_t *copy = malloc((size_t)num_targets * sizeof(node_id_t));
+    if (!f || !copy) {
+        free(f);
+        free(copy);
+        return DSM_ERROR_MEMORY;
+    }
+    memcpy(copy, targets, (size_t)num_targets * sizeof(node_id_t));
+    f->page_id = page_id;
+    f->writer = writer;
+    f->pending = num_targets;
+    f->num_targets = num_targets;
+    f->targets = copy;
+    f->started = time(NULL);
+    if (upgrade) {
+        f->upgrade = true;
+        f->request = *upgrade;
+    }
+
+    pthread_mutex_lock(&g_fanouts.lock);
+    inv_fanout_t **link = &g_fanouts.head;
+    while (*link) {
+        inv_fanout_t *old = *link;
+        if (old->page_id == page_id || f->started - old->started > FANOUT_STALE_SEC) {
+            LOG_DEBUG("Dropping fan-out of page %lu for node %u (%d ACKs missing)",
+                      old->page_id, old->writer, old->pending);
+            *link = old->next;
+            fanout_free(old);
+        } else {
+            link = &old->next;
         }
     }
-    pthread_mutex_unlock(&ctx->lock);
+    f->next = g_fanouts.head;
+    g_fanouts.head = f;
+    pthread_mutex_unlock(&g_fanouts.lock);
+    return DSM_SUCCESS;
+}
 
-    if (!entry) {
-        LOG_WARN("Received INVALIDATE_ACK for unknown page %lu", page_id);
-        return DSM_SUCCESS;
+/**
+ * Tell a writer its invalidations are done
+ * A PAGE_UPGRADE's write request is served as if the writer had sent it
+ * now; the owner's reply (data-less if the writer's copy is current) is
+ * the writer's answer.
+ */
+static void fanout_complete(page_id_t page_id, node_id_t writer,
+                            const page_request_payload_t *upgrade) {
+    if (!upgrade) {
+        send_invalidate_ack(writer, page_id);
+        return;
     }
 
-    /* Decrement pending ACK counter and signal if all ACKs received */
-    pthread_mutex_lock(&entry->entry_lock);
-    if (entry->pending_inv_acks > 0) {
-        entry->pending_inv_acks--;
-        LOG_DEBUG("Page %lu: pending_inv_acks decremented to %d",
-                  page_id, entry->pending_inv_acks);
+    message_t req;
+    memset(&req, 0, sizeof(req));
+    req.header.magic = MSG_MAGIC;
+    req.header.type = MSG_PAGE_REQUEST;
+    req.header.sender = writer;
+    req.payload.page_request = *upgrade;
+    handle_page_request(&req);
+}
 
-        if (entry->pending_inv_acks == 0) {
-            /* All ACKs received, wake up waiting thread */
-            pthread_cond_signal(&entry->inv_ack_cv);
-            LOG_DEBUG("All invalidation ACKs received for page %lu, signaling", page_id);
+/**
+ * Count one target's ACK; the last one sends the writer its ACK
+ * @return false if no fan-out of this page waits for this node
+ */
+static bool fanout_ack(page_id_t page_id, node_id_t acker) {
+    node_id_t writer = DSM_NODE_NONE;
+    bool upgrade = false;
+    page_request_payload_t request;
+    bool found = false;
+
+    pthread_mutex_lock(&g_fanouts.lock);
+    for (inv_fanout_t **link = &g_fanouts.head; *link && !found; link = &(*link)->next) {
+        inv_fanout_t *f = *link;
+        if (f->page_id != page_id) {
+            continue;
+        }
+        for (int i = 0; i < f->num_targets; i++) {
+            if (f->targets[i] == acker) {
+                f->targets[i] = DSM_NODE_NONE;
+                f->pending--;
+                found = true;
+                break;
+            }
+        }
+        if (found && f->pending == 0) {
+            writer = f->writer;
+            upgrade = f->upgrade;
+            request = f->request;
+            *link = f->next;
+            fanout_free(f);
+        }
+        if (found) {
+            break;
         }
     }
-    pthread_mutex_unlock(&entry->entry_lock);
+    pthread_mutex_unlock(&g_fanouts.lock);
 
-    return DSM_SUCCESS;
+    if (!found) {
+        return false;
+    }
+
+    /* The acker dropped its copy */
+    page_directory_t *dir = get_page_directory();
+    if (dir) {
+        directory_remove_sharer(dir, page_id, acker);
+    }
+    if (writer != DSM_NODE_NONE) {
+        LOG_DEBUG("All invalidations of page %lu done for node %u", page_id, writer);
+        fanout_complete(page_id, writer, upgrade ? &request : NULL);
+    }
+    return true;
 }
 
-/* LOCK */
-int send_lock_request(node_id_t manager, lock_id_t lock_id) {
+int send_invalidate_fanout(node_id_t manager, page_id_t page_id, node_id_t exclude,
+                           const node_id_t *sharers, int num_sharers) {
     dsm_context_t *ctx = dsm_get_context();
     message_t msg;
     memset(&msg, 0, sizeof(msg));
 
     msg.header.magic = MSG_MAGIC;
-    msg.header.type = MSG_LOCK_REQUEST;
+    msg.header.type = MSG_INVALIDATE_FANOUT;
     msg.header.sender = ctx->node_id;
 
-    msg.payload.lock_request.lock_id = lock_id;
-    msg.payload.lock_request.requester = ctx->node_id;
+    if (num_sharers > MAX_SHARERS) {
+        num_sharers = MAX_SHARERS;
+    }
+    msg.payload.invalidate_fanout.page_id = page_id;
+    msg.payload.invalidate_fanout.writer = ctx->node_id;
+    msg.payload.invalidate_fanout.exclude = exclude;
+    msg.payload.invalidate_fanout.num_sharers = num_sharers;
+    for (int i = 0; i < num_sharers; i++) {
+        msg.payload.invalidate_fanout.sharers[i] = sharers[i];
+    }
 
-    LOG_DEBUG("Sending LOCK_REQUEST for lock %lu to node %u", lock_id, manager);
-    int rc = network_send(manager, &msg);
+    LOG_DEBUG("Sending INVALIDATE_FANOUT for page %lu (%d known sharers)", page_id, num_sharers);
+    int rc = network_send_async(route_peer(manager), &msg);
     if (rc == DSM_SUCCESS) {
-        track_bytes_sent(MSG_LOCK_REQUEST);
+        track_bytes_sent(MSG_INVALIDATE_FANOUT);
     }
     return rc;
 }
 
-int send_lock_grant(node_id_t grantee, lock_id_t lock_id) {
+/**
+ * Directory node: invalidate every copy of a page but the writer's and exclude's
+ *
+ * @param sharers Sharers known to the writer
+ * @param upgrade Write request to serve when done, NULL to ack the writer
+ */
+static int start_fanout(page_id_t page_id, node_id_t writer, node_id_t exclude,
+                        const node_id_t *sharers, int num_sharers,
+                        const page_request_payload_t *upgrade) {
     dsm_context_t *ctx = dsm_get_context();
-    message_t msg;
-    memset(&msg, 0, sizeof(msg));
-
-    msg.header.magic = MSG_MAGIC;
-    msg.header.type = MSG_LOCK_GRANT;
-    msg.header.sender = ctx->node_id;
 
-    msg.payload.lock_grant.lock_id = lock_id;
-    msg.payload.lock_grant.grantee = grantee;
+    /* The directory node saw every read; add what the writer knows.
+     * Ownership moves only with the writer's OWNER_UPDATE, after the data */
+    node_id_t targets[MAX_SHARERS];
+    int num_targets = 0;
+    page_directory_t *dir = get_page_directory();
+    if (dir) {
+        directory_get_sharers(dir, page_id, targets, &num_targets);
+        directory_remove_sharer(dir, page_id, writer);
+    }
+    for (int i = 0; i < num_sharers && num_targets < MAX_SHARERS; i++) {
+        bool listed = false;
+        for (int j = 0; j < num_targets && !listed; j++) {
+            listed = targets[j] == sharers[i];
+        }
+        if (!listed) {
+            targets[num_targets++] = sharers[i];
+        }
+    }
 
-    int rc = network_send(grantee, &msg);
-    if (rc == DSM_SUCCESS) {
-        track_bytes_sent(MSG_LOCK_GRANT);
+    /* Keep remote live nodes other than the writer and the owner it fetches
+     * from (a home reaches workers over peer links, opened as they are sent) */
+    bool distributed = directory_distributed();
+    bool invalidate_self = false;
+    int kept = 0;
+    pthread_mutex_lock(&ctx->lock);
+    for (int i = 0; i < num_targets; i++) {
+        node_id_t target = targets[i];
+        if (target == writer || target == exclude) {
+            continue;
+        }
+        if (target == ctx->node_id) {
+            invalidate_self = true;
+            continue;
+        }
+        if (target >= (node_id_t)ctx->network.max_nodes ||
+            (!distributed && !ctx->network.nodes[target].connected) ||
+            ctx->network.nodes[target].is_failed) {
+            LOG_WARN("Skipping invalidation to unreachable node %u for page %lu", target, page_id);
+            continue;
+        }
+        targets[kept++] = target;
     }
-    return rc;
-}
+    pthread_mutex_unlock(&ctx->lock);
+    num_targets = kept;
 
-int send_lock_release(node_id_t manager, lock_id_t lock_id) {
-    dsm_context_t *ctx = dsm_get_context();
-    message_t msg;
-    memset(&msg, 0, sizeof(msg));
+    LOG_DEBUG("Fanning out invalidation of page %lu for node %u to %d nodes%s",
+              page_id, writer, num_targets, invalidate_self ? " and this node" : "");
+    if (dir) {
+        directory_note_invalidations(dir, page_id, num_targets);
+    }
 
-    msg.header.magic = MSG_MAGIC;
-    msg.header.type = MSG_LOCK_RELEASE;
-    msg.header.sender = ctx->node_id;
+    if (invalidate_self) {
+        invalidate_local_copy(page_id, writer, false, DIRECTORY_ADVICE_NONE);
+    }
 
-    msg.payload.lock_release.lock_id = lock_id;
-    msg.payload.lock_release.releaser = ctx->node_id;
+    if (num_targets == 0 ||
+        fanout_register(page_id, writer, targets, num_targets, upgrade) != DSM_SUCCESS) {
+        if (num_targets > 0) {
+            LOG_ERROR("Out of memory tracking fan-out of page %lu, not invalidating %d nodes",
+                      page_id, num_targets);
+        }
+        fanout_complete(page_id, writer, upgrade);
+        return DSM_SUCCESS;
+    }
 
-    LOG_DEBUG("Sending LOCK_RELEASE for lock %lu to node %u", lock_id, manager);
-    int rc = network_send(manager, &msg);
-    if (rc == DSM_SUCCESS) {
-        track_bytes_sent(MSG_LOCK_RELEASE);
+    /* All INVALIDATEs go out at once through the per-node send queues */
+    for (int i = 0; i < num_targets; i++) {
+        if (send_invalidate(targets[i], page_id, writer) == DSM_SUCCESS) {
+            STATS_INC(invalidations_sent);
+        } else {
+            LOG_WARN("Failed to send invalidation to node %u", targets[i]);
+            fanout_ack(page_id, targets[i]);
+        }
     }
-    return rc;
+    return DSM_SUCCESS;
 }
 
-int handle_lock_request(const message_t *msg) {
+int handle_invalidate_fanout(const message_t *msg) {
     /* Track received bytes */
-    track_bytes_received(MSG_LOCK_REQUEST);
+    track_bytes_received(MSG_INVALIDATE_FANOUT);
 
-    lock_id_t lock_id = msg->payload.lock_request.lock_id;
+    const invalidate_fanout_payload_t *req = &msg->payload.invalidate_fanout;
+    page_id_t page_id = req->page_id;
+
+    if (!directory_is_local(page_id)) {
+        LOG_WARN("INVALIDATE_FANOUT for page %lu sent to a node not its directory", page_id);
+        return DSM_ERROR_INVALID;
+    }
+    if (req->num_sharers < 0 || req->num_sharers > MAX_SHARERS) {
+        LOG_ERROR("INVALIDATE_FANOUT from node %u lists %d sharers", req->writer, req->num_sharers);
+        return DSM_ERROR_INVALID;
+    }
+
+    if (!handoff_admit(msg, page_id, req->writer, DSM_NODE_NONE)) {
+        return DSM_SUCCESS;
+    }
+
+    /* The owner upgrades its own copy. If the page was handed on while this
+     * waited, the writer finds out after the ACK and asks for it again */
+    page_directory_t *dir = get_page_directory();
+    node_id_t owner = DSM_NODE_NONE;
+    if (dir && directory_lookup(dir, page_id, &owner) == DSM_SUCCESS &&
+        owner != req->writer && owner != DSM_NODE_NONE) {
+        LOG_DEBUG("INVALIDATE_FANOUT of page %lu from node %u, which node %u holds now",
+                  page_id, req->writer, owner);
+        handoff_release(page_id, req->writer);
+        return send_invalidate_ack(req->writer, page_id);
+    }
+
+    node_id_t sharers[MAX_SHARERS];
+    for (int i = 0; i < req->num_sharers; i++) {
+        sharers[i] = req->sharers[i];
+    }
+    return start_fanout(page_id, req->writer, req->exclude, sharers, req->num_sharers, NULL);
+}
+
+/* PAGE_UPGRADE */
+int send_page_upgrade(node_id_t manager, page_id_t page_id, node_id_t owner,
+                      uint64_t cached_version, const node_id_t *sharers, int num_sharers) {
+    dsm_context_t *ctx = dsm_get_context();
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+
+    msg.header.magic = MSG_MAGIC;
+    msg.header.type = MSG_PAGE_UPGRADE;
+    msg.header.sender = ctx->node_id;
+
+    if (num_sharers > MAX_SHARERS) {
+        num_sharers = MAX_SHARERS;
+    }
+    msg.payload.page_upgrade.request.page_id = page_id;
+    msg.payload.page_upgrade.request.access = ACCESS_WRITE;
+    msg.payload.page_upgrade.request.requester = ctx->node_id;
+    msg.payload.page_upgrade.request.cached_version = cached_version;
+    msg.payload.page_upgrade.request.accept_encodings = page_codec_supported();
+    msg.payload.page_upgrade.owner = owner;
+    msg.payload.page_upgrade.num_sharers = num_sharers;
+    for (int i = 0; i < num_sharers; i++) {
+        msg.payload.page_upgrade.sharers[i] = sharers[i];
+    }
+
+    LOG_DEBUG("Sending PAGE_UPGRADE for page %lu (owner=%u, version=%lu, %d known sharers)",
+              page_id, owner, cached_version, num_sharers);
+    int rc = network_send_async(route_peer(manager), &msg);
+    if (rc == DSM_SUCCESS) {
+        track_bytes_sent(MSG_PAGE_UPGRADE);
+    }
+    return rc;
+}
+
+int handle_page_upgrade(const message_t *msg) {
+    /* Track received bytes */
+    track_bytes_received(MSG_PAGE_UPGRADE);
+
+    const page_upgrade_payload_t *req = &msg->payload.page_upgrade;
+    page_request_payload_t request = req->request;
+    page_id_t page_id = request.page_id;
+
+    if (!directory_is_local(page_id)) {
+        LOG_WARN("PAGE_UPGRADE for page %lu sent to a node not its directory", page_id);
+        return DSM_ERROR_INVALID;
+    }
+    if (req->num_sharers < 0 || req->num_sharers > MAX_SHARERS ||
+        request.access != ACCESS_WRITE) {
+        LOG_ERROR("Malformed PAGE_UPGRADE from node %u (%d sharers, access=%d)",
+                  request.requester, req->num_sharers, request.access);
+        return DSM_ERROR_INVALID;
+    }
+
+    /* One write of a page at a time: this one waits for the last to land */
+    if (!handoff_admit(msg, page_id, request.requester, DSM_NODE_NONE)) {
+        return DSM_SUCCESS;
+    }
+
+    /* The request is served by the owner the directory names, so that is
+     * the copy left for the PAGE_REQUEST to hand over */
+    node_id_t owner = req->owner;
+    page_directory_t *dir = get_page_directory();
+    if (dir) {
+        directory_lookup(dir, page_id, &owner);
+    }
+
+    node_id_t sharers[MAX_SHARERS];
+    for (int i = 0; i < req->num_sharers; i++) {
+        sharers[i] = req->sharers[i];
+    }
+    return start_fanout(page_id, request.requester, owner, sharers, req->num_sharers, &request);
+}
+
+int handle_invalidate_ack(const message_t *msg) {
+    /* Track received bytes */
+    track_bytes_received(MSG_INVALIDATE_ACK);
+
+    page_id_t page_id = msg->payload.invalidate_ack.page_id;
+    node_id_t acker = msg->payload.invalidate_ack.acker;
+
+    LOG_DEBUG("Received INVALIDATE_ACK for page %lu from node %u", page_id, acker);
+
+    dsm_context_t *ctx = dsm_get_context();
+
+    /* Directory node: ACKs of a fan-out are collected for its writer */
+    if ((ctx->config.is_manager || directory_distributed()) && fanout_ack(page_id, acker)) {
+        return DSM_SUCCESS;
+    }
+
+    /* Find the page entry to decrement pending ACK counter */
+    page_entry_t *entry = NULL;
+    pthread_mutex_lock(&ctx->lock);
+    entry = page_index_lookup_id(page_id, NULL);
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (!entry) {
+        LOG_WARN("Received INVALIDATE_ACK for unknown page %lu", page_id);
+        return DSM_SUCCESS;
+    }
+
+    /* Decrement pending ACK counter and signal if all ACKs received */
+    pthread_mutex_lock(page_entry_lock(entry));
+    if (entry->pending_inv_acks > 0) {
+        entry->pending_inv_acks--;
+        LOG_DEBUG("Page %lu: pending_inv_acks decremented to %d",
+                  page_id, entry->pending_inv_acks);
+
+        if (entry->pending_inv_acks == 0) {
+            /* All ACKs received, wake up waiting thread */
+            pthread_cond_broadcast(page_entry_inv_ack_cv(entry));  /* The bucket may have other waiters */
+            LOG_DEBUG("All invalidation ACKs received for page %lu, signaling", page_id);
+        }
+    }
+    pthread_mutex_unlock(page_entry_lock(entry));
+
+    return DSM_SUCCESS;
+}
+
+/* LOCK */
+int send_lock_request(node_id_t manager, lock_id_t lock_id, lock_mode_t mode) {
+    dsm_context_t *ctx = dsm_get_context();
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+
+    msg.header.magic = MSG_MAGIC;
+    msg.header.type = MSG_LOCK_REQUEST;
+    msg.header.sender = ctx->node_id;
+
+    msg.payload.lock_request.lock_id = lock_id;
+    msg.payload.lock_request.requester = ctx->node_id;
+    msg.payload.lock_request.mode = (uint8_t)mode;
+
+    LOG_DEBUG("Sending LOCK_REQUEST for lock %lu to node %u (mode=%d)", lock_id, manager, mode);
+    int rc = network_send(manager, &msg);
+    if (rc == DSM_SUCCESS) {
+        track_bytes_sent(MSG_LOCK_REQUEST);
+    }
+    return rc;
+}
+
+int send_lock_grant(node_id_t grantee, lock_id_t lock_id, lock_mode_t mode, bool recall) {
+    dsm_context_t *ctx = dsm_get_context();
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+
+    msg.header.magic = MSG_MAGIC;
+    msg.header.type = MSG_LOCK_GRANT;
+    msg.header.sender = ctx->node_id;
+
+    msg.payload.lock_grant.lock_id = lock_id;
+    msg.payload.lock_grant.grantee = grantee;
+    msg.payload.lock_grant.recall = recall ? 1 : 0;
+    msg.payload.lock_grant.mode = (uint8_t)mode;
+
+    int rc = network_send(grantee, &msg);
+    if (rc == DSM_SUCCESS) {
+        track_bytes_sent(MSG_LOCK_GRANT);
+    }
+    return rc;
+}
+
+int send_lock_release(node_id_t manager, lock_id_t lock_id) {
+    dsm_context_t *ctx = dsm_get_context();
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+
+    msg.header.magic = MSG_MAGIC;
+    msg.header.type = MSG_LOCK_RELEASE;
+    msg.header.sender = ctx->node_id;
+
+    msg.payload.lock_release.lock_id = lock_id;
+    msg.payload.lock_release.releaser = ctx->node_id;
+
+    LOG_DEBUG("Sending LOCK_RELEASE for lock %lu to node %u", lock_id, manager);
+    int rc = network_send(manager, &msg);
+    if (rc == DSM_SUCCESS) {
+        track_bytes_sent(MSG_LOCK_RELEASE);
+    }
+    return rc;
+}
+
+int send_lock_recall(node_id_t holder, lock_id_t lock_id) {
+    dsm_context_t *ctx = dsm_get_context();
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+
+    msg.header.magic = MSG_MAGIC;
+    msg.header.type = MSG_LOCK_RECALL;
+    msg.header.sender = ctx->node_id;
+
+    msg.payload.lock_recall.lock_id = lock_id;
+    msg.payload.lock_recall.holder = holder;
+
+    LOG_DEBUG("Sending LOCK_RECALL for lock %lu to node %u", lock_id, holder);
+    int rc = network_send(holder, &msg);
+    if (rc == DSM_SUCCESS) {
+        track_bytes_sent(MSG_LOCK_RECALL);
+    }
+    return rc;
+}
+
+int handle_lock_request(const message_t *msg) {
+    /* Track received bytes */
+    track_bytes_received(MSG_LOCK_REQUEST);
+
+    lock_id_t lock_id = msg->payload.lock_request.lock_id;
     node_id_t requester = msg->payload.lock_request.requester;
+    lock_mode_t mode = msg->payload.lock_request.mode == LOCK_MODE_SHARED ?
+                       LOCK_MODE_SHARED : LOCK_MODE_EXCLUSIVE;
 
-    LOG_DEBUG("Handling LOCK_REQUEST for lock %lu from node %u", lock_id, requester);
+    LOG_DEBUG("Handling LOCK_REQUEST for lock %lu from node %u (mode=%d)", lock_id, requester, mode);
 
     /* Forward to lock manager (implemented in sync/lock.c) */
-    extern int lock_manager_grant(lock_id_t lock_id, node_id_t requester);
-    return lock_manager_grant(lock_id, requester);
+    extern int lock_manager_grant(lock_id_t lock_id, node_id_t requester, lock_mode_t mode);
+    return lock_manager_grant(lock_id, requester, mode);
 }
 
 int handle_lock_grant(const message_t *msg) {
@@ -832,12 +1970,16 @@ int handle_lock_grant(const message_t *msg) {
 
     lock_id_t lock_id = msg->payload.lock_grant.lock_id;
     node_id_t grantee = msg->payload.lock_grant.grantee;
+    bool recall = msg->payload.lock_grant.recall != 0;
+    lock_mode_t mode = msg->payload.lock_grant.mode == LOCK_MODE_SHARED ?
+                       LOCK_MODE_SHARED : LOCK_MODE_EXCLUSIVE;
 
-    LOG_DEBUG("Received LOCK_GRANT for lock %lu (grantee=%u)", lock_id, grantee);
+    LOG_DEBUG("Received LOCK_GRANT for lock %lu (grantee=%u, mode=%d, recall=%d)",
+              lock_id, grantee, mode, recall);
 
     /* Forward to lock handler (implemented in sync/lock.c) */
-    extern int lock_handle_grant(lock_id_t lock_id, node_id_t grantee);
-    return lock_handle_grant(lock_id, grantee);
+    extern int lock_handle_grant(lock_id_t lock_id, node_id_t grantee, lock_mode_t mode, bool recall);
+    return lock_handle_grant(lock_id, grantee, mode, recall);
 }
 
 int handle_lock_release(const message_t *msg) {
@@ -854,8 +1996,22 @@ int handle_lock_release(const message_t *msg) {
     return lock_manager_release(lock_id, releaser);
 }
 
+int handle_lock_recall(const message_t *msg) {
+    /* Track received bytes */
+    track_bytes_received(MSG_LOCK_RECALL);
+
+    lock_id_t lock_id = msg->payload.lock_recall.lock_id;
+
+    LOG_DEBUG("Received LOCK_RECALL for lock %lu", lock_id);
+
+    /* Forward to lock handler (implemented in sync/lock.c) */
+    extern int lock_handle_recall(lock_id_t lock_id);
+    return lock_handle_recall(lock_id);
+}
+
 /* BARRIER */
-int send_barrier_arrive(node_id_t manager, barrier_id_t barrier_id, int num_participants) {
+int send_barrier_arrive(node_id_t manager, barrier_id_t barrier_id, int num_participants,
+                        const rc_notices_t *notices, const barrier_collective_t *collective) {
     dsm_context_t *ctx = dsm_get_context();
     message_t msg;
     memset(&msg, 0, sizeof(msg));
@@ -867,16 +2023,37 @@ int send_barrier_arrive(node_id_t manager, barrier_id_t barrier_id, int num_part
     msg.payload.barrier_arrive.barrier_id = barrier_id;
     msg.payload.barrier_arrive.arriver = ctx->node_id;
     msg.payload.barrier_arrive.num_participants = num_participants;
+    if (collective) {
+        msg.payload.barrier_arrive.collective = (uint8_t)collective->kind;
+        msg.payload.barrier_arrive.reduce_type = (uint8_t)collective->type;
+        msg.payload.barrier_arrive.reduce_op = (uint8_t)collective->op;
+        msg.payload.barrier_arrive.root = collective->root;
+        msg.payload.barrier_arrive.collective_len = (uint32_t)collective->len;
+    }
+    if (notices) {
+        msg.payload.barrier_arrive.notices_overflow = notices->overflow ? 1 : 0;
+        msg.payload.barrier_arrive.num_notices = (uint16_t)notices->count;
+        for (int i = 0; i < notices->count; i++) {
+            msg.payload.barrier_arrive.notices[i] = notices->pages[i];
+        }
+    }
 
     LOG_DEBUG("Sending BARRIER_ARRIVE for barrier %lu", barrier_id);
-    int rc = network_send(manager, &msg);
+    int rc;
+    if (collective && collective->data) {
+        struct iovec iov = { .iov_base = (void *)collective->data, .iov_len = collective->len };
+        rc = network_send_bulk(manager, &msg, &iov, 1);
+    } else {
+        rc = network_send(manager, &msg);
+    }
     if (rc == DSM_SUCCESS) {
         track_bytes_sent(MSG_BARRIER_ARRIVE);
     }
     return rc;
 }
 
-int send_barrier_release(node_id_t node, barrier_id_t barrier_id) {
+int send_barrier_release(node_id_t node, barrier_id_t barrier_id, const rc_notices_t *notices,
+                         const void *result, size_t result_len, bool collective_failed) {
     dsm_context_t *ctx = dsm_get_context();
     message_t msg;
     memset(&msg, 0, sizeof(msg));
@@ -887,9 +2064,24 @@ int send_barrier_release(node_id_t node, barrier_id_t barrier_id) {
 
     msg.payload.barrier_release.barrier_id = barrier_id;
     msg.payload.barrier_release.num_arrived = 0;
+    msg.payload.barrier_release.collective_failed = collective_failed ? 1 : 0;
+    if (notices) {
+        msg.payload.barrier_release.notices_overflow = notices->overflow ? 1 : 0;
+        msg.payload.barrier_release.num_notices = (uint16_t)notices->count;
+        for (int i = 0; i < notices->count; i++) {
+            msg.payload.barrier_release.notices[i] = notices->pages[i];
+        }
+    }
 
-    LOG_INFO("Sending BARRIER_RELEASE for barrier %lu to node %u", barrier_id, node);
-    int rc = network_send(node, &msg);
+    LOG_DEBUG("Sending BARRIER_RELEASE for barrier %lu to node %u", barrier_id, node);
+    /* A result goes out directly; the send queues only take small messages */
+    int rc;
+    if (result && result_len > 0) {
+        struct iovec iov = { .iov_base = (void *)result, .iov_len = result_len };
+        rc = network_send_bulk(node, &msg, &iov, 1);
+    } else {
+        rc = network_send_async(node, &msg);
+    }
     if (rc != DSM_SUCCESS) {
         LOG_ERROR("Failed to send BARRIER_RELEASE to node %u (rc=%d)", node, rc);
     } else {
@@ -898,7 +2090,7 @@ int send_barrier_release(node_id_t node, barrier_id_t barrier_id) {
     return rc;
 }
 
-int handle_barrier_arrive(const message_t *msg) {
+int handle_barrier_arrive(const message_t *msg, const uint8_t *data, size_t data_len) {
     /* Track received bytes */
     track_bytes_received(MSG_BARRIER_ARRIVE);
 
@@ -906,33 +2098,151 @@ int handle_barrier_arrive(const message_t *msg) {
     node_id_t arriver = msg->payload.barrier_arrive.arriver;
     int num_participants = msg->payload.barrier_arrive.num_participants;
 
-    LOG_DEBUG("Handling BARRIER_ARRIVE for barrier %lu from node %u (%d participants)",
-              barrier_id, arriver, num_participants);
+    int num_notices = msg->payload.barrier_arrive.num_notices;
+    if (num_notices > BARRIER_NOTICE_MAX) {
+        LOG_ERROR("BARRIER_ARRIVE from node %u carries %d write notices (max %d)",
+                  arriver, num_notices, BARRIER_NOTICE_MAX);
+        return DSM_ERROR_INVALID;
+    }
+
+    rc_notices_t notices;
+    notices.overflow = msg->payload.barrier_arrive.notices_overflow != 0;
+    notices.count = num_notices;
+    for (int i = 0; i < num_notices; i++) {
+        notices.pages[i] = msg->payload.barrier_arrive.notices[i];
+    }
+
+    /* A contribution's length is checked against the episode by the manager */
+    barrier_collective_t collective = {
+        .kind = (collective_kind_t)msg->payload.barrier_arrive.collective,
+        .type = (dsm_datatype_t)msg->payload.barrier_arrive.reduce_type,
+        .op = (dsm_reduce_op_t)msg->payload.barrier_arrive.reduce_op,
+        .root = msg->payload.barrier_arrive.root,
+        .len = msg->payload.barrier_arrive.collective_len,
+        .data = data_len == msg->payload.barrier_arrive.collective_len ? data : NULL
+    };
+
+    LOG_DEBUG("Handling BARRIER_ARRIVE for barrier %lu from node %u (%d participants, %d notices, %zu data bytes)",
+              barrier_id, arriver, num_participants, num_notices, data_len);
 
     /* Forward to barrier manager (implemented in sync/barrier.c) */
-    extern int barrier_manager_arrive(barrier_id_t barrier_id, node_id_t arriver, int num_participants);
-    return barrier_manager_arrive(barrier_id, arriver, num_participants);
+    extern int barrier_manager_arrive(barrier_id_t barrier_id, node_id_t arriver, int num_participants,
+                                      const rc_notices_t *notices, const barrier_collective_t *collective);
+    return barrier_manager_arrive(barrier_id, arriver, num_participants, &notices,
+                                  collective.kind != COLLECTIVE_NONE ? &collective : NULL);
 }
 
-int handle_barrier_release(const message_t *msg) {
+int handle_barrier_release(const message_t *msg, const uint8_t *data, size_t data_len) {
     /* Track received bytes */
     track_bytes_received(MSG_BARRIER_RELEASE);
 
     barrier_id_t barrier_id = msg->payload.barrier_release.barrier_id;
-    LOG_INFO("Received BARRIER_RELEASE for barrier %lu from node %u",
+    LOG_DEBUG("Received BARRIER_RELEASE for barrier %lu from node %u",
              barrier_id, msg->header.sender);
 
+    int num_notices = msg->payload.barrier_release.num_notices;
+    if (num_notices > BARRIER_NOTICE_MAX) {
+        LOG_ERROR("BARRIER_RELEASE for barrier %lu carries %d write notices (max %d)",
+                  barrier_id, num_notices, BARRIER_NOTICE_MAX);
+        return DSM_ERROR_INVALID;
+    }
+
+    rc_notices_t notices;
+    notices.overflow = msg->payload.barrier_release.notices_overflow != 0;
+    notices.count = num_notices;
+    for (int i = 0; i < num_notices; i++) {
+        notices.pages[i] = msg->payload.barrier_release.notices[i];
+    }
+
     /* Forward to barrier handler (implemented in sync/barrier.c) */
-    extern int barrier_handle_release(barrier_id_t barrier_id);
-    return barrier_handle_release(barrier_id);
+    extern int barrier_handle_release(barrier_id_t barrier_id, const rc_notices_t *notices,
+                                      const uint8_t *result, size_t result_len, bool collective_failed);
+    return barrier_handle_release(barrier_id, &notices, data, data_len,
+                                  msg->payload.barrier_release.collective_failed != 0);
+}
+
+/* BARRIER_SIGNAL */
+int send_barrier_signal(node_id_t to, barrier_id_t barrier_id, int round, int parity,
+                        const rc_notices_t *notices) {
+    dsm_context_t *ctx = dsm_get_context();
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+
+    msg.header.magic = MSG_MAGIC;
+    msg.header.type = MSG_BARRIER_SIGNAL;
+    msg.header.sender = ctx->node_id;
+
+    msg.payload.barrier_signal.barrier_id = barrier_id;
+    msg.payload.barrier_signal.from = ctx->node_id;
+    msg.payload.barrier_signal.to = to;
+    msg.payload.barrier_signal.round = (uint8_t)round;
+    msg.payload.barrier_signal.parity = (uint8_t)parity;
+    if (notices) {
+        msg.payload.barrier_signal.notices_overflow = notices->overflow ? 1 : 0;
+        msg.payload.barrier_signal.num_notices = (uint16_t)notices->count;
+        for (int i = 0; i < notices->count; i++) {
+            msg.payload.barrier_signal.notices[i] = notices->pages[i];
+        }
+    }
+
+    LOG_DEBUG("Sending BARRIER_SIGNAL for barrier %lu to node %u (round %d)", barrier_id, to, round);
+    int rc = network_send(route_direct(to), &msg);
+    if (rc != DSM_SUCCESS) {
+        LOG_ERROR("Failed to send BARRIER_SIGNAL to node %u (rc=%d)", to, rc);
+    } else {
+        track_bytes_sent(MSG_BARRIER_SIGNAL);
+    }
+    return rc;
+}
+
+int handle_barrier_signal(const message_t *msg) {
+    const barrier_signal_payload_t *signal = &msg->payload.barrier_signal;
+    dsm_context_t *ctx = dsm_get_context();
+    track_bytes_received(MSG_BARRIER_SIGNAL);
+
+    if (signal->num_notices > BARRIER_NOTICE_MAX || signal->parity > 1 ||
+        signal->round >= BARRIER_MAX_ROUNDS) {
+        LOG_ERROR("BARRIER_SIGNAL for barrier %lu from node %u: round %u, parity %u, %u notices",
+                  signal->barrier_id, signal->from, signal->round, signal->parity, signal->num_notices);
+        return DSM_ERROR_INVALID;
+    }
+
+    /* Manager relays signals between workers that have no link */
+    if (signal->to != ctx->node_id) {
+        if (!ctx->config.is_manager || signal->to >= (node_id_t)ctx->network.max_nodes) {
+            LOG_ERROR("BARRIER_SIGNAL for barrier %lu addressed to node %u", signal->barrier_id, signal->to);
+            return DSM_ERROR_INVALID;
+        }
+        message_t forward_msg;
+        memcpy(&forward_msg.header, &msg->header, sizeof(msg_header_t));
+        memcpy(&forward_msg.payload, &msg->payload, message_wire_payload_size(msg));
+        forward_msg.header.sender = ctx->node_id;
+        return network_send(signal->to, &forward_msg);
+    }
+
+    rc_notices_t notices;
+    notices.overflow = signal->notices_overflow != 0;
+    notices.count = signal->num_notices;
+    for (int i = 0; i < notices.count; i++) {
+        notices.pages[i] = signal->notices[i];
+    }
+
+    LOG_DEBUG("Received BARRIER_SIGNAL for barrier %lu from node %u (round %u)",
+              signal->barrier_id, signal->from, signal->round);
+
+    /* Forward to barrier handler (implemented in sync/barrier.c) */
+    extern int barrier_handle_signal(barrier_id_t barrier_id, int round, int parity,
+                                     const rc_notices_t *notices);
+    return barrier_handle_signal(signal->barrier_id, signal->round, signal->parity, &notices);
 }
 
 /* ALLOC_NOTIFY */
-int send_alloc_notify(page_id_t start_page_id, page_id_t end_page_id, node_id_t owner, size_t num_pages, void *base_addr, size_t total_size) {
+int send_alloc_notify(page_id_t start_page_id, page_id_t end_page_id, node_id_t owner, size_t num_pages, void *base_addr, size_t total_size,
+                      const dsm_alloc_attr_t *attr) {
     dsm_context_t *ctx = dsm_get_context();
 
     /* Broadcast to all connected nodes */
-    for (int i = 0; i < MAX_NODES; i++) {
+    for (int i = 0; i < ctx->network.max_nodes; i++) {
         pthread_mutex_lock(&ctx->lock);
         bool connected = ctx->network.nodes[i].connected;
         node_id_t node_id = ctx->network.nodes[i].id;
@@ -952,6 +2262,11 @@ int send_alloc_notify(page_id_t start_page_id, page_id_t end_page_id, node_id_t
             msg.payload.alloc_notify.num_pages = num_pages;
             msg.payload.alloc_notify.base_addr = (uint64_t)base_addr;
             msg.payload.alloc_notify.total_size = total_size;
+            msg.payload.alloc_notify.compression = (uint8_t)attr->compression;
+            msg.payload.alloc_notify.block_size = (uint32_t)attr->block_size;
+            msg.payload.alloc_notify.placement = (uint8_t)attr->placement;
+            msg.payload.alloc_notify.home_node = attr->home_node;
+            msg.payload.alloc_notify.placement_nodes = (uint32_t)ctx->config.num_nodes;
 
             LOG_INFO("Sending ALLOC_NOTIFY to node %u (pages %lu-%lu, addr=%p, size=%zu, owner=%u)",
                      node_id, start_page_id, end_page_id, base_addr, total_size, owner);
@@ -976,22 +2291,51 @@ int handle_alloc_notify(const message_t *msg) {
     size_t num_pages = msg->payload.alloc_notify.num_pages;
     void *base_addr = (void*)msg->payload.alloc_notify.base_addr;
     size_t total_size = msg->payload.alloc_notify.total_size;
+    size_t block_size = msg->payload.alloc_notify.block_size ? msg->payload.alloc_notify.block_size : PAGE_SIZE;
+    dsm_placement_t placement = (dsm_placement_t)msg->payload.alloc_notify.placement;
+    node_id_t home = placement == DSM_PLACEMENT_HOME ? msg->payload.alloc_notify.home_node : owner;
+    int placement_nodes = (int)msg->payload.alloc_notify.placement_nodes;
 
     LOG_INFO("Received ALLOC_NOTIFY: pages %lu-%lu at addr=%p, size=%zu, owned by node %u",
              start_page_id, end_page_id, base_addr, total_size, owner);
 
     dsm_context_t *ctx = dsm_get_context();
 
+    if (!page_block_size_valid(block_size) || total_size % block_size != 0) {
+        LOG_ERROR("ALLOC_NOTIFY with invalid block size %zu for %zu bytes", block_size, total_size);
+        return DSM_ERROR_INVALID;
+    }
+    if (placement > DSM_PLACEMENT_HOME ||
+        (placement == DSM_PLACEMENT_HOME && home >= (node_id_t)placement_nodes)) {
+        LOG_ERROR("ALLOC_NOTIFY with invalid placement %d (home node %u of %d)",
+                  placement, home, placement_nodes);
+        return DSM_ERROR_INVALID;
+    }
+
     /* CRITICAL: Create mmap at the SAME virtual address for SVAS
-     * This ensures all nodes share the same virtual address space */
-    void *addr = mmap(base_addr, total_size, PROT_NONE,
-                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+     * This ensures all nodes share the same virtual address space.
+     * Huge-page blocks use huge pages here too when the system has them. */
+    void *addr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (block_size == DSM_MAX_BLOCK_SIZE) {
+        addr = mmap(base_addr, total_size, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (addr == MAP_FAILED) {
+        addr = mmap(base_addr, total_size, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    }
 
     if (addr == MAP_FAILED || addr != base_addr) {
         LOG_ERROR("Failed to create SVAS mapping at %p (got %p): %s",
                   base_addr, addr, strerror(errno));
         return DSM_ERROR_MEMORY;
     }
+    if (userfault_register(addr, total_size) != DSM_SUCCESS) {
+        munmap(addr, total_size);
+        return DSM_ERROR_MEMORY;
+    }
 
     LOG_INFO("Created SVAS mapping at %p (size=%zu) for remote allocation",
              addr, total_size);
@@ -999,21 +2343,23 @@ int handle_alloc_notify(const message_t *msg) {
     /* Create page table for this remote allocation */
     pthread_mutex_lock(&ctx->lock);
 
-    if (ctx->num_allocations >= 32) {
+    if (dsm_reserve_page_table_slot() != DSM_SUCCESS) {
         pthread_mutex_unlock(&ctx->lock);
         munmap(addr, total_size);
-        LOG_ERROR("Maximum number of allocations (32) exceeded");
+        LOG_ERROR("Failed to grow page table list (%d allocations)", ctx->num_allocations);
         return DSM_ERROR_MEMORY;
     }
 
     /* Create page table with the SAME page IDs as owner */
-    page_table_t *new_table = page_table_create_remote(addr, total_size, owner, start_page_id);
+    page_table_t *new_table = page_table_create_remote(addr, total_size, owner, start_page_id, block_size);
     if (!new_table) {
         pthread_mutex_unlock(&ctx->lock);
         munmap(addr, total_size);
         LOG_ERROR("Failed to create remote page table");
         return DSM_ERROR_MEMORY;
     }
+    new_table->compression = (dsm_compression_t)msg->payload.alloc_notify.compression;
+    page_table_place(new_table, placement, home, placement_nodes);
 
     /* Add to list of page tables */
     ctx->page_tables[ctx->num_allocations] = new_table;
@@ -1036,17 +2382,32 @@ int handle_alloc_notify(const message_t *msg) {
         dir = get_page_directory();
     }
 
-    /* Register pages in directory with remote owner
+    /* Publish to the lock-free index used by the fault handler */
+    if (page_index_insert(new_table) != DSM_SUCCESS) {
+        ctx->page_tables[ctx->num_allocations - 1] = NULL;
+        ctx->num_allocations--;
+        page_table_destroy(new_table);
+        pthread_mutex_unlock(&ctx->lock);
+        munmap(addr, total_size);
+        return DSM_ERROR_MEMORY;
+    }
+
+    /* Register pages in directory with their placed owners
      * NOTE: Release ctx->lock before calling directory_set_owner to avoid
      * deadlock - directory_set_owner may call network_send which also needs ctx->lock */
     pthread_mutex_unlock(&ctx->lock);
     
     if (dir) {
-        for (page_id_t page_id = start_page_id; page_id <= end_page_id; page_id++) {
-            directory_set_owner(dir, page_id, owner);
+        for (size_t i = 0; i < new_table->num_pages; i++) {
+            const page_entry_t *entry = &new_table->entries[i];
+            if (entry->owner == DSM_NODE_NONE) {
+                directory_set_first_touch(dir, entry->id);
+            } else {
+                directory_set_owner(dir, entry->id, entry->owner);
+            }
         }
-        LOG_DEBUG("Registered %zu remote pages (owner=node %u) in directory",
-                  num_pages, owner);
+        LOG_DEBUG("Registered %zu remote pages (allocated by node %u, placement %d) in directory",
+                  num_pages, owner, placement);
     }
 
     LOG_INFO("SVAS setup complete: local addr=%p maps to remote pages %lu-%lu (owner=node %u)",
@@ -1067,7 +2428,7 @@ int handle_alloc_notify(const message_t *msg) {
 
         /* Forward to all connected workers except sender and self */
         int forwarded = 0;
-        for (int i = 0; i < MAX_NODES; i++) {
+        for (int i = 0; i < ctx->network.max_nodes; i++) {
             pthread_mutex_lock(&ctx->lock);
             bool connected = ctx->network.nodes[i].connected;
             node_id_t target_id = ctx->network.nodes[i].id;
@@ -1079,7 +2440,8 @@ int handle_alloc_notify(const message_t *msg) {
 
                 /* Create a copy of the message to forward (preserve original sender) */
                 message_t forward_msg;
-                memcpy(&forward_msg, msg, sizeof(message_t));
+                memcpy(&forward_msg.header, &msg->header, sizeof(msg_header_t));
+                memcpy(&forward_msg.payload, &msg->payload, message_wire_payload_size(msg));
 
                 int rc = network_send(target_id, &forward_msg);
                 if (rc != DSM_SUCCESS) {
@@ -1158,29 +2520,26 @@ int handle_alloc_ack(const message_t *msg) {
          * Forward the ACK to the page owner (the allocator).
          */
         if (ctx->config.is_manager) {
-            /* Look up who owns these pages */
-            page_directory_t *dir = get_page_directory();
-            if (dir) {
-                node_id_t page_owner = 0;
-                int lookup_rc = directory_lookup(dir, start_page_id, &page_owner);
+            /* The allocator is encoded in the page IDs; the directory owner
+             * of the first page may be another node under placement */
+            node_id_t page_owner = PAGE_ID_NODE(start_page_id);
 
-                if (lookup_rc == DSM_SUCCESS &&
-                    page_owner != ctx->node_id &&
-                    page_owner < MAX_NODES) {
+            if (page_owner != ctx->node_id &&
+                page_owner < (node_id_t)ctx->network.max_nodes) {
 
-                    LOG_INFO("Manager proxying ALLOC_ACK from node %u to allocator node %u (pages %lu-%lu)",
-                             acker, page_owner, start_page_id, end_page_id);
+                LOG_INFO("Manager proxying ALLOC_ACK from node %u to allocator node %u (pages %lu-%lu)",
+                         acker, page_owner, start_page_id, end_page_id);
 
-                    /* Forward the ACK to the allocator */
-                    message_t forward_msg;
-                    memcpy(&forward_msg, msg, sizeof(message_t));
+                /* Forward the ACK to the allocator */
+                message_t forward_msg;
+                memcpy(&forward_msg.header, &msg->header, sizeof(msg_header_t));
+                memcpy(&forward_msg.payload, &msg->payload, message_wire_payload_size(msg));
 
-                    int rc = network_send(page_owner, &forward_msg);
-                    if (rc != DSM_SUCCESS) {
-                        LOG_ERROR("Failed to forward ALLOC_ACK to node %u", page_owner);
-                    }
-                    return DSM_SUCCESS;
+                int rc = network_send(page_owner, &forward_msg);
+                if (rc != DSM_SUCCESS) {
+                    LOG_ERROR("Failed to forward ALLOC_ACK to node %u", page_owner);
                 }
+                return DSM_SUCCESS;
             }
         }
 
@@ -1199,7 +2558,7 @@ int handle_alloc_ack(const message_t *msg) {
     }
 
     /* Mark this node as having ACK'd */
-    if (acker < MAX_NODES && !tracker->acks_received[acker]) {
+    if (acker < (node_id_t)ctx->network.max_nodes && !tracker->acks_received[acker]) {
         tracker->acks_received[acker] = true;
         tracker->received_acks++;
         LOG_DEBUG("ALLOC_ACK received from node %u (%d/%d)",
@@ -1217,26 +2576,56 @@ int handle_alloc_ack(const message_t *msg) {
     return DSM_SUCCESS;
 }
 
-int wait_for_alloc_acks(page_id_t start_page_id, page_id_t end_page_id,
-                        int expected_acks, int timeout_sec) {
-    if (expected_acks == 0) {
-        return DSM_SUCCESS;  /* No ACKs to wait for */
-    }
-
+/* CRITICAL FIX: The tracker is armed before ALLOC_NOTIFY is sent. A peer
+ * can map the region and ACK before the allocator reaches
+ * wait_for_alloc_acks(); arming there dropped such ACKs as untracked. */
+void expect_alloc_acks(page_id_t start_page_id, page_id_t end_page_id, int expected_acks) {
     dsm_context_t *ctx = dsm_get_context();
     alloc_ack_tracker_t *tracker = &ctx->network.alloc_tracker;
 
     pthread_mutex_lock(&tracker->lock);
-
-    /* Initialize tracker */
     tracker->start_page_id = start_page_id;
     tracker->end_page_id = end_page_id;
     tracker->expected_acks = expected_acks;
     tracker->received_acks = 0;
-    tracker->active = true;
-    for (int i = 0; i < MAX_NODES; i++) {
+    tracker->active = expected_acks > 0;
+    for (int i = 0; i < ctx->network.max_nodes; i++) {
         tracker->acks_received[i] = false;
     }
+    pthread_mutex_unlock(&tracker->lock);
+}
+
+void cancel_alloc_acks(void) {
+    alloc_ack_tracker_t *tracker = &dsm_get_context()->network.alloc_tracker;
+
+    pthread_mutex_lock(&tracker->lock);
+    tracker->active = false;
+    pthread_mutex_unlock(&tracker->lock);
+}
+
+int wait_for_alloc_acks(page_id_t start_page_id, page_id_t end_page_id,
+                        int expected_acks, int timeout_sec) {
+    if (expected_acks == 0) {
+        return DSM_SUCCESS;  /* No ACKs to wait for */
+    }
+
+    dsm_context_t *ctx = dsm_get_context();
+    alloc_ack_tracker_t *tracker = &ctx->network.alloc_tracker;
+
+    pthread_mutex_lock(&tracker->lock);
+
+    /* Callers that did not arm the tracker start counting now */
+    if (!tracker->active || tracker->start_page_id != start_page_id ||
+        tracker->end_page_id != end_page_id) {
+        tracker->start_page_id = start_page_id;
+        tracker->end_page_id = end_page_id;
+        tracker->expected_acks = expected_acks;
+        tracker->received_acks = 0;
+        tracker->active = true;
+        for (int i = 0; i < ctx->network.max_nodes; i++) {
+            tracker->acks_received[i] = false;
+        }
+    }
 
     LOG_INFO("Waiting for %d ALLOC_ACKs for pages %lu-%lu (timeout=%ds)",
              expected_acks, start_page_id, end_page_id, timeout_sec);
@@ -1308,8 +2697,8 @@ int handle_node_join(const message_t *msg, int sockfd) {
     dsm_context_t *ctx = dsm_get_context();
 
     /* Validate node_id */
-    if (joining_node_id >= MAX_NODES) {
-        LOG_ERROR("Invalid node_id %u (max=%d)", joining_node_id, MAX_NODES);
+    if (joining_node_id >= (node_id_t)ctx->network.max_nodes) {
+        LOG_ERROR("Invalid node_id %u (max=%d)", joining_node_id, ctx->network.max_nodes);
         return DSM_ERROR_INVALID;
     }
 
@@ -1352,6 +2741,16 @@ int handle_node_join(const message_t *msg, int sockfd) {
         strncpy(ctx->network.nodes[joining_node_id].hostname, hostname, MAX_HOSTNAME_LEN - 1);
     }
 
+    /* Other workers reach it at the address it joined from (the roster) */
+    struct sockaddr_in peer_addr;
+    socklen_t addr_len = sizeof(peer_addr);
+    if (getpeername(sockfd, (struct sockaddr*)&peer_addr, &addr_len) == 0 && peer_addr.sin_family == AF_INET) {
+        ctx->network.nodes[joining_node_id].peer_addr = peer_addr.sin_addr.s_addr;
+        ctx->network.nodes[joining_node_id].peer_port = port;
+    } else {
+        ctx->network.nodes[joining_node_id].peer_port = 0;
+    }
+
     /* CRITICAL FIX: Initialize heartbeat timestamp to prevent immediate failure detection */
     struct timespec now;
     clock_gettime(CLOCK_MONOTONIC, &now);
@@ -1359,6 +2758,8 @@ int handle_node_join(const message_t *msg, int sockfd) {
     ctx->network.nodes[joining_node_id].missed_heartbeats = 0;
     ctx->network.nodes[joining_node_id].is_failed = false;
 
+    /* Bootstrap in dsm_init() waits for the last join */
+    pthread_cond_broadcast(&ctx->network.membership_cv);
     pthread_mutex_unlock(&ctx->lock);
 
     LOG_INFO("Node %u successfully joined (sockfd=%d, total_nodes=%d)",
@@ -1367,6 +2768,191 @@ int handle_node_join(const message_t *msg, int sockfd) {
     return DSM_SUCCESS;
 }
 
+/* NODE_ROSTER */
+int send_node_roster(void) {
+    dsm_context_t *ctx = dsm_get_context();
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+
+    msg.header.magic = MSG_MAGIC;
+    msg.header.type = MSG_NODE_ROSTER;
+    msg.header.sender = ctx->node_id;
+
+    /* Workers are connected to us already: the manager has no address */
+    roster_address_t *addrs = calloc(ctx->network.max_nodes, sizeof(*addrs));
+    if (!addrs) {
+        return DSM_ERROR_MEMORY;
+    }
+
+    int n = 0;
+    msg.payload.node_roster.members[n++] = ctx->node_id;
+    pthread_mutex_lock(&ctx->lock);
+    for (int i = 0; i < ctx->network.max_nodes && n < MAX_SHARERS; i++) {
+        if (ctx->network.nodes[i].connected && (node_id_t)i != ctx->node_id) {
+            addrs[n].addr = ctx->network.nodes[i].peer_addr;
+            addrs[n].port = ctx->network.nodes[i].peer_port;
+            msg.payload.node_roster.members[n++] = (node_id_t)i;
+        }
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    msg.payload.node_roster.num_members = n;
+
+    /* One message per worker, all sent before any reply is awaited */
+    struct iovec iov = { .iov_base = addrs, .iov_len = (size_t)n * sizeof(*addrs) };
+    size_t wire = 4 + sizeof(msg_header_t) + message_wire_payload_size(&msg) + iov.iov_len;
+    int rc = DSM_SUCCESS;
+    for (int i = 1; i < n; i++) {
+        int send_rc = network_send_bulk(msg.payload.node_roster.members[i], &msg, &iov, 1);
+        if (send_rc == DSM_SUCCESS) {
+            STATS_ADD(network_bytes_sent, wire);
+        } else {
+            rc = send_rc;
+        }
+    }
+    free(addrs);
+
+    LOG_INFO("Sent roster of %d nodes", n);
+    return rc;
+}
+
+int handle_node_roster(const message_t *msg, const uint8_t *data, size_t data_len) {
+    dsm_context_t *ctx = dsm_get_context();
+    int n = msg->payload.node_roster.num_members;
+    if (n <= 0 || n > MAX_SHARERS) {
+        LOG_ERROR("NODE_ROSTER with %d members", n);
+        return DSM_ERROR_INVALID;
+    }
+    STATS_ADD(network_bytes_received, 4 + sizeof(msg_header_t) + message_wire_payload_size(msg) + data_len);
+
+    /* Without addresses (an older manager) workers stay on the star */
+    const roster_address_t *addrs = NULL;
+    if (data && data_len == (size_t)n * sizeof(roster_address_t)) {
+        addrs = (const roster_address_t *)data;
+    } else if (data_len > 0) {
+        LOG_WARN("NODE_ROSTER of %d members with %zu address bytes, ignoring them", n, data_len);
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    for (int i = 0; i < n; i++) {
+        node_id_t member = msg->payload.node_roster.members[i];
+        if (member < (node_id_t)ctx->network.max_nodes) {
+            ctx->network.nodes[member].id = member;
+            if (addrs && member != ctx->node_id && !ctx->network.nodes[member].connected) {
+                ctx->network.nodes[member].peer_addr = addrs[i].addr;
+                ctx->network.nodes[member].peer_port = addrs[i].port;
+            }
+        }
+    }
+    ctx->network.roster_size = n;
+    pthread_cond_broadcast(&ctx->network.membership_cv);
+    pthread_mutex_unlock(&ctx->lock);
+
+    LOG_INFO("Received roster of %d nodes from node %u", n, msg->header.sender);
+    return DSM_SUCCESS;
+}
+
+/* PEER_HELLO */
+int handle_peer_hello(const message_t *msg, int sockfd) {
+    track_bytes_received(MSG_PEER_HELLO);
+
+    node_id_t peer = msg->payload.peer_hello.node_id;
+    LOG_DEBUG("Handling PEER_HELLO from node %u (sockfd=%d)", peer, sockfd);
+    return network_adopt_peer_link(peer, sockfd);
+}
+
+/* TRANSPORT_CONNECT */
+int send_transport_connect(node_id_t dest, uint8_t kind, uint8_t phase, transport_conn_t *conn) {
+    dsm_context_t *ctx = dsm_get_context();
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+
+    msg.header.magic = MSG_MAGIC;
+    msg.header.type = MSG_TRANSPORT_CONNECT;
+    msg.header.sender = ctx->node_id;
+
+    msg.payload.transport_connect.transport = kind;
+    msg.payload.transport_connect.phase = phase;
+    if (conn && (phase == TRANSPORT_OFFER || phase == TRANSPORT_ACCEPT)) {
+        msg.payload.transport_connect.info_len = (uint16_t)conn->ops->local_info(
+            conn, msg.payload.transport_connect.info, TRANSPORT_INFO_MAX);
+    }
+
+    /* SWITCHED is the last frame on the socket; later ones use conn */
+    int rc = phase == TRANSPORT_SWITCHED ? network_send_switch(dest, &msg, conn)
+                                         : network_send(dest, &msg);
+    if (rc == DSM_SUCCESS) {
+        track_bytes_sent(MSG_TRANSPORT_CONNECT);
+    }
+    return rc;
+}
+
+int handle_transport_connect(const message_t *msg) {
+    track_bytes_received(MSG_TRANSPORT_CONNECT);
+
+    const transport_connect_payload_t *p = &msg->payload.transport_connect;
+    size_t info_len = p->info_len < TRANSPORT_INFO_MAX ? p->info_len : TRANSPORT_INFO_MAX;
+
+    LOG_DEBUG("Handling TRANSPORT_CONNECT from node %u (transport=%u, phase=%u)",
+              msg->header.sender, p->transport, p->phase);
+    return transport_handle_connect(msg->header.sender, p->transport, p->phase, p->info, info_len);
+}
+
+/* TCP_LANE */
+int send_tcp_lane(node_id_t dest, uint8_t phase, uint8_t lane, uint8_t num_lanes) {
+    dsm_context_t *ctx = dsm_get_context();
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+
+    msg.header.magic = MSG_MAGIC;
+    msg.header.type = MSG_TCP_LANE;
+    msg.header.sender = ctx->node_id;
+
+    msg.payload.tcp_lane.node_id = ctx->node_id;
+    msg.payload.tcp_lane.phase = phase;
+    msg.payload.tcp_lane.lane = lane;
+    msg.payload.tcp_lane.num_lanes = num_lanes;
+
+    /* JOIN names the lane it travels on; SWITCHED is the last sharded
+     * frame on the main socket */
+    int rc = phase == LANE_JOIN ? network_send_lane(dest, lane, &msg)
+                                : network_switch_lanes(dest, &msg);
+    if (rc == DSM_SUCCESS) {
+        track_bytes_sent(MSG_TCP_LANE);
+    }
+    return rc;
+}
+
+int handle_tcp_lane(const message_t *msg, int sockfd) {
+    track_bytes_received(MSG_TCP_LANE);
+
+    const tcp_lane_payload_t *p = &msg->payload.tcp_lane;
+    LOG_DEBUG("Handling TCP_LANE from node %u (phase=%u, lane=%u of %u, sockfd=%d)",
+              p->node_id, p->phase, p->lane, p->num_lanes, sockfd);
+
+    int rc;
+    switch (p->phase) {
+        case LANE_JOIN:
+            rc = network_add_lane(p->node_id, p->lane, p->num_lanes, sockfd);
+            break;
+
+        case LANE_SWITCHED:
+            network_enable_lanes_rx(p->node_id, p->num_lanes);
+            LOG_INFO("Node %u now sends over %u extra connections", p->node_id, p->num_lanes);
+            rc = DSM_SUCCESS;
+            break;
+
+        default:
+            LOG_WARN("Unknown TCP_LANE phase %u from node %u", p->phase, p->node_id);
+            return DSM_ERROR_INVALID;
+    }
+
+    /* Answer once the peer has switched and every lane it announced is here */
+    if (rc == DSM_SUCCESS && network_lanes_ready(p->node_id)) {
+        rc = send_tcp_lane(p->node_id, LANE_SWITCHED, 0, p->num_lanes);
+    }
+    return rc;
+}
+
 /* HEARTBEAT */
 int send_heartbeat(node_id_t target) {
     dsm_context_t *ctx = dsm_get_context();
@@ -1377,7 +2963,7 @@ int send_heartbeat(node_id_t target) {
     msg.header.type = MSG_HEARTBEAT;
     msg.header.sender = ctx->node_id;
 
-    int rc = network_send(target, &msg);
+    int rc = network_send_async(target, &msg);
     if (rc == DSM_SUCCESS) {
         track_bytes_sent(MSG_HEARTBEAT);
     }
@@ -1391,7 +2977,7 @@ int handle_heartbeat(const message_t *msg) {
 
     LOG_DEBUG("Received HEARTBEAT from node %u", sender);
 
-    if (sender >= MAX_NODES) {
+    if (sender >= (node_id_t)ctx->network.max_nodes) {
         return DSM_ERROR_INVALID;
     }
 
@@ -1407,10 +2993,157 @@ int handle_heartbeat(const message_t *msg) {
         if (ctx->network.nodes[sender].is_failed) {
             LOG_INFO("Node %u has recovered (heartbeat received)", sender);
             ctx->network.nodes[sender].is_failed = false;
+            pthread_cond_broadcast(&ctx->network.backup_state.manager_cv);
+        }
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    return DSM_SUCCESS;
+}
+
+int send_idle_heartbeats(uint64_t now_ns, uint64_t interval_ns) {
+    dsm_context_t *ctx = dsm_get_context();
+    int sent = 0;
+
+    /* A peer we wrote to within half an interval has heard from us, so
+     * only idle links carry HEARTBEATs; the peer still hears from us at
+     * least every 1.5 intervals */
+    for (int i = 0; i < ctx->network.max_nodes; i++) {
+        pthread_mutex_lock(&ctx->lock);
+        bool live = ctx->network.nodes[i].connected &&
+                    ctx->network.nodes[i].id != ctx->node_id &&
+                    !ctx->network.nodes[i].is_failed;
+        node_id_t target = ctx->network.nodes[i].id;
+        pthread_mutex_unlock(&ctx->lock);
+
+        uint64_t last_send = __atomic_load_n(&ctx->network.nodes[i].last_send_time, __ATOMIC_RELAXED);
+        if (!live || now_ns - last_send < interval_ns / 2) {
+            continue;
+        }
+        if (send_heartbeat(target) == DSM_SUCCESS) {
+            STATS_INC(heartbeats_sent);
+            sent++;
+        }
+    }
+    return sent;
+}
+
+/* INDIRECT PROBING */
+
+/* Where send_probe_requests() looks for helpers next (heartbeat thread only) */
+static int probe_cursor = 0;
+
+static int send_probe_message(node_id_t dest, msg_type_t type, node_id_t origin, node_id_t target) {
+    dsm_context_t *ctx = dsm_get_context();
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+
+    msg.header.magic = MSG_MAGIC;
+    msg.header.type = type;
+    msg.header.sender = ctx->node_id;
+    msg.payload.probe.origin = origin;
+    msg.payload.probe.target = target;
+
+    int rc = network_send_async(dest, &msg);
+    if (rc == DSM_SUCCESS) {
+        track_bytes_sent(type);
+    }
+    return rc;
+}
+
+int send_probe_requests(node_id_t target) {
+    dsm_context_t *ctx = dsm_get_context();
+    int max_nodes = ctx->network.max_nodes;
+    int start = probe_cursor;
+    int asked = 0;
+
+    /* Helpers we still hear from and can reach ourselves: the manager
+     * reaches every worker, a worker the others over peer links */
+    for (int n = 0; n < max_nodes && asked < PROBE_HELPERS; n++) {
+        int i = (start + n) % max_nodes;
+        pthread_mutex_lock(&ctx->lock);
+        node_info_t *node = &ctx->network.nodes[i];
+        bool candidate = (node_id_t)i != ctx->node_id && (node_id_t)i != target &&
+                         !node->is_failed && node->missed_heartbeats == 0 &&
+                         (node->connected || node->peer_port != 0);
+        pthread_mutex_unlock(&ctx->lock);
+
+        if (!candidate || !network_peer_link((node_id_t)i)) {
+            continue;
+        }
+        if (send_probe_message((node_id_t)i, MSG_PROBE_REQUEST, ctx->node_id, target) == DSM_SUCCESS) {
+            STATS_INC(probe_requests_sent);
+            asked++;
+            probe_cursor = (i + 1) % max_nodes;
+        }
+    }
+
+    LOG_DEBUG("Asked %d nodes to probe silent node %u", asked, target);
+    return asked;
+}
+
+int handle_probe_request(const message_t *msg) {
+    track_bytes_received(MSG_PROBE_REQUEST);
+    dsm_context_t *ctx = dsm_get_context();
+    node_id_t origin = msg->payload.probe.origin;
+    node_id_t target = msg->payload.probe.target;
+
+    if (origin >= (node_id_t)ctx->network.max_nodes || target >= (node_id_t)ctx->network.max_nodes) {
+        return DSM_ERROR_INVALID;
+    }
+
+    /* Only over a link we already have: connecting to a dead node would
+     * stall the dispatcher, and a relay would not tell us anything */
+    if (target == ctx->node_id || !network_has_link(target)) {
+        LOG_DEBUG("Cannot probe node %u for node %u: no link", target, origin);
+        return DSM_SUCCESS;
+    }
+    return send_probe_message(target, MSG_PROBE, origin, target);
+}
+
+int handle_probe(const message_t *msg) {
+    track_bytes_received(MSG_PROBE);
+    dsm_context_t *ctx = dsm_get_context();
+
+    if (msg->payload.probe.target != ctx->node_id) {
+        return DSM_ERROR_INVALID;
+    }
+    return send_probe_message(msg->header.sender, MSG_PROBE_ACK,
+                              msg->payload.probe.origin, ctx->node_id);
+}
+
+int handle_probe_ack(const message_t *msg) {
+    track_bytes_received(MSG_PROBE_ACK);
+    dsm_context_t *ctx = dsm_get_context();
+    node_id_t origin = msg->payload.probe.origin;
+    node_id_t target = msg->payload.probe.target;
+
+    if (origin >= (node_id_t)ctx->network.max_nodes || target >= (node_id_t)ctx->network.max_nodes) {
+        return DSM_ERROR_INVALID;
+    }
+
+    if (origin != ctx->node_id) {
+        /* We probed for origin: pass the answer on */
+        if (!network_has_link(origin)) {
+            return DSM_SUCCESS;
         }
+        return send_probe_message(origin, MSG_PROBE_ACK, origin, target);
+    }
+
+    /* Alive, only not talking to us: it gets another round of misses */
+    pthread_mutex_lock(&ctx->lock);
+    node_info_t *node = &ctx->network.nodes[target];
+    bool suspected = !node->is_failed && node->missed_heartbeats > 0;
+    if (suspected) {
+        node->missed_heartbeats = 0;
     }
     pthread_mutex_unlock(&ctx->lock);
 
+    if (suspected) {
+        STATS_INC(probe_acks_received);
+        LOG_INFO("Node %u is silent to us but answered a probe from node %u",
+                 target, msg->header.sender);
+    }
     return DSM_SUCCESS;
 }
 
@@ -1419,57 +3152,73 @@ static void* heartbeat_thread_func(void *arg) {
     (void)arg;
     dsm_context_t *ctx = dsm_get_context();
 
-    const uint64_t HEARTBEAT_TIMEOUT_NS = 6000000000ULL;   /* 6 seconds (3 missed) */
+    int interval_ms = ctx->config.heartbeat_ms > 0 ? ctx->config.heartbeat_ms : HEARTBEAT_DEFAULT_MS;
+    const uint64_t interval_ns = (uint64_t)interval_ms * 1000000ULL;
+    const uint64_t HEARTBEAT_TIMEOUT_NS = HEARTBEAT_TIMEOUT_INTERVALS * interval_ns;
     const int MAX_MISSED_HEARTBEATS = 3;
 
-    LOG_INFO("Heartbeat thread started (interval=2s, timeout=6s)");
+    LOG_INFO("Heartbeat thread started (interval=%dms, timeout=%llums)",
+             interval_ms, (unsigned long long)(HEARTBEAT_TIMEOUT_NS / 1000000));
+
+    /* Peers that missed a heartbeat this round, probed once the lock is dropped */
+    node_id_t *suspects = calloc((size_t)ctx->network.max_nodes, sizeof(node_id_t));
+    if (!suspects) {
+        LOG_ERROR("Out of memory for heartbeat suspects");
+        return NULL;
+    }
 
     while (ctx->network.running) {
+        int num_suspects = 0;
         struct timespec now;
         clock_gettime(CLOCK_MONOTONIC, &now);
         uint64_t current_time = now.tv_sec * 1000000000ULL + now.tv_nsec;
 
-        pthread_mutex_lock(&ctx->lock);
-
-        /* Send heartbeats to all connected nodes */
-        for (int i = 0; i < MAX_NODES; i++) {
-            if (ctx->network.nodes[i].connected &&
-                ctx->network.nodes[i].id != ctx->node_id &&
-                !ctx->network.nodes[i].is_failed) {
+        send_idle_heartbeats(current_time, interval_ns);
 
-                /* Send heartbeat */
-                node_id_t target = ctx->network.nodes[i].id;
-                pthread_mutex_unlock(&ctx->lock);  /* Release lock during send */
-                send_heartbeat(target);
-                pthread_mutex_lock(&ctx->lock);  /* Reacquire lock */
-            }
-        }
+        pthread_mutex_lock(&ctx->lock);
 
-        /* Check for failed nodes (nodes that haven't sent heartbeats) */
-        for (int i = 0; i < MAX_NODES; i++) {
+        /* Check for failed nodes (nodes we have received nothing from) */
+        for (int i = 0; i < ctx->network.max_nodes; i++) {
             if (ctx->network.nodes[i].connected &&
                 ctx->network.nodes[i].id != ctx->node_id &&
                 !ctx->network.nodes[i].is_failed) {
 
-                uint64_t last_hb = ctx->network.nodes[i].last_heartbeat_time;
+                uint64_t last_hb = __atomic_load_n(&ctx->network.nodes[i].last_heartbeat_time, __ATOMIC_RELAXED);
 
                 /* If this is the first heartbeat, initialize timestamp */
                 if (last_hb == 0) {
-                    ctx->network.nodes[i].last_heartbeat_time = current_time;
+                    __atomic_store_n(&ctx->network.nodes[i].last_heartbeat_time, current_time, __ATOMIC_RELAXED);
                     continue;
                 }
 
-                uint64_t elapsed = current_time - last_hb;
-                if (elapsed > HEARTBEAT_TIMEOUT_NS) {
+                /* A frame may have arrived since current_time was read */
+                uint64_t elapsed = current_time > last_hb ? current_time - last_hb : 0;
+                if (elapsed <= HEARTBEAT_TIMEOUT_NS) {
+                    ctx->network.nodes[i].missed_heartbeats = 0;
+                } else {
                     ctx->network.nodes[i].missed_heartbeats++;
 
-                    if (ctx->network.nodes[i].missed_heartbeats >= MAX_MISSED_HEARTBEATS) {
+                    if (ctx->network.nodes[i].missed_heartbeats < MAX_MISSED_HEARTBEATS) {
+                        /* Before giving up on it, ask nodes that may still hear it */
+                        suspects[num_suspects++] = ctx->network.nodes[i].id;
+                    } else {
                         /* Mark node as failed */
                         ctx->network.nodes[i].is_failed = true;
                         node_id_t failed_node_id = ctx->network.nodes[i].id;
                         LOG_ERROR("Node %u marked as FAILED (no heartbeat for %llu ms)",
                                   failed_node_id, elapsed / 1000000);
 
+                        /* Every query goes through the manager: fail the
+                         * ones in flight so their threads wait for the
+                         * promotion instead of the query timeout */
+                        if (failed_node_id == ctx->network.backup_state.current_manager) {
+                            int aborted = pending_query_abort_all(&ctx->network.dir_queries) +
+                                          pending_query_abort_all(&ctx->network.sharer_queries);
+                            if (aborted > 0) {
+                                LOG_INFO("Aborted %d queries to failed manager", aborted);
+                            }
+                        }
+
                         /* CRITICAL FIX: Trigger recovery - clean up directory entries */
                         page_directory_t *dir = get_page_directory();
                         if (dir) {
@@ -1503,14 +3252,19 @@ static void* heartbeat_thread_func(void *arg) {
 
         pthread_mutex_unlock(&ctx->lock);
 
+        for (int s = 0; s < num_suspects; s++) {
+            send_probe_requests(suspects[s]);
+        }
+
         /* Sleep for heartbeat interval */
         struct timespec sleep_time = {
-            .tv_sec = 2,
-            .tv_nsec = 0
+            .tv_sec = interval_ms / 1000,
+            .tv_nsec = (long)(interval_ms % 1000) * 1000000L
         };
         nanosleep(&sleep_time, NULL);
     }
 
+    free(suspects);
     LOG_INFO("Heartbeat thread stopped");
     return NULL;
 }
@@ -1524,7 +3278,7 @@ void start_heartbeat_thread(void) {
     uint64_t current_time = now.tv_sec * 1000000000ULL + now.tv_nsec;
 
     pthread_mutex_lock(&ctx->lock);
-    for (int i = 0; i < MAX_NODES; i++) {
+    for (int i = 0; i < ctx->network.max_nodes; i++) {
         ctx->network.nodes[i].last_heartbeat_time = current_time;
         ctx->network.nodes[i].missed_heartbeats = 0;
         ctx->network.nodes[i].is_failed = false;
@@ -1552,7 +3306,7 @@ void stop_heartbeat_thread(void) {
 }
 
 /* DIRECTORY PROTOCOL */
-int send_dir_query(node_id_t manager, page_id_t page_id) {
+int send_dir_query(node_id_t manager, page_id_t page_id, uint64_t request_id) {
     dsm_context_t *ctx = dsm_get_context();
     message_t msg;
     memset(&msg, 0, sizeof(msg));
@@ -1561,245 +3315,1065 @@ int send_dir_query(node_id_t manager, page_id_t page_id) {
     msg.header.sender = ctx->node_id;
     msg.payload.dir_query.page_id = page_id;
     msg.payload.dir_query.requester = ctx->node_id;
+    msg.payload.dir_query.request_id = request_id;
 
-    LOG_INFO("Sending DIR_QUERY to node %u for page %lu", manager, page_id);
-    int rc = network_send(manager, &msg);
+    LOG_DEBUG("Sending DIR_QUERY to node %u for page %lu (request %lu)", manager, page_id, request_id);
+    int rc = network_send(route_peer(manager), &msg);
     if (rc != DSM_SUCCESS) {
         LOG_ERROR("Failed to send DIR_QUERY to node %u (rc=%d)", manager, rc);
     }
-    return rc;
+    return rc;
+}
+
+int send_dir_reply(node_id_t requester, page_id_t page_id, node_id_t owner, uint64_t request_id) {
+    dsm_context_t *ctx = dsm_get_context();
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.magic = MSG_MAGIC;
+    msg.header.type = MSG_DIR_REPLY;
+    msg.header.sender = ctx->node_id;
+    msg.payload.dir_reply.page_id = page_id;
+    msg.payload.dir_reply.owner = owner;
+    msg.payload.dir_reply.request_id = request_id;
+    msg.payload.dir_reply.advice = (uint8_t)directory_advice_for(page_id, requester);
+    
+    int rc = network_send(route_peer(requester), &msg);
+    if (rc == DSM_SUCCESS) {
+        track_bytes_sent(MSG_DIR_REPLY);
+    }
+    return rc;
+}
+
+int send_owner_update(node_id_t manager, page_id_t page_id, node_id_t new_owner) {
+    dsm_context_t *ctx = dsm_get_context();
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.magic = MSG_MAGIC;
+    msg.header.type = MSG_OWNER_UPDATE;
+    msg.header.sender = ctx->node_id;
+    msg.payload.owner_update.page_id = page_id;
+    msg.payload.owner_update.new_owner = new_owner;
+    
+    int rc = network_send_async(route_peer(manager), &msg);
+    if (rc == DSM_SUCCESS) {
+        track_bytes_sent(MSG_OWNER_UPDATE);
+    }
+    return rc;
+}
+
+int handle_dir_query(const message_t *msg) {
+    /* Track received bytes */
+    track_bytes_received(MSG_DIR_QUERY);
+
+    page_id_t page_id = msg->payload.dir_query.page_id;
+    node_id_t requester = msg->payload.dir_query.requester;
+
+    LOG_DEBUG("Received DIR_QUERY for page %lu from node %u", page_id, requester);
+
+    page_directory_t *dir = get_page_directory();
+    node_id_t owner = 0;
+
+    if (dir) {
+        /* Queries come from faults, so the requester claims an untouched first-touch page */
+        int rc = directory_claim_owner(dir, page_id, requester, &owner);
+        LOG_DEBUG("Directory lookup for page %lu: owner=%u (rc=%d)", page_id, owner, rc);
+    } else {
+        LOG_WARN("No directory available for lookup");
+    }
+
+    LOG_DEBUG("Sending DIR_REPLY to node %u: page %lu owned by node %u", requester, page_id, owner);
+    return send_dir_reply(requester, page_id, owner, msg->payload.dir_query.request_id);
+}
+
+int handle_dir_reply(const message_t *msg) {
+    /* Track received bytes */
+    track_bytes_received(MSG_DIR_REPLY);
+
+    page_id_t page_id = msg->payload.dir_reply.page_id;
+    node_id_t owner = msg->payload.dir_reply.owner;
+
+    LOG_DEBUG("Received DIR_REPLY for page %lu: owner=node %u", page_id, owner);
+
+    /* The directory node decides the adaptive policy; keep its advice
+     * before the querying thread goes on with the page */
+    page_directory_t *dir = get_page_directory();
+    if (dir) {
+        directory_note_advice(dir, page_id, (directory_advice_t)msg->payload.dir_reply.advice);
+    }
+
+    /* Wake exactly the thread that issued this query; a reply for a query
+     * that already timed out no longer has a slot and is dropped */
+    dsm_context_t *ctx = dsm_get_context();
+    if (pending_query_complete_owner(&ctx->network.dir_queries, page_id,
+                                     msg->payload.dir_reply.request_id, owner) != DSM_SUCCESS) {
+        LOG_DEBUG("Dropping stale DIR_REPLY for page %lu (request %lu)",
+                  page_id, msg->payload.dir_reply.request_id);
+    }
+
+    return DSM_SUCCESS;
+}
+
+int handle_owner_update(const message_t *msg) {
+    /* Track received bytes */
+    track_bytes_received(MSG_OWNER_UPDATE);
+
+    page_id_t page_id = msg->payload.owner_update.page_id;
+    node_id_t new_owner = msg->payload.owner_update.new_owner;
+    
+    /* The update leaves the writer after it has the page, on a shard of
+     * its own, so handler threads can run it after the directory node has
+     * taken the page back: it names itself only when it takes a page, from
+     * the writer that got it last. Naming that writer again would have it
+     * treat an invalidated copy as its own */
+    dsm_context_t *ctx = dsm_get_context();
+    bool local = directory_is_local(page_id);
+    page_directory_t *dir = get_page_directory();
+    if (dir) {
+        int rc = local ?
+            directory_update_owner(dir, page_id, new_owner, ctx->node_id) :
+            directory_set_owner(dir, page_id, new_owner);
+        if (rc == DSM_ERROR_BUSY) {
+            LOG_DEBUG("Dropping stale OWNER_UPDATE for page %lu: node %u took it back", page_id, ctx->node_id);
+        } else {
+            LOG_DEBUG("Updated directory (via MSG): page %lu now owned by node %u", page_id, new_owner);
+        }
+    }
+
+    /* The writer has the page: the next request for it may go ahead */
+    if (local) {
+        handoff_release(page_id, new_owner);
+    }
+    return DSM_SUCCESS;
+}
+
+int broadcast_node_failure(node_id_t failed_node) {
+    dsm_context_t *ctx = dsm_get_context();
+    
+    /* Broadcast to all connected nodes */
+    for (int i = 0; i < ctx->network.max_nodes; i++) {
+        pthread_mutex_lock(&ctx->lock);
+        bool connected = ctx->network.nodes[i].connected;
+        node_id_t node_id = ctx->network.nodes[i].id;
+        pthread_mutex_unlock(&ctx->lock);
+
+        /* Don't send to self or the failed node */
+        if (connected && node_id != ctx->node_id && node_id != failed_node) {
+            
+            message_t msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.header.magic = MSG_MAGIC;
+            msg.header.type = MSG_NODE_FAILED;
+            msg.header.sender = ctx->node_id;
+            msg.payload.node_failed.failed_node = failed_node;
+            
+            LOG_INFO("Broadcasting NODE_FAILED for node %u to node %u", 
+                     failed_node, node_id);
+            network_send(node_id, &msg);
+        }
+    }
+    return DSM_SUCCESS;
+}
+
+int handle_node_failed_msg(const message_t *msg) {
+    /* Track received bytes */
+    track_bytes_received(MSG_NODE_FAILED);
+
+    node_id_t failed_node = msg->payload.node_failed.failed_node;
+    dsm_context_t *ctx = dsm_get_context();
+
+    pthread_mutex_lock(&ctx->lock);
+    if (failed_node < (node_id_t)ctx->network.max_nodes && !ctx->network.nodes[failed_node].is_failed) {
+         ctx->network.nodes[failed_node].is_failed = true;
+         LOG_WARN("Marked node %u as FAILED via notification", failed_node);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    page_directory_t *dir = get_page_directory();
+    if (dir) {
+        directory_handle_node_failure(dir, failed_node);
+    }
+
+    return DSM_SUCCESS;
+}
+
+/* CRITICAL FIX (BUG #8): Sharer tracking protocol */
+int send_sharer_query(node_id_t owner, page_id_t page_id, uint64_t request_id) {
+    dsm_context_t *ctx = dsm_get_context();
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.magic = MSG_MAGIC;
+    msg.header.type = MSG_SHARER_QUERY;
+    msg.header.sender = ctx->node_id;
+    msg.payload.sharer_query.page_id = page_id;
+    msg.payload.sharer_query.requester = ctx->node_id;
+    msg.payload.sharer_query.request_id = request_id;
+
+    LOG_DEBUG("Querying node %u for sharers of page %lu", owner, page_id);
+    int rc = network_send(owner, &msg);
+    if (rc == DSM_SUCCESS) {
+        track_bytes_sent(MSG_SHARER_QUERY);
+    }
+    return rc;
+}
+
+int handle_sharer_query(const message_t *msg) {
+    /* Track received bytes */
+    track_bytes_received(MSG_SHARER_QUERY);
+
+    page_id_t page_id = msg->payload.sharer_query.page_id;
+    node_id_t requester = msg->payload.sharer_query.requester;
+
+    LOG_DEBUG("Received SHARER_QUERY for page %lu from node %u", page_id, requester);
+
+    /* Look up sharers in local directory */
+    page_directory_t *dir = get_page_directory();
+    node_id_t sharers[MAX_SHARERS];
+    int num_sharers = 0;
+
+    if (dir) {
+        directory_get_sharers(dir, page_id, sharers, &num_sharers);
+    }
+
+    /* Send reply with sharer list */
+    dsm_context_t *ctx = dsm_get_context();
+    message_t reply;
+    memset(&reply, 0, sizeof(reply));
+    reply.header.magic = MSG_MAGIC;
+    reply.header.type = MSG_SHARER_REPLY;
+    reply.header.sender = ctx->node_id;
+    reply.payload.sharer_reply.page_id = page_id;
+    reply.payload.sharer_reply.request_id = msg->payload.sharer_query.request_id;
+    reply.payload.sharer_reply.num_sharers = num_sharers;
+    for (int i = 0; i < num_sharers && i < MAX_SHARERS; i++) {
+        reply.payload.sharer_reply.sharers[i] = sharers[i];
+    }
+
+    LOG_DEBUG("Sending SHARER_REPLY to node %u: page %lu has %d sharers",
+             requester, page_id, num_sharers);
+    int rc = network_send(requester, &reply);
+    if (rc == DSM_SUCCESS) {
+        track_bytes_sent(MSG_SHARER_REPLY);
+    }
+    return rc;
+}
+
+int handle_sharer_reply(const message_t *msg) {
+    /* Track received bytes */
+    track_bytes_received(MSG_SHARER_REPLY);
+
+    page_id_t page_id = msg->payload.sharer_reply.page_id;
+    int num_sharers = msg->payload.sharer_reply.num_sharers;
+
+    LOG_DEBUG("Received SHARER_REPLY for page %lu: %d sharers", page_id, num_sharers);
+
+    /* Hand the list to the fetch_page_write call that issued this query */
+    dsm_context_t *ctx = dsm_get_context();
+    node_id_t sharers[MAX_SHARERS];
+    if (num_sharers > MAX_SHARERS) {
+        num_sharers = MAX_SHARERS;
+    }
+    for (int i = 0; i < num_sharers; i++) {
+        sharers[i] = msg->payload.sharer_reply.sharers[i];
+    }
+    if (pending_query_complete_sharers(&ctx->network.sharer_queries, page_id,
+                                       msg->payload.sharer_reply.request_id,
+                                       sharers, num_sharers) == DSM_SUCCESS) {
+        LOG_DEBUG("Stored sharer list for page %lu in query table", page_id);
+    } else {
+        LOG_DEBUG("Dropping stale SHARER_REPLY for page %lu (request %lu)",
+                  page_id, msg->payload.sharer_reply.request_id);
+    }
+
+    return DSM_SUCCESS;
+}
+
+/* ============================ */
+/*   Release Consistency Diffs  */
+/* ============================ */
+
+int send_page_diff(node_id_t home, page_id_t page_id, uint16_t sub_page, const uint8_t *data,
+                   uint16_t len, uint16_t num_runs) {
+    if (len > PAGE_DIFF_MAX_DATA) {
+        return DSM_ERROR_INVALID;
+    }
+
+    dsm_context_t *ctx = dsm_get_context();
+    message_t msg;
+    memset(&msg.header, 0, sizeof(msg.header));
+    msg.header.magic = MSG_MAGIC;
+    msg.header.type = MSG_PAGE_DIFF;
+    msg.header.sender = ctx->node_id;
+    msg.payload.page_diff.page_id = page_id;
+    msg.payload.page_diff.writer = ctx->node_id;
+    msg.payload.page_diff.home = home;
+    msg.payload.page_diff.sub_page = sub_page;
+    msg.payload.page_diff.num_runs = num_runs;
+    msg.payload.page_diff.data_len = len;
+    memcpy(msg.payload.page_diff.data, data, len);
+
+    LOG_DEBUG("Sending PAGE_DIFF for page %lu to home node %u (%u runs, %u bytes)",
+              page_id, home, num_runs, len);
+    int rc = network_send(route_direct(home), &msg);
+    if (rc == DSM_SUCCESS) {
+        track_bytes_sent(MSG_PAGE_DIFF);
+        STATS_ADD(network_bytes_sent, len);
+    }
+    return rc;
+}
+
+int send_page_diff_ack(node_id_t writer, page_id_t page_id, int result) {
+    dsm_context_t *ctx = dsm_get_context();
+    message_t msg;
+    memset(&msg, 0, sizeof(msg.header) + sizeof(page_diff_ack_payload_t));
+    msg.header.magic = MSG_MAGIC;
+    msg.header.type = MSG_PAGE_DIFF_ACK;
+    msg.header.sender = ctx->node_id;
+    msg.payload.page_diff_ack.page_id = page_id;
+    msg.payload.page_diff_ack.writer = writer;
+    msg.payload.page_diff_ack.home = ctx->node_id;
+    msg.payload.page_diff_ack.result = result;
+
+    int rc = network_send(route_direct(writer), &msg);
+    if (rc == DSM_SUCCESS) {
+        track_bytes_sent(MSG_PAGE_DIFF_ACK);
+    }
+    return rc;
+}
+
+int handle_page_diff(const message_t *msg) {
+    const page_diff_payload_t *diff = &msg->payload.page_diff;
+    track_bytes_received(MSG_PAGE_DIFF);
+    STATS_ADD(network_bytes_received, diff->data_len);
+
+    dsm_context_t *ctx = dsm_get_context();
+
+    /* Manager proxies diffs between workers (star topology) */
+    if (diff->home != ctx->node_id) {
+        if (!ctx->config.is_manager || diff->home >= (node_id_t)ctx->network.max_nodes) {
+            LOG_ERROR("PAGE_DIFF for page %lu addressed to node %u", diff->page_id, diff->home);
+            return send_page_diff_ack(diff->writer, diff->page_id, DSM_ERROR_INVALID);
+        }
+
+        message_t forward_msg;
+        forward_msg.header = msg->header;
+        forward_msg.header.sender = ctx->node_id;
+        memcpy(&forward_msg.payload.page_diff, diff,
+               offsetof(page_diff_payload_t, data) + diff->data_len);
+
+        LOG_DEBUG("Manager forwarding PAGE_DIFF for page %lu from node %u to home node %u",
+                  diff->page_id, diff->writer, diff->home);
+        int rc = network_send(diff->home, &forward_msg);
+        if (rc != DSM_SUCCESS) {
+            LOG_ERROR("Failed to forward PAGE_DIFF to node %u (rc=%d)", diff->home, rc);
+            return send_page_diff_ack(diff->writer, diff->page_id, rc);
+        }
+        return DSM_SUCCESS;
+    }
+
+    int result = rc_apply_diff(diff->page_id, diff->sub_page, diff->data, diff->data_len, diff->num_runs);
+    LOG_DEBUG("Applied PAGE_DIFF for page %lu from node %u (%u runs, rc=%d)",
+              diff->page_id, diff->writer, diff->num_runs, result);
+    return send_page_diff_ack(diff->writer, diff->page_id, result);
+}
+
+int handle_page_diff_ack(const message_t *msg) {
+    const page_diff_ack_payload_t *ack = &msg->payload.page_diff_ack;
+    track_bytes_received(MSG_PAGE_DIFF_ACK);
+
+    dsm_context_t *ctx = dsm_get_context();
+    if (ack->writer != ctx->node_id) {
+        if (!ctx->config.is_manager || ack->writer >= (node_id_t)ctx->network.max_nodes) {
+            LOG_WARN("Dropping PAGE_DIFF_ACK for node %u", ack->writer);
+            return DSM_SUCCESS;
+        }
+
+        message_t forward_msg;
+        forward_msg.header = msg->header;
+        forward_msg.header.sender = ctx->node_id;
+        forward_msg.payload.page_diff_ack = *ack;
+        return network_send(ack->writer, &forward_msg);
+    }
+
+    if (ack->result != DSM_SUCCESS) {
+        LOG_WARN("Home node %u rejected diff for page %lu (rc=%d)",
+                 ack->home, ack->page_id, ack->result);
+    }
+    rc_diff_acked(ack->result);
+    return DSM_SUCCESS;
+}
+
+/* ============================ */
+/*   Batched Page Requests      */
+/* ============================ */
+
+int send_page_batch_request(node_id_t owner, const page_batch_entry_t *pages, int num_pages) {
+    if (num_pages <= 0 || num_pages > PAGE_BATCH_MAX) {
+        return DSM_ERROR_INVALID;
+    }
+
+    dsm_context_t *ctx = dsm_get_context();
+    message_t msg;
+    memset(&msg.header, 0, sizeof(msg.header));
+    msg.header.magic = MSG_MAGIC;
+    msg.header.type = MSG_PAGE_BATCH_REQUEST;
+    msg.header.sender = ctx->node_id;
+    msg.payload.page_batch_request.requester = ctx->node_id;
+    msg.payload.page_batch_request.accept_encodings = page_codec_supported();
+    msg.payload.page_batch_request.num_pages = (uint16_t)num_pages;
+    memcpy(msg.payload.page_batch_request.pages, pages, (size_t)num_pages * sizeof(*pages));
+
+    LOG_DEBUG("Sending PAGE_BATCH_REQUEST for %d pages from page %lu to node %u",
+              num_pages, pages[0].page_id, owner);
+    int rc = network_send(directory_distributed() ? route_peer(owner) : route_via_manager(owner), &msg);
+    if (rc == DSM_SUCCESS) {
+        STATS_ADD(network_bytes_sent, 4 + sizeof(msg_header_t) + message_wire_payload_size(&msg));
+    }
+    return rc;
+}
+
+/**
+ * PAGE_BATCH_REPLY being built by a page owner
+ */
+typedef struct {
+    message_t msg;                           /**< Header and page metadata */
+    struct iovec data[PAGE_BATCH_MAX];       /**< Page data, in entry order */
+    int num_data;                            /**< Used entries of data */
+    size_t data_len;                         /**< Bytes described by data */
+    page_table_t *tables[PAGE_BATCH_MAX];    /**< Table references held until sent */
+    uint8_t *scratch;                        /**< Encoded pages (PAGE_BATCH_MAX_DATA bytes, on demand) */
+    size_t scratch_used;                     /**< Bytes of scratch used */
+} batch_reply_t;
+
+/**
+ * Add a page we hold to a batch reply, as a READ PAGE_REQUEST would serve it
+ * Raw pages are sent zero-copy from the page.
+ *
+ * @return false if the page is not held here and must be handled on its own
+ */
+static bool batch_reply_add(batch_reply_t *reply, const page_batch_entry_t *page,
+                            node_id_t requester, uint8_t accept_encodings) {
+    dsm_context_t *ctx = dsm_get_context();
+    page_batch_reply_payload_t *batch = &reply->msg.payload.page_batch_reply;
+
+    page_table_t *table = NULL;
+    pthread_mutex_lock(&ctx->lock);
+    page_entry_t *entry = page_index_lookup_id(page->page_id, &table);
+    if (entry) {
+        page_table_acquire(table);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    if (!entry) {
+        return false;
+    }
+
+    /* Blocks larger than PAGE_SIZE are served as one PAGE_REPLY each */
+    if (table->block_size > PAGE_SIZE) {
+        page_table_release(table);
+        return false;
+    }
+
+    pthread_mutex_lock(&table->lock);
+    bool valid = entry->state != PAGE_STATE_INVALID;
+    pthread_mutex_unlock(&table->lock);
+    if (!valid || share_for_read(table, entry, requester) != DSM_SUCCESS) {
+        page_table_release(table);
+        return false;
+    }
+
+    pthread_mutex_lock(&table->lock);
+    uint64_t version = entry->version;
+    pthread_mutex_unlock(&table->lock);
+
+    page_batch_reply_entry_t *out = &batch->pages[batch->num_pages];
+    out->page_id = page->page_id;
+    out->version = version;
+    out->copy_current = page->cached_version != 0 && page->cached_version == version;
+    out->encoding = PAGE_ENCODING_RAW;
+    out->data_len = 0;
+
+    if (!out->copy_current) {
+        const void *data = entry->local_addr;
+        size_t len = PAGE_SIZE;
+
+        dsm_compression_t compression = page_codec_negotiate(table->compression, accept_encodings);
+        if (compression != DSM_COMPRESSION_NONE && !reply->scratch) {
+            reply->scratch = malloc(PAGE_BATCH_MAX_DATA);
+        }
+        if (compression != DSM_COMPRESSION_NONE && reply->scratch) {
+            uint8_t *enc = reply->scratch + reply->scratch_used;
+            len = page_codec_encode(entry->local_addr, compression, enc, &out->encoding);
+            if (out->encoding != PAGE_ENCODING_RAW) {
+                data = enc;
+                reply->scratch_used += len;
+                STATS_INC(pages_compressed);
+                STATS_ADD(compression_bytes_saved, PAGE_SIZE - len);
+            }
+        }
+
+        out->data_len = (uint16_t)len;
+        if (len > 0) {
+            reply->data[reply->num_data].iov_base = (void*)data;
+            reply->data[reply->num_data].iov_len = len;
+            reply->num_data++;
+            reply->data_len += len;
+        }
+    }
+
+    reply->tables[batch->num_pages++] = table;
+    return true;
+}
+
+/**
+ * Send a batch reply and release its pages
+ */
+static int batch_reply_send(batch_reply_t *reply) {
+    page_batch_reply_payload_t *batch = &reply->msg.payload.page_batch_reply;
+    int rc = DSM_SUCCESS;
+
+    if (batch->num_pages > 0) {
+        LOG_DEBUG("Sending PAGE_BATCH_REPLY with %u pages from page %lu to node %u (%zu data bytes)",
+                  batch->num_pages, batch->pages[0].page_id, batch->requester, reply->data_len);
+        node_id_t next = directory_distributed() ? route_direct(batch->requester) :
+                                                   route_via_manager(batch->requester);
+        rc = network_send_bulk(next, &reply->msg, reply->data, reply->num_data);
+        if (rc == DSM_SUCCESS) {
+            STATS_ADD(network_bytes_sent, 4 + sizeof(msg_header_t) +
+                      message_wire_payload_size(&reply->msg) + reply->data_len);
+        } else {
+            LOG_ERROR("Failed to send PAGE_BATCH_REPLY to node %u (rc=%d)", batch->requester, rc);
+        }
+    }
+
+    for (int i = 0; i < batch->num_pages; i++) {
+        if (rc == DSM_SUCCESS) {
+            if (batch->pages[i].copy_current) {
+                STATS_INC(page_data_skipped);
+            } else {
+                STATS_INC(pages_sent);
+            }
+        }
+        page_table_release(reply->tables[i]);
+    }
+    free(reply->scratch);
+    return rc;
+}
+
+/**
+ * Forward pages the directory node does not hold to their owner
+ */
+static int forward_page_batch(const message_t *msg, node_id_t owner,
+                              const page_batch_entry_t *pages, int num_pages) {
+    if (num_pages == 0) {
+        return DSM_SUCCESS;
+    }
+
+    dsm_context_t *ctx = dsm_get_context();
+    message_t fwd;
+    fwd.header = msg->header;
+    fwd.header.sender = ctx->node_id;
+    fwd.payload.page_batch_request.requester = msg->payload.page_batch_request.requester;
+    fwd.payload.page_batch_request.accept_encodings = msg->payload.page_batch_request.accept_encodings;
+    fwd.payload.page_batch_request.num_pages = (uint16_t)num_pages;
+    memcpy(fwd.payload.page_batch_request.pages, pages, (size_t)num_pages * sizeof(*pages));
+
+    LOG_DEBUG("Forwarding PAGE_BATCH_REQUEST for %d pages from node %u to owner node %u",
+              num_pages, fwd.payload.page_batch_request.requester, owner);
+    int rc = network_send(route_peer(owner), &fwd);
+    if (rc != DSM_SUCCESS) {
+        LOG_ERROR("Failed to forward PAGE_BATCH_REQUEST to node %u (rc=%d)", owner, rc);
+    }
+    return rc;
+}
+
+/**
+ * Owner of a page the directory node does not hold, if the request should go there
+ */
+static bool batch_forward_target(page_id_t page_id, node_id_t requester, node_id_t *owner) {
+    dsm_context_t *ctx = dsm_get_context();
+    page_directory_t *dir = get_page_directory();
+    if (!directory_is_local(page_id) || !dir || directory_lookup(dir, page_id, owner) != DSM_SUCCESS) {
+        return false;
+    }
+    return *owner != ctx->node_id && *owner != requester &&
+           *owner < (node_id_t)ctx->network.max_nodes;
+}
+
+int handle_page_batch_request(const message_t *msg) {
+    STATS_ADD(network_bytes_received, 4 + sizeof(msg_header_t) + message_wire_payload_size(msg));
+
+    const page_batch_request_payload_t *batch = &msg->payload.page_batch_request;
+    int num_pages = batch->num_pages <= PAGE_BATCH_MAX ? batch->num_pages : PAGE_BATCH_MAX;
+    if (num_pages == 0) {
+        return DSM_SUCCESS;
+    }
+
+    LOG_DEBUG("Handling PAGE_BATCH_REQUEST for %d pages from node %u",
+              num_pages, batch->requester);
+
+    /* Pages are served by the handler of their shard, so no message for a
+     * page is ever handled concurrently with its part of the batch. This
+     * handler runs on the first page's shard; pages of other shards are
+     * handed on as smaller batches (one per shard). */
+    int shard = handler_pool_page_shard(batch->pages[0].page_id);
+    bool handed_on[PAGE_BATCH_MAX] = { false };
+    message_t sub;
+    sub.header = msg->header;
+    sub.payload.page_batch_request.requester = batch->requester;
+    sub.payload.page_batch_request.accept_encodings = batch->accept_encodings;
+
+    for (int i = 1; i < num_pages; i++) {
+        int other = handler_pool_page_shard(batch->pages[i].page_id);
+        if (handed_on[i] || other == shard) {
+            continue;
+        }
+
+        int count = 0;
+        for (int j = i; j < num_pages; j++) {
+            if (!handed_on[j] && handler_pool_page_shard(batch->pages[j].page_id) == other) {
+                sub.payload.page_batch_request.pages[count++] = batch->pages[j];
+                handed_on[j] = true;
+            }
+        }
+        sub.payload.page_batch_request.num_pages = (uint16_t)count;
+        if (handler_pool_submit(&sub) != DSM_SUCCESS) {
+            /* Pool stopped meanwhile: nothing else runs handlers now */
+            for (int j = i; j < num_pages; j++) {
+                if (handler_pool_page_shard(batch->pages[j].page_id) == other) {
+                    handed_on[j] = false;
+                }
+            }
+        }
+    }
+
+    /* Pages held here go back in one PAGE_BATCH_REPLY. The directory node
+     * forwards the others to their owners, grouped per owner; anything left is
+     * answered page by page (proxy or ERROR), as a PAGE_REQUEST would be. */
+    dsm_context_t *ctx = dsm_get_context();
+    batch_reply_t *reply = malloc(sizeof(*reply));
+    if (!reply) {
+        return DSM_ERROR_MEMORY;
+    }
+    memset(&reply->msg.header, 0, sizeof(reply->msg.header));
+    reply->msg.header.magic = MSG_MAGIC;
+    reply->msg.header.type = MSG_PAGE_BATCH_REPLY;
+    reply->msg.header.sender = ctx->node_id;
+    reply->msg.payload.page_batch_reply.requester = batch->requester;
+    reply->msg.payload.page_batch_reply.num_pages = 0;
+    reply->num_data = 0;
+    reply->data_len = 0;
+    reply->scratch = NULL;
+    reply->scratch_used = 0;
+
+    page_batch_entry_t forward[PAGE_BATCH_MAX];
+    int num_forward = 0;
+    node_id_t forward_owner = 0;
+
+    message_t req;
+    memset(&req, 0, sizeof(req.header) + sizeof(page_request_payload_t));
+    req.header = msg->header;
+    req.header.type = MSG_PAGE_REQUEST;
+    req.payload.page_request.access = ACCESS_READ;
+    req.payload.page_request.requester = batch->requester;
+    req.payload.page_request.accept_encodings = batch->accept_encodings;
+
+    for (int i = 0; i < num_pages; i++) {
+        if (handed_on[i]) {
+            continue;
+        }
+
+        /* A page on its way to a writer waits for it, as its PAGE_REQUEST would */
+        bool in_flight = directory_is_local(batch->pages[i].page_id) &&
+                         handoff_busy(batch->pages[i].page_id);
+        if (!in_flight &&
+            batch_reply_add(reply, &batch->pages[i], batch->requester, batch->accept_encodings)) {
+            continue;
+        }
+
+        node_id_t owner;
+        if (!in_flight && batch_forward_target(batch->pages[i].page_id, batch->requester, &owner)) {
+            track_proxied_reader(batch->pages[i].page_id, batch->requester);
+            if (num_forward > 0 && owner != forward_owner) {
+                forward_page_batch(msg, forward_owner, forward, num_forward);
+                num_forward = 0;
+            }
+            forward_owner = owner;
+            forward[num_forward++] = batch->pages[i];
+            continue;
+        }
+
+        req.payload.page_request.page_id = batch->pages[i].page_id;
+        req.payload.page_request.cached_version = batch->pages[i].cached_version;
+        handle_page_request(&req);
+    }
+    forward_page_batch(msg, forward_owner, forward, num_forward);
+
+    int rc = batch_reply_send(reply);
+    free(reply);
+    return rc;
+}
+
+/* PAGE_BATCH_REPLY */
+int handle_page_batch_reply(const message_t *msg, const uint8_t *data, size_t data_len) {
+    const page_batch_reply_payload_t *batch = &msg->payload.page_batch_reply;
+    int num_pages = batch->num_pages <= PAGE_BATCH_MAX ? batch->num_pages : PAGE_BATCH_MAX;
+    node_id_t sender = msg->header.sender;
+    dsm_context_t *ctx = dsm_get_context();
+
+    /* Manager forwards the whole frame between workers (star topology) */
+    if (batch->requester != ctx->node_id) {
+        if (!ctx->config.is_manager || batch->requester == sender ||
+            batch->requester >= (node_id_t)ctx->network.max_nodes) {
+            LOG_WARN("Dropping PAGE_BATCH_REPLY for node %u from node %u", batch->requester, sender);
+            return DSM_ERROR_INVALID;
+        }
+
+        message_t fwd;
+        memcpy(&fwd.header, &msg->header, sizeof(msg_header_t));
+        memcpy(&fwd.payload, &msg->payload, message_wire_payload_size(msg));
+        fwd.header.sender = ctx->node_id;
+
+        struct iovec iov = { .iov_base = (void*)data, .iov_len = data_len };
+        LOG_DEBUG("Manager forwarding PAGE_BATCH_REPLY with %d pages from node %u to node %u",
+                  num_pages, sender, batch->requester);
+        int rc = network_send_bulk(batch->requester, &fwd, &iov, data_len > 0 ? 1 : 0);
+        if (rc != DSM_SUCCESS) {
+            LOG_ERROR("Failed to forward PAGE_BATCH_REPLY to node %u (rc=%d)", batch->requester, rc);
+        }
+        return rc;
+    }
+
+    LOG_DEBUG("Handling PAGE_BATCH_REPLY with %d pages from node %u (%zu data bytes)",
+              num_pages, sender, data_len);
+
+    /* Each page becomes the PAGE_REPLY it stands for and is installed by
+     * its shard in order with other messages for it. Byte accounting is
+     * per page there. */
+    message_t reply;
+    memset(&reply, 0, sizeof(reply.header) + offsetof(page_reply_payload_t, data));
+    reply.header = msg->header;
+    reply.header.type = MSG_PAGE_REPLY;
+    reply.payload.page_reply.access = ACCESS_READ;
+    reply.payload.page_reply.requester = ctx->node_id;
+
+    /* The whole frame is checked first so a malformed one installs nothing */
+    size_t total = 0;
+    for (int i = 0; i < num_pages; i++) {
+        const page_batch_reply_entry_t *page = &batch->pages[i];
+        reply.payload.page_reply.copy_current = page->copy_current;
+        reply.payload.page_reply.encoding = page->encoding;
+        reply.payload.page_reply.data_len = page->data_len;
+        if (page_reply_data_len(&reply) != page->data_len) {
+            LOG_ERROR("Malformed PAGE_BATCH_REPLY from node %u at page %lu", sender, page->page_id);
+            return DSM_ERROR_INVALID;
+        }
+        total += page->data_len;
+    }
+    if (total != data_len) {
+        LOG_ERROR("PAGE_BATCH_REPLY from node %u carries %zu data bytes, entries describe %zu",
+                  sender, data_len, total);
+        return DSM_ERROR_INVALID;
+    }
+
+    /* Each page is built in a pooled entry of its size and handed over as is */
+    size_t offset = 0;
+    for (int i = 0; i < num_pages; i++) {
+        const page_batch_reply_entry_t *page = &batch->pages[i];
+        msg_queue_entry_t *entry = msg_pool_get(offsetof(page_reply_payload_t, data) + page->data_len);
+        if (!entry) {
+            return DSM_ERROR_MEMORY;
+        }
+
+        message_t *out = &entry->msg;
+        out->header = reply.header;
+        memcpy(&out->payload, &reply.payload, offsetof(page_reply_payload_t, data));
+        out->payload.page_reply.page_id = page->page_id;
+        out->payload.page_reply.version = page->version;
+        out->payload.page_reply.copy_current = page->copy_current;
+        out->payload.page_reply.encoding = page->encoding;
+        out->payload.page_reply.data_len = page->data_len;
+        if (page->data_len > 0) {
+            memcpy(out->payload.page_reply.data, data + offset, page->data_len);
+            offset += page->data_len;
+        }
+
+        if (handler_pool_submit_entry(entry) != DSM_SUCCESS) {
+            handle_page_reply(out);
+            msg_pool_put(entry);
+        }
+    }
+    return DSM_SUCCESS;
+}
+
+/* ============================ */
+/*   One-Sided Transfers        */
+/* ============================ */
+
+/** Bytes described by an iovec array */
+static size_t iov_total(const struct iovec *data, int num_data) {
+    size_t total = 0;
+    for (int i = 0; i < num_data; i++) {
+        total += data[i].iov_len;
+    }
+    return total;
 }
 
-int send_dir_reply(node_id_t requester, page_id_t page_id, node_id_t owner) {
+int send_rma_request(node_id_t target, uint64_t op_id, rma_op_t op, const rma_segment_t *segments,
+                     int num_segments, const struct iovec *data, int num_data) {
+    if (num_segments <= 0 || num_segments > RMA_MAX_SEGMENTS) {
+        return DSM_ERROR_INVALID;
+    }
+
     dsm_context_t *ctx = dsm_get_context();
     message_t msg;
-    memset(&msg, 0, sizeof(msg));
+    memset(&msg.header, 0, sizeof(msg.header));
     msg.header.magic = MSG_MAGIC;
-    msg.header.type = MSG_DIR_REPLY;
+    msg.header.type = MSG_RMA_REQUEST;
     msg.header.sender = ctx->node_id;
-    msg.payload.dir_reply.page_id = page_id;
-    msg.payload.dir_reply.owner = owner;
-    
-    int rc = network_send(requester, &msg);
+    msg.payload.rma_request.op_id = op_id;
+    msg.payload.rma_request.requester = ctx->node_id;
+    msg.payload.rma_request.target = target;
+    msg.payload.rma_request.op = (uint8_t)op;
+    msg.payload.rma_request.num_segments = (uint16_t)num_segments;
+    memcpy(msg.payload.rma_request.segments, segments, (size_t)num_segments * sizeof(*segments));
+
+    /* Requests the manager must resolve go to it; others go to their target */
+    node_id_t dest = target == DSM_NODE_NONE ? 0 : route_direct(target);
+    size_t data_len = iov_total(data, num_data);
+
+    LOG_DEBUG("Sending RMA_REQUEST %lu (op %d, %d segments, %zu data bytes) for node %d via node %u",
+              op_id, (int)op, num_segments, data_len,
+              target == DSM_NODE_NONE ? -1 : (int)target, dest);
+    int rc = network_send_bulk(dest, &msg, data, num_data);
     if (rc == DSM_SUCCESS) {
-        track_bytes_sent(MSG_DIR_REPLY);
+        STATS_ADD(network_bytes_sent, 4 + sizeof(msg_header_t) + message_wire_payload_size(&msg) + data_len);
     }
     return rc;
 }
 
-int send_owner_update(node_id_t manager, page_id_t page_id, node_id_t new_owner) {
+int send_rma_reply(node_id_t requester, uint64_t op_id, rma_op_t op, const rma_result_t *results,
+                   int num_results, const struct iovec *data, int num_data) {
+    if (num_results <= 0 || num_results > RMA_MAX_SEGMENTS) {
+        return DSM_ERROR_INVALID;
+    }
+
     dsm_context_t *ctx = dsm_get_context();
     message_t msg;
-    memset(&msg, 0, sizeof(msg));
+    memset(&msg.header, 0, sizeof(msg.header));
     msg.header.magic = MSG_MAGIC;
-    msg.header.type = MSG_OWNER_UPDATE;
+    msg.header.type = MSG_RMA_REPLY;
     msg.header.sender = ctx->node_id;
-    msg.payload.owner_update.page_id = page_id;
-    msg.payload.owner_update.new_owner = new_owner;
-    
-    int rc = network_send(manager, &msg);
+    msg.payload.rma_reply.op_id = op_id;
+    msg.payload.rma_reply.requester = requester;
+    msg.payload.rma_reply.op = (uint8_t)op;
+    msg.payload.rma_reply.num_results = (uint16_t)num_results;
+    memcpy(msg.payload.rma_reply.results, results, (size_t)num_results * sizeof(*results));
+
+    size_t data_len = iov_total(data, num_data);
+    int rc = network_send_bulk(route_direct(requester), &msg, data, num_data);
     if (rc == DSM_SUCCESS) {
-        track_bytes_sent(MSG_OWNER_UPDATE);
+        STATS_ADD(network_bytes_sent, 4 + sizeof(msg_header_t) + message_wire_payload_size(&msg) + data_len);
+    } else {
+        LOG_ERROR("Failed to send RMA_REPLY %lu to node %u (rc=%d)", op_id, requester, rc);
     }
     return rc;
 }
 
-int handle_dir_query(const message_t *msg) {
-    /* Track received bytes */
-    track_bytes_received(MSG_DIR_QUERY);
-
-    page_id_t page_id = msg->payload.dir_query.page_id;
-    node_id_t requester = msg->payload.dir_query.requester;
-
-    LOG_INFO("Received DIR_QUERY for page %lu from node %u", page_id, requester);
-
-    page_directory_t *dir = get_page_directory();
-    node_id_t owner = 0;
-
-    if (dir) {
-        int rc = directory_lookup(dir, page_id, &owner);
-        LOG_INFO("Directory lookup for page %lu: owner=%u (rc=%d)", page_id, owner, rc);
-    } else {
-        LOG_WARN("No directory available for lookup");
+/**
+ * Answer segments of a request that are not served here with one status
+ */
+static int reply_rma_status(const rma_request_payload_t *req, const rma_segment_t *segments,
+                            int num_segments, rma_status_t status) {
+    rma_result_t results[RMA_MAX_SEGMENTS];
+    for (int i = 0; i < num_segments; i++) {
+        results[i].index = segments[i].index;
+        results[i].status = (uint8_t)status;
     }
-
-    LOG_INFO("Sending DIR_REPLY to node %u: page %lu owned by node %u", requester, page_id, owner);
-    return send_dir_reply(requester, page_id, owner);
+    return send_rma_reply(req->requester, req->op_id, (rma_op_t)req->op, results, num_segments, NULL, 0);
 }
 
-int handle_dir_reply(const message_t *msg) {
-    /* Track received bytes */
-    track_bytes_received(MSG_DIR_REPLY);
-
-    page_id_t page_id = msg->payload.dir_reply.page_id;
-    node_id_t owner = msg->payload.dir_reply.owner;
-
-    LOG_INFO("Received DIR_REPLY for page %lu: owner=node %u", page_id, owner);
-
+/**
+ * Hand segments of a request on to the node holding them
+ *
+ * @param target Node that serves the segments
+ * @param data A put's bytes of these segments, in segment order
+ */
+static int forward_rma_request(const message_t *msg, node_id_t target, const rma_segment_t *segments,
+                               int num_segments, const struct iovec *data, int num_data) {
     dsm_context_t *ctx = dsm_get_context();
-    pthread_mutex_lock(&ctx->network.dir_tracker.lock);
-    
-    if (ctx->network.dir_tracker.active && 
-        ctx->network.dir_tracker.page_id == page_id) {
-        ctx->network.dir_tracker.owner = owner;
-        ctx->network.dir_tracker.complete = true;
-        pthread_cond_signal(&ctx->network.dir_tracker.cv);
+    message_t fwd;
+    fwd.header = msg->header;
+    fwd.header.sender = ctx->node_id;
+    memcpy(&fwd.payload.rma_request, &msg->payload.rma_request, offsetof(rma_request_payload_t, segments));
+    fwd.payload.rma_request.target = target;
+    fwd.payload.rma_request.num_segments = (uint16_t)num_segments;
+    memcpy(fwd.payload.rma_request.segments, segments, (size_t)num_segments * sizeof(*segments));
+
+    LOG_DEBUG("Manager forwarding RMA_REQUEST %lu (%d segments) from node %u to node %u",
+              fwd.payload.rma_request.op_id, num_segments, fwd.payload.rma_request.requester, target);
+    int rc = network_send_bulk(target, &fwd, data, num_data);
+    if (rc != DSM_SUCCESS) {
+        LOG_ERROR("Failed to forward RMA_REQUEST to node %u (rc=%d)", target, rc);
     }
-    
-    pthread_mutex_unlock(&ctx->network.dir_tracker.lock);
-    return DSM_SUCCESS;
+    return rc;
 }
 
-int handle_owner_update(const message_t *msg) {
-    /* Track received bytes */
-    track_bytes_received(MSG_OWNER_UPDATE);
-
-    page_id_t page_id = msg->payload.owner_update.page_id;
-    node_id_t new_owner = msg->payload.owner_update.new_owner;
-    
+/**
+ * Send each segment of an unaddressed request to the owner the directory
+ * records, one request per owner; segments the manager owns are served here
+ */
+static int route_rma_request(const message_t *msg, const uint8_t *data) {
+    dsm_context_t *ctx = dsm_get_context();
+    const rma_request_payload_t *req = &msg->payload.rma_request;
+    int num_segments = req->num_segments;
     page_directory_t *dir = get_page_directory();
-    if (dir) {
-        directory_set_owner(dir, page_id, new_owner);
-        LOG_DEBUG("Updated directory (via MSG): page %lu now owned by node %u", page_id, new_owner);
+
+    node_id_t owners[RMA_MAX_SEGMENTS];
+    size_t offsets[RMA_MAX_SEGMENTS];
+    bool routed[RMA_MAX_SEGMENTS];
+    rma_segment_t group[RMA_MAX_SEGMENTS];
+    struct iovec iov[RMA_MAX_SEGMENTS];
+    int num_group = 0;
+
+    size_t offset = 0;
+    for (int i = 0; i < num_segments; i++) {
+        offsets[i] = offset;
+        offset += rma_request_data_len(req->op, &req->segments[i]);
+        routed[i] = !dir || directory_lookup(dir, req->segments[i].page_id, &owners[i]) != DSM_SUCCESS ||
+                    owners[i] >= (node_id_t)ctx->network.max_nodes;
+        if (routed[i]) {
+            LOG_WARN("RMA_REQUEST %lu from node %u for page %lu without an owner",
+                     req->op_id, req->requester, req->segments[i].page_id);
+            group[num_group++] = req->segments[i];
+        }
+    }
+    if (num_group > 0) {
+        reply_rma_status(req, group, num_group, RMA_FAILED);
     }
-    return DSM_SUCCESS;
-}
 
-int broadcast_node_failure(node_id_t failed_node) {
-    dsm_context_t *ctx = dsm_get_context();
-    
-    /* Broadcast to all connected nodes */
-    for (int i = 0; i < MAX_NODES; i++) {
-        pthread_mutex_lock(&ctx->lock);
-        bool connected = ctx->network.nodes[i].connected;
-        node_id_t node_id = ctx->network.nodes[i].id;
-        pthread_mutex_unlock(&ctx->lock);
+    for (int i = 0; i < num_segments; i++) {
+        if (routed[i]) {
+            continue;
+        }
 
-        /* Don't send to self or the failed node */
-        if (connected && node_id != ctx->node_id && node_id != failed_node) {
-            
-            message_t msg;
-            memset(&msg, 0, sizeof(msg));
-            msg.header.magic = MSG_MAGIC;
-            msg.header.type = MSG_NODE_FAILED;
-            msg.header.sender = ctx->node_id;
-            msg.payload.node_failed.failed_node = failed_node;
-            
-            LOG_INFO("Broadcasting NODE_FAILED for node %u to node %u", 
-                     failed_node, node_id);
-            network_send(node_id, &msg);
+        node_id_t owner = owners[i];
+        num_group = 0;
+        for (int j = i; j < num_segments; j++) {
+            if (routed[j] || owners[j] != owner) {
+                continue;
+            }
+            group[num_group] = req->segments[j];
+            if (req->op != RMA_GET) {
+                iov[num_group].iov_base = (void*)(data + offsets[j]);
+                iov[num_group].iov_len = rma_request_data_len(req->op, &req->segments[j]);
+            }
+            num_group++;
+            routed[j] = true;
+        }
+        int num_iov = req->op != RMA_GET ? num_group : 0;
+
+        if (owner == ctx->node_id) {
+            message_t local;
+            local.header = msg->header;
+            memcpy(&local.payload.rma_request, req, offsetof(rma_request_payload_t, segments));
+            local.payload.rma_request.target = owner;
+            local.payload.rma_request.num_segments = (uint16_t)num_group;
+            memcpy(local.payload.rma_request.segments, group, (size_t)num_group * sizeof(*group));
+            if (num_iov == 1 && rma_serve_inline(&local, iov[0].iov_base, iov[0].iov_len) == DSM_SUCCESS) {
+                continue;
+            }
+            if (rma_serve(&local, iov, num_iov) != DSM_SUCCESS) {
+                reply_rma_status(req, group, num_group, RMA_FAILED);
+            }
+        } else if (forward_rma_request(msg, owner, group, num_group, iov, num_iov) != DSM_SUCCESS) {
+            reply_rma_status(req, group, num_group, RMA_MOVED);
         }
     }
     return DSM_SUCCESS;
 }
 
-int handle_node_failed_msg(const message_t *msg) {
-    /* Track received bytes */
-    track_bytes_received(MSG_NODE_FAILED);
+int handle_rma_request(const message_t *msg, const uint8_t *data, size_t data_len) {
+    STATS_ADD(network_bytes_received, 4 + sizeof(msg_header_t) + message_wire_payload_size(msg) + data_len);
 
-    node_id_t failed_node = msg->payload.node_failed.failed_node;
     dsm_context_t *ctx = dsm_get_context();
-
-    pthread_mutex_lock(&ctx->lock);
-    if (failed_node < MAX_NODES && !ctx->network.nodes[failed_node].is_failed) {
-         ctx->network.nodes[failed_node].is_failed = true;
-         LOG_WARN("Marked node %u as FAILED via notification", failed_node);
+    const rma_request_payload_t *req = &msg->payload.rma_request;
+    int num_segments = req->num_segments <= RMA_MAX_SEGMENTS ? req->num_segments : RMA_MAX_SEGMENTS;
+    if (num_segments == 0) {
+        return DSM_SUCCESS;
     }
-    pthread_mutex_unlock(&ctx->lock);
 
-    page_directory_t *dir = get_page_directory();
-    if (dir) {
-        directory_handle_node_failure(dir, failed_node);
+    size_t expected = 0;
+    for (int i = 0; i < num_segments; i++) {
+        expected += rma_request_data_len(req->op, &req->segments[i]);
     }
-
-    return DSM_SUCCESS;
-}
-
-/* CRITICAL FIX (BUG #8): Sharer tracking protocol */
-int send_sharer_query(node_id_t owner, page_id_t page_id) {
-    dsm_context_t *ctx = dsm_get_context();
-    message_t msg;
-    memset(&msg, 0, sizeof(msg));
-    msg.header.magic = MSG_MAGIC;
-    msg.header.type = MSG_SHARER_QUERY;
-    msg.header.sender = ctx->node_id;
-    msg.payload.sharer_query.page_id = page_id;
-    msg.payload.sharer_query.requester = ctx->node_id;
-
-    LOG_DEBUG("Querying node %u for sharers of page %lu", owner, page_id);
-    int rc = network_send(owner, &msg);
-    if (rc == DSM_SUCCESS) {
-        track_bytes_sent(MSG_SHARER_QUERY);
+    if (req->op > RMA_SWAP || expected != data_len) {
+        LOG_ERROR("Malformed RMA_REQUEST %lu from node %u (op %u, %zu data bytes, %zu expected)",
+                  req->op_id, msg->header.sender, req->op, data_len, expected);
+        return reply_rma_status(req, req->segments, num_segments, RMA_FAILED);
     }
-    return rc;
-}
-
-int handle_sharer_query(const message_t *msg) {
-    /* Track received bytes */
-    track_bytes_received(MSG_SHARER_QUERY);
 
-    page_id_t page_id = msg->payload.sharer_query.page_id;
-    node_id_t requester = msg->payload.sharer_query.requester;
-
-    LOG_DEBUG("Received SHARER_QUERY for page %lu from node %u", page_id, requester);
-
-    /* Look up sharers in local directory */
-    page_directory_t *dir = get_page_directory();
-    node_id_t sharers[MAX_SHARERS];
-    int num_sharers = 0;
+    struct iovec iov = { .iov_base = (void*)data, .iov_len = data_len };
+    int num_iov = data_len > 0 ? 1 : 0;
 
-    if (dir) {
-        directory_get_sharers(dir, page_id, sharers, &num_sharers);
+    if (req->target == ctx->node_id) {
+        /* Atomics on a writable page are applied right here */
+        if (rma_serve_inline(msg, data, data_len) == DSM_SUCCESS) {
+            return DSM_SUCCESS;
+        }
+        LOG_DEBUG("Queueing RMA_REQUEST %lu (%d segments) from node %u",
+                  req->op_id, num_segments, req->requester);
+        if (rma_serve(msg, &iov, num_iov) != DSM_SUCCESS) {
+            return reply_rma_status(req, req->segments, num_segments, RMA_FAILED);
+        }
+        return DSM_SUCCESS;
     }
 
-    /* Send reply with sharer list */
-    dsm_context_t *ctx = dsm_get_context();
-    message_t reply;
-    memset(&reply, 0, sizeof(reply));
-    reply.header.magic = MSG_MAGIC;
-    reply.header.type = MSG_SHARER_REPLY;
-    reply.header.sender = ctx->node_id;
-    reply.payload.sharer_reply.page_id = page_id;
-    reply.payload.sharer_reply.num_sharers = num_sharers;
-    for (int i = 0; i < num_sharers && i < MAX_SHARERS; i++) {
-        reply.payload.sharer_reply.sharers[i] = sharers[i];
+    /* Manager routes requests between workers (star topology) */
+    if (!ctx->config.is_manager) {
+        LOG_WARN("RMA_REQUEST %lu from node %u addressed to node %u", req->op_id,
+                 msg->header.sender, req->target);
+        return reply_rma_status(req, req->segments, num_segments, RMA_FAILED);
     }
-
-    LOG_DEBUG("Sending SHARER_REPLY to node %u: page %lu has %d sharers",
-             requester, page_id, num_sharers);
-    int rc = network_send(requester, &reply);
-    if (rc == DSM_SUCCESS) {
-        track_bytes_sent(MSG_SHARER_REPLY);
+    if (req->target == DSM_NODE_NONE) {
+        return route_rma_request(msg, data);
     }
-    return rc;
+    if (req->target >= (node_id_t)ctx->network.max_nodes) {
+        return reply_rma_status(req, req->segments, num_segments, RMA_FAILED);
+    }
+    if (forward_rma_request(msg, req->target, req->segments, num_segments, &iov, num_iov) != DSM_SUCCESS) {
+        return reply_rma_status(req, req->segments, num_segments, RMA_MOVED);
+    }
+    return DSM_SUCCESS;
 }
 
-int handle_sharer_reply(const message_t *msg) {
-    /* Track received bytes */
-    track_bytes_received(MSG_SHARER_REPLY);
-
-    page_id_t page_id = msg->payload.sharer_reply.page_id;
-    int num_sharers = msg->payload.sharer_reply.num_sharers;
-
-    LOG_DEBUG("Received SHARER_REPLY for page %lu: %d sharers", page_id, num_sharers);
+int handle_rma_reply(const message_t *msg, const uint8_t *data, size_t data_len) {
+    STATS_ADD(network_bytes_received, 4 + sizeof(msg_header_t) + message_wire_payload_size(msg) + data_len);
 
-    /* Store in context for fetch_page_write to retrieve */
     dsm_context_t *ctx = dsm_get_context();
-    pthread_mutex_lock(&ctx->network.sharer_tracker.lock);
+    const rma_reply_payload_t *reply = &msg->payload.rma_reply;
+
+    /* Manager forwards the whole frame between workers (star topology) */
+    if (reply->requester != ctx->node_id) {
+        if (!ctx->config.is_manager || reply->requester == msg->header.sender ||
+            reply->requester >= (node_id_t)ctx->network.max_nodes) {
+            LOG_WARN("Dropping RMA_REPLY %lu for node %u from node %u",
+                     reply->op_id, reply->requester, msg->header.sender);
+            return DSM_ERROR_INVALID;
+        }
 
-    if (ctx->network.sharer_tracker.active &&
-        ctx->network.sharer_tracker.page_id == page_id) {
-        ctx->network.sharer_tracker.num_sharers = num_sharers;
-        for (int i = 0; i < num_sharers && i < MAX_SHARERS; i++) {
-            ctx->network.sharer_tracker.sharers[i] = msg->payload.sharer_reply.sharers[i];
+        message_t fwd;
+        memcpy(&fwd.header, &msg->header, sizeof(msg_header_t));
+        memcpy(&fwd.payload, &msg->payload, message_wire_payload_size(msg));
+        fwd.header.sender = ctx->node_id;
+
+        struct iovec iov = { .iov_base = (void*)data, .iov_len = data_len };
+        int rc = network_send_bulk(reply->requester, &fwd, &iov, data_len > 0 ? 1 : 0);
+        if (rc != DSM_SUCCESS) {
+            LOG_ERROR("Failed to forward RMA_REPLY to node %u (rc=%d)", reply->requester, rc);
         }
-        ctx->network.sharer_tracker.complete = true;
-        pthread_cond_signal(&ctx->network.sharer_tracker.cv);
-        LOG_DEBUG("Stored sharer list for page %lu in tracker", page_id);
+        return rc;
     }
 
-    pthread_mutex_unlock(&ctx->network.sharer_tracker.lock);
-    return DSM_SUCCESS;
+    return rma_complete(msg, data, data_len);
 }
 
 /* Dispatcher */
@@ -1819,21 +4393,35 @@ int dispatch_message(const message_t *msg, int sockfd) {
             return handle_lock_grant(msg);
         case MSG_LOCK_RELEASE:
             return handle_lock_release(msg);
+        case MSG_LOCK_RECALL:
+            return handle_lock_recall(msg);
         case MSG_BARRIER_ARRIVE:
-            return handle_barrier_arrive(msg);
+            return handle_barrier_arrive(msg, NULL, 0);
         case MSG_BARRIER_RELEASE:
-            return handle_barrier_release(msg);
+            return handle_barrier_release(msg, NULL, 0);
+        case MSG_BARRIER_SIGNAL:
+            return handle_barrier_signal(msg);
         case MSG_ALLOC_NOTIFY:
             return handle_alloc_notify(msg);
         case MSG_ALLOC_ACK:
             return handle_alloc_ack(msg);
         case MSG_NODE_JOIN:
             return handle_node_join(msg, sockfd);
+        case MSG_NODE_ROSTER:
+            return handle_node_roster(msg, NULL, 0);
+        case MSG_PEER_HELLO:
+            return handle_peer_hello(msg, sockfd);
         case MSG_HEARTBEAT:
             return handle_heartbeat(msg);
         case MSG_HEARTBEAT_ACK:
             /* Optional, currently unused */
             return DSM_SUCCESS;
+        case MSG_PROBE_REQUEST:
+            return handle_probe_request(msg);
+        case MSG_PROBE:
+            return handle_probe(msg);
+        case MSG_PROBE_ACK:
+            return handle_probe_ack(msg);
         case MSG_DIR_QUERY:
             return handle_dir_query(msg);
         case MSG_DIR_REPLY:
@@ -1846,20 +4434,48 @@ int dispatch_message(const message_t *msg, int sockfd) {
             return handle_sharer_query(msg);
         case MSG_SHARER_REPLY:
             return handle_sharer_reply(msg);
+        case MSG_INVALIDATE_FANOUT:
+            return handle_invalidate_fanout(msg);
+        case MSG_PAGE_UPGRADE:
+            return handle_page_upgrade(msg);
+        case MSG_TRANSPORT_CONNECT:
+            return handle_transport_connect(msg);
+        case MSG_TCP_LANE:
+            return handle_tcp_lane(msg, sockfd);
         case MSG_NODE_LEAVE:
             LOG_INFO("Received NODE_LEAVE from node %u", msg->header.sender);
             return DSM_SUCCESS;
-        /* Hot backup failover messages */
+        /* Hot backup failover messages (batched records come first) */
         case MSG_STATE_SYNC_DIR:
+            replication_snapshot();
             return handle_state_sync_dir(msg);
         case MSG_STATE_SYNC_LOCK:
+            replication_snapshot();
             return handle_state_sync_lock(msg);
         case MSG_STATE_SYNC_BARRIER:
+            replication_snapshot();
             return handle_state_sync_barrier(msg);
+        case MSG_STATE_SYNC_BATCH:
+            return handle_state_sync_batch(msg, NULL, 0);
         case MSG_MANAGER_PROMOTION:
             return handle_manager_promotion(msg);
         case MSG_RECONNECT_REQUEST:
             return handle_reconnect_request(msg);
+        case MSG_PAGE_DIFF:
+            return handle_page_diff(msg);
+        case MSG_PAGE_DIFF_ACK:
+            return handle_page_diff_ack(msg);
+        case MSG_PAGE_BATCH_REQUEST:
+            return handle_page_batch_request(msg);
+        case MSG_PAGE_BATCH_REPLY:
+            /* Bulk frames are handed to dispatch_bulk_message() with their data */
+            LOG_WARN("PAGE_BATCH_REPLY from node %u dispatched without its data", msg->header.sender);
+            return DSM_ERROR_INVALID;
+        /* Gets and bare replies carry no bulk data */
+        case MSG_RMA_REQUEST:
+            return handle_rma_request(msg, NULL, 0);
+        case MSG_RMA_REPLY:
+            return handle_rma_reply(msg, NULL, 0);
         case MSG_ERROR:
             {
                 int error_code = msg->payload.error.error_code;
@@ -1874,24 +4490,24 @@ int dispatch_message(const message_t *msg, int sockfd) {
                 /* Find relevant table */
                 page_entry_t *entry = NULL;
                 pthread_mutex_lock(&ctx->lock);
-                for (int i = 0; i < ctx->num_allocations; i++) {
-                    if (ctx->page_tables[i]) {
-                        entry = page_table_lookup_by_id(ctx->page_tables[i], page_id);
-                        if (entry) break;
-                    }
-                }
+                entry = page_index_lookup_id(page_id, NULL);
                 pthread_mutex_unlock(&ctx->lock);
                 
                 if (entry) {
-                    pthread_mutex_lock(&entry->entry_lock);
+                    pthread_mutex_lock(page_entry_lock(entry));
                     if (entry->request_pending) {
                         /* Propagate error code so fetch_page can retry */
                         entry->fetch_result = error_code;
                         entry->request_pending = false;
-                        pthread_cond_broadcast(&entry->ready_cv);
+                        pthread_cond_broadcast(page_entry_ready_cv(entry));
                         LOG_DEBUG("Woke waiter for page %lu due to error", page_id);
                     }
-                    pthread_mutex_unlock(&entry->entry_lock);
+                    if (entry->prefetch_pending) {
+                        /* Faults waiting on the prefetch fetch the page themselves */
+                        entry->prefetch_pending = false;
+                        pthread_cond_broadcast(page_entry_ready_cv(entry));
+                    }
+                    pthread_mutex_unlock(page_entry_lock(entry));
                 }
                 return DSM_SUCCESS;
             }
@@ -1901,29 +4517,45 @@ int dispatch_message(const message_t *msg, int sockfd) {
     }
 }
 
+int dispatch_bulk_message(const message_t *msg, const uint8_t *data, size_t data_len) {
+    switch (msg->header.type) {
+        case MSG_PAGE_REPLY:
+            return handle_page_reply_data(msg, data, data_len);
+        case MSG_PAGE_BATCH_REPLY:
+            return handle_page_batch_reply(msg, data, data_len);
+        case MSG_STATE_SYNC_BATCH:
+            return handle_state_sync_batch(msg, data, data_len);
+        case MSG_RMA_REQUEST:
+            return handle_rma_request(msg, data, data_len);
+        case MSG_RMA_REPLY:
+            return handle_rma_reply(msg, data, data_len);
+        case MSG_BARRIER_ARRIVE:
+            return handle_barrier_arrive(msg, data, data_len);
+        case MSG_BARRIER_RELEASE:
+            return handle_barrier_release(msg, data, data_len);
+        case MSG_NODE_ROSTER:
+            return handle_node_roster(msg, data, data_len);
+        default:
+            LOG_WARN("Unexpected bulk frame of message type %d", msg->header.type);
+            return DSM_ERROR_INVALID;
+    }
+}
+
 /* ============================================================================
  * HOT BACKUP FAILOVER - REPLICATION FUNCTIONS
  * ============================================================================ */
 
 /**
- * Get next sync sequence number
- */
-static uint64_t get_next_sync_seq(void) {
-    dsm_context_t *ctx = dsm_get_context();
-    pthread_mutex_lock(&ctx->network.seq_lock);
-    uint64_t seq = ctx->network.next_seq_num++;
-    pthread_mutex_unlock(&ctx->network.seq_lock);
-    return seq;
-}
-
-/**
- * Send directory state sync to primary backup (Node 1)
+ * Record a directory change for the primary backup (Node 1)
+ * Appended to the replication log; sync_seq is assigned there.
  */
 int send_state_sync_dir(page_id_t page_id, node_id_t owner, const node_id_t *sharers, int num_sharers) {
     dsm_context_t *ctx = dsm_get_context();
 
-    /* Only manager replicates, and only if not promoted backup */
-    if (!ctx->config.is_manager || ctx->network.backup_state.is_promoted) {
+    /* Only manager replicates, and only if not promoted backup. With the
+     * distributed directory the manager's entries are not the ones in use */
+    if (!ctx->config.is_manager || ctx->network.backup_state.is_promoted ||
+        directory_distributed()) {
         return DSM_SUCCESS;  /* Silently skip */
     }
 
@@ -1938,7 +4570,6 @@ int send_state_sync_dir(page_id_t page_id, node_id_t owner, const node_id_t *sha
     msg.header.type = MSG_STATE_SYNC_DIR;
     msg.header.sender = ctx->node_id;
 
-    msg.payload.state_sync_dir.sync_seq = get_next_sync_seq();
     msg.payload.state_sync_dir.page_id = page_id;
     msg.payload.state_sync_dir.owner = owner;
     msg.payload.state_sync_dir.num_sharers = num_sharers < MAX_SHARERS ? num_sharers : MAX_SHARERS;
@@ -1947,18 +4578,14 @@ int send_state_sync_dir(page_id_t page_id, node_id_t owner, const node_id_t *sha
         msg.payload.state_sync_dir.sharers[i] = sharers[i];
     }
 
-    /* Async send to Node 1 (primary backup) */
-    int rc = network_send(1, &msg);
-    if (rc == DSM_SUCCESS) {
-        track_bytes_sent(MSG_STATE_SYNC_DIR);
-    }
-    return rc;
+    return replication_append(&msg);
 }
 
 /**
- * Send lock state sync to primary backup (Node 1)
+ * Record a lock change for the primary backup (Node 1)
  */
-int send_state_sync_lock(lock_id_t lock_id, node_id_t holder, const node_id_t *waiters, int num_waiters) {
+int send_state_sync_lock(lock_id_t lock_id, node_id_t holder, const node_id_t *readers, int num_readers,
+                         const node_id_t *waiters, int num_waiters) {
     dsm_context_t *ctx = dsm_get_context();
 
     /* Only manager replicates, and only if not promoted backup */
@@ -1977,24 +4604,27 @@ int send_state_sync_lock(lock_id_t lock_id, node_id_t holder, const node_id_t *w
     msg.header.type = MSG_STATE_SYNC_LOCK;
     msg.header.sender = ctx->node_id;
 
-    msg.payload.state_sync_lock.sync_seq = get_next_sync_seq();
     msg.payload.state_sync_lock.lock_id = lock_id;
     msg.payload.state_sync_lock.holder = holder;
-    msg.payload.state_sync_lock.num_waiters = num_waiters < 32 ? num_waiters : 32;
 
-    for (int i = 0; i < msg.payload.state_sync_lock.num_waiters; i++) {
-        msg.payload.state_sync_lock.waiters[i] = waiters[i];
-    }
+    /* Readers first; the queue gets what room is left */
+    if (num_readers > MAX_SHARERS) num_readers = MAX_SHARERS;
+    if (num_waiters > MAX_SHARERS - num_readers) num_waiters = MAX_SHARERS - num_readers;
+    msg.payload.state_sync_lock.num_readers = num_readers;
+    msg.payload.state_sync_lock.num_waiters = num_waiters;
 
-    int rc = network_send(1, &msg);
-    if (rc == DSM_SUCCESS) {
-        track_bytes_sent(MSG_STATE_SYNC_LOCK);
+    for (int i = 0; i < num_readers; i++) {
+        msg.payload.state_sync_lock.waiters[i] = readers[i];
     }
-    return rc;
+    for (int i = 0; i < num_waiters; i++) {
+        msg.payload.state_sync_lock.waiters[num_readers + i] = waiters[i];
+    }
+
+    return replication_append(&msg);
 }
 
 /**
- * Send barrier state sync to primary backup (Node 1)
+ * Record a barrier change for the primary backup (Node 1)
  */
 int send_state_sync_barrier(barrier_id_t barrier_id, int num_arrived, int num_expected, uint64_t generation) {
     dsm_context_t *ctx = dsm_get_context();
@@ -2015,17 +4645,12 @@ int send_state_sync_barrier(barrier_id_t barrier_id, int num_arrived, int num_ex
     msg.header.type = MSG_STATE_SYNC_BARRIER;
     msg.header.sender = ctx->node_id;
 
-    msg.payload.state_sync_barrier.sync_seq = get_next_sync_seq();
     msg.payload.state_sync_barrier.barrier_id = barrier_id;
     msg.payload.state_sync_barrier.num_arrived = num_arrived;
     msg.payload.state_sync_barrier.num_expected = num_expected;
     msg.payload.state_sync_barrier.generation = generation;
 
-    int rc = network_send(1, &msg);
-    if (rc == DSM_SUCCESS) {
-        track_bytes_sent(MSG_STATE_SYNC_BARRIER);
-    }
-    return rc;
+    return replication_append(&msg);
 }
 
 /**
@@ -2049,7 +4674,7 @@ int send_manager_promotion(node_id_t new_manager_id, node_id_t old_manager_id) {
 
     /* Broadcast to all connected nodes */
     int broadcast_count = 0;
-    for (int i = 0; i < MAX_NODES; i++) {
+    for (int i = 0; i < ctx->network.max_nodes; i++) {
         if (i != ctx->node_id && ctx->network.nodes[i].connected) {
             network_send(i, &msg);
             broadcast_count++;
@@ -2174,9 +4799,17 @@ int handle_state_sync_lock(const message_t *msg) {
 
     lock_id_t lock_id = msg->payload.state_sync_lock.lock_id;
     node_id_t holder = msg->payload.state_sync_lock.holder;
+    int num_readers = msg->payload.state_sync_lock.num_readers;
     int num_waiters = msg->payload.state_sync_lock.num_waiters;
     uint64_t sync_seq = msg->payload.state_sync_lock.sync_seq;
 
+    if (num_readers < 0 || num_waiters < 0 || num_readers > MAX_SHARERS ||
+        num_waiters > MAX_SHARERS - num_readers) {
+        LOG_WARN("Malformed STATE_SYNC_LOCK for lock %lu (%d readers, %d waiters)",
+                 lock_id, num_readers, num_waiters);
+        return DSM_ERROR_INVALID;
+    }
+
     /* Check sequence number */
     if (sync_seq <= ctx->network.backup_state.last_sync_seq) {
         LOG_DEBUG("Ignoring out-of-order STATE_SYNC_LOCK: seq=%lu, last=%lu",
@@ -2187,7 +4820,7 @@ int handle_state_sync_lock(const message_t *msg) {
 
     /* Find or create shadow lock slot */
     int slot = -1;
-    for (int i = 0; i < 256; i++) {
+    for (int i = 0; i < ctx->network.backup_state.backup_locks_capacity; i++) {
         if (ctx->network.backup_state.backup_locks[i] == NULL) {
             if (slot == -1) slot = i;  /* First empty slot */
             continue;
@@ -2202,8 +4835,12 @@ int handle_state_sync_lock(const message_t *msg) {
 
     struct dsm_lock_s *shadow_lock;
     if (slot == -1) {
-        LOG_ERROR("Shadow lock array full (max 256 locks)");
-        return DSM_ERROR_MEMORY;
+        slot = ctx->network.backup_state.backup_locks_capacity;
+        if (dsm_table_grow(&ctx->network.backup_state.backup_locks,
+                           &ctx->network.backup_state.backup_locks_capacity) != DSM_SUCCESS) {
+            LOG_ERROR("Failed to grow shadow lock table (%d locks)", slot);
+            return DSM_ERROR_MEMORY;
+        }
     }
 
     if (ctx->network.backup_state.backup_locks[slot] == NULL) {
@@ -2235,23 +4872,51 @@ int handle_state_sync_lock(const message_t *msg) {
     shadow_lock->waiters_head = NULL;
     shadow_lock->waiters_tail = NULL;
 
+    waiter = shadow_lock->readers_head;
+    while (waiter) {
+        lock_waiter_t *next = waiter->next;
+        free(waiter);
+        waiter = next;
+    }
+    shadow_lock->readers_head = NULL;
+    shadow_lock->num_readers = 0;
+
     /* Set holder and state */
     shadow_lock->holder = holder;
-    if (holder == (node_id_t)-1) {
-        shadow_lock->state = LOCK_STATE_FREE;
-    } else {
+    if (holder != (node_id_t)-1) {
         shadow_lock->state = LOCK_STATE_HELD;
+    } else if (num_readers > 0) {
+        shadow_lock->state = LOCK_STATE_SHARED;
+    } else {
+        shadow_lock->state = LOCK_STATE_FREE;
+    }
+
+    /* Rebuild the shared holders */
+    for (int i = 0; i < num_readers; i++) {
+        lock_waiter_t *reader = (lock_waiter_t*)malloc(sizeof(lock_waiter_t));
+        if (!reader) {
+            LOG_ERROR("Failed to allocate reader in shadow lock");
+            pthread_mutex_unlock(&shadow_lock->local_lock);
+            return DSM_ERROR_MEMORY;
+        }
+        reader->node_id = msg->payload.state_sync_lock.waiters[i];
+        reader->mode = LOCK_MODE_SHARED;
+        reader->next = shadow_lock->readers_head;
+        shadow_lock->readers_head = reader;
+        shadow_lock->num_readers++;
     }
 
     /* Rebuild waiter queue */
-    for (int i = 0; i < num_waiters && i < 32; i++) {
+    for (int i = 0; i < num_waiters; i++) {
         lock_waiter_t *new_waiter = (lock_waiter_t*)malloc(sizeof(lock_waiter_t));
         if (!new_waiter) {
             LOG_ERROR("Failed to allocate waiter in shadow lock");
             pthread_mutex_unlock(&shadow_lock->local_lock);
             return DSM_ERROR_MEMORY;
         }
-        new_waiter->node_id = msg->payload.state_sync_lock.waiters[i];
+        node_id_t entry = msg->payload.state_sync_lock.waiters[num_readers + i];
+        new_waiter->node_id = entry & ~LOCK_SYNC_SHARED_WAITER;
+        new_waiter->mode = (entry & LOCK_SYNC_SHARED_WAITER) ? LOCK_MODE_SHARED : LOCK_MODE_EXCLUSIVE;
         new_waiter->next = NULL;
 
         if (shadow_lock->waiters_tail) {
@@ -2264,8 +4929,8 @@ int handle_state_sync_lock(const message_t *msg) {
 
     pthread_mutex_unlock(&shadow_lock->local_lock);
 
-    LOG_DEBUG("Updated shadow lock: id=%lu, holder=%u, waiters=%d (seq=%lu)",
-              lock_id, holder, num_waiters, sync_seq);
+    LOG_DEBUG("Updated shadow lock: id=%lu, holder=%u, readers=%d, waiters=%d (seq=%lu)",
+              lock_id, holder, num_readers, num_waiters, sync_seq);
 
     return DSM_SUCCESS;
 }
@@ -2299,7 +4964,7 @@ int handle_state_sync_barrier(const message_t *msg) {
 
     /* Find or create shadow barrier slot */
     int slot = -1;
-    for (int i = 0; i < 256; i++) {
+    for (int i = 0; i < ctx->network.backup_state.backup_barriers_capacity; i++) {
         if (ctx->network.backup_state.backup_barriers[i] == NULL) {
             if (slot == -1) slot = i;  /* First empty slot */
             continue;
@@ -2314,8 +4979,12 @@ int handle_state_sync_barrier(const message_t *msg) {
 
     dsm_barrier_t *shadow_barrier;
     if (slot == -1) {
-        LOG_ERROR("Shadow barrier array full (max 256 barriers)");
-        return DSM_ERROR_MEMORY;
+        slot = ctx->network.backup_state.backup_barriers_capacity;
+        if (dsm_table_grow(&ctx->network.backup_state.backup_barriers,
+                           &ctx->network.backup_state.backup_barriers_capacity) != DSM_SUCCESS) {
+            LOG_ERROR("Failed to grow shadow barrier table (%d barriers)", slot);
+            return DSM_ERROR_MEMORY;
+        }
     }
 
     if (ctx->network.backup_state.backup_barriers[slot] == NULL) {
@@ -2366,15 +5035,23 @@ int handle_manager_promotion(const message_t *msg) {
         return DSM_SUCCESS;
     }
 
-    /* Update current manager reference */
+    /* Update current manager reference and wake faulting threads waiting
+     * for it (wait_for_manager_reconnection()) */
+    pthread_mutex_lock(&ctx->lock);
     ctx->network.backup_state.current_manager = new_manager;
 
     /* Mark old manager as failed if not already */
-    if (old_manager < MAX_NODES && !ctx->network.nodes[old_manager].is_failed) {
+    if (old_manager < (node_id_t)ctx->network.max_nodes && !ctx->network.nodes[old_manager].is_failed) {
         LOG_INFO("Marking old manager (Node %u) as failed", old_manager);
         ctx->network.nodes[old_manager].is_failed = true;
         ctx->network.nodes[old_manager].connected = false;
     }
+    pthread_cond_broadcast(&ctx->network.backup_state.manager_cv);
+    pthread_mutex_unlock(&ctx->lock);
+
+    /* Queries still waiting on the old manager will never be answered */
+    pending_query_abort_all(&ctx->network.dir_queries);
+    pending_query_abort_all(&ctx->network.sharer_queries);
 
     /*
      * In star topology, workers send directory queries and page requests to manager.
@@ -2457,6 +5134,11 @@ int promote_to_manager(void) {
 
     LOG_INFO("=== PROMOTING NODE %u TO MANAGER ===", ctx->node_id);
 
+    /* Step 0: Replay the log tail received since the last snapshot
+     * (at most REPLICATION_SNAPSHOT_BYTES of records) */
+    int replayed = replication_snapshot();
+    LOG_INFO("Replayed %d replication records into the shadow tables", replayed);
+
     /* Step 1: Mark as promoted */
     ctx->network.backup_state.is_promoted = true;
     ctx->config.is_manager = true;  /* Update config to reflect new role */
@@ -2483,22 +5165,28 @@ int promote_to_manager(void) {
 
     /* Step 3: Activate shadow locks as primary */
     pthread_mutex_lock(&ctx->lock_mgr.lock);
-    for (int i = 0; i < 256; i++) {
-        if (ctx->network.backup_state.backup_locks[i] != NULL) {
-            /* Find empty slot in primary lock manager or replace existing */
-            bool placed = false;
-            for (int j = 0; j < 256; j++) {
-                if (ctx->lock_mgr.locks[j] == NULL ||
-                    ctx->lock_mgr.locks[j]->id == ((struct dsm_lock_s*)ctx->network.backup_state.backup_locks[i])->id) {
-                    ctx->lock_mgr.locks[j] = (struct dsm_lock_s*)ctx->network.backup_state.backup_locks[i];
-                    ctx->network.backup_state.backup_locks[i] = NULL;
-                    placed = true;
+    for (int i = 0; i < ctx->network.backup_state.backup_locks_capacity; i++) {
+        struct dsm_lock_s *shadow = (struct dsm_lock_s*)ctx->network.backup_state.backup_locks[i];
+        if (shadow != NULL) {
+            /* Replace existing lock with the same ID, else take the first empty slot */
+            int slot = -1;
+            for (int j = 0; j < ctx->lock_mgr.capacity; j++) {
+                if (ctx->lock_mgr.locks[j] == NULL) {
+                    if (slot == -1) slot = j;
+                } else if (ctx->lock_mgr.locks[j]->id == shadow->id) {
+                    slot = j;
                     break;
                 }
             }
-            if (!placed) {
-                LOG_WARN("Could not place shadow lock into primary lock manager (full)");
+            if (slot == -1) {
+                slot = ctx->lock_mgr.capacity;
+                if (dsm_table_grow((void ***)&ctx->lock_mgr.locks, &ctx->lock_mgr.capacity) != DSM_SUCCESS) {
+                    LOG_WARN("Could not place shadow lock %lu into primary lock manager", shadow->id);
+                    continue;
+                }
             }
+            ctx->lock_mgr.locks[slot] = shadow;
+            ctx->network.backup_state.backup_locks[i] = NULL;
         }
     }
     pthread_mutex_unlock(&ctx->lock_mgr.lock);
@@ -2506,33 +5194,45 @@ int promote_to_manager(void) {
 
     /* Step 4: Activate shadow barriers as primary */
     pthread_mutex_lock(&ctx->barrier_mgr.lock);
-    for (int i = 0; i < 256 && i < ctx->barrier_mgr.max_barriers; i++) {
+    for (int i = 0; i < ctx->network.backup_state.backup_barriers_capacity; i++) {
         if (ctx->network.backup_state.backup_barriers[i] != NULL) {
-            /* Copy shadow barrier to primary barrier manager */
             dsm_barrier_t *shadow = (dsm_barrier_t*)ctx->network.backup_state.backup_barriers[i];
 
             /* Find the barrier in primary manager by ID */
             bool found = false;
-            for (int j = 0; j < ctx->barrier_mgr.max_barriers; j++) {
-                if (ctx->barrier_mgr.barriers[j].id == shadow->id &&
-                    ctx->barrier_mgr.barriers[j].expected_count > 0) {
-                    /* Update existing barrier */
-                    ctx->barrier_mgr.barriers[j].arrived_count = shadow->arrived_count;
-                    ctx->barrier_mgr.barriers[j].generation = shadow->generation;
-                    found = true;
-                    break;
+            int empty = -1;
+            dsm_barrier_t *barrier = barrier_index_find(&ctx->barrier_mgr, shadow->id);
+            if (barrier) {
+                /* Update existing barrier */
+                barrier->arrived_count = shadow->arrived_count;
+                barrier->generation = shadow->generation;
+                found = true;
+            } else {
+                for (int j = ctx->barrier_mgr.first_free; j < ctx->barrier_mgr.max_barriers; j++) {
+                    if (ctx->barrier_mgr.barriers[j] == NULL) {
+                        empty = j;
+                        break;
+                    }
                 }
             }
 
             if (!found) {
-                /* Find empty slot */
-                for (int j = 0; j < ctx->barrier_mgr.max_barriers; j++) {
-                    if (ctx->barrier_mgr.barriers[j].expected_count == 0) {
-                        ctx->barrier_mgr.barriers[j] = *shadow;
-                        found = true;
-                        break;
+                /* Adopt the shadow barrier itself into an empty (or new) slot */
+                if (empty == -1) {
+                    empty = ctx->barrier_mgr.max_barriers;
+                    if (dsm_table_grow((void ***)&ctx->barrier_mgr.barriers,
+                                       &ctx->barrier_mgr.max_barriers) != DSM_SUCCESS) {
+                        empty = -1;
                     }
                 }
+                if (empty != -1) {
+                    ctx->barrier_mgr.barriers[empty] = shadow;
+                    ctx->barrier_mgr.first_free = empty + 1;
+                    barrier_index_insert(&ctx->barrier_mgr, shadow);
+                    ctx->network.backup_state.backup_barriers[i] = NULL;
+                    continue;
+                }
+                LOG_WARN("Could not place shadow barrier %lu into primary barrier manager", shadow->id);
             }
 
             /* Free shadow barrier */
@@ -2546,7 +5246,10 @@ int promote_to_manager(void) {
     LOG_INFO("Activated shadow barriers as primary");
 
     /* Step 5: Update current_manager to self */
+    pthread_mutex_lock(&ctx->lock);
     ctx->network.backup_state.current_manager = ctx->node_id;
+    pthread_cond_broadcast(&ctx->network.backup_state.manager_cv);
+    pthread_mutex_unlock(&ctx->lock);
 
     /* Step 6: Broadcast promotion to all nodes */
     send_manager_promotion(ctx->node_id, 0);  /* new_manager=self, old_manager=0 */
@@ -7,70 +7,167 @@
 #define HANDLERS_H
 
 #include "protocol.h"
+#include "transport.h"
+#include <sys/uio.h>
+
+/** Heartbeat interval when dsm_config_t.heartbeat_ms is 0 */
+#define HEARTBEAT_DEFAULT_MS 2000
+
+/** Intervals without a frame from a peer that count as one missed heartbeat */
+#define HEARTBEAT_TIMEOUT_INTERVALS 3
+
+/** Nodes asked to probe a silent peer on each missed heartbeat */
+#define PROBE_HELPERS 3
 
 /* Page messages */
-int send_page_request(node_id_t owner, page_id_t page_id, access_type_t access);
-int send_page_reply(node_id_t requester, page_id_t page_id, access_type_t access, const void *data);
+int send_page_request(node_id_t owner, page_id_t page_id, access_type_t access,
+                      uint64_t cached_version);
+int send_page_reply(node_id_t requester, page_id_t page_id, access_type_t access,
+                    const void *data, uint64_t version, dsm_compression_t compression,
+                    size_t block_size);
 int handle_page_request(const message_t *msg);
 int handle_page_reply(const message_t *msg);
+int handle_page_reply_data(const message_t *msg, const uint8_t *data, size_t data_len);
 
 /* Invalidate messages */
-int send_invalidate(node_id_t target, page_id_t page_id);
+int send_invalidate(node_id_t target, page_id_t page_id, node_id_t new_owner);
 int send_invalidate_ack(node_id_t target, page_id_t page_id);
+int send_invalidate_fanout(node_id_t manager, page_id_t page_id, node_id_t exclude,
+                           const node_id_t *sharers, int num_sharers);
 int handle_invalidate(const message_t *msg);
 int handle_invalidate_ack(const message_t *msg);
+int handle_invalidate_fanout(const message_t *msg);
+int send_page_upgrade(node_id_t manager, page_id_t page_id, node_id_t owner,
+                      uint64_t cached_version, const node_id_t *sharers, int num_sharers);
+int handle_page_upgrade(const message_t *msg);
+
+/* Write hand-offs (manager): one write of a page in flight at a time.
+ * handoff_acquire() waits for the page's turn and takes it for this node's
+ * own write until handoff_release(); handoff_wait() only waits. */
+bool handoff_acquire(page_id_t page_id);
+void handoff_release(page_id_t page_id, node_id_t writer);
+void handoff_wait(page_id_t page_id);
+void handoff_cleanup(void);
 
 /* Lock messages */
-int send_lock_request(node_id_t manager, lock_id_t lock_id);
-int send_lock_grant(node_id_t grantee, lock_id_t lock_id);
+int send_lock_request(node_id_t manager, lock_id_t lock_id, lock_mode_t mode);
+int send_lock_grant(node_id_t grantee, lock_id_t lock_id, lock_mode_t mode, bool recall);
 int send_lock_release(node_id_t manager, lock_id_t lock_id);
+int send_lock_recall(node_id_t holder, lock_id_t lock_id);
 int handle_lock_request(const message_t *msg);
 int handle_lock_grant(const message_t *msg);
 int handle_lock_release(const message_t *msg);
-
-/* Barrier messages */
-int send_barrier_arrive(node_id_t manager, barrier_id_t barrier_id, int num_participants);
-int send_barrier_release(node_id_t node, barrier_id_t barrier_id);
-int handle_barrier_arrive(const message_t *msg);
-int handle_barrier_release(const message_t *msg);
+int handle_lock_recall(const message_t *msg);
+
+/* Barrier messages (notices: rc_notices_t write notices, NULL without release
+ * consistency; collective: NULL for a plain barrier; data: bulk contribution or result) */
+struct rc_notices_s;
+struct barrier_collective_s;
+int send_barrier_arrive(node_id_t manager, barrier_id_t barrier_id, int num_participants,
+                        const struct rc_notices_s *notices, const struct barrier_collective_s *collective);
+int send_barrier_release(node_id_t node, barrier_id_t barrier_id, const struct rc_notices_s *notices,
+                         const void *result, size_t result_len, bool collective_failed);
+int handle_barrier_arrive(const message_t *msg, const uint8_t *data, size_t data_len);
+int handle_barrier_release(const message_t *msg, const uint8_t *data, size_t data_len);
+int send_barrier_signal(node_id_t to, barrier_id_t barrier_id, int round, int parity,
+                        const struct rc_notices_s *notices);
+int handle_barrier_signal(const message_t *msg);
 
 /* Allocation notification messages */
-int send_alloc_notify(page_id_t start_page_id, page_id_t end_page_id, node_id_t owner, size_t num_pages, void *base_addr, size_t total_size);
+int send_alloc_notify(page_id_t start_page_id, page_id_t end_page_id, node_id_t owner, size_t num_pages, void *base_addr, size_t total_size,
+                      const dsm_alloc_attr_t *attr);
 int send_alloc_ack(node_id_t target, page_id_t start_page_id, page_id_t end_page_id);
 int handle_alloc_notify(const message_t *msg);
 int handle_alloc_ack(const message_t *msg);
 
 /* Allocation synchronization helpers */
+void expect_alloc_acks(page_id_t start_page_id, page_id_t end_page_id, int expected_acks);
+void cancel_alloc_acks(void);
 int wait_for_alloc_acks(page_id_t start_page_id, page_id_t end_page_id, int expected_acks, int timeout_sec);
 
 /* Node management messages */
 int send_node_join(node_id_t node_id, const char *hostname, uint16_t port);
 int handle_node_join(const message_t *msg, int sockfd);
+int send_node_roster(void);
+int handle_node_roster(const message_t *msg, const uint8_t *data, size_t data_len);
+int handle_peer_hello(const message_t *msg, int sockfd);
 int send_heartbeat(node_id_t target);
+
+/**
+ * Send a HEARTBEAT to every live peer nothing was written to lately
+ * Called by the heartbeat thread once per interval: any frame proves
+ * this node's liveness to its peer, so busy links carry no heartbeats.
+ *
+ * @param now_ns Monotonic time (perf_get_timestamp_ns())
+ * @param interval_ns Heartbeat interval
+ * @return Heartbeats sent
+ */
+int send_idle_heartbeats(uint64_t now_ns, uint64_t interval_ns);
 int handle_heartbeat(const message_t *msg);
+
+/**
+ * Ask other nodes to probe a peer we have not heard from
+ * Called by the heartbeat thread on each missed heartbeat before the peer
+ * is declared failed. Up to PROBE_HELPERS nodes we can reach are asked,
+ * starting where the last call left off; each probes target on a link of
+ * its own (for workers, a peer link) and relays the PROBE_ACK. An answer
+ * resets target's missed heartbeats: a silent link is not a dead node.
+ *
+ * @param target Silent peer
+ * @return Nodes asked
+ */
+int send_probe_requests(node_id_t target);
+int handle_probe_request(const message_t *msg);
+int handle_probe(const message_t *msg);
+int handle_probe_ack(const message_t *msg);
 int broadcast_node_failure(node_id_t failed_node);
+int send_transport_connect(node_id_t dest, uint8_t kind, uint8_t phase, transport_conn_t *conn);
+int handle_transport_connect(const message_t *msg);
+int send_tcp_lane(node_id_t dest, uint8_t phase, uint8_t lane, uint8_t num_lanes);
+int handle_tcp_lane(const message_t *msg, int sockfd);
 
 /* Directory protocol messages */
-int send_dir_query(node_id_t manager, page_id_t page_id);
-int send_dir_reply(node_id_t requester, page_id_t page_id, node_id_t owner);
+int send_dir_query(node_id_t manager, page_id_t page_id, uint64_t request_id);
+int send_dir_reply(node_id_t requester, page_id_t page_id, node_id_t owner, uint64_t request_id);
 int send_owner_update(node_id_t manager, page_id_t page_id, node_id_t new_owner);
 int handle_dir_query(const message_t *msg);
 int handle_dir_reply(const message_t *msg);
 int handle_owner_update(const message_t *msg);
 
 /* Sharer tracking protocol (BUG #8 fix) */
-int send_sharer_query(node_id_t owner, page_id_t page_id);
+int send_sharer_query(node_id_t owner, page_id_t page_id, uint64_t request_id);
 int handle_sharer_query(const message_t *msg);
 int handle_sharer_reply(const message_t *msg);
 int handle_node_failed_msg(const message_t *msg);
 
+/* Release consistency diffs */
+int send_page_diff(node_id_t home, page_id_t page_id, uint16_t sub_page, const uint8_t *data,
+                   uint16_t len, uint16_t num_runs);
+int send_page_diff_ack(node_id_t writer, page_id_t page_id, int result);
+int handle_page_diff(const message_t *msg);
+int handle_page_diff_ack(const message_t *msg);
+
+/* Batched page requests and replies (prefetch) */
+int send_page_batch_request(node_id_t owner, const page_batch_entry_t *pages, int num_pages);
+int handle_page_batch_request(const message_t *msg);
+int handle_page_batch_reply(const message_t *msg, const uint8_t *data, size_t data_len);
+
+/* One-sided transfers (dsm_get() / dsm_put()) */
+int send_rma_request(node_id_t target, uint64_t op_id, rma_op_t op, const rma_segment_t *segments,
+                     int num_segments, const struct iovec *data, int num_data);
+int send_rma_reply(node_id_t requester, uint64_t op_id, rma_op_t op, const rma_result_t *results,
+                   int num_results, const struct iovec *data, int num_data);
+int handle_rma_request(const message_t *msg, const uint8_t *data, size_t data_len);
+int handle_rma_reply(const message_t *msg, const uint8_t *data, size_t data_len);
+
 /* Failure detection */
 void start_heartbeat_thread(void);
 void stop_heartbeat_thread(void);
 
 /* Hot backup failover - replication functions */
 int send_state_sync_dir(page_id_t page_id, node_id_t owner, const node_id_t *sharers, int num_sharers);
-int send_state_sync_lock(lock_id_t lock_id, node_id_t holder, const node_id_t *waiters, int num_waiters);
+int send_state_sync_lock(lock_id_t lock_id, node_id_t holder, const node_id_t *readers, int num_readers,
+                         const node_id_t *waiters, int num_waiters);
 int send_state_sync_barrier(barrier_id_t barrier_id, int num_arrived, int num_expected, uint64_t generation);
 int send_manager_promotion(node_id_t new_manager_id, node_id_t old_manager_id);
 int send_reconnect_request(node_id_t new_manager);
@@ -87,5 +184,6 @@ int promote_to_manager(void);
 
 /* Dispatch incoming message */
 int dispatch_message(const message_t *msg, int sockfd);
+int dispatch_bulk_message(const message_t *msg, const uint8_t *data, size_t data_len);
 
 #endif /* HANDLERS_H */
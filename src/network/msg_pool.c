@@ -0,0 +1,194 @@
+/**
+ * @file msg_pool.c
+ * @brief Pooled message queue entries implementation
+ */
+
+#include "msg_pool.h"
+#include "network.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MSG_POOL_CLASSES 3
+
+/** Payload bytes of the largest class: the whole union */
+#define MSG_POOL_FULL sizeof(((message_t *)0)->payload)
+
+static const size_t class_capacity[MSG_POOL_CLASSES] = {
+    MSG_POOL_SMALL, MSG_POOL_MEDIUM, MSG_POOL_FULL
+};
+
+_Static_assert(MSG_POOL_MEDIUM < MSG_POOL_FULL, "message payload smaller than the middle pool class");
+
+/** Entries of one class, linked through next */
+typedef struct {
+    msg_queue_entry_t *head;
+    int count;
+} entry_list_t;
+
+typedef struct {
+    entry_list_t lists[MSG_POOL_CLASSES];
+    bool registered;                   /**< Flushed to the depot when the thread exits */
+} thread_cache_t;
+
+static struct {
+    pthread_mutex_t lock;              /**< Protects depot */
+    entry_list_t depot[MSG_POOL_CLASSES];
+    pthread_key_t cache_key;
+    pthread_once_t key_once;
+} g_msg_pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .key_once = PTHREAD_ONCE_INIT
+};
+
+static __thread thread_cache_t t_cache;
+
+static size_t class_alloc_size(int cls) {
+    return offsetof(msg_queue_entry_t, msg.payload) + class_capacity[cls];
+}
+
+static msg_queue_entry_t *list_pop(entry_list_t *list) {
+    msg_queue_entry_t *entry = list->head;
+    if (entry) {
+        list->head = entry->next;
+        list->count--;
+    }
+    return entry;
+}
+
+static void list_push(entry_list_t *list, msg_queue_entry_t *entry) {
+    entry->next = list->head;
+    list->head = entry;
+    list->count++;
+}
+
+static void list_free(entry_list_t *list) {
+    msg_queue_entry_t *entry;
+    while ((entry = list_pop(list)) != NULL) {
+        free(entry);
+    }
+}
+
+/**
+ * Move up to n entries from a thread list to the depot, freeing what the
+ * depot has no room for
+ */
+static void flush_to_depot(int cls, entry_list_t *list, int n) {
+    pthread_mutex_lock(&g_msg_pool.lock);
+    entry_list_t *depot = &g_msg_pool.depot[cls];
+    for (; n > 0 && list->head; n--) {
+        msg_queue_entry_t *entry = list_pop(list);
+        if (depot->count < MSG_POOL_DEPOT_MAX) {
+            list_push(depot, entry);
+        } else {
+            free(entry);
+        }
+    }
+    pthread_mutex_unlock(&g_msg_pool.lock);
+}
+
+static void cache_release(void *arg) {
+    thread_cache_t *cache = (thread_cache_t *)arg;
+    for (int cls = 0; cls < MSG_POOL_CLASSES; cls++) {
+        flush_to_depot(cls, &cache->lists[cls], cache->lists[cls].count);
+    }
+    cache->registered = false;
+}
+
+static void create_cache_key(void) {
+    pthread_key_create(&g_msg_pool.cache_key, cache_release);
+}
+
+static thread_cache_t *thread_cache(void) {
+    if (!t_cache.registered) {
+        pthread_once(&g_msg_pool.key_once, create_cache_key);
+        pthread_setspecific(g_msg_pool.cache_key, &t_cache);
+        t_cache.registered = true;
+    }
+    return &t_cache;
+}
+
+msg_queue_entry_t *msg_pool_get(size_t payload_len) {
+    int cls = 0;
+    while (cls < MSG_POOL_CLASSES && payload_len > class_capacity[cls]) {
+        cls++;
+    }
+    if (cls == MSG_POOL_CLASSES) {
+        return NULL;
+    }
+
+    entry_list_t *list = &thread_cache()->lists[cls];
+    msg_queue_entry_t *entry = list_pop(list);
+
+    /* Refill half the cache in one trip to the depot */
+    if (!entry) {
+        pthread_mutex_lock(&g_msg_pool.lock);
+        entry_list_t *depot = &g_msg_pool.depot[cls];
+        for (int i = 0; i < MSG_POOL_CACHE_MAX / 2 && depot->head; i++) {
+            list_push(list, list_pop(depot));
+        }
+        pthread_mutex_unlock(&g_msg_pool.lock);
+        entry = list_pop(list);
+    }
+
+    if (!entry) {
+        entry = malloc(class_alloc_size(cls));
+        if (!entry) {
+            return NULL;
+        }
+        entry->pool_class = (uint8_t)cls;
+    }
+
+    entry->dest = 0;
+    entry->data = NULL;
+    entry->data_len = 0;
+    entry->next = NULL;
+    return entry;
+}
+
+msg_queue_entry_t *msg_pool_copy(const message_t *msg) {
+    size_t payload_size = message_wire_payload_size(msg);
+    if (payload_size == (size_t)-1) {
+        payload_size = MSG_POOL_FULL;
+    }
+
+    msg_queue_entry_t *entry = msg_pool_get(payload_size);
+    if (!entry) {
+        return NULL;
+    }
+    memcpy(&entry->msg.header, &msg->header, sizeof(msg_header_t));
+    memcpy(&entry->msg.payload, &msg->payload, payload_size);
+    return entry;
+}
+
+size_t msg_pool_capacity(const msg_queue_entry_t *entry) {
+    return class_capacity[entry->pool_class];
+}
+
+void msg_pool_put(msg_queue_entry_t *entry) {
+    if (!entry) {
+        return;
+    }
+    free(entry->data);
+    entry->data = NULL;
+
+    int cls = entry->pool_class;
+    entry_list_t *list = &thread_cache()->lists[cls];
+    list_push(list, entry);
+    if (list->count > MSG_POOL_CACHE_MAX) {
+        flush_to_depot(cls, list, MSG_POOL_CACHE_MAX / 2);
+    }
+}
+
+void msg_pool_trim(void) {
+    for (int cls = 0; cls < MSG_POOL_CLASSES; cls++) {
+        list_free(&t_cache.lists[cls]);
+    }
+
+    pthread_mutex_lock(&g_msg_pool.lock);
+    for (int cls = 0; cls < MSG_POOL_CLASSES; cls++) {
+        list_free(&g_msg_pool.depot[cls]);
+    }
+    pthread_mutex_unlock(&g_msg_pool.lock);
+}
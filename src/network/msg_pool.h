@@ -0,0 +1,79 @@
+/**
+ * @file msg_pool.h
+ * @brief Pooled message queue entries
+ *
+ * A msg_queue_entry_t ends in a whole message_t, whose payload union is
+ * sized for a page, yet only message_wire_payload_size() bytes of it are
+ * ever used. Entries are therefore allocated in a few size classes by
+ * payload capacity and recycled: each thread keeps a small cache per class
+ * and exchanges batches of entries with a shared depot, so in steady state
+ * a message costs no malloc()/free() and is copied at its wire size only.
+ *
+ * An entry has exactly one owner, and ownership moves with the pointer:
+ * from the receive path to a handler worker, or from a sender to its send
+ * queue's thread. The owner returns it with msg_pool_put().
+ *
+ * Only the first msg_pool_capacity() bytes of an entry's msg.payload
+ * exist; the message must never be copied or read as a whole message_t.
+ */
+
+#ifndef MSG_POOL_H
+#define MSG_POOL_H
+
+#include "protocol.h"
+#include <stddef.h>
+
+/** Payload capacity of the smallest class: requests, acks, lock and barrier traffic */
+#define MSG_POOL_SMALL 256
+
+/** Payload capacity of the middle class: node lists, batches of page IDs */
+#define MSG_POOL_MEDIUM 1024
+
+/** Entries of one class a thread caches before handing half to the depot */
+#define MSG_POOL_CACHE_MAX 64
+
+/** Entries of one class the shared depot keeps before freeing the excess */
+#define MSG_POOL_DEPOT_MAX 1024
+
+/**
+ * Take an entry whose payload holds at least payload_len bytes
+ *
+ * The entry comes back with no data, dest 0 and next NULL; its message is
+ * uninitialized.
+ *
+ * @param payload_len Payload bytes the caller will write (at most sizeof(message_t.payload))
+ * @return Entry, or NULL if payload_len is too large or memory is exhausted
+ */
+msg_queue_entry_t *msg_pool_get(size_t payload_len);
+
+/**
+ * Take an entry holding a copy of a message's header and wire payload
+ *
+ * @param msg Message to copy
+ * @return Entry, or NULL if memory is exhausted
+ */
+msg_queue_entry_t *msg_pool_copy(const message_t *msg);
+
+/**
+ * Payload bytes an entry holds
+ *
+ * @param entry Entry from msg_pool_get()
+ * @return Capacity of its class
+ */
+size_t msg_pool_capacity(const msg_queue_entry_t *entry);
+
+/**
+ * Return an entry to the calling thread's cache
+ * Its bulk data, if any, is freed.
+ *
+ * @param entry Entry from msg_pool_get(), or NULL
+ */
+void msg_pool_put(msg_queue_entry_t *entry);
+
+/**
+ * Free the entries cached by the calling thread and the shared depot
+ * Entries still owned elsewhere are unaffected and stay valid.
+ */
+void msg_pool_trim(void);
+
+#endif /* MSG_POOL_H */
@@ -4,9 +4,13 @@
  */
 
 #include "protocol.h"
+#include "network.h"
+#include "msg_pool.h"
 #include "../core/log.h"
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
 
 msg_queue_t* msg_queue_create(void) {
     msg_queue_t *queue = malloc(sizeof(msg_queue_t));
@@ -37,7 +41,7 @@ void msg_queue_destroy(msg_queue_t *queue) {
     msg_queue_entry_t *curr = queue->head;
     while (curr) {
         msg_queue_entry_t *next = curr->next;
-        free(curr);
+        msg_pool_put(curr);
         curr = next;
     }
 
@@ -50,18 +54,37 @@ void msg_queue_destroy(msg_queue_t *queue) {
 }
 
 int msg_queue_enqueue(msg_queue_t *queue, const message_t *msg, node_id_t dest) {
+    return msg_queue_enqueue_data(queue, msg, dest, NULL, 0);
+}
+
+int msg_queue_enqueue_data(msg_queue_t *queue, const message_t *msg, node_id_t dest,
+                           uint8_t *data, size_t data_len) {
     if (!queue || !msg) {
         return DSM_ERROR_INVALID;
     }
 
-    msg_queue_entry_t *entry = malloc(sizeof(msg_queue_entry_t));
+    /* Copy only the bytes that go on the wire, into an entry of that size */
+    msg_queue_entry_t *entry = msg_pool_copy(msg);
     if (!entry) {
         LOG_ERROR("Failed to allocate queue entry");
         return DSM_ERROR_MEMORY;
     }
-
-    memcpy(&entry->msg, msg, sizeof(message_t));
     entry->dest = dest;
+    entry->data = data;
+    entry->data_len = data_len;
+
+    int rc = msg_queue_push(queue, entry);
+    if (rc != DSM_SUCCESS) {
+        entry->data = NULL;
+        msg_pool_put(entry);
+    }
+    return rc;
+}
+
+int msg_queue_push(msg_queue_t *queue, msg_queue_entry_t *entry) {
+    if (!queue || !entry) {
+        return DSM_ERROR_INVALID;
+    }
     entry->next = NULL;
 
     pthread_mutex_lock(&queue->lock);
@@ -79,7 +102,7 @@ int msg_queue_enqueue(msg_queue_t *queue, const message_t *msg, node_id_t dest)
     pthread_mutex_unlock(&queue->lock);
 
     LOG_DEBUG("Message enqueued (type=%d, dest=%u, count=%d)",
-              msg->header.type, dest, queue->count);
+              entry->msg.header.type, entry->dest, queue->count);
     return DSM_SUCCESS;
 }
 
@@ -103,18 +126,73 @@ int msg_queue_dequeue(msg_queue_t *queue, message_t *msg, node_id_t *dest) {
 
     queue->count--;
 
-    memcpy(msg, &entry->msg, sizeof(message_t));
     *dest = entry->dest;
 
     pthread_mutex_unlock(&queue->lock);
 
-    free(entry);
+    /* Only the message is returned; bulk data has no place in msg */
+    size_t payload_size = message_wire_payload_size(&entry->msg);
+    if (payload_size > msg_pool_capacity(entry)) {
+        payload_size = msg_pool_capacity(entry);
+    }
+    memcpy(&msg->header, &entry->msg.header, sizeof(msg_header_t));
+    memcpy(&msg->payload, &entry->msg.payload, payload_size);
+    msg_pool_put(entry);
 
     LOG_DEBUG("Message dequeued (type=%d, dest=%u, count=%d)",
               msg->header.type, *dest, queue->count);
     return DSM_SUCCESS;
 }
 
+int msg_queue_wait(msg_queue_t *queue, int timeout_ms) {
+    if (!queue) {
+        return 0;
+    }
+
+    struct timespec timeout;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec += timeout_ms / 1000;
+    timeout.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (timeout.tv_nsec >= 1000000000L) {
+        timeout.tv_sec++;
+        timeout.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0) {
+        if (pthread_cond_timedwait(&queue->not_empty, &queue->lock, &timeout) == ETIMEDOUT) {
+            break;
+        }
+    }
+    int count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+
+    return count;
+}
+
+int msg_queue_dequeue_batch(msg_queue_t *queue, msg_queue_entry_t **entries, int max) {
+    if (!queue || !entries || max <= 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+
+    int n = 0;
+    while (n < max && queue->head) {
+        msg_queue_entry_t *entry = queue->head;
+        queue->head = entry->next;
+        entry->next = NULL;
+        entries[n++] = entry;
+    }
+    if (!queue->head) {
+        queue->tail = NULL;
+    }
+    queue->count -= n;
+
+    pthread_mutex_unlock(&queue->lock);
+    return n;
+}
+
 int msg_queue_size(msg_queue_t *queue) {
     if (!queue) {
         return 0;
@@ -5,21 +5,79 @@
 
 #include "network.h"
 #include "handlers.h"
+#include "handler_pool.h"
+#include "msg_pool.h"
+#include "transport.h"
+#include "replication.h"
 #include "../core/log.h"
 #include "../core/dsm_context.h"
 #include "../core/perf_log.h"
+#include "../core/stats.h"
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
+#include <stddef.h>
 #include <errno.h>
+#include <sys/epoll.h>
 #include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
 
 static void* accept_thread(void *arg);
 static void* dispatcher_thread(void *arg);
+static void drain_socket(int sockfd);
+static bool lane_blocked(int sockfd);
+
+/* A send waits at most this long for room in a full socket buffer */
+#define SEND_TIMEOUT_MS 5000
+
+/**
+ * Set the options every peer socket gets: O_NONBLOCK, TCP_NODELAY and
+ * the socket tunables of dsm_config_t
+ */
+static void configure_peer_socket(int sockfd) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    /* The dispatcher reads until EAGAIN, and senders wait in poll() for
+     * at most SEND_TIMEOUT_MS, so nothing blocks on a slow peer */
+    int flags = fcntl(sockfd, F_GETFL);
+    if (flags < 0 || fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        LOG_WARN("Setting O_NONBLOCK on sockfd=%d failed: %s", sockfd, strerror(errno));
+    }
+
+    /* Frames are written whole, so Nagle could only hold back the tail
+     * of a frame until the previous one is acknowledged */
+    int opt = 1;
+    if (setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt)) < 0) {
+        LOG_WARN("setsockopt TCP_NODELAY failed: %s", strerror(errno));
+    }
+
+    int buffer_size = ctx->config.socket_buffer_size;
+    if (buffer_size > 0) {
+        if (setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size)) < 0 ||
+            setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size)) < 0) {
+            LOG_WARN("Setting socket buffers to %d bytes failed: %s", buffer_size, strerror(errno));
+        }
+    }
+
+    int busy_poll = ctx->config.busy_poll_us;
+    if (busy_poll > 0) {
+#ifdef SO_BUSY_POLL
+        if (setsockopt(sockfd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll, sizeof(busy_poll)) < 0) {
+            LOG_WARN("setsockopt SO_BUSY_POLL failed: %s (needs CAP_NET_ADMIN above net.core.busy_read)",
+                     strerror(errno));
+        }
+#else
+        LOG_WARN("SO_BUSY_POLL not available, busy_poll_us ignored");
+#endif
+    }
+}
 
 int network_server_init(uint16_t port) {
     dsm_context_t *ctx = dsm_get_context();
@@ -64,7 +122,8 @@ int network_server_init(uint16_t port) {
     }
 
     /* Listen */
-    if (listen(sockfd, 10) < 0) {
+    /* Workers of a large cluster all connect at once */
+    if (listen(sockfd, SOMAXCONN) < 0) {
         LOG_ERROR("Listen failed: %s", strerror(errno));
         close(sockfd);
         return DSM_ERROR_NETWORK;
@@ -85,15 +144,20 @@ int network_server_init(uint16_t port) {
     return DSM_SUCCESS;
 }
 
+/**
+ * Accept connections on a listening socket into the pending list
+ *
+ * @param arg The network_state_t field holding the socket (NULL = server_sockfd)
+ */
 static void* accept_thread(void *arg) {
-    (void)arg;
     dsm_context_t *ctx = dsm_get_context();
+    int *listen_fd = arg ? (int *)arg : &ctx->network.server_sockfd;
 
     while (1) {
-        /* Check if we should continue running and get server_sockfd (with lock) */
+        /* Check if we should continue running and get the listening socket (with lock) */
         pthread_mutex_lock(&ctx->lock);
         bool should_run = ctx->network.running;
-        int server_fd = ctx->network.server_sockfd;
+        int server_fd = *listen_fd;
         pthread_mutex_unlock(&ctx->lock);
 
         if (!should_run || server_fd < 0) {
@@ -109,6 +173,10 @@ static void* accept_thread(void *arg) {
             if (errno == EINTR) {
                 break;
             }
+            /* Server socket shut down by network_shutdown() */
+            if (!ctx->network.running) {
+                break;
+            }
             LOG_ERROR("Accept failed: %s", strerror(errno));
             continue;
         }
@@ -118,18 +186,17 @@ static void* accept_thread(void *arg) {
                  ntohs(client_addr.sin_port),
                  client_fd);
 
-        /* Set socket timeouts to prevent indefinite blocking */
-        struct timeval send_tv = {.tv_sec = 5, .tv_usec = 0};  /* 5 second send timeout */
-        struct timeval recv_tv = {.tv_sec = 30, .tv_usec = 0}; /* 30 second recv timeout */
-        setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &send_tv, sizeof(send_tv));
-        setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &recv_tv, sizeof(recv_tv));
+        configure_peer_socket(client_fd);
 
-        /* Add to pending connections list - will be moved to nodes[] when NODE_JOIN is received */
+        /* Add to pending connections list - will be moved to nodes[] when NODE_JOIN
+         * (or, for a peer link, PEER_HELLO) is received */
         pthread_mutex_lock(&ctx->network.pending_lock);
-        if (ctx->network.num_pending < MAX_NODES) {
+        if (ctx->network.num_pending < ctx->network.max_pending) {
             ctx->network.pending_sockets[ctx->network.num_pending++] = client_fd;
             LOG_DEBUG("Added sockfd=%d to pending connections (total pending=%d)",
                      client_fd, ctx->network.num_pending);
+            /* Registered once here; stays registered after NODE_JOIN moves it to nodes[] */
+            network_watch_socket(client_fd);
         } else {
             LOG_ERROR("Too many pending connections, rejecting sockfd=%d", client_fd);
             close(client_fd);
@@ -140,18 +207,17 @@ static void* accept_thread(void *arg) {
     return NULL;
 }
 
-int network_connect_to_node(node_id_t node_id, const char *hostname, uint16_t port) {
-    if (!hostname || node_id >= MAX_NODES) {
-        return DSM_ERROR_INVALID;
-    }
-
-    dsm_context_t *ctx = dsm_get_context();
-
+/**
+ * Open a TCP connection to hostname:port with the peer socket options
+ *
+ * @return Connected socket, or -1
+ */
+static int connect_socket(const char *hostname, uint16_t port) {
     /* Create socket */
     int sockfd = socket(AF_INET, SOCK_STREAM, 0);
     if (sockfd < 0) {
         LOG_ERROR("Socket creation failed: %s", strerror(errno));
-        return DSM_ERROR_NETWORK;
+        return -1;
     }
 
     /* Resolve hostname */
@@ -159,7 +225,7 @@ int network_connect_to_node(node_id_t node_id, const char *hostname, uint16_t po
     if (!host) {
         LOG_ERROR("Cannot resolve hostname: %s", hostname);
         close(sockfd);
-        return DSM_ERROR_NETWORK;
+        return -1;
     }
 
     /* Connect */
@@ -172,14 +238,29 @@ int network_connect_to_node(node_id_t node_id, const char *hostname, uint16_t po
     if (connect(sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
         LOG_ERROR("Connect to %s:%u failed: %s", hostname, port, strerror(errno));
         close(sockfd);
+        return -1;
+    }
+
+    configure_peer_socket(sockfd);
+    return sockfd;
+}
+
+int network_connect_to_node(node_id_t node_id, const char *hostname, uint16_t port) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    if (!hostname || node_id >= (node_id_t)ctx->network.max_nodes) {
+        return DSM_ERROR_INVALID;
+    }
+
+    int sockfd = connect_socket(hostname, port);
+    if (sockfd < 0) {
         return DSM_ERROR_NETWORK;
     }
 
-    /* Set socket timeouts to prevent indefinite blocking */
-    struct timeval send_tv = {.tv_sec = 5, .tv_usec = 0};  /* 5 second send timeout */
-    struct timeval recv_tv = {.tv_sec = 30, .tv_usec = 0}; /* 30 second recv timeout */
-    setsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO, &send_tv, sizeof(send_tv));
-    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &recv_tv, sizeof(recv_tv));
+    if (network_watch_socket(sockfd) != DSM_SUCCESS) {
+        close(sockfd);
+        return DSM_ERROR_NETWORK;
+    }
 
     /* Store connection */
     pthread_mutex_lock(&ctx->lock);
@@ -198,137 +279,228 @@ int network_connect_to_node(node_id_t node_id, const char *hostname, uint16_t po
     return DSM_SUCCESS;
 }
 
-int serialize_message(const message_t *msg, uint8_t *buffer, size_t *len) {
-    if (!msg || !buffer || !len) {
-        return DSM_ERROR_INVALID;
+int network_peer_server_init(uint16_t port) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd < 0) {
+        LOG_ERROR("Failed to create peer link socket: %s", strerror(errno));
+        return DSM_ERROR_NETWORK;
     }
 
-    /* Simple serialization: copy header + payload */
-    size_t offset = 0;
+    int opt = 1;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+        LOG_WARN("setsockopt SO_REUSEADDR failed: %s", strerror(errno));
+    }
 
-    /* Header */
-    memcpy(buffer + offset, &msg->header, sizeof(msg_header_t));
-    offset += sizeof(msg_header_t);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+
+    /* Port 0 lets the kernel pick; peers learn it from the roster */
+    socklen_t addr_len = sizeof(addr);
+    if (bind(sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(sockfd, SOMAXCONN) < 0 ||
+        getsockname(sockfd, (struct sockaddr*)&addr, &addr_len) < 0) {
+        LOG_ERROR("Peer link listener on port %u failed: %s", port, strerror(errno));
+        close(sockfd);
+        return DSM_ERROR_NETWORK;
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->network.peer_server_sockfd = sockfd;
+    ctx->network.peer_server_port = ntohs(addr.sin_port);
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (pthread_create(&ctx->network.peer_accept_thread, NULL, accept_thread,
+                       &ctx->network.peer_server_sockfd) != 0) {
+        LOG_ERROR("Failed to create peer link accept thread");
+        pthread_mutex_lock(&ctx->lock);
+        ctx->network.peer_server_sockfd = -1;
+        ctx->network.peer_server_port = 0;
+        pthread_mutex_unlock(&ctx->lock);
+        close(sockfd);
+        return DSM_ERROR_INIT;
+    }
+
+    LOG_INFO("Taking peer links on port %u", ctx->network.peer_server_port);
+    return DSM_SUCCESS;
+}
+
+
+size_t message_payload_size(msg_type_t type) {
+    switch (type) {
+        case MSG_PAGE_REQUEST:       return sizeof(page_request_payload_t);
+        case MSG_PAGE_REPLY:         return sizeof(page_reply_payload_t);
+        case MSG_INVALIDATE:         return sizeof(invalidate_payload_t);
+        case MSG_INVALIDATE_ACK:     return sizeof(invalidate_ack_payload_t);
+        case MSG_LOCK_REQUEST:       return sizeof(lock_request_payload_t);
+        case MSG_LOCK_GRANT:         return sizeof(lock_grant_payload_t);
+        case MSG_LOCK_RELEASE:       return sizeof(lock_release_payload_t);
+        case MSG_LOCK_RECALL:        return sizeof(lock_recall_payload_t);
+        case MSG_INVALIDATE_FANOUT:  return offsetof(invalidate_fanout_payload_t, sharers);
+        case MSG_PAGE_UPGRADE:       return offsetof(page_upgrade_payload_t, sharers);
+        case MSG_TRANSPORT_CONNECT:  return sizeof(transport_connect_payload_t);
+        case MSG_TCP_LANE:           return sizeof(tcp_lane_payload_t);
+        case MSG_STATE_SYNC_BATCH:   return sizeof(state_sync_batch_payload_t);
+        case MSG_BARRIER_ARRIVE:     return offsetof(barrier_arrive_payload_t, notices);
+        case MSG_BARRIER_RELEASE:    return offsetof(barrier_release_payload_t, notices);
+        case MSG_BARRIER_SIGNAL:     return offsetof(barrier_signal_payload_t, notices);
+        case MSG_ALLOC_NOTIFY:       return sizeof(alloc_notify_payload_t);
+        case MSG_ALLOC_ACK:          return sizeof(alloc_ack_payload_t);
+        case MSG_NODE_JOIN:          return sizeof(node_join_payload_t);
+        case MSG_NODE_LEAVE:         return sizeof(node_leave_payload_t);
+        case MSG_NODE_ROSTER:        return offsetof(node_roster_payload_t, members);
+        case MSG_HEARTBEAT:          return 0;  /* Heartbeat has no payload */
+        case MSG_HEARTBEAT_ACK:      return sizeof(heartbeat_ack_payload_t);
+        case MSG_ERROR:              return sizeof(error_payload_t);
+        case MSG_DIR_QUERY:          return sizeof(dir_query_payload_t);
+        case MSG_DIR_REPLY:          return sizeof(dir_reply_payload_t);
+        case MSG_OWNER_UPDATE:       return sizeof(owner_update_payload_t);
+        case MSG_NODE_FAILED:        return sizeof(node_failed_payload_t);
+        case MSG_SHARER_QUERY:       return sizeof(sharer_query_payload_t);
+        case MSG_SHARER_REPLY:       return offsetof(sharer_reply_payload_t, sharers);
+        case MSG_STATE_SYNC_DIR:     return offsetof(state_sync_dir_payload_t, sharers);
+        case MSG_STATE_SYNC_LOCK:    return offsetof(state_sync_lock_payload_t, waiters);
+        case MSG_STATE_SYNC_BARRIER: return sizeof(state_sync_barrier_payload_t);
+        case MSG_STATE_SYNC_NODE:    return sizeof(state_sync_node_payload_t);
+        case MSG_MANAGER_PROMOTION:  return sizeof(manager_promotion_payload_t);
+        case MSG_RECONNECT_REQUEST:  return sizeof(reconnect_request_payload_t);
+        case MSG_PAGE_DIFF:          return offsetof(page_diff_payload_t, data);
+        case MSG_PAGE_DIFF_ACK:      return sizeof(page_diff_ack_payload_t);
+        case MSG_PAGE_BATCH_REQUEST: return offsetof(page_batch_request_payload_t, pages);
+        case MSG_PAGE_BATCH_REPLY:   return offsetof(page_batch_reply_payload_t, pages);
+        case MSG_RMA_REQUEST:        return offsetof(rma_request_payload_t, segments);
+        case MSG_RMA_REPLY:          return offsetof(rma_reply_payload_t, results);
+        case MSG_PEER_HELLO:         return sizeof(peer_hello_payload_t);
+        case MSG_PROBE_REQUEST:
+        case MSG_PROBE:
+        case MSG_PROBE_ACK:          return sizeof(probe_payload_t);
+        default:                     return (size_t)-1;
+    }
+}
+
+/** Bytes taken by a node ID list of count entries, clamped to [0, MAX_SHARERS] */
+static size_t node_list_size(int count) {
+    if (count < 0) count = 0;
+    if (count > MAX_SHARERS) count = MAX_SHARERS;
+    return (size_t)count * sizeof(node_id_t);
+}
+
+/** Bytes taken by a write notice list of count entries, clamped to [0, BARRIER_NOTICE_MAX] */
+static size_t notice_list_size(int count) {
+    if (count > BARRIER_NOTICE_MAX) count = BARRIER_NOTICE_MAX;
+    return (size_t)count * sizeof(page_id_t);
+}
+
+/** Entries of a STATE_SYNC_LOCK node list: the readers, then the queue */
+static int sync_lock_entries(const state_sync_lock_payload_t *sync) {
+    int readers = sync->num_readers < 0 ? 0 : (sync->num_readers > MAX_SHARERS ? MAX_SHARERS : sync->num_readers);
+    int waiters = sync->num_waiters < 0 ? 0 : (sync->num_waiters > MAX_SHARERS ? MAX_SHARERS : sync->num_waiters);
+    return readers + waiters;
+}
+
+size_t page_reply_data_len(const message_t *msg) {
+    const page_reply_payload_t *reply = &msg->payload.page_reply;
+    if (reply->copy_current || reply->block_size > PAGE_SIZE) {
+        return 0;
+    }
+    switch (reply->encoding) {
+        case PAGE_ENCODING_RAW:  return PAGE_SIZE;
+        case PAGE_ENCODING_ZERO: return 0;
+        default:                 return reply->data_len <= PAGE_SIZE ? reply->data_len : PAGE_SIZE;
+    }
+}
+
+size_t page_reply_bulk_len(const message_t *msg) {
+    const page_reply_payload_t *reply = &msg->payload.page_reply;
+    if (reply->copy_current || reply->block_size <= PAGE_SIZE ||
+        reply->encoding != PAGE_ENCODING_RAW) {
+        return 0;
+    }
+    return reply->block_size;
+}
+
+/**
+ * Fixed part of a payload that sizes the rest of a bulk-capable frame
+ * @return Bytes to read first, or 0 if frames of this type have no bulk data
+ */
+static size_t bulk_frame_fixed_size(msg_type_t type) {
+    switch (type) {
+        case MSG_PAGE_REPLY:       return offsetof(page_reply_payload_t, data);
+        case MSG_PAGE_BATCH_REPLY: return offsetof(page_batch_reply_payload_t, pages);
+        case MSG_STATE_SYNC_BATCH: return sizeof(state_sync_batch_payload_t);
+        case MSG_RMA_REQUEST:      return offsetof(rma_request_payload_t, segments);
+        case MSG_RMA_REPLY:        return offsetof(rma_reply_payload_t, results);
+        case MSG_BARRIER_ARRIVE:   return offsetof(barrier_arrive_payload_t, notices);
+        case MSG_BARRIER_RELEASE:  return offsetof(barrier_release_payload_t, notices);
+        case MSG_NODE_ROSTER:      return offsetof(node_roster_payload_t, members);
+        default:                   return 0;
+    }
+}
+
+size_t message_wire_payload_size(const message_t *msg) {
+    size_t size = message_payload_size(msg->header.type);
+    if (size == (size_t)-1) {
+        return size;
+    }
 
-    /* Payload based on type */
     switch (msg->header.type) {
-        case MSG_PAGE_REQUEST:
-            memcpy(buffer + offset, &msg->payload.page_request, sizeof(page_request_payload_t));
-            offset += sizeof(page_request_payload_t);
-            break;
+        case MSG_SHARER_REPLY:    return size + node_list_size(msg->payload.sharer_reply.num_sharers);
+        case MSG_NODE_ROSTER:     return size + node_list_size(msg->payload.node_roster.num_members);
+        case MSG_INVALIDATE_FANOUT:
+            return size + node_list_size(msg->payload.invalidate_fanout.num_sharers);
+        case MSG_PAGE_UPGRADE:
+            return size + node_list_size(msg->payload.page_upgrade.num_sharers);
+        case MSG_STATE_SYNC_DIR:  return size + node_list_size(msg->payload.state_sync_dir.num_sharers);
+        case MSG_STATE_SYNC_LOCK: return size + node_list_size(sync_lock_entries(&msg->payload.state_sync_lock));
+        case MSG_BARRIER_ARRIVE:  return size + notice_list_size(msg->payload.barrier_arrive.num_notices);
+        case MSG_BARRIER_RELEASE: return size + notice_list_size(msg->payload.barrier_release.num_notices);
+        case MSG_BARRIER_SIGNAL:  return size + notice_list_size(msg->payload.barrier_signal.num_notices);
         case MSG_PAGE_REPLY:
-            memcpy(buffer + offset, &msg->payload.page_reply, sizeof(page_reply_payload_t));
-            offset += sizeof(page_reply_payload_t);
-            break;
-        case MSG_INVALIDATE:
-            memcpy(buffer + offset, &msg->payload.invalidate, sizeof(invalidate_payload_t));
-            offset += sizeof(invalidate_payload_t);
-            break;
-        case MSG_INVALIDATE_ACK:
-            memcpy(buffer + offset, &msg->payload.invalidate_ack, sizeof(invalidate_ack_payload_t));
-            offset += sizeof(invalidate_ack_payload_t);
-            break;
-        case MSG_LOCK_REQUEST:
-            memcpy(buffer + offset, &msg->payload.lock_request, sizeof(lock_request_payload_t));
-            offset += sizeof(lock_request_payload_t);
-            break;
-        case MSG_LOCK_GRANT:
-            memcpy(buffer + offset, &msg->payload.lock_grant, sizeof(lock_grant_payload_t));
-            offset += sizeof(lock_grant_payload_t);
-            break;
-        case MSG_LOCK_RELEASE:
-            memcpy(buffer + offset, &msg->payload.lock_release, sizeof(lock_release_payload_t));
-            offset += sizeof(lock_release_payload_t);
-            break;
-        case MSG_BARRIER_ARRIVE:
-            memcpy(buffer + offset, &msg->payload.barrier_arrive, sizeof(barrier_arrive_payload_t));
-            offset += sizeof(barrier_arrive_payload_t);
-            break;
-        case MSG_BARRIER_RELEASE:
-            memcpy(buffer + offset, &msg->payload.barrier_release, sizeof(barrier_release_payload_t));
-            offset += sizeof(barrier_release_payload_t);
-            break;
-        case MSG_ALLOC_NOTIFY:
-            memcpy(buffer + offset, &msg->payload.alloc_notify, sizeof(alloc_notify_payload_t));
-            offset += sizeof(alloc_notify_payload_t);
-            break;
-        case MSG_ALLOC_ACK:
-            memcpy(buffer + offset, &msg->payload.alloc_ack, sizeof(alloc_ack_payload_t));
-            offset += sizeof(alloc_ack_payload_t);
-            break;
-        case MSG_NODE_JOIN:
-            memcpy(buffer + offset, &msg->payload.node_join, sizeof(node_join_payload_t));
-            offset += sizeof(node_join_payload_t);
-            break;
-        case MSG_NODE_LEAVE:
-            memcpy(buffer + offset, &msg->payload.node_leave, sizeof(node_leave_payload_t));
-            offset += sizeof(node_leave_payload_t);
-            break;
-        case MSG_HEARTBEAT:
-            /* Heartbeat has no payload */
-            break;
-        case MSG_HEARTBEAT_ACK:
-            memcpy(buffer + offset, &msg->payload.heartbeat_ack, sizeof(heartbeat_ack_payload_t));
-            offset += sizeof(heartbeat_ack_payload_t);
-            break;
-        case MSG_ERROR:
-            memcpy(buffer + offset, &msg->payload.error, sizeof(error_payload_t));
-            offset += sizeof(error_payload_t);
-            break;
-        case MSG_DIR_QUERY:
-            memcpy(buffer + offset, &msg->payload.dir_query, sizeof(dir_query_payload_t));
-            offset += sizeof(dir_query_payload_t);
-            break;
-        case MSG_DIR_REPLY:
-            memcpy(buffer + offset, &msg->payload.dir_reply, sizeof(dir_reply_payload_t));
-            offset += sizeof(dir_reply_payload_t);
-            break;
-        case MSG_OWNER_UPDATE:
-            memcpy(buffer + offset, &msg->payload.owner_update, sizeof(owner_update_payload_t));
-            offset += sizeof(owner_update_payload_t);
-            break;
-        case MSG_NODE_FAILED:
-            memcpy(buffer + offset, &msg->payload.node_failed, sizeof(node_failed_payload_t));
-            offset += sizeof(node_failed_payload_t);
-            break;
-        case MSG_SHARER_QUERY:
-            memcpy(buffer + offset, &msg->payload.sharer_query, sizeof(sharer_query_payload_t));
-            offset += sizeof(sharer_query_payload_t);
-            break;
-        case MSG_SHARER_REPLY:
-            memcpy(buffer + offset, &msg->payload.sharer_reply, sizeof(sharer_reply_payload_t));
-            offset += sizeof(sharer_reply_payload_t);
-            break;
-        case MSG_STATE_SYNC_DIR:
-            memcpy(buffer + offset, &msg->payload.state_sync_dir, sizeof(state_sync_dir_payload_t));
-            offset += sizeof(state_sync_dir_payload_t);
-            break;
-        case MSG_STATE_SYNC_LOCK:
-            memcpy(buffer + offset, &msg->payload.state_sync_lock, sizeof(state_sync_lock_payload_t));
-            offset += sizeof(state_sync_lock_payload_t);
-            break;
-        case MSG_STATE_SYNC_BARRIER:
-            memcpy(buffer + offset, &msg->payload.state_sync_barrier, sizeof(state_sync_barrier_payload_t));
-            offset += sizeof(state_sync_barrier_payload_t);
-            break;
-        case MSG_STATE_SYNC_NODE:
-            memcpy(buffer + offset, &msg->payload.state_sync_node, sizeof(state_sync_node_payload_t));
-            offset += sizeof(state_sync_node_payload_t);
-            break;
-        case MSG_MANAGER_PROMOTION:
-            memcpy(buffer + offset, &msg->payload.manager_promotion, sizeof(manager_promotion_payload_t));
-            offset += sizeof(manager_promotion_payload_t);
-            break;
-        case MSG_RECONNECT_REQUEST:
-            memcpy(buffer + offset, &msg->payload.reconnect_request, sizeof(reconnect_request_payload_t));
-            offset += sizeof(reconnect_request_payload_t);
-            break;
-        default:
-            LOG_WARN("Unknown message type: %d", msg->header.type);
-            return DSM_ERROR_INVALID;
+            return offsetof(page_reply_payload_t, data) + page_reply_data_len(msg);
+        case MSG_PAGE_DIFF:
+            return size + (msg->payload.page_diff.data_len <= PAGE_DIFF_MAX_DATA ?
+                           msg->payload.page_diff.data_len : PAGE_DIFF_MAX_DATA);
+        case MSG_PAGE_BATCH_REQUEST:
+            return size + (msg->payload.page_batch_request.num_pages <= PAGE_BATCH_MAX ?
+                           msg->payload.page_batch_request.num_pages : PAGE_BATCH_MAX) *
+                          sizeof(page_batch_entry_t);
+        case MSG_PAGE_BATCH_REPLY:
+            return size + (msg->payload.page_batch_reply.num_pages <= PAGE_BATCH_MAX ?
+                           msg->payload.page_batch_reply.num_pages : PAGE_BATCH_MAX) *
+                          sizeof(page_batch_reply_entry_t);
+        case MSG_RMA_REQUEST:
+            return size + (msg->payload.rma_request.num_segments <= RMA_MAX_SEGMENTS ?
+                           msg->payload.rma_request.num_segments : RMA_MAX_SEGMENTS) *
+                          sizeof(rma_segment_t);
+        case MSG_RMA_REPLY:
+            return size + (msg->payload.rma_reply.num_results <= RMA_MAX_SEGMENTS ?
+                           msg->payload.rma_reply.num_results : RMA_MAX_SEGMENTS) *
+                          sizeof(rma_result_t);
+        default:                  return size;
+    }
+}
+
+int serialize_message(const message_t *msg, uint8_t *buffer, size_t *len) {
+    if (!msg || !buffer || !len) {
+        return DSM_ERROR_INVALID;
+    }
+
+    /* Header and payloads are packed, so the wire format is simply the
+     * header followed by the first payload_size bytes of the payload union */
+    size_t payload_size = message_wire_payload_size(msg);
+    if (payload_size == (size_t)-1) {
+        LOG_WARN("Unknown message type: %d", msg->header.type);
+        return DSM_ERROR_INVALID;
     }
 
-    *len = offset;
+    memcpy(buffer, &msg->header, sizeof(msg_header_t));
+    memcpy(buffer + sizeof(msg_header_t), &msg->payload, payload_size);
+
+    *len = sizeof(msg_header_t) + payload_size;
     return DSM_SUCCESS;
 }
 
@@ -352,7 +524,7 @@ int deserialize_message(const uint8_t *buffer, size_t len, message_t *msg) {
     }
 
     /* Validate message type */
-    if (msg->header.type < 1 || msg->header.type > MSG_RECONNECT_REQUEST) {
+    if (msg->header.type < 1 || msg->header.type > MSG_TYPE_MAX) {
         LOG_ERROR("Invalid message type: %d", msg->header.type);
         return DSM_ERROR_INVALID;
     }
@@ -366,21 +538,30 @@ int deserialize_message(const uint8_t *buffer, size_t len, message_t *msg) {
     return DSM_SUCCESS;
 }
 
-int network_send(node_id_t dest, message_t *msg) {
-    if (!msg || dest >= MAX_NODES) {
-        return DSM_ERROR_INVALID;
-    }
+/* Maximum messages a peer's sender thread coalesces into one sendmsg() */
+#define SEND_BATCH_MAX 64
 
-    dsm_context_t *ctx = dsm_get_context();
+/* Sender threads poll their queue at this interval to notice shutdown */
+#define SENDER_POLL_MS 100
+/* Maximum events handled per epoll_wait() wakeup */
+#define DISPATCH_MAX_EVENTS 64
 
-    /* Assign sequence number atomically for message tracking and debugging */
-    pthread_mutex_lock(&ctx->network.seq_lock);
-    msg->header.seq_num = ctx->network.next_seq_num++;
-    pthread_mutex_unlock(&ctx->network.seq_lock);
+/**
+ * Check that dest is reachable and return its socket
+ * A worker that is not connected is reached over its peer link, if any.
+ */
+static int get_peer_socket(node_id_t dest, int *sockfd) {
+    dsm_context_t *ctx = dsm_get_context();
 
     pthread_mutex_lock(&ctx->lock);
-    if (!ctx->network.nodes[dest].connected) {
+    node_info_t *node = &ctx->network.nodes[dest];
+    if (!node->connected) {
+        int link_fd = node->peer_failed ? -1 : node->peer_sockfd;
         pthread_mutex_unlock(&ctx->lock);
+        if (link_fd >= 0) {
+            *sockfd = link_fd;
+            return DSM_SUCCESS;
+        }
         LOG_ERROR("Node %u not connected", dest);
         return DSM_ERROR_NETWORK;
     }
@@ -392,41 +573,151 @@ int network_send(node_id_t dest, message_t *msg) {
         return DSM_ERROR_NETWORK;
     }
 
-    int sockfd = ctx->network.nodes[dest].sockfd;
+    *sockfd = ctx->network.nodes[dest].sockfd;
     pthread_mutex_unlock(&ctx->lock);
+    return DSM_SUCCESS;
+}
+
+static void assign_seq_num(message_t *msg) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    /* Assign sequence number atomically for message tracking and debugging */
+    pthread_mutex_lock(&ctx->network.seq_lock);
+    msg->header.seq_num = ctx->network.next_seq_num++;
+    pthread_mutex_unlock(&ctx->network.seq_lock);
+}
+
+/**
+ * Socket a message to peer is written to (caller holds the peer's send_lock)
+ *
+ * Once the peer has lanes, messages with a shard key are spread over
+ * them by that key, so all messages for one page, lock or barrier stay
+ * in order on one stream while unrelated ones do not queue behind each
+ * other. Membership, heartbeat and replication traffic keeps the main
+ * socket.
+ */
+static int lane_socket_locked(const node_info_t *peer, const message_t *msg, int sockfd) {
+    if (!peer->lanes_tx || peer->num_lanes == 0) {
+        return sockfd;
+    }
+    int lane = handler_pool_message_shard(msg, peer->num_lanes);
+    return lane < 0 ? sockfd : peer->lane_fds[lane];
+}
 
-    /* Serialize message to get payload */
-    uint8_t msg_buffer[8192];
-    size_t msg_len;
-    if (serialize_message(msg, msg_buffer, &msg_len) != DSM_SUCCESS) {
+/**
+ * Build the iovec for one framed message
+ *
+ * The iovec is {length prefix, header, payload}, pointing straight at the
+ * caller's message so nothing is copied in user space. When page_data is
+ * non-NULL the message must be a PAGE_REPLY; its data[] field is taken from
+ * page_data (typically entry->local_addr) instead of the message itself,
+ * for as many bytes as page_reply_data_len() says go on the wire.
+ * bulk_len bytes of bulk data, added by the caller after the returned
+ * entries, are counted in the length prefix.
+ *
+ * @param msg Message to frame
+ * @param page_data Optional out-of-line page bytes for PAGE_REPLY
+ * @param bulk_len Bytes of bulk data following the payload
+ * @param prefix Storage for the 4-byte length prefix (must outlive the send)
+ * @param iov Output iovec (at least 4 entries)
+ * @param len Output: total frame length in bytes
+ * @return Number of iovec entries used, or DSM_ERROR_INVALID
+ */
+static int build_frame_iov(const message_t *msg, const void *page_data, size_t bulk_len,
+                           uint8_t prefix[4], struct iovec *iov, size_t *len) {
+    size_t payload_size = message_wire_payload_size(msg);
+    if (payload_size == (size_t)-1) {
+        LOG_WARN("Unknown message type: %d", msg->header.type);
         return DSM_ERROR_INVALID;
     }
 
     /* CRITICAL FIX: Add length prefix for proper TCP message framing
      * This prevents message boundary loss when multiple messages arrive together */
-    uint8_t buffer[8196];  /* 4 bytes for length + 8192 for message */
-    uint32_t length_prefix = (uint32_t)msg_len;
+    uint32_t length_prefix = (uint32_t)(sizeof(msg_header_t) + payload_size + bulk_len);
+    prefix[0] = (length_prefix >> 24) & 0xFF;
+    prefix[1] = (length_prefix >> 16) & 0xFF;
+    prefix[2] = (length_prefix >> 8) & 0xFF;
+    prefix[3] = length_prefix & 0xFF;
+
+    int iovcnt = 0;
+    iov[iovcnt].iov_base = prefix;
+    iov[iovcnt++].iov_len = 4;
+    iov[iovcnt].iov_base = (void*)&msg->header;
+    iov[iovcnt++].iov_len = sizeof(msg_header_t);
+
+    if (page_data && msg->header.type == MSG_PAGE_REPLY) {
+        /* Page metadata from the message, page bytes straight from the page */
+        iov[iovcnt].iov_base = (void*)&msg->payload;
+        iov[iovcnt++].iov_len = offsetof(page_reply_payload_t, data);
+        size_t data_len = page_reply_data_len(msg);
+        if (data_len > 0) {
+            iov[iovcnt].iov_base = (void*)page_data;
+            iov[iovcnt++].iov_len = data_len;
+        }
+    } else if (payload_size > 0) {
+        iov[iovcnt].iov_base = (void*)&msg->payload;
+        iov[iovcnt++].iov_len = payload_size;
+    }
+
+    *len = 4 + length_prefix;  /* Total: 4-byte prefix + message */
+    return iovcnt;
+}
 
-    /* Write length prefix (network byte order) */
-    buffer[0] = (length_prefix >> 24) & 0xFF;
-    buffer[1] = (length_prefix >> 16) & 0xFF;
-    buffer[2] = (length_prefix >> 8) & 0xFF;
-    buffer[3] = length_prefix & 0xFF;
+/**
+ * Write a complete iovec to a peer socket
+ *
+ * Caller must hold the peer's send_lock so frames from concurrent senders
+ * are never interleaved on the stream. Once the peer's connection has
+ * moved to a transport backend the frames are written there instead.
+ *
+ * @param dest Destination node (for error reporting / disconnect)
+ * @param sockfd Peer socket
+ * @param iov iovec to send (modified on partial writes)
+ * @param iovcnt Number of iovec entries
+ * @param len Total bytes described by iov
+ * @param frames Frames described by iov, for the peer's traffic counters
+ * @return DSM_SUCCESS or DSM_ERROR_NETWORK
+ */
+static int write_iov_locked(node_id_t dest, int sockfd, struct iovec *iov, int iovcnt, size_t len,
+                            int frames) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    /* Any frame tells the peer we are alive: no heartbeat needed for a while */
+    __atomic_store_n(&ctx->network.nodes[dest].last_send_time, perf_get_timestamp_ns(), __ATOMIC_RELAXED);
+
+    /* A connection moved to a backend writes there; the socket carried
+     * frames up to the TRANSPORT_CONNECT handshake only */
+    transport_conn_t *conn = ctx->network.nodes[dest].transport;
+    if (conn) {
+        int rc = conn->ops->send_iov(conn, iov, iovcnt, len);
+        if (rc != DSM_SUCCESS) {
+            LOG_ERROR("Send to node %u over %s failed", dest, conn->ops->name);
+            perf_log_network_failure();
+        } else {
+            stats_peer_sent(dest, (uint64_t)frames, len);
+        }
+        return rc;
+    }
 
-    /* Copy message after length prefix */
-    memcpy(buffer + 4, msg_buffer, msg_len);
-    size_t len = msg_len + 4;  /* Total: 4-byte prefix + message */
+    /* A broken peer link sends later frames through the manager; a broken
+     * connection is the heartbeat's to deal with */
+    bool peer_link = sockfd == ctx->network.nodes[dest].peer_sockfd;
 
     /* Task 8.4: Network failure handling with retries */
     const int MAX_RETRIES = 3;
     const int RETRY_DELAY_MS = 100;  /* 100ms delay between retries */
     int retry_count = 0;
 
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    mh.msg_iovlen = iovcnt;
+
+    size_t total_sent = 0;
     while (retry_count < MAX_RETRIES) {
-        /* Send with full data transmission */
-        size_t total_sent = 0;
+        /* Send with full data transmission, advancing the iovec on partial writes */
         while (total_sent < len) {
-            ssize_t sent = send(sockfd, buffer + total_sent, len - total_sent, MSG_NOSIGNAL);
+            ssize_t sent = sendmsg(sockfd, &mh, MSG_NOSIGNAL);
 
             if (sent < 0) {
                 /* Handle different error types */
@@ -434,15 +725,24 @@ int network_send(node_id_t dest, message_t *msg) {
                     /* Interrupted by signal, retry immediately */
                     continue;
                 } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                    /* Would block, wait and retry */
-                    struct timespec wait = {0, RETRY_DELAY_MS * 1000000};
-                    nanosleep(&wait, NULL);
-                    continue;
+                    /* Socket buffer full: wait for room, up to the send timeout */
+                    struct pollfd pfd = { .fd = sockfd, .events = POLLOUT };
+                    int ready = poll(&pfd, 1, SEND_TIMEOUT_MS);
+                    if (ready > 0 || (ready < 0 && errno == EINTR)) {
+                        continue;
+                    }
+                    LOG_WARN("Send to node %u timed out (attempt %d/%d)",
+                             dest, retry_count + 1, MAX_RETRIES);
+                    break;  /* Exit inner loop to retry */
                 } else if (errno == EPIPE || errno == ECONNRESET) {
                     /* Connection broken, mark as disconnected */
                     LOG_ERROR("Connection to node %u broken: %s", dest, strerror(errno));
                     pthread_mutex_lock(&ctx->lock);
-                    ctx->network.nodes[dest].connected = false;
+                    if (peer_link) {
+                        ctx->network.nodes[dest].peer_failed = true;
+                    } else {
+                        ctx->network.nodes[dest].connected = false;
+                    }
                     pthread_mutex_unlock(&ctx->lock);
                     return DSM_ERROR_NETWORK;
                 } else {
@@ -455,21 +755,42 @@ int network_send(node_id_t dest, message_t *msg) {
                 /* Connection closed */
                 LOG_ERROR("Connection to node %u closed", dest);
                 pthread_mutex_lock(&ctx->lock);
-                ctx->network.nodes[dest].connected = false;
+                if (peer_link) {
+                    ctx->network.nodes[dest].peer_failed = true;
+                } else {
+                    ctx->network.nodes[dest].connected = false;
+                }
                 pthread_mutex_unlock(&ctx->lock);
                 return DSM_ERROR_NETWORK;
             } else {
-                /* Successful send */
+                /* Successful send: skip fully written iovecs, trim the partial one */
                 total_sent += sent;
+                size_t advance = (size_t)sent;
+                while (mh.msg_iovlen > 0 && advance >= mh.msg_iov[0].iov_len) {
+                    advance -= mh.msg_iov[0].iov_len;
+                    mh.msg_iov++;
+                    mh.msg_iovlen--;
+                }
+                if (mh.msg_iovlen > 0) {
+                    mh.msg_iov[0].iov_base = (uint8_t*)mh.msg_iov[0].iov_base + advance;
+                    mh.msg_iov[0].iov_len -= advance;
+                }
             }
         }
 
         /* Check if we sent all data successfully */
         if (total_sent == len) {
-            LOG_DEBUG("Sent message type=%d to node %u (%zu bytes)", msg->header.type, dest, len);
+            stats_peer_sent(dest, (uint64_t)frames, len);
             return DSM_SUCCESS;
         }
 
+        /* A partially written frame cannot be resent without corrupting the
+         * stream, so only retry when nothing went out */
+        if (total_sent > 0) {
+            LOG_ERROR("Partial send to node %u (%zu/%zu bytes)", dest, total_sent, len);
+            break;
+        }
+
         /* Retry after delay */
         retry_count++;
         if (retry_count < MAX_RETRIES) {
@@ -486,133 +807,1371 @@ int network_send(node_id_t dest, message_t *msg) {
     return DSM_ERROR_NETWORK;
 }
 
-int network_recv(int sockfd, message_t *msg) {
-    if (sockfd < 0 || !msg) {
-        return DSM_ERROR_INVALID;
+/**
+ * Write everything currently queued for a peer, coalescing up to
+ * SEND_BATCH_MAX frames per sendmsg() call
+ *
+ * Caller must hold the peer's send_lock. Because every dequeue happens
+ * under send_lock immediately before the write, async and synchronous
+ * messages to one peer leave in the order they were issued.
+ *
+ * @return DSM_SUCCESS, or DSM_ERROR_NETWORK if a batch could not be written
+ */
+static int flush_send_queue_locked(node_id_t dest, int sockfd) {
+    node_info_t *peer = &dsm_get_context()->network.nodes[dest];
+    msg_queue_t *queue = peer->send_queue;
+    if (!queue) {
+        return DSM_SUCCESS;
     }
 
-    /* CRITICAL FIX: Read length prefix first (4 bytes, network byte order)
-     * This ensures we read exactly one complete message, handling TCP streaming correctly */
-    uint8_t length_buf[4];
-    size_t total_read = 0;
+    int result = DSM_SUCCESS;
+    msg_queue_entry_t *batch[SEND_BATCH_MAX];
+    int n;
+
+    while ((n = msg_queue_dequeue_batch(queue, batch, SEND_BATCH_MAX)) > 0) {
+        /* One sendmsg() per run of frames bound for the same lane */
+        for (int start = 0; start < n;) {
+            struct iovec iov[SEND_BATCH_MAX * 3];
+            uint8_t prefixes[SEND_BATCH_MAX][4];
+            int iovcnt = 0;
+            size_t len = 0;
+            int fd = lane_socket_locked(peer, &batch[start]->msg, sockfd);
+            int end = start;
+            int frames = 0;
+
+            while (end < n && lane_socket_locked(peer, &batch[end]->msg, sockfd) == fd) {
+                size_t frame_len;
+                int cnt = build_frame_iov(&batch[end]->msg, NULL, 0, prefixes[end - start],
+                                          &iov[iovcnt], &frame_len);
+                if (cnt > 0) {
+                    iovcnt += cnt;
+                    len += frame_len;
+                    frames++;
+                }
+                end++;
+            }
 
-    /* Read exactly 4 bytes for length prefix */
-    while (total_read < 4) {
-        ssize_t n = recv(sockfd, length_buf + total_read, 4 - total_read, 0);
-        if (n <= 0) {
-            if (n == 0) {
-                LOG_DEBUG("Connection closed (sockfd=%d)", sockfd);
-            } else {
-                LOG_ERROR("Recv failed reading length: %s", strerror(errno));
+            if (result == DSM_SUCCESS && iovcnt > 0) {
+                result = write_iov_locked(dest, fd, iov, iovcnt, len, frames);
+                if (result == DSM_SUCCESS) {
+                    LOG_DEBUG("Sent %d coalesced messages to node %u (%zu bytes)", end - start, dest, len);
+                } else {
+                    LOG_ERROR("Dropping %d queued messages for node %u", end - start, dest);
+                }
             }
-            return DSM_ERROR_NETWORK;
+            start = end;
+        }
+
+        for (int i = 0; i < n; i++) {
+            msg_pool_put(batch[i]);
         }
-        total_read += n;
     }
 
-    /* Decode length (network byte order to host) */
-    uint32_t msg_len = ((uint32_t)length_buf[0] << 24) |
-                       ((uint32_t)length_buf[1] << 16) |
-                       ((uint32_t)length_buf[2] << 8) |
-                       ((uint32_t)length_buf[3]);
+    return result;
+}
 
-    /* Validate message length */
-    if (msg_len == 0 || msg_len > 8192) {
-        LOG_ERROR("Invalid message length: %u", msg_len);
+/**
+ * Frame one message and write it to the lane it belongs on
+ * Caller holds the peer's send_lock.
+ */
+static int write_frame_locked(node_id_t dest, int sockfd, const message_t *msg, const void *page_data,
+                              const struct iovec *bulk, int num_bulk, size_t bulk_len) {
+    node_info_t *peer = &dsm_get_context()->network.nodes[dest];
+
+    uint8_t prefix[4];
+    struct iovec iov[4 + PAGE_BATCH_MAX];
+    size_t len;
+    int iovcnt = build_frame_iov(msg, page_data, bulk_len, prefix, iov, &len);
+    if (iovcnt < 0) {
         return DSM_ERROR_INVALID;
     }
-
-    /* Read exactly msg_len bytes for the message payload */
-    uint8_t buffer[8192];
-    total_read = 0;
-
-    while (total_read < msg_len) {
-        ssize_t n = recv(sockfd, buffer + total_read, msg_len - total_read, 0);
-        if (n <= 0) {
-            if (n == 0) {
-                LOG_DEBUG("Connection closed while reading message (sockfd=%d)", sockfd);
-            } else {
-                LOG_ERROR("Recv failed reading message: %s", strerror(errno));
-            }
-            return DSM_ERROR_NETWORK;
+    for (int i = 0; i < num_bulk; i++) {
+        if (bulk[i].iov_len > 0) {
+            iov[iovcnt++] = bulk[i];
         }
-        total_read += n;
     }
 
-    return deserialize_message(buffer, msg_len, msg);
+    int rc = write_iov_locked(dest, lane_socket_locked(peer, msg, sockfd), iov, iovcnt, len, 1);
+    if (rc == DSM_SUCCESS) {
+        LOG_DEBUG("Sent message type=%d to node %u (%zu bytes)", msg->header.type, dest, len);
+    }
+    return rc;
 }
 
-int network_start_dispatcher(void) {
-    dsm_context_t *ctx = dsm_get_context();
+/**
+ * Append the bytes [off, off + len) of a segment list to out, merging
+ * pieces that are adjacent in memory
+ *
+ * @return New number of entries in out, or -1 if more than max are needed
+ */
+static int iov_slice(const struct iovec *src, int num_src, size_t off, size_t len,
+                     struct iovec *out, int num_out, int max) {
+    for (int i = 0; i < num_src && len > 0; i++) {
+        if (off >= src[i].iov_len) {
+            off -= src[i].iov_len;
+            continue;
+        }
 
-    if (pthread_create(&ctx->network.dispatcher_thread, NULL, dispatcher_thread, NULL) != 0) {
+        uint8_t *base = (uint8_t*)src[i].iov_base + off;
+        size_t n = src[i].iov_len - off < len ? src[i].iov_len - off : len;
+        if (num_out > 0 && (uint8_t*)out[num_out - 1].iov_base + out[num_out - 1].iov_len == base) {
+            out[num_out - 1].iov_len += n;
+        } else if (num_out < max) {
+            out[num_out].iov_base = base;
+            out[num_out].iov_len = n;
+            num_out++;
+        } else {
+            return -1;
+        }
+        off = 0;
+        len -= n;
+    }
+    return num_out;
+}
+
+/**
+ * Write a PAGE_BATCH_REQUEST or PAGE_BATCH_REPLY as one frame per lane
+ * its pages map to, so each page stays on its lane like a single-page
+ * message would. The receiver handles batches page by page, so the
+ * parts mean what the whole batch did.
+ * Caller holds the peer's send_lock and has checked lanes_tx.
+ */
+static int write_batch_by_lane_locked(node_id_t dest, int sockfd, const message_t *msg,
+                                      const struct iovec *bulk, int num_bulk) {
+    node_info_t *peer = &dsm_get_context()->network.nodes[dest];
+    bool is_reply = msg->header.type == MSG_PAGE_BATCH_REPLY;
+    int num_pages = is_reply ? msg->payload.page_batch_reply.num_pages
+                             : msg->payload.page_batch_request.num_pages;
+    if (num_pages > PAGE_BATCH_MAX) {
+        num_pages = PAGE_BATCH_MAX;
+    }
+
+    int lanes[PAGE_BATCH_MAX];
+    size_t offsets[PAGE_BATCH_MAX];
+    size_t off = 0;
+    for (int i = 0; i < num_pages; i++) {
+        page_id_t page_id = is_reply ? msg->payload.page_batch_reply.pages[i].page_id
+                                     : msg->payload.page_batch_request.pages[i].page_id;
+        lanes[i] = handler_pool_key_shard(page_id, peer->num_lanes);
+        offsets[i] = off;
+        if (is_reply) {
+            off += msg->payload.page_batch_reply.pages[i].data_len;
+        }
+    }
+
+    int rc = DSM_SUCCESS;
+    for (int lane = 0; lane < peer->num_lanes && rc == DSM_SUCCESS; lane++) {
+        message_t part;
+        part.header = msg->header;
+        struct iovec data[PAGE_BATCH_MAX];
+        int num_data = 0;
+        size_t data_len = 0;
+        int count = 0;
+
+        if (is_reply) {
+            part.payload.page_batch_reply.requester = msg->payload.page_batch_reply.requester;
+        } else {
+            part.payload.page_batch_request.requester = msg->payload.page_batch_request.requester;
+            part.payload.page_batch_request.accept_encodings =
+                msg->payload.page_batch_request.accept_encodings;
+        }
+
+        for (int i = 0; i < num_pages; i++) {
+            if (lanes[i] != lane) {
+                continue;
+            }
+            if (!is_reply) {
+                part.payload.page_batch_request.pages[count++] = msg->payload.page_batch_request.pages[i];
+                continue;
+            }
+
+            const page_batch_reply_entry_t *entry = &msg->payload.page_batch_reply.pages[i];
+            part.payload.page_batch_reply.pages[count++] = *entry;
+            num_data = iov_slice(bulk, num_bulk, offsets[i], entry->data_len,
+                                 data, num_data, PAGE_BATCH_MAX);
+            if (num_data < 0) {
+                return DSM_ERROR_INVALID;
+            }
+            data_len += entry->data_len;
+        }
+        if (count == 0) {
+            continue;
+        }
+
+        if (is_reply) {
+            part.payload.page_batch_reply.num_pages = (uint16_t)count;
+        } else {
+            part.payload.page_batch_request.num_pages = (uint16_t)count;
+        }
+        rc = write_frame_locked(dest, sockfd, &part, NULL, data, num_data, data_len);
+    }
+    return rc;
+}
+
+/**
+ * Frame and send one message, optionally moving the peer's later frames
+ * to another transport
+ *
+ * @param switch_tx Move later frames to conn once this one is written
+ *                  (under the same send_lock, so no frame falls between)
+ * @param conn Transport connection for switch_tx (NULL = the socket)
+ */
+static int network_send_frame(node_id_t dest, message_t *msg, const void *page_data,
+                              const struct iovec *bulk, int num_bulk,
+                              bool switch_tx, transport_conn_t *conn) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    if (!msg || dest >= (node_id_t)ctx->network.max_nodes ||
+        num_bulk < 0 || num_bulk > PAGE_BATCH_MAX) {
+        return DSM_ERROR_INVALID;
+    }
+
+    size_t bulk_len = 0;
+    for (int i = 0; i < num_bulk; i++) {
+        bulk_len += bulk[i].iov_len;
+    }
+    if (bulk_len > MSG_MAX_BULK_DATA) {
+        return DSM_ERROR_INVALID;
+    }
+
+    /* Replication changes this frame may reveal reach the backup first */
+    if (msg->header.type != MSG_STATE_SYNC_BATCH) {
+        replication_commit();
+    }
+
+    assign_seq_num(msg);
+
+    int sockfd;
+    int rc = get_peer_socket(dest, &sockfd);
+    if (rc != DSM_SUCCESS) {
+        return rc;
+    }
+
+    node_info_t *peer = &ctx->network.nodes[dest];
+    pthread_mutex_lock(&peer->send_lock);
+
+    /* Anything queued asynchronously for this peer goes out first */
+    flush_send_queue_locked(dest, sockfd);
+    if (peer->lanes_tx && !peer->transport &&
+        (msg->header.type == MSG_PAGE_BATCH_REQUEST || msg->header.type == MSG_PAGE_BATCH_REPLY)) {
+        rc = write_batch_by_lane_locked(dest, sockfd, msg, bulk, num_bulk);
+    } else {
+        rc = write_frame_locked(dest, sockfd, msg, page_data, bulk, num_bulk, bulk_len);
+    }
+    if (switch_tx && rc == DSM_SUCCESS) {
+        peer->transport = conn;
+    }
+
+    pthread_mutex_unlock(&peer->send_lock);
+    return rc;
+}
+
+int network_send(node_id_t dest, message_t *msg) {
+    return network_send_frame(dest, msg, NULL, NULL, 0, false, NULL);
+}
+
+int network_send_page(node_id_t dest, message_t *msg, const void *page_data) {
+    if (!page_data || !msg || msg->header.type != MSG_PAGE_REPLY) {
+        return DSM_ERROR_INVALID;
+    }
+
+    /* A block that does not fit in data[] follows the payload as bulk data */
+    size_t block_len = page_reply_bulk_len(msg);
+    if (block_len > 0) {
+        struct iovec block = { .iov_base = (void*)page_data, .iov_len = block_len };
+        return network_send_frame(dest, msg, NULL, &block, 1, false, NULL);
+    }
+    return network_send_frame(dest, msg, page_data, NULL, 0, false, NULL);
+}
+
+int network_send_bulk(node_id_t dest, message_t *msg, const struct iovec *data, int num_data) {
+    if (!msg || (msg->header.type != MSG_PAGE_BATCH_REPLY && msg->header.type != MSG_STATE_SYNC_BATCH &&
+                 msg->header.type != MSG_RMA_REQUEST && msg->header.type != MSG_RMA_REPLY &&
+                 msg->header.type != MSG_BARRIER_ARRIVE && msg->header.type != MSG_BARRIER_RELEASE &&
+                 msg->header.type != MSG_NODE_ROSTER) ||
+        (num_data > 0 && !data)) {
+        return DSM_ERROR_INVALID;
+    }
+    return network_send_frame(dest, msg, NULL, data, num_data, false, NULL);
+}
+
+/**
+ * Per-peer sender thread: drains the peer's send_queue, coalescing
+ * whatever has accumulated into as few sendmsg() calls as possible
+ */
+static void* sender_thread(void *arg) {
+    node_id_t dest = (node_id_t)(uintptr_t)arg;
+    dsm_context_t *ctx = dsm_get_context();
+    node_info_t *peer = &ctx->network.nodes[dest];
+
+    LOG_DEBUG("Sender thread for node %u started", dest);
+
+    while (true) {
+        int pending = msg_queue_wait(peer->send_queue, SENDER_POLL_MS);
+
+        pthread_mutex_lock(&ctx->lock);
+        bool running = ctx->network.senders_running;
+        pthread_mutex_unlock(&ctx->lock);
+
+        if (pending == 0) {
+            if (!running) {
+                break;
+            }
+            continue;
+        }
+
+        int sockfd;
+        if (get_peer_socket(dest, &sockfd) != DSM_SUCCESS) {
+            /* Peer is gone: discard what was queued for it */
+            msg_queue_entry_t *batch[SEND_BATCH_MAX];
+            int n;
+            while ((n = msg_queue_dequeue_batch(peer->send_queue, batch, SEND_BATCH_MAX)) > 0) {
+                for (int i = 0; i < n; i++) {
+                    msg_pool_put(batch[i]);
+                }
+                LOG_WARN("Discarded %d queued messages for unreachable node %u", n, dest);
+            }
+            continue;
+        }
+
+        pthread_mutex_lock(&peer->send_lock);
+        flush_send_queue_locked(dest, sockfd);
+        pthread_mutex_unlock(&peer->send_lock);
+    }
+
+    LOG_DEBUG("Sender thread for node %u stopped", dest);
+    return NULL;
+}
+
+int network_send_async(node_id_t dest, message_t *msg) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    if (!msg || dest >= (node_id_t)ctx->network.max_nodes || msg->header.type == MSG_PAGE_REPLY) {
+        /* PAGE_REPLY carries 4KB of data and is always sent synchronously */
+        return DSM_ERROR_INVALID;
+    }
+
+    node_info_t *peer = &ctx->network.nodes[dest];
+
+    int sockfd;
+    int rc = get_peer_socket(dest, &sockfd);
+    if (rc != DSM_SUCCESS) {
+        return rc;
+    }
+    (void)sockfd;
+
+    /* Start this peer's sender thread on first use */
+    pthread_mutex_lock(&ctx->lock);
+    if (!peer->sender_started) {
+        ctx->network.senders_running = true;
+        if (pthread_create(&peer->sender_thread, NULL, sender_thread,
+                           (void*)(uintptr_t)dest) != 0) {
+            pthread_mutex_unlock(&ctx->lock);
+            LOG_WARN("Failed to start sender thread for node %u, sending synchronously", dest);
+            return network_send(dest, msg);
+        }
+        peer->sender_started = true;
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    replication_commit();
+    assign_seq_num(msg);
+    return msg_queue_enqueue(peer->send_queue, msg, dest);
+}
+
+void network_stop_senders(void) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->network.senders_running = false;
+    pthread_mutex_unlock(&ctx->lock);
+
+    /* Each sender drains its queue before noticing the flag */
+    for (int i = 0; i < ctx->network.max_nodes; i++) {
+        pthread_mutex_lock(&ctx->lock);
+        bool started = ctx->network.nodes[i].sender_started;
+        pthread_t thread = ctx->network.nodes[i].sender_thread;
+        ctx->network.nodes[i].sender_started = false;
+        pthread_mutex_unlock(&ctx->lock);
+
+        if (started) {
+            pthread_join(thread, NULL);
+        }
+    }
+}
+
+/**
+ * Where a frame is read from: bytes the dispatcher already read off
+ * sockfd, a transport connection, or a blocking socket
+ */
+typedef struct {
+    int sockfd;
+    transport_conn_t *conn;    /**< Transport to read from (NULL = sockfd) */
+    const uint8_t *buf;        /**< Buffered frame bytes not consumed yet (NULL = none) */
+    size_t buf_left;           /**< Bytes left at buf */
+} frame_source_t;
+
+/**
+ * Read exactly len bytes into buf from src
+ */
+static int recv_exact(frame_source_t *src, void *buf, size_t len, const char *what) {
+    if (src->buf) {
+        if (len > src->buf_left) {
+            LOG_ERROR("Frame ends while reading %s (sockfd=%d)", what, src->sockfd);
+            return DSM_ERROR_NETWORK;
+        }
+        memcpy(buf, src->buf, len);
+        src->buf += len;
+        src->buf_left -= len;
+        return DSM_SUCCESS;
+    }
+
+    transport_conn_t *conn = src->conn;
+    int sockfd = src->sockfd;
+    if (conn) {
+        int rc = conn->ops->recv_exact(conn, buf, len);
+        if (rc != DSM_SUCCESS) {
+            LOG_ERROR("Recv over %s failed reading %s (node %u)", conn->ops->name, what, conn->peer);
+        }
+        return rc;
+    }
+
+    size_t total_read = 0;
+    while (total_read < len) {
+        ssize_t n = recv(sockfd, (uint8_t*)buf + total_read, len - total_read, 0);
+        if (n <= 0) {
+            if (n == 0) {
+                LOG_DEBUG("Connection closed while reading %s (sockfd=%d)", what, sockfd);
+            } else if (errno == EINTR) {
+                continue;
+            } else {
+                LOG_ERROR("Recv failed reading %s: %s", what, strerror(errno));
+            }
+            return DSM_ERROR_NETWORK;
+        }
+        total_read += n;
+    }
+    return DSM_SUCCESS;
+}
+
+/**
+ * Decode and validate a frame's length prefix
+ */
+static int decode_frame_length(const uint8_t length_buf[4], uint32_t *length) {
+    /* Decode length (network byte order to host) */
+    uint32_t msg_len = ((uint32_t)length_buf[0] << 24) |
+                       ((uint32_t)length_buf[1] << 16) |
+                       ((uint32_t)length_buf[2] << 8) |
+                       ((uint32_t)length_buf[3]);
+
+    /* Validate message length (bulk frames may exceed message_t) */
+    if (msg_len < sizeof(msg_header_t) || msg_len > MSG_MAX_FRAME_SIZE) {
+        LOG_ERROR("Invalid message length: %u", msg_len);
+        return DSM_ERROR_INVALID;
+    }
+
+    *length = msg_len;
+    return DSM_SUCCESS;
+}
+
+static int recv_frame_length(frame_source_t *src, uint32_t *length) {
+    /* CRITICAL FIX: Read length prefix first (4 bytes, network byte order)
+     * This ensures we read exactly one complete message, handling TCP streaming correctly */
+    uint8_t length_buf[4];
+    if (recv_exact(src, length_buf, 4, "length") != DSM_SUCCESS) {
+        return DSM_ERROR_NETWORK;
+    }
+    return decode_frame_length(length_buf, length);
+}
+
+/**
+ * Read the rest of a frame of msg_len bytes into msg, whose payload holds
+ * capacity bytes
+ */
+static int recv_frame_body(frame_source_t *src, uint32_t msg_len,
+                           message_t *msg, size_t capacity, uint8_t **bulk, size_t *bulk_len) {
+    if (bulk) {
+        *bulk = NULL;
+        *bulk_len = 0;
+    }
+
+    /* Read header and payload straight into the message (no staging buffer) */
+    if (recv_exact(src, &msg->header, sizeof(msg_header_t), "header") != DSM_SUCCESS) {
+        return DSM_ERROR_NETWORK;
+    }
+
+    size_t remaining = msg_len - sizeof(msg_header_t);
+    size_t inline_len = remaining;
+    size_t got = 0;
+
+    /* A bulk frame's payload is sized by fields that come first (page
+     * count, block size); everything after the payload is bulk data */
+    size_t fixed = bulk_frame_fixed_size(msg->header.type);
+    if (fixed > 0 && remaining >= fixed) {
+        if (recv_exact(src, &msg->payload, fixed, "message") != DSM_SUCCESS) {
+            return DSM_ERROR_NETWORK;
+        }
+        got = fixed;
+        inline_len = message_wire_payload_size(msg);
+        if (inline_len > remaining) {
+            inline_len = remaining;
+        }
+    }
+
+    if (inline_len > capacity) {
+        LOG_ERROR("Invalid message length: %u", msg_len);
+        return DSM_ERROR_INVALID;
+    }
+    if (inline_len > got &&
+        recv_exact(src, (uint8_t*)&msg->payload + got, inline_len - got, "message") != DSM_SUCCESS) {
+        return DSM_ERROR_NETWORK;
+    }
+
+    uint8_t *data = NULL;
+    size_t data_len = remaining - inline_len;
+    if (data_len > 0) {
+        data = malloc(data_len);
+        if (!data) {
+            LOG_ERROR("Out of memory for %zu bytes of bulk data", data_len);
+            return DSM_ERROR_MEMORY;
+        }
+        if (recv_exact(src, data, data_len, "bulk data") != DSM_SUCCESS) {
+            free(data);
+            return DSM_ERROR_NETWORK;
+        }
+    }
+
+    /* CRITICAL: Validate magic number to detect corruption
+     * This prevents processing of corrupted or malformed messages.
+     * Checked after the whole frame is consumed so the stream stays in sync */
+    int rc = DSM_SUCCESS;
+    if (msg->header.magic != MSG_MAGIC) {
+        LOG_ERROR("Invalid magic number: expected 0x%X, got 0x%X",
+                  MSG_MAGIC, msg->header.magic);
+        rc = DSM_ERROR_INVALID;
+    } else if (msg->header.type < 1 || msg->header.type > MSG_TYPE_MAX) {
+        /* Validate message type */
+        LOG_ERROR("Invalid message type: %d", msg->header.type);
+        rc = DSM_ERROR_INVALID;
+    } else if (inline_len < (fixed > 0 ? fixed : message_payload_size(msg->header.type)) ||
+               inline_len < message_wire_payload_size(msg)) {
+        /* The fixed fields (which size the rest, and which a pooled entry
+         * may not hold beyond the frame), then the variable-length node
+         * lists, must be fully present in the frame */
+        LOG_ERROR("Truncated payload for message type %d: %zu bytes", msg->header.type, inline_len);
+        rc = DSM_ERROR_INVALID;
+    } else if (msg->header.type == MSG_PAGE_REPLY && data_len != page_reply_bulk_len(msg)) {
+        LOG_ERROR("PAGE_REPLY for page %lu with %zu bulk bytes, expected %zu",
+                  msg->payload.page_reply.page_id, data_len, page_reply_bulk_len(msg));
+        rc = DSM_ERROR_INVALID;
+    } else if (data && !bulk) {
+        LOG_ERROR("Unexpected bulk frame (message type %d, %zu data bytes)",
+                  msg->header.type, data_len);
+        rc = DSM_ERROR_INVALID;
+    }
+
+    if (rc != DSM_SUCCESS) {
+        free(data);
+        return rc;
+    }
+    if (bulk) {
+        *bulk = data;
+        *bulk_len = data_len;
+    }
+    return DSM_SUCCESS;
+}
+
+/**
+ * Read the msg_len bytes of a frame that follow its length prefix into a
+ * pooled entry sized by that length
+ * The frame's bulk data, if any, becomes the entry's data.
+ *
+ * @return Entry owned by the caller, or NULL if no valid frame was read
+ */
+static msg_queue_entry_t *recv_frame_entry_body(frame_source_t *src, uint32_t msg_len) {
+    /* The payload cannot exceed what follows the header; bulk frames are
+     * capped at the whole union and the rest is read as data */
+    size_t want = msg_len - sizeof(msg_header_t);
+    if (want > sizeof(((message_t *)0)->payload)) {
+        want = sizeof(((message_t *)0)->payload);
+    }
+    msg_queue_entry_t *entry = msg_pool_get(want);
+    if (!entry) {
+        LOG_ERROR("Out of memory for a %u byte frame", msg_len);
+        return NULL;
+    }
+
+    if (recv_frame_body(src, msg_len, &entry->msg, msg_pool_capacity(entry),
+                        &entry->data, &entry->data_len) != DSM_SUCCESS) {
+        msg_pool_put(entry);
+        return NULL;
+    }
+    return entry;
+}
+
+/**
+ * Read one frame, length prefix first, into a pooled entry
+ *
+ * @return Entry owned by the caller, or NULL if no valid frame was read
+ */
+static msg_queue_entry_t *recv_frame_entry(frame_source_t *src) {
+    uint32_t msg_len;
+    if (recv_frame_length(src, &msg_len) != DSM_SUCCESS) {
+        return NULL;
+    }
+    return recv_frame_entry_body(src, msg_len);
+}
+
+int network_recv_bulk(int sockfd, message_t *msg, uint8_t **bulk, size_t *bulk_len) {
+    if (sockfd < 0 || !msg) {
+        return DSM_ERROR_INVALID;
+    }
+
+    frame_source_t src = { .sockfd = sockfd };
+    uint32_t msg_len;
+    int rc = recv_frame_length(&src, &msg_len);
+    if (rc != DSM_SUCCESS) {
+        return rc;
+    }
+    return recv_frame_body(&src, msg_len, msg, sizeof(msg->payload), bulk, bulk_len);
+}
+
+int network_recv(int sockfd, message_t *msg) {
+    return network_recv_bulk(sockfd, msg, NULL, NULL);
+}
+
+int network_start_dispatcher(void) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    /* Start handlers before the poller so no message is handled out of shard order */
+    if (ctx->config.num_handler_threads > 0) {
+        int rc = handler_pool_start(ctx->config.num_handler_threads);
+        if (rc != DSM_SUCCESS) {
+            return rc;
+        }
+    }
+
+    if (pthread_create(&ctx->network.dispatcher_thread, NULL, dispatcher_thread, NULL) != 0) {
         LOG_ERROR("Failed to create dispatcher thread");
+        handler_pool_stop();
         return DSM_ERROR_INIT;
     }
 
-    LOG_INFO("Network dispatcher started");
+    LOG_INFO("Network dispatcher started");
+    return DSM_SUCCESS;
+}
+
+/**
+ * Hand one received frame to its handler
+ * The entry goes to the handler pool as is, or is handled here and returned.
+ */
+static void dispatch_frame(msg_queue_entry_t *entry, int sockfd) {
+    message_t *msg = &entry->msg;
+
+    /* Every frame is proof of its sender's liveness, heartbeat or not */
+    dsm_context_t *ctx = dsm_get_context();
+    if (msg->header.sender < (node_id_t)ctx->network.max_nodes) {
+        __atomic_store_n(&ctx->network.nodes[msg->header.sender].last_heartbeat_time,
+                         perf_get_timestamp_ns(), __ATOMIC_RELAXED);
+    }
+    stats_peer_received(msg->header.sender,
+                        4 + sizeof(msg_header_t) + message_wire_payload_size(msg) + entry->data_len);
+
+    /* Enhanced logging to track all messages */
+    if (msg->header.type == MSG_ALLOC_NOTIFY) {
+        LOG_INFO("DISPATCHER: Received ALLOC_NOTIFY from sender=%u (sockfd=%d, pages=%lu-%lu)",
+                 msg->header.sender, sockfd,
+                 msg->payload.alloc_notify.start_page_id,
+                 msg->payload.alloc_notify.end_page_id);
+    } else {
+        LOG_DEBUG("DISPATCHER: Received message type=%d from sender=%u (sockfd=%d)",
+                  msg->header.type, msg->header.sender, sockfd);
+    }
+
+    /* Poller only reads; sharded messages run on the handler pool, a
+     * block along with its data */
+    if (handler_pool_submit_entry(entry) == DSM_SUCCESS) {
+        return;
+    }
+
+    /* A batch is split into per-page messages right here */
+    if (entry->data || msg->header.type == MSG_PAGE_BATCH_REPLY) {
+        dispatch_bulk_message(msg, entry->data, entry->data_len);
+    } else {
+        dispatch_message(msg, sockfd);
+    }
+    msg_pool_put(entry);
+}
+
+/* Bytes a socket is read in at a time; a longer frame grows the buffer */
+#define RX_BUFFER_SIZE (64 * 1024)
+
+/**
+ * What the dispatcher has read off one socket but not dispatched yet
+ *
+ * Sockets are read in RX_BUFFER_SIZE chunks until EAGAIN; a frame cut off
+ * at the end of a read waits here for the rest of its bytes.
+ */
+typedef struct socket_rx_s {
+    pthread_mutex_t lock;      /**< Held while the socket is read and its frames dispatched */
+    bool rerun;                /**< A drain came in while the lock was held */
+    bool stale;                /**< The descriptor was watched anew while the lock was held */
+    uint8_t *buf;              /**< Bytes read (NULL until the first read) */
+    size_t cap;                /**< Size of buf */
+    size_t start;              /**< First byte not dispatched yet */
+    size_t end;                /**< End of the bytes read */
+} socket_rx_t;
+
+/**
+ * Find sockfd's receive state, creating it if create is set
+ */
+static socket_rx_t *socket_rx_find(int sockfd, bool create) {
+    dsm_context_t *ctx = dsm_get_context();
+    socket_rx_t *rx = NULL;
+
+    pthread_mutex_lock(&ctx->network.rx_lock);
+    if (sockfd >= ctx->network.rx_capacity && create) {
+        int capacity = ctx->network.rx_capacity > 0 ? ctx->network.rx_capacity : 64;
+        while (capacity <= sockfd) {
+            capacity *= 2;
+        }
+        socket_rx_t **grown = realloc(ctx->network.rx_sockets, (size_t)capacity * sizeof(*grown));
+        if (grown) {
+            memset(grown + ctx->network.rx_capacity, 0,
+                   (size_t)(capacity - ctx->network.rx_capacity) * sizeof(*grown));
+            ctx->network.rx_sockets = grown;
+            ctx->network.rx_capacity = capacity;
+        }
+    }
+    if (sockfd >= 0 && sockfd < ctx->network.rx_capacity) {
+        rx = ctx->network.rx_sockets[sockfd];
+        if (!rx && create) {
+            rx = calloc(1, sizeof(*rx));
+            if (rx) {
+                pthread_mutex_init(&rx->lock, NULL);
+                ctx->network.rx_sockets[sockfd] = rx;
+            }
+        }
+    }
+    pthread_mutex_unlock(&ctx->network.rx_lock);
+
+    if (!rx && create) {
+        LOG_ERROR("Out of memory for the receive state of sockfd=%d", sockfd);
+    }
+    return rx;
+}
+
+/** Drop whatever was read off a socket; called under rx->lock */
+static void socket_rx_clear(socket_rx_t *rx) {
+    free(rx->buf);
+    rx->buf = NULL;
+    rx->cap = 0;
+    rx->start = 0;
+    rx->end = 0;
+}
+
+void network_release_rx(void) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    pthread_mutex_lock(&ctx->network.rx_lock);
+    for (int i = 0; i < ctx->network.rx_capacity; i++) {
+        socket_rx_t *rx = ctx->network.rx_sockets[i];
+        if (rx) {
+            socket_rx_clear(rx);
+            pthread_mutex_destroy(&rx->lock);
+            free(rx);
+        }
+    }
+    free(ctx->network.rx_sockets);
+    ctx->network.rx_sockets = NULL;
+    ctx->network.rx_capacity = 0;
+    pthread_mutex_unlock(&ctx->network.rx_lock);
+}
+
+/**
+ * Dispatch the whole frames rx holds, then read more until recv() would
+ * block; called under rx->lock
+ */
+static void drain_socket_locked(socket_rx_t *rx, int sockfd) {
+    for (;;) {
+        if (__atomic_exchange_n(&rx->stale, false, __ATOMIC_SEQ_CST)) {
+            socket_rx_clear(rx);
+        }
+
+        uint32_t msg_len = 0;
+        while (rx->end - rx->start >= 4) {
+            /* A lane's frames wait until the peer's LANE_SWITCHED */
+            if (lane_blocked(sockfd)) {
+                return;
+            }
+            if (decode_frame_length(rx->buf + rx->start, &msg_len) != DSM_SUCCESS) {
+                /* No way to find the next frame: drop the stream */
+                socket_rx_clear(rx);
+                return;
+            }
+            if (rx->end - rx->start < 4 + (size_t)msg_len) {
+                break;
+            }
+
+            frame_source_t src = {
+                .sockfd = sockfd,
+                .buf = rx->buf + rx->start + 4,
+                .buf_left = msg_len
+            };
+            msg_queue_entry_t *entry = recv_frame_entry_body(&src, msg_len);
+            rx->start += 4 + (size_t)msg_len;
+            msg_len = 0;
+            if (entry) {
+                dispatch_frame(entry, sockfd);
+            }
+        }
+
+        /* Unread lane frames stay in the kernel buffer */
+        if (lane_blocked(sockfd)) {
+            return;
+        }
+
+        /* Move a partial frame to the front, and make room for all of it */
+        size_t have = rx->end - rx->start;
+        if (rx->start > 0) {
+            memmove(rx->buf, rx->buf + rx->start, have);
+            rx->start = 0;
+            rx->end = have;
+        }
+        size_t need = msg_len > 0 ? 4 + (size_t)msg_len : 0;
+        if (need < RX_BUFFER_SIZE) {
+            need = RX_BUFFER_SIZE;
+        }
+        if (rx->cap < need || (have == 0 && rx->cap > RX_BUFFER_SIZE)) {
+            uint8_t *buf = realloc(rx->buf, need);
+            if (!buf) {
+                LOG_ERROR("Out of memory for a %zu byte frame on sockfd=%d", need, sockfd);
+                socket_rx_clear(rx);
+                return;
+            }
+            rx->buf = buf;
+            rx->cap = need;
+        }
+
+        ssize_t n = recv(sockfd, rx->buf + rx->end, rx->cap - rx->end, MSG_DONTWAIT);
+        if (n > 0) {
+            rx->end += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+
+        /* Closed or broken: the heartbeat deals with the node */
+        if (n == 0) {
+            LOG_DEBUG("Connection closed (sockfd=%d)", sockfd);
+        } else {
+            LOG_ERROR("Recv failed on sockfd=%d: %s", sockfd, strerror(errno));
+        }
+        socket_rx_clear(rx);
+        return;
+    }
+}
+
+/**
+ * Read and dispatch everything that has arrived on sockfd
+ *
+ * The socket is registered edge-triggered, so one wakeup must read until
+ * EAGAIN. A drain that finds another thread draining the socket (the
+ * dispatcher, and a LANE_SWITCHED handler releasing a lane) leaves the
+ * work to it, and that thread reads the socket once more before it stops.
+ */
+static void drain_socket(int sockfd) {
+    socket_rx_t *rx = socket_rx_find(sockfd, true);
+    if (!rx) {
+        return;
+    }
+
+    __atomic_store_n(&rx->rerun, true, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&rx->rerun, __ATOMIC_SEQ_CST) && pthread_mutex_trylock(&rx->lock) == 0) {
+        __atomic_store_n(&rx->rerun, false, __ATOMIC_SEQ_CST);
+        drain_socket_locked(rx, sockfd);
+        pthread_mutex_unlock(&rx->lock);
+    }
+}
+
+void network_drain_transport(transport_conn_t *conn) {
+    /* Until the peer switches, its frames still arrive on the socket */
+    frame_source_t src = { .sockfd = conn->sockfd, .conn = conn };
+    while (conn->rx_enabled && conn->ops->readable(conn)) {
+        msg_queue_entry_t *entry = recv_frame_entry(&src);
+        if (!entry) {
+            return;
+        }
+        dispatch_frame(entry, conn->sockfd);
+    }
+}
+
+int network_send_switch(node_id_t dest, message_t *msg, transport_conn_t *conn) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (dest >= (node_id_t)ctx->network.max_nodes) {
+        return DSM_ERROR_INVALID;
+    }
+    if (msg) {
+        return network_send_frame(dest, msg, NULL, NULL, 0, true, conn);
+    }
+
+    pthread_mutex_lock(&ctx->network.nodes[dest].send_lock);
+    ctx->network.nodes[dest].transport = conn;
+    pthread_mutex_unlock(&ctx->network.nodes[dest].send_lock);
     return DSM_SUCCESS;
 }
 
-static void* dispatcher_thread(void *arg) {
-    (void)arg;
+/* ============================ */
+/*       TCP Lanes              */
+/* ============================ */
+
+int network_open_lanes(node_id_t peer) {
     dsm_context_t *ctx = dsm_get_context();
 
-    while (ctx->network.running) {
-        struct pollfd fds[MAX_NODES * 2];  /* Connected + pending */
-        int nfds = 0;
+    int want = (ctx->config.tcp_lanes < MAX_TCP_LANES ? ctx->config.tcp_lanes : MAX_TCP_LANES) - 1;
+    if (want <= 0 || peer >= (node_id_t)ctx->network.max_nodes) {
+        return DSM_SUCCESS;
+    }
 
-        /* Add connected nodes */
-        pthread_mutex_lock(&ctx->lock);
-        for (int i = 0; i < MAX_NODES; i++) {
-            if (ctx->network.nodes[i].connected) {
-                fds[nfds].fd = ctx->network.nodes[i].sockfd;
-                fds[nfds].events = POLLIN;
-                nfds++;
+    pthread_mutex_lock(&ctx->lock);
+    node_info_t *node = &ctx->network.nodes[peer];
+    bool connected = node->connected && node->num_lanes == 0;
+    char hostname[MAX_HOSTNAME_LEN];
+    strncpy(hostname, node->hostname, sizeof(hostname) - 1);
+    hostname[sizeof(hostname) - 1] = '\0';
+    uint16_t port = node->port;
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (!connected) {
+        return DSM_ERROR_INVALID;
+    }
+
+    int fds[MAX_TCP_LANES - 1];
+    int n = 0;
+    while (n < want) {
+        int fd = connect_socket(hostname, port);
+        if (fd < 0) {
+            break;
+        }
+        if (network_watch_socket(fd) != DSM_SUCCESS) {
+            close(fd);
+            break;
+        }
+        fds[n++] = fd;
+    }
+    if (n == 0) {
+        LOG_WARN("Could not open extra connections to node %u, using one", peer);
+        return DSM_ERROR_NETWORK;
+    }
+
+    /* Nothing is read from the lanes until the peer switches */
+    pthread_mutex_lock(&ctx->lock);
+    for (int i = 0; i < n; i++) {
+        node->lane_fds[i] = fds[i];
+    }
+    node->num_lanes = n;
+    node->lanes_wanted = n;
+    node->lanes_rx = false;
+    ctx->network.blocked_lanes += n;
+    pthread_mutex_unlock(&ctx->lock);
+
+    /* Name each lane on it, then move our sharded frames over */
+    for (int i = 0; i < n; i++) {
+        int rc = send_tcp_lane(peer, LANE_JOIN, (uint8_t)i, (uint8_t)n);
+        if (rc != DSM_SUCCESS) {
+            return rc;
+        }
+    }
+    int rc = send_tcp_lane(peer, LANE_SWITCHED, 0, (uint8_t)n);
+    if (rc == DSM_SUCCESS) {
+        LOG_INFO("Opened %d extra connections to node %u", n, peer);
+    }
+    return rc;
+}
+
+int network_send_lane(node_id_t dest, int lane, message_t *msg) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (!msg || dest >= (node_id_t)ctx->network.max_nodes || lane < 0 || lane >= MAX_TCP_LANES - 1) {
+        return DSM_ERROR_INVALID;
+    }
+    node_info_t *peer = &ctx->network.nodes[dest];
+
+    assign_seq_num(msg);
+
+    uint8_t prefix[4];
+    struct iovec iov[4];
+    size_t len;
+    int iovcnt = build_frame_iov(msg, NULL, 0, prefix, iov, &len);
+    if (iovcnt < 0) {
+        return DSM_ERROR_INVALID;
+    }
+
+    pthread_mutex_lock(&peer->send_lock);
+    int fd = peer->lane_fds[lane];
+    int rc = fd >= 0 ? write_iov_locked(dest, fd, iov, iovcnt, len, 1) : DSM_ERROR_NETWORK;
+    pthread_mutex_unlock(&peer->send_lock);
+    return rc;
+}
+
+int network_switch_lanes(node_id_t dest, message_t *msg) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (!msg || dest >= (node_id_t)ctx->network.max_nodes) {
+        return DSM_ERROR_INVALID;
+    }
+    node_info_t *peer = &ctx->network.nodes[dest];
+
+    assign_seq_num(msg);
+
+    int sockfd;
+    int rc = get_peer_socket(dest, &sockfd);
+    if (rc != DSM_SUCCESS) {
+        return rc;
+    }
+
+    /* msg has no shard key, so it still goes to the main socket */
+    pthread_mutex_lock(&peer->send_lock);
+    flush_send_queue_locked(dest, sockfd);
+    rc = write_frame_locked(dest, sockfd, msg, NULL, NULL, 0, 0);
+    if (rc == DSM_SUCCESS) {
+        peer->lanes_tx = true;
+    }
+    pthread_mutex_unlock(&peer->send_lock);
+    return rc;
+}
+
+/**
+ * Close a node's lanes and forget them (caller holds its send_lock and ctx->lock)
+ */
+static void close_lanes_locked(dsm_context_t *ctx, node_info_t *node) {
+    for (int i = 0; i < MAX_TCP_LANES - 1; i++) {
+        if (node->lane_fds[i] >= 0) {
+            if (!node->lanes_rx) {
+                ctx->network.blocked_lanes--;
             }
+            close(node->lane_fds[i]);
+            node->lane_fds[i] = -1;
+        }
+    }
+    node->num_lanes = 0;
+    node->lanes_wanted = 0;
+    node->lanes_tx = false;
+    node->lanes_rx = false;
+}
+
+int network_add_lane(node_id_t node_id, int lane, int num_lanes, int sockfd) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (node_id >= (node_id_t)ctx->network.max_nodes || lane < 0 ||
+        num_lanes > MAX_TCP_LANES - 1 || lane >= num_lanes) {
+        return DSM_ERROR_INVALID;
+    }
+
+    /* The lane is identified now; it no longer counts as pending */
+    pthread_mutex_lock(&ctx->network.pending_lock);
+    for (int i = 0; i < ctx->network.num_pending; i++) {
+        if (ctx->network.pending_sockets[i] == sockfd) {
+            ctx->network.pending_sockets[i] = ctx->network.pending_sockets[--ctx->network.num_pending];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&ctx->network.pending_lock);
+
+    node_info_t *node = &ctx->network.nodes[node_id];
+    pthread_mutex_lock(&node->send_lock);
+    pthread_mutex_lock(&ctx->lock);
+
+    /* Lanes of an earlier connection of the node are replaced */
+    if (node->lanes_tx || node->lane_fds[lane] >= 0) {
+        LOG_WARN("Node %u opened new lanes, dropping its old ones", node_id);
+        close_lanes_locked(ctx, node);
+    }
+    node->lane_fds[lane] = sockfd;
+    node->num_lanes++;
+    node->lanes_wanted = num_lanes;
+    if (!node->lanes_rx) {
+        ctx->network.blocked_lanes++;
+    }
+
+    pthread_mutex_unlock(&ctx->lock);
+    pthread_mutex_unlock(&node->send_lock);
+
+    LOG_DEBUG("Lane %d of node %u joined (sockfd=%d)", lane, node_id, sockfd);
+    return DSM_SUCCESS;
+}
+
+void network_enable_lanes_rx(node_id_t node_id, int num_lanes) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (node_id >= (node_id_t)ctx->network.max_nodes || num_lanes > MAX_TCP_LANES - 1) {
+        return;
+    }
+    node_info_t *node = &ctx->network.nodes[node_id];
+
+    int fds[MAX_TCP_LANES - 1];
+    pthread_mutex_lock(&ctx->lock);
+    if (!node->lanes_rx) {
+        ctx->network.blocked_lanes -= node->num_lanes;
+    }
+    node->lanes_rx = true;
+    node->lanes_wanted = num_lanes;
+    memcpy(fds, node->lane_fds, sizeof(fds));
+    pthread_mutex_unlock(&ctx->lock);
+
+    /* Frames the peer sent after switching may already be waiting */
+    for (int i = 0; i < MAX_TCP_LANES - 1; i++) {
+        if (fds[i] >= 0) {
+            drain_socket(fds[i]);
+        }
+    }
+}
+
+bool network_lanes_ready(node_id_t node_id) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (node_id >= (node_id_t)ctx->network.max_nodes) {
+        return false;
+    }
+    node_info_t *node = &ctx->network.nodes[node_id];
+
+    pthread_mutex_lock(&node->send_lock);
+    pthread_mutex_lock(&ctx->lock);
+    bool ready = node->lanes_rx && !node->lanes_tx && node->num_lanes > 0 &&
+                 node->num_lanes == node->lanes_wanted && node->connected;
+    pthread_mutex_unlock(&ctx->lock);
+    pthread_mutex_unlock(&node->send_lock);
+    return ready;
+}
+
+bool network_peer_link(node_id_t peer) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (peer >= (node_id_t)ctx->network.max_nodes || peer == ctx->node_id) {
+        return false;
+    }
+    node_info_t *node = &ctx->network.nodes[peer];
+
+    pthread_mutex_lock(&ctx->lock);
+    bool ready = node->connected || (node->peer_sockfd >= 0 && !node->peer_failed);
+    bool can_open = !ready && !ctx->config.is_manager && !node->is_failed &&
+                    !node->peer_failed && node->peer_port != 0;
+    pthread_mutex_unlock(&ctx->lock);
+    if (ready || !can_open) {
+        return ready;
+    }
+
+    /* Opened once, by whichever sender gets here first; the others wait
+     * for it rather than opening links of their own */
+    pthread_mutex_lock(&node->peer_lock);
+    pthread_mutex_lock(&ctx->lock);
+    ready = node->peer_sockfd >= 0 && !node->peer_failed;
+    can_open = !ready && !node->peer_failed && node->peer_port != 0;
+    uint32_t peer_addr = node->peer_addr;
+    uint16_t peer_port = node->peer_port;
+    pthread_mutex_unlock(&ctx->lock);
+    if (ready || !can_open) {
+        pthread_mutex_unlock(&node->peer_lock);
+        return ready;
+    }
+
+    char host[INET_ADDRSTRLEN];
+    struct in_addr in = { .s_addr = peer_addr };
+    inet_ntop(AF_INET, &in, host, sizeof(host));
+
+    int sockfd = connect_socket(host, peer_port);
+    if (sockfd >= 0 && network_watch_socket(sockfd) != DSM_SUCCESS) {
+        close(sockfd);
+        sockfd = -1;
+    }
+
+    /* The hello goes out before the link is published, so it is the first
+     * frame the peer reads on it */
+    int rc = DSM_ERROR_NETWORK;
+    if (sockfd >= 0) {
+        message_t hello;
+        memset(&hello.header, 0, sizeof(hello.header));
+        hello.header.magic = MSG_MAGIC;
+        hello.header.type = MSG_PEER_HELLO;
+        hello.header.sender = ctx->node_id;
+        hello.payload.peer_hello.node_id = ctx->node_id;
+        assign_seq_num(&hello);
+
+        pthread_mutex_lock(&node->send_lock);
+        rc = write_frame_locked(peer, sockfd, &hello, NULL, NULL, 0, 0);
+        if (rc == DSM_SUCCESS) {
+            pthread_mutex_lock(&ctx->lock);
+            node->peer_sockfd = sockfd;
+            pthread_mutex_unlock(&ctx->lock);
+        }
+        pthread_mutex_unlock(&node->send_lock);
+    }
+
+    if (rc != DSM_SUCCESS) {
+        if (sockfd >= 0) {
+            close(sockfd);
         }
+        /* Not retried: one failed attempt per peer, not one per message */
+        pthread_mutex_lock(&ctx->lock);
+        node->peer_failed = true;
         pthread_mutex_unlock(&ctx->lock);
+        LOG_WARN("No link to node %u at %s:%u, relaying through the manager", peer, host, peer_port);
+    } else {
+        STATS_INC(peer_links_opened);
+        LOG_INFO("Opened link to node %u at %s:%u (sockfd=%d)", peer, host, peer_port, sockfd);
+    }
+    pthread_mutex_unlock(&node->peer_lock);
+    return rc == DSM_SUCCESS;
+}
 
-        /* Add pending connections (waiting for NODE_JOIN) */
-        pthread_mutex_lock(&ctx->network.pending_lock);
-        for (int i = 0; i < ctx->network.num_pending; i++) {
-            fds[nfds].fd = ctx->network.pending_sockets[i];
-            fds[nfds].events = POLLIN;
-            nfds++;
+bool network_has_link(node_id_t peer) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (peer >= (node_id_t)ctx->network.max_nodes || peer == ctx->node_id) {
+        return false;
+    }
+    node_info_t *node = &ctx->network.nodes[peer];
+
+    pthread_mutex_lock(&ctx->lock);
+    bool ready = !node->is_failed &&
+                 (node->connected || (node->peer_sockfd >= 0 && !node->peer_failed));
+    pthread_mutex_unlock(&ctx->lock);
+    return ready;
+}
+
+int network_adopt_peer_link(node_id_t peer, int sockfd) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (peer >= (node_id_t)ctx->network.max_nodes || peer == ctx->node_id || ctx->config.is_manager) {
+        return DSM_ERROR_INVALID;
+    }
+
+    /* The link is identified now; it no longer counts as pending */
+    pthread_mutex_lock(&ctx->network.pending_lock);
+    for (int i = 0; i < ctx->network.num_pending; i++) {
+        if (ctx->network.pending_sockets[i] == sockfd) {
+            ctx->network.pending_sockets[i] = ctx->network.pending_sockets[--ctx->network.num_pending];
+            break;
         }
-        pthread_mutex_unlock(&ctx->network.pending_lock);
+    }
+    pthread_mutex_unlock(&ctx->network.pending_lock);
 
-        if (nfds == 0) {
-            usleep(100000);
-            continue;
+    /* Both sides may open a link at once: whoever has none sends on the
+     * one it is given, the other only reads it */
+    node_info_t *node = &ctx->network.nodes[peer];
+    pthread_mutex_lock(&node->peer_lock);
+    pthread_mutex_lock(&node->send_lock);
+    pthread_mutex_lock(&ctx->lock);
+    int old_fd = -1;
+    if (node->peer_sockfd < 0) {
+        node->peer_sockfd = sockfd;
+    } else {
+        old_fd = node->peer_rx_sockfd;
+        node->peer_rx_sockfd = sockfd;
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    pthread_mutex_unlock(&node->send_lock);
+    pthread_mutex_unlock(&node->peer_lock);
+
+    /* A link replaced by a later one has been closed by the peer */
+    if (old_fd >= 0) {
+        close(old_fd);
+    }
+
+    LOG_INFO("Node %u opened a link to us (sockfd=%d)", peer, sockfd);
+    return DSM_SUCCESS;
+}
+
+/**
+ * Check whether sockfd is a lane whose peer has not switched yet
+ */
+static bool lane_blocked(int sockfd) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (__atomic_load_n(&ctx->network.blocked_lanes, __ATOMIC_RELAXED) == 0) {
+        return false;
+    }
+
+    bool blocked = false;
+    pthread_mutex_lock(&ctx->lock);
+    for (int i = 0; i < ctx->network.max_nodes && !blocked; i++) {
+        node_info_t *node = &ctx->network.nodes[i];
+        for (int l = 0; l < MAX_TCP_LANES - 1 && !node->lanes_rx; l++) {
+            if (node->lane_fds[l] == sockfd) {
+                blocked = true;
+                break;
+            }
         }
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    return blocked;
+}
+
+int network_watch_socket(int sockfd) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    /* The descriptor may be reused: nothing read off the socket it was
+     * before belongs to this one. Callers may hold pending_lock, which a
+     * drain in progress can wait for, so that drain is left to clear it */
+    socket_rx_t *rx = socket_rx_find(sockfd, false);
+    if (rx) {
+        __atomic_store_n(&rx->stale, true, __ATOMIC_SEQ_CST);
+        if (pthread_mutex_trylock(&rx->lock) == 0) {
+            if (__atomic_exchange_n(&rx->stale, false, __ATOMIC_SEQ_CST)) {
+                socket_rx_clear(rx);
+            }
+            pthread_mutex_unlock(&rx->lock);
+        }
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    ev.data.fd = sockfd;
+
+    if (epoll_ctl(ctx->network.epoll_fd, EPOLL_CTL_ADD, sockfd, &ev) < 0) {
+        LOG_ERROR("Failed to register sockfd=%d with dispatcher: %s", sockfd, strerror(errno));
+        return DSM_ERROR_NETWORK;
+    }
+    return DSM_SUCCESS;
+}
+
+static void* dispatcher_thread(void *arg) {
+    (void)arg;
+    dsm_context_t *ctx = dsm_get_context();
+    int epoll_fd = ctx->network.epoll_fd;
+    int wake_fd = ctx->network.wake_fd;
+    struct epoll_event events[DISPATCH_MAX_EVENTS];
 
-        int ret = poll(fds, nfds, 1000);
-        if (ret < 0) {
+    while (ctx->network.running) {
+        /* Timeout is only a safety net; shutdown writes wake_fd */
+        int n = epoll_wait(epoll_fd, events, DISPATCH_MAX_EVENTS, 1000);
+        if (n < 0) {
             if (errno == EINTR) continue;
-            LOG_ERROR("Poll failed: %s", strerror(errno));
+            LOG_ERROR("epoll_wait failed: %s", strerror(errno));
             break;
         }
 
-        if (ret == 0) continue;
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
 
-        for (int i = 0; i < nfds; i++) {
-            if (fds[i].revents & POLLIN) {
-                message_t msg;
-                int sockfd = fds[i].fd;
-                if (network_recv(sockfd, &msg) == DSM_SUCCESS) {
-                    /* Enhanced logging to track all messages */
-                    if (msg.header.type == MSG_ALLOC_NOTIFY) {
-                        LOG_INFO("DISPATCHER: Received ALLOC_NOTIFY from sender=%u (sockfd=%d, pages=%lu-%lu)",
-                                 msg.header.sender, sockfd,
-                                 msg.payload.alloc_notify.start_page_id,
-                                 msg.payload.alloc_notify.end_page_id);
-                    } else {
-                        LOG_INFO("DISPATCHER: Received message type=%d from sender=%u (sockfd=%d)",
-                                 msg.header.type, msg.header.sender, sockfd);
-                    }
-                    dispatch_message(&msg, sockfd);
-                }
+            if (fd == wake_fd) {
+                uint64_t val;
+                while (read(wake_fd, &val, sizeof(val)) > 0) {}
+                continue;
+            }
+
+            /* A transport connection's completions: read what its peer sent */
+            transport_conn_t *conn = transport_find_event_fd(fd);
+            if (conn) {
+                conn->ops->handle_event(conn);
+                network_drain_transport(conn);
+                continue;
+            }
+
+            if (events[i].events & EPOLLIN) {
+                drain_socket(fd);
+            }
+
+            /* Peer closed: stop watching; heartbeat handles node failure */
+            if (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                LOG_DEBUG("Peer hung up on sockfd=%d", fd);
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
             }
         }
     }
@@ -633,6 +2192,21 @@ void network_shutdown(void) {
     extern void stop_heartbeat_thread(void);
     stop_heartbeat_thread();
 
+    /* Wake the dispatcher so it sees running == false immediately */
+    uint64_t one = 1;
+    if (write(ctx->network.wake_fd, &one, sizeof(one)) < 0) {
+        LOG_DEBUG("Dispatcher wakeup failed: %s", strerror(errno));
+    }
+
+    /* Drain queued handlers first; they may still send replies */
+    handler_pool_stop();
+
+    /* Ship the rest of the replication log while the backup is connected */
+    replication_stop();
+
+    /* Flush and stop per-peer sender threads while sockets are still open */
+    network_stop_senders();
+
     pthread_mutex_lock(&ctx->lock);
     int server_fd = ctx->network.server_sockfd;
     ctx->network.server_sockfd = -1;
@@ -640,8 +2214,10 @@ void network_shutdown(void) {
     ctx->network.dispatcher_thread = 0;  /* Reset thread handle */
     pthread_mutex_unlock(&ctx->lock);
 
-    /* Close server socket to wake up accept() */
+    /* Shut down and close server socket to wake up accept()
+     * (close() alone does not interrupt a blocked accept() on Linux) */
     if (server_fd >= 0) {
+        shutdown(server_fd, SHUT_RDWR);
         close(server_fd);
 
         /* Wait for accept thread to finish (only if it was running and thread is valid) */
@@ -650,13 +2226,50 @@ void network_shutdown(void) {
         }
     }
 
+    /* Same for the peer link listener of a worker */
+    pthread_mutex_lock(&ctx->lock);
+    int peer_server_fd = ctx->network.peer_server_sockfd;
+    ctx->network.peer_server_sockfd = -1;
+    pthread_mutex_unlock(&ctx->lock);
+    if (peer_server_fd >= 0) {
+        shutdown(peer_server_fd, SHUT_RDWR);
+        close(peer_server_fd);
+        pthread_join(ctx->network.peer_accept_thread, NULL);
+    }
+
+    /* Transport connections are polled by the dispatcher; it must be
+     * gone before they are destroyed */
+    if (transport_enabled()) {
+        if (!(server_fd >= 0 && was_running) && thread != 0) {
+            pthread_join(thread, NULL);
+        }
+        for (int i = 0; i < ctx->network.max_nodes; i++) {
+            network_send_switch((node_id_t)i, NULL, NULL);
+        }
+        transport_shutdown();
+    }
+
     /* Close all connections */
-    for (int i = 0; i < MAX_NODES; i++) {
+    for (int i = 0; i < ctx->network.max_nodes; i++) {
+        pthread_mutex_lock(&ctx->network.nodes[i].send_lock);
+        pthread_mutex_lock(&ctx->lock);
+        close_lanes_locked(ctx, &ctx->network.nodes[i]);
+        pthread_mutex_unlock(&ctx->lock);
+        pthread_mutex_unlock(&ctx->network.nodes[i].send_lock);
+
         if (ctx->network.nodes[i].sockfd >= 0) {
             close(ctx->network.nodes[i].sockfd);
             ctx->network.nodes[i].sockfd = -1;
             ctx->network.nodes[i].connected = false;
         }
+        if (ctx->network.nodes[i].peer_sockfd >= 0) {
+            close(ctx->network.nodes[i].peer_sockfd);
+            ctx->network.nodes[i].peer_sockfd = -1;
+        }
+        if (ctx->network.nodes[i].peer_rx_sockfd >= 0) {
+            close(ctx->network.nodes[i].peer_rx_sockfd);
+            ctx->network.nodes[i].peer_rx_sockfd = -1;
+        }
     }
 
     LOG_INFO("Network shutdown complete");
@@ -755,7 +2368,7 @@ int network_activate_backup_server(void) {
     LOG_INFO("Activating backup server on port %u (starting to listen)", port);
 
     /* Start listening for connections */
-    if (listen(sockfd, 10) < 0) {
+    if (listen(sockfd, SOMAXCONN) < 0) {
         LOG_ERROR("Failed to listen on backup server socket: %s", strerror(errno));
         return DSM_ERROR_NETWORK;
     }
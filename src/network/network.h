@@ -8,6 +8,8 @@
 
 #include "dsm/types.h"
 #include "protocol.h"
+#include "transport.h"
+#include <sys/uio.h>
 
 /**
  * Initialize network server
@@ -25,11 +27,158 @@ int network_connect_to_node(node_id_t node_id, const char *hostname, uint16_t po
  */
 int network_send(node_id_t dest, message_t *msg);
 
+/**
+ * Send a PAGE_REPLY whose page bytes are read directly from page_data
+ * (zero-copy: msg->payload.page_reply.data is not used)
+ * A raw block larger than PAGE_SIZE goes out as the frame's bulk data.
+ */
+int network_send_page(node_id_t dest, message_t *msg, const void *page_data);
+
+/**
+ * Send a bulk frame: a PAGE_BATCH_REPLY followed by its page data, a
+ * STATE_SYNC_BATCH followed by its records, an RMA_REQUEST (put) or
+ * RMA_REPLY (get) followed by the bytes it moves, or a BARRIER_ARRIVE or
+ * BARRIER_RELEASE followed by a collective's contribution or result
+ *
+ * The data segments are written after the payload, in order, straight
+ * from the caller's buffers (zero-copy). At most PAGE_BATCH_MAX segments
+ * and MSG_MAX_BULK_DATA bytes in total.
+ */
+int network_send_bulk(node_id_t dest, message_t *msg, const struct iovec *data, int num_data);
+
+/**
+ * Queue a small control message for asynchronous delivery
+ *
+ * The message is copied into the peer's send queue and written by that
+ * peer's sender thread, coalesced with anything else queued for it.
+ * Ordering with network_send() to the same peer is preserved. Delivery
+ * failures are logged, not returned. PAGE_REPLY is rejected.
+ */
+int network_send_async(node_id_t dest, message_t *msg);
+
+/**
+ * Flush and join all per-peer sender threads
+ */
+void network_stop_senders(void);
+
 /**
  * Receive message (blocking)
+ * Bulk frames are consumed and rejected; use network_recv_bulk() for them.
  */
 int network_recv(int sockfd, message_t *msg);
 
+/**
+ * Receive message or bulk frame (blocking)
+ *
+ * The bulk data of a frame that has any is returned in a malloc'd buffer
+ * the caller frees; *bulk is NULL otherwise.
+ */
+int network_recv_bulk(int sockfd, message_t *msg, uint8_t **bulk, size_t *bulk_len);
+
+/**
+ * Register a connected socket with the dispatcher event loop
+ * Called once per socket, at accept or connect time
+ */
+int network_watch_socket(int sockfd);
+
+/**
+ * Send msg as the last frame on a peer's current path, then write every
+ * later frame to that peer through conn
+ *
+ * Issued under the peer's send_lock, so no frame falls between the two.
+ * With msg NULL only the path is changed (conn NULL = back to the socket).
+ *
+ * @return DSM_SUCCESS, or the error of sending msg (path unchanged)
+ */
+int network_send_switch(node_id_t dest, message_t *msg, transport_conn_t *conn);
+
+/**
+ * Free what the dispatcher read off sockets but never dispatched
+ * Called at context cleanup, once the dispatcher has stopped.
+ */
+void network_release_rx(void);
+
+/**
+ * Read and dispatch every complete frame a transport connection holds
+ * No-op until the peer has switched (conn->rx_enabled).
+ */
+void network_drain_transport(transport_conn_t *conn);
+
+/**
+ * Open extra TCP connections ("lanes") to a peer
+ *
+ * Opens dsm_config_t.tcp_lanes - 1 more sockets to the peer and names
+ * each with a LANE_JOIN on it; a LANE_SWITCHED on the main socket then
+ * moves our sharded frames onto the lanes. The peer answers with its own
+ * LANE_SWITCHED once all lanes have joined. Each side reads a lane only
+ * after the other side's LANE_SWITCHED, so frames of one object are
+ * never reordered by the move. No-op with tcp_lanes <= 1.
+ *
+ * @param peer Connected peer (workers open lanes to the manager)
+ * @return DSM_SUCCESS, or an error if no lane could be set up
+ */
+int network_open_lanes(node_id_t peer);
+
+/**
+ * Write msg on one of a peer's lanes (LANE_JOIN)
+ */
+int network_send_lane(node_id_t dest, int lane, message_t *msg);
+
+/**
+ * Send msg as the last sharded frame on the main socket, then spread
+ * later sharded frames to the peer over its lanes
+ */
+int network_switch_lanes(node_id_t dest, message_t *msg);
+
+/**
+ * Record sockfd as lane lane of num_lanes opened by node_id
+ * Frames on it are not read until network_enable_lanes_rx().
+ */
+int network_add_lane(node_id_t node_id, int lane, int num_lanes, int sockfd);
+
+/**
+ * Start reading a peer's lanes after its LANE_SWITCHED
+ */
+void network_enable_lanes_rx(node_id_t node_id, int num_lanes);
+
+/**
+ * Check whether the peer has switched and all its lanes have joined
+ * while we still write to the main socket only
+ */
+bool network_lanes_ready(node_id_t node_id);
+
+/**
+ * Listen for links other workers open to this one
+ *
+ * @param port Port to listen on (0 = any; the port taken is stored in
+ *             network_state_t.peer_server_port for NODE_JOIN)
+ */
+int network_peer_server_init(uint16_t port);
+
+/**
+ * Check whether frames to peer can go to it directly, opening the link to
+ * a worker on first use
+ *
+ * Workers learn where the others take links from the roster. A link that
+ * cannot be opened, or that breaks, is not retried: the caller relays
+ * through the manager instead.
+ *
+ * @return true if network_send() to peer reaches it without a relay
+ */
+bool network_peer_link(node_id_t peer);
+
+/**
+ * Like network_peer_link(), but never opens a link
+ * Safe on the dispatcher, where a connect to a dead node would stall it.
+ */
+bool network_has_link(node_id_t peer);
+
+/**
+ * Record sockfd as the link peer opened to us (PEER_HELLO)
+ * Sent on unless we already have a link of our own to the peer.
+ */
+int network_adopt_peer_link(node_id_t peer, int sockfd);
+
 /**
  * Start message dispatcher thread
  */
@@ -40,6 +189,34 @@ int network_start_dispatcher(void);
  */
 void network_shutdown(void);
 
+/**
+ * Size in bytes of the payload carried by a message type
+ * Returns (size_t)-1 for unknown types
+ */
+size_t message_payload_size(msg_type_t type);
+
+/**
+ * Size in bytes of the payload actually sent for a message
+ *
+ * Same as message_payload_size() except for SHARER_REPLY, STATE_SYNC_DIR and
+ * STATE_SYNC_LOCK, whose node lists only carry the populated entries, and
+ * PAGE_REPLY and PAGE_DIFF, which only carry the data bytes in use.
+ * Returns (size_t)-1 for unknown types
+ */
+size_t message_wire_payload_size(const message_t *msg);
+
+/**
+ * Bytes of a PAGE_REPLY's data[] that go on the wire
+ * 0 for grants and zero pages, PAGE_SIZE for raw pages, else data_len.
+ */
+size_t page_reply_data_len(const message_t *msg);
+
+/**
+ * Bytes of bulk data that follow a PAGE_REPLY's payload
+ * block_size for a raw block larger than PAGE_SIZE, else 0.
+ */
+size_t page_reply_bulk_len(const message_t *msg);
+
 /**
  * Serialize message
  */
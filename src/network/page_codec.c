@@ -0,0 +1,258 @@
+/**
+ * @file page_codec.c
+ * @brief Page compression for PAGE_REPLY implementation
+ *
+ * LZ stream format (LZ4 block format restricted to one page): a sequence of
+ *   [token][literal length ext][literals][uint16 offset][match length ext]
+ * where the token's high nibble is the literal count and its low nibble the
+ * match length minus LZ_MIN_MATCH; a nibble of 15 continues in extension
+ * bytes that are summed until one is below 255. The last sequence has
+ * literals only and ends the stream.
+ */
+
+#include "page_codec.h"
+#include <string.h>
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 10
+#define LZ_NIBBLE_MAX 15
+
+/* ============================ */
+/*       Negotiation            */
+/* ============================ */
+
+uint8_t page_codec_supported(void) {
+    return PAGE_ENCODING_BIT(PAGE_ENCODING_ZERO) | PAGE_ENCODING_BIT(PAGE_ENCODING_LZ);
+}
+
+dsm_compression_t page_codec_negotiate(dsm_compression_t mode, uint8_t accepted) {
+    if (mode >= DSM_COMPRESSION_LZ && (accepted & PAGE_ENCODING_BIT(PAGE_ENCODING_LZ)) &&
+        (accepted & PAGE_ENCODING_BIT(PAGE_ENCODING_ZERO))) {
+        return DSM_COMPRESSION_LZ;
+    }
+    if (mode >= DSM_COMPRESSION_ZERO && (accepted & PAGE_ENCODING_BIT(PAGE_ENCODING_ZERO))) {
+        return DSM_COMPRESSION_ZERO;
+    }
+    return DSM_COMPRESSION_NONE;
+}
+
+/* ============================ */
+/*       LZ Encoder             */
+/* ============================ */
+
+bool page_codec_is_zero(const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i += sizeof(uint64_t)) {
+        uint64_t w;
+        memcpy(&w, data + i, sizeof(w));
+        if (w != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t lz_hash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/** Append the extension bytes of a length; false if out of room */
+static bool put_length_ext(uint8_t *out, size_t *op, size_t cap, size_t value) {
+    while (value >= 255) {
+        if (*op >= cap) {
+            return false;
+        }
+        out[(*op)++] = 255;
+        value -= 255;
+    }
+    if (*op >= cap) {
+        return false;
+    }
+    out[(*op)++] = (uint8_t)value;
+    return true;
+}
+
+/**
+ * Append one sequence; match_len 0 marks the final literal-only sequence
+ * @return false if the output would exceed cap
+ */
+static bool put_sequence(uint8_t *out, size_t *op, size_t cap, const uint8_t *literals,
+                         size_t num_literals, size_t offset, size_t match_len) {
+    size_t lit_nibble = num_literals < LZ_NIBBLE_MAX ? num_literals : LZ_NIBBLE_MAX;
+    size_t match_code = match_len ? match_len - LZ_MIN_MATCH : 0;
+    size_t match_nibble = match_code < LZ_NIBBLE_MAX ? match_code : LZ_NIBBLE_MAX;
+
+    if (*op >= cap) {
+        return false;
+    }
+    out[(*op)++] = (uint8_t)((lit_nibble << 4) | match_nibble);
+
+    if (lit_nibble == LZ_NIBBLE_MAX && !put_length_ext(out, op, cap, num_literals - LZ_NIBBLE_MAX)) {
+        return false;
+    }
+    if (*op + num_literals > cap) {
+        return false;
+    }
+    memcpy(out + *op, literals, num_literals);
+    *op += num_literals;
+
+    if (match_len == 0) {
+        return true;
+    }
+    if (*op + 2 > cap) {
+        return false;
+    }
+    out[(*op)++] = (uint8_t)(offset & 0xFF);
+    out[(*op)++] = (uint8_t)(offset >> 8);
+    if (match_nibble == LZ_NIBBLE_MAX && !put_length_ext(out, op, cap, match_code - LZ_NIBBLE_MAX)) {
+        return false;
+    }
+    return true;
+}
+
+/** @return Encoded size, or 0 if it would not fit in cap */
+static size_t lz_encode(const uint8_t *page, uint8_t *out, size_t cap) {
+    uint16_t table[1 << LZ_HASH_BITS];  /* Position + 1, 0 = empty */
+    memset(table, 0, sizeof(table));
+
+    size_t op = 0;
+    size_t anchor = 0;
+    size_t ip = 0;
+
+    while (ip + LZ_MIN_MATCH <= PAGE_SIZE) {
+        uint32_t seq = read32(page + ip);
+        uint32_t h = lz_hash(seq);
+        size_t candidate = table[h];
+        table[h] = (uint16_t)(ip + 1);
+
+        if (candidate == 0 || read32(page + candidate - 1) != seq) {
+            ip++;
+            continue;
+        }
+
+        size_t ref = candidate - 1;
+        size_t len = LZ_MIN_MATCH;
+        while (ip + len < PAGE_SIZE && page[ref + len] == page[ip + len]) {
+            len++;
+        }
+
+        if (!put_sequence(out, &op, cap, page + anchor, ip - anchor, ip - ref, len)) {
+            return 0;
+        }
+        ip += len;
+        anchor = ip;
+    }
+
+    /* A stream that ends with a match needs no closing sequence */
+    if (anchor < PAGE_SIZE &&
+        !put_sequence(out, &op, cap, page + anchor, PAGE_SIZE - anchor, 0, 0)) {
+        return 0;
+    }
+    return op;
+}
+
+size_t page_codec_encode(const uint8_t *page, dsm_compression_t mode, uint8_t *out,
+                         uint8_t *encoding) {
+    if (mode >= DSM_COMPRESSION_ZERO && page_codec_is_zero(page, PAGE_SIZE)) {
+        *encoding = PAGE_ENCODING_ZERO;
+        return 0;
+    }
+
+    if (mode >= DSM_COMPRESSION_LZ) {
+        size_t len = lz_encode(page, out, PAGE_SIZE - PAGE_CODEC_MIN_SAVING);
+        if (len > 0) {
+            *encoding = PAGE_ENCODING_LZ;
+            return len;
+        }
+    }
+
+    *encoding = PAGE_ENCODING_RAW;
+    return PAGE_SIZE;
+}
+
+/* ============================ */
+/*       Decoder                */
+/* ============================ */
+
+/** Read the extension bytes of a length; false if the input ends first */
+static bool get_length_ext(const uint8_t *data, size_t len, size_t *ip, size_t *value) {
+    uint8_t b;
+    do {
+        if (*ip >= len) {
+            return false;
+        }
+        b = data[(*ip)++];
+        *value += b;
+    } while (b == 255);
+    return true;
+}
+
+static int lz_decode(const uint8_t *data, size_t len, uint8_t *page) {
+    size_t ip = 0;
+    size_t op = 0;
+
+    while (ip < len) {
+        uint8_t token = data[ip++];
+
+        size_t num_literals = token >> 4;
+        if (num_literals == LZ_NIBBLE_MAX && !get_length_ext(data, len, &ip, &num_literals)) {
+            return DSM_ERROR_INVALID;
+        }
+        if (num_literals > len - ip || num_literals > PAGE_SIZE - op) {
+            return DSM_ERROR_INVALID;
+        }
+        memcpy(page + op, data + ip, num_literals);
+        ip += num_literals;
+        op += num_literals;
+
+        if (ip == len) {
+            break;  /* Final literal-only sequence */
+        }
+
+        if (len - ip < 2) {
+            return DSM_ERROR_INVALID;
+        }
+        size_t offset = (size_t)data[ip] | ((size_t)data[ip + 1] << 8);
+        ip += 2;
+
+        size_t match_len = token & LZ_NIBBLE_MAX;
+        if (match_len == LZ_NIBBLE_MAX && !get_length_ext(data, len, &ip, &match_len)) {
+            return DSM_ERROR_INVALID;
+        }
+        match_len += LZ_MIN_MATCH;
+
+        if (offset == 0 || offset > op || match_len > PAGE_SIZE - op) {
+            return DSM_ERROR_INVALID;
+        }
+        /* Byte by byte: a match may overlap the bytes it produces */
+        for (size_t i = 0; i < match_len; i++) {
+            page[op + i] = page[op - offset + i];
+        }
+        op += match_len;
+    }
+
+    return op == PAGE_SIZE ? DSM_SUCCESS : DSM_ERROR_INVALID;
+}
+
+int page_codec_decode(uint8_t encoding, const uint8_t *data, size_t len, uint8_t *page) {
+    switch (encoding) {
+        case PAGE_ENCODING_RAW:
+            if (len != PAGE_SIZE) {
+                return DSM_ERROR_INVALID;
+            }
+            memcpy(page, data, PAGE_SIZE);
+            return DSM_SUCCESS;
+        case PAGE_ENCODING_ZERO:
+            memset(page, 0, PAGE_SIZE);
+            return DSM_SUCCESS;
+        case PAGE_ENCODING_LZ:
+            return lz_decode(data, len, page);
+        default:
+            return DSM_ERROR_INVALID;
+    }
+}
@@ -0,0 +1,80 @@
+/**
+ * @file page_codec.h
+ * @brief Page compression for PAGE_REPLY
+ *
+ * Sparse pages do not need 4KB on the wire. The owner encodes a page it
+ * sends as one of:
+ *
+ * - PAGE_ENCODING_ZERO: the page is all zeros, no data follows.
+ * - PAGE_ENCODING_LZ: LZ4-style byte-oriented LZ77 (literal runs and
+ *   matches within the page), used only when it saves at least
+ *   PAGE_CODEC_MIN_SAVING bytes.
+ * - PAGE_ENCODING_RAW: the page as is, sent zero-copy from the page.
+ *
+ * The encodings an owner may use are the intersection of the allocation's
+ * dsm_compression_t and the encodings the requester listed in its
+ * PAGE_REQUEST. Blocks larger than PAGE_SIZE are only ever sent ZERO or RAW.
+ */
+
+#ifndef PAGE_CODEC_H
+#define PAGE_CODEC_H
+
+#include "dsm/types.h"
+#include "protocol.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Smallest saving for which an LZ encoding is sent instead of the raw page */
+#define PAGE_CODEC_MIN_SAVING (PAGE_SIZE / 8)
+
+/** Bit for an encoding in page_request_payload_t.accept_encodings */
+#define PAGE_ENCODING_BIT(enc) (1u << (enc))
+
+/**
+ * Encodings this node can decode, for PAGE_REQUEST
+ */
+uint8_t page_codec_supported(void);
+
+/**
+ * Compression mode an owner may use for one reply
+ *
+ * @param mode Compression mode of the page's allocation
+ * @param accepted Encodings accepted by the requester (PAGE_ENCODING_BIT mask)
+ * @return Strongest mode both sides allow
+ */
+dsm_compression_t page_codec_negotiate(dsm_compression_t mode, uint8_t accepted);
+
+/**
+ * Check whether a page or block is all zeros
+ *
+ * @param data Bytes to check
+ * @param len Bytes of data (a multiple of 8)
+ */
+bool page_codec_is_zero(const uint8_t *data, size_t len);
+
+/**
+ * Encode a page
+ *
+ * @param page Page contents (PAGE_SIZE bytes)
+ * @param mode Negotiated compression mode
+ * @param out Output buffer of at least PAGE_SIZE bytes
+ * @param encoding Output: page_encoding_t chosen
+ * @return Bytes of out used; PAGE_SIZE for PAGE_ENCODING_RAW, in which case
+ *         out is not written and the page itself should be sent
+ */
+size_t page_codec_encode(const uint8_t *page, dsm_compression_t mode, uint8_t *out,
+                         uint8_t *encoding);
+
+/**
+ * Decode a page
+ *
+ * @param encoding page_encoding_t of data
+ * @param data Encoded bytes
+ * @param len Bytes of data
+ * @param page Output page (PAGE_SIZE bytes)
+ * @return DSM_SUCCESS, or DSM_ERROR_INVALID if the data is malformed
+ */
+int page_codec_decode(uint8_t encoding, const uint8_t *data, size_t len, uint8_t *page);
+
+#endif /* PAGE_CODEC_H */
@@ -0,0 +1,207 @@
+/**
+ * @file pending_query.c
+ * @brief In-flight request table implementation
+ */
+
+#include "pending_query.h"
+#include "../core/log.h"
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+static pending_query_t* find_slot(pending_query_table_t *table, page_id_t page_id,
+                                  uint64_t request_id) {
+    for (int i = 0; i < MAX_PENDING_QUERIES; i++) {
+        pending_query_t *q = &table->slots[i];
+        if (q->in_use && !q->complete &&
+            q->request_id == request_id && q->page_id == page_id) {
+            return q;
+        }
+    }
+    return NULL;
+}
+
+static void release_slot_locked(pending_query_table_t *table, int slot) {
+    table->slots[slot].in_use = false;
+    table->slots[slot].complete = false;
+    table->num_in_use--;
+    pthread_cond_signal(&table->slot_free_cv);
+}
+
+void pending_query_table_init(pending_query_table_t *table) {
+    for (int i = 0; i < MAX_PENDING_QUERIES; i++) {
+        table->slots[i].in_use = false;
+        table->slots[i].complete = false;
+        table->slots[i].aborted = false;
+        table->slots[i].request_id = 0;
+        table->slots[i].num_sharers = 0;
+        pthread_cond_init(&table->slots[i].cv, NULL);
+    }
+    table->num_in_use = 0;
+    table->next_request_id = 1;  /* Start at 1 (0 reserved) */
+    pthread_mutex_init(&table->lock, NULL);
+    pthread_cond_init(&table->slot_free_cv, NULL);
+}
+
+void pending_query_table_destroy(pending_query_table_t *table) {
+    for (int i = 0; i < MAX_PENDING_QUERIES; i++) {
+        pthread_cond_destroy(&table->slots[i].cv);
+    }
+    pthread_mutex_destroy(&table->lock);
+    pthread_cond_destroy(&table->slot_free_cv);
+}
+
+int pending_query_register(pending_query_table_t *table, page_id_t page_id,
+                           int timeout_sec, uint64_t *request_id) {
+    struct timespec timeout;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec += timeout_sec;
+
+    pthread_mutex_lock(&table->lock);
+
+    while (table->num_in_use >= MAX_PENDING_QUERIES) {
+        int rc = pthread_cond_timedwait(&table->slot_free_cv, &table->lock, &timeout);
+        if (rc == ETIMEDOUT) {
+            pthread_mutex_unlock(&table->lock);
+            LOG_ERROR("No free query slot for page %lu (%d outstanding)",
+                      page_id, MAX_PENDING_QUERIES);
+            return DSM_ERROR_TIMEOUT;
+        }
+    }
+
+    int slot = -1;
+    for (int i = 0; i < MAX_PENDING_QUERIES; i++) {
+        if (!table->slots[i].in_use) {
+            slot = i;
+            break;
+        }
+    }
+
+    pending_query_t *q = &table->slots[slot];
+    q->in_use = true;
+    q->complete = false;
+    q->aborted = false;
+    q->request_id = table->next_request_id++;
+    q->page_id = page_id;
+    q->owner = (node_id_t)-1;
+    q->num_sharers = 0;
+    table->num_in_use++;
+
+    *request_id = q->request_id;
+
+    pthread_mutex_unlock(&table->lock);
+    return slot;
+}
+
+int pending_query_wait(pending_query_table_t *table, int slot, int timeout_sec,
+                       pending_query_t *result) {
+    struct timespec timeout;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec += timeout_sec;
+
+    pthread_mutex_lock(&table->lock);
+
+    pending_query_t *q = &table->slots[slot];
+    while (!q->complete) {
+        int rc = pthread_cond_timedwait(&q->cv, &table->lock, &timeout);
+        if (rc == ETIMEDOUT && !q->complete) {
+            LOG_DEBUG("Query %lu for page %lu timed out", q->request_id, q->page_id);
+            release_slot_locked(table, slot);
+            pthread_mutex_unlock(&table->lock);
+            return DSM_ERROR_TIMEOUT;
+        }
+    }
+
+    if (q->aborted) {
+        LOG_DEBUG("Query %lu for page %lu aborted", q->request_id, q->page_id);
+        release_slot_locked(table, slot);
+        pthread_mutex_unlock(&table->lock);
+        return DSM_ERROR_NETWORK;
+    }
+
+    if (result) {
+        /* Reply fields only: the condition variable stays with the slot */
+        result->request_id = q->request_id;
+        result->page_id = q->page_id;
+        result->owner = q->owner;
+        result->num_sharers = q->num_sharers;
+        memcpy(result->sharers, q->sharers, (size_t)q->num_sharers * sizeof(q->sharers[0]));
+    }
+    release_slot_locked(table, slot);
+
+    pthread_mutex_unlock(&table->lock);
+    return DSM_SUCCESS;
+}
+
+void pending_query_cancel(pending_query_table_t *table, int slot) {
+    pthread_mutex_lock(&table->lock);
+    if (table->slots[slot].in_use) {
+        release_slot_locked(table, slot);
+    }
+    pthread_mutex_unlock(&table->lock);
+}
+
+int pending_query_abort_all(pending_query_table_t *table) {
+    int aborted = 0;
+
+    pthread_mutex_lock(&table->lock);
+    for (int i = 0; i < MAX_PENDING_QUERIES; i++) {
+        pending_query_t *q = &table->slots[i];
+        if (q->in_use && !q->complete) {
+            q->aborted = true;
+            q->complete = true;
+            pthread_cond_signal(&q->cv);
+            aborted++;
+        }
+    }
+    pthread_mutex_unlock(&table->lock);
+
+    return aborted;
+}
+
+int pending_query_complete_owner(pending_query_table_t *table, page_id_t page_id,
+                                 uint64_t request_id, node_id_t owner) {
+    pthread_mutex_lock(&table->lock);
+
+    pending_query_t *q = find_slot(table, page_id, request_id);
+    if (!q) {
+        pthread_mutex_unlock(&table->lock);
+        return DSM_ERROR_NOT_FOUND;
+    }
+
+    q->owner = owner;
+    q->complete = true;
+    pthread_cond_signal(&q->cv);
+
+    pthread_mutex_unlock(&table->lock);
+    return DSM_SUCCESS;
+}
+
+int pending_query_complete_sharers(pending_query_table_t *table, page_id_t page_id,
+                                   uint64_t request_id, const node_id_t *sharers,
+                                   int num_sharers) {
+    pthread_mutex_lock(&table->lock);
+
+    pending_query_t *q = find_slot(table, page_id, request_id);
+    if (!q) {
+        pthread_mutex_unlock(&table->lock);
+        return DSM_ERROR_NOT_FOUND;
+    }
+
+    int max = (int)(sizeof(q->sharers) / sizeof(q->sharers[0]));
+    if (num_sharers < 0) {
+        num_sharers = 0;
+    }
+    if (num_sharers > max) {
+        num_sharers = max;
+    }
+    for (int i = 0; i < num_sharers; i++) {
+        q->sharers[i] = sharers[i];
+    }
+    q->num_sharers = num_sharers;
+    q->complete = true;
+    pthread_cond_signal(&q->cv);
+
+    pthread_mutex_unlock(&table->lock);
+    return DSM_SUCCESS;
+}
@@ -0,0 +1,136 @@
+/**
+ * @file pending_query.h
+ * @brief In-flight request table for DIR_QUERY / SHARER_QUERY round trips
+ *
+ * Each outstanding query occupies one slot keyed by (page_id, request_id).
+ * The request_id travels in the query payload and is echoed back by the
+ * reply, so any number of faulting threads can have queries in flight at
+ * once and each reply wakes exactly the thread that issued it.
+ */
+
+#ifndef PENDING_QUERY_H
+#define PENDING_QUERY_H
+
+#include "dsm/types.h"
+#include <pthread.h>
+#include <stdbool.h>
+
+/** Maximum number of concurrently outstanding queries per table */
+#define MAX_PENDING_QUERIES 64
+
+/**
+ * Single outstanding query
+ */
+typedef struct {
+    bool in_use;                 /**< Slot is allocated to a waiter */
+    bool complete;               /**< Reply has arrived (or the query was aborted) */
+    bool aborted;                /**< Completed by pending_query_abort_all(), without a reply */
+    uint64_t request_id;         /**< Request ID echoed back by the reply */
+    page_id_t page_id;           /**< Page being queried */
+    node_id_t owner;             /**< Owner returned (DIR_REPLY) */
+    int num_sharers;             /**< Number of sharers returned (SHARER_REPLY) */
+    node_id_t sharers[MAX_SHARERS]; /**< Sharers returned */
+    pthread_cond_t cv;           /**< Signaled when this slot completes */
+} pending_query_t;
+
+/**
+ * Table of outstanding queries
+ */
+typedef struct {
+    pending_query_t slots[MAX_PENDING_QUERIES];
+    int num_in_use;              /**< Number of allocated slots */
+    uint64_t next_request_id;    /**< Next request ID to hand out (0 reserved) */
+    pthread_mutex_t lock;        /**< Protects all slots */
+    pthread_cond_t slot_free_cv; /**< Signaled when a slot is released */
+} pending_query_table_t;
+
+/**
+ * Initialize a pending query table
+ *
+ * @param table Table to initialize
+ */
+void pending_query_table_init(pending_query_table_t *table);
+
+/**
+ * Destroy a pending query table
+ *
+ * @param table Table to destroy
+ */
+void pending_query_table_destroy(pending_query_table_t *table);
+
+/**
+ * Register a new outstanding query
+ *
+ * Blocks (up to timeout_sec) if every slot is in use.
+ *
+ * @param table Query table
+ * @param page_id Page being queried
+ * @param timeout_sec Maximum time to wait for a free slot
+ * @param request_id Output: request ID to place in the query payload
+ * @return Slot index (>= 0) on success, DSM_ERROR_TIMEOUT if no slot freed up
+ */
+int pending_query_register(pending_query_table_t *table, page_id_t page_id,
+                           int timeout_sec, uint64_t *request_id);
+
+/**
+ * Wait for a registered query to complete and release its slot
+ *
+ * The slot is always released, whether the reply arrived or not, so a
+ * late reply for a timed-out query is simply dropped.
+ *
+ * @param table Query table
+ * @param slot Slot index returned by pending_query_register
+ * @param timeout_sec Maximum time to wait for the reply
+ * @param result Output: request ID, page, owner and the num_sharers sharers
+ *               of the completed slot (may be NULL); other fields are left alone
+ * @return DSM_SUCCESS on reply, DSM_ERROR_TIMEOUT on timeout,
+ *         DSM_ERROR_NETWORK if the query was aborted
+ */
+int pending_query_wait(pending_query_table_t *table, int slot, int timeout_sec,
+                       pending_query_t *result);
+
+/**
+ * Release a registered slot without waiting (e.g. the send failed)
+ *
+ * @param table Query table
+ * @param slot Slot index returned by pending_query_register
+ */
+void pending_query_cancel(pending_query_table_t *table, int slot);
+
+/**
+ * Abort every outstanding query, e.g. when the node they went to failed
+ * Waiters return DSM_ERROR_NETWORK at once instead of running out their
+ * timeout; replies that still arrive are dropped.
+ *
+ * @param table Query table
+ * @return Number of queries aborted
+ */
+int pending_query_abort_all(pending_query_table_t *table);
+
+/**
+ * Complete the query matching (page_id, request_id) with an owner
+ *
+ * @param table Query table
+ * @param page_id Page ID from the reply
+ * @param request_id Request ID echoed by the reply
+ * @param owner Owner returned by the manager
+ * @return DSM_SUCCESS if a waiter was found, DSM_ERROR_NOT_FOUND otherwise
+ */
+int pending_query_complete_owner(pending_query_table_t *table, page_id_t page_id,
+                                 uint64_t request_id, node_id_t owner);
+
+/**
+ * Complete the query matching (page_id, request_id) with a sharer list
+ *
+ * @param table Query table
+ * @param page_id Page ID from the reply
+ * @param request_id Request ID echoed by the reply
+ * @param sharers Sharer node IDs
+ * @param num_sharers Number of sharers
+ * @return DSM_SUCCESS if a waiter was found, DSM_ERROR_NOT_FOUND otherwise
+ */
+int pending_query_complete_sharers(pending_query_table_t *table, page_id_t page_id,
+                                   uint64_t request_id, const node_id_t *sharers,
+                                   int num_sharers);
+
+#endif /* PENDING_QUERY_H */
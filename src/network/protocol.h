@@ -13,11 +13,6 @@
 #include <stdint.h>
 #include <pthread.h>
 
-/* Maximum number of sharers to track per page */
-#ifndef MAX_SHARERS
-#define MAX_SHARERS 32
-#endif
-
 /* ============================ */
 /*     Message Types            */
 /* ============================ */
@@ -35,6 +30,7 @@ typedef enum {
     MSG_LOCK_RELEASE,          /**< Release a lock */
     MSG_BARRIER_ARRIVE,        /**< Arrive at barrier */
     MSG_BARRIER_RELEASE,       /**< Release all from barrier */
+    MSG_BARRIER_SIGNAL,        /**< One round of a dissemination barrier */
     MSG_ALLOC_NOTIFY,          /**< Notify nodes of new allocation */
     MSG_ALLOC_ACK,             /**< Acknowledge allocation notification */
     MSG_NODE_JOIN,             /**< Node joining cluster */
@@ -54,9 +50,41 @@ typedef enum {
     MSG_STATE_SYNC_BARRIER,    /**< Replicate barrier state */
     MSG_STATE_SYNC_NODE,       /**< Replicate node metadata */
     MSG_MANAGER_PROMOTION,     /**< Backup announces promotion */
-    MSG_RECONNECT_REQUEST      /**< Worker requests reconnection */
+    MSG_RECONNECT_REQUEST,     /**< Worker requests reconnection */
+    /* Release consistency messages */
+    MSG_PAGE_DIFF,             /**< Writer sends page diff to home node */
+    MSG_PAGE_DIFF_ACK,         /**< Home acknowledges an applied diff */
+    /* Prefetch messages */
+    MSG_PAGE_BATCH_REQUEST,    /**< Request several pages in one message */
+    MSG_PAGE_BATCH_REPLY,      /**< Several pages in one message (bulk frame) */
+    /* Lock token messages */
+    MSG_LOCK_RECALL,           /**< Ask a lock's holder to return the token */
+    /* Invalidation fan-out */
+    MSG_INVALIDATE_FANOUT,     /**< Writer asks the manager to invalidate a page's copies */
+    /* Ownership upgrade */
+    MSG_PAGE_UPGRADE,          /**< Invalidate a page's copies, then forward a write request */
+    /* Transport handshake */
+    MSG_TRANSPORT_CONNECT,     /**< Move a connection's frames to another transport */
+    /* TCP lanes */
+    MSG_TCP_LANE,              /**< Add extra TCP connections to a peer */
+    /* Replication log */
+    MSG_STATE_SYNC_BATCH,      /**< Several STATE_SYNC_* records (bulk frame) */
+    /* Bootstrap */
+    MSG_NODE_ROSTER,           /**< Manager lists the cluster once every node has joined */
+    /* One-sided transfers */
+    MSG_RMA_REQUEST,           /**< Read or write bytes of pages where they are held (bulk frame for puts) */
+    MSG_RMA_REPLY,             /**< Outcome of an RMA_REQUEST (bulk frame for gets) */
+    /* Peer links */
+    MSG_PEER_HELLO,            /**< First frame on a link one worker opened to another */
+    /* Indirect probing */
+    MSG_PROBE_REQUEST,         /**< Ask a node to probe a peer that went silent on us */
+    MSG_PROBE,                 /**< Probe sent on the asked node's own link to the peer */
+    MSG_PROBE_ACK              /**< The peer answered; relayed back to the node that asked */
 } msg_type_t;
 
+/** Highest msg_type_t value */
+#define MSG_TYPE_MAX MSG_PROBE_ACK
+
 /* ============================ */
 /*     Message Header           */
 /* ============================ */
@@ -87,17 +115,40 @@ typedef struct {
     page_id_t page_id;         /**< Requested page ID */
     access_type_t access;      /**< READ or WRITE access */
     node_id_t requester;       /**< Requesting node ID */
+    uint64_t cached_version;   /**< Version of the requester's stale copy, 0 if it has none */
+    uint8_t accept_encodings;  /**< Page encodings the requester decodes (PAGE_ENCODING_BIT mask) */
 } __attribute__((packed)) page_request_payload_t;
 
+/**
+ * Encoding of PAGE_REPLY data (see page_codec.h)
+ */
+typedef enum {
+    PAGE_ENCODING_RAW = 0,     /**< data[] is the page (PAGE_SIZE bytes) */
+    PAGE_ENCODING_ZERO,        /**< Page is all zeros, no data */
+    PAGE_ENCODING_LZ           /**< data[] holds data_len bytes of LZ stream */
+} page_encoding_t;
+
 /**
  * PAGE_REPLY message payload
+ * When copy_current is set the reply is a grant only: data[] is not sent
+ * and the requester keeps its cached copy, which is at this version.
+ * Otherwise only data_len bytes of data[] go on the wire.
+ *
+ * A page of an allocation with blocks larger than PAGE_SIZE does not fit
+ * in data[]: block_size is set, data[] is not sent and, for
+ * PAGE_ENCODING_RAW, the block follows the payload as bulk data
+ * (network_send_page()). Such blocks are only sent RAW or ZERO.
  */
 typedef struct {
     page_id_t page_id;         /**< Page ID */
     uint64_t version;          /**< Page version number */
     access_type_t access;      /**< Access type granted (READ or WRITE) */
     node_id_t requester;       /**< Original requester (for manager proxying) */
-    uint8_t data[PAGE_SIZE];   /**< Page data (4KB) */
+    uint8_t copy_current;      /**< Nonzero: requester's cached copy is current, no data follows */
+    uint8_t encoding;          /**< page_encoding_t of data[] */
+    uint16_t data_len;         /**< Bytes of data[] used (PAGE_SIZE when RAW) */
+    uint32_t block_size;       /**< Bytes in the page when above PAGE_SIZE (bulk data), else 0 */
+    uint8_t data[PAGE_SIZE];   /**< Page data (4KB), possibly encoded */
 } __attribute__((packed)) page_reply_payload_t;
 
 /**
@@ -107,6 +158,7 @@ typedef struct {
     page_id_t page_id;         /**< Page to invalidate */
     node_id_t new_owner;       /**< New owner node ID */
     uint64_t version;          /**< New version number */
+    uint8_t advice;            /**< directory_advice_t for the receiver, from the page's directory node */
 } __attribute__((packed)) invalidate_payload_t;
 
 /**
@@ -117,51 +169,134 @@ typedef struct {
     node_id_t acker;           /**< Node that acknowledged */
 } __attribute__((packed)) invalidate_ack_payload_t;
 
+/**
+ * Lock modes of LOCK_REQUEST and LOCK_GRANT
+ *
+ * A shared token may be held by several nodes at once (dsm_rwlock_rdlock());
+ * an exclusive one by a single node, whose threads may also read under it.
+ */
+typedef enum {
+    LOCK_MODE_EXCLUSIVE = 0,   /**< Mutual exclusion (dsm_lock_t, writers) */
+    LOCK_MODE_SHARED           /**< Shared by readers */
+} lock_mode_t;
+
 /**
  * LOCK_REQUEST message payload
  */
 typedef struct {
     lock_id_t lock_id;         /**< Lock identifier */
     node_id_t requester;       /**< Requesting node */
+    uint8_t mode;              /**< lock_mode_t requested */
 } __attribute__((packed)) lock_request_payload_t;
 
 /**
  * LOCK_GRANT message payload
+ *
+ * Passes the lock's token to the grantee, which keeps it after release
+ * until the manager recalls it. recall set means other nodes already
+ * wait, so the token goes back to the manager on the first release.
  */
 typedef struct {
     lock_id_t lock_id;         /**< Lock identifier */
     node_id_t grantee;         /**< Node granted the lock */
+    uint8_t recall;            /**< Return the token on release */
+    uint8_t mode;              /**< lock_mode_t of the token */
 } __attribute__((packed)) lock_grant_payload_t;
 
 /**
  * LOCK_RELEASE message payload
+ * Returns the lock's token to the manager.
  */
 typedef struct {
     lock_id_t lock_id;         /**< Lock identifier */
     node_id_t releaser;        /**< Node releasing lock */
 } __attribute__((packed)) lock_release_payload_t;
 
+/**
+ * LOCK_RECALL message payload
+ *
+ * Sent by the manager to the token's holder when another node requests
+ * the lock. The holder answers with LOCK_RELEASE once no thread of its
+ * own is in the critical section.
+ */
+typedef struct {
+    lock_id_t lock_id;         /**< Lock identifier */
+    node_id_t holder;          /**< Node asked to return the token */
+} __attribute__((packed)) lock_recall_payload_t;
+
+/** Most write notices carried by one BARRIER_ARRIVE or BARRIER_RELEASE */
+#define BARRIER_NOTICE_MAX 256
+
+/**
+ * Collective carried by a barrier episode
+ */
+typedef enum {
+    COLLECTIVE_NONE = 0,       /**< Plain dsm_barrier() */
+    COLLECTIVE_ALLREDUCE,      /**< Every arrival contributes; every node gets the result */
+    COLLECTIVE_REDUCE,         /**< Every arrival contributes; only the root gets the result */
+    COLLECTIVE_BROADCAST       /**< Only the root contributes; every node gets its bytes */
+} collective_kind_t;
+
 /**
  * BARRIER_ARRIVE message payload
+ * Under release consistency it carries the write notices of the arriver:
+ * pages it changed (diffed, or wrote as their home) since its last arrival.
+ * An arrival contributing to a collective is a bulk frame whose data is
+ * its contribution (collective_len bytes).
  */
 typedef struct {
     barrier_id_t barrier_id;   /**< Barrier identifier */
     node_id_t arriver;         /**< Arriving node */
     int num_participants;      /**< Total expected participants */
+    uint8_t collective;        /**< collective_kind_t of the episode */
+    uint8_t reduce_type;       /**< dsm_datatype_t of a reduction */
+    uint8_t reduce_op;         /**< dsm_reduce_op_t of a reduction */
+    node_id_t root;            /**< Root of a reduce or broadcast */
+    uint32_t collective_len;   /**< Bytes of the collective's buffer */
+    uint8_t notices_overflow;  /**< 1 if more pages were written than notices holds */
+    uint16_t num_notices;      /**< Entries in notices (only these go on the wire) */
+    page_id_t notices[BARRIER_NOTICE_MAX]; /**< Written pages */
 } __attribute__((packed)) barrier_arrive_payload_t;
 
 /**
  * BARRIER_RELEASE message payload
+ * Under release consistency it carries the union of the arrivals' write
+ * notices; on overflow every cached copy is invalidated instead. A release
+ * delivering a collective's result is a bulk frame whose data is the result.
  */
 typedef struct {
     barrier_id_t barrier_id;   /**< Barrier identifier */
     int num_arrived;           /**< Number that arrived */
+    uint8_t collective_failed; /**< 1 if the arrivals disagreed on the collective */
+    uint8_t notices_overflow;  /**< 1 if the union did not fit in notices */
+    uint16_t num_notices;      /**< Entries in notices (only these go on the wire) */
+    page_id_t notices[BARRIER_NOTICE_MAX]; /**< Pages written during the episode */
 } __attribute__((packed)) barrier_release_payload_t;
 
+/**
+ * BARRIER_SIGNAL message payload
+ * In round k of a dissemination barrier node i signals node (i + 2^k) mod N.
+ * Under release consistency it carries the write notices the sender has
+ * heard of so far, its own included.
+ */
+typedef struct {
+    barrier_id_t barrier_id;   /**< Barrier identifier */
+    node_id_t from;            /**< Signalling node */
+    node_id_t to;              /**< Signalled node; the manager relays signals between workers without a link */
+    uint8_t round;             /**< Round of the episode, from 0 */
+    uint8_t parity;            /**< Episode number mod 2 (a signal can be one episode ahead of its receiver) */
+    uint8_t notices_overflow;  /**< 1 if the notices did not fit */
+    uint16_t num_notices;      /**< Entries in notices (only these go on the wire) */
+    page_id_t notices[BARRIER_NOTICE_MAX]; /**< Pages written during the episode */
+} __attribute__((packed)) barrier_signal_payload_t;
+
 /**
  * ALLOC_NOTIFY message payload
  * Sent by a node to notify all other nodes of a new allocation
  * Workers must create mmap at the same virtual address for SVAS
+ * owner is the allocating node, which waits for the ALLOC_ACKs; the
+ * initial owner of each page follows from the placement fields
+ * (page_placement_owner()).
  */
 typedef struct {
     page_id_t start_page_id;   /**< First page ID in allocation */
@@ -170,6 +305,11 @@ typedef struct {
     size_t num_pages;          /**< Number of pages allocated */
     uint64_t base_addr;        /**< Virtual address of allocation (for SVAS) */
     size_t total_size;         /**< Total size in bytes */
+    uint8_t compression;       /**< dsm_compression_t of the allocation */
+    uint32_t block_size;       /**< Bytes per page of the allocation (0 means PAGE_SIZE) */
+    uint8_t placement;         /**< dsm_placement_t of the allocation */
+    node_id_t home_node;       /**< Home node for DSM_PLACEMENT_HOME */
+    uint32_t placement_nodes;  /**< Nodes the allocator spread the pages over */
 } __attribute__((packed)) alloc_notify_payload_t;
 
 /**
@@ -178,7 +318,7 @@ typedef struct {
 typedef struct {
     node_id_t node_id;         /**< Joining node ID */
     char hostname[MAX_HOSTNAME_LEN]; /**< Hostname */
-    uint16_t port;             /**< Port number */
+    uint16_t port;             /**< Port it takes peer links on (0 = none) */
 } __attribute__((packed)) node_join_payload_t;
 
 /**
@@ -188,6 +328,44 @@ typedef struct {
     node_id_t node_id;         /**< Leaving node ID */
 } __attribute__((packed)) node_leave_payload_t;
 
+/**
+ * NODE_ROSTER message payload
+ *
+ * Sent by the manager to every worker once all dsm_config_t.num_nodes
+ * nodes have joined. Workers join only when fully initialized, so a
+ * worker holding the roster knows the whole cluster is up.
+ *
+ * A bulk frame: one roster_address_t per member follows, in member order,
+ * telling workers where to open links to each other.
+ */
+typedef struct {
+    int num_members;           /**< Nodes in the cluster, the manager included */
+    node_id_t members[MAX_SHARERS]; /**< Their IDs (only num_members go on the wire) */
+} __attribute__((packed)) node_roster_payload_t;
+
+/**
+ * Where a roster member takes peer links
+ */
+typedef struct {
+    uint32_t addr;             /**< IPv4 address it joined from (network byte order) */
+    uint16_t port;             /**< Port it listens on for peer links (0 = none) */
+} __attribute__((packed)) roster_address_t;
+
+/**
+ * PEER_HELLO message payload
+ */
+typedef struct {
+    node_id_t node_id;         /**< Worker that opened the link */
+} __attribute__((packed)) peer_hello_payload_t;
+
+/**
+ * PROBE_REQUEST, PROBE and PROBE_ACK message payload
+ */
+typedef struct {
+    node_id_t origin;          /**< Node that suspects target and asked for the probe */
+    node_id_t target;          /**< Node being probed */
+} __attribute__((packed)) probe_payload_t;
+
 /**
  * ALLOC_ACK message payload
  */
@@ -211,6 +389,7 @@ typedef struct {
 typedef struct {
     page_id_t page_id;         /**< Requested page ID */
     node_id_t requester;       /**< Requesting node ID */
+    uint64_t request_id;       /**< Requester's query ID (echoed in reply) */
 } __attribute__((packed)) dir_query_payload_t;
 
 /**
@@ -219,6 +398,8 @@ typedef struct {
 typedef struct {
     page_id_t page_id;         /**< Page ID */
     node_id_t owner;           /**< Current owner node ID */
+    uint64_t request_id;       /**< Query ID from the matching DIR_QUERY */
+    uint8_t advice;            /**< directory_advice_t for the requester (dsm_config_t.adaptive) */
 } __attribute__((packed)) dir_reply_payload_t;
 
 /**
@@ -242,15 +423,47 @@ typedef struct {
 typedef struct {
     page_id_t page_id;         /**< Page ID */
     node_id_t requester;       /**< Requesting node ID */
+    uint64_t request_id;       /**< Requester's query ID (echoed in reply) */
 } __attribute__((packed)) sharer_query_payload_t;
 
+/**
+ * INVALIDATE_FANOUT message payload
+ *
+ * Sent by a worker that takes write access to a page. The manager adds
+ * the sharers it tracks to the ones listed, sends every one an INVALIDATE
+ * at once and answers with a single INVALIDATE_ACK when all have acked.
+ */
+typedef struct {
+    page_id_t page_id;         /**< Page being written */
+    node_id_t writer;          /**< New owner, waiting for the ACK */
+    node_id_t exclude;         /**< Owner the writer fetches from (gives up its copy itself), or DSM_NODE_NONE */
+    int num_sharers;           /**< Number of sharers known to the writer */
+    node_id_t sharers[MAX_SHARERS]; /**< Those sharers (only num_sharers go on the wire) */
+} __attribute__((packed)) invalidate_fanout_payload_t;
+
+/**
+ * PAGE_UPGRADE message payload
+ *
+ * Sent to the manager by a worker that takes write access to a page
+ * owned elsewhere: an INVALIDATE_FANOUT whose completion forwards the
+ * embedded write PAGE_REQUEST instead of acking. A requester whose copy
+ * is current gets ownership in a data-less PAGE_REPLY.
+ */
+typedef struct {
+    page_request_payload_t request; /**< Write request served once the sharers are invalidated */
+    node_id_t owner;           /**< Owner the request goes to (gives up its copy itself) */
+    int num_sharers;           /**< Number of sharers known to the requester */
+    node_id_t sharers[MAX_SHARERS]; /**< Those sharers (only num_sharers go on the wire) */
+} __attribute__((packed)) page_upgrade_payload_t;
+
 /**
  * SHARER_REPLY message payload
  */
 typedef struct {
     page_id_t page_id;         /**< Page ID */
+    uint64_t request_id;       /**< Query ID from the matching SHARER_QUERY */
     int num_sharers;           /**< Number of sharers */
-    node_id_t sharers[MAX_SHARERS]; /**< List of sharer node IDs */
+    node_id_t sharers[MAX_SHARERS]; /**< Sharer node IDs (only num_sharers go on the wire) */
 } __attribute__((packed)) sharer_reply_payload_t;
 
 /**
@@ -271,19 +484,26 @@ typedef struct {
     page_id_t page_id;         /**< Page ID */
     node_id_t owner;           /**< Current owner node ID */
     int num_sharers;           /**< Number of sharers */
-    node_id_t sharers[MAX_SHARERS]; /**< List of sharer node IDs */
+    node_id_t sharers[MAX_SHARERS]; /**< Sharer node IDs (only num_sharers go on the wire) */
 } __attribute__((packed)) state_sync_dir_payload_t;
 
+/** Flag on a STATE_SYNC_LOCK waiter that asked for a shared token */
+#define LOCK_SYNC_SHARED_WAITER 0x80000000u
+
 /**
  * STATE_SYNC_LOCK message payload
- * Replicates lock state to backup nodes
+ *
+ * Replicates lock state to backup nodes. waiters[] lists the num_readers
+ * nodes holding a shared token, then the num_waiters queued requests, the
+ * shared ones tagged with LOCK_SYNC_SHARED_WAITER.
  */
 typedef struct {
     uint64_t sync_seq;         /**< Sequence number for ordering */
     lock_id_t lock_id;         /**< Lock identifier */
-    node_id_t holder;          /**< Current lock holder (or -1 if free) */
+    node_id_t holder;          /**< Exclusive holder (or -1 if free or shared) */
+    int num_readers;           /**< Nodes holding a shared token */
     int num_waiters;           /**< Number of waiters in queue */
-    node_id_t waiters[32];     /**< FIFO queue of waiters */
+    node_id_t waiters[MAX_SHARERS]; /**< Readers, then the FIFO queue (only the used entries go on the wire) */
 } __attribute__((packed)) state_sync_lock_payload_t;
 
 /**
@@ -298,6 +518,25 @@ typedef struct {
     uint64_t generation;       /**< Barrier generation number */
 } __attribute__((packed)) state_sync_barrier_payload_t;
 
+/**
+ * One record of a STATE_SYNC_BATCH
+ * Followed by len bytes: the wire payload of a STATE_SYNC_DIR, _LOCK or
+ * _BARRIER message of the given type.
+ */
+typedef struct {
+    uint8_t type;              /**< msg_type_t of the record */
+    uint32_t len;              /**< Payload bytes that follow */
+} __attribute__((packed)) state_sync_record_t;
+
+/**
+ * STATE_SYNC_BATCH message payload
+ * The frame's bulk data holds num_records records in replication log order.
+ */
+typedef struct {
+    uint64_t last_seq;         /**< sync_seq of the last record */
+    uint32_t num_records;      /**< Records in the bulk data */
+} __attribute__((packed)) state_sync_batch_payload_t;
+
 /**
  * STATE_SYNC_NODE message payload
  * Replicates node metadata to backup nodes
@@ -328,6 +567,207 @@ typedef struct {
     uint64_t last_seq_seen;    /**< Last sequence number seen from old manager */
 } __attribute__((packed)) reconnect_request_payload_t;
 
+/** Largest run-length diff carried by one PAGE_DIFF (fits a whole-page run) */
+#define PAGE_DIFF_MAX_DATA (PAGE_SIZE + 128)
+
+/**
+ * PAGE_DIFF message payload
+ * Sent at release by a non-home writer; the manager forwards it to the home.
+ * data holds num_runs runs of [uint16 offset][uint16 length][length bytes].
+ * Blocks larger than PAGE_SIZE are diffed one OS page at a time; offsets
+ * are within OS page sub_page of the block.
+ */
+typedef struct {
+    page_id_t page_id;         /**< Page the diff applies to */
+    node_id_t writer;          /**< Node that made the changes (receives the ACK) */
+    node_id_t home;            /**< Home node that applies the diff */
+    uint16_t sub_page;         /**< OS page of the block the runs apply to (0 for single pages) */
+    uint16_t num_runs;         /**< Runs in data */
+    uint16_t data_len;         /**< Bytes of data used (only these go on the wire) */
+    uint8_t data[PAGE_DIFF_MAX_DATA]; /**< Encoded runs */
+} __attribute__((packed)) page_diff_payload_t;
+
+/**
+ * PAGE_DIFF_ACK message payload
+ */
+typedef struct {
+    page_id_t page_id;         /**< Page the diff applied to */
+    node_id_t writer;          /**< Node waiting for the ACK */
+    node_id_t home;            /**< Home node that applied the diff */
+    int result;                /**< DSM_SUCCESS or error code */
+} __attribute__((packed)) page_diff_ack_payload_t;
+
+/** Most pages carried by one PAGE_BATCH_REQUEST */
+#define PAGE_BATCH_MAX 64
+
+/**
+ * One page of a PAGE_BATCH_REQUEST
+ */
+typedef struct {
+    page_id_t page_id;         /**< Requested page ID */
+    uint64_t cached_version;   /**< Version of the requester's stale copy, 0 if it has none */
+} __attribute__((packed)) page_batch_entry_t;
+
+/**
+ * PAGE_BATCH_REQUEST message payload
+ * Read requests for several pages with the same owner. The owner answers
+ * the pages it holds with one PAGE_BATCH_REPLY and any others with a
+ * PAGE_REPLY or ERROR each, exactly as for a PAGE_REQUEST.
+ */
+typedef struct {
+    node_id_t requester;       /**< Requesting node ID */
+    uint8_t accept_encodings;  /**< Page encodings the requester decodes (PAGE_ENCODING_BIT mask) */
+    uint16_t num_pages;        /**< Entries in pages (only these go on the wire) */
+    page_batch_entry_t pages[PAGE_BATCH_MAX]; /**< Requested pages */
+} __attribute__((packed)) page_batch_request_payload_t;
+
+/** Most page data carried by one PAGE_BATCH_REPLY */
+#define PAGE_BATCH_MAX_DATA (PAGE_BATCH_MAX * PAGE_SIZE)
+
+/**
+ * One page of a PAGE_BATCH_REPLY
+ * Fields mean what they do in page_reply_payload_t.
+ */
+typedef struct {
+    page_id_t page_id;         /**< Page ID */
+    uint64_t version;          /**< Owner's version of the page */
+    uint8_t copy_current;      /**< 1 if the requester's cached copy is current (no data) */
+    uint8_t encoding;          /**< page_encoding_t of the page's data */
+    uint16_t data_len;         /**< Bytes of the page's data in the bulk section */
+} __attribute__((packed)) page_batch_reply_entry_t;
+
+/**
+ * PAGE_BATCH_REPLY message payload
+ * Read copies of several pages. Unlike other messages it is a bulk frame:
+ * the page data does not fit in message_t and follows the payload on the
+ * wire, one data_len run per entry in order (network_send_bulk()).
+ */
+typedef struct {
+    node_id_t requester;       /**< Original requester (for manager forwarding) */
+    uint16_t num_pages;        /**< Entries in pages (only these go on the wire) */
+    page_batch_reply_entry_t pages[PAGE_BATCH_MAX]; /**< Page metadata */
+} __attribute__((packed)) page_batch_reply_payload_t;
+
+/** Most segments carried by one RMA_REQUEST */
+#define RMA_MAX_SEGMENTS PAGE_BATCH_MAX
+
+/** Most bytes moved by one RMA_REQUEST */
+#define RMA_MAX_DATA PAGE_BATCH_MAX_DATA
+
+/**
+ * Operation of an RMA_REQUEST
+ *
+ * Atomics carry one naturally aligned segment of 4 or 8 bytes. Their
+ * request data is the operand (RMA_CAS: expected, then desired) and their
+ * reply data the word's previous value.
+ */
+typedef enum {
+    RMA_GET = 0,               /**< Copy the segments' bytes to the requester */
+    RMA_PUT,                   /**< Write the bulk data into the segments */
+    RMA_FETCH_ADD,             /**< Add the operand to the word */
+    RMA_CAS,                   /**< Replace the word with desired if it equals expected */
+    RMA_SWAP                   /**< Replace the word with the operand */
+} rma_op_t;
+
+/**
+ * Outcome of one RMA segment
+ */
+typedef enum {
+    RMA_DONE = 0,              /**< Applied (a get's bytes or an atomic's old value are in the reply's bulk data) */
+    RMA_MOVED,                 /**< The target no longer holds the page; ask the directory */
+    RMA_FAILED                 /**< Unknown page or segment out of range */
+} rma_status_t;
+
+/**
+ * Bytes of one page moved by an RMA_REQUEST
+ */
+typedef struct {
+    page_id_t page_id;         /**< Page holding the bytes */
+    uint32_t offset;           /**< First byte within the page */
+    uint32_t len;              /**< Bytes (offset + len <= the allocation's block size) */
+    uint32_t index;            /**< Segment's index in the requester's operation */
+} __attribute__((packed)) rma_segment_t;
+
+/**
+ * RMA_REQUEST message payload
+ * Reads or writes bytes of pages at the node holding them without moving
+ * the pages. Workers send it to the manager, which forwards it to target,
+ * or with target DSM_NODE_NONE splits it among the owners its directory
+ * names. For RMA_PUT the bulk data holds the segments' bytes in order,
+ * for an atomic its operands.
+ */
+typedef struct {
+    uint64_t op_id;            /**< Requester's operation, echoed by the reply */
+    node_id_t requester;       /**< Requesting node ID */
+    node_id_t target;          /**< Node asked to serve the segments, DSM_NODE_NONE for the directory's owners */
+    uint8_t op;                /**< rma_op_t */
+    uint16_t num_segments;     /**< Entries in segments (only these go on the wire) */
+    rma_segment_t segments[RMA_MAX_SEGMENTS]; /**< Segments */
+} __attribute__((packed)) rma_request_payload_t;
+
+/**
+ * Outcome of one segment in an RMA_REPLY
+ */
+typedef struct {
+    uint32_t index;            /**< Segment's index in the requester's operation */
+    uint8_t status;            /**< rma_status_t */
+} __attribute__((packed)) rma_result_t;
+
+/**
+ * RMA_REPLY message payload
+ * For RMA_GET the bulk data holds the bytes of the RMA_DONE segments, in
+ * result order; for an applied atomic, the word's old value.
+ */
+typedef struct {
+    uint64_t op_id;            /**< Operation from the request */
+    node_id_t requester;       /**< Requesting node ID (for manager forwarding) */
+    uint8_t op;                /**< rma_op_t */
+    uint16_t num_results;      /**< Entries in results (only these go on the wire) */
+    rma_result_t results[RMA_MAX_SEGMENTS]; /**< Outcomes */
+} __attribute__((packed)) rma_reply_payload_t;
+
+/** Most backend connection data carried by one TRANSPORT_CONNECT */
+#define TRANSPORT_INFO_MAX 64
+
+/**
+ * Steps of the TRANSPORT_CONNECT handshake (see transport.h)
+ */
+typedef enum {
+    TRANSPORT_OFFER = 0,       /**< Sender can connect; info describes its end */
+    TRANSPORT_ACCEPT,          /**< Receiver of the offer connected; info describes its end */
+    TRANSPORT_SWITCHED,        /**< Last frame on the socket: the rest follow on the transport */
+    TRANSPORT_REJECT           /**< Stay on TCP and drop the half-built connection */
+} transport_phase_t;
+
+/**
+ * TRANSPORT_CONNECT message payload
+ * Always sent over the TCP socket of the connection it moves.
+ */
+typedef struct {
+    uint8_t transport;         /**< dsm_transport_t being set up */
+    uint8_t phase;             /**< transport_phase_t */
+    uint16_t info_len;         /**< Bytes of info used */
+    uint8_t info[TRANSPORT_INFO_MAX]; /**< Backend connection data */
+} __attribute__((packed)) transport_connect_payload_t;
+
+/**
+ * Steps of the TCP_LANE handshake (see network_open_lanes())
+ */
+typedef enum {
+    LANE_JOIN = 0,             /**< First frame on a new lane socket: names its node and index */
+    LANE_SWITCHED              /**< Last sharded frame on the main socket: the rest follow on lanes */
+} lane_phase_t;
+
+/**
+ * TCP_LANE message payload
+ */
+typedef struct {
+    node_id_t node_id;         /**< Node that opened the lanes */
+    uint8_t phase;             /**< lane_phase_t */
+    uint8_t lane;              /**< Index of this lane (LANE_JOIN) */
+    uint8_t num_lanes;         /**< Lanes the node opened */
+} __attribute__((packed)) tcp_lane_payload_t;
+
 /* ============================ */
 /*     Complete Message         */
 /* ============================ */
@@ -347,12 +787,17 @@ typedef struct {
         lock_request_payload_t lock_request;
         lock_grant_payload_t lock_grant;
         lock_release_payload_t lock_release;
+        lock_recall_payload_t lock_recall;
         barrier_arrive_payload_t barrier_arrive;
         barrier_release_payload_t barrier_release;
+        barrier_signal_payload_t barrier_signal;
         alloc_notify_payload_t alloc_notify;
         alloc_ack_payload_t alloc_ack;
         node_join_payload_t node_join;
         node_leave_payload_t node_leave;
+        node_roster_payload_t node_roster;
+        peer_hello_payload_t peer_hello;
+        probe_payload_t probe;
         heartbeat_ack_payload_t heartbeat_ack;
         dir_query_payload_t dir_query;
         dir_reply_payload_t dir_reply;
@@ -366,23 +811,54 @@ typedef struct {
         state_sync_lock_payload_t state_sync_lock;
         state_sync_barrier_payload_t state_sync_barrier;
         state_sync_node_payload_t state_sync_node;
+        state_sync_batch_payload_t state_sync_batch;
         manager_promotion_payload_t manager_promotion;
         reconnect_request_payload_t reconnect_request;
+        /* Release consistency payloads */
+        page_diff_payload_t page_diff;
+        page_diff_ack_payload_t page_diff_ack;
+        /* Prefetch payloads */
+        page_batch_request_payload_t page_batch_request;
+        page_batch_reply_payload_t page_batch_reply;
+        /* Invalidation fan-out payloads */
+        invalidate_fanout_payload_t invalidate_fanout;
+        /* Ownership upgrade payloads */
+        page_upgrade_payload_t page_upgrade;
+        /* Transport handshake payloads */
+        transport_connect_payload_t transport_connect;
+        tcp_lane_payload_t tcp_lane;
+        /* One-sided transfer payloads */
+        rma_request_payload_t rma_request;
+        rma_reply_payload_t rma_reply;
         uint8_t raw[PAGE_SIZE + 256]; /**< Raw buffer for largest payload */
     } payload;
 } message_t;
 
+/** Most bulk data carried by one frame: a batch of pages, one whole block or an RMA transfer */
+#define MSG_MAX_BULK_DATA \
+    (PAGE_BATCH_MAX_DATA > DSM_MAX_BLOCK_SIZE ? PAGE_BATCH_MAX_DATA : DSM_MAX_BLOCK_SIZE)
+
+/** Largest frame accepted from the wire: a whole message plus bulk data */
+#define MSG_MAX_FRAME_SIZE (sizeof(message_t) + MSG_MAX_BULK_DATA)
+
 /* ============================ */
 /*     Message Queue Entry      */
 /* ============================ */
 
 /**
  * Entry in message queue for pending requests
+ *
+ * Entries come from msg_pool_get() (see msg_pool.h). msg is last so that
+ * an entry is allocated only as large as its pool class: just the first
+ * msg_pool_capacity() bytes of msg.payload exist.
  */
 typedef struct msg_queue_entry_s {
-    message_t msg;                    /**< The message */
     node_id_t dest;                   /**< Destination node */
+    uint8_t *data;                    /**< Bulk data owned by the entry (malloc'd), or NULL */
+    size_t data_len;                  /**< Bytes of data */
     struct msg_queue_entry_s *next;   /**< Next in queue */
+    uint8_t pool_class;               /**< Size class the entry was allocated in */
+    message_t msg;                    /**< The message (header and wire payload only) */
 } msg_queue_entry_t;
 
 /**
@@ -424,16 +900,64 @@ void msg_queue_destroy(msg_queue_t *queue);
  */
 int msg_queue_enqueue(msg_queue_t *queue, const message_t *msg, node_id_t dest);
 
+/**
+ * Enqueue a message together with its bulk data
+ *
+ * On success the entry takes ownership of data, which is freed with it.
+ *
+ * @param queue Message queue
+ * @param msg Message to enqueue
+ * @param dest Destination node ID
+ * @param data malloc'd bulk data, or NULL
+ * @param data_len Bytes of data
+ * @return DSM_SUCCESS on success, error code on failure (data still the caller's)
+ */
+int msg_queue_enqueue_data(msg_queue_t *queue, const message_t *msg, node_id_t dest,
+                           uint8_t *data, size_t data_len);
+
+/**
+ * Append an entry taken from msg_pool_get()
+ *
+ * The queue takes ownership of the entry and its data; nothing is copied.
+ *
+ * @param queue Message queue
+ * @param entry Entry to append
+ * @return DSM_SUCCESS on success, DSM_ERROR_INVALID (entry still the caller's)
+ */
+int msg_queue_push(msg_queue_t *queue, msg_queue_entry_t *entry);
+
 /**
  * Dequeue a message (blocking)
  *
  * @param queue Message queue
- * @param msg Buffer to store dequeued message
+ * @param msg Buffer to store dequeued message (header and wire payload only)
  * @param dest Buffer to store destination node
  * @return DSM_SUCCESS on success, error code on failure
  */
 int msg_queue_dequeue(msg_queue_t *queue, message_t *msg, node_id_t *dest);
 
+/**
+ * Wait until the queue is non-empty or the timeout expires
+ *
+ * @param queue Message queue
+ * @param timeout_ms Maximum time to wait in milliseconds
+ * @return Number of messages in queue (0 on timeout)
+ */
+int msg_queue_wait(msg_queue_t *queue, int timeout_ms);
+
+/**
+ * Detach up to max entries from the head of the queue (non-blocking)
+ *
+ * Ownership of the returned entries passes to the caller, who must return
+ * them with msg_pool_put(), which also frees their bulk data.
+ *
+ * @param queue Message queue
+ * @param entries Output array of detached entries
+ * @param max Capacity of entries
+ * @return Number of entries detached
+ */
+int msg_queue_dequeue_batch(msg_queue_t *queue, msg_queue_entry_t **entries, int max);
+
 /**
  * Get queue size
  *
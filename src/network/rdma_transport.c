@@ -0,0 +1,850 @@
+/**
+ * @file rdma_transport.c
+ * @brief RDMA (ibverbs) transport backend
+ *
+ * Each peer connection is one reliable-connected queue pair with its own
+ * completion queue and completion channel. Control bytes of the frame
+ * stream are cut into RDMA_CHUNK_SIZE chunks sent with two-sided SEND from
+ * a registered send ring; the receiver keeps RDMA_RECV_SLOTS registered
+ * buffers posted and appends their completions to the stream in posting
+ * order, which RC guarantees is the order they were sent.
+ *
+ * Page data (any iovec element of RDMA_WRITE_MIN bytes or more: PAGE_REPLY
+ * data, batch and block bulk data) is moved with one-sided RDMA WRITE into
+ * the peer's landing ring, RDMA_LANDING_SIZE registered bytes placed page
+ * by page. The immediate value carries the length; both sides derive the
+ * position with rdma_landing_place(), and the completion takes the data's
+ * place in the stream, so the reader copies it straight from the landing
+ * page into the message. The receiver hands ring space back with empty
+ * SENDs whose immediate value is how far it has read (credits). A sender
+ * short of credit copies its own unread landings to the heap meanwhile, so
+ * two dispatchers writing to each other cannot deadlock.
+ *
+ * Writes land in the ring, not in the requester's DSM page. Under the
+ * userfaultfd engine pages cannot stay registered (invalidation drops
+ * them with MADV_DONTNEED), and under either engine queue pairs only join
+ * workers to the manager, so most replies are forwarded rather than sent
+ * by the owner, and the requester checks a reply (abandoned or
+ * invalidated fetch, stale prefetch) before its data may touch the page.
+ *
+ * Built only with DSM_HAVE_RDMA (make RDMA=1); otherwise
+ * rdma_transport_open() reports the backend unavailable.
+ */
+
+#include "transport.h"
+#include "../core/log.h"
+
+#ifdef DSM_HAVE_RDMA
+
+#include <infiniband/verbs.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** Bytes per SEND and per receive buffer */
+#define RDMA_CHUNK_SIZE (64 * 1024)
+/** Receive buffers kept posted per connection */
+#define RDMA_RECV_SLOTS 64
+/** Sends in flight per connection */
+#define RDMA_SEND_SLOTS 16
+/** Completions reaped per ibv_poll_cq() call */
+#define RDMA_POLL_BATCH 16
+/** Device port connections use */
+#define RDMA_PORT_NUM 1
+/** Longest wait for a send slot or for the rest of a frame */
+#define RDMA_WAIT_MS 10000
+/** Marks send work requests (receives carry their slot number) */
+#define RDMA_WR_SEND (1ULL << 63)
+/** Bytes of the landing ring peers write page data into (multiple of PAGE_SIZE) */
+#define RDMA_LANDING_SIZE (4 * 1024 * 1024)
+/** Smallest iovec element written one-sided instead of sent */
+#define RDMA_WRITE_MIN PAGE_SIZE
+/** Ring space read since the last credit that is worth a credit */
+#define RDMA_CREDIT_BYTES (RDMA_LANDING_SIZE / 4)
+
+/**
+ * What a peer needs to connect to one of our queue pairs
+ */
+typedef struct {
+    uint32_t qpn;              /**< Queue pair number */
+    uint32_t psn;              /**< First packet sequence number we send */
+    uint16_t lid;              /**< Port LID (InfiniBand) */
+    uint8_t mtu;               /**< enum ibv_mtu of our port */
+    uint8_t gid[16];           /**< Port GID (RoCE and routed InfiniBand) */
+    uint64_t landing;          /**< Address of our landing ring */
+    uint32_t landing_rkey;     /**< Remote key of our landing ring */
+} __attribute__((packed)) rdma_conn_info_t;
+
+/**
+ * Page data the peer wrote into our landing ring, in stream order
+ */
+typedef struct {
+    uint64_t stream_pos;       /**< Sent bytes received before it */
+    uint8_t *data;             /**< In the landing ring, or a heap copy once spilled */
+    uint32_t len;
+    uint32_t read;             /**< Bytes already read */
+    uint64_t ring_end;         /**< Landing ring position after it */
+    bool spilled;              /**< data is a heap copy; the ring space is free */
+} rdma_landed_t;
+
+static struct {
+    struct ibv_context *verbs;
+    struct ibv_pd *pd;
+    struct ibv_port_attr port_attr;
+    union ibv_gid gid;
+    int gid_index;
+} g_rdma;
+
+typedef struct {
+    transport_conn_t base;
+    struct ibv_comp_channel *channel;
+    struct ibv_cq *cq;
+    struct ibv_qp *qp;
+    uint8_t *recv_buf;         /**< RDMA_RECV_SLOTS chunks */
+    struct ibv_mr *recv_mr;
+    uint8_t *send_buf;         /**< RDMA_SEND_SLOTS chunks */
+    struct ibv_mr *send_mr;
+    uint8_t *landing;          /**< RDMA_LANDING_SIZE bytes the peer writes into */
+    struct ibv_mr *landing_mr;
+    uint64_t remote_landing;   /**< Peer's landing ring */
+    uint32_t remote_rkey;
+    uint32_t psn;
+
+    pthread_mutex_t cq_lock;   /**< Protects everything below and CQ polling */
+    uint64_t sends_posted;     /**< SENDs, WRITEs and credits */
+    uint64_t sends_done;
+    bool failed;               /**< A work request failed: the connection is unusable */
+    uint8_t *rx;               /**< Received bytes not yet read */
+    size_t rx_start;
+    size_t rx_end;
+    size_t rx_cap;
+    uint64_t rx_in;            /**< Sent bytes received so far */
+    uint64_t rx_out;           /**< Sent bytes read so far */
+    rdma_landed_t *landed;     /**< Landed page data not yet read */
+    size_t landed_start;
+    size_t landed_end;
+    size_t landed_cap;
+
+    uint64_t write_pos;        /**< Our next position in the peer's landing ring */
+    uint64_t peer_freed;       /**< Peer's landing ring is free up to here */
+    uint64_t place_pos;        /**< Next position the peer writes in our landing ring */
+    uint64_t freed;            /**< Our landing ring is read or spilled up to here */
+    uint64_t credited;         /**< freed as last told to the peer */
+    bool credit_due;           /**< A credit should go out as soon as a send slot is free */
+} rdma_conn_t;
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static int post_recv(rdma_conn_t *c, uint64_t slot) {
+    struct ibv_sge sge = {
+        .addr = (uintptr_t)(c->recv_buf + slot * RDMA_CHUNK_SIZE),
+        .length = RDMA_CHUNK_SIZE,
+        .lkey = c->recv_mr->lkey
+    };
+    struct ibv_recv_wr wr, *bad;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = slot;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    return ibv_post_recv(c->qp, &wr, &bad) == 0 ? DSM_SUCCESS : DSM_ERROR_NETWORK;
+}
+
+/**
+ * Append received bytes to the stream (cq_lock held)
+ */
+static int ingest_locked(rdma_conn_t *c, const uint8_t *data, size_t len) {
+    if (c->rx_end + len > c->rx_cap && c->rx_start > 0) {
+        memmove(c->rx, c->rx + c->rx_start, c->rx_end - c->rx_start);
+        c->rx_end -= c->rx_start;
+        c->rx_start = 0;
+    }
+    if (c->rx_end + len > c->rx_cap) {
+        size_t cap = c->rx_cap ? c->rx_cap * 2 : 4 * RDMA_CHUNK_SIZE;
+        while (cap < c->rx_end + len) {
+            cap *= 2;
+        }
+        uint8_t *rx = realloc(c->rx, cap);
+        if (!rx) {
+            LOG_ERROR("Out of memory buffering %zu bytes from node %u", len, c->base.peer);
+            return DSM_ERROR_MEMORY;
+        }
+        c->rx = rx;
+        c->rx_cap = cap;
+    }
+    memcpy(c->rx + c->rx_end, data, len);
+    c->rx_end += len;
+    c->rx_in += len;
+    return DSM_SUCCESS;
+}
+
+/**
+ * Queue page data the peer wrote into our landing ring (cq_lock held)
+ */
+static int land_locked(rdma_conn_t *c, uint32_t len) {
+    if (len == 0 || len > RDMA_CHUNK_SIZE) {
+        LOG_ERROR("RDMA write of %u bytes from node %u", len, c->base.peer);
+        return DSM_ERROR_INVALID;
+    }
+    if (c->landed_end == c->landed_cap && c->landed_start > 0) {
+        memmove(c->landed, c->landed + c->landed_start,
+                (c->landed_end - c->landed_start) * sizeof(*c->landed));
+        c->landed_end -= c->landed_start;
+        c->landed_start = 0;
+    }
+    if (c->landed_end == c->landed_cap) {
+        size_t cap = c->landed_cap ? c->landed_cap * 2 : RDMA_LANDING_SIZE / PAGE_SIZE;
+        rdma_landed_t *landed = realloc(c->landed, cap * sizeof(*landed));
+        if (!landed) {
+            LOG_ERROR("Out of memory tracking RDMA writes from node %u", c->base.peer);
+            return DSM_ERROR_MEMORY;
+        }
+        c->landed = landed;
+        c->landed_cap = cap;
+    }
+
+    size_t off = rdma_landing_place(&c->place_pos, len, RDMA_LANDING_SIZE);
+    rdma_landed_t *l = &c->landed[c->landed_end++];
+    l->stream_pos = c->rx_in;
+    l->data = c->landing + off;
+    l->len = len;
+    l->read = 0;
+    l->ring_end = c->place_pos;
+    l->spilled = false;
+    return DSM_SUCCESS;
+}
+
+/**
+ * Give the peer back our landing ring up to freed (cq_lock held)
+ * Skipped while the send queue is full; poll_locked() tries again.
+ */
+static void post_credit_locked(rdma_conn_t *c) {
+    if (!c->credit_due || c->failed || c->sends_posted - c->sends_done >= RDMA_SEND_SLOTS) {
+        return;
+    }
+    struct ibv_send_wr wr, *bad;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = RDMA_WR_SEND;
+    wr.num_sge = 0;
+    wr.opcode = IBV_WR_SEND_WITH_IMM;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.imm_data = htonl((uint32_t)c->freed);
+    if (ibv_post_send(c->qp, &wr, &bad) != 0) {
+        LOG_ERROR("Posting RDMA credit to node %u failed: %s", c->base.peer, strerror(errno));
+        c->failed = true;
+        return;
+    }
+    c->sends_posted++;
+    c->credited = c->freed;
+    c->credit_due = false;
+}
+
+/**
+ * Mark the landing ring read up to ring_end (cq_lock held)
+ */
+static void free_landing_locked(rdma_conn_t *c, uint64_t ring_end) {
+    c->freed = ring_end;
+    if (c->freed - c->credited >= RDMA_CREDIT_BYTES) {
+        c->credit_due = true;
+    }
+}
+
+/**
+ * Copy every unread landing to the heap and credit the whole ring
+ * (cq_lock held), so a peer writing to us is never stuck behind a reader
+ * that is itself waiting to send
+ */
+static void spill_landed_locked(rdma_conn_t *c) {
+    for (size_t i = c->landed_start; i < c->landed_end; i++) {
+        rdma_landed_t *l = &c->landed[i];
+        if (l->spilled) {
+            continue;
+        }
+        uint8_t *copy = malloc(l->len);
+        if (!copy) {
+            /* The ring stays held; the peer waits for the reader instead */
+            return;
+        }
+        memcpy(copy, l->data, l->len);
+        l->data = copy;
+        l->spilled = true;
+        c->freed = l->ring_end;
+        c->credit_due = true;
+    }
+}
+
+/**
+ * Reap completions: count finished sends, take in received chunks and
+ * post their buffers again (cq_lock held)
+ *
+ * @return Completions reaped
+ */
+static int poll_locked(rdma_conn_t *c) {
+    struct ibv_wc wc[RDMA_POLL_BATCH];
+    int total = 0;
+    int n;
+
+    while ((n = ibv_poll_cq(c->cq, RDMA_POLL_BATCH, wc)) > 0) {
+        for (int i = 0; i < n; i++) {
+            if (wc[i].wr_id & RDMA_WR_SEND) {
+                c->sends_done++;
+            }
+            if (wc[i].status != IBV_WC_SUCCESS) {
+                if (!c->failed) {
+                    LOG_ERROR("RDMA work request to node %u failed: %s",
+                              c->base.peer, ibv_wc_status_str(wc[i].status));
+                }
+                c->failed = true;
+                continue;
+            }
+            if (!(wc[i].wr_id & RDMA_WR_SEND)) {
+                uint64_t slot = wc[i].wr_id;
+                int rc;
+                if (wc[i].opcode == IBV_WC_RECV_RDMA_WITH_IMM) {
+                    rc = land_locked(c, ntohl(wc[i].imm_data));
+                } else if (wc[i].wc_flags & IBV_WC_WITH_IMM) {
+                    /* Credit: the peer's ring is free up to the low 32 bits given */
+                    uint32_t freed = ntohl(wc[i].imm_data);
+                    c->peer_freed += (uint32_t)(freed - (uint32_t)c->peer_freed);
+                    rc = DSM_SUCCESS;
+                } else {
+                    rc = ingest_locked(c, c->recv_buf + slot * RDMA_CHUNK_SIZE, wc[i].byte_len);
+                }
+                if (rc != DSM_SUCCESS || post_recv(c, slot) != DSM_SUCCESS) {
+                    c->failed = true;
+                }
+            }
+        }
+        total += n;
+    }
+    if (n < 0) {
+        LOG_ERROR("Polling RDMA completions of node %u failed", c->base.peer);
+        c->failed = true;
+    }
+    post_credit_locked(c);
+    return total;
+}
+
+/**
+ * Poll once; if nothing completed, let other threads at the CQ
+ *
+ * @return false once the deadline has passed or the connection failed
+ */
+static bool poll_or_yield_locked(rdma_conn_t *c, uint64_t deadline) {
+    if (poll_locked(c) > 0) {
+        return !c->failed;
+    }
+    pthread_mutex_unlock(&c->cq_lock);
+    sched_yield();
+    pthread_mutex_lock(&c->cq_lock);
+    return !c->failed && now_ms() < deadline;
+}
+
+/**
+ * Wait as a sender: spill our landings first so the peer can go on
+ * writing to us while we wait for it (cq_lock held)
+ */
+static bool wait_locked(rdma_conn_t *c, uint64_t deadline) {
+    spill_landed_locked(c);
+    post_credit_locked(c);
+    return poll_or_yield_locked(c, deadline);
+}
+
+/**
+ * Wait until a send slot is free; no unlock between this and the post
+ * that uses it (cq_lock held)
+ */
+static int wait_send_slot_locked(rdma_conn_t *c, uint64_t deadline) {
+    while (c->sends_posted - c->sends_done >= RDMA_SEND_SLOTS) {
+        if (!wait_locked(c, deadline)) {
+            return DSM_ERROR_NETWORK;
+        }
+    }
+    return c->failed ? DSM_ERROR_NETWORK : DSM_SUCCESS;
+}
+
+/**
+ * Post the send slot chunk of used bytes: as a SEND, or as an RDMA WRITE
+ * to offset remote_off of the peer's landing ring (cq_lock held)
+ */
+static int post_chunk_locked(rdma_conn_t *c, uint8_t *chunk, size_t used, bool write,
+                             size_t remote_off) {
+    struct ibv_sge sge = {
+        .addr = (uintptr_t)chunk,
+        .length = (uint32_t)used,
+        .lkey = c->send_mr->lkey
+    };
+    struct ibv_send_wr wr, *bad;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = RDMA_WR_SEND | (c->sends_posted % RDMA_SEND_SLOTS);
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    if (write) {
+        wr.opcode = IBV_WR_RDMA_WRITE_WITH_IMM;
+        wr.imm_data = htonl((uint32_t)used);
+        wr.wr.rdma.remote_addr = c->remote_landing + remote_off;
+        wr.wr.rdma.rkey = c->remote_rkey;
+    } else {
+        wr.opcode = IBV_WR_SEND;
+    }
+    if (ibv_post_send(c->qp, &wr, &bad) != 0) {
+        LOG_ERROR("Posting RDMA %s to node %u failed: %s", write ? "write" : "send",
+                  c->base.peer, strerror(errno));
+        c->failed = true;
+        return DSM_ERROR_NETWORK;
+    }
+    c->sends_posted++;
+    return DSM_SUCCESS;
+}
+
+/**
+ * Write len bytes of page data into the peer's landing ring, in pieces of
+ * at most RDMA_CHUNK_SIZE (cq_lock held)
+ */
+static int write_landing_locked(rdma_conn_t *c, const uint8_t *data, size_t len, uint64_t deadline) {
+    while (len > 0) {
+        size_t n = len < RDMA_CHUNK_SIZE ? len : RDMA_CHUNK_SIZE;
+
+        /* Reserve ring space: the peer credits what it has read */
+        uint64_t pos = c->write_pos;
+        size_t off = rdma_landing_place(&pos, n, RDMA_LANDING_SIZE);
+        while (pos - c->peer_freed > RDMA_LANDING_SIZE) {
+            if (!wait_locked(c, deadline)) {
+                return DSM_ERROR_NETWORK;
+            }
+        }
+        if (wait_send_slot_locked(c, deadline) != DSM_SUCCESS) {
+            return DSM_ERROR_NETWORK;
+        }
+        c->write_pos = pos;
+
+        uint8_t *chunk = c->send_buf + (c->sends_posted % RDMA_SEND_SLOTS) * RDMA_CHUNK_SIZE;
+        memcpy(chunk, data, n);
+        if (post_chunk_locked(c, chunk, n, true, off) != DSM_SUCCESS) {
+            return DSM_ERROR_NETWORK;
+        }
+        data += n;
+        len -= n;
+    }
+    return DSM_SUCCESS;
+}
+
+static int rdma_send_iov(transport_conn_t *conn, const struct iovec *iov, int iovcnt, size_t len) {
+    rdma_conn_t *c = (rdma_conn_t *)conn;
+    uint64_t deadline = now_ms() + RDMA_WAIT_MS;
+    uint8_t *chunk = NULL;
+    size_t used = 0;
+    int rc = DSM_SUCCESS;
+    (void)len;  /* iov is walked to its end */
+
+    pthread_mutex_lock(&c->cq_lock);
+    for (int i = 0; i < iovcnt && rc == DSM_SUCCESS; i++) {
+        const uint8_t *data = iov[i].iov_base;
+        size_t n = iov[i].iov_len;
+
+        if (n >= RDMA_WRITE_MIN) {
+            /* Control bytes before the page data go first */
+            if (chunk) {
+                rc = post_chunk_locked(c, chunk, used, false, 0);
+                chunk = NULL;
+            }
+            if (rc == DSM_SUCCESS) {
+                rc = write_landing_locked(c, data, n, deadline);
+            }
+            continue;
+        }
+
+        while (n > 0 && rc == DSM_SUCCESS) {
+            if (!chunk) {
+                /* A slot is free again once its previous SEND has completed */
+                rc = wait_send_slot_locked(c, deadline);
+                if (rc != DSM_SUCCESS) {
+                    break;
+                }
+                chunk = c->send_buf + (c->sends_posted % RDMA_SEND_SLOTS) * RDMA_CHUNK_SIZE;
+                used = 0;
+            }
+            size_t take = n < RDMA_CHUNK_SIZE - used ? n : RDMA_CHUNK_SIZE - used;
+            memcpy(chunk + used, data, take);
+            used += take;
+            data += take;
+            n -= take;
+            if (used == RDMA_CHUNK_SIZE) {
+                rc = post_chunk_locked(c, chunk, used, false, 0);
+                chunk = NULL;
+            }
+        }
+    }
+    if (rc == DSM_SUCCESS && chunk) {
+        rc = post_chunk_locked(c, chunk, used, false, 0);
+    }
+    pthread_mutex_unlock(&c->cq_lock);
+    return rc;
+}
+
+static int rdma_recv_exact(transport_conn_t *conn, void *buf, size_t len) {
+    rdma_conn_t *c = (rdma_conn_t *)conn;
+    uint64_t deadline = now_ms() + RDMA_WAIT_MS;
+    uint8_t *out = buf;
+
+    pthread_mutex_lock(&c->cq_lock);
+    while (len > 0) {
+        rdma_landed_t *l = c->landed_start < c->landed_end ? &c->landed[c->landed_start] : NULL;
+        size_t n;
+
+        if (l && l->stream_pos == c->rx_out) {
+            /* Page data is read straight from where the peer wrote it */
+            n = l->len - l->read < len ? l->len - l->read : len;
+            memcpy(out, l->data + l->read, n);
+            l->read += (uint32_t)n;
+            if (l->read == l->len) {
+                if (l->spilled) {
+                    free(l->data);
+                } else {
+                    free_landing_locked(c, l->ring_end);
+                    post_credit_locked(c);
+                }
+                if (++c->landed_start == c->landed_end) {
+                    c->landed_start = c->landed_end = 0;
+                }
+            }
+        } else {
+            n = c->rx_end - c->rx_start;
+            if (l && n > l->stream_pos - c->rx_out) {
+                n = l->stream_pos - c->rx_out;
+            }
+            if (n > len) {
+                n = len;
+            }
+            if (n == 0) {
+                if (!poll_or_yield_locked(c, deadline)) {
+                    pthread_mutex_unlock(&c->cq_lock);
+                    return DSM_ERROR_NETWORK;
+                }
+                continue;
+            }
+            memcpy(out, c->rx + c->rx_start, n);
+            c->rx_start += n;
+            c->rx_out += n;
+            if (c->rx_start == c->rx_end) {
+                c->rx_start = c->rx_end = 0;
+            }
+        }
+        out += n;
+        len -= n;
+    }
+    pthread_mutex_unlock(&c->cq_lock);
+    return DSM_SUCCESS;
+}
+
+static bool rdma_readable(transport_conn_t *conn) {
+    rdma_conn_t *c = (rdma_conn_t *)conn;
+
+    pthread_mutex_lock(&c->cq_lock);
+    poll_locked(c);
+    bool readable = c->rx_end > c->rx_start || c->landed_end > c->landed_start;
+    pthread_mutex_unlock(&c->cq_lock);
+    return readable;
+}
+
+static int rdma_event_fd(transport_conn_t *conn) {
+    return ((rdma_conn_t *)conn)->channel->fd;
+}
+
+static void rdma_handle_event(transport_conn_t *conn) {
+    rdma_conn_t *c = (rdma_conn_t *)conn;
+    struct ibv_cq *cq;
+    void *cq_ctx;
+    unsigned int events = 0;
+
+    while (ibv_get_cq_event(c->channel, &cq, &cq_ctx) == 0) {
+        events++;
+    }
+    if (events > 0) {
+        ibv_ack_cq_events(c->cq, events);
+    }
+
+    /* Re-arm first, then poll, so no completion slips in between */
+    ibv_req_notify_cq(c->cq, 0);
+    pthread_mutex_lock(&c->cq_lock);
+    poll_locked(c);
+    pthread_mutex_unlock(&c->cq_lock);
+}
+
+static void rdma_destroy(transport_conn_t *conn) {
+    rdma_conn_t *c = (rdma_conn_t *)conn;
+
+    if (c->qp) ibv_destroy_qp(c->qp);
+    if (c->recv_mr) ibv_dereg_mr(c->recv_mr);
+    if (c->send_mr) ibv_dereg_mr(c->send_mr);
+    if (c->landing_mr) ibv_dereg_mr(c->landing_mr);
+    if (c->cq) ibv_destroy_cq(c->cq);
+    if (c->channel) ibv_destroy_comp_channel(c->channel);
+    free(c->recv_buf);
+    free(c->send_buf);
+    free(c->landing);
+    for (size_t i = c->landed_start; i < c->landed_end; i++) {
+        if (c->landed[i].spilled) {
+            free(c->landed[i].data);
+        }
+    }
+    free(c->landed);
+    free(c->rx);
+    pthread_mutex_destroy(&c->cq_lock);
+    free(c);
+}
+
+static transport_conn_t *rdma_create(node_id_t peer) {
+    rdma_conn_t *c = calloc(1, sizeof(*c));
+    if (!c) {
+        return NULL;
+    }
+    pthread_mutex_init(&c->cq_lock, NULL);
+
+    c->channel = ibv_create_comp_channel(g_rdma.verbs);
+    if (c->channel) {
+        int flags = fcntl(c->channel->fd, F_GETFL);
+        fcntl(c->channel->fd, F_SETFL, flags | O_NONBLOCK);
+        c->cq = ibv_create_cq(g_rdma.verbs, RDMA_RECV_SLOTS + RDMA_SEND_SLOTS, NULL, c->channel, 0);
+    }
+    if (posix_memalign((void **)&c->recv_buf, PAGE_SIZE, (size_t)RDMA_RECV_SLOTS * RDMA_CHUNK_SIZE) != 0) {
+        c->recv_buf = NULL;
+    }
+    if (posix_memalign((void **)&c->send_buf, PAGE_SIZE, (size_t)RDMA_SEND_SLOTS * RDMA_CHUNK_SIZE) != 0) {
+        c->send_buf = NULL;
+    }
+    if (posix_memalign((void **)&c->landing, PAGE_SIZE, RDMA_LANDING_SIZE) != 0) {
+        c->landing = NULL;
+    }
+    if (!c->cq || !c->recv_buf || !c->send_buf || !c->landing) {
+        LOG_ERROR("Failed to set up RDMA completion queue or buffers for node %u", peer);
+        rdma_destroy(&c->base);
+        return NULL;
+    }
+
+    c->recv_mr = ibv_reg_mr(g_rdma.pd, c->recv_buf, (size_t)RDMA_RECV_SLOTS * RDMA_CHUNK_SIZE,
+                            IBV_ACCESS_LOCAL_WRITE);
+    c->send_mr = ibv_reg_mr(g_rdma.pd, c->send_buf, (size_t)RDMA_SEND_SLOTS * RDMA_CHUNK_SIZE, 0);
+    c->landing_mr = ibv_reg_mr(g_rdma.pd, c->landing, RDMA_LANDING_SIZE,
+                               IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE);
+
+    struct ibv_qp_init_attr init;
+    memset(&init, 0, sizeof(init));
+    init.send_cq = c->cq;
+    init.recv_cq = c->cq;
+    init.qp_type = IBV_QPT_RC;
+    init.cap.max_send_wr = RDMA_SEND_SLOTS;
+    init.cap.max_recv_wr = RDMA_RECV_SLOTS;
+    init.cap.max_send_sge = 1;
+    init.cap.max_recv_sge = 1;
+    if (c->recv_mr && c->send_mr && c->landing_mr) {
+        c->qp = ibv_create_qp(g_rdma.pd, &init);
+    }
+    if (!c->qp) {
+        LOG_ERROR("Failed to create RDMA queue pair for node %u: %s", peer, strerror(errno));
+        rdma_destroy(&c->base);
+        return NULL;
+    }
+
+    struct ibv_qp_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.qp_state = IBV_QPS_INIT;
+    attr.pkey_index = 0;
+    attr.port_num = RDMA_PORT_NUM;
+    attr.qp_access_flags = IBV_ACCESS_REMOTE_WRITE;
+    if (ibv_modify_qp(c->qp, &attr, IBV_QP_STATE | IBV_QP_PKEY_INDEX |
+                                    IBV_QP_PORT | IBV_QP_ACCESS_FLAGS) != 0) {
+        LOG_ERROR("Failed to move RDMA queue pair for node %u to INIT: %s", peer, strerror(errno));
+        rdma_destroy(&c->base);
+        return NULL;
+    }
+
+    /* Receives may be posted before the connection is up */
+    for (uint64_t slot = 0; slot < RDMA_RECV_SLOTS; slot++) {
+        if (post_recv(c, slot) != DSM_SUCCESS) {
+            LOG_ERROR("Failed to post RDMA receive buffers for node %u", peer);
+            rdma_destroy(&c->base);
+            return NULL;
+        }
+    }
+    ibv_req_notify_cq(c->cq, 0);
+
+    c->psn = (uint32_t)lrand48() & 0xFFFFFF;
+    return &c->base;
+}
+
+static size_t rdma_local_info(transport_conn_t *conn, uint8_t *buf, size_t cap) {
+    rdma_conn_t *c = (rdma_conn_t *)conn;
+    if (cap < sizeof(rdma_conn_info_t)) {
+        return 0;
+    }
+
+    rdma_conn_info_t info;
+    memset(&info, 0, sizeof(info));
+    info.qpn = c->qp->qp_num;
+    info.psn = c->psn;
+    info.lid = g_rdma.port_attr.lid;
+    info.mtu = (uint8_t)g_rdma.port_attr.active_mtu;
+    memcpy(info.gid, g_rdma.gid.raw, sizeof(info.gid));
+    info.landing = (uintptr_t)c->landing;
+    info.landing_rkey = c->landing_mr->rkey;
+    memcpy(buf, &info, sizeof(info));
+    return sizeof(info);
+}
+
+static int rdma_connect(transport_conn_t *conn, const uint8_t *buf, size_t len) {
+    rdma_conn_t *c = (rdma_conn_t *)conn;
+    if (len < sizeof(rdma_conn_info_t)) {
+        LOG_ERROR("Short RDMA connection info from node %u (%zu bytes)", conn->peer, len);
+        return DSM_ERROR_INVALID;
+    }
+
+    rdma_conn_info_t remote;
+    memcpy(&remote, buf, sizeof(remote));
+    c->remote_landing = remote.landing;
+    c->remote_rkey = remote.landing_rkey;
+
+    static const uint8_t no_gid[16];
+    struct ibv_qp_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.qp_state = IBV_QPS_RTR;
+    attr.path_mtu = remote.mtu < g_rdma.port_attr.active_mtu ? (enum ibv_mtu)remote.mtu
+                                                              : g_rdma.port_attr.active_mtu;
+    attr.dest_qp_num = remote.qpn;
+    attr.rq_psn = remote.psn;
+    attr.max_dest_rd_atomic = 1;
+    attr.min_rnr_timer = 12;
+    attr.ah_attr.dlid = remote.lid;
+    attr.ah_attr.port_num = RDMA_PORT_NUM;
+    if (memcmp(remote.gid, no_gid, sizeof(no_gid)) != 0) {
+        /* RoCE has no LIDs: route by GID */
+        attr.ah_attr.is_global = 1;
+        memcpy(attr.ah_attr.grh.dgid.raw, remote.gid, sizeof(remote.gid));
+        attr.ah_attr.grh.sgid_index = (uint8_t)g_rdma.gid_index;
+        attr.ah_attr.grh.hop_limit = 64;
+    }
+    if (ibv_modify_qp(c->qp, &attr, IBV_QP_STATE | IBV_QP_AV | IBV_QP_PATH_MTU |
+                                    IBV_QP_DEST_QPN | IBV_QP_RQ_PSN |
+                                    IBV_QP_MAX_DEST_RD_ATOMIC | IBV_QP_MIN_RNR_TIMER) != 0) {
+        LOG_ERROR("Failed to move RDMA queue pair for node %u to RTR: %s", conn->peer, strerror(errno));
+        return DSM_ERROR_NETWORK;
+    }
+
+    /* Retry forever on receiver-not-ready: a slow reader is not a failure */
+    memset(&attr, 0, sizeof(attr));
+    attr.qp_state = IBV_QPS_RTS;
+    attr.timeout = 14;
+    attr.retry_cnt = 7;
+    attr.rnr_retry = 7;
+    attr.sq_psn = c->psn;
+    attr.max_rd_atomic = 1;
+    if (ibv_modify_qp(c->qp, &attr, IBV_QP_STATE | IBV_QP_TIMEOUT | IBV_QP_RETRY_CNT |
+                                    IBV_QP_RNR_RETRY | IBV_QP_SQ_PSN |
+                                    IBV_QP_MAX_QP_RD_ATOMIC) != 0) {
+        LOG_ERROR("Failed to move RDMA queue pair for node %u to RTS: %s", conn->peer, strerror(errno));
+        return DSM_ERROR_NETWORK;
+    }
+
+    LOG_INFO("RDMA queue pair %u connected to node %u (remote qpn %u)",
+             c->qp->qp_num, conn->peer, remote.qpn);
+    return DSM_SUCCESS;
+}
+
+static void rdma_close(void) {
+    if (g_rdma.pd) ibv_dealloc_pd(g_rdma.pd);
+    if (g_rdma.verbs) ibv_close_device(g_rdma.verbs);
+    memset(&g_rdma, 0, sizeof(g_rdma));
+}
+
+static const transport_ops_t rdma_ops = {
+    .name = "rdma",
+    .create = rdma_create,
+    .local_info = rdma_local_info,
+    .connect = rdma_connect,
+    .event_fd = rdma_event_fd,
+    .handle_event = rdma_handle_event,
+    .send_iov = rdma_send_iov,
+    .recv_exact = rdma_recv_exact,
+    .readable = rdma_readable,
+    .destroy = rdma_destroy,
+    .close = rdma_close
+};
+
+const transport_ops_t *rdma_transport_open(void) {
+    int num_devices = 0;
+    struct ibv_device **devices = ibv_get_device_list(&num_devices);
+    if (!devices) {
+        LOG_WARN("No RDMA devices: %s", strerror(errno));
+        return NULL;
+    }
+
+    /* First device whose port is up */
+    for (int i = 0; i < num_devices && !g_rdma.verbs; i++) {
+        struct ibv_context *verbs = ibv_open_device(devices[i]);
+        if (!verbs) {
+            continue;
+        }
+        struct ibv_port_attr port_attr;
+        if (ibv_query_port(verbs, RDMA_PORT_NUM, &port_attr) != 0 ||
+            port_attr.state != IBV_PORT_ACTIVE) {
+            ibv_close_device(verbs);
+            continue;
+        }
+        g_rdma.verbs = verbs;
+        g_rdma.port_attr = port_attr;
+        LOG_INFO("Using RDMA device %s port %d", ibv_get_device_name(devices[i]), RDMA_PORT_NUM);
+    }
+    ibv_free_device_list(devices);
+
+    if (!g_rdma.verbs) {
+        LOG_WARN("No active RDMA device port found");
+        return NULL;
+    }
+
+    g_rdma.gid_index = 0;
+    if (ibv_query_gid(g_rdma.verbs, RDMA_PORT_NUM, g_rdma.gid_index, &g_rdma.gid) != 0) {
+        memset(&g_rdma.gid, 0, sizeof(g_rdma.gid));
+    }
+    if (g_rdma.port_attr.link_layer != IBV_LINK_LAYER_ETHERNET) {
+        /* InfiniBand within one subnet routes by LID */
+        memset(&g_rdma.gid, 0, sizeof(g_rdma.gid));
+    }
+
+    g_rdma.pd = ibv_alloc_pd(g_rdma.verbs);
+    if (!g_rdma.pd) {
+        LOG_WARN("Failed to allocate RDMA protection domain");
+        rdma_close();
+        return NULL;
+    }
+    return &rdma_ops;
+}
+
+#else /* !DSM_HAVE_RDMA */
+
+const transport_ops_t *rdma_transport_open(void) {
+    LOG_WARN("Built without RDMA support (rebuild with make RDMA=1)");
+    return NULL;
+}
+
+#endif /* DSM_HAVE_RDMA */
+
+size_t rdma_landing_place(uint64_t *pos, size_t len, size_t ring_size) {
+    size_t off = (size_t)(*pos % ring_size);
+    if (off + len > ring_size) {
+        /* Never wrap inside a write: skip the ring's tail */
+        *pos += ring_size - off;
+        off = 0;
+    }
+    *pos += (len + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+    return off;
+}
@@ -0,0 +1,531 @@
+/**
+ * @file replication.c
+ * @brief Hot-backup replication log implementation
+ */
+
+#include "replication.h"
+#include "network.h"
+#include "handlers.h"
+#include "../core/log.h"
+#include "../core/dsm_context.h"
+#include "../core/stats.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** Node the log is shipped to */
+#define REPLICATION_BACKUP_NODE 1
+
+static struct {
+    pthread_mutex_t lock;        /**< Protects everything below */
+    pthread_cond_t cv;           /**< Wakes the shipper and commit waiters */
+    dsm_replication_t mode;
+    uint8_t *buf;                /**< Records appended since the last batch */
+    size_t len;
+    size_t cap;
+    uint32_t num_records;
+    uint8_t *spare;              /**< Buffer of the last batch, reused for the next */
+    size_t spare_cap;
+    uint64_t appended_seq;       /**< sync_seq of the last record appended */
+    uint64_t shipped_seq;        /**< sync_seq of the last record shipped or dropped */
+    bool shipping;               /**< A thread is writing a batch */
+    bool running;                /**< Shipper thread started and not told to stop */
+    pthread_t thread;
+} g_repl = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cv = PTHREAD_COND_INITIALIZER
+};
+
+/* Backup side: records received but not yet in the shadow tables */
+static struct {
+    pthread_mutex_t lock;        /**< Protects everything below */
+    uint8_t *buf;                /**< Records in arrival (sync_seq) order */
+    size_t len;
+    size_t cap;
+    uint32_t num_records;
+    struct timespec last_snapshot; /**< CLOCK_MONOTONIC time of the last snapshot */
+} g_replica = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static bool is_sync_record_type(uint8_t type) {
+    return type == MSG_STATE_SYNC_DIR || type == MSG_STATE_SYNC_LOCK ||
+           type == MSG_STATE_SYNC_BARRIER;
+}
+
+/**
+ * Next sync sequence number
+ * Drawn from the message sequence counter, as single STATE_SYNC_* were.
+ */
+static uint64_t next_sync_seq(void) {
+    dsm_context_t *ctx = dsm_get_context();
+    pthread_mutex_lock(&ctx->network.seq_lock);
+    uint64_t seq = ctx->network.next_seq_num++;
+    pthread_mutex_unlock(&ctx->network.seq_lock);
+    return seq;
+}
+
+/**
+ * Write a batch of records to the backup in frames of at most
+ * MSG_MAX_BULK_DATA bytes
+ * Records are dropped when the backup is gone, as single messages were.
+ */
+static int send_batch(const uint8_t *batch, size_t len, uint32_t num_records) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    if (ctx->network.max_nodes <= REPLICATION_BACKUP_NODE ||
+        !ctx->network.nodes[REPLICATION_BACKUP_NODE].connected) {
+        LOG_DEBUG("Backup gone, dropping %u replication records", num_records);
+        return DSM_SUCCESS;
+    }
+
+    size_t off = 0;
+    while (off < len) {
+        size_t start = off;
+        uint32_t count = 0;
+        uint64_t last_seq = 0;
+
+        /* Records never straddle frames */
+        while (off < len) {
+            state_sync_record_t rec;
+            memcpy(&rec, batch + off, sizeof(rec));
+            size_t size = sizeof(rec) + rec.len;
+            if (count > 0 && off + size - start > MSG_MAX_BULK_DATA) {
+                break;
+            }
+            /* Every STATE_SYNC_* payload starts with its sync_seq */
+            memcpy(&last_seq, batch + off + sizeof(rec), sizeof(last_seq));
+            off += size;
+            count++;
+        }
+
+        message_t msg;
+        memset(&msg.header, 0, sizeof(msg.header));
+        msg.header.magic = MSG_MAGIC;
+        msg.header.type = MSG_STATE_SYNC_BATCH;
+        msg.header.sender = ctx->node_id;
+        msg.payload.state_sync_batch.last_seq = last_seq;
+        msg.payload.state_sync_batch.num_records = count;
+
+        struct iovec data = { .iov_base = (void*)(batch + start), .iov_len = off - start };
+        int rc = network_send_bulk(REPLICATION_BACKUP_NODE, &msg, &data, 1);
+        if (rc != DSM_SUCCESS) {
+            LOG_WARN("Failed to ship %u replication records to backup (rc=%d)", count, rc);
+            return rc;
+        }
+        STATS_ADD(network_bytes_sent, 4 + sizeof(msg_header_t) +
+                  sizeof(state_sync_batch_payload_t) + (off - start));
+    }
+
+    LOG_DEBUG("Shipped %u replication records (%zu bytes) to backup", num_records, len);
+    return DSM_SUCCESS;
+}
+
+/**
+ * Ship the log until everything up to target has gone out
+ * Called and returns with g_repl.lock held. Whoever finds records pending
+ * and no batch in flight takes all of them; the rest wait for it.
+ */
+static int ship_locked(uint64_t target) {
+    int rc = DSM_SUCCESS;
+
+    while (g_repl.shipped_seq < target) {
+        if (g_repl.shipping) {
+            pthread_cond_wait(&g_repl.cv, &g_repl.lock);
+            continue;
+        }
+
+        uint8_t *batch = g_repl.buf;
+        size_t batch_cap = g_repl.cap;
+        size_t len = g_repl.len;
+        uint32_t num_records = g_repl.num_records;
+        uint64_t last = g_repl.appended_seq;
+
+        /* Appends go to the spare buffer while this batch is written */
+        g_repl.buf = g_repl.spare;
+        g_repl.cap = g_repl.spare_cap;
+        g_repl.len = 0;
+        g_repl.num_records = 0;
+        g_repl.spare = NULL;
+        g_repl.spare_cap = 0;
+        g_repl.shipping = true;
+        pthread_mutex_unlock(&g_repl.lock);
+
+        rc = send_batch(batch, len, num_records);
+
+        pthread_mutex_lock(&g_repl.lock);
+        g_repl.spare = batch;
+        g_repl.spare_cap = batch_cap;
+        g_repl.shipping = false;
+        __atomic_store_n(&g_repl.shipped_seq, last, __ATOMIC_RELEASE);
+        pthread_cond_broadcast(&g_repl.cv);
+    }
+
+    return rc;
+}
+
+static void *shipper_thread(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&g_repl.lock);
+    while (g_repl.running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += REPLICATION_FLUSH_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        while (g_repl.running && g_repl.len < REPLICATION_BATCH_BYTES) {
+            if (pthread_cond_timedwait(&g_repl.cv, &g_repl.lock, &deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
+
+        if (g_repl.len > 0 && !g_repl.shipping) {
+            ship_locked(g_repl.appended_seq);
+        }
+    }
+    pthread_mutex_unlock(&g_repl.lock);
+
+    return NULL;
+}
+
+int replication_start(dsm_replication_t mode) {
+    pthread_mutex_lock(&g_repl.lock);
+    if (g_repl.running) {
+        pthread_mutex_unlock(&g_repl.lock);
+        return DSM_SUCCESS;
+    }
+    __atomic_store_n(&g_repl.mode, mode, __ATOMIC_RELAXED);
+    g_repl.running = true;
+    if (pthread_create(&g_repl.thread, NULL, shipper_thread, NULL) != 0) {
+        g_repl.running = false;
+        pthread_mutex_unlock(&g_repl.lock);
+        LOG_ERROR("Failed to start replication shipper thread");
+        return DSM_ERROR_INIT;
+    }
+    pthread_mutex_unlock(&g_repl.lock);
+
+    LOG_INFO("Replication log started (%s)",
+             mode == DSM_REPLICATION_ASYNC ? "async" : "before reply");
+    return DSM_SUCCESS;
+}
+
+void replication_stop(void) {
+    pthread_mutex_lock(&g_repl.lock);
+    bool was_running = g_repl.running;
+    g_repl.running = false;
+    pthread_cond_broadcast(&g_repl.cv);
+    pthread_mutex_unlock(&g_repl.lock);
+
+    if (was_running) {
+        pthread_join(g_repl.thread, NULL);
+    }
+
+    pthread_mutex_lock(&g_repl.lock);
+    ship_locked(g_repl.appended_seq);
+    free(g_repl.buf);
+    free(g_repl.spare);
+    g_repl.buf = NULL;
+    g_repl.spare = NULL;
+    g_repl.cap = 0;
+    g_repl.spare_cap = 0;
+    __atomic_store_n(&g_repl.mode, DSM_REPLICATION_BEFORE_REPLY, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&g_repl.lock);
+
+    pthread_mutex_lock(&g_replica.lock);
+    free(g_replica.buf);
+    g_replica.buf = NULL;
+    g_replica.len = 0;
+    g_replica.cap = 0;
+    g_replica.num_records = 0;
+    pthread_mutex_unlock(&g_replica.lock);
+}
+
+int replication_append(message_t *msg) {
+    if (!msg || !is_sync_record_type(msg->header.type)) {
+        return DSM_ERROR_INVALID;
+    }
+
+    size_t len = message_wire_payload_size(msg);
+    if (len == (size_t)-1 || len > sizeof(msg->payload)) {
+        return DSM_ERROR_INVALID;
+    }
+
+    pthread_mutex_lock(&g_repl.lock);
+
+    size_t need = g_repl.len + sizeof(state_sync_record_t) + len;
+    if (need > g_repl.cap) {
+        size_t cap = g_repl.cap ? g_repl.cap : 4096;
+        while (cap < need) {
+            cap *= 2;
+        }
+        uint8_t *buf = realloc(g_repl.buf, cap);
+        if (!buf) {
+            pthread_mutex_unlock(&g_repl.lock);
+            LOG_ERROR("Out of memory growing the replication log to %zu bytes", cap);
+            return DSM_ERROR_MEMORY;
+        }
+        g_repl.buf = buf;
+        g_repl.cap = cap;
+    }
+
+    /* Sequence numbers are taken under the log lock so the backup never
+     * sees a record after one with a higher sync_seq */
+    uint64_t seq = next_sync_seq();
+    switch (msg->header.type) {
+        case MSG_STATE_SYNC_DIR:  msg->payload.state_sync_dir.sync_seq = seq; break;
+        case MSG_STATE_SYNC_LOCK: msg->payload.state_sync_lock.sync_seq = seq; break;
+        default:                  msg->payload.state_sync_barrier.sync_seq = seq; break;
+    }
+
+    state_sync_record_t rec = { .type = (uint8_t)msg->header.type, .len = (uint32_t)len };
+    memcpy(g_repl.buf + g_repl.len, &rec, sizeof(rec));
+    memcpy(g_repl.buf + g_repl.len + sizeof(rec), &msg->payload, len);
+    g_repl.len = need;
+    g_repl.num_records++;
+    __atomic_store_n(&g_repl.appended_seq, seq, __ATOMIC_RELEASE);
+
+    bool running = g_repl.running;
+    if (running && g_repl.len >= REPLICATION_BATCH_BYTES) {
+        pthread_cond_broadcast(&g_repl.cv);
+    }
+
+    pthread_mutex_unlock(&g_repl.lock);
+
+    /* Without a shipper (before dsm_init() finishes, or in tests) every
+     * record goes out at once */
+    return running ? DSM_SUCCESS : replication_flush();
+}
+
+void replication_commit(void) {
+    if (__atomic_load_n(&g_repl.mode, __ATOMIC_RELAXED) != DSM_REPLICATION_BEFORE_REPLY) {
+        return;
+    }
+
+    /* Fast path: nothing appended since the last batch */
+    uint64_t target = __atomic_load_n(&g_repl.appended_seq, __ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&g_repl.shipped_seq, __ATOMIC_ACQUIRE) >= target) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_repl.lock);
+    ship_locked(target);
+    pthread_mutex_unlock(&g_repl.lock);
+}
+
+int replication_flush(void) {
+    pthread_mutex_lock(&g_repl.lock);
+    int rc = ship_locked(g_repl.appended_seq);
+    pthread_mutex_unlock(&g_repl.lock);
+    return rc;
+}
+
+/**
+ * Decode the record at data + *off into msg and step past it
+ * @return DSM_SUCCESS, or DSM_ERROR_INVALID if the record is malformed
+ */
+static int decode_record(const uint8_t *data, size_t data_len, size_t *off,
+                         node_id_t sender, message_t *msg) {
+    state_sync_record_t rec;
+    if (data_len - *off < sizeof(rec)) {
+        return DSM_ERROR_INVALID;
+    }
+    memcpy(&rec, data + *off, sizeof(rec));
+
+    size_t body = *off + sizeof(rec);
+    if (!is_sync_record_type(rec.type) || rec.len > data_len - body ||
+        rec.len > sizeof(msg->payload)) {
+        return DSM_ERROR_INVALID;
+    }
+
+    memset(&msg->header, 0, sizeof(msg->header));
+    msg->header.magic = MSG_MAGIC;
+    msg->header.type = rec.type;
+    msg->header.sender = sender;
+    memcpy(&msg->payload, data + body, rec.len);
+
+    /* Node lists must be complete, as for single messages */
+    if (rec.len < message_wire_payload_size(msg)) {
+        return DSM_ERROR_INVALID;
+    }
+
+    *off = body + rec.len;
+    return DSM_SUCCESS;
+}
+
+static void apply_record(const message_t *msg) {
+    switch (msg->header.type) {
+        case MSG_STATE_SYNC_DIR:  handle_state_sync_dir(msg); break;
+        case MSG_STATE_SYNC_LOCK: handle_state_sync_lock(msg); break;
+        default:                  handle_state_sync_barrier(msg); break;
+    }
+}
+
+/** Entry a record replaces: every STATE_SYNC_* payload is sync_seq, then its ID */
+typedef struct {
+    uint64_t id;
+    uint8_t type;                /**< 0 = empty slot */
+} record_key_t;
+
+static record_key_t record_key(const uint8_t *record) {
+    state_sync_record_t rec;
+    memcpy(&rec, record, sizeof(rec));
+    record_key_t key = { .type = rec.type };
+    memcpy(&key.id, record + sizeof(rec) + sizeof(uint64_t), sizeof(key.id));
+    return key;
+}
+
+/**
+ * Mark the last record of each entry in the backup's log
+ * @return false if out of memory (every record is then applied)
+ */
+static bool mark_live_records(const size_t *offs, uint32_t n, bool *live) {
+    size_t cap = 16;
+    while (cap < (size_t)n * 2) {
+        cap *= 2;
+    }
+    record_key_t *seen = calloc(cap, sizeof(*seen));
+    if (!seen) {
+        return false;
+    }
+
+    for (uint32_t i = n; i-- > 0; ) {
+        record_key_t key = record_key(g_replica.buf + offs[i]);
+        size_t h = (size_t)((key.id * 0x9E3779B97F4A7C15ULL) ^ key.type) & (cap - 1);
+        while (seen[h].type != 0 && (seen[h].type != key.type || seen[h].id != key.id)) {
+            h = (h + 1) & (cap - 1);
+        }
+        if (seen[h].type == 0) {
+            seen[h] = key;
+            live[i] = true;
+        }
+    }
+
+    free(seen);
+    return true;
+}
+
+/**
+ * Apply the backup's log to the shadow tables and empty it
+ * Called with g_replica.lock held.
+ */
+static int snapshot_locked(void) {
+    uint32_t n = g_replica.num_records;
+    if (n == 0) {
+        return 0;
+    }
+
+    size_t *offs = malloc(n * sizeof(*offs));
+    bool *live = calloc(n, sizeof(*live));
+    size_t off = 0;
+    for (uint32_t i = 0; i < n && offs; i++) {
+        state_sync_record_t rec;
+        offs[i] = off;
+        memcpy(&rec, g_replica.buf + off, sizeof(rec));
+        off += sizeof(rec) + rec.len;
+    }
+
+    /* Log order is sync_seq order, so the last record of an entry is its
+     * current state and the others can be skipped */
+    bool compact = offs && live && mark_live_records(offs, n, live);
+
+    int applied = 0;
+    message_t msg;
+    off = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        size_t at = off;
+        if (decode_record(g_replica.buf, g_replica.len, &off, 0 /* manager */, &msg) != DSM_SUCCESS) {
+            LOG_ERROR("Backup replication log corrupt at byte %zu", at);
+            break;
+        }
+        if (!compact || live[i]) {
+            apply_record(&msg);
+            applied++;
+        }
+    }
+
+    free(offs);
+    free(live);
+
+    LOG_DEBUG("Replication snapshot: applied %d of %u records", applied, n);
+    g_replica.len = 0;
+    g_replica.num_records = 0;
+    clock_gettime(CLOCK_MONOTONIC, &g_replica.last_snapshot);
+    return applied;
+}
+
+int replication_snapshot(void) {
+    pthread_mutex_lock(&g_replica.lock);
+    int applied = snapshot_locked();
+    pthread_mutex_unlock(&g_replica.lock);
+    return applied;
+}
+
+int handle_state_sync_batch(const message_t *msg, const uint8_t *data, size_t data_len) {
+    uint32_t num_records = msg->payload.state_sync_batch.num_records;
+    message_t rec_msg;
+
+    /* Check the whole batch first so the log only ever holds valid records */
+    size_t off = 0;
+    for (uint32_t i = 0; i < num_records; i++) {
+        if (decode_record(data, data_len, &off, msg->header.sender, &rec_msg) != DSM_SUCCESS) {
+            LOG_ERROR("Malformed record %u of STATE_SYNC_BATCH from node %u",
+                      i, msg->header.sender);
+            return DSM_ERROR_INVALID;
+        }
+    }
+    if (off != data_len) {
+        LOG_ERROR("STATE_SYNC_BATCH from node %u has %zu bytes for %u records",
+                  msg->header.sender, data_len, num_records);
+        return DSM_ERROR_INVALID;
+    }
+    if (num_records == 0) {
+        return DSM_SUCCESS;
+    }
+
+    pthread_mutex_lock(&g_replica.lock);
+
+    size_t need = g_replica.len + data_len;
+    if (need > g_replica.cap) {
+        size_t cap = g_replica.cap ? g_replica.cap : 4096;
+        while (cap < need) {
+            cap *= 2;
+        }
+        uint8_t *buf = realloc(g_replica.buf, cap);
+        if (!buf) {
+            /* Keep the shadow tables current rather than drop the batch */
+            snapshot_locked();
+            pthread_mutex_unlock(&g_replica.lock);
+            LOG_WARN("Out of memory for the backup replication log, applying batch directly");
+            off = 0;
+            for (uint32_t i = 0; i < num_records; i++) {
+                decode_record(data, data_len, &off, msg->header.sender, &rec_msg);
+                apply_record(&rec_msg);
+            }
+            return DSM_SUCCESS;
+        }
+        g_replica.buf = buf;
+        g_replica.cap = cap;
+    }
+    memcpy(g_replica.buf + g_replica.len, data, data_len);
+    g_replica.len = need;
+    g_replica.num_records += num_records;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (g_replica.last_snapshot.tv_sec == 0) {
+        g_replica.last_snapshot = now;
+    }
+    long elapsed_ms = (now.tv_sec - g_replica.last_snapshot.tv_sec) * 1000 +
+                      (now.tv_nsec - g_replica.last_snapshot.tv_nsec) / 1000000;
+    if (g_replica.len >= REPLICATION_SNAPSHOT_BYTES || elapsed_ms >= REPLICATION_SNAPSHOT_MS) {
+        snapshot_locked();
+    }
+
+    pthread_mutex_unlock(&g_replica.lock);
+    return DSM_SUCCESS;
+}
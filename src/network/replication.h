@@ -0,0 +1,106 @@
+/**
+ * @file replication.h
+ * @brief Hot-backup replication log
+ *
+ * The manager records each directory, lock and barrier change as a
+ * STATE_SYNC_* record appended to an in-memory log, instead of sending
+ * the primary backup (node 1) one message per change. The log is shipped
+ * to node 1 in STATE_SYNC_BATCH frames, in append order:
+ *
+ *   - by the shipper thread every REPLICATION_FLUSH_MS, or as soon as
+ *     REPLICATION_BATCH_BYTES are pending
+ *   - by replication_commit(), which with DSM_REPLICATION_BEFORE_REPLY
+ *     runs before every other frame the manager sends: no node can see
+ *     the effect of a change (a grant, a reply, an invalidation) before
+ *     the backup has been sent the change
+ *
+ * Commits are grouped: the first caller to find records pending ships
+ * all of them in one batch while later callers wait for that batch, so a
+ * burst of handlers replying at once costs one write to node 1.
+ *
+ * Records keep their sync_seq; the backup drops any it has already
+ * applied, as it does for single STATE_SYNC_* messages.
+ *
+ * The backup does not apply batches one record at a time. It appends them
+ * to its own copy of the log and folds that into the shadow directory,
+ * lock and barrier tables (the snapshot) every REPLICATION_SNAPSHOT_MS or
+ * REPLICATION_SNAPSHOT_BYTES. Each record carries the whole state of one
+ * entry, so a snapshot applies only the last record of each entry.
+ * Promotion replays the log tail left since the last snapshot, which is
+ * bounded by REPLICATION_SNAPSHOT_BYTES.
+ */
+
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include "protocol.h"
+
+/** Longest a record waits in the log for the shipper thread */
+#define REPLICATION_FLUSH_MS 2
+
+/** Pending log bytes that wake the shipper thread early */
+#define REPLICATION_BATCH_BYTES (64 * 1024)
+
+/** Backup log bytes that trigger a snapshot (the most promotion replays) */
+#define REPLICATION_SNAPSHOT_BYTES (256 * 1024)
+
+/** Longest the backup's shadow tables trail a busy log */
+#define REPLICATION_SNAPSHOT_MS 100
+
+/**
+ * Start the shipper thread (manager only)
+ *
+ * @param mode Durability point from dsm_config_t.replication
+ * @return DSM_SUCCESS, or DSM_ERROR_INIT if the thread cannot start
+ */
+int replication_start(dsm_replication_t mode);
+
+/**
+ * Ship what is left in the log and stop the shipper thread
+ * Called from network_shutdown() after the handler pool has drained. On
+ * the backup, records not yet in the snapshot are discarded.
+ */
+void replication_stop(void);
+
+/**
+ * Append a STATE_SYNC_DIR, _LOCK or _BARRIER message to the log
+ * Assigns the record's sync_seq, so log order is sync_seq order.
+ *
+ * @param msg Message to record (its payload's sync_seq is overwritten)
+ * @return DSM_SUCCESS, DSM_ERROR_INVALID or DSM_ERROR_MEMORY
+ */
+int replication_append(message_t *msg);
+
+/**
+ * Wait for the log to be shipped up to its current end
+ * No-op unless the mode is DSM_REPLICATION_BEFORE_REPLY.
+ */
+void replication_commit(void);
+
+/**
+ * Ship everything in the log now, whatever the mode
+ *
+ * @return DSM_SUCCESS, or the error of a failed send (the batch is dropped)
+ */
+int replication_flush(void);
+
+/**
+ * Fold the backup's log into the shadow tables
+ * Called before promotion and before a single STATE_SYNC_* is applied.
+ *
+ * @return Records applied (at most one per directory, lock or barrier entry)
+ */
+int replication_snapshot(void);
+
+/**
+ * Append the records of a STATE_SYNC_BATCH to the backup's log
+ * The whole batch is checked before any of it is kept.
+ *
+ * @param msg Batch message
+ * @param data Records
+ * @param data_len Bytes of data
+ * @return DSM_SUCCESS, or DSM_ERROR_INVALID for a malformed batch
+ */
+int handle_state_sync_batch(const message_t *msg, const uint8_t *data, size_t data_len);
+
+#endif /* REPLICATION_H */
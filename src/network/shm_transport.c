@@ -0,0 +1,498 @@
+/**
+ * @file shm_transport.c
+ * @brief Shared-memory transport backend for co-located nodes
+ *
+ * The offering node creates a memfd segment holding one single-producer,
+ * single-consumer byte ring per direction; the accepting node maps the
+ * same segment through /proc/<pid>/fd of the offerer. A frame is copied
+ * into the ring by the sender and out of it by the receiver, with no
+ * system call while the receiver is busy. The receiver sets its ring's
+ * waiting flag only before it goes back to epoll; a sender that finds the
+ * flag set clears it and rings a doorbell, a one-byte datagram on an
+ * abstract Unix socket that is the connection's event fd.
+ *
+ * Peers count as co-located when they share a boot ID and the offerer's
+ * segment and doorbell can be opened; anything else is rejected and the
+ * connection moves on to the next transport.
+ *
+ * A sender blocked on a full ring moves what its own receive ring holds
+ * into a private overflow buffer, so two nodes filling each other's
+ * rings from their dispatchers cannot deadlock.
+ */
+
+#define _GNU_SOURCE
+#include "transport.h"
+#include "../core/log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/** Bytes of each direction's ring (a power of two) */
+#define SHM_RING_SIZE (1024 * 1024)
+/** Longest wait for ring space or for the rest of a frame */
+#define SHM_WAIT_MS 10000
+/** Identifies a segment laid out by this file */
+#define SHM_MAGIC 0x44534D53484D3031ULL
+
+/**
+ * One direction of a connection
+ * head and tail count bytes ever written and read; they sit on separate
+ * cache lines so producer and consumer do not share one.
+ */
+typedef struct {
+    uint64_t head __attribute__((aligned(64)));     /**< Written by the producer */
+    uint64_t tail __attribute__((aligned(64)));     /**< Written by the consumer */
+    uint32_t waiting __attribute__((aligned(64)));  /**< Consumer is about to sleep: ring the doorbell */
+    uint8_t data[SHM_RING_SIZE] __attribute__((aligned(64)));
+} shm_ring_t;
+
+/**
+ * Layout of the memfd segment
+ * ring[0] carries frames from the offerer, ring[1] frames to it.
+ */
+typedef struct {
+    uint64_t magic;
+    uint64_t token;            /**< Random value the offerer also sends in its info */
+    shm_ring_t ring[2];
+} shm_segment_t;
+
+/**
+ * What a peer needs to connect (OFFER carries all of it, ACCEPT the
+ * doorbell only)
+ */
+typedef struct {
+    uint8_t boot_id[16];       /**< Kernel boot ID: equal on co-located nodes */
+    uint64_t token;            /**< Segment token */
+    int32_t pid;               /**< Process holding the segment and doorbell */
+    int32_t fd;                /**< Segment memfd in that process (-1 in ACCEPT) */
+    uint32_t bell;             /**< Doorbell ID in that process */
+} __attribute__((packed)) shm_conn_info_t;
+
+typedef struct {
+    transport_conn_t base;
+    shm_segment_t *seg;
+    int memfd;                 /**< Offerer only */
+    shm_ring_t *tx;
+    shm_ring_t *rx;
+    int bell_fd;               /**< Our doorbell (event fd) */
+    uint32_t bell_id;
+    int peer_bell_fd;          /**< Connected to the peer's doorbell */
+    pid_t peer_pid;
+
+    pthread_mutex_t rx_lock;   /**< Consumer side: rx->tail and overflow */
+    uint8_t *overflow;         /**< Bytes taken from rx while our sender was blocked */
+    size_t ov_start;
+    size_t ov_end;
+    size_t ov_cap;
+} shm_conn_t;
+
+static uint32_t g_next_bell;
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static int read_boot_id(uint8_t out[16]) {
+    FILE *f = fopen("/proc/sys/kernel/random/boot_id", "r");
+    if (!f) {
+        return DSM_ERROR_INIT;
+    }
+    char text[64];
+    int rc = fgets(text, sizeof(text), f) ? DSM_SUCCESS : DSM_ERROR_INIT;
+    fclose(f);
+
+    int n = 0;
+    for (char *p = text; rc == DSM_SUCCESS && *p && n < 16; p++) {
+        unsigned int byte;
+        if (*p == '-' || *p == '\n') {
+            continue;
+        }
+        if (sscanf(p, "%2x", &byte) != 1) {
+            rc = DSM_ERROR_INIT;
+            break;
+        }
+        out[n++] = (uint8_t)byte;
+        p++;
+    }
+    return rc == DSM_SUCCESS && n == 16 ? DSM_SUCCESS : DSM_ERROR_INIT;
+}
+
+static socklen_t bell_address(struct sockaddr_un *addr, pid_t pid, uint32_t bell) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    int len = snprintf(addr->sun_path + 1, sizeof(addr->sun_path) - 1, "dsm-shm-%d-%u", (int)pid, bell);
+    return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + len);
+}
+
+/* ============================ */
+/*       Rings                  */
+/* ============================ */
+
+static void ring_notify(shm_conn_t *c) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&c->tx->waiting, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&c->tx->waiting, 0, __ATOMIC_SEQ_CST)) {
+        char bell = 1;
+        if (send(c->peer_bell_fd, &bell, 1, MSG_DONTWAIT) < 0 && errno != EAGAIN) {
+            LOG_DEBUG("Doorbell to node %u failed: %s", c->base.peer, strerror(errno));
+        }
+    }
+}
+
+/**
+ * Bytes waiting in the receive ring
+ */
+static size_t ring_available(const shm_ring_t *r) {
+    return (size_t)(__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - r->tail);
+}
+
+/**
+ * Copy out up to len bytes from the receive ring (rx_lock held)
+ */
+static size_t ring_read(shm_ring_t *r, uint8_t *buf, size_t len) {
+    size_t avail = ring_available(r);
+    size_t n = len < avail ? len : avail;
+    size_t pos = (size_t)(r->tail & (SHM_RING_SIZE - 1));
+    size_t first = SHM_RING_SIZE - pos < n ? SHM_RING_SIZE - pos : n;
+
+    memcpy(buf, r->data + pos, first);
+    memcpy(buf + first, r->data, n - first);
+    __atomic_store_n(&r->tail, r->tail + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+/**
+ * Move everything in the receive ring to the overflow buffer, if no
+ * reader is at it (called by a blocked sender)
+ */
+static void drain_to_overflow(shm_conn_t *c) {
+    if (pthread_mutex_trylock(&c->rx_lock) != 0) {
+        return;
+    }
+
+    size_t avail = ring_available(c->rx);
+    if (avail > 0) {
+        if (c->ov_start > 0) {
+            memmove(c->overflow, c->overflow + c->ov_start, c->ov_end - c->ov_start);
+            c->ov_end -= c->ov_start;
+            c->ov_start = 0;
+        }
+        if (c->ov_end + avail > c->ov_cap) {
+            size_t cap = c->ov_cap ? c->ov_cap * 2 : SHM_RING_SIZE;
+            while (cap < c->ov_end + avail) {
+                cap *= 2;
+            }
+            uint8_t *ov = realloc(c->overflow, cap);
+            if (ov) {
+                c->overflow = ov;
+                c->ov_cap = cap;
+            }
+        }
+        if (c->ov_end + avail <= c->ov_cap) {
+            c->ov_end += ring_read(c->rx, c->overflow + c->ov_end, avail);
+        }
+    }
+    pthread_mutex_unlock(&c->rx_lock);
+}
+
+/**
+ * Wait a little for the peer; false once it is gone or the deadline passed
+ */
+static bool wait_for_peer(shm_conn_t *c, uint64_t deadline) {
+    sched_yield();
+    if (kill(c->peer_pid, 0) != 0 && errno == ESRCH) {
+        LOG_ERROR("Node %u (pid %d) is gone", c->base.peer, (int)c->peer_pid);
+        return false;
+    }
+    return now_ms() < deadline;
+}
+
+static int shm_send_iov(transport_conn_t *conn, const struct iovec *iov, int iovcnt, size_t len) {
+    shm_conn_t *c = (shm_conn_t *)conn;
+    shm_ring_t *r = c->tx;
+    uint64_t deadline = now_ms() + SHM_WAIT_MS;
+
+    for (int i = 0; i < iovcnt && len > 0; i++) {
+        const uint8_t *src = iov[i].iov_base;
+        size_t left = iov[i].iov_len;
+
+        while (left > 0) {
+            uint64_t head = r->head;
+            size_t space = SHM_RING_SIZE - (size_t)(head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE));
+            if (space == 0) {
+                /* Make sure the peer is draining, then keep our side moving */
+                ring_notify(c);
+                drain_to_overflow(c);
+                if (!wait_for_peer(c, deadline)) {
+                    return DSM_ERROR_NETWORK;
+                }
+                continue;
+            }
+
+            size_t n = left < space ? left : space;
+            size_t pos = (size_t)(head & (SHM_RING_SIZE - 1));
+            size_t first = SHM_RING_SIZE - pos < n ? SHM_RING_SIZE - pos : n;
+            memcpy(r->data + pos, src, first);
+            memcpy(r->data, src + first, n - first);
+            __atomic_store_n(&r->head, head + n, __ATOMIC_RELEASE);
+
+            src += n;
+            left -= n;
+            len -= n;
+        }
+    }
+
+    ring_notify(c);
+    return DSM_SUCCESS;
+}
+
+static int shm_recv_exact(transport_conn_t *conn, void *buf, size_t len) {
+    shm_conn_t *c = (shm_conn_t *)conn;
+    uint8_t *dst = buf;
+    uint64_t deadline = now_ms() + SHM_WAIT_MS;
+    int rc = DSM_SUCCESS;
+
+    pthread_mutex_lock(&c->rx_lock);
+    while (len > 0) {
+        size_t n;
+        if (c->ov_end > c->ov_start) {
+            n = c->ov_end - c->ov_start < len ? c->ov_end - c->ov_start : len;
+            memcpy(dst, c->overflow + c->ov_start, n);
+            c->ov_start += n;
+            if (c->ov_start == c->ov_end) {
+                c->ov_start = c->ov_end = 0;
+            }
+        } else {
+            n = ring_read(c->rx, dst, len);
+        }
+
+        if (n > 0) {
+            dst += n;
+            len -= n;
+            continue;
+        }
+
+        /* The rest of the frame is still being written */
+        pthread_mutex_unlock(&c->rx_lock);
+        bool alive = wait_for_peer(c, deadline);
+        pthread_mutex_lock(&c->rx_lock);
+        if (!alive) {
+            rc = DSM_ERROR_NETWORK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&c->rx_lock);
+    return rc;
+}
+
+static bool shm_readable(transport_conn_t *conn) {
+    shm_conn_t *c = (shm_conn_t *)conn;
+
+    pthread_mutex_lock(&c->rx_lock);
+    bool readable = c->ov_end > c->ov_start || ring_available(c->rx) > 0;
+    if (!readable) {
+        /* Going back to epoll: ask for a doorbell, then look once more
+         * in case a frame landed before the flag was seen */
+        __atomic_store_n(&c->rx->waiting, 1, __ATOMIC_SEQ_CST);
+        if (ring_available(c->rx) > 0) {
+            __atomic_store_n(&c->rx->waiting, 0, __ATOMIC_RELAXED);
+            readable = true;
+        }
+    }
+    pthread_mutex_unlock(&c->rx_lock);
+    return readable;
+}
+
+static int shm_event_fd(transport_conn_t *conn) {
+    return ((shm_conn_t *)conn)->bell_fd;
+}
+
+static void shm_handle_event(transport_conn_t *conn) {
+    shm_conn_t *c = (shm_conn_t *)conn;
+    char bells[64];
+    while (recv(c->bell_fd, bells, sizeof(bells), MSG_DONTWAIT) > 0) {}
+}
+
+/* ============================ */
+/*       Connection Setup       */
+/* ============================ */
+
+static void shm_destroy(transport_conn_t *conn) {
+    shm_conn_t *c = (shm_conn_t *)conn;
+
+    if (c->seg) munmap(c->seg, sizeof(shm_segment_t));
+    if (c->memfd >= 0) close(c->memfd);
+    if (c->bell_fd >= 0) close(c->bell_fd);
+    if (c->peer_bell_fd >= 0) close(c->peer_bell_fd);
+    free(c->overflow);
+    pthread_mutex_destroy(&c->rx_lock);
+    free(c);
+}
+
+static transport_conn_t *shm_create(node_id_t peer) {
+    shm_conn_t *c = calloc(1, sizeof(*c));
+    if (!c) {
+        return NULL;
+    }
+    pthread_mutex_init(&c->rx_lock, NULL);
+    c->memfd = -1;
+    c->peer_bell_fd = -1;
+    c->bell_id = __atomic_fetch_add(&g_next_bell, 1, __ATOMIC_RELAXED);
+
+    struct sockaddr_un addr;
+    socklen_t addr_len = bell_address(&addr, getpid(), c->bell_id);
+    c->bell_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c->bell_fd < 0 || bind(c->bell_fd, (struct sockaddr *)&addr, addr_len) != 0) {
+        LOG_WARN("Failed to set up shared-memory doorbell for node %u: %s", peer, strerror(errno));
+        shm_destroy(&c->base);
+        return NULL;
+    }
+    return &c->base;
+}
+
+/**
+ * Create and map the segment (offerer)
+ */
+static int create_segment(shm_conn_t *c) {
+    c->memfd = memfd_create("dsm-shm", MFD_CLOEXEC);
+    if (c->memfd < 0 || ftruncate(c->memfd, sizeof(shm_segment_t)) != 0) {
+        LOG_WARN("Failed to create shared-memory segment: %s", strerror(errno));
+        return DSM_ERROR_MEMORY;
+    }
+    c->seg = mmap(NULL, sizeof(shm_segment_t), PROT_READ | PROT_WRITE, MAP_SHARED, c->memfd, 0);
+    if (c->seg == MAP_FAILED) {
+        c->seg = NULL;
+        return DSM_ERROR_MEMORY;
+    }
+
+    c->seg->token = ((uint64_t)random() << 32) ^ (uint64_t)random() ^ (uint64_t)now_ms();
+    c->seg->ring[0].waiting = 1;
+    c->seg->ring[1].waiting = 1;
+    __atomic_store_n(&c->seg->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+    c->tx = &c->seg->ring[0];
+    c->rx = &c->seg->ring[1];
+    return DSM_SUCCESS;
+}
+
+static size_t shm_local_info(transport_conn_t *conn, uint8_t *buf, size_t cap) {
+    shm_conn_t *c = (shm_conn_t *)conn;
+    if (cap < sizeof(shm_conn_info_t)) {
+        return 0;
+    }
+
+    /* Asked before connecting: we are the offerer and own the segment */
+    if (!c->seg && create_segment(c) != DSM_SUCCESS) {
+        return 0;
+    }
+
+    shm_conn_info_t info;
+    memset(&info, 0, sizeof(info));
+    if (read_boot_id(info.boot_id) != DSM_SUCCESS) {
+        return 0;
+    }
+    info.token = c->seg->token;
+    info.pid = (int32_t)getpid();
+    info.fd = c->memfd;
+    info.bell = c->bell_id;
+    memcpy(buf, &info, sizeof(info));
+    return sizeof(info);
+}
+
+/**
+ * Map the offerer's segment through /proc (accepter)
+ */
+static int open_segment(shm_conn_t *c, const shm_conn_info_t *info) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/fd/%d", (int)info->pid, (int)info->fd);
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_INFO("Cannot open shared-memory segment of node %u: %s", c->base.peer, strerror(errno));
+        return DSM_ERROR_NETWORK;
+    }
+
+    void *seg = mmap(NULL, sizeof(shm_segment_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (seg == MAP_FAILED) {
+        LOG_WARN("Cannot map shared-memory segment of node %u: %s", c->base.peer, strerror(errno));
+        return DSM_ERROR_NETWORK;
+    }
+
+    c->seg = seg;
+    if (__atomic_load_n(&c->seg->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC || c->seg->token != info->token) {
+        LOG_WARN("Shared-memory segment of node %u does not match its offer", c->base.peer);
+        return DSM_ERROR_INVALID;
+    }
+    c->tx = &c->seg->ring[1];
+    c->rx = &c->seg->ring[0];
+    return DSM_SUCCESS;
+}
+
+static int shm_connect(transport_conn_t *conn, const uint8_t *buf, size_t len) {
+    shm_conn_t *c = (shm_conn_t *)conn;
+    if (len < sizeof(shm_conn_info_t)) {
+        return DSM_ERROR_INVALID;
+    }
+
+    shm_conn_info_t info;
+    memcpy(&info, buf, sizeof(info));
+
+    uint8_t boot_id[16];
+    if (read_boot_id(boot_id) != DSM_SUCCESS || memcmp(boot_id, info.boot_id, sizeof(boot_id)) != 0) {
+        LOG_DEBUG("Node %u runs on another host", conn->peer);
+        return DSM_ERROR_NETWORK;
+    }
+
+    if (!c->seg && open_segment(c, &info) != DSM_SUCCESS) {
+        return DSM_ERROR_NETWORK;
+    }
+
+    struct sockaddr_un addr;
+    socklen_t addr_len = bell_address(&addr, (pid_t)info.pid, info.bell);
+    c->peer_bell_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (c->peer_bell_fd < 0 || connect(c->peer_bell_fd, (struct sockaddr *)&addr, addr_len) != 0) {
+        LOG_INFO("Cannot reach shared-memory doorbell of node %u: %s", conn->peer, strerror(errno));
+        return DSM_ERROR_NETWORK;
+    }
+    c->peer_pid = (pid_t)info.pid;
+
+    LOG_INFO("Shared-memory connection to node %u (pid %d) ready", conn->peer, (int)info.pid);
+    return DSM_SUCCESS;
+}
+
+static void shm_close(void) {
+}
+
+static const transport_ops_t shm_ops = {
+    .name = "shm",
+    .create = shm_create,
+    .local_info = shm_local_info,
+    .connect = shm_connect,
+    .event_fd = shm_event_fd,
+    .handle_event = shm_handle_event,
+    .send_iov = shm_send_iov,
+    .recv_exact = shm_recv_exact,
+    .readable = shm_readable,
+    .destroy = shm_destroy,
+    .close = shm_close
+};
+
+const transport_ops_t *shm_transport_open(void) {
+    uint8_t boot_id[16];
+    if (read_boot_id(boot_id) != DSM_SUCCESS) {
+        LOG_WARN("No kernel boot ID, shared-memory transport disabled");
+        return NULL;
+    }
+    return &shm_ops;
+}
@@ -0,0 +1,362 @@
+/**
+ * @file transport.c
+ * @brief Transport selection and TRANSPORT_CONNECT handshake
+ */
+
+#include "transport.h"
+#include "network.h"
+#include "handlers.h"
+#include "../core/log.h"
+#include "../core/dsm_context.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Kinds a worker offers, most preferred first */
+static const dsm_transport_t g_offer_order[] = { DSM_TRANSPORT_SHM, DSM_TRANSPORT_RDMA };
+#define NUM_OFFER_KINDS (sizeof(g_offer_order) / sizeof(g_offer_order[0]))
+
+static struct {
+    pthread_mutex_t lock;          /**< Protects conns */
+    const transport_ops_t *backends[DSM_TRANSPORT_COUNT]; /**< Opened backend per kind (NULL = not in use) */
+    dsm_transport_t kind;          /**< Backend for remote peers (TCP = none) */
+    transport_conn_t **conns;      /**< Connection per peer (max_conns entries) */
+    int max_conns;
+} g_transport = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .backends = { NULL },
+    .kind = DSM_TRANSPORT_TCP,
+    .conns = NULL,
+    .max_conns = 0
+};
+
+/**
+ * Backend for kind, or NULL
+ */
+static const transport_ops_t *backend_for(dsm_transport_t kind) {
+    if ((int)kind <= DSM_TRANSPORT_TCP || kind >= DSM_TRANSPORT_COUNT) {
+        return NULL;
+    }
+    pthread_mutex_lock(&g_transport.lock);
+    const transport_ops_t *ops = g_transport.backends[kind];
+    pthread_mutex_unlock(&g_transport.lock);
+    return ops;
+}
+
+int transport_init(dsm_transport_t kind, bool use_shm, int max_nodes) {
+    const transport_ops_t *backends[DSM_TRANSPORT_COUNT] = { NULL };
+    bool any = false;
+
+    if (kind == DSM_TRANSPORT_RDMA) {
+        backends[DSM_TRANSPORT_RDMA] = rdma_transport_open();
+        if (!backends[DSM_TRANSPORT_RDMA]) {
+            LOG_WARN("Transport %d unavailable, remote peers connect over TCP", kind);
+            kind = DSM_TRANSPORT_TCP;
+        }
+    } else if (kind != DSM_TRANSPORT_TCP) {
+        LOG_WARN("Transport %d cannot be requested, remote peers connect over TCP", kind);
+        kind = DSM_TRANSPORT_TCP;
+    }
+    if (use_shm) {
+        backends[DSM_TRANSPORT_SHM] = shm_transport_open();
+    }
+    for (int i = 0; i < DSM_TRANSPORT_COUNT; i++) {
+        any = any || backends[i];
+    }
+    if (!any) {
+        return DSM_SUCCESS;
+    }
+
+    transport_conn_t **conns = calloc(max_nodes, sizeof(*conns));
+    if (!conns) {
+        for (int i = 0; i < DSM_TRANSPORT_COUNT; i++) {
+            if (backends[i]) {
+                backends[i]->close();
+            }
+        }
+        return DSM_ERROR_MEMORY;
+    }
+
+    pthread_mutex_lock(&g_transport.lock);
+    memcpy(g_transport.backends, backends, sizeof(backends));
+    g_transport.kind = kind;
+    g_transport.conns = conns;
+    g_transport.max_conns = max_nodes;
+    pthread_mutex_unlock(&g_transport.lock);
+
+    for (int i = 0; i < DSM_TRANSPORT_COUNT; i++) {
+        if (backends[i]) {
+            LOG_INFO("Transport backend %s opened", backends[i]->name);
+        }
+    }
+    return DSM_SUCCESS;
+}
+
+void transport_shutdown(void) {
+    const transport_ops_t *backends[DSM_TRANSPORT_COUNT];
+
+    pthread_mutex_lock(&g_transport.lock);
+    memcpy(backends, g_transport.backends, sizeof(backends));
+    transport_conn_t **conns = g_transport.conns;
+    int max_conns = g_transport.max_conns;
+    memset(g_transport.backends, 0, sizeof(g_transport.backends));
+    g_transport.kind = DSM_TRANSPORT_TCP;
+    g_transport.conns = NULL;
+    g_transport.max_conns = 0;
+    pthread_mutex_unlock(&g_transport.lock);
+
+    for (int i = 0; i < max_conns; i++) {
+        if (conns[i]) {
+            conns[i]->ops->destroy(conns[i]);
+        }
+    }
+    free(conns);
+    for (int i = 0; i < DSM_TRANSPORT_COUNT; i++) {
+        if (backends[i]) {
+            backends[i]->close();
+            LOG_INFO("Transport backend %s closed", backends[i]->name);
+        }
+    }
+}
+
+dsm_transport_t transport_active(void) {
+    pthread_mutex_lock(&g_transport.lock);
+    dsm_transport_t kind = g_transport.kind;
+    pthread_mutex_unlock(&g_transport.lock);
+    return kind;
+}
+
+bool transport_enabled(void) {
+    pthread_mutex_lock(&g_transport.lock);
+    bool enabled = g_transport.conns != NULL;
+    pthread_mutex_unlock(&g_transport.lock);
+    return enabled;
+}
+
+dsm_transport_t transport_peer_kind(node_id_t peer) {
+    dsm_transport_t kind = DSM_TRANSPORT_TCP;
+
+    pthread_mutex_lock(&g_transport.lock);
+    transport_conn_t *conn = peer < (node_id_t)g_transport.max_conns ? g_transport.conns[peer] : NULL;
+    if (conn && conn->rx_enabled && conn->tx_enabled) {
+        kind = conn->kind;
+    }
+    pthread_mutex_unlock(&g_transport.lock);
+    return kind;
+}
+
+transport_conn_t *transport_find_event_fd(int fd) {
+    transport_conn_t *found = NULL;
+
+    pthread_mutex_lock(&g_transport.lock);
+    for (int i = 0; i < g_transport.max_conns && !found; i++) {
+        transport_conn_t *conn = g_transport.conns[i];
+        if (conn && conn->ops->event_fd(conn) == fd) {
+            found = conn;
+        }
+    }
+    pthread_mutex_unlock(&g_transport.lock);
+    return found;
+}
+
+/**
+ * Connection to peer, or NULL
+ */
+static transport_conn_t *conn_for_peer(node_id_t peer) {
+    pthread_mutex_lock(&g_transport.lock);
+    transport_conn_t *conn = peer < (node_id_t)g_transport.max_conns ? g_transport.conns[peer] : NULL;
+    pthread_mutex_unlock(&g_transport.lock);
+    return conn;
+}
+
+/**
+ * Drop a peer's connection; its frames go back to the socket
+ */
+static void drop_conn(node_id_t peer) {
+    pthread_mutex_lock(&g_transport.lock);
+    transport_conn_t *conn = peer < (node_id_t)g_transport.max_conns ? g_transport.conns[peer] : NULL;
+    if (conn) {
+        g_transport.conns[peer] = NULL;
+    }
+    pthread_mutex_unlock(&g_transport.lock);
+
+    if (conn) {
+        network_send_switch(peer, NULL, NULL);
+        conn->ops->destroy(conn);
+    }
+}
+
+/**
+ * Create a connection to peer and watch its events
+ * An existing connection to peer (from before a reconnect) is replaced.
+ */
+static transport_conn_t *new_conn(node_id_t peer, dsm_transport_t kind) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    drop_conn(peer);
+
+    pthread_mutex_lock(&ctx->lock);
+    if (peer >= (node_id_t)ctx->network.max_nodes || !ctx->network.nodes[peer].connected) {
+        pthread_mutex_unlock(&ctx->lock);
+        return NULL;
+    }
+    int sockfd = ctx->network.nodes[peer].sockfd;
+    pthread_mutex_unlock(&ctx->lock);
+
+    const transport_ops_t *ops = backend_for(kind);
+    transport_conn_t *conn = ops ? ops->create(peer) : NULL;
+    if (!conn) {
+        return NULL;
+    }
+    conn->ops = ops;
+    conn->kind = kind;
+    conn->peer = peer;
+    conn->sockfd = sockfd;
+    conn->offered = false;
+    conn->rx_enabled = false;
+    conn->tx_enabled = false;
+
+    pthread_mutex_lock(&g_transport.lock);
+    g_transport.conns[peer] = conn;
+    pthread_mutex_unlock(&g_transport.lock);
+
+    if (network_watch_socket(ops->event_fd(conn)) != DSM_SUCCESS) {
+        drop_conn(peer);
+        return NULL;
+    }
+    return conn;
+}
+
+/**
+ * Move our frames to the peer onto the connection, with SWITCHED as the
+ * last frame on the socket
+ */
+static int switch_tx(transport_conn_t *conn) {
+    int rc = send_transport_connect(conn->peer, conn->kind, TRANSPORT_SWITCHED, conn);
+    if (rc == DSM_SUCCESS) {
+        conn->tx_enabled = true;
+        LOG_INFO("Frames to node %u now travel over %s", conn->peer, conn->ops->name);
+    }
+    return rc;
+}
+
+/**
+ * Position of kind in g_offer_order (NUM_OFFER_KINDS if absent)
+ */
+static size_t offer_position(uint8_t kind) {
+    size_t i = 0;
+    while (i < NUM_OFFER_KINDS && g_offer_order[i] != (dsm_transport_t)kind) {
+        i++;
+    }
+    return i;
+}
+
+/**
+ * Offer the first opened kind after the one at position start of
+ * g_offer_order; TCP stays when none is left
+ */
+static int offer_from(node_id_t peer, size_t start) {
+    for (size_t i = start; i < NUM_OFFER_KINDS; i++) {
+        dsm_transport_t kind = g_offer_order[i];
+        const transport_ops_t *ops = backend_for(kind);
+        if (!ops) {
+            continue;
+        }
+
+        transport_conn_t *conn = new_conn(peer, kind);
+        if (!conn) {
+            LOG_WARN("Could not set up %s connection to node %u", ops->name, peer);
+            continue;
+        }
+
+        conn->offered = true;
+        int rc = send_transport_connect(peer, kind, TRANSPORT_OFFER, conn);
+        if (rc != DSM_SUCCESS) {
+            drop_conn(peer);
+        }
+        return rc;
+    }
+
+    LOG_INFO("Frames to and from node %u stay on TCP", peer);
+    return network_open_lanes(peer);
+}
+
+int transport_offer(node_id_t peer) {
+    if (!transport_enabled()) {
+        return network_open_lanes(peer);
+    }
+    return offer_from(peer, 0);
+}
+
+/**
+ * Answer an OFFER: connect and ACCEPT, or REJECT
+ */
+static int accept_offer(node_id_t peer, uint8_t kind, const uint8_t *info, size_t info_len) {
+    const transport_ops_t *ops = backend_for((dsm_transport_t)kind);
+    if (!ops) {
+        LOG_INFO("Node %u offered transport %u, which this node does not use", peer, kind);
+        return send_transport_connect(peer, kind, TRANSPORT_REJECT, NULL);
+    }
+
+    transport_conn_t *conn = new_conn(peer, (dsm_transport_t)kind);
+    if (!conn || conn->ops->connect(conn, info, info_len) != DSM_SUCCESS) {
+        LOG_INFO("Could not connect to node %u over %s", peer, ops->name);
+        drop_conn(peer);
+        return send_transport_connect(peer, kind, TRANSPORT_REJECT, NULL);
+    }
+
+    int rc = send_transport_connect(peer, kind, TRANSPORT_ACCEPT, conn);
+    if (rc != DSM_SUCCESS) {
+        drop_conn(peer);
+    }
+    return rc;
+}
+
+int transport_handle_connect(node_id_t peer, uint8_t kind, uint8_t phase,
+                             const uint8_t *info, size_t info_len) {
+    if (phase == TRANSPORT_OFFER) {
+        return accept_offer(peer, kind, info, info_len);
+    }
+
+    transport_conn_t *conn = conn_for_peer(peer);
+    if (!conn || conn->kind != (dsm_transport_t)kind) {
+        LOG_WARN("TRANSPORT_CONNECT phase %u from node %u without a connection", phase, peer);
+        return DSM_ERROR_INVALID;
+    }
+
+    switch (phase) {
+        case TRANSPORT_ACCEPT:
+            if (conn->ops->connect(conn, info, info_len) != DSM_SUCCESS) {
+                LOG_INFO("Could not connect to node %u over %s", peer, conn->ops->name);
+                drop_conn(peer);
+                send_transport_connect(peer, kind, TRANSPORT_REJECT, NULL);
+                return offer_from(peer, offer_position(kind) + 1);
+            }
+            return switch_tx(conn);
+
+        case TRANSPORT_SWITCHED:
+            /* Everything the peer sends from here on comes over the
+             * backend, possibly already waiting there */
+            conn->rx_enabled = true;
+            LOG_INFO("Frames from node %u now travel over %s", peer, conn->ops->name);
+            network_drain_transport(conn);
+            return conn->tx_enabled ? DSM_SUCCESS : switch_tx(conn);
+
+        case TRANSPORT_REJECT:
+            if (conn->tx_enabled || conn->rx_enabled) {
+                LOG_WARN("Node %u rejected a connection already in use", peer);
+                return DSM_ERROR_INVALID;
+            }
+            LOG_INFO("Node %u declined %s", peer, conn->ops->name);
+            {
+                /* Only the offering side moves on to the next kind */
+                bool offered = conn->offered;
+                drop_conn(peer);
+                return offered ? offer_from(peer, offer_position(kind) + 1) : DSM_SUCCESS;
+            }
+
+        default:
+            LOG_WARN("Unknown TRANSPORT_CONNECT phase %u from node %u", phase, peer);
+            return DSM_ERROR_INVALID;
+    }
+}
@@ -0,0 +1,188 @@
+/**
+ * @file transport.h
+ * @brief Pluggable peer transports
+ *
+ * Every peer is first reached over TCP: the socket carries NODE_JOIN,
+ * reports hangups and is the default byte stream for frames. A backend
+ * selected with dsm_config_t.transport can take over a connection's frame
+ * stream after a TRANSPORT_CONNECT handshake on the socket:
+ *
+ *   worker                               manager
+ *   OFFER (local info)        --TCP-->   create, connect
+ *                             <--TCP--   ACCEPT (local info)
+ *   connect, SWITCHED         --TCP-->   receive from backend,
+ *   send over backend                    SWITCHED
+ *                             <--TCP--   send over backend
+ *   receive from backend
+ *
+ * Workers offer the kinds they opened in order of preference: shared
+ * memory first (only usable when both nodes run on the same host), then
+ * the backend selected with dsm_config_t.transport. A REJECT makes the
+ * offering side offer the next kind.
+ *
+ * SWITCHED is the last frame either side writes to the socket, so a
+ * receiver that starts reading the backend when it handles SWITCHED sees
+ * every frame exactly once and in order. Frames keep the length-prefixed
+ * format of the TCP stream and are parsed by the same reader. Either side
+ * answers REJECT before switching when it cannot (or will not) use the
+ * backend; the connection then stays on TCP.
+ *
+ * TRANSPORT_CONNECT is handled on the dispatcher thread, which is also
+ * the only thread that polls connections and, before shutdown, destroys
+ * them.
+ */
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include "dsm/types.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+typedef struct transport_ops_s transport_ops_t;
+
+/**
+ * One peer connection of a backend
+ * Backends embed this as the first member of their connection state.
+ */
+typedef struct {
+    const transport_ops_t *ops;
+    dsm_transport_t kind;          /**< Backend the connection belongs to */
+    node_id_t peer;                /**< Node at the other end */
+    int sockfd;                    /**< TCP socket the connection was set up over */
+    bool offered;                  /**< We sent the OFFER */
+    volatile bool rx_enabled;      /**< Peer switched: frames are read from the backend */
+    bool tx_enabled;               /**< We switched: frames are written to the backend */
+} transport_conn_t;
+
+/**
+ * Backend operations
+ *
+ * send_iov, recv_exact and readable behave like their socket
+ * counterparts on a reliable byte stream. send_iov runs under the peer's
+ * send_lock; the others run on the dispatcher thread.
+ */
+struct transport_ops_s {
+    const char *name;
+
+    /** New connection to peer, ready to receive once connected */
+    transport_conn_t *(*create)(node_id_t peer);
+    /** Write what the peer needs to connect to us; returns bytes used */
+    size_t (*local_info)(transport_conn_t *conn, uint8_t *buf, size_t cap);
+    /** Connect to the peer described by info */
+    int (*connect)(transport_conn_t *conn, const uint8_t *info, size_t len);
+    /** fd the dispatcher polls for connection events (edge-triggered) */
+    int (*event_fd)(transport_conn_t *conn);
+    /** Consume the events behind an event_fd wakeup */
+    void (*handle_event)(transport_conn_t *conn);
+
+    /** Write len bytes described by iov */
+    int (*send_iov)(transport_conn_t *conn, const struct iovec *iov, int iovcnt, size_t len);
+    /** Read exactly len bytes */
+    int (*recv_exact)(transport_conn_t *conn, void *buf, size_t len);
+    /** Check whether received bytes are waiting */
+    bool (*readable)(transport_conn_t *conn);
+
+    void (*destroy)(transport_conn_t *conn);
+    /** Release the device once all connections are destroyed */
+    void (*close)(void);
+};
+
+/**
+ * Open the backend for dsm_config_t.transport and the shared-memory one
+ * Falls back to TCP with a warning when the backend is unavailable.
+ *
+ * @param kind Requested transport for remote peers
+ * @param use_shm Also open the shared-memory backend for co-located peers
+ * @param max_nodes Node table capacity
+ * @return DSM_SUCCESS, or DSM_ERROR_MEMORY
+ */
+int transport_init(dsm_transport_t kind, bool use_shm, int max_nodes);
+
+/**
+ * Destroy all connections and close the backend
+ * The dispatcher must no longer be running.
+ */
+void transport_shutdown(void);
+
+/**
+ * Transport this node offers its remote peers
+ */
+dsm_transport_t transport_active(void);
+
+/**
+ * Check whether any backend is open
+ */
+bool transport_enabled(void);
+
+/**
+ * Transport frames to and from peer travel over
+ *
+ * @return The connection's kind once switched both ways, DSM_TRANSPORT_TCP otherwise
+ */
+dsm_transport_t transport_peer_kind(node_id_t peer);
+
+/**
+ * Start the handshake that moves a peer connection to the backend
+ * A connection that ends up on TCP gets the extra TCP lanes of
+ * dsm_config_t.tcp_lanes instead (network_open_lanes()).
+ *
+ * @param peer Connected peer (workers offer to the manager)
+ * @return DSM_SUCCESS, or an error if the offer could not be sent
+ */
+int transport_offer(node_id_t peer);
+
+/**
+ * Handle one step of a peer's TRANSPORT_CONNECT handshake
+ *
+ * @param peer Sending node
+ * @param kind dsm_transport_t the peer is setting up
+ * @param phase transport_phase_t of the message
+ * @param info Backend connection data of the peer (OFFER and ACCEPT)
+ * @param info_len Bytes of info
+ * @return DSM_SUCCESS or error code
+ */
+int transport_handle_connect(node_id_t peer, uint8_t kind, uint8_t phase,
+                             const uint8_t *info, size_t info_len);
+
+/**
+ * Find the connection whose event fd is fd
+ * Called by the dispatcher for every wakeup that is not a socket.
+ */
+transport_conn_t *transport_find_event_fd(int fd);
+
+/**
+ * Open the RDMA (ibverbs) backend on the first active device port
+ * Page data is written one-sided into a registered landing ring and copied
+ * from there into the message, not written straight into the requester's
+ * DSM page: DSM regions are not registered with the device.
+ *
+ * @return Backend operations, or NULL if built without DSM_HAVE_RDMA
+ *         (make RDMA=1) or no device is usable
+ */
+const transport_ops_t *rdma_transport_open(void);
+
+/**
+ * Place the next RDMA write of len bytes in a landing ring
+ * Sender and receiver both call this for every write, in order, so they
+ * agree on where it lands without sending the offset. Writes start on a
+ * page boundary and never wrap: one that does not fit before the end of
+ * the ring skips to its start.
+ *
+ * @param pos Ring position (counts up forever), advanced past the write
+ * @param len Bytes written (at most ring_size)
+ * @param ring_size Ring bytes, a multiple of PAGE_SIZE
+ * @return Offset in the ring the write starts at
+ */
+size_t rdma_landing_place(uint64_t *pos, size_t len, size_t ring_size);
+
+/**
+ * Open the shared-memory backend for peers on the same host
+ *
+ * @return Backend operations, or NULL if the kernel boot ID is unreadable
+ */
+const transport_ops_t *shm_transport_open(void);
+
+#endif /* TRANSPORT_H */
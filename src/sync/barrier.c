@@ -4,14 +4,30 @@
  *
  * Implements centralized barrier synchronization using the manager node.
  * Each node sends BARRIER_ARRIVE to the manager, which broadcasts
- * BARRIER_RELEASE when all participants have arrived.
+ * BARRIER_RELEASE when all participants have arrived. Releases go through
+ * the per-node send queues, so the manager does not write to N sockets in
+ * turn before handling the next message.
+ *
+ * With DSM_BARRIER_DISSEMINATION, barriers of the whole cluster skip the
+ * manager: in ceil(log2 N) rounds each node signals one other, over links
+ * between workers, so no node handles more than one message per round.
+ *
+ * Collectives (dsm_allreduce(), dsm_reduce(), dsm_broadcast()) are barrier
+ * episodes whose arrivals carry contributions as bulk data. The manager
+ * combines each one as it arrives and the release carries the result, so
+ * a collective costs one barrier round and no page faults.
  */
 
 #include "barrier.h"
 #include "dsm/dsm.h"
 #include "../core/dsm_context.h"
+#include "../core/stats.h"
+#include "../core/trace.h"
+#include "../core/perf_log.h"
 #include "../core/log.h"
 #include "../network/handlers.h"
+#include "../consistency/prefetch.h"
+#include "../consistency/release_consistency.h"
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -20,6 +36,30 @@
 /* Timeout for barrier wait (30 seconds) */
 #define BARRIER_TIMEOUT_SEC 30
 
+/* ============================ */
+/*       Barrier Index          */
+/* ============================ */
+
+static size_t barrier_bucket(barrier_id_t barrier_id) {
+    /* Fibonacci hashing: consecutive IDs spread over the buckets */
+    return (size_t)((barrier_id * 11400714819323198485ULL) >> 56) % BARRIER_HASH_BUCKETS;
+}
+
+dsm_barrier_t* barrier_index_find(barrier_manager_t *mgr, barrier_id_t barrier_id) {
+    for (dsm_barrier_t *b = mgr->buckets[barrier_bucket(barrier_id)]; b; b = b->hash_next) {
+        if (b->id == barrier_id && b->expected_count > 0) {
+            return b;
+        }
+    }
+    return NULL;
+}
+
+void barrier_index_insert(barrier_manager_t *mgr, dsm_barrier_t *barrier) {
+    size_t bucket = barrier_bucket(barrier->id);
+    barrier->hash_next = mgr->buckets[bucket];
+    mgr->buckets[bucket] = barrier;
+}
+
 /**
  * Find or create barrier by ID
  */
@@ -28,46 +68,456 @@ static dsm_barrier_t* find_or_create_barrier(barrier_id_t barrier_id, int num_pa
 
     pthread_mutex_lock(&ctx->barrier_mgr.lock);
 
-    /* Search for existing barrier */
-    for (int i = 0; i < ctx->barrier_mgr.max_barriers; i++) {
-        dsm_barrier_t *b = &ctx->barrier_mgr.barriers[i];
-        if (b->id == barrier_id && b->expected_count > 0) {
-            pthread_mutex_unlock(&ctx->barrier_mgr.lock);
-            return b;
-        }
+    dsm_barrier_t *existing = barrier_index_find(&ctx->barrier_mgr, barrier_id);
+    if (existing) {
+        pthread_mutex_unlock(&ctx->barrier_mgr.lock);
+        return existing;
     }
 
-    /* Find empty slot */
-    for (int i = 0; i < ctx->barrier_mgr.max_barriers; i++) {
-        dsm_barrier_t *b = &ctx->barrier_mgr.barriers[i];
-        if (b->expected_count == 0) {
-            /* Initialize barrier */
-            b->id = barrier_id;
-            b->expected_count = num_participants;
-            b->arrived_count = 0;
-            b->generation = 0;
-            pthread_mutex_init(&b->lock, NULL);
-            pthread_cond_init(&b->all_arrived_cv, NULL);
+    int free_slot = -1;
+    for (int i = ctx->barrier_mgr.first_free; i < ctx->barrier_mgr.max_barriers; i++) {
+        if (!ctx->barrier_mgr.barriers[i]) {
+            free_slot = i;
+            break;
+        }
+    }
 
+    /* No free slot: grow the table (barrier addresses stay stable) */
+    if (free_slot == -1) {
+        free_slot = ctx->barrier_mgr.max_barriers;
+        if (dsm_table_grow((void ***)&ctx->barrier_mgr.barriers,
+                           &ctx->barrier_mgr.max_barriers) != DSM_SUCCESS) {
             pthread_mutex_unlock(&ctx->barrier_mgr.lock);
-            LOG_DEBUG("Created barrier %lu (expecting %d participants)",
-                      barrier_id, num_participants);
-            return b;
+            LOG_ERROR("Failed to grow barrier table (%d barriers)", free_slot);
+            return NULL;
         }
     }
 
+    dsm_barrier_t *b = calloc(1, sizeof(dsm_barrier_t));
+    if (b && rc_enabled()) {
+        bool disseminates = ctx->config.barrier_algorithm == DSM_BARRIER_DISSEMINATION;
+        b->notices = calloc(1, sizeof(rc_notices_t));
+        b->released = calloc(1, sizeof(rc_notices_t));
+        b->heard[0] = disseminates ? calloc(1, sizeof(rc_notices_t)) : NULL;
+        b->heard[1] = disseminates ? calloc(1, sizeof(rc_notices_t)) : NULL;
+        if (!b->notices || !b->released || (disseminates && (!b->heard[0] || !b->heard[1]))) {
+            free(b->notices);
+            free(b->released);
+            free(b->heard[0]);
+            free(b->heard[1]);
+            free(b);
+            b = NULL;
+        }
+    }
+    if (!b) {
+        pthread_mutex_unlock(&ctx->barrier_mgr.lock);
+        LOG_ERROR("Failed to allocate barrier %lu", barrier_id);
+        return NULL;
+    }
+
+    /* Initialize barrier */
+    b->id = barrier_id;
+    b->expected_count = num_participants;
+    b->arrived_count = 0;
+    b->generation = 0;
+    pthread_mutex_init(&b->lock, NULL);
+    pthread_cond_init(&b->all_arrived_cv, NULL);
+    ctx->barrier_mgr.barriers[free_slot] = b;
+    ctx->barrier_mgr.first_free = free_slot + 1;
+    barrier_index_insert(&ctx->barrier_mgr, b);
+
     pthread_mutex_unlock(&ctx->barrier_mgr.lock);
-    LOG_ERROR("Barrier manager full (max %d barriers)", ctx->barrier_mgr.max_barriers);
-    return NULL;
+    LOG_DEBUG("Created barrier %lu (expecting %d participants)",
+              barrier_id, num_participants);
+    return b;
+}
+
+/* ============================ */
+/*       Collectives            */
+/* ============================ */
+
+_Static_assert(DSM_COLLECTIVE_MAX_BYTES <= MSG_MAX_BULK_DATA,
+               "a collective's buffer must fit in one bulk frame");
+
+/** Bytes of one element, 0 for an unknown type */
+static size_t datatype_size(dsm_datatype_t type) {
+    switch (type) {
+        case DSM_TYPE_INT32:
+        case DSM_TYPE_UINT32:
+        case DSM_TYPE_FLOAT:  return 4;
+        case DSM_TYPE_INT64:
+        case DSM_TYPE_UINT64:
+        case DSM_TYPE_DOUBLE: return 8;
+        default:              return 0;
+    }
 }
 
+/* Integer sums and products wrap (computed in the unsigned type U) */
+#define REDUCE_LOOP(T, U)                                                   \
+    do {                                                                    \
+        T *a = (T *)acc;                                                    \
+        const T *b = (const T *)in;                                         \
+        for (size_t i = 0; i < count; i++) {                                \
+            switch (op) {                                                   \
+                case DSM_REDUCE_SUM:  a[i] = (T)((U)a[i] + (U)b[i]); break; \
+                case DSM_REDUCE_PROD: a[i] = (T)((U)a[i] * (U)b[i]); break; \
+                case DSM_REDUCE_MIN:  if (b[i] < a[i]) a[i] = b[i]; break;  \
+                case DSM_REDUCE_MAX:  if (b[i] > a[i]) a[i] = b[i]; break;  \
+            }                                                               \
+        }                                                                   \
+    } while (0)
+
 /**
- * Distributed barrier synchronization
+ * Combine count elements of in into acc
+ * Both buffers come from malloc(), so they are aligned for any type.
+ */
+static void reduce_into(void *acc, const void *in, size_t count, dsm_datatype_t type,
+                        dsm_reduce_op_t op) {
+    switch (type) {
+        case DSM_TYPE_INT32:  REDUCE_LOOP(int32_t, uint32_t); break;
+        case DSM_TYPE_INT64:  REDUCE_LOOP(int64_t, uint64_t); break;
+        case DSM_TYPE_UINT32: REDUCE_LOOP(uint32_t, uint32_t); break;
+        case DSM_TYPE_UINT64: REDUCE_LOOP(uint64_t, uint64_t); break;
+        case DSM_TYPE_FLOAT:  REDUCE_LOOP(float, float); break;
+        case DSM_TYPE_DOUBLE: REDUCE_LOOP(double, double); break;
+    }
+}
+
+#undef REDUCE_LOOP
+
+/** Whether a collective from the wire can be combined */
+static bool collective_valid(const barrier_collective_t *collective) {
+    if (collective->kind == COLLECTIVE_NONE || collective->kind == COLLECTIVE_BROADCAST) {
+        return collective->kind == COLLECTIVE_NONE || collective->len <= DSM_COLLECTIVE_MAX_BYTES;
+    }
+    size_t size = datatype_size(collective->type);
+    return (collective->kind == COLLECTIVE_ALLREDUCE || collective->kind == COLLECTIVE_REDUCE) &&
+           size > 0 && collective->len % size == 0 && collective->len <= DSM_COLLECTIVE_MAX_BYTES &&
+           (unsigned)collective->op <= DSM_REDUCE_MAX;
+}
+
+/** Whether two arrivals describe the same collective */
+static bool collective_matches(const barrier_collective_t *a, const barrier_collective_t *b) {
+    if (a->kind != b->kind) {
+        return false;
+    }
+    if (a->kind == COLLECTIVE_NONE) {
+        return true;
+    }
+    bool reduces = a->kind != COLLECTIVE_BROADCAST;
+    return a->len == b->len && (a->kind == COLLECTIVE_ALLREDUCE || a->root == b->root) &&
+           (!reduces || (a->type == b->type && a->op == b->op));
+}
+
+/**
+ * Manager: combine an arrival's contribution into the episode
+ * Caller must hold barrier->lock and have counted the arrival.
  *
- * Blocks until all participating nodes have reached the barrier.
- * All nodes must call with the same barrier_id and num_participants.
+ * @param collective The arrival's collective, NULL for a plain barrier
  */
-int dsm_barrier(barrier_id_t barrier_id, int num_participants) {
+static void merge_collective_locked(dsm_barrier_t *barrier, const barrier_collective_t *collective,
+                                    node_id_t arriver) {
+    static const barrier_collective_t plain = { .kind = COLLECTIVE_NONE };
+    if (!collective) {
+        collective = &plain;
+    }
+    if (barrier->arrived_count == 1) {
+        barrier->collective_failed = false;
+    }
+    if (!collective_valid(collective)) {
+        LOG_ERROR("Barrier %lu: node %u arrived with an invalid collective (kind %d, type %d, op %d, %zu bytes)",
+                  barrier->id, arriver, (int)collective->kind, (int)collective->type,
+                  (int)collective->op, collective->len);
+        barrier->collective_failed = true;
+    }
+    if (barrier->arrived_count == 1) {
+        barrier->collective = *collective;
+        barrier->collective.data = NULL;
+    } else if (!collective_matches(&barrier->collective, collective)) {
+        LOG_ERROR("Barrier %lu: node %u arrived with a different collective (kind %d, %zu bytes)",
+                  barrier->id, arriver, (int)collective->kind, collective->len);
+        barrier->collective_failed = true;
+    }
+    if (barrier->collective_failed || collective->kind == COLLECTIVE_NONE) {
+        return;
+    }
+
+    bool contributes = collective->kind != COLLECTIVE_BROADCAST || arriver == collective->root;
+    if (!contributes) {
+        return;
+    }
+    if (!collective->data) {
+        LOG_ERROR("Barrier %lu: node %u sent no %zu-byte contribution", barrier->id, arriver, collective->len);
+        barrier->collective_failed = true;
+        return;
+    }
+
+    if (!barrier->combined) {
+        barrier->combined = malloc(collective->len);
+        if (!barrier->combined) {
+            LOG_ERROR("Barrier %lu: out of memory for a %zu-byte collective", barrier->id, collective->len);
+            barrier->collective_failed = true;
+            return;
+        }
+        memcpy(barrier->combined, collective->data, collective->len);
+    } else {
+        reduce_into(barrier->combined, collective->data, collective->len / datatype_size(collective->type),
+                    collective->type, collective->op);
+    }
+}
+
+/**
+ * Manager: make the episode's combined contributions the released result
+ * Caller must hold barrier->lock.
+ */
+static void publish_collective_locked(dsm_barrier_t *barrier) {
+    free(barrier->result);
+    barrier->result = NULL;
+    barrier->result_len = 0;
+    barrier->result_failed = barrier->collective_failed;
+    if (barrier->collective.kind != COLLECTIVE_NONE && !barrier->collective_failed) {
+        barrier->result_failed = !barrier->combined;
+        barrier->result = barrier->combined;
+        barrier->result_len = barrier->combined ? barrier->collective.len : 0;
+    } else {
+        free(barrier->combined);
+    }
+    barrier->combined = NULL;
+}
+
+/** Whether a node receives the result of a collective */
+static bool collective_delivers_to(const barrier_collective_t *collective, node_id_t node) {
+    switch (collective->kind) {
+        case COLLECTIVE_ALLREDUCE: return true;
+        case COLLECTIVE_REDUCE:    return node == collective->root;
+        case COLLECTIVE_BROADCAST: return node != collective->root;
+        default:                   return false;
+    }
+}
+
+/**
+ * Copy the last release's collective result to the caller's buffer
+ * Caller must hold barrier->lock.
+ *
+ * @param collective This node's collective, NULL for a plain barrier
+ * @param out Buffer of collective->len bytes
+ * @return DSM_SUCCESS, or DSM_ERROR_INVALID if the participants disagreed
+ */
+static int collective_result_locked(const dsm_barrier_t *barrier, const barrier_collective_t *collective,
+                                    void *out) {
+    if (!collective) {
+        return DSM_SUCCESS;
+    }
+    if (barrier->result_failed) {
+        return DSM_ERROR_INVALID;
+    }
+    if (!collective_delivers_to(collective, dsm_get_context()->node_id)) {
+        return DSM_SUCCESS;
+    }
+    if (!barrier->result || barrier->result_len != collective->len) {
+        LOG_ERROR("Barrier %lu: released %zu collective bytes, expected %zu",
+                  barrier->id, barrier->result_len, collective->len);
+        return DSM_ERROR_INVALID;
+    }
+    memcpy(out, barrier->result, collective->len);
+    return DSM_SUCCESS;
+}
+
+/* ============================ */
+/*       Write Notices          */
+/* ============================ */
+
+/** Notices standing in for a barrier without notice storage */
+static const rc_notices_t all_pages_written = { .overflow = true, .count = 0 };
+
+/**
+ * Manager: add an arrival's write notices to the episode
+ * Caller must hold barrier->lock.
+ */
+static void merge_notices_locked(dsm_barrier_t *barrier, const rc_notices_t *notices) {
+    if (barrier->notices) {
+        rc_notices_merge(barrier->notices, notices->pages, notices->count, notices->overflow);
+    }
+}
+
+/**
+ * Write notices to apply at exit from the last release
+ * Caller must hold barrier->lock.
+ */
+static void released_notices_locked(const dsm_barrier_t *barrier, rc_notices_t *out) {
+    const rc_notices_t *src = barrier->released ? barrier->released : &all_pages_written;
+    out->overflow = src->overflow;
+    out->count = src->count;
+    memcpy(out->pages, src->pages, (size_t)src->count * sizeof(page_id_t));
+}
+
+/**
+ * Release every participant of a barrier whose last arrival just came in
+ * Caller must hold barrier->lock.
+ */
+static void release_barrier_locked(dsm_barrier_t *barrier) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    LOG_DEBUG("Manager: All %d participants arrived at barrier %lu, releasing",
+              barrier->arrived_count, barrier->id);
+
+    /* This episode's notices become the released set; threads that have
+     * not left yet read it before they can arrive again */
+    const rc_notices_t *notices = NULL;
+    if (rc_enabled()) {
+        if (barrier->notices && barrier->released) {
+            rc_notices_t *episode = barrier->notices;
+            barrier->notices = barrier->released;
+            barrier->released = episode;
+            barrier->notices->overflow = false;
+            barrier->notices->count = 0;
+            notices = episode;
+        } else {
+            notices = &all_pages_written;
+        }
+    }
+
+    publish_collective_locked(barrier);
+
+    /* CRITICAL FIX: Broadcast release to all nodes
+     * Must iterate through ALL slots (max_nodes), not just num_nodes count,
+     * because nodes are indexed by their node_id, not sequentially */
+    for (int i = 0; i < ctx->network.max_nodes; i++) {
+        if (ctx->network.nodes[i].connected && ctx->network.nodes[i].id != ctx->node_id) {
+            node_id_t node = ctx->network.nodes[i].id;
+            bool delivers = barrier->result && collective_delivers_to(&barrier->collective, node);
+            send_barrier_release(node, barrier->id, notices, delivers ? barrier->result : NULL,
+                                 delivers ? barrier->result_len : 0, barrier->result_failed);
+        }
+    }
+
+    /* CRITICAL FIX: Increment generation BEFORE resetting count
+     * This prevents race where fast nodes re-enter before others leave
+     * Based on sense-reversal barrier best practices */
+    barrier->generation++;
+
+    /* Reset barrier for reuse */
+    barrier->arrived_count = 0;
+
+    /* Wake up local threads */
+    pthread_cond_broadcast(&barrier->all_arrived_cv);
+}
+
+/* ============================ */
+/*     Dissemination            */
+/* ============================ */
+
+/**
+ * Whether an episode runs as a dissemination barrier
+ * Every node decides the same way: collectives, and barriers of part of
+ * the cluster, go through the manager.
+ */
+static bool barrier_disseminates(int num_participants, const barrier_collective_t *collective) {
+    dsm_context_t *ctx = dsm_get_context();
+    return ctx->config.barrier_algorithm == DSM_BARRIER_DISSEMINATION && !collective &&
+           num_participants == ctx->config.num_nodes && num_participants > 1;
+}
+
+/**
+ * Move the notices heard for an episode into this node's set
+ * Caller must hold barrier->lock.
+ */
+static void take_heard_locked(dsm_barrier_t *barrier, int parity, rc_notices_t *notices) {
+    rc_notices_t *heard = barrier->heard[parity];
+    if (!heard) {
+        return;
+    }
+    rc_notices_merge(notices, heard->pages, heard->count, heard->overflow);
+    heard->overflow = false;
+    heard->count = 0;
+}
+
+/**
+ * Run one episode of a dissemination barrier
+ *
+ * In round k node i signals node (i + 2^k) mod N and waits for the signal
+ * of node (i - 2^k) mod N. After ceil(log2 N) rounds every node has heard,
+ * directly or not, from every other one. Each signal carries the write
+ * notices heard so far, so notices ends up holding the union of all of them.
+ *
+ * @param notices This node's write notices; receives the episode's union
+ */
+static int dissemination_wait(dsm_barrier_t *barrier, rc_notices_t *notices) {
+    dsm_context_t *ctx = dsm_get_context();
+    int num_nodes = ctx->config.num_nodes;
+
+    struct timespec timeout;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec += BARRIER_TIMEOUT_SEC;
+
+    pthread_mutex_lock(&barrier->lock);
+    int parity = barrier->generation & 1;
+    for (int round = 0; round < BARRIER_MAX_ROUNDS && (1LL << round) < num_nodes; round++) {
+        int step = 1 << round;
+        node_id_t to = (node_id_t)((ctx->node_id + step) % num_nodes);
+        node_id_t from = (node_id_t)((ctx->node_id + num_nodes - step) % num_nodes);
+
+        take_heard_locked(barrier, parity, notices);
+        pthread_mutex_unlock(&barrier->lock);
+        int rc = send_barrier_signal(to, barrier->id, round, parity, rc_enabled() ? notices : NULL);
+        pthread_mutex_lock(&barrier->lock);
+        if (rc != DSM_SUCCESS) {
+            pthread_mutex_unlock(&barrier->lock);
+            return rc;
+        }
+
+        while (!(barrier->signals[parity] & (1u << round))) {
+            rc = pthread_cond_timedwait(&barrier->all_arrived_cv, &barrier->lock, &timeout);
+            if (rc == ETIMEDOUT) {
+                pthread_mutex_unlock(&barrier->lock);
+                LOG_ERROR("Barrier %lu timeout in round %d, waiting for node %u (gen=%d)",
+                          barrier->id, round, from, barrier->generation);
+                return DSM_ERROR_TIMEOUT;
+            }
+        }
+        barrier->signals[parity] &= ~(1u << round);
+    }
+
+    /* A barrier adopted at failover keeps no notices: drop every copy */
+    take_heard_locked(barrier, parity, notices);
+    if (rc_enabled() && !barrier->heard[parity]) {
+        notices->overflow = true;
+    }
+    barrier->generation++;
+    pthread_mutex_unlock(&barrier->lock);
+    return DSM_SUCCESS;
+}
+
+/**
+ * Handle one round's signal of a dissemination barrier
+ * Signals can come in before this node enters the barrier.
+ */
+int barrier_handle_signal(barrier_id_t barrier_id, int round, int parity, const rc_notices_t *notices) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    dsm_barrier_t *barrier = find_or_create_barrier(barrier_id, ctx->config.num_nodes);
+    if (!barrier) {
+        return DSM_ERROR_MEMORY;
+    }
+
+    pthread_mutex_lock(&barrier->lock);
+    if (barrier->heard[parity]) {
+        rc_notices_merge(barrier->heard[parity], notices->pages, notices->count, notices->overflow);
+    }
+    barrier->signals[parity] |= 1u << round;
+    pthread_cond_broadcast(&barrier->all_arrived_cv);
+    pthread_mutex_unlock(&barrier->lock);
+    return DSM_SUCCESS;
+}
+
+/**
+ * Wait at a barrier, taking part in its collective if one is given
+ *
+ * @param collective This node's collective, NULL for a plain barrier
+ * @param out Receives the collective's result, if this node gets one
+ */
+static int barrier_wait(barrier_id_t barrier_id, int num_participants,
+                        const barrier_collective_t *collective, void *out) {
     dsm_context_t *ctx = dsm_get_context();
     if (!ctx->initialized) {
         LOG_ERROR("DSM not initialized");
@@ -81,46 +531,50 @@ int dsm_barrier(barrier_id_t barrier_id, int num_participants) {
 
     LOG_DEBUG("Node %u entering barrier %lu (expecting %d participants)",
               ctx->node_id, barrier_id, num_participants);
+    uint64_t start_ns = perf_get_timestamp_ns();
+
+    /* Release consistency: push diffs home before arriving. The barrier
+     * completes even if a diff was lost, and the error is returned */
+    int flush_rc = rc_release();
 
     dsm_barrier_t *barrier = find_or_create_barrier(barrier_id, num_participants);
     if (!barrier) {
         return DSM_ERROR_MEMORY;
     }
 
-    /* If this is the manager node, handle locally */
-    if (ctx->config.is_manager) {
+    /* Write notices go out with the arrival; the same buffer then receives
+     * the released notices to apply at exit */
+    rc_notices_t notices;
+    notices.overflow = false;
+    notices.count = 0;
+    int collective_rc = DSM_SUCCESS;
+    if (rc_enabled()) {
+        rc_take_notices(&notices);
+        STATS_ADD(write_notices_sent, notices.count);
+    }
+
+    if (barrier_disseminates(num_participants, collective)) {
+        /* Signals between the nodes, without the manager */
+        int rc = dissemination_wait(barrier, &notices);
+        if (rc != DSM_SUCCESS) {
+            return rc;
+        }
+    } else if (ctx->config.is_manager) {
+        /* If this is the manager node, handle locally */
         pthread_mutex_lock(&barrier->lock);
 
         int my_generation = barrier->generation;
         barrier->arrived_count++;
+        merge_notices_locked(barrier, &notices);
+        merge_collective_locked(barrier, collective, ctx->node_id);
 
         LOG_DEBUG("Manager: barrier %lu arrived_count=%d/%d (gen=%d)",
                   barrier_id, barrier->arrived_count, barrier->expected_count, my_generation);
 
         if (barrier->arrived_count >= barrier->expected_count) {
-            /* All participants arrived, release everyone */
-            LOG_INFO("Manager: All %d participants arrived at barrier %lu, releasing",
-                     barrier->arrived_count, barrier_id);
-
-            /* CRITICAL FIX: Broadcast release to all nodes
-             * Must iterate through ALL slots (MAX_NODES), not just num_nodes count,
-             * because nodes are indexed by their node_id, not sequentially */
-            for (int i = 0; i < MAX_NODES; i++) {
-                if (ctx->network.nodes[i].connected && ctx->network.nodes[i].id != ctx->node_id) {
-                    send_barrier_release(ctx->network.nodes[i].id, barrier_id);
-                }
-            }
-
-            /* CRITICAL FIX: Increment generation BEFORE resetting count
-             * This prevents race where fast nodes re-enter before others leave
-             * Based on sense-reversal barrier best practices */
-            barrier->generation++;
-
-            /* Reset barrier for reuse */
-            barrier->arrived_count = 0;
-
-            /* Wake up local threads */
-            pthread_cond_broadcast(&barrier->all_arrived_cv);
+            release_barrier_locked(barrier);
+            released_notices_locked(barrier, &notices);
+            collective_rc = collective_result_locked(barrier, collective, out);
             pthread_mutex_unlock(&barrier->lock);
         } else {
             /* Wait for all to arrive (check for generation change) */
@@ -138,6 +592,8 @@ int dsm_barrier(barrier_id_t barrier_id, int num_participants) {
                 }
             }
 
+            released_notices_locked(barrier, &notices);
+            collective_rc = collective_result_locked(barrier, collective, out);
             pthread_mutex_unlock(&barrier->lock);
         }
     } else {
@@ -147,7 +603,8 @@ int dsm_barrier(barrier_id_t barrier_id, int num_participants) {
         pthread_mutex_unlock(&barrier->lock);
 
         node_id_t manager = 0;  /* Manager is always node 0 */
-        int rc = send_barrier_arrive(manager, barrier_id, num_participants);
+        int rc = send_barrier_arrive(manager, barrier_id, num_participants,
+                                     rc_enabled() ? &notices : NULL, collective);
         if (rc != DSM_SUCCESS) {
             LOG_ERROR("Failed to send barrier arrive");
             return rc;
@@ -169,22 +626,110 @@ int dsm_barrier(barrier_id_t barrier_id, int num_participants) {
             }
         }
 
+        released_notices_locked(barrier, &notices);
+        collective_rc = collective_result_locked(barrier, collective, out);
         pthread_mutex_unlock(&barrier->lock);
     }
 
     /* Update statistics */
-    pthread_mutex_lock(&ctx->stats_lock);
-    ctx->stats.barrier_waits++;
-    pthread_mutex_unlock(&ctx->stats_lock);
+    STATS_INC(barrier_waits);
+    rc_acquire_notices(&notices);
+    if (ctx->config.adaptive && !rc_enabled()) {
+        /* Read-mostly pages written during the phase are fetched again */
+        prefetch_replicas();
+    }
+    trace_event(TRACE_BARRIER, barrier_id, TRACE_ACCESS_NONE,
+                perf_get_timestamp_ns() - start_ns, 0, TRACE_NODE_NONE);
 
     LOG_DEBUG("Node %u passed barrier %lu", ctx->node_id, barrier_id);
-    return DSM_SUCCESS;
+    return flush_rc != DSM_SUCCESS ? flush_rc : collective_rc;
+}
+
+/**
+ * Distributed barrier synchronization
+ *
+ * Blocks until all participating nodes have reached the barrier.
+ * All nodes must call with the same barrier_id and num_participants.
+ */
+int dsm_barrier(barrier_id_t barrier_id, int num_participants) {
+    return barrier_wait(barrier_id, num_participants, NULL, NULL);
+}
+
+/**
+ * Run one collective as an episode of DSM_BARRIER_REDUCE
+ */
+static int run_collective(collective_kind_t kind, void *buf, size_t len, dsm_datatype_t type,
+                          dsm_reduce_op_t op, node_id_t root) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (!ctx->initialized) {
+        LOG_ERROR("DSM not initialized");
+        return DSM_ERROR_INIT;
+    }
+    if (!buf || len == 0 || len > DSM_COLLECTIVE_MAX_BYTES ||
+        (kind != COLLECTIVE_ALLREDUCE && root >= (node_id_t)ctx->config.num_nodes)) {
+        LOG_ERROR("Invalid collective: %zu bytes (max %d), root %u of %d nodes",
+                  len, DSM_COLLECTIVE_MAX_BYTES, root, ctx->config.num_nodes);
+        return DSM_ERROR_INVALID;
+    }
+
+    /* A single node already holds the result */
+    int rc = DSM_SUCCESS;
+    if (ctx->config.num_nodes > 1) {
+        barrier_collective_t collective = {
+            .kind = kind,
+            .type = type,
+            .op = op,
+            .root = root,
+            .len = len,
+            .data = kind != COLLECTIVE_BROADCAST || ctx->node_id == root ? buf : NULL
+        };
+        rc = barrier_wait(DSM_BARRIER_REDUCE, ctx->config.num_nodes, &collective, buf);
+    }
+    if (rc == DSM_SUCCESS) {
+        STATS_INC(collectives);
+        STATS_ADD(collective_bytes, len);
+    }
+    return rc;
+}
+
+/**
+ * Bytes of a reduction's buffer, 0 for invalid arguments
+ */
+static size_t reduction_len(size_t count, dsm_datatype_t type, dsm_reduce_op_t op) {
+    size_t size = datatype_size(type);
+    if (size == 0 || (unsigned)op > DSM_REDUCE_MAX || count > DSM_COLLECTIVE_MAX_BYTES / size) {
+        return 0;
+    }
+    return count * size;
+}
+
+int dsm_allreduce(void *buf, size_t count, dsm_datatype_t type, dsm_reduce_op_t op) {
+    size_t len = reduction_len(count, type, op);
+    if (len == 0) {
+        LOG_ERROR("dsm_allreduce: invalid count %zu, type %d or op %d", count, (int)type, (int)op);
+        return DSM_ERROR_INVALID;
+    }
+    return run_collective(COLLECTIVE_ALLREDUCE, buf, len, type, op, 0);
+}
+
+int dsm_reduce(void *buf, size_t count, dsm_datatype_t type, dsm_reduce_op_t op, node_id_t root) {
+    size_t len = reduction_len(count, type, op);
+    if (len == 0) {
+        LOG_ERROR("dsm_reduce: invalid count %zu, type %d or op %d", count, (int)type, (int)op);
+        return DSM_ERROR_INVALID;
+    }
+    return run_collective(COLLECTIVE_REDUCE, buf, len, type, op, root);
+}
+
+int dsm_broadcast(void *buf, size_t len, node_id_t root) {
+    return run_collective(COLLECTIVE_BROADCAST, buf, len, DSM_TYPE_INT32, DSM_REDUCE_SUM, root);
 }
 
 /**
  * Manager-side: Handle barrier arrival from a node
  */
-int barrier_manager_arrive(barrier_id_t barrier_id, node_id_t arriver, int num_participants) {
+int barrier_manager_arrive(barrier_id_t barrier_id, node_id_t arriver, int num_participants,
+                           const rc_notices_t *notices, const barrier_collective_t *collective) {
     dsm_context_t *ctx = dsm_get_context();
 
     dsm_barrier_t *barrier = find_or_create_barrier(barrier_id, num_participants);
@@ -195,6 +740,8 @@ int barrier_manager_arrive(barrier_id_t barrier_id, node_id_t arriver, int num_p
     pthread_mutex_lock(&barrier->lock);
 
     barrier->arrived_count++;
+    merge_notices_locked(barrier, notices);
+    merge_collective_locked(barrier, collective, arriver);
     LOG_DEBUG("Manager: Node %u arrived at barrier %lu (count=%d/%d)",
               arriver, barrier_id, barrier->arrived_count, barrier->expected_count);
 
@@ -204,35 +751,13 @@ int barrier_manager_arrive(barrier_id_t barrier_id, node_id_t arriver, int num_p
     uint64_t generation_copy = barrier->generation;
 
     if (barrier->arrived_count >= barrier->expected_count) {
-        /* All participants arrived, release everyone */
-        LOG_INFO("Manager: All %d participants arrived at barrier %lu, releasing",
-                 barrier->arrived_count, barrier_id);
-
-        /* Broadcast release to all nodes (including the one that just arrived) */
-        /* CRITICAL FIX: Use MAX_NODES not num_nodes, since nodes are indexed by node_id
-         * not sequentially. If node_id=1 but num_nodes=1, loop would only check index 0. */
-        for (int i = 0; i < MAX_NODES; i++) {
-            if (ctx->network.nodes[i].connected && ctx->network.nodes[i].id != ctx->node_id) {
-                send_barrier_release(ctx->network.nodes[i].id, barrier_id);
-            }
-        }
-
-        /* CRITICAL FIX: Increment generation BEFORE resetting count
-         * This prevents race where fast nodes re-enter before others leave
-         * Based on sense-reversal barrier best practices */
-        barrier->generation++;
-
-        /* Reset barrier for reuse */
-        barrier->arrived_count = 0;
+        release_barrier_locked(barrier);
 
         /* Capture state for replication after release */
         int arrived_after = barrier->arrived_count;
         int expected_after = barrier->expected_count;
         uint64_t generation_after = barrier->generation;
 
-        /* Wake up any local threads waiting on this barrier */
-        pthread_cond_broadcast(&barrier->all_arrived_cv);
-
         pthread_mutex_unlock(&barrier->lock);
 
         /* Replicate barrier state to backup (after release) */
@@ -256,21 +781,14 @@ int barrier_manager_arrive(barrier_id_t barrier_id, node_id_t arriver, int num_p
 /**
  * Client-side: Handle barrier release from manager
  */
-int barrier_handle_release(barrier_id_t barrier_id) {
+int barrier_handle_release(barrier_id_t barrier_id, const rc_notices_t *notices,
+                           const uint8_t *result, size_t result_len, bool collective_failed) {
     dsm_context_t *ctx = dsm_get_context();
 
     /* Find the barrier */
     pthread_mutex_lock(&ctx->barrier_mgr.lock);
 
-    dsm_barrier_t *barrier = NULL;
-    for (int i = 0; i < ctx->barrier_mgr.max_barriers; i++) {
-        dsm_barrier_t *b = &ctx->barrier_mgr.barriers[i];
-        if (b->id == barrier_id && b->expected_count > 0) {
-            barrier = b;
-            break;
-        }
-    }
-
+    dsm_barrier_t *barrier = barrier_index_find(&ctx->barrier_mgr, barrier_id);
     pthread_mutex_unlock(&ctx->barrier_mgr.lock);
 
     if (!barrier) {
@@ -280,6 +798,29 @@ int barrier_handle_release(barrier_id_t barrier_id) {
 
     pthread_mutex_lock(&barrier->lock);
 
+    /* Waiting threads apply these at exit, before they can arrive again */
+    if (barrier->released) {
+        barrier->released->overflow = false;
+        barrier->released->count = 0;
+        rc_notices_merge(barrier->released, notices->pages, notices->count, notices->overflow);
+    }
+
+    /* Likewise the collective's result */
+    free(barrier->result);
+    barrier->result = NULL;
+    barrier->result_len = 0;
+    barrier->result_failed = collective_failed;
+    if (result && result_len > 0) {
+        barrier->result = malloc(result_len);
+        if (barrier->result) {
+            memcpy(barrier->result, result, result_len);
+            barrier->result_len = result_len;
+        } else {
+            LOG_ERROR("Barrier %lu: out of memory for a %zu-byte result", barrier_id, result_len);
+            barrier->result_failed = true;
+        }
+    }
+
     /* Increment generation to signal release and wake up waiting threads */
     barrier->generation++;
     pthread_cond_broadcast(&barrier->all_arrived_cv);
@@ -7,27 +7,86 @@
 #define BARRIER_H
 
 #include "dsm/types.h"
+#include "../network/protocol.h"
 #include <pthread.h>
+#include <stddef.h>
+
+struct rc_notices_s;
+
+/** Buckets of the barrier manager's ID index */
+#define BARRIER_HASH_BUCKETS 256
+
+/** Most rounds of a dissemination barrier (one bit each in dsm_barrier_t.signals) */
+#define BARRIER_MAX_ROUNDS 32
+
+/**
+ * Collective an arrival takes part in
+ * Every participant passes the same kind, type, op, root and len.
+ */
+typedef struct barrier_collective_s {
+    collective_kind_t kind;   /**< COLLECTIVE_NONE for a plain barrier */
+    dsm_datatype_t type;      /**< Element type of a reduction */
+    dsm_reduce_op_t op;       /**< Combining operation of a reduction */
+    node_id_t root;           /**< Root of a reduce or broadcast */
+    size_t len;               /**< Bytes of the buffer */
+    const void *data;         /**< This arrival's contribution (NULL for a broadcast's non-root) */
+} barrier_collective_t;
 
 /**
  * Barrier state structure
  */
-typedef struct {
+typedef struct dsm_barrier_s {
     barrier_id_t id;
     int expected_count;
     int arrived_count;
     int generation;           /* Sense-reversing barrier generation */
     pthread_mutex_t lock;
     pthread_cond_t all_arrived_cv;
+    struct dsm_barrier_s *hash_next; /**< Next barrier in the same index bucket */
+    /* Write notices (release consistency only). NULL for a barrier adopted
+     * at failover, whose releases then invalidate every cached copy */
+    struct rc_notices_s *notices;  /**< Manager: union of this episode's arrivals */
+    struct rc_notices_s *released; /**< Notices of the last release, read at exit */
+    /* Collective data (dsm_allreduce(), dsm_reduce(), dsm_broadcast()) */
+    barrier_collective_t collective; /**< Manager: the episode's collective, from its first arrival */
+    bool collective_failed;   /**< Manager: arrivals disagreed on the collective */
+    uint8_t *combined;        /**< Manager: contributions combined so far (NULL before the first) */
+    uint8_t *result;          /**< Collective result of the last release, read at exit */
+    size_t result_len;        /**< Bytes of result */
+    bool result_failed;       /**< The last release's collective failed */
+    /* Dissemination rounds (DSM_BARRIER_DISSEMINATION). A neighbour can be
+     * one episode ahead, so signals are kept by episode parity */
+    uint32_t signals[2];      /**< Rounds signalled but not yet waited for, one bit each */
+    struct rc_notices_s *heard[2]; /**< Write notices those signals carried (release consistency only) */
 } dsm_barrier_t;
 
 /**
  * Barrier manager (for centralized coordination)
+ *
+ * Applications such as Game of Life use a new barrier ID per iteration,
+ * so barriers are found through a hash index on their ID rather than by
+ * scanning every barrier ever created.
  */
 typedef struct {
-    dsm_barrier_t *barriers;
-    int max_barriers;
+    dsm_barrier_t **barriers;  /**< Growable slot array (NULL = never used) */
+    int max_barriers;          /**< Slots in barriers */
+    int first_free;            /**< No slot below this one is free (slots are only freed at cleanup) */
+    dsm_barrier_t *buckets[BARRIER_HASH_BUCKETS]; /**< ID index over barriers */
     pthread_mutex_t lock;
 } barrier_manager_t;
 
+/**
+ * Find a barrier by ID
+ * Caller must hold mgr->lock.
+ *
+ * @return The barrier, or NULL if none with this ID exists
+ */
+dsm_barrier_t* barrier_index_find(barrier_manager_t *mgr, barrier_id_t barrier_id);
+
+/**
+ * Add a barrier to the ID index
+ * Caller must hold mgr->lock; the barrier must also be in a slot of barriers.
+ */
+void barrier_index_insert(barrier_manager_t *mgr, dsm_barrier_t *barrier);
+
 #endif /* BARRIER_H */
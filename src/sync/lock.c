@@ -2,15 +2,41 @@
  * @file lock.c
  * @brief Distributed lock implementation (Day 9, Task 9.1-9.2)
  *
- * Implements a centralized distributed lock using the manager node.
- * Lock requests are sent to the manager, which grants locks in FIFO order.
+ * Implements a token lock directed by the manager node. Each lock has one
+ * token; the node holding it may enter the critical section and keeps it
+ * after release, so a node re-acquiring a lock nobody else asked for
+ * sends no messages. Requests for a token held elsewhere are queued at
+ * the manager in FIFO order and the holder is recalled: it returns the
+ * token (LOCK_RELEASE) as soon as no thread of its own is inside, and the
+ * manager passes it straight on to the next waiter. A grant tells the
+ * grantee whether others already wait, so the token then comes back on the
+ * first release without a separate recall.
+ *
+ * Reader-writer locks (dsm_rwlock_t) use the same token in two modes. The
+ * manager grants a shared token to any number of readers; a writer's
+ * request recalls all of them and is granted once the last reader is
+ * back. Readers queued behind a writer are granted together when it
+ * releases, and readers arriving while a writer waits queue behind it.
+ *
+ * All lock messages are sent with local_lock held, so the grants, recalls
+ * and releases of one lock leave each node in the order they were decided.
+ *
+ * Ranges bound to a lock (dsm_lock_bind()) are fetched as soon as a fresh
+ * token arrives, with one PAGE_BATCH_REQUEST per owner, instead of one
+ * fault each once the critical section touches them.
  */
 
 #include "lock.h"
 #include "dsm/dsm.h"
 #include "../core/dsm_context.h"
+#include "../core/stats.h"
+#include "../core/trace.h"
+#include "../core/perf_log.h"
 #include "../core/log.h"
 #include "../network/handlers.h"
+#include "../consistency/release_consistency.h"
+#include "../memory/page_index.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -43,10 +69,24 @@ dsm_lock_t* dsm_lock_create(lock_id_t lock_id) {
 
     /* Initialize lock fields */
     lock->id = lock_id;
-    lock->holder = (node_id_t)-1;  /* -1 means no holder */
+    lock->holder = DSM_NODE_NONE;  /* Token free at the manager */
     lock->state = LOCK_STATE_FREE;
     lock->waiters_head = NULL;
     lock->waiters_tail = NULL;
+    lock->readers_head = NULL;
+    lock->num_readers = 0;
+    lock->recall_sent = false;
+    lock->has_token = false;
+    lock->shared = false;
+    lock->in_use = false;
+    lock->readers_in = 0;
+    lock->requested = false;
+    lock->recalled = false;
+    lock->fresh = false;
+    lock->syncing = false;
+    lock->num_waiting = 0;
+    lock->writers_waiting = 0;
+    lock->num_bindings = 0;
 
     /* Initialize synchronization primitives */
     pthread_mutex_init(&lock->local_lock, NULL);
@@ -57,10 +97,10 @@ dsm_lock_t* dsm_lock_create(lock_id_t lock_id) {
 
     /* Find empty slot */
     int slot = -1;
-    for (int i = 0; i < 256; i++) {
+    for (int i = 0; i < ctx->lock_mgr.capacity; i++) {
         if (ctx->lock_mgr.locks[i] == NULL) {
-            slot = i;
-            break;
+            if (slot == -1) slot = i;
+            continue;
         }
         /* Check if lock with this ID already exists */
         if (ctx->lock_mgr.locks[i]->id == lock_id) {
@@ -73,13 +113,17 @@ dsm_lock_t* dsm_lock_create(lock_id_t lock_id) {
         }
     }
 
+    /* No free slot: grow the table */
     if (slot == -1) {
-        LOG_ERROR("Lock manager full (max 256 locks)");
-        pthread_mutex_unlock(&ctx->lock_mgr.lock);
-        pthread_mutex_destroy(&lock->local_lock);
-        pthread_cond_destroy(&lock->acquired_cv);
-        free(lock);
-        return NULL;
+        slot = ctx->lock_mgr.capacity;
+        if (dsm_table_grow((void ***)&ctx->lock_mgr.locks, &ctx->lock_mgr.capacity) != DSM_SUCCESS) {
+            LOG_ERROR("Failed to grow lock table (%d locks)", slot);
+            pthread_mutex_unlock(&ctx->lock_mgr.lock);
+            pthread_mutex_destroy(&lock->local_lock);
+            pthread_cond_destroy(&lock->acquired_cv);
+            free(lock);
+            return NULL;
+        }
     }
 
     ctx->lock_mgr.locks[slot] = lock;
@@ -98,7 +142,7 @@ static dsm_lock_t* find_lock_by_id(lock_id_t lock_id) {
 
     pthread_mutex_lock(&ctx->lock_mgr.lock);
     dsm_lock_t *lock = NULL;
-    for (int i = 0; i < 256; i++) {
+    for (int i = 0; i < ctx->lock_mgr.capacity; i++) {
         if (ctx->lock_mgr.locks[i] && ctx->lock_mgr.locks[i]->id == lock_id) {
             lock = ctx->lock_mgr.locks[i];
             break;
@@ -109,13 +153,332 @@ static dsm_lock_t* find_lock_by_id(lock_id_t lock_id) {
     return lock;
 }
 
+/* ============================ */
+/*       Token Directory        */
+/* ============================ */
+
+static int token_take_locked(dsm_lock_t *lock, lock_mode_t mode, bool recall);
+static int token_recall_locked(dsm_lock_t *lock);
+
+static bool is_self(node_id_t node) {
+    return node == dsm_get_context()->node_id;
+}
+
 /**
- * Acquire a distributed lock
+ * Replicate a lock's directory state to the backup
+ */
+static void directory_sync_locked(dsm_lock_t *lock) {
+    node_id_t readers[MAX_SHARERS];
+    int num_readers = 0;
+    for (lock_waiter_t *r = lock->readers_head; r && num_readers < MAX_SHARERS; r = r->next) {
+        readers[num_readers++] = r->node_id;
+    }
+
+    node_id_t waiters[MAX_SHARERS];
+    int num_waiters = 0;
+    for (lock_waiter_t *w = lock->waiters_head; w && num_waiters < MAX_SHARERS; w = w->next) {
+        waiters[num_waiters++] = w->node_id |
+                                 (w->mode == LOCK_MODE_SHARED ? LOCK_SYNC_SHARED_WAITER : 0);
+    }
+    send_state_sync_lock(lock->id, lock->holder, readers, num_readers, waiters, num_waiters);
+}
+
+/**
+ * Hand a granted token to its node
+ * If others already wait, the grantee is told to return it on release.
+ */
+static int directory_send_grant_locked(dsm_lock_t *lock, node_id_t grantee, lock_mode_t mode) {
+    LOG_DEBUG("Manager granted lock %lu to node %u (mode=%d, recall=%d)",
+              lock->id, grantee, mode, lock->recall_sent);
+    if (is_self(grantee)) {
+        return token_take_locked(lock, mode, lock->recall_sent);
+    }
+    return send_lock_grant(grantee, lock->id, mode, lock->recall_sent);
+}
+
+/**
+ * Pass the token to a node exclusively
+ */
+static int directory_grant_locked(dsm_lock_t *lock, node_id_t grantee) {
+    lock->holder = grantee;
+    lock->state = LOCK_STATE_HELD;
+    lock->recall_sent = lock->waiters_head != NULL;
+    directory_sync_locked(lock);
+    return directory_send_grant_locked(lock, grantee, LOCK_MODE_EXCLUSIVE);
+}
+
+/**
+ * Record a node as holding the token shared
+ * The caller replicates the state and sends the grant.
+ */
+static void directory_add_reader_locked(dsm_lock_t *lock, lock_waiter_t *reader) {
+    reader->mode = LOCK_MODE_SHARED;
+    reader->next = lock->readers_head;
+    lock->readers_head = reader;
+    lock->num_readers++;
+    lock->state = LOCK_STATE_SHARED;
+}
+
+/**
+ * No node holds the token any more: pass it to the head of the queue
+ * A run of readers at the head is granted the token shared in one batch.
+ */
+static int directory_grant_next_locked(dsm_lock_t *lock) {
+    lock_waiter_t *head = lock->waiters_head;
+    if (!head) {
+        lock->state = LOCK_STATE_FREE;
+        lock->holder = DSM_NODE_NONE;
+        lock->recall_sent = false;
+        directory_sync_locked(lock);
+
+        LOG_DEBUG("Manager released lock %lu (no waiters)", lock->id);
+        return DSM_SUCCESS;
+    }
+
+    if (head->mode == LOCK_MODE_EXCLUSIVE) {
+        lock->waiters_head = head->next;
+        if (!lock->waiters_head) {
+            lock->waiters_tail = NULL;
+        }
+        node_id_t next_holder = head->node_id;
+        free(head);
+        return directory_grant_locked(lock, next_holder);
+    }
+
+    /* Grantees are collected first: a token taken here may come straight
+     * back and change the lists while the other grants go out */
+    node_id_t grantees[MAX_SHARERS];
+    int num_grantees = 0;
+    while (lock->waiters_head && lock->waiters_head->mode == LOCK_MODE_SHARED &&
+           num_grantees < MAX_SHARERS) {
+        lock_waiter_t *reader = lock->waiters_head;
+        lock->waiters_head = reader->next;
+        grantees[num_grantees++] = reader->node_id;
+        directory_add_reader_locked(lock, reader);
+    }
+    if (!lock->waiters_head) {
+        lock->waiters_tail = NULL;
+    }
+    lock->holder = DSM_NODE_NONE;
+    lock->recall_sent = lock->waiters_head != NULL;
+    directory_sync_locked(lock);
+
+    int result = DSM_SUCCESS;
+    for (int i = 0; i < num_grantees; i++) {
+        int rc = directory_send_grant_locked(lock, grantees[i], LOCK_MODE_SHARED);
+        if (rc != DSM_SUCCESS && result == DSM_SUCCESS) {
+            result = rc;
+        }
+    }
+    return result;
+}
+
+/**
+ * Ask the nodes holding the token to return it, once per grant
+ */
+static int directory_recall_locked(dsm_lock_t *lock) {
+    if (lock->recall_sent) {
+        return DSM_SUCCESS;
+    }
+    lock->recall_sent = true;
+
+    if (lock->state == LOCK_STATE_HELD) {
+        if (is_self(lock->holder)) {
+            return token_recall_locked(lock);
+        }
+        return send_lock_recall(lock->holder, lock->id);
+    }
+
+    /* As for grants: a recall here may return the token at once */
+    node_id_t readers[MAX_SHARERS];
+    int num_readers = 0;
+    for (lock_waiter_t *r = lock->readers_head; r && num_readers < MAX_SHARERS; r = r->next) {
+        readers[num_readers++] = r->node_id;
+    }
+
+    int result = DSM_SUCCESS;
+    for (int i = 0; i < num_readers; i++) {
+        int rc = is_self(readers[i]) ? token_recall_locked(lock) :
+                                       send_lock_recall(readers[i], lock->id);
+        if (rc != DSM_SUCCESS && result == DSM_SUCCESS) {
+            result = rc;
+        }
+    }
+    return result;
+}
+
+/**
+ * Manager: a node asks for the token
  *
- * Blocks until the lock is acquired. Sends LOCK_REQUEST to manager node
- * and waits for LOCK_GRANT response.
+ * A shared request joins the current readers unless a writer already
+ * waits, so writers are not starved by a stream of readers.
  */
-int dsm_lock_acquire(dsm_lock_t *lock) {
+static int directory_request_locked(dsm_lock_t *lock, node_id_t requester, lock_mode_t mode) {
+    if (lock->state == LOCK_STATE_FREE && mode == LOCK_MODE_EXCLUSIVE) {
+        return directory_grant_locked(lock, requester);
+    }
+
+    lock_waiter_t *waiter = (lock_waiter_t*)malloc(sizeof(lock_waiter_t));
+    if (!waiter) {
+        return DSM_ERROR_MEMORY;
+    }
+    waiter->node_id = requester;
+    waiter->mode = mode;
+    waiter->next = NULL;
+
+    if (mode == LOCK_MODE_SHARED &&
+        (lock->state == LOCK_STATE_FREE ||
+         (lock->state == LOCK_STATE_SHARED && !lock->waiters_head))) {
+        directory_add_reader_locked(lock, waiter);
+        directory_sync_locked(lock);
+        return directory_send_grant_locked(lock, requester, LOCK_MODE_SHARED);
+    }
+
+    if (lock->waiters_tail) {
+        lock->waiters_tail->next = waiter;
+        lock->waiters_tail = waiter;
+    } else {
+        lock->waiters_head = lock->waiters_tail = waiter;
+    }
+    directory_sync_locked(lock);
+
+    LOG_DEBUG("Manager queued node %u for lock %lu (mode=%d, state=%d)",
+              requester, lock->id, mode, lock->state);
+    return directory_recall_locked(lock);
+}
+
+/**
+ * Manager: the token comes back from a node holding it
+ */
+static int directory_release_locked(dsm_lock_t *lock, node_id_t releaser) {
+    if (lock->state == LOCK_STATE_HELD && lock->holder == releaser) {
+        lock->holder = DSM_NODE_NONE;
+        return directory_grant_next_locked(lock);
+    }
+
+    if (lock->state == LOCK_STATE_SHARED) {
+        for (lock_waiter_t **r = &lock->readers_head; *r; r = &(*r)->next) {
+            if ((*r)->node_id != releaser) {
+                continue;
+            }
+            lock_waiter_t *reader = *r;
+            *r = reader->next;
+            free(reader);
+            lock->num_readers--;
+
+            if (lock->readers_head) {
+                directory_sync_locked(lock);
+                return DSM_SUCCESS;
+            }
+            return directory_grant_next_locked(lock);
+        }
+    }
+
+    LOG_ERROR("Node %u doesn't hold lock %lu (holder is %u, %d readers)",
+              releaser, lock->id, lock->holder, lock->num_readers);
+    return DSM_ERROR_PERMISSION;
+}
+
+/* ============================ */
+/*       Token on this Node     */
+/* ============================ */
+
+/**
+ * No thread of this node is in the critical section
+ */
+static bool token_idle_locked(const dsm_lock_t *lock) {
+    return !lock->in_use && lock->readers_in == 0;
+}
+
+/**
+ * Give the token back to the manager
+ */
+static int token_return_locked(dsm_lock_t *lock) {
+    dsm_context_t *ctx = dsm_get_context();
+
+    lock->has_token = false;
+    lock->shared = false;
+    lock->recalled = false;
+    lock->fresh = false;
+
+    if (ctx->config.is_manager) {
+        return directory_release_locked(lock, ctx->node_id);
+    }
+
+    node_id_t manager = 0;  /* Manager is always node 0 */
+    int rc = send_lock_release(manager, lock->id);
+    if (rc != DSM_SUCCESS) {
+        LOG_ERROR("Failed to return token of lock %lu", lock->id);
+    }
+    return rc;
+}
+
+/**
+ * The token arrives; recall set means it goes back after one use
+ */
+static int token_take_locked(dsm_lock_t *lock, lock_mode_t mode, bool recall) {
+    lock->has_token = true;
+    lock->shared = mode == LOCK_MODE_SHARED;
+    lock->requested = false;
+    lock->fresh = true;
+    lock->recalled = recall;
+    pthread_cond_broadcast(&lock->acquired_cv);
+
+    /* The requester gave up waiting: nobody here will release it */
+    if (recall && token_idle_locked(lock) && lock->num_waiting == 0) {
+        return token_return_locked(lock);
+    }
+    return DSM_SUCCESS;
+}
+
+/**
+ * The manager wants the token back for another node
+ */
+static int token_recall_locked(dsm_lock_t *lock) {
+    if (!lock->has_token) {
+        LOG_DEBUG("Recall of lock %lu, which this node does not hold", lock->id);
+        return DSM_SUCCESS;
+    }
+
+    STATS_INC(lock_recalls);
+    lock->recalled = true;
+    if (token_idle_locked(lock) && lock->num_waiting == 0) {
+        return token_return_locked(lock);
+    }
+    /* Returned by the release of the threads inside (or about to enter) */
+    return DSM_SUCCESS;
+}
+
+/**
+ * Whether a thread may enter the critical section in a mode now
+ *
+ * Readers share any token; a writer needs the token exclusively and
+ * alone. Readers wait for local writers, and a recalled token admits no
+ * more readers once one is inside, so it is returned after that use.
+ */
+static bool token_usable_locked(const dsm_lock_t *lock, lock_mode_t mode) {
+    if (!lock->has_token || lock->in_use || lock->syncing) {
+        return false;
+    }
+    if (mode == LOCK_MODE_EXCLUSIVE) {
+        return !lock->shared && lock->readers_in == 0;
+    }
+    return lock->writers_waiting == 0 && !(lock->recalled && lock->readers_in > 0);
+}
+
+/* ============================ */
+/*       Acquire and Release    */
+/* ============================ */
+
+/**
+ * Enter the critical section of a lock
+ *
+ * With a usable token cached on this node the lock is taken without
+ * messages; otherwise a LOCK_REQUEST goes to the manager and the caller
+ * waits for the token's LOCK_GRANT. A writer finding a shared token here
+ * returns it first and asks for the token exclusively.
+ */
+static int lock_acquire_mode(dsm_lock_t *lock, lock_mode_t mode) {
     if (!lock) {
         LOG_ERROR("NULL lock");
         return DSM_ERROR_INVALID;
@@ -127,76 +490,125 @@ int dsm_lock_acquire(dsm_lock_t *lock) {
         return DSM_ERROR_INIT;
     }
 
-    LOG_DEBUG("Node %u acquiring lock %lu", ctx->node_id, lock->id);
+    LOG_DEBUG("Node %u acquiring lock %lu (mode=%d)", ctx->node_id, lock->id, mode);
+    uint64_t start_ns = perf_get_timestamp_ns();
 
-    /* If this is the manager node, handle locally */
-    if (ctx->config.is_manager) {
-        pthread_mutex_lock(&lock->local_lock);
+    struct timespec timeout;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec += LOCK_TIMEOUT_SEC;
 
-        /* Wait until lock is free */
-        while (lock->state == LOCK_STATE_HELD) {
-            struct timespec timeout;
-            clock_gettime(CLOCK_REALTIME, &timeout);
-            timeout.tv_sec += LOCK_TIMEOUT_SEC;
-
-            int rc = pthread_cond_timedwait(&lock->acquired_cv, &lock->local_lock, &timeout);
-            if (rc == ETIMEDOUT) {
-                pthread_mutex_unlock(&lock->local_lock);
-                LOG_ERROR("Lock acquire timeout for lock %lu", lock->id);
-                return DSM_ERROR_TIMEOUT;
+    pthread_mutex_lock(&lock->local_lock);
+    lock->num_waiting++;
+    if (mode == LOCK_MODE_EXCLUSIVE) {
+        lock->writers_waiting++;
+    }
+
+    int rc = DSM_SUCCESS;
+    while (!token_usable_locked(lock, mode)) {
+        if (mode == LOCK_MODE_EXCLUSIVE && lock->has_token && lock->shared &&
+            token_idle_locked(lock)) {
+            rc = token_return_locked(lock);
+            if (rc != DSM_SUCCESS) {
+                break;
             }
+            continue;
         }
 
-        /* Acquire the lock */
-        lock->state = LOCK_STATE_HELD;
-        lock->holder = ctx->node_id;
+        if (!lock->has_token && !lock->requested) {
+            lock->requested = true;
+            if (ctx->config.is_manager) {
+                rc = directory_request_locked(lock, ctx->node_id, mode);
+            } else {
+                node_id_t manager = 0;  /* Manager is always node 0 */
+                rc = send_lock_request(manager, lock->id, mode);
+            }
+            if (rc != DSM_SUCCESS) {
+                lock->requested = false;
+                LOG_ERROR("Failed to request lock %lu", lock->id);
+                break;
+            }
+            continue;
+        }
+
+        if (pthread_cond_timedwait(&lock->acquired_cv, &lock->local_lock, &timeout) == ETIMEDOUT) {
+            LOG_ERROR("Lock acquire timeout for lock %lu", lock->id);
+            rc = DSM_ERROR_TIMEOUT;
+            break;
+        }
+    }
+
+    lock->num_waiting--;
+    if (mode == LOCK_MODE_EXCLUSIVE) {
+        lock->writers_waiting--;
+    }
+
+    if (rc != DSM_SUCCESS) {
+        if (lock->has_token && lock->recalled && token_idle_locked(lock) && lock->num_waiting == 0) {
+            token_return_locked(lock);
+        }
+        /* Readers held back for this writer may go ahead */
+        pthread_cond_broadcast(&lock->acquired_cv);
         pthread_mutex_unlock(&lock->local_lock);
+        return rc;
+    }
 
-        LOG_DEBUG("Node %u acquired lock %lu locally", ctx->node_id, lock->id);
+    if (mode == LOCK_MODE_EXCLUSIVE) {
+        lock->in_use = true;
     } else {
-        /* Send LOCK_REQUEST to manager */
-        node_id_t manager = 0;  /* Manager is always node 0 */
-        int rc = send_lock_request(manager, lock->id);
-        if (rc != DSM_SUCCESS) {
-            LOG_ERROR("Failed to send lock request");
-            return rc;
-        }
+        lock->readers_in++;
+    }
+    bool fresh = lock->fresh;
+    lock->fresh = false;
+    lock->syncing = fresh;
 
-        /* Wait for LOCK_GRANT */
-        pthread_mutex_lock(&lock->local_lock);
+    lock_binding_t bindings[LOCK_MAX_BINDINGS];
+    int num_bindings = fresh ? lock->num_bindings : 0;
+    memcpy(bindings, lock->bindings, (size_t)num_bindings * sizeof(bindings[0]));
+    pthread_mutex_unlock(&lock->local_lock);
 
-        struct timespec timeout;
-        clock_gettime(CLOCK_REALTIME, &timeout);
-        timeout.tv_sec += LOCK_TIMEOUT_SEC;
+    /* Update statistics */
+    STATS_INC(lock_acquires);
+    if (mode == LOCK_MODE_SHARED) {
+        STATS_INC(lock_shared_acquires);
+    }
 
-        while (lock->holder != ctx->node_id) {
-            rc = pthread_cond_timedwait(&lock->acquired_cv, &lock->local_lock, &timeout);
-            if (rc == ETIMEDOUT) {
-                pthread_mutex_unlock(&lock->local_lock);
-                LOG_ERROR("Lock acquire timeout for lock %lu", lock->id);
-                return DSM_ERROR_TIMEOUT;
-            }
+    if (fresh) {
+        /* Release consistency: drop stale copies so the critical section
+         * sees the previous holder's writes */
+        rc_acquire();
+
+        /* The previous holder may have written the bound data: bring it in
+         * with one batch per owner. Read access, so the writes of the
+         * critical section still decide which pages become dirty */
+        for (int i = 0; i < num_bindings; i++) {
+            dsm_prefetch(bindings[i].addr, bindings[i].len, ACCESS_READ);
         }
 
+        /* Other readers of this node enter only once the copies are fresh */
+        pthread_mutex_lock(&lock->local_lock);
+        lock->syncing = false;
+        pthread_cond_broadcast(&lock->acquired_cv);
         pthread_mutex_unlock(&lock->local_lock);
-        LOG_DEBUG("Node %u acquired lock %lu from manager", ctx->node_id, lock->id);
+        LOG_DEBUG("Node %u acquired lock %lu", ctx->node_id, lock->id);
+    } else {
+        /* No other node held the lock since this node released it */
+        STATS_INC(lock_cached_acquires);
+        LOG_DEBUG("Node %u acquired lock %lu from its cached token", ctx->node_id, lock->id);
     }
 
-    /* Update statistics */
-    pthread_mutex_lock(&ctx->stats_lock);
-    ctx->stats.lock_acquires++;
-    pthread_mutex_unlock(&ctx->stats_lock);
+    trace_event(TRACE_LOCK_ACQUIRE, lock->id, TRACE_ACCESS_NONE,
+                perf_get_timestamp_ns() - start_ns, 0, TRACE_NODE_NONE);
 
     return DSM_SUCCESS;
 }
 
 /**
- * Release a distributed lock
+ * Leave the critical section of a lock, in whichever mode it was entered
  *
- * Releases the lock, allowing another node to acquire it.
- * Must be called by the node that currently holds the lock.
+ * The token stays cached on this node unless the manager recalled it, in
+ * which case it is returned for the next waiter once no thread is inside.
  */
-int dsm_lock_release(dsm_lock_t *lock) {
+static int lock_release_mode(dsm_lock_t *lock) {
     if (!lock) {
         LOG_ERROR("NULL lock");
         return DSM_ERROR_INVALID;
@@ -210,51 +622,108 @@ int dsm_lock_release(dsm_lock_t *lock) {
 
     LOG_DEBUG("Node %u releasing lock %lu", ctx->node_id, lock->id);
 
-    /* If this is the manager node, handle locally */
-    if (ctx->config.is_manager) {
-        pthread_mutex_lock(&lock->local_lock);
-
-        if (lock->holder != ctx->node_id) {
-            pthread_mutex_unlock(&lock->local_lock);
-            LOG_ERROR("Node %u doesn't hold lock %lu", ctx->node_id, lock->id);
-            return DSM_ERROR_PERMISSION;
-        }
+    /* Release consistency: homes must hold our writes before the next holder
+     * runs. Done on every release, so a recalled idle token needs no flush.
+     * The lock is released even if a diff was lost, and the error returned */
+    int flush_rc = rc_release();
 
-        /* Release the lock */
-        lock->state = LOCK_STATE_FREE;
-        lock->holder = (node_id_t)-1;
+    pthread_mutex_lock(&lock->local_lock);
 
-        /* Wake up next waiter if any */
-        pthread_cond_signal(&lock->acquired_cv);
+    if (!lock->has_token || token_idle_locked(lock)) {
         pthread_mutex_unlock(&lock->local_lock);
+        LOG_ERROR("Node %u doesn't hold lock %lu", ctx->node_id, lock->id);
+        return DSM_ERROR_PERMISSION;
+    }
 
-        LOG_DEBUG("Node %u released lock %lu locally", ctx->node_id, lock->id);
+    if (lock->in_use) {
+        lock->in_use = false;
     } else {
-        /* Send LOCK_RELEASE to manager */
-        pthread_mutex_lock(&lock->local_lock);
+        lock->readers_in--;
+    }
 
-        if (lock->holder != ctx->node_id) {
-            pthread_mutex_unlock(&lock->local_lock);
-            LOG_ERROR("Node %u doesn't hold lock %lu", ctx->node_id, lock->id);
-            return DSM_ERROR_PERMISSION;
-        }
+    int rc = DSM_SUCCESS;
+    if (lock->recalled && token_idle_locked(lock)) {
+        rc = token_return_locked(lock);
+    }
 
-        lock->holder = (node_id_t)-1;
-        pthread_mutex_unlock(&lock->local_lock);
+    /* Local waiters take the cached token, or request it again */
+    pthread_cond_broadcast(&lock->acquired_cv);
+    pthread_mutex_unlock(&lock->local_lock);
 
-        node_id_t manager = 0;  /* Manager is always node 0 */
-        int rc = send_lock_release(manager, lock->id);
-        if (rc != DSM_SUCCESS) {
-            LOG_ERROR("Failed to send lock release");
-            return rc;
-        }
+    if (rc != DSM_SUCCESS) {
+        return rc;
+    }
+
+    trace_event(TRACE_LOCK_RELEASE, lock->id, TRACE_ACCESS_NONE, 0, 0, TRACE_NODE_NONE);
+    return flush_rc;
+}
+
+/* ============================ */
+/*       Public API             */
+/* ============================ */
+
+/**
+ * Acquire a distributed lock
+ *
+ * Blocks until the lock is acquired. With the token cached on this node
+ * the lock is taken without messages.
+ */
+int dsm_lock_acquire(dsm_lock_t *lock) {
+    return lock_acquire_mode(lock, LOCK_MODE_EXCLUSIVE);
+}
 
-        LOG_DEBUG("Node %u released lock %lu to manager", ctx->node_id, lock->id);
+/**
+ * Bind a DSM range to a lock
+ *
+ * Every acquire that receives the token from another node fetches the
+ * range before returning.
+ */
+int dsm_lock_bind(dsm_lock_t *lock, void *addr, size_t len) {
+    if (!lock || !addr || len == 0 || (uintptr_t)addr + len < (uintptr_t)addr) {
+        return DSM_ERROR_INVALID;
     }
 
+    dsm_context_t *ctx = dsm_get_context();
+    if (!ctx->initialized) {
+        LOG_ERROR("DSM not initialized");
+        return DSM_ERROR_INIT;
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    page_table_t *table = NULL;
+    bool found = page_index_lookup_addr(addr, &table) != NULL;
+    pthread_mutex_unlock(&ctx->lock);
+    if (!found) {
+        LOG_ERROR("Lock %lu: %p is not DSM memory", lock->id, addr);
+        return DSM_ERROR_NOT_FOUND;
+    }
+
+    pthread_mutex_lock(&lock->local_lock);
+    if (lock->num_bindings == LOCK_MAX_BINDINGS) {
+        pthread_mutex_unlock(&lock->local_lock);
+        LOG_ERROR("Lock %lu already has %d bound ranges", lock->id, LOCK_MAX_BINDINGS);
+        return DSM_ERROR_MEMORY;
+    }
+    lock->bindings[lock->num_bindings].addr = addr;
+    lock->bindings[lock->num_bindings].len = len;
+    lock->num_bindings++;
+    pthread_mutex_unlock(&lock->local_lock);
+
+    LOG_DEBUG("Lock %lu: bound %zu bytes at %p", lock->id, len, addr);
     return DSM_SUCCESS;
 }
 
+/**
+ * Release a distributed lock
+ *
+ * The token stays cached on this node unless the manager recalled it, in
+ * which case it is returned for the next waiter.
+ * Must be called by the node that currently holds the lock.
+ */
+int dsm_lock_release(dsm_lock_t *lock) {
+    return lock_release_mode(lock);
+}
+
 /**
  * Destroy a distributed lock
  *
@@ -273,9 +742,18 @@ int dsm_lock_destroy(dsm_lock_t *lock) {
 
     LOG_DEBUG("Destroying lock %lu", lock->id);
 
+    /* A cached token goes back, or the manager would keep recalling it here */
+    if (!ctx->config.is_manager) {
+        pthread_mutex_lock(&lock->local_lock);
+        if (lock->has_token) {
+            token_return_locked(lock);
+        }
+        pthread_mutex_unlock(&lock->local_lock);
+    }
+
     /* Remove from lock manager */
     pthread_mutex_lock(&ctx->lock_mgr.lock);
-    for (int i = 0; i < 256; i++) {
+    for (int i = 0; i < ctx->lock_mgr.capacity; i++) {
         if (ctx->lock_mgr.locks[i] == lock) {
             ctx->lock_mgr.locks[i] = NULL;
             ctx->lock_mgr.num_locks--;
@@ -284,13 +762,19 @@ int dsm_lock_destroy(dsm_lock_t *lock) {
     }
     pthread_mutex_unlock(&ctx->lock_mgr.lock);
 
-    /* Cleanup waiters */
+    /* Cleanup waiters and readers */
     lock_waiter_t *waiter = lock->waiters_head;
     while (waiter) {
         lock_waiter_t *next = waiter->next;
         free(waiter);
         waiter = next;
     }
+    waiter = lock->readers_head;
+    while (waiter) {
+        lock_waiter_t *next = waiter->next;
+        free(waiter);
+        waiter = next;
+    }
 
     /* Cleanup synchronization primitives */
     pthread_mutex_destroy(&lock->local_lock);
@@ -300,10 +784,39 @@ int dsm_lock_destroy(dsm_lock_t *lock) {
     return DSM_SUCCESS;
 }
 
+/* ============================ */
+/*       Reader-Writer Locks    */
+/* ============================ */
+
+/*
+ * A dsm_rwlock_t handle is the dsm_lock_t of the same ID; it only adds
+ * the shared mode. struct dsm_rwlock_s is never defined.
+ */
+
+dsm_rwlock_t* dsm_rwlock_create(lock_id_t lock_id) {
+    return (dsm_rwlock_t*)dsm_lock_create(lock_id);
+}
+
+int dsm_rwlock_rdlock(dsm_rwlock_t *rwlock) {
+    return lock_acquire_mode((dsm_lock_t*)rwlock, LOCK_MODE_SHARED);
+}
+
+int dsm_rwlock_wrlock(dsm_rwlock_t *rwlock) {
+    return lock_acquire_mode((dsm_lock_t*)rwlock, LOCK_MODE_EXCLUSIVE);
+}
+
+int dsm_rwlock_unlock(dsm_rwlock_t *rwlock) {
+    return lock_release_mode((dsm_lock_t*)rwlock);
+}
+
+int dsm_rwlock_destroy(dsm_rwlock_t *rwlock) {
+    return dsm_lock_destroy((dsm_lock_t*)rwlock);
+}
+
 /**
- * Manager-side: Grant lock to a node (called by handler)
+ * Manager-side: Handle a lock request (called by handler)
  */
-int lock_manager_grant(lock_id_t lock_id, node_id_t requester) {
+int lock_manager_grant(lock_id_t lock_id, node_id_t requester, lock_mode_t mode) {
     dsm_lock_t *lock = find_lock_by_id(lock_id);
     if (!lock) {
         /* Lazy creation: create lock if it doesn't exist */
@@ -315,71 +828,14 @@ int lock_manager_grant(lock_id_t lock_id, node_id_t requester) {
         }
     }
 
-    dsm_context_t *ctx = dsm_get_context();
-
     pthread_mutex_lock(&lock->local_lock);
-
-    if (lock->state == LOCK_STATE_FREE) {
-        /* Lock is free, grant immediately */
-        lock->state = LOCK_STATE_HELD;
-        lock->holder = requester;
-
-        /* Capture state for replication */
-        node_id_t holder_copy = lock->holder;
-
-        pthread_mutex_unlock(&lock->local_lock);
-
-        /* Replicate lock state to backup */
-        if (ctx->config.is_manager && !ctx->network.backup_state.is_promoted) {
-            extern int send_state_sync_lock(lock_id_t lock_id, node_id_t holder, const node_id_t *waiters, int num_waiters);
-            send_state_sync_lock(lock_id, holder_copy, NULL, 0);
-        }
-
-        LOG_DEBUG("Manager granted lock %lu to node %u", lock_id, requester);
-        return send_lock_grant(requester, lock_id);
-    } else {
-        /* Lock is held, add to wait queue */
-        lock_waiter_t *waiter = (lock_waiter_t*)malloc(sizeof(lock_waiter_t));
-        if (!waiter) {
-            pthread_mutex_unlock(&lock->local_lock);
-            return DSM_ERROR_MEMORY;
-        }
-
-        waiter->node_id = requester;
-        waiter->next = NULL;
-
-        if (lock->waiters_tail) {
-            lock->waiters_tail->next = waiter;
-            lock->waiters_tail = waiter;
-        } else {
-            lock->waiters_head = lock->waiters_tail = waiter;
-        }
-
-        /* Capture waiter queue for replication */
-        node_id_t holder_copy = lock->holder;
-        node_id_t waiters_copy[32];
-        int num_waiters = 0;
-        lock_waiter_t *w = lock->waiters_head;
-        while (w && num_waiters < 32) {
-            waiters_copy[num_waiters++] = w->node_id;
-            w = w->next;
-        }
-
-        pthread_mutex_unlock(&lock->local_lock);
-
-        /* Replicate lock state to backup */
-        if (ctx->config.is_manager && !ctx->network.backup_state.is_promoted) {
-            extern int send_state_sync_lock(lock_id_t lock_id, node_id_t holder, const node_id_t *waiters, int num_waiters);
-            send_state_sync_lock(lock_id, holder_copy, waiters_copy, num_waiters);
-        }
-
-        LOG_DEBUG("Manager queued node %u for lock %lu", requester, lock_id);
-        return DSM_SUCCESS;
-    }
+    int rc = directory_request_locked(lock, requester, mode);
+    pthread_mutex_unlock(&lock->local_lock);
+    return rc;
 }
 
 /**
- * Manager-side: Handle lock release and grant to next waiter
+ * Manager-side: Handle a returned token and grant it to the next waiter
  */
 int lock_manager_release(lock_id_t lock_id, node_id_t releaser) {
     dsm_lock_t *lock = find_lock_by_id(lock_id);
@@ -390,89 +846,50 @@ int lock_manager_release(lock_id_t lock_id, node_id_t releaser) {
     }
 
     pthread_mutex_lock(&lock->local_lock);
+    int rc = directory_release_locked(lock, releaser);
+    pthread_mutex_unlock(&lock->local_lock);
+    return rc;
+}
 
-    if (lock->holder != releaser) {
-        pthread_mutex_unlock(&lock->local_lock);
-        LOG_ERROR("Node %u doesn't hold lock %lu (holder is %u)",
-                  releaser, lock_id, lock->holder);
-        return DSM_ERROR_PERMISSION;
+/**
+ * Client-side: Handle lock grant from manager
+ */
+int lock_handle_grant(lock_id_t lock_id, node_id_t grantee, lock_mode_t mode, bool recall) {
+    dsm_context_t *ctx = dsm_get_context();
+    if (grantee != ctx->node_id) {
+        LOG_WARN("Received lock grant for node %u but I am node %u", grantee, ctx->node_id);
+        return DSM_ERROR_INVALID;
     }
 
-    /* Check if there are waiters */
-    if (lock->waiters_head) {
-        /* Grant to next waiter */
-        lock_waiter_t *next_waiter = lock->waiters_head;
-        lock->waiters_head = next_waiter->next;
-        if (!lock->waiters_head) {
-            lock->waiters_tail = NULL;
-        }
-
-        node_id_t next_holder = next_waiter->node_id;
-        free(next_waiter);
-
-        lock->holder = next_holder;
-
-        /* Capture remaining waiters for replication */
-        node_id_t holder_copy = lock->holder;
-        node_id_t waiters_copy[32];
-        int num_waiters = 0;
-        lock_waiter_t *w = lock->waiters_head;
-        while (w && num_waiters < 32) {
-            waiters_copy[num_waiters++] = w->node_id;
-            w = w->next;
-        }
-
-        pthread_mutex_unlock(&lock->local_lock);
-
-        /* Replicate lock state to backup */
-        dsm_context_t *ctx = dsm_get_context();
-        if (ctx->config.is_manager && !ctx->network.backup_state.is_promoted) {
-            extern int send_state_sync_lock(lock_id_t lock_id, node_id_t holder, const node_id_t *waiters, int num_waiters);
-            send_state_sync_lock(lock_id, holder_copy, waiters_copy, num_waiters);
-        }
-
-        LOG_DEBUG("Manager granted lock %lu to next waiter (node %u)", lock_id, next_holder);
-        return send_lock_grant(next_holder, lock_id);
-    } else {
-        /* No waiters, mark as free */
-        lock->state = LOCK_STATE_FREE;
-        lock->holder = (node_id_t)-1;
-
-        pthread_mutex_unlock(&lock->local_lock);
+    dsm_lock_t *lock = find_lock_by_id(lock_id);
+    if (!lock) {
+        /* Destroyed while the request was in flight: hand the token back */
+        LOG_WARN("Lock %lu not found, returning its token", lock_id);
+        node_id_t manager = 0;  /* Manager is always node 0 */
+        send_lock_release(manager, lock_id);
+        return DSM_ERROR_NOT_FOUND;
+    }
 
-        /* Replicate lock state to backup */
-        dsm_context_t *ctx = dsm_get_context();
-        if (ctx->config.is_manager && !ctx->network.backup_state.is_promoted) {
-            extern int send_state_sync_lock(lock_id_t lock_id, node_id_t holder, const node_id_t *waiters, int num_waiters);
-            send_state_sync_lock(lock_id, (node_id_t)-1, NULL, 0);
-        }
+    pthread_mutex_lock(&lock->local_lock);
+    int rc = token_take_locked(lock, mode, recall);
+    pthread_mutex_unlock(&lock->local_lock);
 
-        LOG_DEBUG("Manager released lock %lu (no waiters)", lock_id);
-        return DSM_SUCCESS;
-    }
+    LOG_DEBUG("Node %u received lock grant for lock %lu", grantee, lock_id);
+    return rc;
 }
 
 /**
- * Client-side: Handle lock grant from manager
+ * Client-side: Handle a token recall from the manager
  */
-int lock_handle_grant(lock_id_t lock_id, node_id_t grantee) {
+int lock_handle_recall(lock_id_t lock_id) {
     dsm_lock_t *lock = find_lock_by_id(lock_id);
     if (!lock) {
-        LOG_ERROR("Lock %lu not found", lock_id);
+        LOG_DEBUG("Recall of unknown lock %lu", lock_id);
         return DSM_ERROR_NOT_FOUND;
     }
 
-    dsm_context_t *ctx = dsm_get_context();
-    if (grantee != ctx->node_id) {
-        LOG_WARN("Received lock grant for node %u but I am node %u", grantee, ctx->node_id);
-        return DSM_ERROR_INVALID;
-    }
-
     pthread_mutex_lock(&lock->local_lock);
-    lock->holder = grantee;
-    pthread_cond_signal(&lock->acquired_cv);
+    int rc = token_recall_locked(lock);
     pthread_mutex_unlock(&lock->local_lock);
-
-    LOG_DEBUG("Node %u received lock grant for lock %lu", grantee, lock_id);
-    return DSM_SUCCESS;
+    return rc;
 }
@@ -7,25 +7,69 @@
 #define LOCK_H
 
 #include "dsm/types.h"
+#include "../network/protocol.h"
 #include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Ranges one lock can have bound with dsm_lock_bind() */
+#define LOCK_MAX_BINDINGS 8
+
+/**
+ * DSM range protected by a lock
+ */
+typedef struct {
+    void *addr;
+    size_t len;
+} lock_binding_t;
 
 /**
  * Queue node for waiting requests
  */
 typedef struct lock_waiter_s {
     node_id_t node_id;
+    lock_mode_t mode;          /**< Token mode asked for (readers list: LOCK_MODE_SHARED) */
     struct lock_waiter_s *next;
 } lock_waiter_t;
 
 /**
  * Distributed lock structure (opaque to users)
+ *
+ * A lock is a token that a node keeps after releasing it, so re-acquiring
+ * a lock no other node asked for takes no messages. The manager's copy
+ * also tracks where the token is (holder) and who waits for it.
+ *
+ * A dsm_rwlock_t is the same structure. Its token can also be shared:
+ * then several nodes hold it at once (readers) and none may write.
  */
 struct dsm_lock_s {
     lock_id_t id;
-    node_id_t holder;
-    lock_state_t state;
+
+    /* Token directory (manager only) */
+    node_id_t holder;          /**< Node holding the token exclusively, or -1 */
+    lock_state_t state;        /**< LOCK_STATE_HELD or LOCK_STATE_SHARED while nodes hold the token */
+    lock_waiter_t *readers_head; /**< Nodes holding a shared token (unordered) */
+    int num_readers;
     lock_waiter_t *waiters_head;
     lock_waiter_t *waiters_tail;
+    bool recall_sent;          /**< The holder (or every reader) was asked to return the token */
+
+    /* Token on this node */
+    bool has_token;            /**< This node holds the token (in use or cached) */
+    bool shared;               /**< The token held is shared: read acquires only */
+    bool in_use;               /**< A thread of this node is in the critical section exclusively */
+    int readers_in;            /**< Threads of this node in the critical section to read */
+    bool requested;            /**< A LOCK_REQUEST is outstanding */
+    bool recalled;             /**< Return the token to the manager on release */
+    bool fresh;                /**< The token arrived since the last acquire on this node */
+    bool syncing;              /**< The first acquire of a fresh token is still in rc_acquire() */
+    int num_waiting;           /**< Threads of this node waiting in dsm_lock_acquire() */
+    int writers_waiting;       /**< Of those, the ones that want the lock exclusively */
+
+    /* Data the lock protects, fetched with a fresh token */
+    lock_binding_t bindings[LOCK_MAX_BINDINGS];
+    int num_bindings;
+
     pthread_mutex_t local_lock;
     pthread_cond_t acquired_cv;
 };
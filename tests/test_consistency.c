@@ -7,9 +7,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
 #include "dsm/types.h"
 #include "../src/consistency/directory.h"
 #include "../src/consistency/page_migration.h"
+#include "../src/consistency/release_consistency.h"
+#include "../src/consistency/diff_kernels.h"
+#include "../src/core/dsm_context.h"
+#include "../src/memory/page_table.h"
 
 #define NUM_TEST_PAGES 10
 
@@ -71,6 +76,105 @@ void test_directory_add_reader(void) {
     printf("  ✓ directory_add_reader passed\n");
 }
 
+void test_directory_access_advice(void) {
+    printf("Testing directory access counters and advice...\n");
+
+    page_directory_t *dir = directory_create(NUM_TEST_PAGES);
+    assert(dir != NULL);
+
+    node_id_t invalidate[MAX_SHARERS];
+    int num_invalidate;
+    directory_access_t access;
+
+    /* Placement is not a write; many reads make the page read-mostly */
+    assert(directory_set_owner(dir, 0, 0) == DSM_SUCCESS);
+    assert(directory_advise(dir, 0, 1) == DIRECTORY_ADVICE_NONE);
+    for (int i = 0; i < DIRECTORY_READ_MOSTLY_MIN; i++) {
+        assert(directory_add_reader(dir, 0, 1 + i % 3) == DSM_SUCCESS);
+    }
+    assert(directory_get_access(dir, 0, &access) == DSM_SUCCESS);
+    assert(access.reads == DIRECTORY_READ_MOSTLY_MIN);
+    assert(access.writes == 0);
+    assert(directory_advise(dir, 0, 1) == DIRECTORY_ADVICE_REPLICATE);
+
+    assert(directory_note_invalidations(dir, 0, 3) == DSM_SUCCESS);
+    assert(directory_get_access(dir, 0, &access) == DSM_SUCCESS);
+    assert(access.invalidations == 3);
+
+    /* Repeated writes by one node make it the dominant writer */
+    for (int i = 0; i < DIRECTORY_MIGRATE_VOTES; i++) {
+        assert(directory_set_writer(dir, 1, 2, invalidate, &num_invalidate) == DSM_SUCCESS);
+    }
+    assert(directory_advise(dir, 1, 2) == DIRECTORY_ADVICE_MIGRATE);
+    assert(directory_advise(dir, 1, 1) == DIRECTORY_ADVICE_NONE);
+    assert(directory_get_access(dir, 1, &access) == DSM_SUCCESS);
+    assert(access.dominant_writer == 2);
+    assert(access.transfers == 0);
+
+    /* A write by another node takes a vote away */
+    assert(directory_set_writer(dir, 1, 3, invalidate, &num_invalidate) == DSM_SUCCESS);
+    assert(directory_get_access(dir, 1, &access) == DSM_SUCCESS);
+    assert(access.dominant_votes == DIRECTORY_MIGRATE_VOTES - 1);
+    assert(access.transfers == 1);
+    assert(directory_advise(dir, 1, 2) == DIRECTORY_ADVICE_NONE);
+
+    /* Ownership moving back and forth freezes the page */
+    for (int i = 0; i < DIRECTORY_PINGPONG_TRANSFERS; i++) {
+        assert(directory_set_writer(dir, 2, 1 + i % 2, invalidate, &num_invalidate) == DSM_SUCCESS);
+    }
+    assert(directory_get_access(dir, 2, &access) == DSM_SUCCESS);
+    assert(access.transfers == DIRECTORY_PINGPONG_TRANSFERS - 1);  /* First write found no owner */
+    assert(access.frozen_until_ns == 0);
+    assert(directory_set_writer(dir, 2, 1, invalidate, &num_invalidate) == DSM_SUCCESS);
+    assert(directory_advise(dir, 2, 1) == DIRECTORY_ADVICE_FROZEN);
+    assert(directory_advise(dir, 2, 2) == DIRECTORY_ADVICE_FROZEN);
+
+    /* Untracked pages have no history */
+    assert(directory_get_access(dir, 5, &access) == DSM_SUCCESS);
+    assert(access.writes == 0 && access.dominant_writer == DSM_NODE_NONE);
+    assert(directory_advise(dir, 5, 1) == DIRECTORY_ADVICE_NONE);
+
+    directory_destroy(dir);
+    printf("  ✓ directory access counters and advice passed\n");
+}
+
+void test_directory_large_node_ids(void) {
+    printf("Testing directory sharers beyond 64 nodes...\n");
+
+    page_directory_t *dir = directory_create(NUM_TEST_PAGES);
+    assert(dir != NULL);
+
+    /* Node IDs past the inline bitmap word use the extension words */
+    node_id_t ids[] = {3, 64, 200, 1000};
+    int rc;
+    for (int i = 0; i < 4; i++) {
+        rc = directory_add_reader(dir, 0, ids[i]);
+        assert(rc == DSM_SUCCESS);
+    }
+    /* Re-adding a sharer is a no-op */
+    rc = directory_add_reader(dir, 0, 200);
+    assert(rc == DSM_SUCCESS);
+
+    node_id_t sharers[MAX_SHARERS];
+    int count;
+    rc = directory_get_sharers(dir, 0, sharers, &count);
+    assert(rc == DSM_SUCCESS);
+    assert(count == 4);
+    for (int i = 0; i < 4; i++) {
+        assert(sharers[i] == ids[i]);
+    }
+
+    rc = directory_remove_sharer(dir, 0, 200);
+    assert(rc == DSM_SUCCESS);
+    rc = directory_get_sharers(dir, 0, sharers, &count);
+    assert(rc == DSM_SUCCESS);
+    assert(count == 3);
+    assert(sharers[2] == 1000);
+
+    directory_destroy(dir);
+    printf("  ✓ directory large node IDs passed\n");
+}
+
 void test_directory_set_writer(void) {
     printf("Testing directory_set_writer()...\n");
 
@@ -148,6 +252,90 @@ void test_directory_remove_sharer(void) {
     printf("  ✓ directory_remove_sharer passed\n");
 }
 
+#define CONCURRENT_THREADS 8
+#define CONCURRENT_PAGES 1000
+
+typedef struct {
+    page_directory_t *dir;
+    node_id_t reader;
+} add_readers_arg_t;
+
+static void *add_readers_thread(void *arg) {
+    add_readers_arg_t *a = arg;
+    for (page_id_t p = 0; p < CONCURRENT_PAGES; p++) {
+        assert(directory_add_reader(a->dir, p, a->reader) == DSM_SUCCESS);
+    }
+    return NULL;
+}
+
+void test_directory_concurrent_create(void) {
+    printf("Testing concurrent directory entry creation...\n");
+
+    page_directory_t *dir = directory_create(CONCURRENT_PAGES);
+    assert(dir != NULL);
+
+    /* Every thread creates the same entries at once */
+    pthread_t threads[CONCURRENT_THREADS];
+    add_readers_arg_t args[CONCURRENT_THREADS];
+    for (int i = 0; i < CONCURRENT_THREADS; i++) {
+        args[i].dir = dir;
+        args[i].reader = (node_id_t)(i + 1);
+        pthread_create(&threads[i], NULL, add_readers_thread, &args[i]);
+    }
+    for (int i = 0; i < CONCURRENT_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    /* One entry per page, holding every thread's reader */
+    assert(dir->num_entries == CONCURRENT_PAGES);
+    for (page_id_t p = 0; p < CONCURRENT_PAGES; p++) {
+        node_id_t sharers[MAX_SHARERS];
+        int count;
+        assert(directory_get_sharers(dir, p, sharers, &count) == DSM_SUCCESS);
+        assert(count == CONCURRENT_THREADS);
+    }
+
+    directory_destroy(dir);
+    printf("  ✓ concurrent directory entry creation passed\n");
+}
+
+void test_directory_ranges(void) {
+    printf("Testing directory range storage...\n");
+
+    page_directory_t *dir = directory_create(NUM_TEST_PAGES);
+    assert(dir != NULL);
+
+    /* Pages of two allocations on different nodes, spanning chunk boundaries */
+    page_id_t a = PAGE_ID_BASE(1, 0) + DIRECTORY_CHUNK_PAGES - 1;
+    page_id_t b = PAGE_ID_BASE(2, 3) + PAGE_ID_MAX_PAGES - 1;
+    assert(directory_set_owner(dir, a, 1) == DSM_SUCCESS);
+    assert(directory_set_owner(dir, a + 1, 1) == DSM_SUCCESS);
+    assert(directory_set_owner(dir, b, 2) == DSM_SUCCESS);
+    assert(directory_add_reader(dir, b, 1) == DSM_SUCCESS);
+    assert(dir->num_entries == 3);
+
+    /* Node 1 fails: its pages lose their owner, its copies their sharer */
+    assert(directory_handle_node_failure(dir, 1) == DSM_SUCCESS);
+    node_id_t owner;
+    node_id_t sharers[MAX_SHARERS];
+    int count;
+    assert(directory_lookup(dir, a, &owner) == DSM_SUCCESS && owner == (node_id_t)-1);
+    assert(directory_lookup(dir, a + 1, &owner) == DSM_SUCCESS && owner == (node_id_t)-1);
+    assert(directory_lookup(dir, b, &owner) == DSM_SUCCESS && owner == 2);
+    assert(directory_get_sharers(dir, b, sharers, &count) == DSM_SUCCESS && count == 0);
+
+    /* A removed entry comes back fresh */
+    assert(directory_add_reader(dir, b, 3) == DSM_SUCCESS);
+    assert(directory_remove_entry(dir, b) == DSM_SUCCESS);
+    assert(dir->num_entries == 2);
+    assert(directory_get_sharers(dir, b, sharers, &count) == DSM_SUCCESS && count == 0);
+    assert(directory_lookup(dir, b, &owner) == DSM_SUCCESS && owner == (node_id_t)-1);
+    assert(dir->num_entries == 3);
+
+    directory_destroy(dir);
+    printf("  ✓ directory range storage passed\n");
+}
+
 void test_consistency_init(void) {
     printf("Testing consistency_init()...\n");
 
@@ -162,6 +350,256 @@ void test_consistency_init(void) {
     printf("  ✓ consistency_init passed\n");
 }
 
+void test_directory_homes(void) {
+    printf("Testing directory_node() homes...\n");
+
+    dsm_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.node_id = 2;
+    config.num_nodes = 4;
+    config.directory = DSM_DIRECTORY_DISTRIBUTED;
+    assert(dsm_context_init(&config) == DSM_SUCCESS);
+    dsm_context_t *ctx = dsm_get_context();
+    assert(directory_distributed());
+
+    /* Runs of pages share a home; the next run moves to the next node */
+    page_id_t base = PAGE_ID_BASE(0, 0);
+    assert(directory_node(base) == 0);
+    assert(directory_node(base + (1 << DIRECTORY_HOME_SHIFT) - 1) == 0);
+    assert(directory_node(base + (1 << DIRECTORY_HOME_SHIFT)) == 1);
+    assert(directory_node(base + 2 * (1 << DIRECTORY_HOME_SHIFT)) == 2);
+    assert(directory_is_local(base + 2 * (1 << DIRECTORY_HOME_SHIFT)));
+    assert(!directory_is_local(base));
+
+    /* Small allocations, of other nodes too, do not all land on one home */
+    int homes[4] = { 0 };
+    for (node_id_t node = 0; node < 4; node++) {
+        for (int alloc = 0; alloc < 4; alloc++) {
+            homes[directory_node(PAGE_ID_BASE(node, alloc))]++;
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        assert(homes[i] == 4);
+    }
+
+    /* A failed home's pages fall to the manager */
+    ctx->network.nodes[1].is_failed = true;
+    assert(directory_node(base + (1 << DIRECTORY_HOME_SHIFT)) == 0);
+    ctx->network.nodes[1].is_failed = false;
+
+    /* The central directory is the manager's */
+    ctx->config.directory = DSM_DIRECTORY_CENTRAL;
+    assert(!directory_distributed());
+    assert(directory_node(base + 2 * (1 << DIRECTORY_HOME_SHIFT)) == 0);
+    assert(!directory_is_local(base + 2 * (1 << DIRECTORY_HOME_SHIFT)));
+
+    dsm_context_cleanup();
+    printf("  ✓ directory homes passed\n");
+}
+
+void test_directory_page_advice(void) {
+    printf("Testing directory_page_advice()...\n");
+
+    dsm_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.node_id = 2;
+    config.num_nodes = 4;
+    config.directory = DSM_DIRECTORY_DISTRIBUTED;
+    config.adaptive = true;
+    assert(dsm_context_init(&config) == DSM_SUCCESS);
+    dsm_context_t *ctx = dsm_get_context();
+    assert(consistency_init(NUM_TEST_PAGES) == DSM_SUCCESS);
+    page_directory_t *dir = get_page_directory();
+
+    page_id_t remote = PAGE_ID_BASE(0, 0);
+    page_id_t local = remote + 2 * (1 << DIRECTORY_HOME_SHIFT);
+    assert(!directory_is_local(remote) && directory_is_local(local));
+
+    node_id_t invalidate[MAX_SHARERS];
+    int num_invalidate;
+    for (int i = 0; i < DIRECTORY_MIGRATE_VOTES; i++) {
+        assert(directory_set_writer(dir, remote, 2, invalidate, &num_invalidate) == DSM_SUCCESS);
+        assert(directory_set_writer(dir, local, 2, invalidate, &num_invalidate) == DSM_SUCCESS);
+    }
+
+    /* This node's own counts of another home's page decide nothing */
+    assert(directory_advise(dir, remote, 2) == DIRECTORY_ADVICE_MIGRATE);
+    assert(directory_page_advice(dir, remote) == DIRECTORY_ADVICE_NONE);
+    assert(directory_advice_for(remote, 2) == DIRECTORY_ADVICE_NONE);
+
+    /* ...the home's advice does */
+    assert(directory_note_advice(dir, remote, DIRECTORY_ADVICE_FROZEN) == DSM_SUCCESS);
+    assert(directory_page_advice(dir, remote) == DIRECTORY_ADVICE_FROZEN);
+
+    /* As the home, this node advises itself and the others */
+    assert(directory_page_advice(dir, local) == DIRECTORY_ADVICE_MIGRATE);
+    assert(directory_advice_for(local, 2) == DIRECTORY_ADVICE_MIGRATE);
+    assert(directory_advice_for(local, 1) == DIRECTORY_ADVICE_NONE);
+
+    /* No advice without the adaptive policy */
+    ctx->config.adaptive = false;
+    assert(directory_page_advice(dir, local) == DIRECTORY_ADVICE_NONE);
+    assert(directory_page_advice(dir, remote) == DIRECTORY_ADVICE_NONE);
+
+    consistency_cleanup();
+    dsm_context_cleanup();
+    printf("  ✓ directory_page_advice passed\n");
+}
+
+void test_release_consistency_diffs(void) {
+    printf("Testing rc_encode_diff() / rc_apply_runs()...\n");
+
+    static uint8_t base[PAGE_SIZE], writer_a[PAGE_SIZE], writer_b[PAGE_SIZE];
+    static uint8_t home[PAGE_SIZE], expected[PAGE_SIZE];
+    static uint8_t diff_a[RC_DIFF_MAX_ENCODED], diff_b[RC_DIFF_MAX_ENCODED];
+
+    for (int i = 0; i < PAGE_SIZE; i++) {
+        base[i] = (uint8_t)(i * 7);
+    }
+    memcpy(writer_a, base, PAGE_SIZE);
+    memcpy(writer_b, base, PAGE_SIZE);
+
+    /* Unchanged page encodes to nothing */
+    int runs_a = -1;
+    assert(rc_encode_diff(writer_a, base, diff_a, &runs_a) == 0);
+    assert(runs_a == 0);
+
+    /* Disjoint writes, including neighbouring bytes of one word */
+    for (int i = 0; i < PAGE_SIZE; i += 2) {
+        writer_a[i] = (uint8_t)~base[i];
+    }
+    writer_b[1] = 0xAB;
+    writer_b[PAGE_SIZE - 1] = 0xCD;
+    memcpy(expected, writer_a, PAGE_SIZE);
+    expected[1] = 0xAB;
+    expected[PAGE_SIZE - 1] = 0xCD;
+
+    runs_a = 0;
+    int runs_b = 0;
+    size_t len_a = rc_encode_diff(writer_a, base, diff_a, &runs_a);
+    size_t len_b = rc_encode_diff(writer_b, base, diff_b, &runs_b);
+    assert(runs_a == PAGE_SIZE / 2);
+    assert(len_a <= RC_DIFF_MAX_ENCODED);
+    assert(runs_b == 2);
+
+    /* Diffs merge in either order */
+    memcpy(home, base, PAGE_SIZE);
+    assert(rc_apply_runs(home, diff_b, len_b, runs_b) == DSM_SUCCESS);
+    assert(rc_apply_runs(home, diff_a, len_a, runs_a) == DSM_SUCCESS);
+    assert(memcmp(home, expected, PAGE_SIZE) == 0);
+
+    memcpy(home, base, PAGE_SIZE);
+    assert(rc_apply_runs(home, diff_a, len_a, runs_a) == DSM_SUCCESS);
+    assert(rc_apply_runs(home, diff_b, len_b, runs_b) == DSM_SUCCESS);
+    assert(memcmp(home, expected, PAGE_SIZE) == 0);
+
+    /* Truncated data and out-of-page runs are rejected */
+    assert(rc_apply_runs(home, diff_b, len_b - 1, runs_b) == DSM_ERROR_INVALID);
+    uint8_t bad[8] = {0};
+    uint16_t offset = PAGE_SIZE - 2, length = 4;
+    memcpy(bad, &offset, sizeof(offset));
+    memcpy(bad + 2, &length, sizeof(length));
+    assert(rc_apply_runs(home, bad, sizeof(bad), 1) == DSM_ERROR_INVALID);
+
+    printf("  ✓ release consistency diffs passed\n");
+}
+
+void test_write_notices_merge(void) {
+    printf("Testing rc_notices_merge()...\n");
+
+    static rc_notices_t set;
+    memset(&set, 0, sizeof(set));
+
+    /* Duplicates within and across merges are kept once */
+    page_id_t first[] = {7, 3, 7, 9};
+    page_id_t second[] = {9, 11};
+    rc_notices_merge(&set, first, 4, false);
+    rc_notices_merge(&set, second, 2, false);
+    assert(!set.overflow);
+    assert(set.count == 4);
+    assert(set.pages[0] == 7 && set.pages[1] == 3 && set.pages[2] == 9 && set.pages[3] == 11);
+
+    /* Filling the set overflows it and drops the list */
+    static page_id_t many[BARRIER_NOTICE_MAX];
+    for (int i = 0; i < BARRIER_NOTICE_MAX; i++) {
+        many[i] = 1000 + (page_id_t)i;
+    }
+    rc_notices_merge(&set, many, BARRIER_NOTICE_MAX, false);
+    assert(set.overflow);
+    assert(set.count == 0);
+
+    /* An overflowed arrival overflows the union, and it stays that way */
+    memset(&set, 0, sizeof(set));
+    rc_notices_merge(&set, NULL, 0, true);
+    rc_notices_merge(&set, first, 4, false);
+    assert(set.overflow && set.count == 0);
+
+    printf("  ✓ write notice merging passed\n");
+}
+
+void test_diff_kernels(void) {
+    printf("Testing diff kernels...\n");
+
+    static uint8_t twin[PAGE_SIZE], page[PAGE_SIZE];
+    static uint8_t expected[RC_DIFF_MAX_ENCODED], actual[RC_DIFF_MAX_ENCODED];
+    const char *names[] = { "avx512", "avx2", "neon" };
+
+    const diff_kernel_t *scalar = diff_kernel_get("scalar");
+    assert(scalar != NULL);
+    assert(diff_kernel_select() != NULL);
+    assert(diff_kernel_get("bogus") == NULL);
+
+    srand(12345);
+    for (int trial = 0; trial < 200; trial++) {
+        for (int i = 0; i < PAGE_SIZE; i++) {
+            twin[i] = (uint8_t)rand();
+        }
+        memcpy(page, twin, PAGE_SIZE);
+
+        /* Sparse bytes, dense stretches, block edges and the page ends */
+        int changes = trial % 50;
+        for (int c = 0; c < changes; c++) {
+            int at = rand() % PAGE_SIZE;
+            int len = (c % 5 == 0) ? rand() % 200 : 1;
+            for (int i = at; i < at + len && i < PAGE_SIZE; i++) {
+                page[i] = (uint8_t)~twin[i];
+            }
+        }
+        if (trial % 7 == 0) {
+            page[0] = (uint8_t)~twin[0];
+            page[63] = (uint8_t)~twin[63];
+            page[64] = (uint8_t)~twin[64];
+            page[PAGE_SIZE - 1] = (uint8_t)~twin[PAGE_SIZE - 1];
+        }
+        if (trial == 199) {
+            for (int i = 0; i < PAGE_SIZE; i++) {
+                page[i] = (uint8_t)~twin[i];
+            }
+        }
+
+        int expected_runs = 0;
+        size_t expected_len = diff_encode(scalar, page, twin, expected, &expected_runs);
+
+        for (size_t k = 0; k < sizeof(names) / sizeof(names[0]); k++) {
+            const diff_kernel_t *kernel = diff_kernel_get(names[k]);
+            if (!kernel) {
+                continue;  /* Not supported on this CPU */
+            }
+            int runs = 0;
+            size_t len = diff_encode(kernel, page, twin, actual, &runs);
+            assert(len == expected_len);
+            assert(runs == expected_runs);
+            assert(memcmp(actual, expected, len) == 0);
+        }
+
+        /* Applying the diff to the twin reproduces the page */
+        assert(rc_apply_runs(twin, expected, expected_len, expected_runs) == DSM_SUCCESS);
+        assert(memcmp(twin, page, PAGE_SIZE) == 0);
+    }
+
+    printf("  ✓ diff kernels passed (selected: %s)\n", diff_kernel_select()->name);
+}
+
 int main(void) {
     printf("=================================\n");
     printf("  DSM Consistency Module Tests\n");
@@ -171,8 +609,17 @@ int main(void) {
     test_directory_lookup();
     test_directory_add_reader();
     test_directory_set_writer();
+    test_directory_large_node_ids();
+    test_directory_access_advice();
     test_directory_remove_sharer();
+    test_directory_concurrent_create();
+    test_directory_ranges();
     test_consistency_init();
+    test_directory_homes();
+    test_directory_page_advice();
+    test_release_consistency_diffs();
+    test_write_notices_merge();
+    test_diff_kernels();
 
     printf("\n=================================\n");
     printf("  All tests passed! ✓\n");
@@ -13,11 +13,14 @@
 #include <pthread.h>
 #include <assert.h>
 #include <time.h>
+#include <sys/socket.h>
 #include "dsm/dsm.h"
 #include "../src/core/dsm_context.h"
 #include "../src/consistency/directory.h"
 #include "../src/network/protocol.h"
 #include "../src/network/handlers.h"
+#include "../src/network/network.h"
+#include "../src/network/replication.h"
 #include "../src/sync/lock.h"
 #include "../src/sync/barrier.h"
 #include "../src/core/log.h"
@@ -287,9 +290,40 @@ int test_state_sync_locks(void) {
     TEST_ASSERT(backup_lock->holder == (node_id_t)-1, "Lock not released");
     TEST_ASSERT(backup_lock->waiters_head == NULL, "Waiters not cleared");
 
+    /* Test 4: Reader-writer lock held shared, a writer and a reader queued */
+    sync_msg.payload.state_sync_lock.sync_seq = 4;
+    sync_msg.payload.state_sync_lock.lock_id = 10;
+    sync_msg.payload.state_sync_lock.holder = (node_id_t)-1;  /* Shared: no single holder */
+    sync_msg.payload.state_sync_lock.num_readers = 2;
+    sync_msg.payload.state_sync_lock.num_waiters = 2;
+    sync_msg.payload.state_sync_lock.waiters[0] = 2;
+    sync_msg.payload.state_sync_lock.waiters[1] = 3;
+    sync_msg.payload.state_sync_lock.waiters[2] = 1;
+    sync_msg.payload.state_sync_lock.waiters[3] = 4 | LOCK_SYNC_SHARED_WAITER;
+
+    rc = handle_state_sync_lock(&sync_msg);
+    TEST_ASSERT(rc == DSM_SUCCESS, "Failed to handle shared lock state");
+    TEST_ASSERT(backup_lock->state == LOCK_STATE_SHARED, "Lock not replicated as shared");
+    TEST_ASSERT(backup_lock->num_readers == 2, "Reader count mismatch: expected 2, got %d",
+                backup_lock->num_readers);
+    TEST_ASSERT(backup_lock->waiters_head && backup_lock->waiters_head->node_id == 1 &&
+                backup_lock->waiters_head->mode == LOCK_MODE_EXCLUSIVE,
+                "Queued writer not replicated");
+    TEST_ASSERT(backup_lock->waiters_head->next && backup_lock->waiters_head->next->node_id == 4 &&
+                backup_lock->waiters_head->next->mode == LOCK_MODE_SHARED,
+                "Queued reader not replicated");
+
+    /* Test 5: A list longer than the payload is rejected */
+    sync_msg.payload.state_sync_lock.sync_seq = 5;
+    sync_msg.payload.state_sync_lock.num_readers = MAX_SHARERS;
+    sync_msg.payload.state_sync_lock.num_waiters = 1;
+    rc = handle_state_sync_lock(&sync_msg);
+    TEST_ASSERT(rc == DSM_ERROR_INVALID, "Oversized shared lock state accepted");
+    TEST_ASSERT(backup_lock->num_readers == 2, "Rejected state changed the shadow lock");
+
     /* Verify sequence number tracking */
-    TEST_ASSERT(ctx->network.backup_state.last_sync_seq == 3,
-                "Sequence number mismatch: expected 3, got %lu",
+    TEST_ASSERT(ctx->network.backup_state.last_sync_seq == 4,
+                "Sequence number mismatch: expected 4, got %lu",
                 ctx->network.backup_state.last_sync_seq);
 
     /* Cleanup */
@@ -724,6 +758,309 @@ int test_in_flight_operations(void) {
     TEST_PASS("In-flight operations retry");
 }
 
+/**
+ * Append a STATE_SYNC_* message to a STATE_SYNC_BATCH record buffer
+ */
+static size_t append_sync_record(uint8_t *buf, size_t off, const message_t *msg) {
+    state_sync_record_t rec = {
+        .type = (uint8_t)msg->header.type,
+        .len = (uint32_t)message_wire_payload_size(msg)
+    };
+    memcpy(buf + off, &rec, sizeof(rec));
+    memcpy(buf + off + sizeof(rec), &msg->payload, rec.len);
+    return off + sizeof(rec) + rec.len;
+}
+
+/**
+ * Test 7: Batched Replication Log
+ *
+ * Verifies that the backup logs STATE_SYNC_BATCH records and folds them
+ * into its shadow tables at the next snapshot.
+ * Tests:
+ * - Nothing applied before the snapshot
+ * - Only the last record of each entry applied
+ * - Stale records (sync_seq already applied) skipped
+ * - Truncated batches rejected
+ */
+int test_state_sync_batch(void) {
+    printf("\n[TEST 7] Batched Replication Log\n");
+
+    dsm_config_t config = {
+        .node_id = 1,  /* This will be the backup */
+        .num_nodes = 2,
+        .is_manager = false,
+        .port = 9007,
+        .log_level = LOG_LEVEL_DEBUG
+    };
+
+    dsm_context_t *ctx = dsm_get_context();
+    int rc = dsm_context_init(&config);
+    TEST_ASSERT(rc == DSM_SUCCESS, "Failed to initialize DSM context");
+
+    ctx->network.backup_state.is_backup = true;
+    ctx->network.backup_state.is_primary_backup = true;
+    ctx->network.backup_state.is_promoted = false;
+    ctx->network.backup_state.current_manager = 0;
+    ctx->network.backup_state.last_sync_seq = 0;
+    ctx->network.backup_state.backup_directory = directory_create(100000);
+    TEST_ASSERT(ctx->network.backup_state.backup_directory != NULL,
+                "Failed to create backup directory");
+
+    static uint8_t data[4 * sizeof(message_t)];
+    size_t len = 0;
+
+    message_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.header.magic = MSG_MAGIC;
+    rec.header.type = MSG_STATE_SYNC_DIR;
+    rec.header.sender = 0;
+
+    /* Page 7 moves to node 2, then node 3 shares it */
+    rec.payload.state_sync_dir.sync_seq = 10;
+    rec.payload.state_sync_dir.page_id = 7;
+    rec.payload.state_sync_dir.owner = 2;
+    rec.payload.state_sync_dir.num_sharers = 0;
+    len = append_sync_record(data, len, &rec);
+
+    rec.payload.state_sync_dir.sync_seq = 11;
+    rec.payload.state_sync_dir.num_sharers = 1;
+    rec.payload.state_sync_dir.sharers[0] = 3;
+    len = append_sync_record(data, len, &rec);
+
+    /* Page 8 is owned by node 1 */
+    rec.payload.state_sync_dir.sync_seq = 12;
+    rec.payload.state_sync_dir.page_id = 8;
+    rec.payload.state_sync_dir.owner = 1;
+    rec.payload.state_sync_dir.num_sharers = 0;
+    len = append_sync_record(data, len, &rec);
+
+    message_t batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.header.magic = MSG_MAGIC;
+    batch.header.type = MSG_STATE_SYNC_BATCH;
+    batch.header.sender = 0;
+    batch.payload.state_sync_batch.last_seq = 12;
+    batch.payload.state_sync_batch.num_records = 3;
+
+    rc = handle_state_sync_batch(&batch, data, len);
+    TEST_ASSERT(rc == DSM_SUCCESS, "Failed to handle state sync batch");
+
+    page_directory_t *backup_dir = (page_directory_t*)ctx->network.backup_state.backup_directory;
+    node_id_t owner;
+    TEST_ASSERT(ctx->network.backup_state.last_sync_seq == 0,
+                "Records applied before the snapshot (seq %lu)",
+                ctx->network.backup_state.last_sync_seq);
+
+    int applied = replication_snapshot();
+    TEST_ASSERT(applied == 2, "Snapshot applied %d records, expected 2", applied);
+
+    rc = directory_lookup(backup_dir, 7, &owner);
+    TEST_ASSERT(rc == DSM_SUCCESS, "Failed to lookup page 7 in backup directory");
+    TEST_ASSERT(owner == 2, "Owner mismatch: expected 2, got %u", owner);
+    rc = directory_lookup(backup_dir, 8, &owner);
+    TEST_ASSERT(rc == DSM_SUCCESS && owner == 1, "Page 8 owner mismatch: expected 1, got %u", owner);
+
+    node_id_t sharers[MAX_SHARERS];
+    int num_sharers;
+    rc = directory_get_sharers(backup_dir, 7, sharers, &num_sharers);
+    TEST_ASSERT(rc == DSM_SUCCESS, "Failed to get sharers from backup directory");
+    TEST_ASSERT(num_sharers == 1 && sharers[0] == 3,
+                "Sharers mismatch: expected [3], got %d sharers", num_sharers);
+    TEST_ASSERT(ctx->network.backup_state.last_sync_seq == 12,
+                "Sequence number not updated: expected 12, got %lu",
+                ctx->network.backup_state.last_sync_seq);
+
+    /* Already applied: must not roll the entry back */
+    rec.payload.state_sync_dir.sync_seq = 9;
+    rec.payload.state_sync_dir.page_id = 7;
+    rec.payload.state_sync_dir.owner = 0;
+    len = append_sync_record(data, 0, &rec);
+    batch.payload.state_sync_batch.last_seq = 9;
+    batch.payload.state_sync_batch.num_records = 1;
+    rc = handle_state_sync_batch(&batch, data, len);
+    TEST_ASSERT(rc == DSM_SUCCESS, "Failed to handle stale batch");
+    replication_snapshot();
+    rc = directory_lookup(backup_dir, 7, &owner);
+    TEST_ASSERT(rc == DSM_SUCCESS && owner == 2, "Stale record applied: owner %u", owner);
+
+    /* A batch cut off inside a record is rejected */
+    rc = handle_state_sync_batch(&batch, data, sizeof(state_sync_record_t) + 4);
+    TEST_ASSERT(rc == DSM_ERROR_INVALID, "Truncated batch accepted (rc=%d)", rc);
+    TEST_ASSERT(replication_snapshot() == 0, "Truncated batch logged");
+
+    directory_destroy(backup_dir);
+    ctx->network.backup_state.backup_directory = NULL;
+    dsm_context_cleanup();
+
+    TEST_PASS("Batched replication log");
+}
+
+/**
+ * Test 8: Heartbeats Only on Idle Links
+ *
+ * Verifies that a frame written to a peer stands in for its heartbeat.
+ * Tests:
+ * - No HEARTBEAT to a peer written to within half an interval
+ * - One HEARTBEAT to a peer idle for an interval, which counts as a write
+ */
+int test_idle_heartbeats(void) {
+    printf("\n[TEST 8] Heartbeats Only on Idle Links\n");
+
+    dsm_config_t config = {
+        .node_id = 2,
+        .num_nodes = 3,
+        .is_manager = false,
+        .port = 9008,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    dsm_context_t *ctx = dsm_get_context();
+    int rc = dsm_context_init(&config);
+    TEST_ASSERT(rc == DSM_SUCCESS, "Failed to initialize DSM context");
+
+    int fds[2];
+    TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0, "socketpair failed");
+    ctx->network.nodes[0].id = 0;
+    ctx->network.nodes[0].sockfd = fds[0];
+    ctx->network.nodes[0].connected = true;
+
+    const uint64_t interval = 2000000000ULL;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+    /* Busy link: the last frame already told the peer we are alive */
+    ctx->network.nodes[0].last_send_time = now - interval / 4;
+    int busy_sent = send_idle_heartbeats(now, interval);
+
+    /* Idle link: heartbeat it */
+    ctx->network.nodes[0].last_send_time = now - interval;
+    int idle_sent = send_idle_heartbeats(now, interval);
+    network_stop_senders();
+
+    message_t msg;
+    int recv_rc = network_recv(fds[1], &msg);
+    uint64_t last_send = ctx->network.nodes[0].last_send_time;
+
+    ctx->network.nodes[0].connected = false;
+    ctx->network.nodes[0].sockfd = -1;
+    close(fds[0]);
+    close(fds[1]);
+    dsm_context_cleanup();
+
+    TEST_ASSERT(busy_sent == 0, "Heartbeat sent on a busy link");
+    TEST_ASSERT(idle_sent == 1, "Expected 1 heartbeat on the idle link, got %d", idle_sent);
+    TEST_ASSERT(recv_rc == DSM_SUCCESS && msg.header.type == MSG_HEARTBEAT,
+                "Peer did not receive the HEARTBEAT");
+    TEST_ASSERT(last_send >= now, "Heartbeat write not recorded");
+
+    TEST_PASS("Idle heartbeats");
+}
+
+/**
+ * Test 9: Indirect Probing
+ *
+ * Verifies that a silent peer is probed through other nodes before it is
+ * declared failed.
+ * Tests:
+ * - The monitor asks a node it still hears from, not the silent one
+ * - Its PROBE_ACK resets the silent node's missed heartbeats
+ * - A helper probes over its own link and relays the answer
+ */
+int test_indirect_probe(void) {
+    printf("\n[TEST 9] Indirect Probing\n");
+
+    dsm_config_t config = {
+        .node_id = 0,
+        .num_nodes = 3,
+        .is_manager = true,
+        .port = 9009,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    /* Manager: node 1 went silent, node 2 did not */
+    dsm_context_t *ctx = dsm_get_context();
+    int rc = dsm_context_init(&config);
+    TEST_ASSERT(rc == DSM_SUCCESS, "Failed to initialize DSM context");
+
+    int fds[3][2];
+    for (int i = 1; i < 3; i++) {
+        TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]) == 0, "socketpair failed");
+        ctx->network.nodes[i].id = (node_id_t)i;
+        ctx->network.nodes[i].sockfd = fds[i][0];
+        ctx->network.nodes[i].connected = true;
+    }
+    ctx->network.nodes[1].missed_heartbeats = 1;
+
+    int asked = send_probe_requests(1);
+    network_stop_senders();
+    message_t request;
+    int request_rc = network_recv(fds[2][1], &request);
+
+    message_t ack;
+    memset(&ack, 0, sizeof(ack));
+    ack.header.magic = MSG_MAGIC;
+    ack.header.type = MSG_PROBE_ACK;
+    ack.header.sender = 2;
+    ack.payload.probe.origin = 0;
+    ack.payload.probe.target = 1;
+    int ack_rc = handle_probe_ack(&ack);
+    int missed = ctx->network.nodes[1].missed_heartbeats;
+
+    for (int i = 1; i < 3; i++) {
+        ctx->network.nodes[i].connected = false;
+        ctx->network.nodes[i].sockfd = -1;
+        close(fds[i][0]);
+        close(fds[i][1]);
+    }
+    dsm_context_cleanup();
+
+    TEST_ASSERT(asked == 1, "Expected 1 helper asked, got %d", asked);
+    TEST_ASSERT(request_rc == DSM_SUCCESS && request.header.type == MSG_PROBE_REQUEST &&
+                request.payload.probe.origin == 0 && request.payload.probe.target == 1,
+                "Helper did not receive the PROBE_REQUEST");
+    TEST_ASSERT(ack_rc == DSM_SUCCESS && missed == 0, "PROBE_ACK did not clear the misses");
+
+    /* Helper: node 0 asks it to probe node 1 */
+    config.node_id = 2;
+    config.is_manager = false;
+    rc = dsm_context_init(&config);
+    TEST_ASSERT(rc == DSM_SUCCESS, "Failed to initialize DSM context");
+    for (int i = 0; i < 2; i++) {
+        TEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]) == 0, "socketpair failed");
+        ctx->network.nodes[i].id = (node_id_t)i;
+        ctx->network.nodes[i].sockfd = fds[i][0];
+        ctx->network.nodes[i].connected = true;
+    }
+
+    request.header.sender = 0;
+    int probe_rc = handle_probe_request(&request);
+    ack.header.sender = 1;
+    int relay_rc = handle_probe_ack(&ack);
+    network_stop_senders();
+    message_t probe, relayed;
+    int recv_probe = network_recv(fds[1][1], &probe);
+    int recv_relayed = network_recv(fds[0][1], &relayed);
+
+    for (int i = 0; i < 2; i++) {
+        ctx->network.nodes[i].connected = false;
+        ctx->network.nodes[i].sockfd = -1;
+        close(fds[i][0]);
+        close(fds[i][1]);
+    }
+    dsm_context_cleanup();
+
+    TEST_ASSERT(probe_rc == DSM_SUCCESS && recv_probe == DSM_SUCCESS &&
+                probe.header.type == MSG_PROBE && probe.payload.probe.origin == 0,
+                "Silent node did not receive the PROBE");
+    TEST_ASSERT(relay_rc == DSM_SUCCESS && recv_relayed == DSM_SUCCESS &&
+                relayed.header.type == MSG_PROBE_ACK && relayed.header.sender == 2 &&
+                relayed.payload.probe.target == 1,
+                "PROBE_ACK was not relayed to the node that asked");
+
+    TEST_PASS("Indirect probing");
+}
+
 /**
  * Main test runner
  */
@@ -751,6 +1088,15 @@ int main(void) {
     /* Run Test 6 */
     test_in_flight_operations();
 
+    /* Run Test 7 */
+    test_state_sync_batch();
+
+    /* Run Test 8 */
+    test_idle_heartbeats();
+
+    /* Run Test 9 */
+    test_indirect_probe();
+
     /* Print summary */
     printf("\n");
     printf("═══════════════════════════════════════════════════════\n");
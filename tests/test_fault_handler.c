@@ -208,6 +208,71 @@ int test_sequential_access(void) {
     return 1;
 }
 
+typedef struct {
+    char *base;
+    int thread_id;
+} uffd_arg_t;
+
+static void* uffd_thread_func(void *arg) {
+    uffd_arg_t *a = (uffd_arg_t *)arg;
+    /* Each thread faults on its own pages, read first, then write */
+    for (int p = a->thread_id; p < 32; p += 4) {
+        volatile char *page = a->base + (size_t)p * PAGE_SIZE;
+        (void)page[0];
+        page[1] = (char)p;
+    }
+    return NULL;
+}
+
+int test_userfaultfd_engine(void) {
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 5000,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR,
+        .fault_engine = DSM_FAULT_USERFAULTFD,
+        .num_fault_threads = 2
+    };
+
+    dsm_init(&config);
+    if (dsm_get_fault_engine() != DSM_FAULT_USERFAULTFD) {
+        /* Kernel without userfaultfd: the SIGSEGV fallback still has to work */
+        printf("(SIGSEGV fallback) ");
+    }
+
+    char *data = dsm_malloc(32 * PAGE_SIZE);
+    if (!data) {
+        dsm_finalize();
+        return 0;
+    }
+
+    /* Untouched pages read as zeros, then read-only pages are upgraded */
+    pthread_t threads[4];
+    uffd_arg_t args[4];
+    for (int i = 0; i < 4; i++) {
+        args[i].base = data;
+        args[i].thread_id = i;
+        pthread_create(&threads[i], NULL, uffd_thread_func, &args[i]);
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    int ok = 1;
+    for (int p = 0; p < 32 && ok; p++) {
+        ok = data[(size_t)p * PAGE_SIZE] == 0 && data[(size_t)p * PAGE_SIZE + 1] == (char)p;
+    }
+
+    dsm_stats_t stats;
+    dsm_get_stats(&stats);
+    ok = ok && stats.page_faults >= 32;
+
+    dsm_free(data);
+    dsm_finalize();
+    return ok && dsm_get_fault_engine() == DSM_FAULT_SIGSEGV;
+}
+
 int main(void) {
     printf("=== Page Fault Handler Tests ===\n\n");
 
@@ -215,6 +280,7 @@ int main(void) {
     RUN_TEST(test_multiple_pages);
     RUN_TEST(test_multithreaded_faults);
     RUN_TEST(test_sequential_access);
+    RUN_TEST(test_userfaultfd_engine);
 
     printf("\n=== Test Summary ===\n");
     printf("Passed: %d\n", tests_passed);
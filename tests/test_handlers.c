@@ -5,8 +5,22 @@
 
 #include "dsm/dsm.h"
 #include "../src/network/handlers.h"
+#include "../src/network/network.h"
+#include "../src/network/handler_pool.h"
+#include "../src/network/page_codec.h"
+#include "../src/memory/permission.h"
+#include "../src/memory/page_index.h"
+#include "../src/consistency/directory.h"
+#include "../src/consistency/page_migration.h"
 #include "../src/sync/lock.h"
 #include "../src/core/log.h"
+#include "../src/core/dsm_context.h"
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -59,6 +73,401 @@ int test_page_request_handler() {
     return rc == DSM_SUCCESS ? 1 : 0;
 }
 
+/** Pretend a fetch of the page is in flight, so its PAGE_REPLY is accepted */
+static void set_request_pending(page_entry_t *entry) {
+    pthread_mutex_lock(page_entry_lock(entry));
+    entry->request_pending = true;
+    pthread_mutex_unlock(page_entry_lock(entry));
+}
+
+int test_page_reply_copy_current() {
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 15107,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    dsm_init(&config);
+    unsigned char *mem = dsm_malloc(PAGE_SIZE);
+    if (!mem) {
+        dsm_finalize();
+        return 0;
+    }
+
+    /* Write fault: the page gets a fresh nonzero version */
+    memset(mem, 0x17, PAGE_SIZE);
+
+    dsm_context_t *ctx = dsm_get_context();
+    page_table_t *table = NULL;
+    pthread_mutex_lock(&ctx->lock);
+    page_entry_t *entry = page_index_lookup_addr(mem, &table);
+    pthread_mutex_unlock(&ctx->lock);
+    if (!entry) {
+        dsm_free(mem);
+        dsm_finalize();
+        return 0;
+    }
+    pthread_mutex_lock(&table->lock);
+    uint64_t version = entry->version;
+    page_id_t page_id = entry->id;
+    pthread_mutex_unlock(&table->lock);
+
+    /* Data-less grant for the version we hold: contents must be kept */
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = MSG_PAGE_REPLY;
+    msg.header.sender = 1;
+    msg.payload.page_reply.page_id = page_id;
+    msg.payload.page_reply.access = ACCESS_READ;
+    msg.payload.page_reply.version = version;
+    msg.payload.page_reply.copy_current = 1;
+    memset(msg.payload.page_reply.data, 0x42, PAGE_SIZE);
+
+    set_request_pending(entry);
+    int rc_match = handle_page_reply(&msg);
+    bool kept = mem[0] == 0x17 && mem[PAGE_SIZE - 1] == 0x17;
+
+    /* Data-less grant for a version we do not hold is refused */
+    msg.payload.page_reply.version = version + 1;
+    set_request_pending(entry);
+    int rc_stale = handle_page_reply(&msg);
+
+    dsm_free(mem);
+    dsm_finalize();
+
+    return version != 0 && rc_match == DSM_SUCCESS && kept &&
+           message_wire_payload_size(&msg) < PAGE_SIZE && rc_stale == DSM_ERROR_INVALID ? 1 : 0;
+}
+
+int test_page_reply_unexpected_dropped() {
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 15108,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    dsm_init(&config);
+    unsigned char *mem = dsm_malloc(PAGE_SIZE);
+    if (!mem) {
+        dsm_finalize();
+        return 0;
+    }
+    memset(mem, 0x17, PAGE_SIZE);
+
+    dsm_context_t *ctx = dsm_get_context();
+    page_table_t *table = NULL;
+    pthread_mutex_lock(&ctx->lock);
+    page_entry_t *entry = page_index_lookup_addr(mem, &table);
+    pthread_mutex_unlock(&ctx->lock);
+    if (!entry) {
+        dsm_free(mem);
+        dsm_finalize();
+        return 0;
+    }
+
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = MSG_PAGE_REPLY;
+    msg.header.sender = 1;
+    msg.payload.page_reply.page_id = entry->id;
+    msg.payload.page_reply.access = ACCESS_READ;
+    msg.payload.page_reply.version = 1;
+    memset(msg.payload.page_reply.data, 0x42, PAGE_SIZE);
+
+    /* Nobody is fetching the page: a stray reply must not overwrite it */
+    int rc_stray = handle_page_reply(&msg);
+    bool kept_stray = mem[0] == 0x17;
+
+    /* A prefetch for a page that became present meanwhile is dropped too */
+    pthread_mutex_lock(page_entry_lock(entry));
+    entry->prefetch_pending = true;
+    pthread_mutex_unlock(page_entry_lock(entry));
+    int rc_prefetch = handle_page_reply(&msg);
+    bool kept_prefetch = mem[0] == 0x17;
+    pthread_mutex_lock(page_entry_lock(entry));
+    bool cleared = !entry->prefetch_pending;
+    pthread_mutex_unlock(page_entry_lock(entry));
+
+    dsm_free(mem);
+    dsm_finalize();
+
+    return rc_stray == DSM_SUCCESS && kept_stray &&
+           rc_prefetch == DSM_SUCCESS && kept_prefetch && cleared ? 1 : 0;
+}
+
+int test_prefetch_local() {
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 15109,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    dsm_init(&config);
+    unsigned char *mem = dsm_malloc(4 * PAGE_SIZE);
+    if (!mem) {
+        dsm_finalize();
+        return 0;
+    }
+
+    /* Batch requests only carry the pages in use */
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = MSG_PAGE_BATCH_REQUEST;
+    msg.payload.page_batch_request.num_pages = 3;
+    bool wire_ok = message_wire_payload_size(&msg) ==
+                   offsetof(page_batch_request_payload_t, pages) + 3 * sizeof(page_batch_entry_t);
+
+    /* Local pages: nothing to request, a write prefetch just upgrades them */
+    int rc_read = dsm_prefetch(mem + 10, 2 * PAGE_SIZE, ACCESS_READ);
+    int rc_write = dsm_prefetch(mem + PAGE_SIZE, 2 * PAGE_SIZE, ACCESS_WRITE);
+
+    dsm_stats_t before, after;
+    dsm_get_stats(&before);
+    mem[PAGE_SIZE] = 1;
+    mem[2 * PAGE_SIZE] = 2;
+    dsm_get_stats(&after);
+    bool no_faults = after.write_faults == before.write_faults;
+
+    int local = 0;
+    int rc_bad = dsm_prefetch(NULL, PAGE_SIZE, ACCESS_READ);
+    int rc_foreign = dsm_prefetch(&local, sizeof(local), ACCESS_READ);
+
+    dsm_free(mem);
+    dsm_finalize();
+
+    return wire_ok && rc_read == DSM_SUCCESS && rc_write == DSM_SUCCESS && no_faults &&
+           rc_bad == DSM_ERROR_INVALID && rc_foreign == DSM_ERROR_NOT_FOUND ? 1 : 0;
+}
+
+typedef struct {
+    int completions;
+    int last_status;
+    void *last_addr;
+} async_result_t;
+
+static void on_async_done(void *addr, size_t len, int status, void *arg) {
+    (void)len;
+    async_result_t *result = (async_result_t *)arg;
+    result->completions++;
+    result->last_status = status;
+    result->last_addr = addr;
+}
+
+int test_acquire_async_local() {
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 15114,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    dsm_init(&config);
+    unsigned char *mem = dsm_malloc(4 * PAGE_SIZE);
+    if (!mem) {
+        dsm_finalize();
+        return 0;
+    }
+
+    int fd = dsm_async_fd();
+    bool idle = dsm_poll(0) == 0;
+
+    dsm_stats_t start;
+    dsm_get_stats(&start);
+    async_result_t result = {0};
+    int rc_read = dsm_acquire_async(mem + 10, 2 * PAGE_SIZE, ACCESS_READ, on_async_done, &result);
+    int rc_write = dsm_acquire_async(mem + PAGE_SIZE, 2 * PAGE_SIZE, ACCESS_WRITE, on_async_done, &result);
+
+    /* Completions arrive through the descriptor, one per dsm_poll(1) */
+    int polled = 0;
+    for (int i = 0; i < 100 && polled < 2; i++) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        if (poll(&pfd, 1, 20) > 0) {
+            polled += dsm_poll(1);
+        }
+    }
+    bool drained = dsm_poll(0) == 0;
+
+    dsm_stats_t before, after;
+    dsm_get_stats(&before);
+    mem[PAGE_SIZE] = 1;
+    mem[2 * PAGE_SIZE] = 2;
+    dsm_get_stats(&after);
+    bool no_faults = after.write_faults == before.write_faults;
+
+    int local = 0;
+    int rc_bad = dsm_acquire_async(mem, PAGE_SIZE, (access_type_t)7, NULL, NULL);
+    int rc_foreign = dsm_acquire_async(&local, sizeof(local), ACCESS_READ, NULL, NULL);
+
+    dsm_free(mem);
+    dsm_finalize();
+
+    return fd >= 0 && idle && rc_read == DSM_SUCCESS && rc_write == DSM_SUCCESS &&
+           polled == 2 && drained && result.completions == 2 &&
+           result.last_status == DSM_SUCCESS && result.last_addr == mem + PAGE_SIZE &&
+           after.async_acquires - start.async_acquires == 2 &&
+           no_faults && rc_bad == DSM_ERROR_INVALID && rc_foreign == DSM_ERROR_NOT_FOUND ? 1 : 0;
+}
+
+int test_page_batch_reply_install() {
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 15110,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    dsm_init(&config);
+    unsigned char *mem = dsm_malloc(3 * PAGE_SIZE);
+    if (!mem) {
+        dsm_finalize();
+        return 0;
+    }
+
+    dsm_context_t *ctx = dsm_get_context();
+    page_table_t *table = NULL;
+    pthread_mutex_lock(&ctx->lock);
+    page_entry_t *first = page_index_lookup_addr(mem, &table);
+    pthread_mutex_unlock(&ctx->lock);
+    if (!first) {
+        dsm_free(mem);
+        dsm_finalize();
+        return 0;
+    }
+
+    /* Three prefetched pages arriving in one bulk frame: raw, zero, LZ */
+    static uint8_t data[3 * PAGE_SIZE];
+    static uint8_t pattern[PAGE_SIZE];
+    memset(pattern, 0, PAGE_SIZE);
+    pattern[7] = 0x33;
+
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = MSG_PAGE_BATCH_REPLY;
+    msg.header.sender = 1;
+    msg.payload.page_batch_reply.requester = 0;
+    msg.payload.page_batch_reply.num_pages = 3;
+    page_batch_reply_entry_t *pages = msg.payload.page_batch_reply.pages;
+
+    memset(data, 0x21, PAGE_SIZE);
+    pages[0].encoding = PAGE_ENCODING_RAW;
+    pages[0].data_len = PAGE_SIZE;
+    pages[1].encoding = PAGE_ENCODING_ZERO;
+    pages[1].data_len = 0;
+    size_t lz_len = page_codec_encode(pattern, DSM_COMPRESSION_LZ, data + PAGE_SIZE, &pages[2].encoding);
+    pages[2].data_len = (uint16_t)lz_len;
+
+    for (int i = 0; i < 3; i++) {
+        page_entry_t *entry = &first[i];
+        pages[i].page_id = entry->id;
+        pages[i].version = 5;
+        set_page_permission(entry->local_addr, PAGE_PERM_NONE);
+        pthread_mutex_lock(page_entry_lock(entry));
+        entry->prefetch_pending = true;
+        pthread_mutex_unlock(page_entry_lock(entry));
+    }
+
+    /* A frame whose data is shorter than its entries claim is rejected */
+    int rc_short = handle_page_batch_reply(&msg, data, PAGE_SIZE);
+    int rc = handle_page_batch_reply(&msg, data, PAGE_SIZE + lz_len);
+
+    bool installed = pages[2].encoding == PAGE_ENCODING_LZ;
+    for (int i = 0; i < 3; i++) {
+        pthread_mutex_lock(page_entry_lock(&first[i]));
+        installed = installed && !first[i].prefetch_pending;
+        pthread_mutex_unlock(page_entry_lock(&first[i]));
+        pthread_mutex_lock(&table->lock);
+        installed = installed && first[i].state == PAGE_STATE_READ_ONLY && first[i].version == 5;
+        pthread_mutex_unlock(&table->lock);
+    }
+    installed = installed && mem[0] == 0x21 && mem[PAGE_SIZE - 1] == 0x21 &&
+                mem[PAGE_SIZE] == 0 && mem[2 * PAGE_SIZE + 7] == 0x33 &&
+                mem[2 * PAGE_SIZE + 8] == 0;
+
+    dsm_free(mem);
+    dsm_finalize();
+
+    return rc_short == DSM_ERROR_INVALID && rc == DSM_SUCCESS && installed ? 1 : 0;
+}
+
+int test_page_block_reply_install() {
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 15111,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    dsm_init(&config);
+    size_t block = 4 * PAGE_SIZE;
+    unsigned char *mem = dsm_malloc_ex(2 * block, DSM_COMPRESSION_NONE, block);
+    if (!mem) {
+        dsm_finalize();
+        return 0;
+    }
+
+    dsm_context_t *ctx = dsm_get_context();
+    page_table_t *table = NULL;
+    pthread_mutex_lock(&ctx->lock);
+    page_entry_t *entry = page_index_lookup_addr(mem + block + PAGE_SIZE, &table);
+    pthread_mutex_unlock(&ctx->lock);
+    if (!entry || table->num_pages != 2 || entry != &table->entries[1]) {
+        dsm_free(mem);
+        dsm_finalize();
+        return 0;
+    }
+
+    /* The second 16KB block arrives as one reply with bulk data */
+    static uint8_t data[4 * PAGE_SIZE];
+    memset(data, 0x5A, sizeof(data));
+    data[sizeof(data) - 1] = 0x77;
+
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = MSG_PAGE_REPLY;
+    msg.header.sender = 1;
+    msg.payload.page_reply.page_id = entry->id;
+    msg.payload.page_reply.version = 9;
+    msg.payload.page_reply.access = ACCESS_READ;
+    msg.payload.page_reply.requester = 0;
+    msg.payload.page_reply.encoding = PAGE_ENCODING_RAW;
+    msg.payload.page_reply.block_size = (uint32_t)block;
+
+    set_page_permission(entry->local_addr, PAGE_PERM_NONE);
+
+    /* A single-page reply for a block page is refused */
+    msg.payload.page_reply.block_size = 0;
+    set_request_pending(entry);
+    int rc_single = handle_page_reply_data(&msg, data, PAGE_SIZE);
+
+    msg.payload.page_reply.block_size = (uint32_t)block;
+    set_request_pending(entry);
+    int rc_short = handle_page_reply_data(&msg, data, PAGE_SIZE);
+    set_request_pending(entry);
+    int rc = handle_page_reply_data(&msg, data, block);
+
+    /* The whole block became readable at once */
+    pthread_mutex_lock(&table->lock);
+    bool installed = entry->state == PAGE_STATE_READ_ONLY && entry->version == 9;
+    pthread_mutex_unlock(&table->lock);
+    installed = installed && mem[block] == 0x5A && mem[block + 2 * PAGE_SIZE + 1] == 0x5A &&
+                mem[2 * block - 1] == 0x77;
+
+    dsm_free(mem);
+    dsm_finalize();
+
+    return rc_single == DSM_ERROR_INVALID && rc_short == DSM_ERROR_INVALID &&
+           rc == DSM_SUCCESS && installed ? 1 : 0;
+}
+
 int test_invalidate_handler() {
     dsm_config_t config = {
         .node_id = 0,
@@ -94,6 +503,194 @@ int test_invalidate_handler() {
     return rc == DSM_SUCCESS ? 1 : 0;
 }
 
+int test_invalidate_fanout_handler() {
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 15112,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    dsm_init(&config);
+    void *mem = dsm_malloc(PAGE_SIZE);
+    if (!mem) {
+        dsm_finalize();
+        return 0;
+    }
+    ((int*)mem)[0] = 42;
+
+    dsm_context_t *ctx = dsm_get_context();
+    page_table_t *table = NULL;
+    pthread_mutex_lock(&ctx->lock);
+    page_entry_t *entry = page_index_lookup_addr(mem, &table);
+    pthread_mutex_unlock(&ctx->lock);
+    if (!entry) {
+        dsm_free(mem);
+        dsm_finalize();
+        return 0;
+    }
+
+    /* Node 1 owns the page and writes it; the manager and an unreachable
+     * node hold copies */
+    directory_set_owner(get_page_directory(), entry->id, 1);
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = MSG_INVALIDATE_FANOUT;
+    msg.header.sender = 1;
+    msg.payload.invalidate_fanout.page_id = entry->id;
+    msg.payload.invalidate_fanout.writer = 1;
+    msg.payload.invalidate_fanout.exclude = DSM_NODE_NONE;
+    msg.payload.invalidate_fanout.num_sharers = 2;
+    msg.payload.invalidate_fanout.sharers[0] = 0;
+    msg.payload.invalidate_fanout.sharers[1] = 7;
+    bool wire_ok = message_wire_payload_size(&msg) ==
+                   offsetof(invalidate_fanout_payload_t, sharers) + 2 * sizeof(node_id_t);
+
+    handle_invalidate_fanout(&msg);
+
+    pthread_mutex_lock(&table->lock);
+    bool invalidated = entry->state == PAGE_STATE_INVALID && entry->owner == 1;
+    pthread_mutex_unlock(&table->lock);
+
+    msg.payload.invalidate_fanout.num_sharers = MAX_SHARERS + 1;
+    int rc_bad = handle_invalidate_fanout(&msg);
+
+    dsm_free(mem);
+    dsm_finalize();
+
+    return wire_ok && invalidated && rc_bad == DSM_ERROR_INVALID ? 1 : 0;
+}
+
+int test_page_upgrade_handler() {
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 15113,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    dsm_init(&config);
+
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = MSG_PAGE_UPGRADE;
+    msg.header.sender = 1;
+    msg.payload.page_upgrade.request.page_id = 0;
+    msg.payload.page_upgrade.request.access = ACCESS_WRITE;
+    msg.payload.page_upgrade.request.requester = 1;
+    msg.payload.page_upgrade.owner = 0;
+    msg.payload.page_upgrade.num_sharers = 3;
+    bool wire_ok = message_wire_payload_size(&msg) ==
+                   offsetof(page_upgrade_payload_t, sharers) + 3 * sizeof(node_id_t);
+
+    /* Only write requests can be upgrades, with a bounded sharer list */
+    msg.payload.page_upgrade.request.access = ACCESS_READ;
+    int rc_read = handle_page_upgrade(&msg);
+    msg.payload.page_upgrade.request.access = ACCESS_WRITE;
+    msg.payload.page_upgrade.num_sharers = MAX_SHARERS + 1;
+    int rc_long = handle_page_upgrade(&msg);
+
+    dsm_finalize();
+
+    return wire_ok && rc_read == DSM_ERROR_INVALID && rc_long == DSM_ERROR_INVALID ? 1 : 0;
+}
+
+/** Bytes waiting to be read on a socket */
+static int socket_pending(int sockfd) {
+    int avail = 0;
+    return ioctl(sockfd, FIONREAD, &avail) == 0 ? avail : -1;
+}
+
+/**
+ * Two workers write the manager's page back to back: the second write
+ * waits for the first writer's OWNER_UPDATE instead of being sent to an
+ * owner that is about to give the page away
+ */
+int test_write_handoff_serialized() {
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 15116,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR,
+        .disable_shm = true
+    };
+
+    dsm_init(&config);
+    void *mem = dsm_malloc(PAGE_SIZE);
+    int sv[3][2];
+    if (!mem || socketpair(AF_UNIX, SOCK_STREAM, 0, sv[1]) != 0 ||
+        socketpair(AF_UNIX, SOCK_STREAM, 0, sv[2]) != 0) {
+        dsm_finalize();
+        return 0;
+    }
+    ((int*)mem)[0] = 42;
+
+    dsm_context_t *ctx = dsm_get_context();
+    for (int n = 1; n <= 2; n++) {
+        ctx->network.nodes[n].sockfd = sv[n][0];
+        ctx->network.nodes[n].connected = true;
+    }
+    pthread_mutex_lock(&ctx->lock);
+    page_entry_t *entry = page_index_lookup_addr(mem, NULL);
+    pthread_mutex_unlock(&ctx->lock);
+    page_id_t page_id = entry ? entry->id : 0;
+
+    message_t upgrade;
+    memset(&upgrade, 0, sizeof(upgrade));
+    upgrade.header.magic = MSG_MAGIC;
+    upgrade.header.type = MSG_PAGE_UPGRADE;
+    upgrade.payload.page_upgrade.request.page_id = page_id;
+    upgrade.payload.page_upgrade.request.access = ACCESS_WRITE;
+    upgrade.payload.page_upgrade.owner = 0;
+
+    /* Node 1 gets the page from the manager */
+    upgrade.header.sender = 1;
+    upgrade.payload.page_upgrade.request.requester = 1;
+    handle_page_upgrade(&upgrade);
+    message_t received;
+    int ok = entry && network_recv(sv[1][1], &received) == DSM_SUCCESS &&
+             received.header.type == MSG_PAGE_REPLY && received.payload.page_reply.page_id == page_id;
+
+    /* Node 2's write arrives before node 1 reported: nothing goes out */
+    upgrade.header.sender = 2;
+    upgrade.payload.page_upgrade.request.requester = 2;
+    handle_page_upgrade(&upgrade);
+    ok = ok && socket_pending(sv[1][1]) == 0 && socket_pending(sv[2][1]) == 0;
+
+    /* Node 1 has it: node 2's request goes to node 1 */
+    message_t update;
+    memset(&update, 0, sizeof(update));
+    update.header.magic = MSG_MAGIC;
+    update.header.type = MSG_OWNER_UPDATE;
+    update.header.sender = 1;
+    update.payload.owner_update.page_id = page_id;
+    update.payload.owner_update.new_owner = 1;
+    handle_owner_update(&update);
+    ok = ok && network_recv(sv[1][1], &received) == DSM_SUCCESS &&
+         received.header.type == MSG_PAGE_REQUEST &&
+         received.payload.page_request.requester == 2 &&
+         received.payload.page_request.access == ACCESS_WRITE;
+
+    /* Sent back by node 1, the request is not bounced to node 1 again,
+     * nor answered with an error: it waits for the next owner to report */
+    received.header.sender = 1;
+    handle_page_request(&received);
+    ok = ok && socket_pending(sv[1][1]) == 0 && socket_pending(sv[2][1]) == 0;
+
+    for (int n = 1; n <= 2; n++) {
+        ctx->network.nodes[n].connected = false;
+        ctx->network.nodes[n].sockfd = -1;
+        close(sv[n][0]);
+        close(sv[n][1]);
+    }
+    dsm_free(mem);
+    dsm_finalize();
+    return ok;
+}
+
 int test_message_dispatch() {
     dsm_config_t config = {
         .node_id = 0,
@@ -189,14 +786,262 @@ int test_barrier_handlers() {
     return rc == DSM_SUCCESS ? 1 : 0;
 }
 
+int test_barrier_signal_handler() {
+    dsm_config_t config = {
+        .node_id = 1,
+        .port = 15115,
+        .num_nodes = 1,
+        .is_manager = false,
+        .log_level = LOG_LEVEL_ERROR,
+        .barrier_algorithm = DSM_BARRIER_DISSEMINATION
+    };
+
+    dsm_init(&config);
+    dsm_context_t *ctx = dsm_get_context();
+
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = MSG_BARRIER_SIGNAL;
+    msg.header.sender = 0;
+    msg.payload.barrier_signal.barrier_id = 77;
+    msg.payload.barrier_signal.from = 0;
+    msg.payload.barrier_signal.round = 1;
+    msg.payload.barrier_signal.parity = 1;
+
+    /* Only the manager relays signals for other nodes */
+    msg.payload.barrier_signal.to = 2;
+    int misrouted_rc = dispatch_message(&msg, 0);
+
+    /* A signal of the next episode, before this node entered the barrier */
+    msg.payload.barrier_signal.to = 1;
+    int rc = dispatch_message(&msg, 0);
+
+    pthread_mutex_lock(&ctx->barrier_mgr.lock);
+    dsm_barrier_t *barrier = barrier_index_find(&ctx->barrier_mgr, 77);
+    pthread_mutex_unlock(&ctx->barrier_mgr.lock);
+    int ok = misrouted_rc == DSM_ERROR_INVALID && rc == DSM_SUCCESS && barrier &&
+             barrier->signals[0] == 0 && barrier->signals[1] == 1u << 1;
+
+    dsm_finalize();
+    return ok;
+}
+
+int test_concurrent_dir_replies() {
+    dsm_config_t config = {
+        .node_id = 1,
+        .port = 15105,
+        .num_nodes = 1,
+        .is_manager = false,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    dsm_init(&config);
+    dsm_context_t *ctx = dsm_get_context();
+
+    /* Two queries for the same page outstanding at once */
+    uint64_t req_a = 0, req_b = 0;
+    int slot_a = pending_query_register(&ctx->network.dir_queries, 7, 1, &req_a);
+    int slot_b = pending_query_register(&ctx->network.dir_queries, 7, 1, &req_b);
+    if (slot_a < 0 || slot_b < 0 || req_a == req_b) {
+        dsm_finalize();
+        return 0;
+    }
+
+    /* Replies arrive out of order */
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = MSG_DIR_REPLY;
+    msg.payload.dir_reply.page_id = 7;
+    msg.payload.dir_reply.owner = 3;
+    msg.payload.dir_reply.request_id = req_b;
+    dispatch_message(&msg, 0);
+
+    msg.payload.dir_reply.owner = 2;
+    msg.payload.dir_reply.request_id = req_a;
+    dispatch_message(&msg, 0);
+
+    pending_query_t res_a, res_b;
+    int rc_a = pending_query_wait(&ctx->network.dir_queries, slot_a, 1, &res_a);
+    int rc_b = pending_query_wait(&ctx->network.dir_queries, slot_b, 1, &res_b);
+
+    /* A stale reply with no matching slot is dropped */
+    msg.payload.dir_reply.request_id = req_a;
+    dispatch_message(&msg, 0);
+    int in_use = ctx->network.dir_queries.num_in_use;
+
+    dsm_finalize();
+    return rc_a == DSM_SUCCESS && rc_b == DSM_SUCCESS &&
+           res_a.owner == 2 && res_b.owner == 3 && in_use == 0 ? 1 : 0;
+}
+
+int test_promotion_aborts_queries() {
+    dsm_config_t config = {
+        .node_id = 2,
+        .port = 15107,
+        .num_nodes = 1,
+        .is_manager = false,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    dsm_init(&config);
+    dsm_context_t *ctx = dsm_get_context();
+
+    uint64_t req = 0;
+    int slot = pending_query_register(&ctx->network.dir_queries, 9, 1, &req);
+    if (slot < 0) {
+        dsm_finalize();
+        return 0;
+    }
+
+    /* The old manager will never answer: the waiter fails at once */
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = MSG_MANAGER_PROMOTION;
+    msg.header.sender = 1;
+    msg.payload.manager_promotion.new_manager_id = 1;
+    msg.payload.manager_promotion.old_manager_id = 0;
+    dispatch_message(&msg, 0);
+
+    pending_query_t res;
+    int rc = pending_query_wait(&ctx->network.dir_queries, slot, 5, &res);
+    node_id_t manager = ctx->network.backup_state.current_manager;
+    int in_use = ctx->network.dir_queries.num_in_use;
+
+    dsm_finalize();
+    return rc == DSM_ERROR_NETWORK && manager == 1 && in_use == 0 ? 1 : 0;
+}
+
+int test_node_roster() {
+    dsm_config_t config = {
+        .node_id = 2,
+        .port = 15108,
+        .num_nodes = 1,
+        .is_manager = false,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    dsm_init(&config);
+    dsm_context_t *ctx = dsm_get_context();
+
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = MSG_NODE_ROSTER;
+    msg.header.sender = 0;
+
+    /* An empty roster is malformed and ends no bootstrap */
+    int bad_rc = dispatch_message(&msg, 0);
+    int size_before = ctx->network.roster_size;
+
+    msg.payload.node_roster.num_members = 3;
+    msg.payload.node_roster.members[0] = 0;
+    msg.payload.node_roster.members[1] = 1;
+    msg.payload.node_roster.members[2] = 2;
+    int rc = dispatch_message(&msg, 0);
+
+    /* Only the listed members go on the wire */
+    size_t wire = message_wire_payload_size(&msg);
+
+    /* The bulk form carries the address each worker takes peer links on */
+    roster_address_t addrs[3] = {{0, 0}, {htonl(INADDR_LOOPBACK), 15109}, {htonl(INADDR_LOOPBACK), 15110}};
+    int bulk_rc = dispatch_bulk_message(&msg, (const uint8_t *)addrs, sizeof(addrs));
+    node_info_t *peer = &ctx->network.nodes[1];
+    node_info_t *self = &ctx->network.nodes[2];
+
+    int ok = bad_rc == DSM_ERROR_INVALID && size_before == 0 && rc == DSM_SUCCESS &&
+             ctx->network.roster_size == 3 &&
+             wire == offsetof(node_roster_payload_t, members) + 3 * sizeof(node_id_t) &&
+             bulk_rc == DSM_SUCCESS && peer->peer_addr == htonl(INADDR_LOOPBACK) &&
+             peer->peer_port == 15109 && self->peer_port == 0;
+
+    dsm_finalize();
+    return ok;
+}
+
+int test_handler_pool_dispatch() {
+    dsm_config_t config = {
+        .node_id = 1,
+        .port = 15106,
+        .num_nodes = 1,
+        .is_manager = false,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    dsm_init(&config);
+    dsm_context_t *ctx = dsm_get_context();
+
+    if (handler_pool_start(4) != DSM_SUCCESS) {
+        dsm_finalize();
+        return 0;
+    }
+
+    /* Queries for several pages, completed by pool workers */
+    enum { NUM_QUERIES = 8 };
+    int slots[NUM_QUERIES];
+    uint64_t reqs[NUM_QUERIES];
+    for (int i = 0; i < NUM_QUERIES; i++) {
+        slots[i] = pending_query_register(&ctx->network.dir_queries, 100 + i, 1, &reqs[i]);
+    }
+
+    message_t msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = MSG_DIR_REPLY;
+    int submitted = 0;
+    for (int i = 0; i < NUM_QUERIES; i++) {
+        msg.payload.dir_reply.page_id = 100 + i;
+        msg.payload.dir_reply.owner = (node_id_t)(i % 4);
+        msg.payload.dir_reply.request_id = reqs[i];
+        if (handler_pool_submit(&msg) == DSM_SUCCESS) {
+            submitted++;
+        }
+    }
+
+    int ok = 0;
+    for (int i = 0; i < NUM_QUERIES; i++) {
+        pending_query_t res;
+        if (pending_query_wait(&ctx->network.dir_queries, slots[i], 2, &res) == DSM_SUCCESS &&
+            res.owner == (node_id_t)(i % 4)) {
+            ok++;
+        }
+    }
+
+    /* Membership traffic has no shard and stays on the poller */
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = MSG_NODE_JOIN;
+    int join_rejected = handler_pool_submit(&msg) != DSM_SUCCESS;
+
+    handler_pool_stop();
+
+    /* Stopped pool rejects everything */
+    msg.header.type = MSG_DIR_REPLY;
+    int stopped_rejected = handler_pool_submit(&msg) != DSM_SUCCESS;
+
+    dsm_finalize();
+    return submitted == NUM_QUERIES && ok == NUM_QUERIES &&
+           join_rejected && stopped_rejected ? 1 : 0;
+}
+
 int main(void) {
     printf("=== Protocol Handler Tests ===\n\n");
 
     RUN_TEST(test_page_request_handler);
+    RUN_TEST(test_page_reply_copy_current);
+    RUN_TEST(test_page_reply_unexpected_dropped);
+    RUN_TEST(test_prefetch_local);
+    RUN_TEST(test_acquire_async_local);
+    RUN_TEST(test_page_batch_reply_install);
+    RUN_TEST(test_page_block_reply_install);
     RUN_TEST(test_invalidate_handler);
+    RUN_TEST(test_invalidate_fanout_handler);
+    RUN_TEST(test_page_upgrade_handler);
+    RUN_TEST(test_write_handoff_serialized);
     RUN_TEST(test_message_dispatch);
     RUN_TEST(test_lock_handlers);
     RUN_TEST(test_barrier_handlers);
+    RUN_TEST(test_barrier_signal_handler);
+    RUN_TEST(test_concurrent_dir_replies);
+    RUN_TEST(test_promotion_aborts_queries);
+    RUN_TEST(test_node_roster);
+    RUN_TEST(test_handler_pool_dispatch);
 
     printf("\n=== Test Summary ===\n");
     printf("Passed: %d\n", tests_passed);
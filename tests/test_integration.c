@@ -550,6 +550,97 @@ int test_performance_profiling() {
     return 1;
 }
 
+/**
+ * Test 10.6.2: Asynchronous logging
+ * Lines from several threads are formatted by the writer thread exactly
+ * as the synchronous path would, none are lost, and each thread's lines
+ * keep their order.
+ */
+#define LOG_TEST_THREADS 4
+#define LOG_TEST_LINES 600
+
+static void* async_log_worker(void *arg) {
+    int id = (int)(long)arg;
+    for (int i = 0; i < LOG_TEST_LINES; i++) {
+        LOG_INFO("async-test thread=%d line=%d", id, i);
+    }
+    return NULL;
+}
+
+int test_async_logging() {
+    FILE *capture = tmpfile();
+    if (!capture) {
+        return 0;
+    }
+    fflush(stderr);
+    int saved_stderr = dup(STDERR_FILENO);
+    dup2(fileno(capture), STDERR_FILENO);
+
+    log_level_t saved_level = log_get_level();
+    log_set_level(LOG_LEVEL_INFO);
+    int ok = log_start_async() == 0;
+
+    const char *name = "pages";
+    LOG_INFO("fmt %d|%5u|%-4s|%lu|%zu|%x|%c|%.2f|%*d|%%|%s", -7, 42u, name, 123456789012UL,
+             (size_t)99, 255u, 'Z', 3.14159, 6, 17, (const char *)NULL);
+    char big[400];
+    memset(big, 'b', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    LOG_INFO("long %s end", big);
+    LOG_INFO("wide %1500d end", 5);
+
+    pthread_t threads[LOG_TEST_THREADS];
+    for (long t = 0; t < LOG_TEST_THREADS; t++) {
+        pthread_create(&threads[t], NULL, async_log_worker, (void*)t);
+    }
+    for (int t = 0; t < LOG_TEST_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    log_stop_async();
+    log_set_level(saved_level);
+    fflush(stderr);
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+
+    /* Check the captured output */
+    int next[LOG_TEST_THREADS] = {0};
+    int formatted = 0;
+    int long_whole = 0;
+    int wide_whole = 0;
+    char line[2048];
+    rewind(capture);
+    while (fgets(line, sizeof(line), capture)) {
+        const char *msg = strstr(line, " - ");
+        if (!msg) {
+            continue;
+        }
+        msg += 3;
+        int id, n;
+        if (sscanf(msg, "async-test thread=%d line=%d", &id, &n) == 2) {
+            if (id < 0 || id >= LOG_TEST_THREADS || n != next[id]) {
+                ok = 0;
+            } else {
+                next[id]++;
+            }
+        } else if (strcmp(msg, "fmt -7|   42|pages|123456789012|99|ff|Z|3.14|    17|%|(null)\n") == 0) {
+            formatted = 1;
+        } else if (strncmp(msg, "long bbb", 8) == 0) {
+            /* Strings past a record's room are not cut short */
+            long_whole = strlen(msg) == 5 + strlen(big) + 5 && strcmp(msg + 5 + strlen(big), " end\n") == 0;
+        } else if (strncmp(msg, "wide ", 5) == 0) {
+            /* Nor are lines past the writer's buffer */
+            wide_whole = strlen(msg) == 5 + 1500 + 5 && strcmp(msg + 5 + 1500, " end\n") == 0;
+        }
+    }
+    fclose(capture);
+
+    for (int t = 0; t < LOG_TEST_THREADS; t++) {
+        ok = ok && next[t] == LOG_TEST_LINES;
+    }
+    return ok && formatted && long_whole && wide_whole;
+}
+
 /* ================================================================
  * Main Test Runner
  * ================================================================ */
@@ -569,6 +660,7 @@ int main() {
 
     printf("\n--- Task 10.6: Performance Profiling ---\n");
     RUN_TEST(test_performance_profiling);
+    RUN_TEST(test_async_logging);
 
     printf("\n=== Test Summary ===\n");
     printf("Passed: %d\n", tests_passed);
@@ -6,9 +6,23 @@
 #include "dsm/dsm.h"
 #include "../src/core/log.h"
 #include "../src/memory/permission.h"
+#include "../src/memory/page_index.h"
+#include "../src/core/stats.h"
+#include "../src/core/trace.h"
+#include "../src/core/sharing_profile.h"
+#include "../src/core/metrics.h"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 static int tests_passed = 0;
 static int tests_failed = 0;
@@ -124,6 +138,71 @@ int test_page_permissions(void) {
     return 1;
 }
 
+int test_permission_batch(void) {
+    dsm_config_t config = {
+        .node_id = 1,
+        .port = 5000,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    dsm_init(&config);
+
+    char *ptr = dsm_malloc(8 * PAGE_SIZE);
+    page_table_t *table = NULL;
+    page_entry_t *entries = ptr ? page_index_lookup_addr(ptr, &table) : NULL;
+    if (!entries) {
+        dsm_finalize();
+        return 0;
+    }
+
+    /* Pages added in address order form one run */
+    dsm_stats_t before, after;
+    dsm_get_stats(&before);
+    perm_batch_t batch;
+    perm_batch_init(&batch);
+    int ok = 1;
+    for (int i = 0; i < 8; i++) {
+        ok = ok && perm_batch_add(&batch, table, &entries[i], PAGE_PERM_READ_WRITE) == DSM_SUCCESS;
+    }
+    ok = ok && perm_batch_apply(&batch) == DSM_SUCCESS;
+    dsm_get_stats(&after);
+    ok = ok && after.batched_mprotects - before.batched_mprotects == 1;
+    for (int i = 0; i < 8; i++) {
+        ok = ok && entries[i].state == PAGE_STATE_READ_WRITE && entries[i].version != 0;
+        ptr[i * PAGE_SIZE] = (char)i;
+    }
+
+    /* Out of order adds still merge: [0-3] READ, [4-5] NONE, [7] NONE */
+    const page_perm_t perms[] = { PAGE_PERM_NONE, PAGE_PERM_NONE, PAGE_PERM_READ, PAGE_PERM_READ,
+                                  PAGE_PERM_READ, PAGE_PERM_READ, PAGE_PERM_NONE };
+    const int pages[] = { 5, 4, 0, 1, 2, 3, 7 };
+    dsm_get_stats(&before);
+    for (int i = 0; i < 7; i++) {
+        ok = ok && perm_batch_add(&batch, table, &entries[pages[i]], perms[i]) == DSM_SUCCESS;
+    }
+    ok = ok && perm_batch_apply(&batch) == DSM_SUCCESS;
+    dsm_get_stats(&after);
+    ok = ok && after.batched_pages - before.batched_pages == 7;
+    ok = ok && after.batched_mprotects - before.batched_mprotects == 3;
+    ok = ok && entries[0].state == PAGE_STATE_READ_ONLY && entries[3].state == PAGE_STATE_READ_ONLY;
+    ok = ok && entries[4].state == PAGE_STATE_INVALID && entries[7].state == PAGE_STATE_INVALID;
+    ok = ok && entries[6].state == PAGE_STATE_READ_WRITE;
+
+    /* Read-only and untouched pages are accessed without faults */
+    ok = ok && ptr[3 * PAGE_SIZE] == 3;
+    ptr[6 * PAGE_SIZE] = 60;
+    dsm_stats_t end;
+    dsm_get_stats(&end);
+    ok = ok && end.page_faults == after.page_faults;
+
+    perm_batch_destroy(&batch);
+    dsm_free(ptr);
+    dsm_finalize();
+    return ok;
+}
+
 int test_stats(void) {
     dsm_config_t config = {
         .node_id = 1,
@@ -159,13 +238,765 @@ int test_stats(void) {
     return 1;
 }
 
+#define STATS_THREADS 8
+#define STATS_EVENTS 10000
+
+static void* stats_worker(void *arg) {
+    uint64_t latency = (uint64_t)(uintptr_t)arg;
+    for (int i = 0; i < STATS_EVENTS; i++) {
+        STATS_INC(lock_acquires);
+    }
+    stats_record_fault_latency(latency);
+    return NULL;
+}
+
+int test_stats_threads(void) {
+    dsm_config_t config = {
+        .node_id = 1,
+        .port = 5000,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    dsm_init(&config);
+    dsm_reset_stats();
+
+    /* Each thread counts into its own block; dsm_get_stats() sums them */
+    pthread_t threads[STATS_THREADS];
+    for (int i = 0; i < STATS_THREADS; i++) {
+        pthread_create(&threads[i], NULL, stats_worker, (void*)(uintptr_t)(100 + i));
+    }
+    for (int i = 0; i < STATS_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    dsm_stats_t stats;
+    dsm_get_stats(&stats);
+    int ok = stats.lock_acquires == (uint64_t)STATS_THREADS * STATS_EVENTS &&
+             stats.min_fault_latency_ns == 100 &&
+             stats.max_fault_latency_ns == 100 + STATS_THREADS - 1;
+
+    dsm_reset_stats();
+    dsm_get_stats(&stats);
+    ok = ok && stats.lock_acquires == 0 && stats.max_fault_latency_ns == 0;
+
+    dsm_finalize();
+    return ok;
+}
+
+int test_latency_histogram(void) {
+    dsm_config_t config = {
+        .node_id = 1,
+        .port = 5000,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    dsm_init(&config);
+    dsm_reset_stats();
+
+    /* 99% fast local read upgrades, 1% slow forwarded write fetches */
+    for (int i = 0; i < 990; i++) {
+        stats_record_fault_histogram(false, 0, 1000);
+    }
+    for (int i = 0; i < 10; i++) {
+        stats_record_fault_histogram(true, STATS_PATH_REMOTE | STATS_PATH_FORWARDED, 1000000);
+    }
+
+    dsm_latency_histogram_t all, local, forwarded, direct;
+    int ok = dsm_get_latency_histogram(DSM_FAULT_PATH_ALL, &all) == DSM_SUCCESS &&
+             dsm_get_latency_histogram(DSM_FAULT_PATH_LOCAL_UPGRADE, &local) == DSM_SUCCESS &&
+             dsm_get_latency_histogram(DSM_FAULT_PATH_FORWARDED, &forwarded) == DSM_SUCCESS &&
+             dsm_get_latency_histogram(DSM_FAULT_PATH_DIRECT, &direct) == DSM_SUCCESS;
+
+    /* Percentiles are accurate to one bucket (1/16) */
+    ok = ok && all.count == 1000 && local.count == 990 &&
+         forwarded.count == 10 && direct.count == 0 &&
+         all.min_ns == 1000 && all.max_ns == 1000000 &&
+         all.p50_ns >= 1000 && all.p50_ns < 1000 * 17 / 16 &&
+         all.p99_ns >= 1000 && all.p99_ns < 1000 * 17 / 16 &&
+         all.p999_ns == 1000000 && forwarded.p50_ns == 1000000;
+
+    ok = ok && dsm_get_latency_histogram(DSM_FAULT_PATH_COUNT, &all) == DSM_ERROR_INVALID;
+
+    dsm_reset_stats();
+    dsm_get_latency_histogram(DSM_FAULT_PATH_ALL, &all);
+    ok = ok && all.count == 0 && all.p99_ns == 0;
+
+    dsm_finalize();
+    return ok;
+}
+
+int test_many_allocations(void) {
+    dsm_config_t config = {
+        .node_id = 1,
+        .port = 5000,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    dsm_init(&config);
+
+    /* More allocations than the initial page table list holds */
+    enum { NUM_ALLOCS = 300 };
+    static int *ptrs[NUM_ALLOCS];
+    for (int i = 0; i < NUM_ALLOCS; i++) {
+        ptrs[i] = dsm_malloc(PAGE_SIZE);
+        if (!ptrs[i]) {
+            dsm_finalize();
+            return 0;
+        }
+        ptrs[i][0] = i;
+    }
+
+    /* Every allocation must still resolve to its own pages */
+    for (int i = 0; i < NUM_ALLOCS; i++) {
+        if (ptrs[i][0] != i) {
+            dsm_finalize();
+            return 0;
+        }
+    }
+
+    for (int i = 0; i < NUM_ALLOCS; i++) {
+        if (dsm_free(ptrs[i]) != DSM_SUCCESS) {
+            dsm_finalize();
+            return 0;
+        }
+    }
+
+    dsm_finalize();
+    return 1;
+}
+
+int test_arena(void) {
+    dsm_config_t config = {
+        .node_id = 1,
+        .port = 5000,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    dsm_init(&config);
+
+    dsm_arena_t *arena = dsm_arena_create(16 * PAGE_SIZE);
+    if (!arena) {
+        dsm_finalize();
+        return 0;
+    }
+
+    /* Small objects of one class share a page and are 16-byte aligned */
+    enum { NUM_OBJECTS = 100 };
+    char *objs[NUM_OBJECTS];
+    int ok = 1;
+    for (int i = 0; i < NUM_OBJECTS && ok; i++) {
+        objs[i] = dsm_arena_alloc(arena, 24);
+        ok = objs[i] && ((uintptr_t)objs[i] % 16) == 0;
+        if (ok) {
+            memset(objs[i], i, 24);
+        }
+    }
+    ok = ok && ((uintptr_t)objs[0] / PAGE_SIZE) == ((uintptr_t)objs[NUM_OBJECTS - 1] / PAGE_SIZE);
+    for (int i = 0; i < NUM_OBJECTS && ok; i++) {
+        ok = objs[i][0] == (char)i && objs[i][23] == (char)i;
+    }
+
+    /* A freed object is reused; a second free is rejected */
+    ok = ok && dsm_arena_free(arena, objs[10]) == DSM_SUCCESS;
+    ok = ok && dsm_arena_free(arena, objs[10]) == DSM_ERROR_INVALID;
+    ok = ok && dsm_arena_alloc(arena, 32) == objs[10];
+    ok = ok && dsm_arena_free(arena, objs[10] + 1) == DSM_ERROR_INVALID;
+
+    /* Large objects take page-aligned runs, until the arena is full */
+    char *big = dsm_arena_alloc(arena, 3 * PAGE_SIZE);
+    ok = ok && big && ((uintptr_t)big % PAGE_SIZE) == 0;
+    ok = ok && dsm_arena_alloc(arena, 15 * PAGE_SIZE) == NULL;
+    ok = ok && dsm_arena_free(arena, big) == DSM_SUCCESS;
+    ok = ok && dsm_arena_alloc(arena, 15 * PAGE_SIZE) == big;
+
+    int x;
+    ok = ok && dsm_arena_free(arena, &x) == DSM_ERROR_INVALID;
+    ok = ok && dsm_arena_destroy(arena) == DSM_SUCCESS;
+
+    dsm_finalize();
+    return ok;
+}
+
+int test_malloc_collective(void) {
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 5000,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    dsm_init(&config);
+
+    /* Regions are carved from the window in call order */
+    size_t stride = 0;
+    char *first = dsm_malloc_collective(100, NULL, &stride);
+    char *second = dsm_malloc_collective(3 * PAGE_SIZE, NULL, NULL);
+    int ok = first && second && stride == PAGE_SIZE && second == first + PAGE_SIZE;
+    ok = ok && dsm_malloc_collective(0, NULL, NULL) == NULL;
+
+    if (ok) {
+        memset(second, 0x5a, 3 * PAGE_SIZE);
+        first[0] = 1;
+        ok = second[3 * PAGE_SIZE - 1] == 0x5a && first[0] == 1;
+    }
+
+    /* A freed region reads as zeros again and stays reserved */
+    ok = ok && dsm_free(second) == DSM_SUCCESS;
+    char *third = ok ? dsm_malloc_collective(PAGE_SIZE, NULL, NULL) : NULL;
+    ok = ok && third == second + 3 * PAGE_SIZE && third[0] == 0;
+    ok = ok && dsm_free(first) == DSM_SUCCESS && dsm_free(third) == DSM_SUCCESS;
+
+    dsm_finalize();
+
+    /* The window is released at finalize and laid out afresh */
+    dsm_init(&config);
+    char *again = dsm_malloc_collective(PAGE_SIZE, NULL, NULL);
+    ok = ok && again == first;
+    dsm_free(again);
+    dsm_finalize();
+    return ok;
+}
+
+#define TRACE_THREADS 4
+int test_sharing_profile(void) {
+    dsm_config_t config = {
+        .node_id = 1,
+        .port = 5000,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR,
+        .sharing_profile_pages = 4
+    };
+
+    if (dsm_init(&config) != DSM_SUCCESS || !sharing_profile_enabled()) {
+        return 0;
+    }
+
+    char *ptr = dsm_malloc(2 * PAGE_SIZE);
+    if (!ptr) {
+        dsm_finalize();
+        return 0;
+    }
+    page_table_t *table = NULL;
+    page_id_t first = page_index_lookup_addr(ptr, &table)->id;
+    page_id_t second = page_index_lookup_addr(ptr + PAGE_SIZE, &table)->id;
+
+    /* Write faults are attributed to the cell of the faulting address */
+    ptr[130] = 1;
+    sharing_page_t page;
+    int ok = sharing_profile_get(first, &page) == DSM_SUCCESS &&
+             page.writes == 1 && page.cells[130 / (PAGE_SIZE / SHARING_PROFILE_CELLS)] == 1 &&
+             page.writers == (1ULL << 1) && page.pingpongs == 0;
+
+    /* Losing a page we wrote to another writer is a ping-pong */
+    dsm_stats_t before, after;
+    dsm_get_stats(&before);
+    sharing_profile_invalidated(first, 3);
+    sharing_profile_invalidated(first, 3);
+    dsm_get_stats(&after);
+    ok = ok && sharing_profile_get(first, &page) == DSM_SUCCESS &&
+         page.invalidations == 2 && page.pingpongs == 1 &&
+         page.writers == ((1ULL << 1) | (1ULL << 3)) &&
+         after.false_sharing_events == before.false_sharing_events + 1;
+
+    /* A written range covers every cell it touches */
+    size_t cell = PAGE_SIZE / SHARING_PROFILE_CELLS;
+    sharing_profile_write(second, PAGE_SIZE, cell - 1, 2);
+    ok = ok && sharing_profile_get(second, &page) == DSM_SUCCESS &&
+         page.cells[0] == 1 && page.cells[1] == 1 && page.cells[2] == 0;
+
+    /* Pages past the limit are not recorded */
+    for (page_id_t id = 1000; id < 1004; id++) {
+        sharing_profile_write(id, PAGE_SIZE, 0, 1);
+    }
+    ok = ok && sharing_profile_get(1000, &page) == DSM_SUCCESS &&
+         sharing_profile_get(1002, &page) == DSM_ERROR_NOT_FOUND;
+
+    /* Export ranks the ping-ponging page first */
+    const char *path = "/tmp/dsm_test_sharing.csv";
+    ok = ok && sharing_profile_export(path, 1) == 4;
+    FILE *f = fopen(path, "r");
+    char line[1024];
+    unsigned long rank, page_id;
+    ok = ok && f && fgets(line, sizeof(line), f) &&
+         strncmp(line, "rank,page_id,node_id,writers,", 29) == 0 &&
+         fgets(line, sizeof(line), f) &&
+         sscanf(line, "%lu,%lu,", &rank, &page_id) == 2 && rank == 1 && page_id == first &&
+         strstr(line, ",1;3,2,") != NULL;
+    if (f) {
+        fclose(f);
+    }
+    remove(path);
+
+    dsm_free(ptr);
+    dsm_finalize();
+    return ok && !sharing_profile_enabled();
+}
+
+#define TRACE_EVENTS 1000
+
+static void* trace_worker(void *arg) {
+    uint64_t base = (uintptr_t)arg;
+    for (int i = 0; i < TRACE_EVENTS; i++) {
+        trace_event(TRACE_PAGE_FAULT, base + i, ACCESS_WRITE, 100, i & TRACE_FLAG_QUEUED,
+                    TRACE_NODE_NONE);
+    }
+    return NULL;
+}
+
+int test_trace_threads(void) {
+    const char *trace_path = "/tmp/dsm_test_trace.bin";
+    const char *csv_path = "/tmp/dsm_test_trace.csv";
+
+    if (trace_start(trace_path, 1) != DSM_SUCCESS) {
+        return 0;
+    }
+
+    /* Fewer events per thread than a ring holds, so none may be dropped */
+    pthread_t threads[TRACE_THREADS];
+    for (int i = 0; i < TRACE_THREADS; i++) {
+        pthread_create(&threads[i], NULL, trace_worker, (void*)(uintptr_t)(i * TRACE_EVENTS));
+    }
+    for (int i = 0; i < TRACE_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    trace_stop();
+
+    /* Events after trace_stop() are not recorded */
+    trace_event(TRACE_PAGE_FAULT, 0, ACCESS_READ, 0, 0, TRACE_NODE_NONE);
+
+    int rows = trace_convert_csv(trace_path, csv_path);
+    int ok = rows == TRACE_THREADS * TRACE_EVENTS && trace_dropped() == 0;
+
+    /* CSV is time ordered with the perf_log header */
+    FILE *f = fopen(csv_path, "r");
+    char line[256];
+    ok = ok && f && fgets(line, sizeof(line), f) &&
+         strcmp(line, "timestamp_ns,event_type,page_id,access_type,latency_ns,was_queued\n") == 0;
+    unsigned long prev = 0, ts, page, latency;
+    int queued, count = 0;
+    char type[32], access[16];
+    while (ok && fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%lu,%31[^,],%lu,%15[^,],%lu,%d", &ts, type, &page, access,
+                   &latency, &queued) != 6 ||
+            ts < prev || strcmp(type, "PAGE_FAULT") != 0 ||
+            strcmp(access, "WRITE") != 0 || latency != 100) {
+            ok = 0;
+        }
+        prev = ts;
+        count++;
+    }
+    ok = ok && count == rows;
+    if (f) {
+        fclose(f);
+    }
+
+    remove(trace_path);
+    remove(csv_path);
+    return ok;
+}
+
+/** GET path from the metrics endpoint on localhost; returns bytes read into buf */
+static size_t http_get(int port, const char *path, char *buf, size_t len) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port) };
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+
+    char request[128];
+    int n = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", path);
+    if (write(fd, request, (size_t)n) != n) {
+        close(fd);
+        return 0;
+    }
+
+    size_t got = 0;
+    ssize_t r;
+    while (got < len - 1 && (r = read(fd, buf + got, len - 1 - got)) > 0) {
+        got += (size_t)r;
+    }
+    buf[got] = '\0';
+    close(fd);
+    return got;
+}
+
+int test_metrics_page(void) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/dsm_metrics_test_%d", (int)getpid());
+    const int port = 19464;
+    dsm_config_t config = {
+        .node_id = 1,
+        .port = 5000,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR,
+        .metrics_path = path,
+        .metrics_port = port,
+        .metrics_interval_ms = 50
+    };
+
+    if (dsm_init(&config) != DSM_SUCCESS) {
+        return 0;
+    }
+    dsm_reset_stats();
+
+    char *ptr = dsm_malloc(PAGE_SIZE);
+    if (ptr) {
+        ptr[0] = 1;
+    }
+    stats_peer_sent(1, 2, 100);
+    stats_peer_received(1, 40);
+
+    /* A tool maps the file read-only and never calls into the node */
+    int fd = open(path, O_RDONLY);
+    const dsm_metrics_page_t *shared = fd >= 0 ?
+        mmap(NULL, sizeof(dsm_metrics_page_t), PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    int ok = ptr && shared != MAP_FAILED && metrics_publish() == DSM_SUCCESS;
+
+    dsm_metrics_page_t *snap = malloc(sizeof(*snap));
+    dsm_stats_t stats;
+    dsm_get_stats(&stats);
+    ok = ok && snap && dsm_metrics_read(shared, snap) == 0 &&
+         snap->node_id == 1 && snap->num_counters == STATS_NUM_COUNTERS &&
+         snap->stats_offset == offsetof(dsm_metrics_page_t, stats) &&
+         snap->stats.page_faults == stats.page_faults && stats.page_faults >= 1 &&
+         snap->peers[1].frames_sent == 2 && snap->peers[1].bytes_sent == 100 &&
+         snap->peers[1].frames_received == 1 && snap->peers[1].bytes_received == 40 &&
+         strncmp(snap->counter_names, "page_faults\nread_faults\n", 24) == 0 &&
+         strncmp(snap->path_names, "all\nread\n", 9) == 0;
+
+    /* The publisher keeps the page fresh on its own */
+    uint64_t publishes = ok ? snap->publishes : 0;
+    usleep(200000);
+    ok = ok && dsm_metrics_read(shared, snap) == 0 && snap->publishes > publishes;
+
+    /* One counter name per dsm_stats_t field, in field order */
+    int names = 0;
+    for (const char *c = ok ? snap->counter_names : ""; *c; c++) {
+        names += *c == '\n';
+    }
+    ok = ok && names == (int)STATS_NUM_COUNTERS &&
+         strstr(snap->counter_names, "\nmax_fault_latency_ns\nmin_fault_latency_ns\n");
+
+    /* A client that connects and says nothing must not hold up the next */
+    int idle = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port) };
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ok = ok && idle >= 0 && connect(idle, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    char *body = malloc(256 * 1024);
+    ok = ok && body && http_get(port, "/metrics", body, 256 * 1024) > 0 &&
+         strstr(body, "HTTP/1.1 200 OK") &&
+         strstr(body, "# TYPE dsm_page_faults_total counter") &&
+         strstr(body, "dsm_page_faults_total{node=\"1\"}") &&
+         strstr(body, "# TYPE dsm_max_fault_latency_ns gauge") &&
+         strstr(body, "dsm_fault_latency_seconds_count{node=\"1\",path=\"all\"}") &&
+         strstr(body, "dsm_peer_frames_sent_total{node=\"1\",peer=\"1\"} 2\n") &&
+         !strstr(body, "peer=\"2\"");
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    long waited_ms = (t1.tv_sec - t0.tv_sec) * 1000 + (t1.tv_nsec - t0.tv_nsec) / 1000000;
+    ok = ok && waited_ms < 500;
+    ok = ok && http_get(port, "/other", body, 256 * 1024) > 0 && strstr(body, "404 Not Found");
+
+    /* ... and is closed once it has idled past the client timeout */
+    struct pollfd idle_poll = { .fd = idle, .events = POLLIN };
+    char byte;
+    ok = ok && poll(&idle_poll, 1, 3000) == 1 && read(idle, &byte, 1) == 0;
+    if (idle >= 0) {
+        close(idle);
+    }
+
+    dsm_free(ptr);
+    dsm_finalize();
+
+    /* The final snapshot stays in the file */
+    ok = ok && dsm_metrics_read(shared, snap) == 0 && snap->publishes > publishes;
+
+    free(body);
+    free(snap);
+    if (shared != MAP_FAILED) {
+        munmap((void *)shared, sizeof(dsm_metrics_page_t));
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    unlink(path);
+    return ok;
+}
+
+int test_rma_local(void) {
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 5000,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    if (dsm_init(&config) != DSM_SUCCESS) {
+        return 0;
+    }
+
+    size_t size = 3 * PAGE_SIZE;
+    uint8_t *ptr = dsm_malloc(size);
+    uint8_t *src = malloc(size);
+    uint8_t *dst = calloc(1, size);
+    if (!ptr || !src || !dst) {
+        free(src);
+        free(dst);
+        dsm_free(ptr);
+        dsm_finalize();
+        return 0;
+    }
+    for (size_t i = 0; i < size; i++) {
+        src[i] = (uint8_t)(i * 7 + 3);
+    }
+
+    /* Unaligned ranges spanning pages, blocking and non-blocking */
+    dsm_stats_t before, after;
+    dsm_get_stats(&before);
+    int ok = dsm_put(ptr + 100, src, size - 200) == DSM_SUCCESS &&
+             memcmp(ptr + 100, src, size - 200) == 0 &&
+             dsm_get(dst, ptr + 100, size - 200) == DSM_SUCCESS &&
+             memcmp(dst, src, size - 200) == 0;
+
+    dsm_rma_t *handle = NULL;
+    bool done = false;
+    memset(dst, 0, size);
+    ok = ok && dsm_get_nb(dst, ptr + PAGE_SIZE - 8, 16, &handle) == DSM_SUCCESS &&
+         dsm_rma_test(handle, &done) == DSM_SUCCESS && done &&
+         memcmp(dst, src + PAGE_SIZE - 108, 16) == 0;
+    ok = ok && dsm_put_nb(ptr, src, PAGE_SIZE, &handle) == DSM_SUCCESS &&
+         dsm_rma_wait(handle) == DSM_SUCCESS && memcmp(ptr, src, PAGE_SIZE) == 0;
+
+    /* Everything is held here: no requests, no fallbacks */
+    dsm_get_stats(&after);
+    ok = ok && after.rma_bytes == before.rma_bytes + 2 * (size - 200) + 16 + PAGE_SIZE &&
+         after.rma_requests == before.rma_requests && after.rma_fallbacks == before.rma_fallbacks;
+
+    /* Ranges must lie wholly in DSM memory */
+    uint8_t local[16];
+    ok = ok && dsm_get(dst, local, sizeof(local)) == DSM_ERROR_NOT_FOUND &&
+         dsm_put(ptr + size - 8, src, 16) == DSM_ERROR_NOT_FOUND &&
+         dsm_get(NULL, ptr, 16) == DSM_ERROR_INVALID &&
+         dsm_get(dst, ptr, 0) == DSM_ERROR_INVALID &&
+         dsm_rma_wait(NULL) == DSM_ERROR_INVALID &&
+         dsm_rma_test(NULL, &done) == DSM_ERROR_INVALID;
+
+    free(src);
+    free(dst);
+    dsm_free(ptr);
+    dsm_finalize();
+    return ok;
+}
+
+int test_atomics_local(void) {
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 5000,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    if (dsm_init(&config) != DSM_SUCCESS) {
+        return 0;
+    }
+
+    uint64_t *words = dsm_malloc(PAGE_SIZE);
+    if (!words) {
+        dsm_finalize();
+        return 0;
+    }
+    words[0] = 10;
+    words[1] = 0;
+
+    dsm_stats_t before, after;
+    dsm_get_stats(&before);
+
+    uint64_t old64 = 0;
+    uint32_t old32 = 0;
+    uint32_t *halves = (uint32_t *)&words[1];
+    int ok = dsm_atomic_fetch_add64(&words[0], 5, &old64) == DSM_SUCCESS && old64 == 10 &&
+             words[0] == 15;
+    ok = ok && dsm_atomic_cas64(&words[0], 3, 99, &old64) == DSM_SUCCESS && old64 == 15 &&
+         words[0] == 15;
+    ok = ok && dsm_atomic_cas64(&words[0], 15, 99, &old64) == DSM_SUCCESS && old64 == 15 &&
+         words[0] == 99;
+    ok = ok && dsm_atomic_swap64(&words[0], 7, NULL) == DSM_SUCCESS && words[0] == 7;
+    ok = ok && dsm_atomic_fetch_add32(&halves[1], 0xFFFFFFFFu, &old32) == DSM_SUCCESS &&
+         old32 == 0 && halves[1] == 0xFFFFFFFFu && halves[0] == 0;
+    ok = ok && dsm_atomic_cas32(&halves[1], 0xFFFFFFFFu, 4, &old32) == DSM_SUCCESS &&
+         halves[1] == 4 && dsm_atomic_swap32(&halves[0], 8, &old32) == DSM_SUCCESS &&
+         old32 == 0 && halves[0] == 8;
+
+    dsm_get_stats(&after);
+    ok = ok && after.atomic_ops == before.atomic_ops + 7 && after.rma_requests == before.rma_requests;
+
+    /* Words must be naturally aligned and in DSM memory */
+    uint64_t local = 0;
+    ok = ok && dsm_atomic_fetch_add64((uint8_t *)words + 4, 1, NULL) == DSM_ERROR_INVALID &&
+         dsm_atomic_swap32((uint8_t *)words + 2, 1, NULL) == DSM_ERROR_INVALID &&
+         dsm_atomic_fetch_add64(&local, 1, NULL) == DSM_ERROR_NOT_FOUND && local == 0;
+
+    dsm_free(words);
+    dsm_finalize();
+    return ok;
+}
+
+/**
+ * Write the checkpoint restored by test_checkpoint_restore()
+ * Runs in a child process, so the restart maps the regions into an address
+ * space where they are free, as a restarted program would.
+ */
+static int write_test_checkpoint(const char *dir, void **bases) {
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 5000,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    if (dsm_init(&config) != DSM_SUCCESS) {
+        return 0;
+    }
+
+    /* One page-sized, one 16K-block and one collective allocation */
+    dsm_alloc_attr_t attr;
+    dsm_alloc_attr_init(&attr);
+    uint32_t *small = dsm_malloc(4 * PAGE_SIZE);
+    uint8_t *large = dsm_malloc_ex(8 * 4 * PAGE_SIZE, DSM_COMPRESSION_NONE, 4 * PAGE_SIZE);
+    size_t stride = 0;
+    uint64_t *shared = dsm_malloc_collective(PAGE_SIZE, &attr, &stride);
+    if (!small || !large || !shared) {
+        dsm_finalize();
+        return 0;
+    }
+    for (size_t i = 0; i < 4 * PAGE_SIZE / sizeof(uint32_t); i++) {
+        small[i] = (uint32_t)i * 3;
+    }
+    memset(large + 5 * 4 * PAGE_SIZE, 0x5A, 4 * PAGE_SIZE);
+    shared[7] = 0x0123456789ABCDEFULL;
+
+    int ok = dsm_checkpoint(dir) == DSM_SUCCESS;
+    small[0] = 999;
+    bases[0] = small;
+    bases[1] = large;
+    bases[2] = shared;
+
+    dsm_finalize();
+    return ok;
+}
+
+int test_checkpoint_restore(void) {
+    char dir[] = "/tmp/dsm_ckpt_XXXXXX";
+    void **bases = mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (!mkdtemp(dir) || bases == MAP_FAILED) {
+        return 0;
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(write_test_checkpoint(dir, bases) ? 0 : 1);
+    }
+    int status = 0;
+    int ok = pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+             WEXITSTATUS(status) == 0;
+
+    /* Same addresses and order, the checkpointed contents */
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 5000,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR,
+        .restore_path = dir
+    };
+    if (!ok || dsm_init(&config) != DSM_SUCCESS) {
+        munmap(bases, PAGE_SIZE);
+        return 0;
+    }
+    uint32_t *small = dsm_get_allocation(0);
+    uint8_t *large = dsm_get_allocation(1);
+    uint64_t *shared = dsm_get_allocation(2);
+    ok = small == bases[0] && large == bases[1] && shared == bases[2];
+
+    /* Restored protections go out in batches: 4 + 1 + 1 saved blocks */
+    dsm_stats_t stats;
+    dsm_get_stats(&stats);
+    ok = ok && stats.batched_pages == 6;
+    for (size_t i = 0; ok && i < 4 * PAGE_SIZE / sizeof(uint32_t); i++) {
+        ok = small[i] == (uint32_t)i * 3;
+    }
+    ok = ok && large[0] == 0 && large[5 * 4 * PAGE_SIZE] == 0x5A &&
+         large[6 * 4 * PAGE_SIZE - 1] == 0x5A && large[6 * 4 * PAGE_SIZE] == 0 &&
+         shared[7] == 0x0123456789ABCDEFULL && shared[6] == 0;
+
+    /* Restored memory is writable, and new allocations do not collide */
+    if (ok) {
+        small[1] = 42;
+        large[0] = 1;
+    }
+    uint32_t *fresh = dsm_malloc(PAGE_SIZE);
+    ok = ok && small[1] == 42 && large[0] == 1 && fresh && fresh != small &&
+         dsm_get_allocation(3) == fresh;
+    if (fresh) {
+        fresh[0] = 7;
+        ok = ok && fresh[0] == 7;
+        dsm_free(fresh);
+    }
+    dsm_free(small);
+    dsm_free(large);
+    dsm_free(shared);
+    dsm_finalize();
+
+    /* Nothing to restart from */
+    config.restore_path = "/tmp/dsm_no_such_checkpoint";
+    ok = ok && dsm_init(&config) != DSM_SUCCESS;
+
+    char path[64];
+    snprintf(path, sizeof(path), "%s/node-0.dsmckpt", dir);
+    unlink(path);
+    rmdir(dir);
+    munmap(bases, PAGE_SIZE);
+    return ok;
+}
+
 int main(void) {
     printf("=== Memory Management Tests ===\n\n");
 
     RUN_TEST(test_dsm_init);
     RUN_TEST(test_dsm_malloc_free);
     RUN_TEST(test_page_permissions);
+    RUN_TEST(test_permission_batch);
     RUN_TEST(test_stats);
+    RUN_TEST(test_stats_threads);
+    RUN_TEST(test_latency_histogram);
+    RUN_TEST(test_many_allocations);
+    RUN_TEST(test_arena);
+    RUN_TEST(test_malloc_collective);
+    RUN_TEST(test_trace_threads);
+    RUN_TEST(test_sharing_profile);
+    RUN_TEST(test_metrics_page);
+    RUN_TEST(test_rma_local);
+    RUN_TEST(test_atomics_local);
+    RUN_TEST(test_checkpoint_restore);
 
     printf("\n=== Test Summary ===\n");
     printf("Passed: %d\n", tests_passed);
@@ -8,13 +8,27 @@
  * USAGE:
  *   Node 0 (manager): ./test_multinode --manager --nodes 2
  *   Node 1 (worker):  ./test_multinode --worker --manager-host <ip> --node-id 1
+ *   Add --release on every node to run under release consistency.
+ *   Add --prefetch <N> to enable the fault prefetcher with an N-page window.
+ *   Add --handlers <N> to handle messages on a pool of N threads.
+ *   Add --userfaultfd to catch page faults with userfaultfd instead of SIGSEGV.
+ *   Add --distributed-directory on every node to track pages on home nodes.
+ *   Run again with --restore /tmp/dsm_checkpoint on every node to restart
+ *   from the checkpoint the two-node run takes last.
+ *
+ *   make test-multinode (scripts/run_multinode.sh) runs two nodes on
+ *   localhost in each configuration a protocol change must pass, handler
+ *   threads with userfaultfd among them, then the restart.
  */
 
 #include "dsm/dsm.h"
 #include "../src/core/log.h"
+#include <limits.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 /* ================================================================
@@ -248,224 +262,1830 @@ void test_read_sharing(int node_id, int num_nodes) {
     dsm_free(shared_data);
 }
 
-/* ================================================================
- * Task 10.3: Four-Node Tests
- * ================================================================ */
-
 /**
- * Test A: Parallel Sum
+ * Test D: False Sharing (--release only)
+ * Nodes write interleaved ints of the same page every round; the writes
+ * are merged at the home through diffs.
  */
-void test_parallel_sum(int node_id, int num_nodes) {
-    printf("[Node %d] Starting parallel sum test...\n", node_id);
+void test_false_sharing(int node_id, int num_nodes) {
+    printf("[Node %d] Starting false-sharing test...\n", node_id);
 
-    const int ARRAY_SIZE = 1000;
-    int *array = NULL;
-    int *partial_sums = NULL;
+    int *shared_data = NULL;
 
     if (node_id == 0) {
-        array = (int*)dsm_malloc(ARRAY_SIZE * sizeof(int));
-        partial_sums = (int*)dsm_malloc(num_nodes * sizeof(int));
+        shared_data = (int*)dsm_malloc(PAGE_SIZE);
     }
-    
-    /* Barrier 40: Wait for allocation */
-    dsm_barrier(40, num_nodes);
-    
+
+    /* Barrier 60: Wait for allocation */
+    dsm_barrier(60, num_nodes);
+
     if (node_id != 0) {
-        array = (int*)dsm_get_allocation(0);
-        partial_sums = (int*)dsm_get_allocation(1);
+        shared_data = (int*)dsm_get_allocation(0);
     }
 
-    if (!array || !partial_sums) {
+    if (!shared_data) {
         printf("[Node %d] Failed to allocate DSM memory\n", node_id);
         return;
     }
 
-    if (node_id == 0) {
-        /* Initialize array */
-        for (int i = 0; i < ARRAY_SIZE; i++) {
-            array[i] = i + 1;
+    const int NUM_INTS = PAGE_SIZE / sizeof(int);
+    const int ROUNDS = 10;
+    int errors = 0;
+
+    for (int round = 0; round < ROUNDS; round++) {
+        /* Each node owns every num_nodes-th int, so 8-byte words are shared too */
+        for (int i = node_id; i < NUM_INTS; i += num_nodes) {
+            shared_data[i] = round * 1000 + node_id;
         }
-        printf("[Node %d] Initialized array\n", node_id);
-    }
 
-    /* Synchronize */
-    dsm_barrier(4000, num_nodes);
+        dsm_barrier(6000, num_nodes);  /* Sync after writes */
 
-    /* Each node sums its portion */
-    int per_node = ARRAY_SIZE / num_nodes;
-    int start = node_id * per_node;
-    int end = (node_id == num_nodes - 1) ? ARRAY_SIZE : (node_id + 1) * per_node;
+        for (int i = 0; i < NUM_INTS; i++) {
+            if (shared_data[i] != round * 1000 + i % num_nodes) {
+                errors++;
+            }
+        }
 
-    int local_sum = 0;
-    for (int i = start; i < end; i++) {
-        local_sum += array[i];
+        dsm_barrier(6001, num_nodes);  /* Sync before next round's writes */
     }
 
-    partial_sums[node_id] = local_sum;
-    printf("[Node %d] Partial sum: %d (range %d-%d)\n", node_id, local_sum, start, end - 1);
+    if (errors == 0) {
+        printf("[Node %d] ✓ False-sharing test PASSED\n", node_id);
+    } else {
+        printf("[Node %d] ✗ False-sharing test FAILED (%d wrong values)\n", node_id, errors);
+    }
 
-    /* Synchronize */
-    dsm_barrier(4001, num_nodes); /* Changed ID to avoid collision */
+    dsm_stats_t stats;
+    dsm_get_stats(&stats);
+    printf("[Node %d] Twins: %lu, diffs sent: %lu, diffs applied: %lu\n",
+           node_id, stats.twins_created, stats.diffs_sent, stats.diffs_applied);
+
+    dsm_barrier(6002, num_nodes);
+    dsm_free(shared_data);
+}
+
+/**
+ * Test E: Bulk Prefetch
+ * Node 1 prefetches the first half of Node 0's array with dsm_prefetch()
+ * and reads the second half sequentially, which the fault prefetcher
+ * follows when --prefetch is given.
+ */
+void test_bulk_prefetch(int node_id, int num_nodes) {
+    printf("[Node %d] Starting bulk-prefetch test...\n", node_id);
+
+    const int NUM_PAGES = 32;
+    const int INTS_PER_PAGE = PAGE_SIZE / sizeof(int);
+    int *shared_data = NULL;
 
     if (node_id == 0) {
-        /* Compute total sum */
-        int total = 0;
-        for (int i = 0; i < num_nodes; i++) {
-            total += partial_sums[i];
+        shared_data = (int*)dsm_malloc(NUM_PAGES * PAGE_SIZE);
+        if (shared_data) {
+            for (int i = 0; i < NUM_PAGES * INTS_PER_PAGE; i++) {
+                shared_data[i] = i;
+            }
+        }
+    }
+
+    /* Barrier 70: Wait for allocation and initialization */
+    dsm_barrier(70, num_nodes);
+
+    if (node_id != 0) {
+        shared_data = (int*)dsm_get_allocation(0);
+    }
+
+    if (!shared_data) {
+        printf("[Node %d] Failed to allocate DSM memory\n", node_id);
+        return;
+    }
+
+    if (node_id == 1) {
+        int rc = dsm_prefetch(shared_data, NUM_PAGES / 2 * PAGE_SIZE, ACCESS_READ);
+
+        int errors = 0;
+        for (int i = 0; i < NUM_PAGES * INTS_PER_PAGE; i++) {
+            if (shared_data[i] != i) {
+                errors++;
+            }
         }
 
-        int expected = (ARRAY_SIZE * (ARRAY_SIZE + 1)) / 2;  /* Sum of 1 to N */
-        printf("[Node %d] Total sum: %d (expected %d)\n", node_id, total, expected);
+        dsm_stats_t stats;
+        dsm_get_stats(&stats);
+        printf("[Node %d] Prefetch requests: %lu, pages prefetched: %lu, in-flight hits: %lu, read faults: %lu\n",
+               node_id, stats.prefetch_requests, stats.pages_prefetched, stats.prefetch_hits,
+               stats.read_faults);
 
-        if (total == expected) {
-            printf("[Node %d] ✓ Parallel sum test PASSED\n", node_id);
+        if (rc == DSM_SUCCESS && errors == 0) {
+            printf("[Node %d] ✓ Bulk-prefetch test PASSED\n", node_id);
         } else {
-            printf("[Node %d] ✗ Parallel sum test FAILED\n", node_id);
+            printf("[Node %d] ✗ Bulk-prefetch test FAILED (rc=%d, %d wrong values)\n",
+                   node_id, rc, errors);
         }
     }
 
-    dsm_free(array);
-    dsm_free(partial_sums);
+    /* CRITICAL: Final barrier before cleanup */
+    dsm_barrier(7000, num_nodes);
+
+    dsm_free(shared_data);
+}
+
+static void on_acquired(void *addr, size_t len, int status, void *arg) {
+    (void)addr;
+    (void)len;
+    int *state = (int *)arg;
+    if (status == DSM_SUCCESS) {
+        state[0]++;
+    } else {
+        state[1]++;
+    }
 }
 
 /**
- * Test B: Shared Counter with Locks
+ * Test E2: Asynchronous acquire
+ * Node 1 acquires all of Node 0's array with dsm_acquire_async(), every
+ * range in flight at once, and waits on dsm_async_fd() as an event loop
+ * would. The read ranges are then read and the write range written
+ * without a fault, and Node 0 sees the writes.
  */
-void test_shared_counter(int node_id, int num_nodes) {
-    printf("[Node %d] Starting shared counter test...\n", node_id);
+void test_async_acquire(int node_id, int num_nodes) {
+    printf("[Node %d] Starting async-acquire test...\n", node_id);
+
+    const int NUM_PAGES = 32;
+    const int RANGE_PAGES = 4;
+    const int WRITE_PAGE = NUM_PAGES - RANGE_PAGES;
+    const int INTS_PER_PAGE = PAGE_SIZE / sizeof(int);
+    int *shared_data = NULL;
 
-    int *counter = NULL;
-    
     if (node_id == 0) {
-        counter = (int*)dsm_malloc(sizeof(int));
+        shared_data = (int*)dsm_malloc(NUM_PAGES * PAGE_SIZE);
+        if (shared_data) {
+            for (int i = 0; i < NUM_PAGES * INTS_PER_PAGE; i++) {
+                shared_data[i] = 3 * i;
+            }
+        }
     }
-    
-    /* Barrier 50: Wait for allocation */
-    dsm_barrier(50, num_nodes);
-    
+
+    /* Barrier 89: Wait for allocation and initialization */
+    dsm_barrier(89, num_nodes);
+
     if (node_id != 0) {
-        counter = (int*)dsm_get_allocation(0);
+        shared_data = (int*)dsm_get_allocation(0);
     }
 
-    if (!counter) {
+    if (!shared_data) {
         printf("[Node %d] Failed to allocate DSM memory\n", node_id);
         return;
     }
 
-    dsm_lock_t *lock = dsm_lock_create(5000);
-    if (!lock) {
-        printf("[Node %d] Failed to create lock\n", node_id);
-        dsm_free(counter);
-        return;
+    if (node_id == 1) {
+        int state[2] = {0, 0};  /* Completed, failed */
+        int submitted = 0;
+        int rc = DSM_SUCCESS;
+        for (int p = 0; p < NUM_PAGES && rc == DSM_SUCCESS; p += RANGE_PAGES) {
+            access_type_t access = p == WRITE_PAGE ? ACCESS_WRITE : ACCESS_READ;
+            rc = dsm_acquire_async(shared_data + p * INTS_PER_PAGE, RANGE_PAGES * PAGE_SIZE,
+                                   access, on_acquired, state);
+            submitted += rc == DSM_SUCCESS;
+        }
+
+        int fd = dsm_async_fd();
+        for (int i = 0; i < 500 && state[0] + state[1] < submitted; i++) {
+            struct pollfd pfd = { .fd = fd, .events = POLLIN };
+            if (poll(&pfd, 1, 20) > 0) {
+                dsm_poll(0);
+            }
+        }
+
+        dsm_stats_t before, after;
+        dsm_get_stats(&before);
+        int errors = 0;
+        for (int i = 0; i < WRITE_PAGE * INTS_PER_PAGE; i++) {
+            if (shared_data[i] != 3 * i) {
+                errors++;
+            }
+        }
+        for (int i = WRITE_PAGE * INTS_PER_PAGE; i < NUM_PAGES * INTS_PER_PAGE; i++) {
+            shared_data[i] = -i;
+        }
+        dsm_get_stats(&after);
+        uint64_t faults = (after.read_faults - before.read_faults) +
+                          (after.write_faults - before.write_faults);
+
+        printf("[Node %d] Async requests: %d completed, %d failed, %lu faults after completion\n",
+               node_id, state[0], state[1], faults);
+
+        if (rc == DSM_SUCCESS && state[0] == submitted && errors == 0 && faults == 0) {
+            printf("[Node %d] ✓ Async-acquire test PASSED\n", node_id);
+        } else {
+            printf("[Node %d] ✗ Async-acquire test FAILED (rc=%d, %d wrong values, %lu faults)\n",
+                   node_id, rc, errors, faults);
+        }
     }
 
+    /* Barrier 8900: Node 1's writes are visible to Node 0 */
+    dsm_barrier(8900, num_nodes);
+
     if (node_id == 0) {
-        *counter = 0;
+        int errors = 0;
+        for (int i = WRITE_PAGE * INTS_PER_PAGE; i < NUM_PAGES * INTS_PER_PAGE; i++) {
+            if (shared_data[i] != -i) {
+                errors++;
+            }
+        }
+        if (errors == 0) {
+            printf("[Node %d] ✓ Async-acquire writes PASSED\n", node_id);
+        } else {
+            printf("[Node %d] ✗ Async-acquire writes FAILED (%d wrong values)\n", node_id, errors);
+        }
     }
 
-    dsm_barrier(5001, num_nodes);
+    /* CRITICAL: Final barrier before cleanup */
+    dsm_barrier(8901, num_nodes);
 
-    /* Each node increments counter 100 times */
-    for (int i = 0; i < 100; i++) {
-        dsm_lock_acquire(lock);
-        (*counter)++;
-        dsm_lock_release(lock);
+    dsm_free(shared_data);
+}
+
+/**
+ * Test F: Placement
+ * Each node writes the pages placement gave it without fetching them:
+ * every other page of a cyclic array, and the half of a first-touch
+ * array it writes first. Then both nodes read everything.
+ */
+void test_placement(int node_id, int num_nodes) {
+    printf("[Node %d] Starting placement test...\n", node_id);
+
+    const int NUM_PAGES = 8;
+    const int INTS_PER_PAGE = PAGE_SIZE / sizeof(int);
+    int *cyclic = NULL;
+    int *touched = NULL;
+
+    if (node_id == 0) {
+        dsm_alloc_attr_t attr;
+        dsm_alloc_attr_init(&attr);
+        attr.placement = DSM_PLACEMENT_CYCLIC;
+        cyclic = (int*)dsm_malloc_attr(NUM_PAGES * PAGE_SIZE, &attr);
+        attr.placement = DSM_PLACEMENT_FIRST_TOUCH;
+        touched = (int*)dsm_malloc_attr(NUM_PAGES * PAGE_SIZE, &attr);
     }
 
-    dsm_barrier(5002, num_nodes); /* Changed ID to avoid collision */
+    /* Barrier 80: Wait for allocation */
+    dsm_barrier(80, num_nodes);
+
+    if (node_id != 0) {
+        cyclic = (int*)dsm_get_allocation(0);
+        touched = (int*)dsm_get_allocation(1);
+    }
+
+    if (!cyclic || !touched) {
+        printf("[Node %d] Failed to allocate DSM memory\n", node_id);
+        return;
+    }
+
+    dsm_stats_t before, after;
+    dsm_get_stats(&before);
+
+    for (int p = node_id; p < NUM_PAGES; p += num_nodes) {
+        for (int i = 0; i < INTS_PER_PAGE; i++) {
+            cyclic[p * INTS_PER_PAGE + i] = p * 1000 + i;
+        }
+    }
 
+    /* Node 1 claims the first half of the first-touch array, node 0 the rest */
+    int first = node_id == 1 ? 0 : NUM_PAGES / 2;
     if (node_id == 0) {
-        int expected = num_nodes * 100;
-        printf("[Node %d] Final counter: %d (expected %d)\n", node_id, *counter, expected);
+        dsm_barrier(8000, num_nodes);
+    }
+    for (int p = first; p < first + NUM_PAGES / 2; p++) {
+        for (int i = 0; i < INTS_PER_PAGE; i++) {
+            touched[p * INTS_PER_PAGE + i] = -(p * 1000 + i);
+        }
+    }
+    if (node_id != 0) {
+        dsm_barrier(8000, num_nodes);
+    }
 
-        if (*counter == expected) {
-            printf("[Node %d] ✓ Shared counter test PASSED\n", node_id);
-        } else {
-            printf("[Node %d] ✗ Shared counter test FAILED\n", node_id);
+    dsm_get_stats(&after);
+    uint64_t write_fetches = after.pages_fetched - before.pages_fetched;
+
+    /* Barrier 8001: All writes done */
+    dsm_barrier(8001, num_nodes);
+
+    int errors = 0;
+    for (int p = 0; p < NUM_PAGES; p++) {
+        for (int i = 0; i < INTS_PER_PAGE; i++) {
+            if (cyclic[p * INTS_PER_PAGE + i] != p * 1000 + i ||
+                touched[p * INTS_PER_PAGE + i] != -(p * 1000 + i)) {
+                errors++;
+            }
         }
     }
 
-    dsm_lock_destroy(lock);
-    dsm_free(counter);
-}
+    printf("[Node %d] Pages fetched while writing placed pages: %lu\n", node_id, write_fetches);
+    if (errors == 0 && write_fetches == 0) {
+        printf("[Node %d] ✓ Placement test PASSED\n", node_id);
+    } else {
+        printf("[Node %d] ✗ Placement test FAILED (%d wrong values, %lu fetches)\n",
+               node_id, errors, write_fetches);
+    }
 
-/* ================================================================
- * Main
- * ================================================================ */
+    /* CRITICAL: Final barrier before cleanup */
+    dsm_barrier(8002, num_nodes);
 
-void print_usage(const char *prog) {
-    printf("Usage:\n");
-    printf("  Manager: %s --manager --nodes <N> [--port <P>]\n", prog);
-    printf("  Worker:  %s --worker --node-id <ID> --manager-host <HOST> [--manager-port <P>]\n", prog);
+    dsm_free(cyclic);
+    dsm_free(touched);
 }
 
-int main(int argc, char *argv[]) {
-    int is_manager = 0;
-    int node_id = -1;
-    int num_nodes = 2;
-    char manager_host[256] = "localhost";
-    int port = 5000;
+/**
+ * Test G: Shared-heap arena
+ */
+void test_arena_shared(int node_id, int num_nodes) {
+    printf("[Node %d] Starting arena test...\n", node_id);
 
-    /* Parse arguments */
-    for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "--manager") == 0) {
-            is_manager = 1;
-            node_id = 0;
-        } else if (strcmp(argv[i], "--worker") == 0) {
-            is_manager = 0;
-        } else if (strcmp(argv[i], "--node-id") == 0 && i + 1 < argc) {
-            node_id = atoi(argv[++i]);
-        } else if (strcmp(argv[i], "--nodes") == 0 && i + 1 < argc) {
-            num_nodes = atoi(argv[++i]);
-        } else if (strcmp(argv[i], "--manager-host") == 0 && i + 1 < argc) {
-            strncpy(manager_host, argv[++i], sizeof(manager_host) - 1);
-        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
-            port = atoi(argv[++i]);
-        } else if (strcmp(argv[i], "--manager-port") == 0 && i + 1 < argc) {
-            port = atoi(argv[++i]);
-        }
+    const int NUM_PAGES = 8;
+    const int NUM_OBJECTS = 64;
+    const size_t OBJECT_SIZE = 48;  /* Served from the 64-byte class */
+    dsm_arena_t *arena = NULL;
+
+    if (node_id == 0) {
+        arena = dsm_arena_create(NUM_PAGES * PAGE_SIZE);
     }
 
-    if (node_id < 0) {
-        print_usage(argv[0]);
-        return 1;
+    /* Barrier 81: Wait for allocation */
+    dsm_barrier(81, num_nodes);
+
+    if (node_id != 0) {
+        arena = dsm_arena_attach(dsm_get_allocation(0));
+    }
+    if (!arena) {
+        printf("[Node %d] Failed to create arena\n", node_id);
+        return;
     }
 
-    /* Initialize DSM */
-    dsm_config_t config = {
-        .node_id = node_id,
-        .port = port + node_id,
-        .num_nodes = num_nodes,
-        .is_manager = is_manager,
-        .log_level = LOG_LEVEL_INFO
-    };
+    dsm_stats_t before, after;
+    dsm_get_stats(&before);
 
-    if (!is_manager) {
-        strncpy(config.manager_host, manager_host, sizeof(config.manager_host) - 1);
-        config.manager_port = port;
+    char *first = NULL;
+    for (int i = 0; i < NUM_OBJECTS; i++) {
+        int *obj = dsm_arena_alloc(arena, OBJECT_SIZE);
+        if (!obj) {
+            break;
+        }
+        if (i == 0) {
+            first = (char*)obj;
+        }
+        obj[0] = node_id * 1000 + i;
     }
 
-    printf("\n=== Multi-Node DSM Tests (Node %d) ===\n\n", node_id);
+    dsm_get_stats(&after);
+    uint64_t alloc_fetches = after.pages_fetched - before.pages_fetched;
+
+    /* Barrier 8100: All objects written */
+    dsm_barrier(8100, num_nodes);
+
+    /* Node n's objects are packed from the start of its run of pages */
+    char *base = dsm_get_allocation(0);
+    int run = (NUM_PAGES + num_nodes - 1) / num_nodes;
+    int errors = first == base + (size_t)node_id * run * PAGE_SIZE ? 0 : 1;
+    for (int n = 0; n < num_nodes; n++) {
+        char *part = base + (size_t)n * run * PAGE_SIZE;
+        for (int i = 0; i < NUM_OBJECTS; i++) {
+            if (*(int*)(part + (size_t)i * 64) != n * 1000 + i) {
+                errors++;
+            }
+        }
+    }
 
-    if (dsm_init(&config) != DSM_SUCCESS) {
-        printf("Failed to initialize DSM\n");
-        return 1;
+    printf("[Node %d] Pages fetched while allocating: %lu\n", node_id, alloc_fetches);
+    if (errors == 0 && alloc_fetches == 0) {
+        printf("[Node %d] ✓ Arena test PASSED\n", node_id);
+    } else {
+        printf("[Node %d] ✗ Arena test FAILED (%d wrong values, %lu fetches)\n",
+               node_id, errors, alloc_fetches);
     }
 
-    /* Run tests based on number of nodes */
-    if (num_nodes == 2) {
-        printf("--- Two-Node Tests ---\n");
-        test_ping_pong(node_id, num_nodes);
-        dsm_barrier(9000, num_nodes);  /* Sync between tests */
-        test_producer_consumer(node_id, num_nodes);
-        dsm_barrier(9001, num_nodes);  /* Sync between tests */
-        test_read_sharing(node_id, num_nodes);
-        dsm_barrier(9002, num_nodes);  /* Final sync */
-    } else if (num_nodes >= 4) {
-        printf("--- Four-Node Tests ---\n");
-        test_parallel_sum(node_id, num_nodes);
-        dsm_barrier(9003, num_nodes);  /* Sync between tests */
-        test_shared_counter(node_id, num_nodes);
+    /* CRITICAL: Final barrier before cleanup */
+    dsm_barrier(8101, num_nodes);
+
+    dsm_arena_destroy(arena);
+}
+
+/**
+ * Test G2: Collective allocation
+ */
+void test_collective_alloc(int node_id, int num_nodes) {
+    printf("[Node %d] Starting collective allocation test...\n", node_id);
+
+    const int PART_INTS = 3000;  /* Partitions of 3 pages */
+    size_t stride = 0;
+
+    /* No barrier needed: the call itself is the only synchronization */
+    int *base = dsm_malloc_collective(PART_INTS * sizeof(int), NULL, &stride);
+    if (!base) {
+        printf("[Node %d] Failed to allocate collectively\n", node_id);
+        return;
+    }
+    int *mine = (int*)((char*)base + (size_t)node_id * stride);
+
+    dsm_stats_t before, after;
+    dsm_get_stats(&before);
+    for (int i = 0; i < PART_INTS; i++) {
+        mine[i] = node_id * 100000 + i;
+    }
+    dsm_get_stats(&after);
+    uint64_t own_fetches = after.pages_fetched - before.pages_fetched;
+
+    /* Barrier 8200: All partitions written */
+    dsm_barrier(8200, num_nodes);
+
+    int errors = 0;
+    for (int n = 0; n < num_nodes; n++) {
+        const int *part = (const int*)((char*)base + (size_t)n * stride);
+        for (int i = 0; i < PART_INTS; i++) {
+            if (part[i] != n * 100000 + i) {
+                errors++;
+            }
+        }
+    }
+
+    if (errors == 0 && own_fetches == 0) {
+        printf("[Node %d] ✓ Collective allocation test PASSED\n", node_id);
+    } else {
+        printf("[Node %d] ✗ Collective allocation test FAILED (%d wrong values, %lu fetches)\n",
+               node_id, errors, own_fetches);
+    }
+
+    /* CRITICAL: Final barrier before cleanup */
+    dsm_barrier(8201, num_nodes);
+
+    dsm_free(base);
+}
+
+/**
+ * Test H: Lock token caching
+ */
+void test_lock_token(int node_id, int num_nodes) {
+    printf("[Node %d] Starting lock token test...\n", node_id);
+
+    const int SOLO = 50;
+    const int SHARED = 100;
+    int *counter = NULL;
+
+    if (node_id == 0) {
+        counter = (int*)dsm_malloc(sizeof(int));
+        if (counter) {
+            *counter = 0;
+        }
+    }
+
+    /* Barrier 82: Wait for allocation */
+    dsm_barrier(82, num_nodes);
+
+    if (node_id != 0) {
+        counter = (int*)dsm_get_allocation(0);
+    }
+
+    dsm_lock_t *lock = dsm_lock_create(6000);
+    if (!counter || !lock) {
+        printf("[Node %d] Failed to set up lock token test\n", node_id);
+        return;
+    }
+
+    /* Node 1 alone: every acquire after the first uses the cached token */
+    dsm_stats_t before, after;
+    dsm_get_stats(&before);
+    if (node_id == 1) {
+        for (int i = 0; i < SOLO; i++) {
+            dsm_lock_acquire(lock);
+            (*counter)++;
+            dsm_lock_release(lock);
+        }
+    }
+    dsm_get_stats(&after);
+    uint64_t cached = after.lock_cached_acquires - before.lock_cached_acquires;
+
+    /* Barrier 8200: Solo phase done */
+    dsm_barrier(8200, num_nodes);
+
+    /* All nodes contend: the token is recalled back and forth */
+    for (int i = 0; i < SHARED; i++) {
+        dsm_lock_acquire(lock);
+        (*counter)++;
+        dsm_lock_release(lock);
+    }
+
+    /* Barrier 8201: All increments done */
+    dsm_barrier(8201, num_nodes);
+
+    dsm_lock_acquire(lock);
+    int total = *counter;
+    dsm_lock_release(lock);
+
+    int expected = SOLO + num_nodes * SHARED;
+    bool cached_ok = node_id != 1 || cached == (uint64_t)SOLO - 1;
+    printf("[Node %d] Counter %d (expected %d), %lu cached acquires while alone\n",
+           node_id, total, expected, cached);
+    if (total == expected && cached_ok) {
+        printf("[Node %d] ✓ Lock token test PASSED\n", node_id);
+    } else {
+        printf("[Node %d] ✗ Lock token test FAILED\n", node_id);
+    }
+
+    /* CRITICAL: Final barrier before cleanup */
+    dsm_barrier(8202, num_nodes);
+
+    dsm_lock_destroy(lock);
+    dsm_free(counter);
+}
+
+/**
+ * Test I: Data bound to a lock arrives with the lock
+ */
+void test_lock_bound_data(int node_id, int num_nodes) {
+    printf("[Node %d] Starting lock bound data test...\n", node_id);
+
+    const int PAGES = 8;
+    const int INTS_PER_PAGE = PAGE_SIZE / sizeof(int);
+    int *data = NULL;
+
+    if (node_id == 0) {
+        data = (int*)dsm_malloc(PAGES * PAGE_SIZE);
+        if (data) {
+            memset(data, 0, PAGES * PAGE_SIZE);
+        }
+    }
+
+    /* Barrier 83: Wait for allocation */
+    dsm_barrier(83, num_nodes);
+
+    if (node_id != 0) {
+        data = (int*)dsm_get_allocation(0);
+    }
+
+    dsm_lock_t *lock = dsm_lock_create(6100);
+    if (!data || !lock || dsm_lock_bind(lock, data, PAGES * PAGE_SIZE) != DSM_SUCCESS) {
+        printf("[Node %d] Failed to set up lock bound data test\n", node_id);
+        return;
+    }
+
+    /* Each node in turn, and node 0 once more at the end, reads what the
+     * previous one wrote and writes the next value; the bound pages are
+     * fetched by the acquire, not by faults */
+    bool ok = true;
+    uint64_t faults = 0;
+    for (int turn = 0; turn <= num_nodes; turn++) {
+        if (turn % num_nodes == node_id) {
+            dsm_lock_acquire(lock);
+            dsm_stats_t before, after;
+            dsm_get_stats(&before);
+            for (int p = 0; p < PAGES; p++) {
+                ok = ok && data[p * INTS_PER_PAGE] == turn;
+            }
+            dsm_get_stats(&after);
+            faults += after.read_faults - before.read_faults;
+            for (int p = 0; p < PAGES; p++) {
+                data[p * INTS_PER_PAGE] = turn + 1;
+            }
+            dsm_lock_release(lock);
+        }
+
+        /* Barrier 8300 + turn: This turn is done */
+        dsm_barrier(8300 + turn, num_nodes);
+    }
+
+    /* Only pages that did not arrive in time fault; allow one straggler */
+    printf("[Node %d] %lu read faults on bound data after acquire\n", node_id, faults);
+    if (ok && faults <= 1) {
+        printf("[Node %d] ✓ Lock bound data test PASSED\n", node_id);
+    } else {
+        printf("[Node %d] ✗ Lock bound data test FAILED\n", node_id);
+    }
+
+    /* CRITICAL: Final barrier before cleanup */
+    dsm_barrier(8399, num_nodes);
+
+    dsm_lock_destroy(lock);
+    dsm_free(data);
+}
+
+/**
+ * Test J: Reader-writer lock shared across nodes
+ */
+void test_rwlock_shared(int node_id, int num_nodes) {
+    printf("[Node %d] Starting reader-writer lock test...\n", node_id);
+
+    const int WRITES = 50;
+    const int READS = 20;
+    int *counter = NULL;
+
+    if (node_id == 0) {
+        counter = (int*)dsm_malloc(sizeof(int));
+        if (counter) {
+            *counter = 0;
+        }
+    }
+
+    /* Barrier 84: Wait for allocation */
+    dsm_barrier(84, num_nodes);
+
+    if (node_id != 0) {
+        counter = (int*)dsm_get_allocation(0);
+    }
+
+    dsm_rwlock_t *rwlock = dsm_rwlock_create(6200);
+    if (!counter || !rwlock) {
+        printf("[Node %d] Failed to set up reader-writer lock test\n", node_id);
+        return;
+    }
+
+    /* Every node holds the lock for reading across a barrier: this only
+     * completes if readers of different nodes hold it at once */
+    bool ok = dsm_rwlock_rdlock(rwlock) == DSM_SUCCESS;
+    ok = ok && *counter == 0;
+    dsm_barrier(8400, num_nodes);
+    ok = ok && dsm_rwlock_unlock(rwlock) == DSM_SUCCESS;
+
+    /* Writers exclude each other */
+    for (int i = 0; i < WRITES; i++) {
+        dsm_rwlock_wrlock(rwlock);
+        (*counter)++;
+        dsm_rwlock_unlock(rwlock);
+    }
+
+    /* Barrier 8401: All writes done */
+    dsm_barrier(8401, num_nodes);
+
+    /* Without writers, reads after the first use the cached shared token */
+    dsm_stats_t before, after;
+    dsm_get_stats(&before);
+    int total = 0;
+    for (int i = 0; i < READS; i++) {
+        dsm_rwlock_rdlock(rwlock);
+        total = *counter;
+        dsm_rwlock_unlock(rwlock);
+    }
+    dsm_get_stats(&after);
+    uint64_t cached = after.lock_cached_acquires - before.lock_cached_acquires;
+
+    int expected = num_nodes * WRITES;
+    printf("[Node %d] Counter %d (expected %d), %lu of %d reads from a cached token\n",
+           node_id, total, expected, cached, READS);
+    if (ok && total == expected && cached >= (uint64_t)READS - 1) {
+        printf("[Node %d] ✓ Reader-writer lock test PASSED\n", node_id);
+    } else {
+        printf("[Node %d] ✗ Reader-writer lock test FAILED\n", node_id);
+    }
+
+    /* CRITICAL: Final barrier before cleanup */
+    dsm_barrier(8402, num_nodes);
+
+    dsm_rwlock_destroy(rwlock);
+    dsm_free(counter);
+}
+
+/**
+ * Test K: Barrier write notices (--release only)
+ * Node 0 changes one of two pages every node caches; after the barrier
+ * the workers refetch only that page.
+ */
+void test_write_notices(int node_id, int num_nodes) {
+    printf("[Node %d] Starting write-notice test...\n", node_id);
+
+    int *data = NULL;
+
+    if (node_id == 0) {
+        data = (int*)dsm_malloc(2 * PAGE_SIZE);
+        if (data) {
+            data[0] = 1;
+            data[PAGE_SIZE / sizeof(int)] = 2;
+        }
+    }
+
+    /* Barrier 85: Wait for allocation */
+    dsm_barrier(85, num_nodes);
+
+    if (node_id != 0) {
+        data = (int*)dsm_get_allocation(0);
+    }
+
+    if (!data) {
+        printf("[Node %d] Failed to allocate DSM memory\n", node_id);
+        return;
+    }
+
+    int *written = &data[0];
+    int *untouched = &data[PAGE_SIZE / sizeof(int)];
+    bool ok = *written == 1 && *untouched == 2;
+
+    /* Barrier 8500: Every node caches both pages */
+    dsm_barrier(8500, num_nodes);
+
+    if (node_id == 0) {
+        *written = 10;
+    }
+
+    /* Barrier 8501: Only the written page is noticed */
+    dsm_barrier(8501, num_nodes);
+
+    dsm_stats_t before, after;
+    dsm_get_stats(&before);
+    ok = ok && *written == 10 && *untouched == 2;
+    dsm_get_stats(&after);
+    uint64_t faults = after.read_faults - before.read_faults;
+
+    printf("[Node %d] %lu read faults after the barrier, %lu notice invalidations\n",
+           node_id, faults, after.notice_invalidations);
+    if (ok && (node_id == 0 || faults == 1)) {
+        printf("[Node %d] ✓ Write-notice test PASSED\n", node_id);
+    } else {
+        printf("[Node %d] ✗ Write-notice test FAILED\n", node_id);
+    }
+
+    /* CRITICAL: Final barrier before cleanup */
+    dsm_barrier(8502, num_nodes);
+    dsm_free(data);
+}
+
+/**
+ * Test L2: Ownership hand-off races (sequential consistency)
+ * Node 0 and node 1 take turns incrementing a counter with no lock or
+ * barrier between turns, each spinning on its cached copy until the other
+ * node's write invalidates it. A node that kept a stale copy after handing
+ * the page over never sees its turn. Then node 0 writes a rising value
+ * while node 1 spins reading it: each of node 0's writes must invalidate
+ * the copy it has just sent, or node 1 is left on an old value.
+ */
+void test_handoff_races(int node_id, int num_nodes) {
+    printf("[Node %d] Starting hand-off races test...\n", node_id);
+
+    const int ROUNDS = 200;
+    const int STREAM_MS = 1000;
+    const int INTS_PER_PAGE = PAGE_SIZE / sizeof(int);
+    uint64_t addrs[2] = {0, 0};
+
+    /* The streamed page is incompressible and LZ-enabled, so each reply
+     * spends a while compressing it between the downgrade and the send */
+    if (node_id == 0) {
+        int *turn_page = (int*)dsm_malloc(PAGE_SIZE);
+        int *stream_page = (int*)dsm_malloc_ex(PAGE_SIZE, DSM_COMPRESSION_LZ, 0);
+        if (turn_page && stream_page) {
+            turn_page[0] = 0;
+            for (int i = 0; i < INTS_PER_PAGE; i++) {
+                stream_page[i] = (int)((uint32_t)i * 2654435761u);
+            }
+            stream_page[0] = 0;
+        }
+        addrs[0] = (uintptr_t)turn_page;
+        addrs[1] = (uintptr_t)stream_page;
+    }
+
+    /* Barrier 93: Wait for allocation */
+    dsm_barrier(93, num_nodes);
+    dsm_broadcast(addrs, sizeof(addrs), 0);
+    volatile int *turn = (volatile int*)(uintptr_t)addrs[0];
+    volatile int *stream = (volatile int*)(uintptr_t)addrs[1];
+    if (!turn || !stream) {
+        printf("[Node %d] Failed to allocate DSM memory\n", node_id);
+        return;
+    }
+
+    /* Ping-pong: the page changes hands on every increment */
+    time_t deadline = time(NULL) + 20;
+    int mine = 0;
+    while (time(NULL) < deadline) {
+        int t = *turn;
+        if (t >= 2 * ROUNDS) {
+            break;
+        }
+        if (t % 2 == node_id) {
+            *turn = t + 1;
+            mine++;
+        }
+    }
+    bool ok = *turn == 2 * ROUNDS && mine == ROUNDS;
+
+    /* Barrier 9300: Ping-pong is done */
+    dsm_barrier(9300, num_nodes);
+
+    /* Node 0 keeps writing, so it writes right after serving each of
+     * node 1's reads, and ends with INT_MAX */
+    int seen = 0;
+    deadline = time(NULL) + 20;
+    if (node_id == 0) {
+        struct timespec start, now;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int v = 0;
+        do {
+            for (int k = 0; k < 1024; k++) {
+                *stream = ++v;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &now);
+        } while ((now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000 < STREAM_MS);
+        *stream = INT_MAX;
+    } else if (node_id == 1) {
+        while (seen != INT_MAX && time(NULL) < deadline) {
+            int v = *stream;
+            if (v < seen) {
+                ok = false;
+                break;
+            }
+            seen = v;
+        }
+        ok = ok && seen == INT_MAX;
+    }
+
+    /* Barrier 9301: Everyone is done with the pages */
+    dsm_barrier(9301, num_nodes);
+
+    if (ok) {
+        printf("[Node %d] ✓ Hand-off races test PASSED (%d turns)\n", node_id, mine);
+    } else {
+        printf("[Node %d] ✗ Hand-off races test FAILED (turn=%d, %d mine, stream seen %d)\n",
+               node_id, *turn, mine, seen);
+    }
+
+    dsm_free((void*)turn);
+    dsm_free((void*)stream);
+}
+
+/**
+ * Test L: Read-to-Write Upgrade
+ * Node 1 reads pages then writes them; node 0, the owner, grants write
+ * access without resending the pages node 1 already holds.
+ */
+void test_write_upgrade(int node_id, int num_nodes) {
+    printf("[Node %d] Starting read-to-write upgrade test...\n", node_id);
+
+    const int NUM_PAGES = 4;
+    const int INTS_PER_PAGE = PAGE_SIZE / sizeof(int);
+    int *data = NULL;
+
+    if (node_id == 0) {
+        data = (int*)dsm_malloc(NUM_PAGES * PAGE_SIZE);
+        if (data) {
+            for (int p = 0; p < NUM_PAGES; p++) {
+                data[p * INTS_PER_PAGE] = p;
+            }
+        }
+    }
+
+    /* Counted before the barrier: node 1 may be done upgrading before
+     * node 0's thread has woken from it */
+    dsm_stats_t before, after;
+    dsm_get_stats(&before);
+
+    /* Barrier 86: Wait for allocation */
+    dsm_barrier(86, num_nodes);
+
+    if (node_id != 0) {
+        data = (int*)dsm_get_allocation(0);
+    }
+
+    if (!data) {
+        printf("[Node %d] Failed to allocate DSM memory\n", node_id);
+        return;
+    }
+
+    bool ok = true;
+    if (node_id == 1) {
+        for (int p = 0; p < NUM_PAGES; p++) {
+            int v = data[p * INTS_PER_PAGE];
+            data[p * INTS_PER_PAGE] = v + 100;
+            ok = ok && v == p;
+        }
+    }
+
+    /* Barrier 8600: Node 1 owns every page */
+    dsm_barrier(8600, num_nodes);
+
+    dsm_get_stats(&after);
+    uint64_t skipped = after.page_data_skipped - before.page_data_skipped;
+    for (int p = 0; p < NUM_PAGES; p++) {
+        ok = ok && data[p * INTS_PER_PAGE] == p + 100;
+    }
+
+    printf("[Node %d] Write grants without data: %lu\n", node_id, skipped);
+    if (ok && (node_id != 0 || skipped == (uint64_t)NUM_PAGES)) {
+        printf("[Node %d] ✓ Read-to-write upgrade test PASSED\n", node_id);
+    } else {
+        printf("[Node %d] ✗ Read-to-write upgrade test FAILED\n", node_id);
+    }
+
+    /* CRITICAL: Final barrier before cleanup */
+    dsm_barrier(8601, num_nodes);
+    dsm_free(data);
+}
+
+/**
+ * Test M: One-sided transfers
+ * Node 1 reads and writes node 0's partition with dsm_get()/dsm_put():
+ * no page faults there, and node 0 sees the put in its own copy.
+ */
+void test_rma(int node_id, int num_nodes) {
+    printf("[Node %d] Starting one-sided transfer test...\n", node_id);
+
+    const int PART_INTS = 5000;  /* Partitions of 5 pages */
+    size_t stride = 0;
+
+    int *base = dsm_malloc_collective(PART_INTS * sizeof(int), NULL, &stride);
+    if (!base) {
+        printf("[Node %d] Failed to allocate collectively\n", node_id);
+        return;
+    }
+    int *mine = (int*)((char*)base + (size_t)node_id * stride);
+    for (int i = 0; i < PART_INTS; i++) {
+        mine[i] = node_id * 100000 + i;
+    }
+
+    /* Barrier 8700: All partitions written */
+    dsm_barrier(8700, num_nodes);
+
+    bool ok = true;
+    int *buf = malloc(2 * stride);
+    if (node_id == 1 && buf) {
+        dsm_stats_t before, after;
+        dsm_get_stats(&before);
+
+        /* Node 0's partition, then a range spanning both */
+        ok = dsm_get(buf, base, PART_INTS * sizeof(int)) == DSM_SUCCESS;
+        for (int i = 0; ok && i < PART_INTS; i++) {
+            ok = buf[i] == i;
+        }
+        memset(buf, 0, 2 * stride);
+        ok = ok && dsm_get(buf, base, 2 * stride) == DSM_SUCCESS;
+        for (int n = 0; ok && n < num_nodes; n++) {
+            const int *part = (const int*)((char*)buf + (size_t)n * stride);
+            for (int i = 0; ok && i < PART_INTS; i++) {
+                ok = part[i] == n * 100000 + i;
+            }
+        }
+
+        /* Overwrite the middle of node 0's partition */
+        for (int i = 0; i < PART_INTS / 2; i++) {
+            buf[i] = -i;
+        }
+        dsm_rma_t *handle = NULL;
+        ok = ok && dsm_put_nb(base + PART_INTS / 4, buf, (PART_INTS / 2) * sizeof(int), &handle) == DSM_SUCCESS &&
+             dsm_rma_wait(handle) == DSM_SUCCESS;
+
+        dsm_get_stats(&after);
+        printf("[Node %d] One-sided: %lu requests, %lu faults, %lu fallbacks\n", node_id,
+               after.rma_requests - before.rma_requests, after.page_faults - before.page_faults,
+               after.rma_fallbacks - before.rma_fallbacks);
+        ok = ok && after.page_faults == before.page_faults && after.rma_requests > before.rma_requests &&
+             after.rma_fallbacks == before.rma_fallbacks;
+    }
+
+    /* Barrier 8701: Put applied */
+    dsm_barrier(8701, num_nodes);
+
+    dsm_stats_t stats;
+    dsm_get_stats(&stats);
+    for (int i = 0; i < PART_INTS; i++) {
+        int expected = i >= PART_INTS / 4 && i < PART_INTS / 4 + PART_INTS / 2 ? -(i - PART_INTS / 4) : i;
+        ok = ok && base[i] == expected;
+    }
+    if (node_id == 0) {
+        ok = ok && stats.rma_segments_served > 0;
+    }
+
+    if (ok && buf) {
+        printf("[Node %d] ✓ One-sided transfer test PASSED\n", node_id);
+    } else {
+        printf("[Node %d] ✗ One-sided transfer test FAILED\n", node_id);
+    }
+
+    /* CRITICAL: Final barrier before cleanup */
+    dsm_barrier(8702, num_nodes);
+    free(buf);
+    dsm_free(base);
+}
+
+/**
+ * Test N: Remote atomics
+ * Both nodes add to a counter in node 0's partition with
+ * dsm_atomic_fetch_add32(), race a compare-and-swap and node 1 swaps a
+ * word: no update is lost and node 1 takes no page faults.
+ */
+void test_atomics(int node_id, int num_nodes) {
+    printf("[Node %d] Starting remote atomics test...\n", node_id);
+
+    const int ADDS = 200;
+    size_t stride = 0;
+
+    uint32_t *base = dsm_malloc_collective(PAGE_SIZE, NULL, &stride);
+    if (!base) {
+        printf("[Node %d] Failed to allocate collectively\n", node_id);
+        return;
+    }
+    uint32_t *counter = &base[0];
+    uint32_t *slot = &base[1];
+    uint64_t *word = (uint64_t *)&base[2];
+    if (node_id == 0) {
+        *counter = 0;
+        *slot = 0;
+        *word = 0x1234567890ULL;
+    }
+
+    /* Barrier 8800: Node 0's partition initialized */
+    dsm_barrier(8800, num_nodes);
+
+    dsm_stats_t before, after;
+    dsm_get_stats(&before);
+    bool ok = true;
+    for (int i = 0; ok && i < ADDS; i++) {
+        ok = dsm_atomic_fetch_add32(counter, 1, NULL) == DSM_SUCCESS;
+    }
+    uint32_t cas_old = 0;
+    ok = ok && dsm_atomic_cas32(slot, 0, (uint32_t)node_id + 1, &cas_old) == DSM_SUCCESS;
+    uint64_t swap_old = 0;
+    if (node_id == 1) {
+        ok = ok && dsm_atomic_swap64(word, 77, &swap_old) == DSM_SUCCESS && swap_old == 0x1234567890ULL;
+    }
+    dsm_get_stats(&after);
+    if (node_id == 1) {
+        printf("[Node %d] Atomics: %lu ops, %lu requests, %lu faults\n", node_id,
+               after.atomic_ops - before.atomic_ops, after.rma_requests - before.rma_requests,
+               after.page_faults - before.page_faults);
+        ok = ok && after.page_faults == before.page_faults && after.rma_requests > before.rma_requests;
+    }
+
+    /* Barrier 8801: Every atomic applied */
+    dsm_barrier(8801, num_nodes);
+
+    uint32_t total = *counter;
+    uint32_t winner = *slot;
+    ok = ok && total == (uint32_t)(ADDS * num_nodes) && *word == 77;
+    ok = ok && winner >= 1 && winner <= (uint32_t)num_nodes &&
+         (cas_old == 0) == (winner == (uint32_t)node_id + 1);
+    if (cas_old != 0) {
+        ok = ok && cas_old == winner;
+    }
+
+    if (ok) {
+        printf("[Node %d] ✓ Remote atomics test PASSED (counter=%u)\n", node_id, total);
+    } else {
+        printf("[Node %d] ✗ Remote atomics test FAILED (counter=%u, slot=%u)\n", node_id, total, winner);
+    }
+
+    /* CRITICAL: Final barrier before cleanup */
+    dsm_barrier(8802, num_nodes);
+    dsm_free(base);
+}
+
+/**
+ * Test O: Collectives
+ * Every node contributes to an allreduce, a reduce to the last node and a
+ * broadcast from node 0; nobody touches a DSM page.
+ */
+void test_collectives(int node_id, int num_nodes) {
+    printf("[Node %d] Starting collectives test...\n", node_id);
+
+    dsm_stats_t before, after;
+    dsm_get_stats(&before);
+
+    /* Sum, min and max of values every node derives from its ID */
+    int64_t sums[4];
+    for (int i = 0; i < 4; i++) {
+        sums[i] = (int64_t)(node_id + 1) * (i + 1);
+    }
+    double extremes[2] = { node_id * 1.5, node_id * 1.5 };
+    bool ok = dsm_allreduce(sums, 4, DSM_TYPE_INT64, DSM_REDUCE_SUM) == DSM_SUCCESS;
+    ok = ok && dsm_allreduce(&extremes[0], 1, DSM_TYPE_DOUBLE, DSM_REDUCE_MIN) == DSM_SUCCESS &&
+         dsm_allreduce(&extremes[1], 1, DSM_TYPE_DOUBLE, DSM_REDUCE_MAX) == DSM_SUCCESS;
+    int64_t node_sum = (int64_t)num_nodes * (num_nodes + 1) / 2;
+    for (int i = 0; ok && i < 4; i++) {
+        ok = sums[i] == node_sum * (i + 1);
+    }
+    ok = ok && extremes[0] == 0.0 && extremes[1] == (num_nodes - 1) * 1.5;
+
+    /* Only the root of a reduce gets the result */
+    uint32_t product = (uint32_t)node_id + 2;
+    node_id_t last = (node_id_t)(num_nodes - 1);
+    ok = ok && dsm_reduce(&product, 1, DSM_TYPE_UINT32, DSM_REDUCE_PROD, last) == DSM_SUCCESS;
+    uint32_t expected = 1;
+    for (int n = 0; n < num_nodes; n++) {
+        expected *= (uint32_t)n + 2;
+    }
+    ok = ok && product == ((node_id_t)node_id == last ? expected : (uint32_t)node_id + 2);
+
+    /* Node 0's buffer reaches everyone */
+    char message[64];
+    memset(message, 0, sizeof(message));
+    if (node_id == 0) {
+        snprintf(message, sizeof(message), "broadcast from node 0 of %d", num_nodes);
+    }
+    ok = ok && dsm_broadcast(message, sizeof(message), 0) == DSM_SUCCESS;
+    char want[64];
+    snprintf(want, sizeof(want), "broadcast from node 0 of %d", num_nodes);
+    ok = ok && strcmp(message, want) == 0;
+
+    dsm_get_stats(&after);
+    ok = ok && after.collectives == before.collectives + 5 && after.page_faults == before.page_faults;
+
+    if (ok) {
+        printf("[Node %d] ✓ Collectives test PASSED (sum=%ld)\n", node_id, (long)sums[0]);
+    } else {
+        printf("[Node %d] ✗ Collectives test FAILED (sum=%ld, product=%u)\n", node_id, (long)sums[0], product);
+    }
+}
+
+/**
+ * Test S: Coordinated checkpoint
+ * Node 0 fills an array, Node 1 overwrites its second half, and both take
+ * a checkpoint into dir. Run again with --restore <dir> to check the
+ * restart (see test_restart()).
+ */
+void test_checkpoint(int node_id, int num_nodes, const char *dir) {
+    printf("[Node %d] Starting checkpoint test...\n", node_id);
+
+    const int NUM_PAGES = 8;
+    const int INTS_PER_PAGE = PAGE_SIZE / sizeof(int);
+    const int HALF = NUM_PAGES / 2 * INTS_PER_PAGE;
+    uint64_t addr = 0;
+
+    if (node_id == 0) {
+        int *data = (int*)dsm_malloc(NUM_PAGES * PAGE_SIZE);
+        if (data) {
+            for (int i = 0; i < NUM_PAGES * INTS_PER_PAGE; i++) {
+                data[i] = i;
+            }
+        }
+        addr = (uintptr_t)data;
+    }
+    dsm_broadcast(&addr, sizeof(addr), 0);
+    int *shared_data = (int*)(uintptr_t)addr;
+    if (!shared_data) {
+        printf("[Node %d] Failed to allocate DSM memory\n", node_id);
+        return;
+    }
+
+    if (node_id == 1) {
+        for (int i = HALF; i < 2 * HALF; i++) {
+            shared_data[i] = -i;
+        }
+    }
+
+    /* Barrier 90: Node 1's writes are done */
+    dsm_barrier(90, num_nodes);
+
+    int rc = dsm_checkpoint(dir);
+
+    /* The checkpoint leaves memory as it was */
+    int errors = 0;
+    for (int i = 0; i < 2 * HALF; i++) {
+        if (shared_data[i] != (i < HALF ? i : -i)) {
+            errors++;
+        }
+    }
+
+    if (rc == DSM_SUCCESS && errors == 0) {
+        printf("[Node %d] ✓ Checkpoint test PASSED (saved to %s)\n", node_id, dir);
+    } else {
+        printf("[Node %d] ✗ Checkpoint test FAILED (rc=%d, %d wrong values)\n", node_id, rc, errors);
+    }
+}
+
+/**
+ * Test S2: Restart from a checkpoint
+ * Run with --restore after test_checkpoint(): its array is the last
+ * allocation on every node. Every node reads it back, fetching the half
+ * the other node saved, and then writes to it.
+ */
+void test_restart(int node_id, int num_nodes) {
+    printf("[Node %d] Starting restart test...\n", node_id);
+
+    const int NUM_PAGES = 8;
+    const int INTS_PER_PAGE = PAGE_SIZE / sizeof(int);
+    const int HALF = NUM_PAGES / 2 * INTS_PER_PAGE;
+
+    int last = 0;
+    while (dsm_get_allocation(last + 1)) {
+        last++;
+    }
+    int *shared_data = (int*)dsm_get_allocation(last);
+    if (!shared_data) {
+        printf("[Node %d] ✗ Restart test FAILED (nothing restored)\n", node_id);
+        return;
+    }
+
+    int errors = 0;
+    for (int i = 0; i < 2 * HALF; i++) {
+        if (shared_data[i] != (i < HALF ? i : -i)) {
+            errors++;
+        }
+    }
+
+    /* Barrier 91: Everyone has read it, then each node writes the other's half */
+    dsm_barrier(91, num_nodes);
+    if (node_id < 2) {
+        int start = node_id == 0 ? HALF : 0;
+        for (int i = start; i < start + HALF; i++) {
+            shared_data[i] = 7 * i;
+        }
+    }
+
+    /* Barrier 92: Writes are done */
+    dsm_barrier(92, num_nodes);
+    for (int i = 0; i < 2 * HALF; i++) {
+        if (shared_data[i] != 7 * i) {
+            errors++;
+        }
+    }
+
+    if (errors == 0) {
+        printf("[Node %d] ✓ Restart test PASSED (%d allocations restored)\n", node_id, last + 1);
+    } else {
+        printf("[Node %d] ✗ Restart test FAILED (%d wrong values)\n", node_id, errors);
+    }
+}
+
+/* ================================================================
+ * Task 10.3: Four-Node Tests
+ * ================================================================ */
+
+/**
+ * Test A: Parallel Sum
+ */
+void test_parallel_sum(int node_id, int num_nodes) {
+    printf("[Node %d] Starting parallel sum test...\n", node_id);
+
+    const int ARRAY_SIZE = 1000;
+    int *array = NULL;
+    int *partial_sums = NULL;
+
+    if (node_id == 0) {
+        array = (int*)dsm_malloc(ARRAY_SIZE * sizeof(int));
+        partial_sums = (int*)dsm_malloc(num_nodes * sizeof(int));
+    }
+    
+    /* Barrier 40: Wait for allocation */
+    dsm_barrier(40, num_nodes);
+    
+    if (node_id != 0) {
+        array = (int*)dsm_get_allocation(0);
+        partial_sums = (int*)dsm_get_allocation(1);
+    }
+
+    if (!array || !partial_sums) {
+        printf("[Node %d] Failed to allocate DSM memory\n", node_id);
+        return;
+    }
+
+    if (node_id == 0) {
+        /* Initialize array */
+        for (int i = 0; i < ARRAY_SIZE; i++) {
+            array[i] = i + 1;
+        }
+        printf("[Node %d] Initialized array\n", node_id);
+    }
+
+    /* Synchronize */
+    dsm_barrier(4000, num_nodes);
+
+    /* Each node sums its portion */
+    int per_node = ARRAY_SIZE / num_nodes;
+    int start = node_id * per_node;
+    int end = (node_id == num_nodes - 1) ? ARRAY_SIZE : (node_id + 1) * per_node;
+
+    int local_sum = 0;
+    for (int i = start; i < end; i++) {
+        local_sum += array[i];
+    }
+
+    partial_sums[node_id] = local_sum;
+    printf("[Node %d] Partial sum: %d (range %d-%d)\n", node_id, local_sum, start, end - 1);
+
+    /* Synchronize */
+    dsm_barrier(4001, num_nodes); /* Changed ID to avoid collision */
+
+    if (node_id == 0) {
+        /* Compute total sum */
+        int total = 0;
+        for (int i = 0; i < num_nodes; i++) {
+            total += partial_sums[i];
+        }
+
+        int expected = (ARRAY_SIZE * (ARRAY_SIZE + 1)) / 2;  /* Sum of 1 to N */
+        printf("[Node %d] Total sum: %d (expected %d)\n", node_id, total, expected);
+
+        if (total == expected) {
+            printf("[Node %d] ✓ Parallel sum test PASSED\n", node_id);
+        } else {
+            printf("[Node %d] ✗ Parallel sum test FAILED\n", node_id);
+        }
+    }
+
+    /* Node 0 may still be fetching the partial sums */
+    dsm_barrier(4002, num_nodes);
+
+    dsm_free(array);
+    dsm_free(partial_sums);
+}
+
+/**
+ * Test B: Shared Counter with Locks
+ */
+void test_shared_counter(int node_id, int num_nodes) {
+    printf("[Node %d] Starting shared counter test...\n", node_id);
+
+    int *counter = NULL;
+    
+    if (node_id == 0) {
+        counter = (int*)dsm_malloc(sizeof(int));
+    }
+    
+    /* Barrier 50: Wait for allocation */
+    dsm_barrier(50, num_nodes);
+    
+    if (node_id != 0) {
+        counter = (int*)dsm_get_allocation(0);
+    }
+
+    if (!counter) {
+        printf("[Node %d] Failed to allocate DSM memory\n", node_id);
+        return;
+    }
+
+    dsm_lock_t *lock = dsm_lock_create(5000);
+    if (!lock) {
+        printf("[Node %d] Failed to create lock\n", node_id);
+        dsm_free(counter);
+        return;
+    }
+
+    if (node_id == 0) {
+        *counter = 0;
+    }
+
+    dsm_barrier(5001, num_nodes);
+
+    /* Each node increments counter 100 times */
+    for (int i = 0; i < 100; i++) {
+        dsm_lock_acquire(lock);
+        (*counter)++;
+        dsm_lock_release(lock);
+    }
+
+    dsm_barrier(5002, num_nodes); /* Changed ID to avoid collision */
+
+    if (node_id == 0) {
+        int expected = num_nodes * 100;
+        printf("[Node %d] Final counter: %d (expected %d)\n", node_id, *counter, expected);
+
+        if (*counter == expected) {
+            printf("[Node %d] ✓ Shared counter test PASSED\n", node_id);
+        } else {
+            printf("[Node %d] ✗ Shared counter test FAILED\n", node_id);
+        }
+    }
+
+    /* Node 0 may still be fetching the counter from its last writer */
+    dsm_barrier(5003, num_nodes);
+
+    dsm_lock_destroy(lock);
+    dsm_free(counter);
+}
+
+/**
+ * Test C: Compressed pages
+ * Node 0 fills an LZ-compressed array with dense pages, which fall back to
+ * raw pages, and sparse ones, which go out compressed. Every node reads it
+ * all, then writes its slot of a compressed result page.
+ */
+void test_compressed_pages(int node_id, int num_nodes) {
+    printf("[Node %d] Starting compressed pages test...\n", node_id);
+
+    const int NUM_PAGES = 8;
+    const int DENSE_PAGES = NUM_PAGES / 2;
+    const int INTS_PER_PAGE = PAGE_SIZE / sizeof(int);
+    uint64_t addrs[2] = {0, 0};
+
+    if (node_id == 0) {
+        int *data = (int*)dsm_malloc_ex(NUM_PAGES * PAGE_SIZE, DSM_COMPRESSION_LZ, 0);
+        int *slots = (int*)dsm_malloc_ex(PAGE_SIZE, DSM_COMPRESSION_LZ, 0);
+        if (data) {
+            for (int i = 0; i < NUM_PAGES * INTS_PER_PAGE; i++) {
+                if (i < DENSE_PAGES * INTS_PER_PAGE) {
+                    data[i] = (int)((uint32_t)i * 2654435761u);
+                } else {
+                    data[i] = i % 64 == 0 ? i : 0;
+                }
+            }
+        }
+        addrs[0] = (uintptr_t)data;
+        addrs[1] = (uintptr_t)slots;
+    }
+
+    /* Node 0 sends the pages the others read */
+    dsm_stats_t before, after;
+    dsm_get_stats(&before);
+
+    /* Barrier 41: Allocation and initialization are done */
+    dsm_barrier(41, num_nodes);
+    dsm_broadcast(addrs, sizeof(addrs), 0);
+    int *data = (int*)(uintptr_t)addrs[0];
+    int *slots = (int*)(uintptr_t)addrs[1];
+    if (!data || !slots) {
+        printf("[Node %d] Failed to allocate DSM memory\n", node_id);
+        return;
+    }
+
+    int64_t errors = 0;
+    for (int i = 0; i < NUM_PAGES * INTS_PER_PAGE; i++) {
+        int want = i < DENSE_PAGES * INTS_PER_PAGE ? (int)((uint32_t)i * 2654435761u)
+                                                   : (i % 64 == 0 ? i : 0);
+        if (data[i] != want) {
+            errors++;
+        }
+    }
+
+    /* Barrier 4100: Everyone has read the array */
+    dsm_barrier(4100, num_nodes);
+    dsm_get_stats(&after);
+
+    /* Every reader got the sparse pages compressed */
+    uint64_t compressed = after.pages_compressed - before.pages_compressed;
+    if (node_id == 0 && compressed < (uint64_t)((num_nodes - 1) * (NUM_PAGES - DENSE_PAGES))) {
+        errors++;
+    }
+    slots[node_id * 16] = node_id + 1;
+
+    /* Barrier 4101: Slots are written */
+    dsm_barrier(4101, num_nodes);
+    if (node_id == 0) {
+        for (int n = 0; n < num_nodes; n++) {
+            if (slots[n * 16] != n + 1) {
+                errors++;
+            }
+        }
+    }
+    dsm_allreduce(&errors, 1, DSM_TYPE_INT64, DSM_REDUCE_SUM);
+
+    if (node_id == 0) {
+        if (errors == 0) {
+            printf("[Node %d] ✓ Compressed pages test PASSED (%lu pages sent compressed)\n",
+                   node_id, compressed);
+        } else {
+            printf("[Node %d] ✗ Compressed pages test FAILED (%ld errors)\n", node_id, (long)errors);
+        }
+    }
+
+    /* Barrier 4102: Nobody touches the pages any more */
+    dsm_barrier(4102, num_nodes);
+    dsm_free(data);
+    dsm_free(slots);
+}
+
+/**
+ * Test D: Links between workers
+ * Each worker reads the next worker's partition with dsm_get(): the
+ * request and reply go over a link the two open on first use, not
+ * through the manager.
+ */
+void test_peer_links(int node_id, int num_nodes) {
+    printf("[Node %d] Starting peer link test...\n", node_id);
+
+    const int PART_INTS = 2048;  /* Partitions of 2 pages */
+    size_t stride = 0;
+
+    int *base = dsm_malloc_collective(PART_INTS * sizeof(int), NULL, &stride);
+    if (!base) {
+        printf("[Node %d] Failed to allocate collectively\n", node_id);
+        return;
+    }
+    int *mine = (int*)((char*)base + (size_t)node_id * stride);
+    for (int i = 0; i < PART_INTS; i++) {
+        mine[i] = node_id * 100000 + i;
+    }
+
+    /* Barrier 4200: All partitions written */
+    dsm_barrier(4200, num_nodes);
+
+    bool ok = true;
+    if (node_id != 0) {
+        int next = node_id % (num_nodes - 1) + 1;
+        int *buf = malloc(PART_INTS * sizeof(int));
+        dsm_peer_stats_t before, after;
+        dsm_get_peer_stats((node_id_t)next, &before);
+
+        ok = buf && dsm_get(buf, (char*)base + (size_t)next * stride, PART_INTS * sizeof(int)) == DSM_SUCCESS;
+        for (int i = 0; ok && i < PART_INTS; i++) {
+            ok = buf[i] == next * 100000 + i;
+        }
+
+        /* Relayed requests would count as frames sent to the manager */
+        dsm_get_peer_stats((node_id_t)next, &after);
+        printf("[Node %d] Read node %d's partition, %lu frames sent to it\n", node_id, next,
+               after.frames_sent - before.frames_sent);
+        ok = ok && after.frames_sent > before.frames_sent;
+        free(buf);
+    }
+
+    if (ok) {
+        printf("[Node %d] ✓ Peer link test PASSED\n", node_id);
+    } else {
+        printf("[Node %d] ✗ Peer link test FAILED\n", node_id);
+    }
+
+    /* Barrier 4201: Reads done before the partitions go */
+    dsm_barrier(4201, num_nodes);
+    dsm_free(base);
+}
+
+/**
+ * Test E: Stale owner hint (sequential consistency)
+ * Node 1 reads node 0's page, then nodes 2 and 3 write it in turn. Node 2's
+ * write invalidates node 1's copy and names node 2 as owner; node 3's write
+ * does not reach node 1, so its hint goes stale. Node 1's next read goes to
+ * node 2 through the directory node, which passes it on to node 3.
+ */
+void test_stale_owner_hint(int node_id, int num_nodes) {
+    printf("[Node %d] Starting stale owner hint test...\n", node_id);
+
+    size_t stride = 0;
+    int *base = dsm_malloc_collective(PAGE_SIZE, NULL, &stride);
+    if (!base) {
+        printf("[Node %d] Failed to allocate collectively\n", node_id);
+        return;
+    }
+    volatile int *page = base;  /* Node 0's partition */
+    if (node_id == 0) {
+        page[0] = 1;
+    }
+
+    /* Barrier 4300: Page written by its first owner */
+    dsm_barrier(4300, num_nodes);
+
+    bool ok = true;
+    if (node_id == 1) {
+        ok = page[0] == 1;
+    }
+
+    /* Barrier 4301: Node 1 holds a copy */
+    dsm_barrier(4301, num_nodes);
+    if (node_id == 2) {
+        page[0] = 2;
+    }
+
+    /* Barrier 4302: Node 1's hint names node 2 */
+    dsm_barrier(4302, num_nodes);
+    if (node_id == 3) {
+        page[0] = 3;
+    }
+
+    /* Barrier 4303: Node 3 owns the page; node 1 was not told */
+    dsm_barrier(4303, num_nodes);
+    dsm_stats_t before, after;
+    dsm_get_stats(&before);
+
+    /* Barrier 4304: Only node 1's read is counted from here */
+    dsm_barrier(4304, num_nodes);
+    if (node_id == 1) {
+        ok = ok && page[0] == 3;
+    }
+
+    /* Barrier 4305: Read done */
+    dsm_barrier(4305, num_nodes);
+    dsm_get_stats(&after);
+    uint64_t forwarded = after.requests_forwarded - before.requests_forwarded;
+    ok = dsm_allreduce(&forwarded, 1, DSM_TYPE_UINT64, DSM_REDUCE_SUM) == DSM_SUCCESS && ok;
+
+    printf("[Node %d] Requests forwarded to the owner: %lu\n", node_id, forwarded);
+    if (ok && forwarded >= 1) {
+        printf("[Node %d] ✓ Stale owner hint test PASSED\n", node_id);
+    } else {
+        printf("[Node %d] ✗ Stale owner hint test FAILED\n", node_id);
+    }
+
+    /* Barrier 4306: Counted before the page goes */
+    dsm_barrier(4306, num_nodes);
+    dsm_free(base);
+}
+
+/* ================================================================
+ * Main
+ * ================================================================ */
+
+void print_usage(const char *prog) {
+    printf("Usage:\n");
+    printf("  Manager: %s --manager --nodes <N> [--port <P>] [--release] [--prefetch <N>] [--dissemination] [--userfaultfd] [--rdma] [--no-shm] [--lanes <N>] [--busy-poll <US>] [--async-replication] [--adaptive] [--profile-sharing <N>] [--metrics <PATH>] [--metrics-port <P>] [--metrics-bind <ADDR>] [--async-log] [--distributed-directory] [--checkpoint-dir <DIR>] [--restore <DIR>]\n", prog);
+    printf("  Worker:  %s --worker --node-id <ID> --manager-host <HOST> [--manager-port <P>] [--release] [--prefetch <N>] [--dissemination] [--userfaultfd] [--rdma] [--no-shm] [--lanes <N>] [--busy-poll <US>] [--async-replication] [--adaptive] [--profile-sharing <N>] [--metrics <PATH>] [--metrics-port <P>] [--metrics-bind <ADDR>] [--async-log] [--distributed-directory] [--checkpoint-dir <DIR>] [--restore <DIR>]\n", prog);
+    printf("  --release: use release consistency (must be given to every node)\n");
+    printf("  --prefetch <N>: prefetch up to N pages ahead of sequential faults\n");
+    printf("  --dissemination: run whole-cluster barriers as dissemination barriers (must be given to every node)\n");
+    printf("  --userfaultfd: catch page faults with userfaultfd instead of SIGSEGV\n");
+    printf("  --rdma: move peer traffic to RDMA when built with RDMA=1 and a device is up\n");
+    printf("  --no-shm: keep peers on the same host off the shared-memory transport\n");
+    printf("  --lanes <N>: use N TCP connections per peer that stays on TCP\n");
+    printf("  --busy-poll <US>: busy-poll peer sockets for up to US microseconds\n");
+    printf("  --async-replication: ship the manager's replication log to the backup in the background\n");
+    printf("  --adaptive: adapt page grants to observed access patterns\n");
+    printf("  --profile-sharing <N>: profile false sharing on up to N pages\n");
+    printf("  --metrics <PATH>: publish live metrics to the file PATH\n");
+    printf("  --metrics-port <P>: serve Prometheus metrics on port P\n");
+    printf("  --metrics-bind <ADDR>: address the metrics port listens on (default 127.0.0.1)\n");
+    printf("  --async-log: format log lines on a background thread\n");
+    printf("  --distributed-directory: track each page on its home node instead of the manager (must be given to every node)\n");
+    printf("  --checkpoint-dir <DIR>: write the checkpoint test's snapshots to DIR (default /tmp/dsm_checkpoint)\n");
+    printf("  --restore <DIR>: restart from the checkpoint in DIR and only run the restart test\n");
+}
+
+int main(int argc, char *argv[]) {
+    int is_manager = 0;
+    int node_id = -1;
+    int num_nodes = 2;
+    char manager_host[256] = "localhost";
+    int port = 5000;
+    dsm_consistency_t consistency = DSM_CONSISTENCY_SEQUENTIAL;
+    int prefetch_depth = 0;
+    int num_handler_threads = 0;
+    dsm_barrier_algorithm_t barrier_algorithm = DSM_BARRIER_CENTRAL;
+    dsm_fault_engine_t fault_engine = DSM_FAULT_SIGSEGV;
+    dsm_transport_t transport = DSM_TRANSPORT_TCP;
+    bool disable_shm = false;
+    int tcp_lanes = 0;
+    int busy_poll_us = 0;
+    dsm_replication_t replication = DSM_REPLICATION_BEFORE_REPLY;
+    bool adaptive = false;
+    int sharing_profile_pages = 0;
+    const char *metrics_path = NULL;
+    int metrics_port = 0;
+    const char *metrics_bind = NULL;
+    bool log_async = false;
+    dsm_directory_t directory = DSM_DIRECTORY_CENTRAL;
+    const char *checkpoint_dir = "/tmp/dsm_checkpoint";
+    const char *restore_path = NULL;
+
+    /* Parse arguments */
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--manager") == 0) {
+            is_manager = 1;
+            node_id = 0;
+        } else if (strcmp(argv[i], "--worker") == 0) {
+            is_manager = 0;
+        } else if (strcmp(argv[i], "--node-id") == 0 && i + 1 < argc) {
+            node_id = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--nodes") == 0 && i + 1 < argc) {
+            num_nodes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--manager-host") == 0 && i + 1 < argc) {
+            strncpy(manager_host, argv[++i], sizeof(manager_host) - 1);
+        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--manager-port") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--release") == 0) {
+            consistency = DSM_CONSISTENCY_RELEASE;
+        } else if (strcmp(argv[i], "--prefetch") == 0 && i + 1 < argc) {
+            prefetch_depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--handlers") == 0 && i + 1 < argc) {
+            num_handler_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--dissemination") == 0) {
+            barrier_algorithm = DSM_BARRIER_DISSEMINATION;
+        } else if (strcmp(argv[i], "--userfaultfd") == 0) {
+            fault_engine = DSM_FAULT_USERFAULTFD;
+        } else if (strcmp(argv[i], "--rdma") == 0) {
+            transport = DSM_TRANSPORT_RDMA;
+        } else if (strcmp(argv[i], "--no-shm") == 0) {
+            disable_shm = true;
+        } else if (strcmp(argv[i], "--lanes") == 0 && i + 1 < argc) {
+            tcp_lanes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--busy-poll") == 0 && i + 1 < argc) {
+            busy_poll_us = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--async-replication") == 0) {
+            replication = DSM_REPLICATION_ASYNC;
+        } else if (strcmp(argv[i], "--adaptive") == 0) {
+            adaptive = true;
+        } else if (strcmp(argv[i], "--profile-sharing") == 0 && i + 1 < argc) {
+            sharing_profile_pages = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            metrics_path = argv[++i];
+        } else if (strcmp(argv[i], "--metrics-port") == 0 && i + 1 < argc) {
+            metrics_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--metrics-bind") == 0 && i + 1 < argc) {
+            metrics_bind = argv[++i];
+        } else if (strcmp(argv[i], "--async-log") == 0) {
+            log_async = true;
+        } else if (strcmp(argv[i], "--distributed-directory") == 0) {
+            directory = DSM_DIRECTORY_DISTRIBUTED;
+        } else if (strcmp(argv[i], "--checkpoint-dir") == 0 && i + 1 < argc) {
+            checkpoint_dir = argv[++i];
+        } else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc) {
+            restore_path = argv[++i];
+        }
+    }
+
+    if (node_id < 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    /* Initialize DSM */
+    dsm_config_t config = {
+        .node_id = node_id,
+        .port = port + node_id,
+        .num_nodes = num_nodes,
+        .is_manager = is_manager,
+        .log_level = LOG_LEVEL_INFO,
+        .log_async = log_async,
+        .consistency = consistency,
+        .prefetch_depth = prefetch_depth,
+        .num_handler_threads = num_handler_threads,
+        .barrier_algorithm = barrier_algorithm,
+        .fault_engine = fault_engine,
+        .transport = transport,
+        .disable_shm = disable_shm,
+        .tcp_lanes = tcp_lanes,
+        .busy_poll_us = busy_poll_us,
+        .replication = replication,
+        .directory = directory,
+        .adaptive = adaptive,
+        .sharing_profile_pages = sharing_profile_pages,
+        .metrics_path = metrics_path,
+        .metrics_port = metrics_port,
+        .metrics_bind = metrics_bind,
+        .restore_path = restore_path
+    };
+
+    if (!is_manager) {
+        strncpy(config.manager_host, manager_host, sizeof(config.manager_host) - 1);
+        config.manager_port = port;
+    }
+
+    printf("\n=== Multi-Node DSM Tests (Node %d) ===\n\n", node_id);
+
+    if (dsm_init(&config) != DSM_SUCCESS) {
+        printf("Failed to initialize DSM\n");
+        return 1;
+    }
+
+    /* Run tests based on number of nodes */
+    if (restore_path) {
+        printf("--- Restart Test ---\n");
+        test_restart(node_id, num_nodes);
+        dsm_barrier(9005, num_nodes);  /* Final sync */
+    } else if (num_nodes == 2) {
+        printf("--- Two-Node Tests ---\n");
+        test_ping_pong(node_id, num_nodes);
+        dsm_barrier(9000, num_nodes);  /* Sync between tests */
+        test_producer_consumer(node_id, num_nodes);
+        dsm_barrier(9001, num_nodes);  /* Sync between tests */
+        test_read_sharing(node_id, num_nodes);
+        dsm_barrier(9002, num_nodes);  /* Sync between tests */
+        if (consistency == DSM_CONSISTENCY_RELEASE) {
+            /* Needs multiple writers per page */
+            test_false_sharing(node_id, num_nodes);
+        }
+        dsm_barrier(9006, num_nodes);  /* Sync between tests */
+        test_bulk_prefetch(node_id, num_nodes);
+        dsm_barrier(9018, num_nodes);  /* Sync between tests */
+        test_async_acquire(node_id, num_nodes);
+        dsm_barrier(9007, num_nodes);  /* Sync between tests */
+        test_placement(node_id, num_nodes);
+        dsm_barrier(9008, num_nodes);  /* Sync between tests */
+        test_arena_shared(node_id, num_nodes);
+        dsm_barrier(9009, num_nodes);  /* Sync between tests */
+        test_collective_alloc(node_id, num_nodes);
+        dsm_barrier(9014, num_nodes);  /* Sync between tests */
+        test_lock_token(node_id, num_nodes);
+        dsm_barrier(9010, num_nodes);  /* Sync between tests */
+        test_lock_bound_data(node_id, num_nodes);
+        dsm_barrier(9011, num_nodes);  /* Sync between tests */
+        test_rwlock_shared(node_id, num_nodes);
+        if (consistency == DSM_CONSISTENCY_RELEASE) {
+            /* Write notices only exist under release consistency */
+            dsm_barrier(9012, num_nodes);  /* Sync between tests */
+            test_write_notices(node_id, num_nodes);
+        } else {
+            /* Under release consistency writes do not move ownership */
+            dsm_barrier(9013, num_nodes);  /* Sync between tests */
+            test_write_upgrade(node_id, num_nodes);
+            dsm_barrier(9022, num_nodes);  /* Sync between tests */
+            test_handoff_races(node_id, num_nodes);
+        }
+        dsm_barrier(9015, num_nodes);  /* Sync between tests */
+        test_rma(node_id, num_nodes);
+        dsm_barrier(9016, num_nodes);  /* Sync between tests */
+        test_atomics(node_id, num_nodes);
+        dsm_barrier(9017, num_nodes);  /* Sync between tests */
+        test_collectives(node_id, num_nodes);
+        dsm_barrier(9021, num_nodes);  /* Sync between tests */
+        test_compressed_pages(node_id, num_nodes);
+        dsm_barrier(9019, num_nodes);  /* Sync between tests */
+        test_checkpoint(node_id, num_nodes, checkpoint_dir);
+        dsm_barrier(9005, num_nodes);  /* Final sync */
+    } else if (num_nodes >= 4) {
+        printf("--- Four-Node Tests ---\n");
+        test_parallel_sum(node_id, num_nodes);
+        dsm_barrier(9003, num_nodes);  /* Sync between tests */
+        test_shared_counter(node_id, num_nodes);
+        dsm_barrier(9023, num_nodes);  /* Sync between tests */
+        test_peer_links(node_id, num_nodes);
+        if (consistency == DSM_CONSISTENCY_SEQUENTIAL) {
+            /* Under release consistency writes do not move ownership */
+            dsm_barrier(9024, num_nodes);  /* Sync between tests */
+            test_stale_owner_hint(node_id, num_nodes);
+        }
+        dsm_barrier(9020, num_nodes);  /* Sync between tests */
+        test_compressed_pages(node_id, num_nodes);
         dsm_barrier(9004, num_nodes);  /* Final sync */
     }
 
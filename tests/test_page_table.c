@@ -4,6 +4,7 @@
  */
 
 #include "../src/memory/page_table.h"
+#include "../src/memory/page_index.h"
 #include "../src/core/log.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -35,7 +36,7 @@ int test_create_destroy(void) {
         return 0;
     }
 
-    page_table_t *table = page_table_create(base, TEST_SIZE, 0, 0);
+    page_table_t *table = page_table_create(base, TEST_SIZE, 0, 0, PAGE_SIZE);
     if (!table) {
         munmap(base, TEST_SIZE);
         return 0;
@@ -59,7 +60,7 @@ int test_lookup_by_addr(void) {
         return 0;
     }
 
-    page_table_t *table = page_table_create(base, TEST_SIZE, 0, 0);
+    page_table_t *table = page_table_create(base, TEST_SIZE, 0, 0, PAGE_SIZE);
     if (!table) {
         munmap(base, TEST_SIZE);
         return 0;
@@ -103,7 +104,7 @@ int test_lookup_by_id(void) {
         return 0;
     }
 
-    page_table_t *table = page_table_create(base, TEST_SIZE, 0, 0);
+    page_table_t *table = page_table_create(base, TEST_SIZE, 0, 0, PAGE_SIZE);
     if (!table) {
         munmap(base, TEST_SIZE);
         return 0;
@@ -139,7 +140,7 @@ int test_set_owner(void) {
         return 0;
     }
 
-    page_table_t *table = page_table_create(base, TEST_SIZE, 0, 0);
+    page_table_t *table = page_table_create(base, TEST_SIZE, 0, 0, PAGE_SIZE);
     if (!table) {
         munmap(base, TEST_SIZE);
         return 0;
@@ -173,7 +174,7 @@ int test_set_state(void) {
         return 0;
     }
 
-    page_table_t *table = page_table_create(base, TEST_SIZE, 0, 0);
+    page_table_t *table = page_table_create(base, TEST_SIZE, 0, 0, PAGE_SIZE);
     if (!table) {
         munmap(base, TEST_SIZE);
         return 0;
@@ -227,6 +228,159 @@ int test_page_addr_helpers(void) {
     return 1;
 }
 
+int test_block_size(void) {
+    void *base = mmap(NULL, TEST_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        return 0;
+    }
+
+    /* Sizes that are not a power-of-two multiple of PAGE_SIZE are refused */
+    int ok = page_table_create(base, TEST_SIZE, 0, 0, 3 * PAGE_SIZE) == NULL &&
+             page_table_create(base, TEST_SIZE, 0, 0, PAGE_SIZE / 2) == NULL &&
+             page_table_create(base, TEST_SIZE, 0, 0, 2 * DSM_MAX_BLOCK_SIZE) == NULL;
+
+    /* 16 OS pages as four 16KB blocks: one entry, one ID per block */
+    size_t block = 4 * PAGE_SIZE;
+    page_table_t *table = page_table_create(base, TEST_SIZE, 0, 0, block);
+    if (!table) {
+        munmap(base, TEST_SIZE);
+        return 0;
+    }
+
+    char *addr = (char*)base + 2 * block + 3 * PAGE_SIZE + 5;
+    page_entry_t *entry = page_table_lookup_by_addr(table, addr);
+    ok = ok && table->num_pages == 4 && table->block_size == block;
+    ok = ok && entry == &table->entries[2] && entry->local_addr == (char*)base + 2 * block;
+    ok = ok && page_addr_to_id(table, addr) == 2;
+    ok = ok && page_id_to_addr(table, 3) == (char*)base + 3 * block;
+
+    /* The index maps any byte of a block to the block's entry */
+    ok = ok && page_index_insert(table) == DSM_SUCCESS;
+    page_table_t *found = NULL;
+    ok = ok && page_index_lookup_addr(addr, &found) == entry && found == table;
+    ok = ok && page_index_lookup_addr((char*)base + TEST_SIZE - 1, NULL) == &table->entries[3];
+
+    page_index_cleanup();
+    page_table_destroy(table);
+    munmap(base, TEST_SIZE);
+    return ok;
+}
+
+int test_placement(void) {
+    /* Ten pages over three nodes: runs of four, or dealt one at a time */
+    int ok = 1;
+    node_id_t block[10] = {0, 0, 0, 0, 1, 1, 1, 1, 2, 2};
+    for (size_t i = 0; i < 10; i++) {
+        ok = ok && page_placement_owner(DSM_PLACEMENT_BLOCK, 0, i, 10, 3) == block[i];
+        ok = ok && page_placement_owner(DSM_PLACEMENT_CYCLIC, 0, i, 10, 3) == (node_id_t)(i % 3);
+        ok = ok && page_placement_owner(DSM_PLACEMENT_LOCAL, 1, i, 10, 3) == 1;
+        ok = ok && page_placement_owner(DSM_PLACEMENT_HOME, 2, i, 10, 3) == 2;
+        ok = ok && page_placement_owner(DSM_PLACEMENT_FIRST_TOUCH, 1, i, 10, 3) == DSM_NODE_NONE;
+    }
+
+    void *base = mmap(NULL, TEST_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        return 0;
+    }
+    page_table_t *table = page_table_create(base, TEST_SIZE, 1, 0, PAGE_SIZE);
+    if (!table) {
+        munmap(base, TEST_SIZE);
+        return 0;
+    }
+    page_table_place(table, DSM_PLACEMENT_CYCLIC, 1, 2);
+    ok = ok && table->placement == DSM_PLACEMENT_CYCLIC;
+    for (size_t i = 0; i < table->num_pages; i++) {
+        ok = ok && table->entries[i].owner == (node_id_t)(i % 2) &&
+             table->entries[i].home == table->entries[i].owner;
+    }
+    page_table_destroy(table);
+    munmap(base, TEST_SIZE);
+    return ok;
+}
+
+int test_page_index(void) {
+    /* Four 4-page tables over every other 4-page slice, inserted out of order */
+    size_t slice = 4 * PAGE_SIZE;
+    char *base = mmap(NULL, 8 * slice, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        return 0;
+    }
+
+    int order[4] = {2, 0, 3, 1};
+    page_table_t *tables[4];
+    int ok = 1;
+    for (int i = 0; i < 4; i++) {
+        int k = order[i];
+        tables[k] = page_table_create(base + 2 * k * slice, slice, 1, k, PAGE_SIZE);
+        if (!tables[k] || page_index_insert(tables[k]) != DSM_SUCCESS) {
+            munmap(base, 8 * slice);
+            return 0;
+        }
+    }
+
+    for (int k = 0; k < 4 && ok; k++) {
+        page_table_t *found = NULL;
+        char *addr = base + 2 * k * slice + PAGE_SIZE + 17;
+        page_entry_t *entry = page_index_lookup_addr(addr, &found);
+        ok = entry == &tables[k]->entries[1] && found == tables[k];
+
+        entry = page_index_lookup_id(tables[k]->start_page_id + 3, &found);
+        ok = ok && entry == &tables[k]->entries[3] && found == tables[k];
+
+        /* Gap after each table and the ID just past its range */
+        ok = ok && page_index_lookup_addr(base + (2 * k + 1) * slice, NULL) == NULL;
+        ok = ok && page_index_lookup_id(tables[k]->start_page_id + 4, NULL) == NULL;
+    }
+
+    /* Removed tables are no longer found */
+    ok = ok && page_index_remove(tables[2]) == DSM_SUCCESS;
+    ok = ok && page_index_lookup_addr(base + 4 * slice, NULL) == NULL;
+    ok = ok && page_index_lookup_addr(base + 6 * slice, NULL) != NULL;
+
+    page_index_cleanup();
+    for (int k = 0; k < 4; k++) {
+        page_table_destroy(tables[k]);
+    }
+    munmap(base, 8 * slice);
+    return ok;
+}
+
+int test_wait_buckets(void) {
+    void *base = mmap(NULL, TEST_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        return 0;
+    }
+
+    page_table_t *table = page_table_create(base, TEST_SIZE, 0, 0, PAGE_SIZE);
+    if (!table) {
+        munmap(base, TEST_SIZE);
+        return 0;
+    }
+
+    /* Neighbouring pages never share a bucket */
+    int ok = 1;
+    for (size_t i = 0; i + 1 < table->num_pages && ok; i++) {
+        ok = page_entry_lock(&table->entries[i]) != page_entry_lock(&table->entries[i + 1]) &&
+             page_entry_ready_cv(&table->entries[i]) == &page_wait_bucket(&table->entries[i])->ready_cv;
+    }
+
+    /* The bucket lock works on a freshly created table */
+    page_entry_t *entry = &table->entries[3];
+    ok = ok && pthread_mutex_lock(page_entry_lock(entry)) == 0;
+    entry->request_pending = true;
+    ok = ok && pthread_mutex_unlock(page_entry_lock(entry)) == 0;
+    ok = ok && pthread_mutex_trylock(page_entry_lock(&table->entries[4])) == 0;
+    pthread_mutex_unlock(page_entry_lock(&table->entries[4]));
+
+    page_table_destroy(table);
+    munmap(base, TEST_SIZE);
+    return ok;
+}
+
 int main(void) {
     log_init(LOG_LEVEL_ERROR);
 
@@ -238,6 +392,10 @@ int main(void) {
     RUN_TEST(test_set_owner);
     RUN_TEST(test_set_state);
     RUN_TEST(test_page_addr_helpers);
+    RUN_TEST(test_block_size);
+    RUN_TEST(test_placement);
+    RUN_TEST(test_page_index);
+    RUN_TEST(test_wait_buckets);
 
     printf("\n=== Test Summary ===\n");
     printf("Passed: %d\n", tests_passed);
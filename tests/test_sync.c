@@ -7,6 +7,7 @@
 #include "../src/core/log.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <assert.h>
@@ -237,6 +238,198 @@ int test_lock_statistics() {
     return success ? 1 : 0;
 }
 
+/**
+ * Test 5: Re-acquires use the cached token
+ */
+int test_lock_cached_token() {
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 15208,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    if (dsm_init(&config) != DSM_SUCCESS) {
+        return 0;
+    }
+
+    dsm_reset_stats();
+
+    dsm_lock_t *lock = dsm_lock_create(104);
+    if (!lock) {
+        dsm_finalize();
+        return 0;
+    }
+
+    /* Only the first acquire has to take the token from the directory */
+    int success = 1;
+    for (int i = 0; i < 10 && success; i++) {
+        success = dsm_lock_acquire(lock) == DSM_SUCCESS &&
+                  dsm_lock_release(lock) == DSM_SUCCESS;
+    }
+
+    /* Releasing a lock that is not held is still an error */
+    success = success && dsm_lock_release(lock) == DSM_ERROR_PERMISSION;
+
+    dsm_stats_t stats;
+    dsm_get_stats(&stats);
+    success = success && stats.lock_acquires == 10 && stats.lock_cached_acquires == 9;
+    if (!success) {
+        fprintf(stderr, "Cached acquires: got %lu of %lu, expected 9 of 10\n",
+                stats.lock_cached_acquires, stats.lock_acquires);
+    }
+
+    dsm_lock_destroy(lock);
+    dsm_finalize();
+    return success ? 1 : 0;
+}
+
+/**
+ * Test binding data ranges to a lock
+ */
+int test_lock_bind() {
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 15209,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_NONE
+    };
+
+    if (dsm_init(&config) != DSM_SUCCESS) {
+        return 0;
+    }
+
+    dsm_lock_t *lock = dsm_lock_create(105);
+    int *data = dsm_malloc(2 * PAGE_SIZE);
+    if (!lock || !data) {
+        dsm_finalize();
+        return 0;
+    }
+
+    int local = 0;
+    int success = dsm_lock_bind(lock, data, 2 * PAGE_SIZE) == DSM_SUCCESS &&
+                  dsm_lock_bind(lock, NULL, PAGE_SIZE) == DSM_ERROR_INVALID &&
+                  dsm_lock_bind(lock, data, 0) == DSM_ERROR_INVALID &&
+                  dsm_lock_bind(lock, &local, sizeof(local)) == DSM_ERROR_NOT_FOUND;
+
+    /* The first binding is in place; fill the rest of the slots */
+    for (int i = 1; i < 8 && success; i++) {
+        success = dsm_lock_bind(lock, data, sizeof(int)) == DSM_SUCCESS;
+    }
+    success = success && dsm_lock_bind(lock, data, sizeof(int)) == DSM_ERROR_MEMORY;
+
+    /* Bound data is used under the lock as any other */
+    success = success && dsm_lock_acquire(lock) == DSM_SUCCESS;
+    if (success) {
+        data[0] = 7;
+        data[PAGE_SIZE / sizeof(int)] = 8;
+        success = dsm_lock_release(lock) == DSM_SUCCESS;
+    }
+    success = success && data[0] == 7 && data[PAGE_SIZE / sizeof(int)] == 8;
+
+    dsm_lock_destroy(lock);
+    dsm_free(data);
+    dsm_finalize();
+    return success ? 1 : 0;
+}
+
+/**
+ * Thread worker for reader-writer lock testing
+ */
+static int rw_inside = 0;
+static int rw_max_inside = 0;
+static pthread_mutex_t rw_count_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void* rwlock_reader_thread(void *arg) {
+    dsm_rwlock_t *rwlock = (dsm_rwlock_t*)arg;
+
+    if (dsm_rwlock_rdlock(rwlock) != DSM_SUCCESS) {
+        return NULL;
+    }
+    pthread_mutex_lock(&rw_count_lock);
+    rw_inside++;
+    if (rw_inside > rw_max_inside) {
+        rw_max_inside = rw_inside;
+    }
+    pthread_mutex_unlock(&rw_count_lock);
+
+    usleep(50000);  /* Stay inside so the others overlap */
+
+    pthread_mutex_lock(&rw_count_lock);
+    rw_inside--;
+    pthread_mutex_unlock(&rw_count_lock);
+    dsm_rwlock_unlock(rwlock);
+    return NULL;
+}
+
+/**
+ * Test reader-writer lock: readers share, a writer excludes them
+ */
+int test_rwlock_basic() {
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 15210,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    if (dsm_init(&config) != DSM_SUCCESS) {
+        return 0;
+    }
+
+    dsm_reset_stats();
+
+    dsm_rwlock_t *rwlock = dsm_rwlock_create(106);
+    if (!rwlock) {
+        dsm_finalize();
+        return 0;
+    }
+
+    const int NUM_READERS = 4;
+    pthread_t threads[NUM_READERS];
+    rw_inside = 0;
+    rw_max_inside = 0;
+
+    for (int i = 0; i < NUM_READERS; i++) {
+        pthread_create(&threads[i], NULL, rwlock_reader_thread, rwlock);
+    }
+    for (int i = 0; i < NUM_READERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    int success = rw_max_inside == NUM_READERS;
+    if (!success) {
+        fprintf(stderr, "Readers inside at once: %d, expected %d\n", rw_max_inside, NUM_READERS);
+    }
+
+    /* A reader waits for the writer */
+    success = success && dsm_rwlock_wrlock(rwlock) == DSM_SUCCESS;
+    rw_max_inside = 0;
+    pthread_t reader;
+    pthread_create(&reader, NULL, rwlock_reader_thread, rwlock);
+    usleep(100000);
+    pthread_mutex_lock(&rw_count_lock);
+    success = success && rw_max_inside == 0;
+    pthread_mutex_unlock(&rw_count_lock);
+    success = success && dsm_rwlock_unlock(rwlock) == DSM_SUCCESS;
+    pthread_join(reader, NULL);
+    success = success && rw_max_inside == 1;
+
+    /* Unlocking a lock no thread holds is an error */
+    success = success && dsm_rwlock_unlock(rwlock) == DSM_ERROR_PERMISSION;
+
+    dsm_stats_t stats;
+    dsm_get_stats(&stats);
+    success = success && stats.lock_shared_acquires == (uint64_t)NUM_READERS + 1 &&
+              stats.lock_acquires == (uint64_t)NUM_READERS + 2;
+
+    dsm_rwlock_destroy(rwlock);
+    dsm_finalize();
+    return success ? 1 : 0;
+}
+
 /**
  * Thread worker for barrier testing
  */
@@ -411,6 +604,93 @@ int test_barrier_scaling() {
     return success ? 1 : 0;
 }
 
+/**
+ * Test 7b: Many distinct barrier IDs (one per phase, as iterative codes use)
+ */
+int test_barrier_many_ids() {
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 15211,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    if (dsm_init(&config) != DSM_SUCCESS) {
+        return 0;
+    }
+
+    dsm_reset_stats();
+
+    /* Each ID is created once and found again on the second pass */
+    int success = 1;
+    for (int pass = 0; pass < 2 && success; pass++) {
+        for (barrier_id_t id = 1000; id < 3000; id++) {
+            if (dsm_barrier(id, 1) != DSM_SUCCESS) {
+                fprintf(stderr, "Barrier %lu failed on pass %d\n", id, pass);
+                success = 0;
+                break;
+            }
+        }
+    }
+
+    dsm_stats_t stats;
+    dsm_get_stats(&stats);
+    if (success && stats.barrier_waits != 4000) {
+        fprintf(stderr, "Barrier stat mismatch: got %lu, expected 4000\n", stats.barrier_waits);
+        success = 0;
+    }
+
+    dsm_finalize();
+    return success;
+}
+
+/**
+ * Collectives on one node: the buffer already holds the result, and bad
+ * arguments are rejected before any barrier
+ */
+int test_collectives_single_node() {
+    dsm_config_t config = {
+        .node_id = 0,
+        .port = 15213,
+        .num_nodes = 1,
+        .is_manager = true,
+        .log_level = LOG_LEVEL_ERROR
+    };
+
+    if (dsm_init(&config) != DSM_SUCCESS) {
+        return 0;
+    }
+
+    dsm_reset_stats();
+
+    int64_t sums[3] = { 4, -5, 6 };
+    double max = 2.5;
+    char text[8] = "hello";
+    int success = dsm_allreduce(sums, 3, DSM_TYPE_INT64, DSM_REDUCE_SUM) == DSM_SUCCESS &&
+                  sums[0] == 4 && sums[1] == -5 && sums[2] == 6 &&
+                  dsm_reduce(&max, 1, DSM_TYPE_DOUBLE, DSM_REDUCE_MAX, 0) == DSM_SUCCESS && max == 2.5 &&
+                  dsm_broadcast(text, sizeof(text), 0) == DSM_SUCCESS && strcmp(text, "hello") == 0;
+
+    dsm_stats_t stats;
+    dsm_get_stats(&stats);
+    success = success && stats.collectives == 3 &&
+              stats.collective_bytes == sizeof(sums) + sizeof(max) + sizeof(text);
+
+    /* Bad type, op, size or root */
+    success = success &&
+              dsm_allreduce(sums, 3, (dsm_datatype_t)99, DSM_REDUCE_SUM) == DSM_ERROR_INVALID &&
+              dsm_allreduce(sums, 3, DSM_TYPE_INT64, (dsm_reduce_op_t)99) == DSM_ERROR_INVALID &&
+              dsm_allreduce(sums, 0, DSM_TYPE_INT64, DSM_REDUCE_SUM) == DSM_ERROR_INVALID &&
+              dsm_allreduce(NULL, 3, DSM_TYPE_INT64, DSM_REDUCE_SUM) == DSM_ERROR_INVALID &&
+              dsm_allreduce(sums, DSM_COLLECTIVE_MAX_BYTES, DSM_TYPE_INT64, DSM_REDUCE_SUM) == DSM_ERROR_INVALID &&
+              dsm_reduce(&max, 1, DSM_TYPE_DOUBLE, DSM_REDUCE_MAX, 1) == DSM_ERROR_INVALID &&
+              dsm_broadcast(text, DSM_COLLECTIVE_MAX_BYTES + 1, 0) == DSM_ERROR_INVALID;
+
+    dsm_finalize();
+    return success;
+}
+
 /**
  * Test 8: Lock and barrier integration
  */
@@ -490,11 +770,16 @@ int main() {
     RUN_TEST(test_lock_single_thread);
     RUN_TEST(test_lock_mutual_exclusion);
     RUN_TEST(test_lock_statistics);
+    RUN_TEST(test_lock_cached_token);
+    RUN_TEST(test_lock_bind);
+    RUN_TEST(test_rwlock_basic);
 
     printf("\n--- Barrier Tests ---\n");
     RUN_TEST(test_barrier_basic);
     RUN_TEST(test_barrier_statistics);
     RUN_TEST(test_barrier_scaling);
+    RUN_TEST(test_barrier_many_ids);
+    RUN_TEST(test_collectives_single_node);
 
     printf("\n--- Integration Tests ---\n");
     RUN_TEST(test_lock_barrier_integration);
@@ -1,11 +1,15 @@
 """Data sources package for reading DSM statistics and monitoring processes."""
 
-from dsm_visualizer.data_sources.csv_reader import CSVStatsReader, PerfLogReader
+from dsm_visualizer.data_sources.csv_reader import CSVStatsReader, PerfLogReader, SharingProfileReader
+from dsm_visualizer.data_sources.metrics_page import MetricsPageReader, MetricsSnapshot
 from dsm_visualizer.data_sources.process_monitor import GameOfLifeMonitor, ProcessEvent
 
 __all__ = [
     "CSVStatsReader",
     "PerfLogReader",
+    "SharingProfileReader",
+    "MetricsPageReader",
+    "MetricsSnapshot",
     "GameOfLifeMonitor",
     "ProcessEvent",
 ]
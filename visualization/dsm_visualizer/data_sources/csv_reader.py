@@ -18,6 +18,11 @@ perf_log.csv:
     timestamp_ns,event_type,page_id,access_type,latency_ns,was_queued
     1234567890,PAGE_FAULT,42,READ,1500,0
     ...
+
+dsm_sharing_nodeN.csv (sharing_profile.c, with sharing_profile_pages > 0):
+    rank,page_id,node_id,writers,num_writers,writes,invalidations,pingpongs,c0,...,c63
+    1,42,0,0;1,2,17,9,8,3,0,...,0
+    ...
 """
 
 import csv
@@ -25,7 +30,7 @@ from dataclasses import dataclass
 from pathlib import Path
 from typing import Dict, List, Optional
 
-from dsm_visualizer.models.dsm_stats import DSMStats, NodeStats
+from dsm_visualizer.models.dsm_stats import DSMStats, NodeStats, PageSharing
 
 
 @dataclass
@@ -33,7 +38,7 @@ class PerfEvent:
     """A single performance event from perf_log.csv."""
 
     timestamp_ns: int
-    event_type: str  # PAGE_FAULT, FALSE_SHARING
+    event_type: str  # PAGE_FAULT, FALSE_SHARING, PAGE_REQUEST, PAGE_REPLY, INVALIDATE, LOCK_ACQUIRE, LOCK_RELEASE, BARRIER
     page_id: int
     access_type: str  # READ, WRITE, NA
     latency_ns: int
@@ -225,3 +230,62 @@ class PerfLogReader:
             List of events in the time range.
         """
         return [e for e in self.read_events() if start_ns <= e.timestamp_ns <= end_ns]
+
+
+class SharingProfileReader:
+    """
+    Reads the per-node sharing profiles and merges them by page.
+
+    Each node only knows the cells it wrote itself and the writers that
+    invalidated its copies, so a page's full picture needs every file.
+
+    Files are named: dsm_sharing_node{N}.csv
+    """
+
+    def __init__(self, stats_dir: str = "."):
+        """
+        Initialize the sharing profile reader.
+
+        Args:
+            stats_dir: Directory containing the profile CSV files.
+        """
+        self.stats_dir = Path(stats_dir)
+
+    def read_pages(self) -> List[PageSharing]:
+        """
+        Read and merge every node's profile.
+
+        Returns:
+            Pages ranked by ping-pongs, then invalidations, then writes.
+        """
+        pages: Dict[int, PageSharing] = {}
+
+        for path in sorted(self.stats_dir.glob("dsm_sharing_node*.csv")):
+            try:
+                with open(path, "r") as f:
+                    for row in csv.DictReader(f):
+                        try:
+                            page_id = int(row["page_id"])
+                            node_id = int(row["node_id"])
+                            counts = []
+                            while f"c{len(counts)}" in row:
+                                counts.append(int(row[f"c{len(counts)}"]))
+                        except (ValueError, KeyError):
+                            continue
+
+                        page = pages.setdefault(page_id, PageSharing(page_id=page_id))
+                        page.writers.update(
+                            int(w) for w in row.get("writers", "").split(";") if w
+                        )
+                        page.writes += int(row.get("writes", 0) or 0)
+                        page.invalidations += int(row.get("invalidations", 0) or 0)
+                        page.pingpongs += int(row.get("pingpongs", 0) or 0)
+                        if any(counts):
+                            page.cells[node_id] = counts
+            except Exception as e:
+                print(f"Error reading {path}: {e}")
+
+        return sorted(
+            pages.values(),
+            key=lambda p: (-p.pingpongs, -p.invalidations, -p.writes, p.page_id),
+        )
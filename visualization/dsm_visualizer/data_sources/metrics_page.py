@@ -0,0 +1,183 @@
+"""Reader for the live metrics page a DSM node publishes.
+
+A node started with dsm_config_t.metrics_path (test_multinode --metrics PATH)
+maps that file and rewrites it every metrics_interval_ms under a sequence
+lock (include/dsm/metrics.h). This reader maps it read-only and copies it
+between two equal, even reads of the sequence number, so it never blocks or
+signals the node.
+
+The page describes itself: the header gives the section offsets and the
+counter and fault path names, so only the header layout is fixed here.
+"""
+
+import mmap
+import struct
+from dataclasses import dataclass, field
+from pathlib import Path
+from typing import Dict, Optional
+
+from dsm_visualizer.models.dsm_stats import NodeStats
+
+MAGIC = 0x435254454D4D5344  # "DSMMETRC"
+VERSION = 1
+
+# magic, version, size, seq, publish_time_ns, publishes, node_id, pid,
+# interval_ms, num_counters, num_paths, num_buckets, num_peers,
+# stats_offset, histograms_offset, peers_offset
+HEADER = struct.Struct("=QIIQQQIIIIIIIIII")
+SEQ_OFFSET = 16
+NAMES_OFFSET = HEADER.size
+NAMES_BYTES = 2048
+PATH_NAMES_BYTES = 128
+
+HISTOGRAM_FIELDS = ("count", "total_ns", "min_ns", "max_ns", "p50_ns", "p90_ns", "p99_ns", "p999_ns")
+PEER_FIELDS = ("frames_sent", "bytes_sent", "frames_received", "bytes_received")
+
+READ_TRIES = 100
+
+
+@dataclass
+class MetricsSnapshot:
+    """One consistent copy of a node's metrics page."""
+
+    node_id: int
+    pid: int
+    publish_time_ns: int
+    publishes: int
+    interval_ms: int
+    counters: Dict[str, int] = field(default_factory=dict)
+    histograms: Dict[str, Dict[str, int]] = field(default_factory=dict)  # path -> HISTOGRAM_FIELDS
+    peers: Dict[int, Dict[str, int]] = field(default_factory=dict)  # peers with traffic only
+
+    def to_node_stats(self) -> NodeStats:
+        """Convert to the NodeStats the stats panel draws."""
+        c = self.counters
+        return NodeStats(
+            node_id=self.node_id,
+            page_faults=c.get("page_faults", 0),
+            read_faults=c.get("read_faults", 0),
+            write_faults=c.get("write_faults", 0),
+            pages_fetched=c.get("pages_fetched", 0),
+            pages_sent=c.get("pages_sent", 0),
+            invalidations_sent=c.get("invalidations_sent", 0),
+            invalidations_received=c.get("invalidations_received", 0),
+            bytes_sent=c.get("network_bytes_sent", 0),
+            bytes_received=c.get("network_bytes_received", 0),
+            lock_acquires=c.get("lock_acquires", 0),
+            barrier_waits=c.get("barrier_waits", 0),
+            total_fault_latency_ns=c.get("total_fault_latency_ns", 0),
+            max_fault_latency_ns=c.get("max_fault_latency_ns", 0),
+            min_fault_latency_ns=c.get("min_fault_latency_ns", 0),
+        )
+
+
+class MetricsPageReader:
+    """
+    Reads snapshots from a node's metrics file while the node runs.
+
+    Usage:
+        reader = MetricsPageReader("/tmp/dsm_metrics_node0")
+        snap = reader.read()
+        if snap:
+            print(snap.counters["page_faults"])
+    """
+
+    def __init__(self, path: str):
+        """
+        Initialize the reader.
+
+        Args:
+            path: Metrics file given to the node.
+        """
+        self.path = Path(path)
+        self._file = None
+        self._map: Optional[mmap.mmap] = None
+
+    def _open(self) -> bool:
+        if self._map is not None:
+            return True
+        try:
+            self._file = open(self.path, "rb")
+            self._map = mmap.mmap(self._file.fileno(), 0, access=mmap.ACCESS_READ)
+        except (OSError, ValueError):
+            self.close()
+            return False
+        return True
+
+    def close(self) -> None:
+        """Unmap the file."""
+        if self._map is not None:
+            self._map.close()
+            self._map = None
+        if self._file is not None:
+            self._file.close()
+            self._file = None
+
+    def _seq(self) -> int:
+        return struct.unpack_from("=Q", self._map, SEQ_OFFSET)[0]
+
+    def _copy(self) -> Optional[bytes]:
+        """Copy the page under the sequence lock."""
+        for _ in range(READ_TRIES):
+            seq = self._seq()
+            if seq & 1:
+                continue
+            data = self._map[:]
+            if self._seq() == seq:
+                return data
+        return None
+
+    def read(self) -> Optional[MetricsSnapshot]:
+        """
+        Take a consistent snapshot.
+
+        Returns:
+            MetricsSnapshot, or None if the file is missing, not a metrics
+            page of this version, or busy on every attempt.
+        """
+        if not self._open():
+            return None
+        if len(self._map) < HEADER.size:
+            return None
+
+        data = self._copy()
+        if data is None:
+            return None
+
+        (magic, version, size, _seq, publish_time_ns, publishes, node_id, pid, interval_ms,
+         num_counters, num_paths, num_buckets, num_peers,
+         stats_offset, histograms_offset, peers_offset) = HEADER.unpack_from(data, 0)
+        if magic != MAGIC or version != VERSION or len(data) < size:
+            return None
+
+        names = _names(data, NAMES_OFFSET, NAMES_BYTES)
+        path_names = _names(data, NAMES_OFFSET + NAMES_BYTES, PATH_NAMES_BYTES)
+
+        values = struct.unpack_from(f"={num_counters}Q", data, stats_offset)
+        snap = MetricsSnapshot(
+            node_id=node_id,
+            pid=pid,
+            publish_time_ns=publish_time_ns,
+            publishes=publishes,
+            interval_ms=interval_ms,
+            counters=dict(zip(names, values)),
+        )
+
+        hist_size = (len(HISTOGRAM_FIELDS) + num_buckets) * 8
+        for p in range(min(num_paths, len(path_names))):
+            fields = struct.unpack_from(f"={len(HISTOGRAM_FIELDS)}Q", data, histograms_offset + p * hist_size)
+            snap.histograms[path_names[p]] = dict(zip(HISTOGRAM_FIELDS, fields))
+
+        peer_size = len(PEER_FIELDS) * 8
+        for peer in range(num_peers):
+            fields = struct.unpack_from(f"={len(PEER_FIELDS)}Q", data, peers_offset + peer * peer_size)
+            if fields[0] or fields[2]:
+                snap.peers[peer] = dict(zip(PEER_FIELDS, fields))
+
+        return snap
+
+
+def _names(data: bytes, offset: int, length: int) -> list:
+    """Split a NUL-padded, newline-terminated name list."""
+    raw = data[offset:offset + length].split(b"\0", 1)[0].decode("ascii", "replace")
+    return [name for name in raw.split("\n") if name]
@@ -10,7 +10,11 @@ from dsm_visualizer.models.grid_state import GridState
 from dsm_visualizer.models.dsm_stats import DSMStats, NodeStats
 from dsm_visualizer.renderers.pygame_grid import PygameGridRenderer
 from dsm_visualizer.simulation.demo_simulator import DemoSimulator
-from dsm_visualizer.data_sources.csv_reader import CSVStatsReader, PerfLogReader
+from dsm_visualizer.data_sources.csv_reader import (
+    CSVStatsReader,
+    PerfLogReader,
+    SharingProfileReader,
+)
 from dsm_visualizer.data_sources.process_monitor import (
     GameOfLifeMonitor,
     ProcessEvent,
@@ -461,6 +465,11 @@ def run_replay(config: VisualizerConfig, args: argparse.Namespace) -> None:
     if perf_events:
         print(f"  Loaded {len(perf_events)} performance events")
 
+    # Load the merged sharing profile if the nodes ran the profiler
+    hot_pages = SharingProfileReader(str(stats_path)).read_pages()
+    if hot_pages:
+        print(f"  Loaded sharing profile for {len(hot_pages)} pages")
+
     if not all_node_stats:
         print("Error: No stats files found")
         sys.exit(1)
@@ -475,6 +484,7 @@ def run_replay(config: VisualizerConfig, args: argparse.Namespace) -> None:
     stats = DSMStats()
     for node_id, node_stats in all_node_stats.items():
         stats.set_node(node_id, node_stats)
+    stats.hot_pages = hot_pages
 
     # Main display loop
     running = True
@@ -1,6 +1,6 @@
 """Models package for DSM visualizer."""
 
 from dsm_visualizer.models.grid_state import GridState
-from dsm_visualizer.models.dsm_stats import DSMStats, NodeStats
+from dsm_visualizer.models.dsm_stats import DSMStats, NodeStats, PageSharing
 
-__all__ = ["GridState", "DSMStats", "NodeStats"]
+__all__ = ["GridState", "DSMStats", "NodeStats", "PageSharing"]
@@ -1,7 +1,7 @@
 """DSM statistics models."""
 
 from dataclasses import dataclass, field
-from typing import Dict
+from typing import Dict, List, Set
 
 
 @dataclass
@@ -54,12 +54,46 @@ class NodeStats:
         return self.bytes_received / 1024
 
 
+@dataclass
+class PageSharing:
+    """Sharing profile of one page, merged from every node's dsm_sharing_nodeN.csv."""
+
+    page_id: int
+    writers: Set[int] = field(default_factory=set)
+    writes: int = 0
+    invalidations: int = 0
+    pingpongs: int = 0
+    # Writes per cell (a cache line of a 4 KiB page), by the node that made them
+    cells: Dict[int, List[int]] = field(default_factory=dict)
+
+    @property
+    def num_cells(self) -> int:
+        """Cells per page in the profile."""
+        return max((len(c) for c in self.cells.values()), default=0)
+
+    def cell_writers(self, cell: int) -> List[int]:
+        """Nodes that wrote a cell."""
+        return sorted(
+            node for node, counts in self.cells.items() if cell < len(counts) and counts[cell]
+        )
+
+    @property
+    def false_sharing(self) -> bool:
+        """Several nodes write the page, but never the same cell."""
+        written = [n for n, counts in self.cells.items() if any(counts)]
+        if len(written) < 2:
+            return False
+        return all(len(self.cell_writers(c)) <= 1 for c in range(self.num_cells))
+
+
 @dataclass
 class DSMStats:
     """Aggregated DSM statistics across all nodes."""
 
     node_stats: Dict[int, NodeStats] = field(default_factory=dict)
     generation: int = 0
+    # Most contended pages first (empty unless the sharing profiler ran)
+    hot_pages: List[PageSharing] = field(default_factory=list)
 
     def get_node(self, node_id: int) -> NodeStats:
         """Get stats for a specific node, creating if needed."""
@@ -130,3 +164,4 @@ class DSMStats:
         """Reset all statistics."""
         self.node_stats.clear()
         self.generation = 0
+        self.hot_pages.clear()
@@ -15,6 +15,7 @@ from dsm_visualizer.config import (
     SEPARATOR_COLOR,
     SUCCESS_COLOR,
     WARNING_COLOR,
+    BOUNDARY_COLOR,
     ACCENT_COLOR,
     CARD_BORDER_RADIUS,
     PANEL_PADDING,
@@ -336,6 +337,65 @@ class StatsPanel:
 
         return y + card_h + self.card_gap
 
+    def _draw_hot_pages_card(self, y: int, stats: DSMStats, max_pages: int = 5) -> int:
+        """
+        Draw the most contended pages with a heat strip of their cells.
+
+        Each strip cell is one cell of the page: dim if nobody wrote it,
+        the writer's accent color if one node did, red if several did.
+        """
+        pages = stats.hot_pages[:max_pages]
+        card_x = self.padding
+        card_w = self.width - 2 * self.padding
+        row_h = 34
+        card_h = 30 + row_h * len(pages)
+
+        self._draw_rounded_rect(
+            self.content_surface,
+            (card_x, y, card_w, card_h),
+            STATS_PANEL_CARD_BG,
+            border_color=WARNING_COLOR,
+        )
+
+        inner_x = card_x + self.card_padding
+        inner_w = card_w - 2 * self.card_padding
+        inner_y = y + 8
+
+        title_surf = self.label_font.render("HOT PAGES", True, WARNING_COLOR)
+        self.content_surface.blit(title_surf, (inner_x, inner_y))
+        inner_y += 20
+
+        for page in pages:
+            writers = ",".join(str(w) for w in sorted(page.writers)) or "-"
+            line = f"#{page.page_id}  w:{writers}  pp:{page.pingpongs}"
+            if page.false_sharing:
+                line += "  FALSE"
+            color = WARNING_COLOR if page.false_sharing else TEXT_COLOR
+            line_surf = self.small_font.render(line, True, color)
+            self.content_surface.blit(line_surf, (inner_x, inner_y))
+
+            num_cells = page.num_cells
+            if num_cells:
+                cell_w = max(1, inner_w // num_cells)
+                for c in range(num_cells):
+                    cell_writers = page.cell_writers(c)
+                    if not cell_writers:
+                        cell_color = SEPARATOR_COLOR
+                    elif len(cell_writers) == 1:
+                        cell_color = NODE_ACCENT_COLORS[
+                            cell_writers[0] % len(NODE_ACCENT_COLORS)
+                        ]
+                    else:
+                        cell_color = BOUNDARY_COLOR
+                    pygame.draw.rect(
+                        self.content_surface,
+                        cell_color,
+                        (inner_x + c * cell_w, inner_y + 14, max(1, cell_w - 1), 8),
+                    )
+            inner_y += row_h
+
+        return y + card_h + self.card_gap
+
     def _draw_controls_card(self, y: int) -> int:
         """Draw the controls help card (legacy, checks height)."""
         return self._draw_controls_card_always(y)
@@ -473,6 +533,10 @@ class StatsPanel:
         # Totals card
         y = self._draw_totals_card(y, stats)
 
+        # Hot pages card (only when a sharing profile was loaded)
+        if stats.hot_pages:
+            y = self._draw_hot_pages_card(y, stats)
+
         # Controls card
         y = self._draw_controls_card_always(y)
 